@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# coding: utf-8
+#
+# Microbenchmark driver for `make bench`.  Starts a temporary instance,
+# exercises the engine primitives and prints one JSON object per benchmark
+# on stdout, so CI can append the lines to a trend file.
+#
+# The in-backend primitives (find_page descent, page item locator walk,
+# page_locator_insert_item, o_compress_page, lock_page) run through
+# orioledb_bench_primitive(); o_btree_modify() insert/update loops are
+# driven through plain SQL and reported both as wall-clock averages and as
+# orioledb_latency percentiles.
+
+import json
+import os
+import time
+
+from threading import Thread
+
+import testgres
+
+ITERATIONS = int(os.getenv('ORIOLEDB_BENCH_ITERATIONS', '100000'))
+ROWS = int(os.getenv('ORIOLEDB_BENCH_ROWS', '100000'))
+LOCK_SESSIONS = int(os.getenv('ORIOLEDB_BENCH_LOCK_SESSIONS', '4'))
+
+PRIMITIVES = ['find_page', 'page_iterate', 'page_insert_item', 'compress',
+			  'lock_page']
+
+
+def report(name, iterations, ns_per_op):
+	print(json.dumps({
+		'benchmark': name,
+		'iterations': iterations,
+		'ns_per_op': round(ns_per_op, 2),
+		'ops_per_sec': round(1e9 / ns_per_op, 2) if ns_per_op > 0 else None
+	}), flush=True)
+
+
+def bench_primitive(node, name, iterations):
+	return float(node.execute(
+		'postgres',
+		"SELECT orioledb_bench_primitive('%s', 'bench'::regclass, %d)" %
+		(name, iterations))[0][0])
+
+
+def main():
+	node = testgres.get_new_node('bench')
+	node.init()
+	node.append_conf('postgresql.conf',
+					 "shared_preload_libraries = orioledb\n"
+					 "orioledb.track_latencies = on\n")
+	node.start()
+	try:
+		node.safe_psql('postgres', 'CREATE EXTENSION orioledb;')
+		node.safe_psql('postgres', """
+			CREATE TABLE bench (
+				id int8 NOT NULL,
+				value text NOT NULL,
+				PRIMARY KEY(id)
+			) USING orioledb;
+		""")
+
+		# o_btree_modify() insert and update loops through SQL
+		start = time.time()
+		node.safe_psql('postgres', """
+			INSERT INTO bench
+				SELECT id, repeat('x', 100) FROM generate_series(1, %d) id;
+		""" % ROWS)
+		report('modify_insert', ROWS, (time.time() - start) * 1e9 / ROWS)
+
+		start = time.time()
+		node.safe_psql('postgres', "UPDATE bench SET value = value || 'y';")
+		report('modify_update', ROWS, (time.time() - start) * 1e9 / ROWS)
+
+		for row in node.execute('postgres',
+								"SELECT operation, count, p50, p99, p999"
+								" FROM orioledb_latency"):
+			(operation, count, p50, p99, p999) = row
+			if count == 0:
+				continue
+			print(json.dumps({
+				'benchmark': 'latency_' + operation,
+				'iterations': count,
+				'p50_ns': p50,
+				'p99_ns': p99,
+				'p999_ns': p999
+			}), flush=True)
+
+		for name in PRIMITIVES:
+			report(name, ITERATIONS, bench_primitive(node, name, ITERATIONS))
+
+		# lock_page again, this time contended from several sessions at once
+		results = [None] * LOCK_SESSIONS
+
+		def worker(n):
+			results[n] = bench_primitive(node, 'lock_page', ITERATIONS)
+
+		threads = [Thread(target=worker, args=(n,))
+				   for n in range(LOCK_SESSIONS)]
+		for thread in threads:
+			thread.start()
+		for thread in threads:
+			thread.join()
+		report('lock_page_contended_%d' % LOCK_SESSIONS,
+			   ITERATIONS * LOCK_SESSIONS, sum(results) / LOCK_SESSIONS)
+	finally:
+		node.stop()
+		node.cleanup()
+
+
+if __name__ == '__main__':
+	main()
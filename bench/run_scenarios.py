@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+# coding: utf-8
+#
+# Macro benchmark scenarios for `make benchcheck`.  Each scenario encodes
+# one canonical workload shape against a temporary instance and reports a
+# single throughput number; the numbers are compared against the recorded
+# baselines in bench/baseline.json and the run fails when a scenario
+# regresses by more than its threshold.  Scale with care: the defaults are
+# sized so the whole suite stays in the page pool and finishes in minutes.
+#
+# Run with ORIOLEDB_BENCH_UPDATE_BASELINE=1 to re-record the baselines on
+# the reference machine instead of checking against them.
+
+import json
+import os
+import sys
+import time
+
+import testgres
+
+ROWS = int(os.getenv('ORIOLEDB_BENCH_ROWS', '200000'))
+BASELINE_FILE = os.path.join(os.path.dirname(__file__), 'baseline.json')
+
+
+def timed(node, sql):
+	start = time.time()
+	node.safe_psql('postgres', sql)
+	return time.time() - start
+
+
+def scenario_append_ingest(node):
+	node.safe_psql('postgres', """
+		CREATE TABLE ingest (
+			id int8 NOT NULL,
+			value text NOT NULL,
+			PRIMARY KEY(id)
+		) USING orioledb;
+	""")
+	elapsed = timed(node, """
+		INSERT INTO ingest
+			SELECT id, repeat('x', 100) FROM generate_series(1, %d) id;
+	""" % ROWS)
+	return ROWS / elapsed
+
+
+def scenario_random_updates_8idx(node):
+	cols = ', '.join('v%d int8 NOT NULL' % n for n in range(8))
+	node.safe_psql('postgres', """
+		CREATE TABLE upd8 (
+			id int8 NOT NULL,
+			%s,
+			PRIMARY KEY(id)
+		) USING orioledb;
+	""" % cols)
+	for n in range(8):
+		node.safe_psql('postgres',
+					   'CREATE INDEX upd8_ix%d ON upd8 (v%d);' % (n, n))
+	node.safe_psql('postgres', """
+		INSERT INTO upd8
+			SELECT id, %s FROM generate_series(1, %d) id;
+	""" % (', '.join(['id'] * 8), ROWS))
+
+	nupdates = ROWS // 10
+	elapsed = timed(node, """
+		DO $$
+		BEGIN
+			FOR i IN 1..%d LOOP
+				UPDATE upd8 SET v0 = v0 + 1, v7 = v7 + 1
+					WHERE id = 1 + (random() * (%d - 1))::int8;
+			END LOOP;
+		END $$;
+	""" % (nupdates, ROWS))
+	return nupdates / elapsed
+
+
+def scenario_upsert_storm(node):
+	node.safe_psql('postgres', """
+		CREATE TABLE upsert (
+			id int8 NOT NULL,
+			counter int8 NOT NULL,
+			PRIMARY KEY(id)
+		) USING orioledb;
+	""")
+	nupserts = ROWS // 10
+	keyspace = ROWS // 100
+	elapsed = timed(node, """
+		DO $$
+		BEGIN
+			FOR i IN 1..%d LOOP
+				INSERT INTO upsert VALUES (1 + (random() * (%d - 1))::int8, 1)
+					ON CONFLICT (id) DO UPDATE
+					SET counter = upsert.counter + 1;
+			END LOOP;
+		END $$;
+	""" % (nupserts, keyspace))
+	return nupserts / elapsed
+
+
+def scenario_bulk_delete_merge(node):
+	node.safe_psql('postgres', """
+		CREATE TABLE bulkdel (
+			id int8 NOT NULL,
+			value text NOT NULL,
+			PRIMARY KEY(id)
+		) USING orioledb;
+		INSERT INTO bulkdel
+			SELECT id, repeat('x', 100) FROM generate_series(1, %d) id;
+	""" % ROWS)
+	elapsed = timed(node, 'DELETE FROM bulkdel WHERE id %% 10 <> 0;')
+	# scan the sparse tree too: page merges keep this from degrading
+	elapsed += timed(node, 'SELECT count(*) FROM bulkdel;')
+	return ROWS / elapsed
+
+
+def scenario_compressed_cold_scan(node):
+	node.safe_psql('postgres', """
+		CREATE TABLE coldscan (
+			id int8 NOT NULL,
+			value text NOT NULL,
+			PRIMARY KEY(id)
+		) USING orioledb WITH (compress = 11);
+		INSERT INTO coldscan
+			SELECT id, repeat('x', 100) FROM generate_series(1, %d) id;
+	""" % ROWS)
+	node.safe_psql('postgres',
+				   "SELECT orioledb_evict_pages('coldscan'::regclass, 0);")
+	elapsed = timed(node, 'SELECT count(*) FROM coldscan;')
+	return ROWS / elapsed
+
+
+SCENARIOS = [
+	('append_ingest', scenario_append_ingest),
+	('random_updates_8idx', scenario_random_updates_8idx),
+	('upsert_storm', scenario_upsert_storm),
+	('bulk_delete_merge', scenario_bulk_delete_merge),
+	('compressed_cold_scan', scenario_compressed_cold_scan),
+]
+
+
+def main():
+	update_baseline = os.getenv('ORIOLEDB_BENCH_UPDATE_BASELINE') == '1'
+	baseline = {}
+	if not update_baseline and os.path.exists(BASELINE_FILE):
+		with open(BASELINE_FILE) as f:
+			baseline = json.load(f)
+
+	node = testgres.get_new_node('benchcheck')
+	node.init()
+	node.append_conf('postgresql.conf',
+					 "shared_preload_libraries = orioledb\n")
+	node.start()
+	failed = []
+	results = {}
+	try:
+		node.safe_psql('postgres', 'CREATE EXTENSION orioledb;')
+		for (name, scenario) in SCENARIOS:
+			ops_per_sec = scenario(node)
+			results[name] = ops_per_sec
+			entry = baseline.get(name)
+			status = 'recorded' if update_baseline else 'no-baseline'
+			if entry:
+				threshold = entry['ops_per_sec'] * \
+					(1.0 - entry['max_regression'])
+				status = 'ok' if ops_per_sec >= threshold else 'regression'
+				if status == 'regression':
+					failed.append(name)
+			print(json.dumps({
+				'benchmark': name,
+				'rows': ROWS,
+				'ops_per_sec': round(ops_per_sec, 2),
+				'baseline_ops_per_sec':
+					entry['ops_per_sec'] if entry else None,
+				'status': status
+			}), flush=True)
+	finally:
+		node.stop()
+		node.cleanup()
+
+	if update_baseline:
+		with open(BASELINE_FILE, 'w') as f:
+			json.dump({name: {'ops_per_sec': round(results[name], 2),
+							  'max_regression': 0.3}
+					   for (name, _) in SCENARIOS}, f, indent=1, sort_keys=True)
+			f.write('\n')
+	elif failed:
+		print('performance regression in: ' + ', '.join(failed),
+			  file=sys.stderr)
+		sys.exit(1)
+
+
+if __name__ == '__main__':
+	main()
@@ -58,6 +58,17 @@ typedef int (*OBTreeKeyCmp) (BTreeDescr *descr,
 							 void *p1, BTreeKeyType k1,
 							 void *p2, BTreeKeyType k2);
 
+/*
+ * Same as OBTreeKeyCmp, but supports skipping of leading key attributes
+ * known to be equal.  On entry, *equalAtts is the number of leading
+ * attributes the comparison may take as equal without looking at them.  On
+ * exit, it's set to the number of leading attributes which compared equal.
+ */
+typedef int (*OBTreeKeyCmpPrefix) (BTreeDescr *descr,
+								   void *p1, BTreeKeyType k1,
+								   void *p2, BTreeKeyType k2,
+								   int *equalAtts);
+
 typedef struct
 {
 	OInMemoryBlkno rootPageBlkno;
@@ -134,9 +145,41 @@ typedef struct
 							   OTuple newTuple, OXid newOxid);
 	uint32		(*hash) (BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType);
 	uint32		(*unique_hash) (BTreeDescr *desc, OTuple tuple);
+
+	/*
+	 * Compute a 64-bit order-preserving abbreviation of a key: if
+	 * abbrev(k1) < abbrev(k2), then k1 < k2.  Equal abbreviations don't
+	 * guarantee equal keys, so ties must be resolved with cmp.  Returns false
+	 * if the given key can't be abbreviated.  Optional: NULL if tree keys
+	 * can't be abbreviated at all.
+	 */
+	bool		(*key_abbrev) (BTreeDescr *desc, void *key,
+							   BTreeKeyType kind, uint64 *abbrev);
 	OBTreeKeyCmp cmp;
+
+	/*
+	 * Prefix-aware version of cmp, used by the page binary search to skip
+	 * leading attributes shared by the search range.  Optional: NULL if the
+	 * tree keys aren't compared attribute by attribute.
+	 */
+	OBTreeKeyCmpPrefix cmpPrefix;
+
+	/*
+	 * Build a minimal separator key containing only the first `natts`
+	 * attributes of the given key.  Attributes cut away compare less than
+	 * any value (see cmp).  Returns a NULL tuple when the key can't be
+	 * truncated.  Optional: NULL if the tree doesn't support separator key
+	 * truncation.
+	 */
+	OTuple		(*truncate_key) (BTreeDescr *desc, OTuple key, int natts);
 } BTreeOps;
 
+typedef struct
+{
+	OInMemoryBlkno blkno;
+	uint32		pageChangeCount;
+} BTreeLocationHint;
+
 struct BTreeDescr
 {
 	BTreeRootInfo rootInfo;
@@ -146,6 +189,8 @@ struct BTreeDescr
 	OIndexType	type;
 	OPagePool  *ppool;
 	OCompress	compress;
+	/* trained compression dictionary of the tree, NULL if none */
+	struct OCompressDict *compressDict;
 	UndoReserveType undoType;
 	BTreeStorageType storageType;
 	SeqBufDescPrivate freeBuf;
@@ -153,6 +198,12 @@ struct BTreeDescr
 	SeqBufDescPrivate tmpBuf[2];
 	OXid		createOxid;
 	BTreeOps   *ops;
+
+	/*
+	 * Backend-local cache of the rightmost leaf location.  Lets inserts of
+	 * monotonically increasing keys skip the descent from the root.
+	 */
+	BTreeLocationHint rightmostHint;
 };
 
 static inline int
@@ -206,12 +257,6 @@ o_btree_cmp(BTreeDescr *desc, void *p1, BTreeKeyType k1,
 
 typedef struct BTreePageItemLocator BTreePageItemLocator;
 
-typedef struct
-{
-	OInMemoryBlkno blkno;
-	uint32		pageChangeCount;
-} BTreeLocationHint;
-
 typedef struct
 {
 	BTreeLocationHint hint;
@@ -237,6 +282,12 @@ typedef struct
 #define TREE_NUM_LEAF_PAGES(desc) \
 	(pg_atomic_read_u32(&BTREE_GET_META(desc)->leafPagesNum))
 
+/*
+ * Get approximate number of live tuples in the tree.
+ */
+#define TREE_NUM_LIVE_TUPLES(desc) \
+	(pg_atomic_read_u64(&BTREE_GET_META(desc)->liveTuplesNum))
+
 /*
  * Check if given tree needs WAL and XIP records.  Currently, only primary index
  * tree and TOAST tree need it.  Argument is (BTreeDescr *).
@@ -17,6 +17,17 @@
 
 typedef struct Tuplesortstate Tuplesortstate;
 
+/*
+ * Streaming bottom-up bulk load of an ordered tuple stream, see
+ * src/btree/build.c.
+ */
+typedef struct BTreeBulkLoadState BTreeBulkLoadState;
+
+extern BTreeBulkLoadState *btree_bulk_load_begin(BTreeDescr *desc, uint64 ctid,
+												 bool validateOrder);
+extern void btree_bulk_load_add_tuple(BTreeBulkLoadState *state, OTuple tuple);
+extern void btree_bulk_load_finish(BTreeBulkLoadState *state,
+								   CheckpointFileHeader *file_header);
 extern void btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 								   Tuplesortstate *sortstate, uint64 ctid,
 								   CheckpointFileHeader *file_header);
@@ -15,6 +15,9 @@
 
 #include "btree/btree.h"
 
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+
 typedef struct
 {
 	int			from;
@@ -34,8 +37,14 @@ typedef struct
 } BTreeCompressStats;
 
 extern bool check_btree(BTreeDescr *desc, bool force_file_check);
+extern bool check_btree_structure(BTreeDescr *desc, int nworkers,
+								  double sampleRatio);
+extern void o_btree_struct_check_worker_main(dsm_segment *seg, shm_toc *toc);
 extern void check_btree_compression(BTreeDescr *desc,
 									BTreeCompressStats *stats,
 									OCompress lvl);
+extern size_t train_btree_compression_dict(BTreeDescr *desc,
+										   Pointer dictBuffer,
+										   size_t dictCapacity);
 
 #endif							/* __BTREE_CHECK_H__ */
@@ -0,0 +1,28 @@
+/*-------------------------------------------------------------------------
+ *
+ * decompress_cache.h
+ *		Declarations of the cache of decompressed page images.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/decompress_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_DECOMPRESS_CACHE_H__
+#define __BTREE_DECOMPRESS_CACHE_H__
+
+#include "btree.h"
+
+extern Size decompress_cache_shmem_needs(void);
+extern void decompress_cache_shmem_init(Pointer ptr, bool found);
+
+extern bool o_decompress_cache_enabled(void);
+extern bool o_decompress_cache_lookup(BTreeDescr *desc, uint64 offset,
+									  Page img);
+extern void o_decompress_cache_store(BTreeDescr *desc, uint64 offset,
+									 Page img);
+extern void o_decompress_cache_invalidate(BTreeDescr *desc, uint64 offset);
+
+#endif							/* __BTREE_DECOMPRESS_CACHE_H__ */
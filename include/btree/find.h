@@ -42,6 +42,13 @@ typedef struct
 	int			index;
 	OBtreePageFindItem items[ORIOLEDB_MAX_DEPTH];
 
+	/*
+	 * Last leaf page found by this context.  When the next searched key still
+	 * falls between the fences of this page, the root-to-leaf descent can be
+	 * skipped (see find_page_via_leaf_hint()).
+	 */
+	BTreeLocationHint leafHint;
+
 	/*
 	 * When BTREE_PAGE_FIND_LOKEY_SIBLING is not set, then lokey contains
 	 * hikey of left sibling of parent.  Otherwise, contain hikey of left
@@ -89,6 +96,8 @@ extern bool find_page(OBTreeFindPageContext *context, void *key,
 extern bool refind_page(OBTreeFindPageContext *context, void *key,
 						BTreeKeyType keyType, uint16 level,
 						OInMemoryBlkno blkno, uint32 pageChangeCount);
+extern void prefetch_page_for_key(BTreeDescr *desc, Pointer key,
+								  BTreeKeyType keyType, uint64 *lastDownlink);
 
 extern bool find_right_page(OBTreeFindPageContext *context, OFixedKey *hikey);
 extern bool find_left_page(OBTreeFindPageContext *context, OFixedKey *hikey);
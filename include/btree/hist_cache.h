@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * hist_cache.h
+ *		Declarations of the cache of reconstructed historical page images.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/hist_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_HIST_CACHE_H__
+#define __BTREE_HIST_CACHE_H__
+
+#include "btree.h"
+
+extern Size hist_cache_shmem_needs(void);
+extern void hist_cache_shmem_init(Pointer ptr, bool found);
+
+extern bool o_hist_cache_enabled(void);
+extern bool o_hist_cache_lookup(UndoLocation undoLoc, OTuple hikey,
+								LocationIndex hikeyLen,
+								CommitSeqNo csn, Page img,
+								OffsetNumber *startOffset);
+extern void o_hist_cache_store(UndoLocation undoLoc, OTuple hikey,
+							   LocationIndex hikeyLen,
+							   CommitSeqNo imageCsn, CommitSeqNo prevCsn,
+							   OffsetNumber startOffset, Page img);
+
+#endif							/* __BTREE_HIST_CACHE_H__ */
@@ -16,6 +16,13 @@
 #include "btree.h"
 #include "btree/find.h"
 
+/*
+ * Writeback ranges separated by at most this many blocks are merged into a
+ * single btree_smgr_writeback() call: flushing a small clean gap is cheaper
+ * than an extra syscall, while a larger gap would amplify the writes.
+ */
+#define WRITEBACK_MERGE_GAP	16
+
 typedef enum OWalkPageResult
 {
 	OWalkPageSkipped,
@@ -29,7 +36,13 @@ extern void btree_io_shmem_init(Pointer buf, bool found);
 extern void btree_io_error_cleanup(void);
 extern void request_btree_io_lwlocks(void);
 extern int	assign_io_num(OInMemoryBlkno blkno, OffsetNumber offnum);
+extern void btree_write_start(BTreeDescr *desc);
+extern void btree_write_finish(void);
 extern OWalkPageResult walk_page(OInMemoryBlkno blkno, bool evict);
+extern OWalkPageResult merge_page_if_sparse(OInMemoryBlkno blkno);
+extern int	merge_sparse_pages_pass(int workerId, int workersCount,
+									int maxMerges,
+									volatile sig_atomic_t *shutdown_requested);
 extern void unlock_io(int ionum);
 extern void wait_for_io_completion(int ionum);
 extern bool cleanup_btree_files(Oid datoid, Oid relnode);
@@ -45,11 +58,13 @@ extern int	btree_smgr_write(BTreeDescr *desc, char *buffer, int amount,
 							 off_t offset);
 extern int	btree_smgr_read(BTreeDescr *desc, char *buffer, int amount,
 							off_t offset);
+extern void btree_smgr_prefetch(BTreeDescr *desc, off_t offset, int amount);
 extern void btree_smgr_writeback(BTreeDescr *desc, off_t offset, int amount);
 extern void btree_smgr_sync(BTreeDescr *desc, off_t length);
 
 extern void init_btree_io_lwlocks(void);
 extern bool read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink, FileExtent *extent);
+extern void prefetch_page_from_disk(BTreeDescr *desc, uint64 downlink);
 extern void load_page(OBTreeFindPageContext *context);
 extern uint64 perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 							  Page img, uint32 checkpoint_number,
@@ -39,6 +39,12 @@ extern OTuple o_btree_find_tuple_by_key(BTreeDescr *desc, void *key,
 										MemoryContext mcxt,
 										BTreeLocationHint *hint);
 
+extern int	o_btree_find_tuples_batch(BTreeDescr *desc, void **keys,
+									  BTreeKeyType kind, int nkeys,
+									  CommitSeqNo readCsn,
+									  CommitSeqNo *outCsns,
+									  MemoryContext mcxt, OTuple *tuples);
+
 extern BTreeIterator *o_btree_iterator_create(BTreeDescr *desc, void *key,
 											  BTreeKeyType kind, CommitSeqNo csn,
 											  ScanDirection scan);
@@ -51,6 +57,13 @@ extern OTuple o_btree_iterator_fetch(BTreeIterator *it, CommitSeqNo *tupleCsn,
 									 void *end, BTreeKeyType endType,
 									 bool endIsIncluded,
 									 BTreeLocationHint *hint);
+extern int	o_btree_iterator_fetch_batch(BTreeIterator *it,
+										 CommitSeqNo *tupleCsns,
+										 void *end, BTreeKeyType endType,
+										 bool endIsIncluded,
+										 BTreeLocationHint *hint,
+										 OTuple *tuples, int max,
+										 bool *scanEnd);
 extern OTuple btree_iterate_raw(BTreeIterator *it, void *end,
 								BTreeKeyType endKind, bool endInclude,
 								bool *scanEnd, BTreeLocationHint *hint);
@@ -81,5 +81,8 @@ extern OBTreeModifyResult o_btree_insert_unique(BTreeDescr *desc,
 												RowLockMode lock_mode,
 												BTreeLocationHint *hint,
 												BTreeModifyCallbackInfo *callbackInfo);
+extern bool o_btree_unique_probe(BTreeDescr *desc, OTuple tuple,
+								 Pointer key, BTreeKeyType keyType,
+								 OXid opOxid);
 
 #endif							/* __BTREE_MODIFY_H__ */
@@ -30,8 +30,26 @@ typedef struct
 	bool		newItem;
 } BTreePageItem;
 
+/*
+ * Flat snapshot of an internal page: all downlinks together with their keys,
+ * decoded in one pass and indexed by the page item offset.  Iteration over
+ * the snapshot is a plain array walk instead of stepping an item locator
+ * across chunk boundaries for every item.  The keys point into the page
+ * image the snapshot was taken from, so the snapshot stays valid exactly as
+ * long as the image does.
+ */
+typedef struct
+{
+	int			itemsCount;
+	uint64		downlinks[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	OTuple		keys[BTREE_PAGE_MAX_CHUNK_ITEMS];
+} BTreePageItems;
+
 extern bool partial_load_chunk(PartialPageState *partial, Page img,
 							   OffsetNumber chunkOffset);
+extern bool btree_page_decode_internal_items(Page p,
+											 PartialPageState *partial,
+											 BTreePageItems *items);
 extern BTreeItemPageFitType page_locator_fits_item(BTreeDescr *desc,
 												   Page p,
 												   BTreePageItemLocator *locator,
@@ -17,6 +17,23 @@
 
 #define NUM_SEQ_SCANS_ARRAY_SIZE	32
 
+/*
+ * Per-tree hot-path counters exposed by orioledb_tree_stat().  Incremented
+ * with atomics and never reset, so readers diff the snapshots.
+ */
+typedef struct
+{
+	pg_atomic_uint64 lockAcquires;
+	pg_atomic_uint64 lockWaits;
+	pg_atomic_uint64 splits;
+	pg_atomic_uint64 merges;
+	pg_atomic_uint64 evictions;
+	pg_atomic_uint64 writeBytesRaw;
+	pg_atomic_uint64 writeBytesCompressed;
+	pg_atomic_uint64 readRetries;
+	pg_atomic_uint64 readLockFallbacks;
+} BTreeTreeStats;
+
 /* The structure of BTree meta page.  Referenced by metaPageBlkno. */
 typedef struct
 {
@@ -39,8 +56,35 @@ typedef struct
 	pg_atomic_uint64 ctid;
 	pg_atomic_uint32 leafPagesNum;
 
+	/*
+	 * Approximate number of live (non-deleted) tuples in the tree.  Updated
+	 * on inserts, deletes and undo rollbacks; persisted in the checkpoint
+	 * file header, so changes since the last checkpoint are lost on crash.
+	 * Used by planner size estimation, which tolerates the inaccuracy.
+	 */
+	pg_atomic_uint64 liveTuplesNum;
+
+	/*
+	 * Number of dirty in-memory pages of the tree and number of in-flight
+	 * operations, which have sampled a checkpoint number and may still
+	 * relocate pages or free file extents (see btree_write_start()).  The
+	 * checkpointer skips traversal of trees where both counters are zero:
+	 * the previous on-disk image is still exact.
+	 */
+	pg_atomic_uint32 dirtyPagesCount;
+	pg_atomic_uint32 inProgressWritesCount;
+
 	/* Number of running sequential scans depending on the checkpoint number */
 	pg_atomic_uint32 numSeqScans[NUM_SEQ_SCANS_ARRAY_SIZE];
+
+	/*
+	 * Generation of the unique check bloom filter covering this tree, 0 if
+	 * the tree isn't covered.  See src/btree/unique_filter.c.
+	 */
+	pg_atomic_uint64 uniqueFilterGen;
+
+	/* Hot-path counters of the tree */
+	BTreeTreeStats stats;
 } BTreeMetaPage;
 
 StaticAssertDecl(sizeof(BTreeMetaPage) <= ORIOLEDB_BLCKSZ,
@@ -49,6 +93,37 @@ StaticAssertDecl(sizeof(BTreeMetaPage) <= ORIOLEDB_BLCKSZ,
 #define BTREE_GET_META(desc) \
 	((BTreeMetaPage *) O_GET_IN_MEMORY_PAGE((desc)->rootInfo.metaPageBlkno))
 
+/* Bump a per-tree counter, if the tree meta page is loaded */
+#define O_TREE_STAT_ADD(desc, field, val) \
+	do { \
+		if (OMetaPageIsValid(desc)) \
+			pg_atomic_fetch_add_u64(&BTREE_GET_META(desc)->stats.field, \
+									(uint64) (val)); \
+	} while (0)
+#define O_TREE_STAT_INC(desc, field) O_TREE_STAT_ADD(desc, field, 1)
+
+/*
+ * Insert pattern tracking.  Three 4-bit saturating scores are packed into
+ * BTreePageHeader.insertPattern: ascending, descending and hotspot.  Unlike
+ * prevInsertOffset, which only recognizes a pattern when two consecutive
+ * inserts into the page are adjacent, the scores survive interleaving - a
+ * page fed by several ascending streams (e.g. multi-tenant indexes) still
+ * accumulates an ascending score - and drive the split point selection in
+ * btree_get_split_left_count().
+ */
+#define O_INSERT_PATTERN_ASC(header)  ((header)->insertPattern & 0xF)
+#define O_INSERT_PATTERN_DESC(header) (((header)->insertPattern >> 4) & 0xF)
+#define O_INSERT_PATTERN_HOT(header)  (((header)->insertPattern >> 8) & 0xF)
+#define O_INSERT_PATTERN_MAKE(asc, desc, hot) \
+	((uint16) (asc) | ((uint16) (desc) << 4) | ((uint16) (hot) << 8))
+#define O_INSERT_PATTERN_SCORE_MAX		15
+/* score value from which we trust the detected pattern */
+#define O_INSERT_PATTERN_THRESHOLD		12
+/* an insert within this many items of the previous one counts as a hotspot */
+#define O_INSERT_PATTERN_HOTSPOT_DISTANCE	8
+
+extern void page_track_insert_pattern(Page p, OffsetNumber offset);
+
 typedef struct
 {
 	uint32		shortLocation:12,
@@ -114,6 +189,11 @@ typedef struct
 	OffsetNumber itemsCount;
 	OffsetNumber hikeysEnd;
 	LocationIndex dataSize;
+
+	/*
+	 * Insert pattern scores of the page, see page_track_insert_pattern().
+	 */
+	uint16		insertPattern;
 	BTreePageChunkDesc chunkDesc[1];
 } BTreePageHeader;
 
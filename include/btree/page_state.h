@@ -20,9 +20,17 @@
 #define PAGE_STATE_LIST_LOCKED_FLAG	2
 #define PAGE_STATE_LOCKED_FLAG	4
 #define PAGE_STATE_NO_READ_FLAG	8
-#define PAGE_STATE_CHANGE_COUNT_ONE	16
-#define PAGE_STATE_CHANGE_COUNT_MASK (0xFFFFFFF0)
-#define PAGE_STATE_CHANGE_NON_WAITERS_MASK (0xFFFFFFFC)
+
+/*
+ * Counter of shared lockers.  A shared lock doesn't conflict with the
+ * exclusive lock itself, but page_block_reads() waits till all the shared
+ * lockers are gone, same as it blocks the lock-less readers.
+ */
+#define PAGE_STATE_SHARED_ONE	16
+#define PAGE_STATE_SHARED_MASK	(0x3F0)
+#define PAGE_STATE_CHANGE_COUNT_ONE	1024
+#define PAGE_STATE_CHANGE_COUNT_MASK (0xFFFFFC00)
+#define PAGE_STATE_CHANGE_NON_WAITERS_MASK (0xFFFFFC0C)
 
 /* Macros for dealing with OrioleDBPageHeader.state */
 #define O_PAGE_STATE_IS_LOCKED(state) ((state) & PAGE_STATE_LOCKED_FLAG)
@@ -30,8 +38,13 @@
 #define O_PAGE_STATE_BLOCK_READ(state) ((state) | PAGE_STATE_LOCKED_FLAG | PAGE_STATE_NO_READ_FLAG)
 #define O_PAGE_STATE_READ_IS_BLOCKED(state) ((state) & PAGE_STATE_NO_READ_FLAG)
 
+extern uint64 page_lock_nacquires;
+extern uint64 page_lock_nwaits;
+
 extern bool have_locked_pages(void);
 extern void lock_page(OInMemoryBlkno blkno);
+extern void lock_page_shared(OInMemoryBlkno blkno);
+extern void unlock_page_shared(OInMemoryBlkno blkno);
 extern void relock_page(OInMemoryBlkno blkno);
 extern bool try_lock_page(OInMemoryBlkno blkno);
 extern void delare_page_as_locked(OInMemoryBlkno blkno);
@@ -16,6 +16,7 @@
 #include "btree/btree.h"
 #include "btree/page_contents.h"
 
+#include "access/relscan.h"
 #include "executor/tuptable.h"
 #include "utils/sampling.h"
 
@@ -27,12 +28,46 @@ typedef struct BTreeSeqScanCallbacks
 	bool		(*getNextKey) (OFixedKey *key, bool inclusive, void *arg);
 } BTreeSeqScanCallbacks;
 
-extern BTreeSeqScan *make_btree_seq_scan(BTreeDescr *desc, CommitSeqNo csn);
+/*
+ * Filter applied to raw leaf tuples of a sequential scan, see
+ * btree_seq_scan_set_tuple_filter().
+ */
+typedef bool (*BTreeSeqScanTupleFilter) (OTuple tuple, void *arg);
+
+/*
+ * Shared state of a parallel sequential scan.
+ *
+ * The key space is handed out to the workers dynamically.  The `watermark`
+ * key marks the boundary below which all keys are already claimed by some
+ * worker.  Each worker iterates the internal pages on its own and claims the
+ * downlink keyranges reaching beyond the watermark, advancing the watermark
+ * to the keyrange hikey.  Claims are versioned, so the key comparison is
+ * done outside of the spinlock.
+ */
+typedef struct ParallelOScanDescData
+{
+	ParallelTableScanDescData phs_base;
+	slock_t		mutex;
+	uint64		claimVersion;
+	bool		finished;
+	bool		watermarkValid;
+	OFixedShmemKey watermark;
+} ParallelOScanDescData;
+
+typedef ParallelOScanDescData *ParallelOScanDesc;
+
+extern Size seq_scan_shmem_needs(void);
+extern void seq_scan_shmem_init(Pointer ptr, bool found);
+extern BTreeSeqScan *make_btree_seq_scan(BTreeDescr *desc, CommitSeqNo csn,
+										 ParallelOScanDesc poscan);
 extern BTreeSeqScan *make_btree_seq_scan_cb(BTreeDescr *desc, CommitSeqNo csn,
 											BTreeSeqScanCallbacks *cb,
 											void *arg);
 extern BTreeSeqScan *make_btree_sampling_scan(BTreeDescr *desc,
 											  BlockSampler sampler);
+extern void btree_seq_scan_set_tuple_filter(BTreeSeqScan *scan,
+											BTreeSeqScanTupleFilter filter,
+											void *arg);
 extern OTuple btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
 									 CommitSeqNo *tupleCsn,
 									 BTreeLocationHint *hint);
@@ -59,7 +59,9 @@ extern bool page_item_rollback(BTreeDescr *desc, Page p, BTreePageItemLocator *l
 extern BTreeLeafTuphdr *make_undo_record(BTreeDescr *desc, OTuple tuple,
 										 bool is_tuple, BTreeOperationType action,
 										 OInMemoryBlkno blkno, uint32 pageChangeCount,
-										 UndoLocation *undoLocation);
+										 UndoLocation *undoLocation,
+										 OTuple *newTuple);
+extern bool undo_record_is_delta_update(UndoLocation location);
 
 extern void get_page_from_undo(BTreeDescr *desc, UndoLocation undo_loc, Pointer key,
 							   BTreeKeyType kind, Pointer dest,
@@ -89,6 +91,7 @@ extern void modify_undo_callback(UndoLocation location,
 								 OXid oxid,
 								 bool abort,
 								 bool changeCountsValid);
+extern ORelOids btree_undo_item_get_oids(UndoStackItem *baseItem);
 extern void lock_undo_callback(UndoLocation location, UndoStackItem *baseItem,
 							   OXid oxid, bool abort,
 							   bool changeCountsValid);
@@ -100,7 +103,8 @@ extern void get_prev_leaf_header_from_undo(BTreeLeafTuphdr *tuphdr,
 										   bool inPage);
 extern void get_prev_leaf_header_and_tuple_from_undo(BTreeLeafTuphdr *tuphdr,
 													 OTuple *tuple,
-													 LocationIndex sizeAvailable);
+													 LocationIndex sizeAvailable,
+													 OTuple newTuple);
 extern void update_leaf_header_in_undo(BTreeLeafTuphdr *tuphdr, UndoLocation location);
 extern void add_undo_truncate_relnode(ORelOids oldOids, ORelOids *oldTreeOids,
 									  int oldNumTreeOids,
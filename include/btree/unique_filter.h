@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * unique_filter.h
+ * 		Declarations for the unique check bloom filter.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/unique_filter.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_UNIQUE_FILTER_H__
+#define __BTREE_UNIQUE_FILTER_H__
+
+#include "btree.h"
+
+extern Size unique_filter_shmem_needs(void);
+extern void unique_filter_shmem_init(Pointer ptr, bool found);
+
+extern bool o_unique_filter_enabled(void);
+extern void o_unique_filter_try_cover(BTreeDescr *desc, Page p);
+extern bool o_unique_filter_covered(BTreeDescr *desc);
+extern void o_unique_filter_insert(BTreeDescr *desc, uint32 uniqueHash);
+extern bool o_unique_filter_test(BTreeDescr *desc, uint32 uniqueHash);
+
+#endif							/* __BTREE_UNIQUE_FILTER_H__ */
@@ -16,7 +16,11 @@
 #include "catalog/sys_trees.h"
 
 extern FileExtent get_extent(BTreeDescr *desc, uint16 len);
+extern FileExtent get_extent_near(BTreeDescr *desc, uint16 len,
+								  uint64 hintOff);
 extern void free_extent(BTreeDescr *desc, FileExtent extent);
+extern void release_reserved_extents(void);
+extern void free_extents_xact_callback(XactEvent event, void *arg);
 
 typedef void (*ForEachExtentCallback) (BTreeDescr *desc, FileExtent extent, void *arg);
 extern void foreach_free_extent(BTreeDescr *desc, ForEachExtentCallback callback,
@@ -19,6 +19,9 @@
 
 #include "catalog/o_tables.h"
 
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+
 extern void o_index_create(Relation rel,
 						   IndexStmt *stmt,
 						   const char *queryString,
@@ -34,5 +37,6 @@ extern void assign_new_oids(OTable *oTable, Relation rel);
 extern void recreate_o_table(OTable *old_o_table, OTable *o_table);
 extern void build_secondary_index(OTable *o_table, OTableDescr *descr,
 								  OIndexNumber ix_num);
+extern void o_index_build_worker_main(dsm_segment *seg, shm_toc *toc);
 
 #endif							/* __INDICES_H__ */
@@ -26,11 +26,15 @@ typedef struct
 	OXid		createOxid;
 	NameData	name;
 	bool		primaryIsCtid;
+	/* RELPERSISTENCE_* of the table the index belongs to */
+	char		tablePersistence;
 	OCompress	compress;
 	uint16		nLeafFields;
 	uint16		nNonLeafFields;
 	uint16		nUniqueFields;
 	uint16		nKeyFields;
+	/* number of included columns stored in leaf tuples only */
+	uint16		nIncludedFields;
 	uint16		nPrimaryFields;
 	AttrNumber	primaryFieldsAttnums[INDEX_MAX_KEYS];
 	OTableField *leafFields;
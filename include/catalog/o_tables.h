@@ -76,6 +76,8 @@ typedef struct
 	OIndexType	type;
 	OCompress	compress;
 	uint8		nfields;
+	/* fields[nkeyfields .. nfields) are included (non-key) columns */
+	uint8		nkeyfields;
 	OTableIndexField fields[INDEX_MAX_KEYS];
 	uint8		nexprfields;
 	OTableField *exprfields;
@@ -103,6 +105,8 @@ typedef struct
 	bool		has_primary;
 	bool		has_missing;
 	bool		has_default;
+	/* RELPERSISTENCE_* of the relation */
+	char		persistence;
 	OTableIndex *indices;
 	OTableField *fields;
 	AttrMissing *missing;		/* missing attributes values, NULL if none */
@@ -144,6 +148,12 @@ extern void o_tables_drop_columns_by_type(OXid oxid, CommitSeqNo csn, Oid type_o
 /* Adds a new table to o_tables list */
 extern bool o_tables_add(OTable *table, OXid oxid, CommitSeqNo csn);
 
+/* Shared cache of serialized table definitions */
+extern Size o_tables_cache_shmem_needs(void);
+extern void o_tables_cache_shmem_init(Pointer ptr, bool found);
+extern void o_tables_cache_invalidate(ORelOids oids);
+extern void o_tables_cache_invalidate_all(void);
+
 /* Returns OTable by its oids */
 extern OTable *o_tables_get(ORelOids oids);
 
@@ -196,6 +206,10 @@ extern bool o_tables_rel_try_lock_extended(ORelOids *oids, int lockmode, bool *n
 extern void o_tables_rel_lock_extended(ORelOids *oids, int lockmode, bool checkpoint);
 extern void o_tables_rel_unlock_extended(ORelOids *oids, int lockmode, bool checkpoint);
 
+/* Serialize OTable into the O_TABLES sys tree format and back */
+extern Pointer serialize_o_table(OTable *o_table, int *size);
+extern OTable *deserialize_o_table(Pointer data, Size length);
+
 /* Deserialize OTable stored in O_TABLES sys tree */
 extern void o_serialize_node(Node *node, StringInfo str);
 extern Node *o_deserialize_node(Pointer *ptr);
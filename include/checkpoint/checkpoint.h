@@ -18,6 +18,7 @@
 #include "btree/page_contents.h"
 
 #include "access/xlogdefs.h"
+#include "datatype/timestamp.h"
 
 typedef struct
 {
@@ -43,6 +44,7 @@ struct CheckpointFileHeader
 	uint64		datafileLength;
 	uint64		numFreeBlocks;
 	uint32		leafPagesNum;
+	uint64		liveTuplesNum;
 };
 
 typedef enum
@@ -168,6 +170,11 @@ typedef struct
 	pid_t		pid;
 	double		dirtyPagesEstimate;
 	uint64		pagesWritten;
+	/* progress reporting for orioledb_checkpoint_progress() */
+	uint64		bytesWritten;
+	uint64		treesTotal;
+	uint64		treesCompleted;
+	TimestampTz startTimestamp;
 	/* helps to avoid skip a new table for the checkpoint in progress */
 	int			oTablesAddTrancheId;
 	LWLock		oTablesAddLock;
@@ -242,6 +249,8 @@ extern bool tree_is_under_checkpoint(BTreeDescr *desc);
 extern bool get_checkpoint_number(BTreeDescr *desc, OInMemoryBlkno blkno, uint32 *checkpoint_number, bool *copy_blkno);
 extern uint32 get_cur_checkpoint_number(ORelOids *oids, OIndexType type, bool *checkpoint_concurrent);
 extern bool can_use_checkpoint_extents(BTreeDescr *desc, uint32 chkp_num);
+extern bool checkpoint_flush_ahead_pass(int workerId, int workersCount,
+										volatile sig_atomic_t *shutdown_requested);
 extern void free_extent_for_checkpoint(BTreeDescr *desc, FileExtent *extent, uint32 chkp_num);
 extern void backend_set_autonomous_level(CheckpointState *state, uint32 level);
 extern bool tbl_data_exists(ORelOids *oids);
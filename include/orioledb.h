@@ -40,12 +40,44 @@
 #define ORIOLEDB_CUT_FIRST_KEY 1
 /* max a BTree depth */
 #define ORIOLEDB_MAX_DEPTH		32
-/* size of OrioleDB BTree page */
+/*
+ * Size of OrioleDB BTree page.  Can be overridden at build time
+ * (-DORIOLEDB_BLCKSZ=...) to trade lock granularity for sequential scan
+ * throughput; the whole cluster then uses the chosen size, since the page
+ * pool, undo page images and the on-disk format are laid out with it.
+ */
+#ifndef ORIOLEDB_BLCKSZ
 #define ORIOLEDB_BLCKSZ		8192
+#endif
 /* size of on disk compressed page chunk */
 #define ORIOLEDB_COMP_BLCKSZ	512
 /* size of data file segment */
 #define ORIOLEDB_SEGMENT_SIZE	(1024 * 1024 * 1024)
+/* alignment of the page pool: the (2MB) huge page boundary */
+#define ORIOLEDB_BUFFERS_ALIGN	(2 * 1024 * 1024)
+
+/*
+ * The constraints the page layout and I/O paths rely upon:
+ *
+ * - direct I/O buffers are aligned to 4096 bytes, so the page size must be a
+ *   power-of-two multiple of that;
+ * - compressed pages are stored in ORIOLEDB_COMP_BLCKSZ chunks and data file
+ *   segments are cut into whole pages;
+ * - in-page locations are encoded in the 12-bit shortLocation field of
+ *   BTreePageChunkDesc in units of 4 bytes, which caps the page size at 16KB.
+ */
+#if ORIOLEDB_BLCKSZ < 4096 || ORIOLEDB_BLCKSZ > 16384
+#error ORIOLEDB_BLCKSZ must be between 4096 and 16384
+#endif
+#if (ORIOLEDB_BLCKSZ & (ORIOLEDB_BLCKSZ - 1)) != 0
+#error ORIOLEDB_BLCKSZ must be a power of 2
+#endif
+#if ORIOLEDB_BLCKSZ % ORIOLEDB_COMP_BLCKSZ != 0
+#error ORIOLEDB_BLCKSZ must be a multiple of ORIOLEDB_COMP_BLCKSZ
+#endif
+#if ORIOLEDB_SEGMENT_SIZE % ORIOLEDB_BLCKSZ != 0
+#error ORIOLEDB_SEGMENT_SIZE must be a multiple of ORIOLEDB_BLCKSZ
+#endif
 
 #define GetMaxBackends() MaxBackends
 
@@ -177,22 +209,42 @@ extern Size undo_circular_buffer_size;
 extern uint32 undo_buffers_count;
 extern Size xid_circular_buffer_size;
 extern uint32 xid_buffers_count;
+extern Size unique_filter_size;
+extern Size decompress_cache_size;
+extern Size hist_cache_size;
+extern Size table_cache_size;
 extern Pointer o_shared_buffers;
 extern ODBProcData *oProcData;
 extern int	max_procs;
 extern OrioleDBPageDesc *page_descs;
 extern bool remove_old_checkpoint_files;
 extern bool debug_disable_bgwriter;
+extern bool checkpoint_flush_ahead;
+extern double merge_sparse_ratio;
+extern double free_pages_watermark;
+extern bool tinylfu_admission;
+extern bool recovery_prefetch;
+extern bool wal_compression;
+extern int	undo_tuple_cache_size;
+extern int	toast_cache_size;
+extern int	bgwriter_merge_pages;
+extern int	undo_trim_max_files;
+extern int	seq_scan_prefetch_depth;
+extern int	oxid_batch_size;
+extern int	group_commit_delay;
 extern MemoryContext btree_insert_context;
 extern MemoryContext btree_seqscan_context;
 extern double o_checkpoint_completion_ratio;
+extern bool o_checkpoint_adaptive_pacing;
 extern int	max_io_concurrency;
 extern bool use_mmap;
 extern bool use_device;
+extern bool use_direct_io;
 extern int	device_fd;
 extern char *device_filename;
 extern Pointer mmap_data;
 extern Size device_length;
+extern int	device_zone_size_guc;
 extern int	default_compress;
 extern int	default_primary_compress;
 extern int	default_toast_compress;
@@ -244,6 +296,10 @@ typedef struct OPagePool OPagePool;
 struct BTreeDescr;
 
 extern uint64 orioledb_device_alloc(struct BTreeDescr *descr, uint32 size);
+extern bool orioledb_device_zoned(void);
+extern void orioledb_device_zone_free(uint64 offset, uint64 size);
+extern void orioledb_device_zones_save(void);
+extern void orioledb_device_zones_restore(void);
 extern OPagePool *get_ppool(OPagePoolType type);
 extern OPagePool *get_ppool_by_blkno(OInMemoryBlkno blkno);
 extern OInMemoryBlkno get_dirty_pages_count_sum(void);
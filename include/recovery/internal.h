@@ -17,6 +17,8 @@
 
 #include "orioledb.h"
 
+#include "transam/undo.h"
+
 #include "postmaster/bgworker.h"
 
 /*
@@ -28,6 +30,8 @@ extern void recovery_finish_current_oxid(CommitSeqNo csn, XLogRecPtr ptr,
 										 int worker_id, bool sync);
 extern void recovery_savepoint(SubTransactionId parentSubid, int worker_id);
 extern void recovery_rollback_to_savepoint(SubTransactionId parentSubid, int worker_id);
+extern void recovery_apply_branches(OXid oxid, UndoStackLocations undoStack,
+									bool needsWalFlush);
 extern void recovery_finish(int worker_id);
 extern void update_recovery_undo_loc_flush(bool single, int worker_id);
 extern void recovery_on_proc_exit(int code, Datum arg);
@@ -37,7 +41,6 @@ extern uint64 recovery_queue_data_size;
 
 #define GET_WORKER_QUEUE(worker_id) ((void*)(recovery_first_queue \
 										+ recovery_queue_data_size * (worker_id)))
-#define GET_WORKER_ID(hash) ((hash) % recovery_pool_size_guc)
 
 /*
  * Recovery from master to workers messages format.
@@ -54,6 +57,7 @@ extern uint64 recovery_queue_data_size;
 #define RECOVERY_TOAST_CONSISTENT ((uint16) 1 << 10)
 #define RECOVERY_SAVEPOINT ((uint16) 1 << 11)
 #define RECOVERY_ROLLBACK_TO_SAVEPOINT ((uint16) 1 << 12)
+#define RECOVERY_APPLY_BRANCHES ((uint16) 1 << 13)
 #define RECOVERY_MODIFY (RECOVERY_INSERT | RECOVERY_DELETE | RECOVERY_UPDATE)
 #define RECOVERY_QUEUE_BUF_SIZE (8 * 1024)
 
@@ -111,12 +115,22 @@ typedef struct
 	SubTransactionId parentSubId;
 } RecoveryMsgRollbackToSavepoint;
 
+typedef struct
+{
+	RecoveryMsgHeader header;
+	OXid		oxid;
+	UndoStackLocations undoStack;
+	bool		needsWalFlush;
+} RecoveryMsgApplyBranches;
+
 extern bool toast_consistent;
 extern pg_atomic_uint32 *worker_finish_count;
 extern pg_atomic_uint32 *worker_ptrs_changes;
 extern RecoveryWorkerPtrs *worker_ptrs;
 extern pg_atomic_uint64 *recovery_ptr;
 extern pg_atomic_uint64 *recovery_main_retain_ptr;
+extern pg_atomic_uint64 *recovery_queue_consumed;
+extern pg_atomic_uint64 *recovery_queue_added;
 extern bool *recovery_single_process;
 extern RecoveryUndoLocFlush *recovery_undo_loc_flush;
 
@@ -130,9 +144,11 @@ extern void recovery_worker_main(Datum main_arg);
  * Recovery utility.
  */
 extern void apply_modify_record(OTableDescr *descr, OIndexDescr *id,
-								uint16 type, OTuple p, bool must_modify);
+								uint16 type, OTuple p, bool must_modify,
+								BTreeLocationHint *hint);
 extern bool apply_btree_modify_record(BTreeDescr *tree, uint16 type,
-									  OTuple ptr, OXid oxid, CommitSeqNo csn);
+									  OTuple ptr, OXid oxid, CommitSeqNo csn,
+									  BTreeLocationHint *hint);
 
 extern OBTreeModifyCallbackAction recovery_insert_primary_callback(BTreeDescr *descr,
 																   OTuple tup, OTuple *newtup,
@@ -28,6 +28,7 @@
 #define WAL_REC_SAVEPOINT	(9)
 #define WAL_REC_ROLLBACK_TO_SAVEPOINT (10)
 #define WAL_REC_JOINT_COMMIT (11)
+#define WAL_REC_CONTAINER_COMPRESSED (12)
 
 typedef struct
 {
@@ -90,6 +91,17 @@ typedef struct
 	uint8		xmin[sizeof(OXid)];
 } WALRecFinish;
 
+/*
+ * Wraps a whole zstd-compressed WAL container.  Unlike the records above, it
+ * can only appear as the very first byte of a logical message: the reader
+ * decompresses the payload and replays the recovered container as usual.
+ */
+typedef struct
+{
+	uint8		recType;
+	uint8		rawLength[sizeof(uint32)];
+} WALRecContainerCompressed;
+
 #define LOCAL_WAL_BUFFER_SIZE	(8192)
 #define ORIOLEDB_WAL_PREFIX	"o_wal"
 #define ORIOLEDB_WAL_PREFIX_SIZE (5)
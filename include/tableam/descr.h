@@ -46,6 +46,9 @@ typedef struct
 typedef struct OComparator OComparator;
 typedef struct OComparatorKey OComparatorKey;
 
+/* A specialized comparison function for a common built-in key type */
+typedef int (*OFastComparator) (Datum left, Datum right);
+
 /*
  * The index field descriptor
  */
@@ -69,6 +72,15 @@ typedef struct
 	 * and opclass.
 	 */
 	OComparator *comparator;
+
+	/*
+	 * Specialized comparison function selected once at descriptor
+	 * initialization for fields of common built-in types (int4, int8, uuid).
+	 * It spares the comparator dispatch overhead on the hot comparison
+	 * paths.  NULL if no specialized function fits the field, then the
+	 * generic comparator above is used.
+	 */
+	OFastComparator fastCmp;
 } OIndexField;
 
 /*
@@ -118,8 +130,18 @@ struct OIndexDescr
 	 */
 	bool		primaryIsCtid;
 
+	/* RELPERSISTENCE_* of the table the index belongs to */
+	char		tablePersistence;
+
 	/* Description of the index fields */
 	int			nFields;
+
+	/*
+	 * Number of included (non-key) fields.  They are stored in the tail of
+	 * leaf tuples only, so fields[] describes nFields + nIncludedFields leaf
+	 * fields, while non-leaf tuples contain just the first nFields of them.
+	 */
+	int			nIncludedFields;
 	OIndexField fields[INDEX_MAX_KEYS];
 
 	/*
@@ -240,6 +262,8 @@ extern EvictedTreeData *read_evicted_data(ORelOids oids, uint32 chkp_num);
 
 extern void oFillFieldOpClassAndComparator(OIndexField *field, Oid datoid, Oid opclassoid);
 extern void o_finish_sort_support_function(OComparator *comparator, SortSupport ssup);
+extern void o_finish_sort_support_function_abbrev(OComparator *comparator,
+												  SortSupport ssup);
 
 extern void o_add_invalidate_undo_item(ORelOids oids, uint32 flags);
 extern void o_invalidate_undo_item_callback(UndoLocation location,
@@ -18,6 +18,9 @@
 
 #include "access/sdir.h"
 
+/* number of tuples fetched by one o_index_scan_refill_batch() call */
+#define O_INDEX_SCAN_BATCH_SIZE	32
+
 typedef struct OScanState
 {
 	OIndexNumber ixNum;
@@ -36,6 +39,17 @@ typedef struct OScanState
 	/* used only by direct modify functions */
 	CmdType		cmd;
 	CommitSeqNo csn;
+
+	/*
+	 * Batch buffer of fetched tuples: o_exec_fetch() returns them one by one,
+	 * refilling the buffer with o_index_scan_refill_batch() when it runs
+	 * empty.  Tuples in [batchPos, batchCount) are not yet consumed.
+	 */
+	OTuple		batchTuples[O_INDEX_SCAN_BATCH_SIZE];
+	CommitSeqNo batchCsns[O_INDEX_SCAN_BATCH_SIZE];
+	BTreeLocationHint batchHints[O_INDEX_SCAN_BATCH_SIZE];
+	int			batchCount;
+	int			batchPos;
 } OScanState;
 
 /*
@@ -46,11 +60,19 @@ extern void init_index_scan_state(OScanState *ostate, Relation index,
 extern OTuple o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 							  CommitSeqNo csn, CommitSeqNo *tupleCsn,
 							  MemoryContext tupleCxt, BTreeLocationHint *hint);
+extern int	o_iterate_index_batch(OIndexDescr *indexDescr, OScanState *ostate,
+								  CommitSeqNo csn, CommitSeqNo *tupleCsns,
+								  MemoryContext tupleCxt,
+								  BTreeLocationHint *hints,
+								  OTuple *tuples, int max);
 extern OTuple o_index_scan_getnext(OTableDescr *descr, OScanState *ostate,
 								   CommitSeqNo csn,
 								   CommitSeqNo *tupleCsn,
 								   bool scan_primary, MemoryContext tupleCxt,
 								   BTreeLocationHint *hint);
+extern bool o_index_scan_refill_batch(OTableDescr *descr, OScanState *ostate,
+									  CommitSeqNo csn, bool scan_primary,
+									  MemoryContext tupleCxt);
 extern TupleTableSlot *o_exec_fetch(OScanState *ostate, ScanState *ss,
 									CommitSeqNo csn);
 extern bool o_exec_qual(ExprContext *econtext, ExprState *qual,
@@ -83,6 +83,9 @@ typedef struct
 extern void o_tbl_insert(OTableDescr *descr, Relation relation,
 						 EState *estate, TupleTableSlot *slot, OXid oxid,
 						 CommitSeqNo csn);
+extern void o_tbl_multi_insert(OTableDescr *descr, Relation relation,
+							   EState *estate, TupleTableSlot **slots,
+							   int ntuples, OXid oxid, CommitSeqNo csn);
 extern TupleTableSlot *o_tbl_insert_on_conflict(ModifyTableState *mstate,
 												EState *estate,
 												ResultRelInfo *rinfo,
@@ -33,6 +33,10 @@ extern int	o_idx_cmp_value_bounds(OBTreeValueBound *bound1,
 extern int	o_idx_cmp(BTreeDescr *desc,
 					  void *p1, BTreeKeyType keyType1,
 					  void *p2, BTreeKeyType keyType2);
+extern int	o_idx_cmp_prefix(BTreeDescr *desc,
+							 void *p1, BTreeKeyType keyType1,
+							 void *p2, BTreeKeyType keyType2,
+							 int *equalAtts);
 extern int	o_idx_cmp_range_key_to_value(OBTreeValueBound *sk1, OIndexField *field,
 										 Datum value, bool isnull);
 
@@ -56,5 +56,6 @@ extern int	oxid_get_procnum(OXid oxid);
 extern bool xid_is_finished(OXid xid);
 extern bool xid_is_finished_for_everybody(OXid xid);
 extern void fsync_xidmap_range(OXid xmin, OXid xmax, uint32 wait_event_info);
+extern void write_xidsmap_ahead(void);
 
 #endif							/* __OXID_H__ */
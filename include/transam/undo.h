@@ -111,6 +111,7 @@ typedef struct
 {
 	bool		needs_wal_flush;
 	bool		has_retained_undo_location;
+	bool		flush_pending_subxacts;
 	OXid		oxid;
 } OAutonomousTxState;
 
@@ -190,6 +191,8 @@ extern void undo_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 								  SubTransactionId parentSubid, void *arg);
 extern bool have_current_undo(void);
 extern void report_undo_overflow(void);
+extern void apply_undo_item(UndoLocation location, OXid oxid,
+							bool changeCountsValid);
 extern void apply_undo_branches(OXid oxid);
 extern void apply_undo_stack(OXid oxid, UndoStackLocations *toLocation,
 							 bool changeCountsValid);
@@ -43,6 +43,8 @@ typedef struct
 {
 	uint16		natts;
 	uint16		len;
+	/* start offsets of the first natts (fixed-width) attributes */
+	uint16	   *offsets;
 } OTupleFixedFormatSpec;
 
 typedef OTupleHeaderData *OTupleHeader;
@@ -161,6 +163,19 @@ typedef OTupleHeaderData *OTupleHeader;
 	)																\
 )
 
+/* number of attributes physically present in the tuple */
+#define o_tuple_natts(tup, spec)									\
+(																	\
+	((tup).formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT) ?				\
+	(																\
+		(spec)->natts												\
+	)																\
+	:																\
+	(																\
+		((OTupleHeader) (tup).data)->natts							\
+	)																\
+)
+
 #define o_has_nulls(tup)											\
 (																	\
 	((tup).formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT) ?				\
@@ -176,7 +191,12 @@ typedef OTupleHeaderData *OTupleHeader;
 extern void o_tuple_init_reader(OTupleReaderState *state, OTuple tuple,
 								TupleDesc desc, OTupleFixedFormatSpec *spec,
 								ExprState **defvals_exprstate, EState *estate);
+extern void o_tuple_reader_skip_fixed_prefix(OTupleReaderState *state,
+											 OTupleFixedFormatSpec *spec);
 extern Datum o_tuple_read_next_field(OTupleReaderState *state, bool *isnull);
+extern int	o_tuple_deform_fixed(TupleDesc desc, OTupleFixedFormatSpec *spec,
+								 OTuple tuple, int natts,
+								 Datum *values, bool *isnull);
 extern ItemPointer o_tuple_get_last_iptr(TupleDesc desc,
 										 OTupleFixedFormatSpec *spec,
 										 OTuple tuple, bool *isnull);
@@ -196,6 +216,9 @@ extern void o_tuple_fill(TupleDesc tupleDesc, OTupleFixedFormatSpec *spec,
 						 Datum *values, bool *isnull, bool *to_toast);
 extern OTuple o_form_tuple(TupleDesc tupleDesc, OTupleFixedFormatSpec *spec,
 						   uint32 version, Datum *values, bool *isnull);
+extern OTuple o_tuple_make_truncated_key(TupleDesc tupleDesc,
+										 OTupleFixedFormatSpec *spec,
+										 OTuple key, int natts);
 extern uint32 o_tuple_get_version(OTuple tuple);
 extern void o_tuple_set_version(OTupleFixedFormatSpec *spec, OTuple *tuple,
 								uint32 version);
@@ -48,6 +48,13 @@ extern void tts_orioledb_store_tuple(TupleTableSlot *slot, OTuple tuple,
 extern OTuple tts_orioledb_make_secondary_tuple(TupleTableSlot *slot,
 												OIndexDescr *idx,
 												bool leaf);
+extern Pointer tts_orioledb_make_secondary_tuples(TupleTableSlot **slots,
+												  int nslots,
+												  OIndexDescr *idx,
+												  OTuple *tuples);
+extern bool tts_orioledb_included_fields_eq(TupleTableSlot *slot1,
+											TupleTableSlot *slot2,
+											OIndexDescr *idx);
 extern void tts_orioledb_fill_key_bound(TupleTableSlot *slot, OIndexDescr *idx,
 										OBTreeKeyBound *bound);
 extern char *tss_orioledb_print_idx_key(TupleTableSlot *slot, OIndexDescr *id);
@@ -63,6 +70,9 @@ extern bool tts_orioledb_insert_toast_values(TupleTableSlot *slot,
 extern void tts_orioledb_toast_sort_add(TupleTableSlot *slot,
 										OTableDescr *descr,
 										Tuplesortstate *sortstate);
+extern void tts_orioledb_toast_batch_add(TupleTableSlot *slot,
+										 OTableDescr *descr,
+										 struct OToastChunkBatch *batch);
 extern bool tts_orioledb_remove_toast_values(TupleTableSlot *slot,
 											 OTableDescr *descr,
 											 OXid oxid, CommitSeqNo csn);
@@ -19,6 +19,7 @@
 #include "orioledb.h"
 
 #include "btree/iterator.h"
+#include "btree/page_contents.h"
 #include "tableam/descr.h"
 
 /* position after primary ix tuple */
@@ -91,6 +92,30 @@ extern bool generic_toast_insert(ToastAPI *api, void *key, Pointer data,
 extern void generic_toast_sort_add(ToastAPI *api, void *key, Pointer data,
 								   Size data_size, Tuplesortstate *sortstate,
 								   void *arg);
+
+/*
+ * Staged TOAST chunk insertion.  generic_toast_batch_add() chops a value
+ * into chunk tuples the same way generic_toast_sort_add() does, but collects
+ * them into a backend-local array instead of a tuplesort;
+ * generic_toast_batch_insert() then applies the whole array to the TOAST
+ * tree in one pass sharing a single leaf location hint.  As long as values
+ * are staged in key order (e.g. rows sorted by primary key), consecutive
+ * chunks land on the same leaf and the pass costs one descent per touched
+ * leaf instead of one per chunk.
+ */
+typedef struct OToastChunkBatch
+{
+	OTuple	   *chunks;			/* staged chunk tuples, in key order */
+	int			count;
+	int			allocated;
+	MemoryContext mcxt;			/* chunk tuples and the array live here */
+} OToastChunkBatch;
+
+extern void generic_toast_batch_add(ToastAPI *api, void *key, Pointer data,
+									Size data_size, OToastChunkBatch *batch,
+									void *arg);
+extern bool generic_toast_batch_insert(ToastAPI *api, OToastChunkBatch *batch,
+									   OXid oxid, CommitSeqNo csn, void *arg);
 extern bool generic_toast_update(ToastAPI *api, void *key, Pointer data,
 								 Size data_size, OXid oxid, CommitSeqNo csn,
 								 void *arg);
@@ -122,6 +147,50 @@ extern Pointer generic_toast_get_any_with_callback(ToastAPI *api, Pointer key,
 												   Size *data_size, CommitSeqNo csn, void *arg,
 												   TupleFetchCallback fetch_callback, void *callback_arg);
 
+/*
+ * Streaming TOAST reader.  Yields the stored value one chunk at a time
+ * instead of materializing the whole concatenated copy: at most one chunk
+ * tuple is kept allocated, and the pointer returned by
+ * generic_toast_iterator_next() stays valid until the next call on the same
+ * iterator.  The key passed to generic_toast_iterator_init() must stay valid
+ * for the iterator lifetime.
+ */
+typedef struct GenericToastIterator
+{
+	ToastAPI   *api;
+	void	   *key;
+	void	   *arg;
+	BTreeIterator *iterator;
+	OTuple		chunkTuple;		/* chunk currently exposed to the caller */
+	uint32		maxChunkSize;
+	bool		finished;
+} GenericToastIterator;
+
+extern void generic_toast_iterator_init(GenericToastIterator *iter,
+										ToastAPI *api, void *key,
+										CommitSeqNo csn, void *arg);
+extern Pointer generic_toast_iterator_next(GenericToastIterator *iter,
+										   uint32 *chunkSize);
+extern void generic_toast_iterator_free(GenericToastIterator *iter);
+
+/*
+ * Streaming counterpart of o_detoast(): iterates over the stored byte
+ * stream of an orioledb-toasted value.  The stream is the on-disk varlena
+ * image, so it starts with a varlena header and may be compressed;
+ * rawSize/toastedSize mirror the TOAST pointer fields.
+ */
+typedef struct ODetoastIterator
+{
+	GenericToastIterator gen;
+	OToastKey	key;
+	OFixedKey	pk;				/* storage for the primary key part of key */
+	int32		rawSize;
+	int32		toastedSize;
+} ODetoastIterator;
+
+extern ODetoastIterator *o_detoast_iterator_create(struct varlena *attr);
+extern void o_detoast_iterator_free(ODetoastIterator *iter);
+
 /* Copies TupleDescs to toast definition */
 extern void o_toast_init_tupdescs(OIndexDescr *toast, TupleDesc ix_primary);
 
@@ -136,6 +205,13 @@ extern void o_toast_sort_add(OIndexDescr *primary, OIndexDescr *toast,
 							 OTuple pk, uint16 attn,
 							 Pointer data, Size data_size,
 							 Tuplesortstate *sortstate);
+extern void o_toast_batch_add(OIndexDescr *primary, OIndexDescr *toast,
+							  OTuple pk, uint16 attn,
+							  Pointer data, Size data_size,
+							  OToastChunkBatch *batch);
+extern bool o_toast_batch_insert(OIndexDescr *primary, OIndexDescr *toast,
+								 OToastChunkBatch *batch,
+								 OXid oxid, CommitSeqNo csn);
 extern bool o_toast_delete(OIndexDescr *primary, OIndexDescr *toast,
 						   OTuple pk, uint16 attn,
 						   OXid oxid, CommitSeqNo csn);
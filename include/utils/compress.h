@@ -13,9 +13,34 @@
 #ifndef __COMPRESS_H__
 #define __COMPRESS_H__
 
+/*
+ * A zstd dictionary trained on leaf pages of a particular tree.  Opaque for
+ * the callers: holds the digested compression and decompression forms.
+ */
+typedef struct OCompressDict OCompressDict;
+
+/* recommended size of a trained dictionary */
+#define O_COMPRESS_DICT_SIZE	(16 * 1024)
+
 extern void o_compress_init(void);
-extern Pointer o_compress_page(Pointer page, size_t *size, OCompress lvl);
-extern void o_decompress_page(Pointer src, size_t size, Pointer page);
+extern Pointer o_compress_page(Pointer page, size_t *size, OCompress lvl,
+							   OCompressDict *dict);
+extern void o_decompress_page(Pointer src, size_t size, Pointer page,
+							  OCompressDict *dict);
+extern size_t o_compress_wal_container(Pointer data, size_t length,
+									   Pointer dst, size_t dstSize);
+extern void o_decompress_wal_container(Pointer src, size_t size,
+									   Pointer dst, size_t rawLength);
+extern size_t o_compress_bound(size_t size);
+extern size_t o_compress_row_batch(Pointer data, size_t length,
+								   Pointer dst, size_t dstSize,
+								   OCompress lvl);
 extern OCompress o_compress_max_lvl(void);
+extern char *o_compress_dict_filename(ORelOids oids);
+extern OCompressDict *o_compress_dict_load(ORelOids oids, OCompress lvl);
+extern void o_compress_dict_free(OCompressDict *dict);
+extern size_t o_compress_dict_train(Pointer samples, size_t *sampleSizes,
+									unsigned nSamples, Pointer dictBuffer,
+									size_t dictCapacity);
 
 #endif							/* __COMPRESS_H__ */
@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------------
+ *
+ * o_latency.h
+ *		Declarations for latency histograms of btree operations.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/o_latency.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __O_LATENCY_H__
+#define __O_LATENCY_H__
+
+#include "portability/instr_time.h"
+
+/*
+ * Tracked operation types.  The first four mirror BTreeOperationType, so an
+ * action can be converted with a plain cast.
+ */
+typedef enum OLatencyOperation
+{
+	OLatencyInsert,
+	OLatencyLock,
+	OLatencyUpdate,
+	OLatencyDelete,
+	OLatencyFindPage,
+	OLatencyOperationsCount
+} OLatencyOperation;
+
+/*
+ * Histogram buckets cover nanosecond durations with two sub-bucket bits per
+ * power of two, HDR-style: the relative error of a bucket is at most 25%.
+ */
+#define O_LATENCY_SUBBUCKET_BITS	2
+#define O_LATENCY_SUBBUCKETS		(1 << O_LATENCY_SUBBUCKET_BITS)
+#define O_LATENCY_BUCKETS			256
+
+extern bool track_latencies;
+extern Pointer oLatencyCounters;
+
+#define O_LATENCY_TRACKING() (track_latencies && oLatencyCounters != NULL)
+
+extern Size o_latency_shmem_needs(void);
+extern void o_latency_shmem_init(Pointer ptr, bool found);
+extern void o_latency_record(OLatencyOperation op, instr_time start);
+extern void o_latency_merged_histogram(OLatencyOperation op, uint64 *buckets);
+extern double o_latency_bucket_value(int bucket);
+extern const char *o_latency_operation_name(OLatencyOperation op);
+
+#endif							/* __O_LATENCY_H__ */
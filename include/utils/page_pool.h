@@ -37,12 +37,33 @@
 #define PPOOL_RESERVE_MASK_ALL (PPOOL_RESERVE_META_MASK | PPOOL_RESERVE_INSERT_MASK \
 								| PPOOL_RESERVE_FIND_MASK)
 
+/* size of the backend-local magazine of free pages */
+#define PPOOL_MAGAZINE_SIZE	8
+
+/*
+ * Monotonic counters of clock replacement work done on the pool, split by
+ * the initiator: background is the bgwriter workers refilling the pool, the
+ * foreground counters grow when a backend had to run the clock synchronously
+ * because the pool ran dry.  Exposed by orioledb_buffer_stats().
+ */
+typedef struct OPagePoolStatCounters
+{
+	pg_atomic_uint64 evictedForeground;
+	pg_atomic_uint64 evictedBackground;
+	pg_atomic_uint64 writtenForeground;
+	pg_atomic_uint64 writtenBackground;
+} OPagePoolStatCounters;
+
 struct OPagePool
 {
 	/* count of available to reserve pages in the pool */
 	pg_atomic_uint64 *availablePagesCount;
 	/* count of dirty pages in the pool */
 	pg_atomic_uint32 *dirtyPagesCount;
+	/* eviction and write counters, see OPagePoolStatCounters */
+	OPagePoolStatCounters *statCounters;
+	/* adaptive watermark boost in percent, see ppool_adjust_watermarks() */
+	pg_atomic_uint32 *watermarkBoost;
 	/* init position for the ucm */
 	OInMemoryBlkno location;
 	/* offset of the pool in the o_shared_buffers */
@@ -51,6 +72,9 @@ struct OPagePool
 	OInMemoryBlkno size;
 	/* reserved pages count by type array */
 	OInMemoryBlkno numPagesReserved[PPOOL_RESERVE_COUNT];
+	/* backend-local magazine of free pages, hidden from other backends */
+	OInMemoryBlkno freeMagazine[PPOOL_MAGAZINE_SIZE];
+	int			freeMagazineCount;
 	/* usage counter map and their size in shared memory */
 	UsageCountMap ucm;
 	Size		ucmShmemSize;
@@ -62,11 +86,46 @@ struct OPagePool
 #endif
 };
 
+/*
+ * Bounds of the adaptive free pages watermark, in percent of the configured
+ * orioledb.free_pages_watermark.  The boost grows while foreground backends
+ * keep running the clock themselves and decays once the pressure subsides,
+ * so the background writers' effort follows the pool that actually throttles
+ * instead of the static split between the pools.  The watermark is
+ * additionally capped by a quarter of the pool size.
+ */
+#define PPOOL_WATERMARK_BOOST_MIN	100
+#define PPOOL_WATERMARK_BOOST_MAX	400
+#define PPOOL_WATERMARK_BOOST_STEP	50
+#define PPOOL_WATERMARK_BOOST_DECAY	25
+
+/*
+ * The number of immediately allocatable pages the background writers try to
+ * keep available in the pool, so that foreground backends don't run the
+ * clock (and possibly synchronous eviction writes) themselves.
+ */
+static inline OInMemoryBlkno
+ppool_watermark_pages(OPagePool *pool)
+{
+	uint32		boost = PPOOL_WATERMARK_BOOST_MIN;
+	OInMemoryBlkno base,
+				result;
+
+	if (pool->watermarkBoost)
+		boost = pg_atomic_read_u32(pool->watermarkBoost);
+
+	base = (OInMemoryBlkno) (pool->size * free_pages_watermark);
+	result = base * boost / PPOOL_WATERMARK_BOOST_MIN;
+	/* the boost never grows the watermark beyond a quarter of the pool */
+	return Min(result, Max(base, pool->size / 4));
+}
+
 extern Size ppool_estimate_space(OPagePool *pool, OInMemoryBlkno offset, OInMemoryBlkno size, bool debug);
 extern void ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found);
 extern OInMemoryBlkno ppool_free_pages_count(OPagePool *pool);
 extern OInMemoryBlkno ppool_dirty_pages_count(OPagePool *pool);
 extern void ppool_run_clock(OPagePool *pool, bool evict, volatile sig_atomic_t *shutdown_requested);
+extern void ppool_adjust_watermarks(void);
 
 extern void ppool_reserve_pages(OPagePool *pool, int kind, int count);
 extern void ppool_release_reserved(OPagePool *pool, uint32 mask);
@@ -74,6 +133,7 @@ extern void ppool_release_all_pages(void);
 extern OInMemoryBlkno ppool_get_metapage(OPagePool *pool);
 extern OInMemoryBlkno ppool_get_page(OPagePool *pool, int kind);
 extern void ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock);
+extern void ppool_flush_magazine(OPagePool *pool);
 
 #define PAGE_DESC_FLAG_DIRTY			1	/* Modified since the the last
 											 * time being written out */
@@ -85,12 +145,22 @@ extern void ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock
 #define IS_DIRTY_CONCURRENT(blkno) (O_GET_IN_MEMORY_PAGEDESC(blkno)->flags & PAGE_DESC_FLAG_CONCURRENT_DIRTY)
 #define CLEAN_DIRTY_CONCURRENT(blkno) (O_GET_IN_MEMORY_PAGEDESC(blkno)->flags &= ~PAGE_DESC_FLAG_CONCURRENT_DIRTY)
 
-#define MARK_DIRTY(pool, blkno) \
+/*
+ * Dirty pages are counted twice: per-pool counter drives the background
+ * writer, per-tree counter in the tree meta page lets the checkpointer skip
+ * traversal of clean trees.  MARK_DIRTY()/CLEAN_DIRTY() take a tree
+ * descriptor and maintain both counters (BTREE_GET_META() is resolved at the
+ * expansion site).  CLEAN_DIRTY_POOL() only maintains the pool counter: it is
+ * intended for tree destroy paths, where the tree meta page is freed anyway.
+ */
+#define MARK_DIRTY(desc, blkno) \
 	do \
 	{ \
 		if (!IS_DIRTY(blkno)) { \
 			O_GET_IN_MEMORY_PAGEDESC(blkno)->flags |= PAGE_DESC_FLAG_BOTH_DIRTY; \
-			pg_atomic_fetch_add_u32(pool->dirtyPagesCount, 1); \
+			pg_atomic_fetch_add_u32((desc)->ppool->dirtyPagesCount, 1); \
+			if (OMetaPageIsValid(desc)) \
+				pg_atomic_fetch_add_u32(&BTREE_GET_META(desc)->dirtyPagesCount, 1); \
 		} \
 		else if (!IS_DIRTY_CONCURRENT(blkno)) \
 		{ \
@@ -99,16 +169,24 @@ extern void ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock
 	} \
 	while (0); \
 
-#define CLEAN_DIRTY(pool, blkno) \
+#define CLEAN_DIRTY(desc, blkno) \
+	if (IS_DIRTY(blkno)) { \
+		O_GET_IN_MEMORY_PAGEDESC(blkno)->flags &= ~PAGE_DESC_FLAG_BOTH_DIRTY; \
+		pg_atomic_fetch_sub_u32((desc)->ppool->dirtyPagesCount, 1); \
+		if (OMetaPageIsValid(desc)) \
+			pg_atomic_fetch_sub_u32(&BTREE_GET_META(desc)->dirtyPagesCount, 1); \
+	}
+
+#define CLEAN_DIRTY_POOL(pool, blkno) \
 	if (IS_DIRTY(blkno)) { \
 		O_GET_IN_MEMORY_PAGEDESC(blkno)->flags &= ~PAGE_DESC_FLAG_BOTH_DIRTY; \
-		pg_atomic_fetch_sub_u32(pool->dirtyPagesCount, 1); \
+		pg_atomic_fetch_sub_u32((pool)->dirtyPagesCount, 1); \
 	}
 
 #define FREE_PAGE_IF_VALID(pool, blkno) \
 	if (OInMemoryBlknoIsValid((blkno))) \
 	{ \
-		CLEAN_DIRTY((pool), (blkno)); \
+		CLEAN_DIRTY_POOL((pool), (blkno)); \
 		ppool_free_page((pool), (blkno), false); \
 		(blkno) = OInvalidInMemoryBlkno; \
 	} \
@@ -0,0 +1,40 @@
+/*-------------------------------------------------------------------------
+ *
+ * page_waits.h
+ *		Declarations for page lock and I/O wait tracking.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/page_waits.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __PAGE_WAITS_H__
+#define __PAGE_WAITS_H__
+
+/*
+ * Distinct wait sites.  Every sleep of a backend on shared engine state
+ * goes through o_page_wait_start()/o_page_wait_end() with one of these, so
+ * pg_stat_activity shows the backend as waiting (wait event class
+ * "Extension") instead of on CPU, and the site, the blocked page and its
+ * tree are inspectable through orioledb_page_waiters() while the
+ * accumulated counts and times are served by the orioledb_page_waits view.
+ */
+typedef enum OPageWaitSite
+{
+	OPageWaitLock,				/* lock_page() waiters queue */
+	OPageWaitReadEnable,		/* page_wait_for_read_enable() */
+	OPageWaitChangeCount,		/* page_wait_for_changecount() */
+	OPageWaitIOCompletion,		/* wait_for_io_completion() */
+	OPageWaitIOThrottle,		/* io_start() concurrency limit */
+	OPageWaitSeqBufPrevPage,	/* seq_buf_wait_prev_page() */
+	OPageWaitSitesCount
+} OPageWaitSite;
+
+extern Size page_waits_shmem_needs(void);
+extern void page_waits_shmem_init(Pointer ptr, bool found);
+extern void o_page_wait_start(OPageWaitSite site, OInMemoryBlkno blkno);
+extern void o_page_wait_end(void);
+
+#endif							/* __PAGE_WAITS_H__ */
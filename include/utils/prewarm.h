@@ -0,0 +1,21 @@
+/*-------------------------------------------------------------------------
+ *
+ * prewarm.h
+ *		Declarations for page pool prewarming.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/prewarm.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __PREWARM_H__
+#define __PREWARM_H__
+
+extern int	prewarm_interval;
+
+extern void register_prewarm_worker(void);
+extern void prewarm_worker_main(Datum main_arg);
+
+#endif							/* __PREWARM_H__ */
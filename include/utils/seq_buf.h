@@ -33,13 +33,27 @@ typedef struct
 							  (l)->num == (r)->num && \
 							  (l)->type == (r)->type)
 
+/*
+ * Number of in-memory pages per sequential buffer.  Writers use them as a
+ * ring: one page accepts new data, one may be flushed to disk and one more
+ * may be parked full waiting for the flusher, so a producer switching pages
+ * doesn't have to wait for write I/O.  Readers only use the first two pages.
+ */
+#define SEQ_BUF_PAGES 3
+
 typedef struct
 {
 	slock_t		lock;			/* spinlock protecting the fields below */
-	OInMemoryBlkno pages[2];	/* pages with data */
+	OInMemoryBlkno pages[SEQ_BUF_PAGES];	/* pages with data */
 	int			location;
-	int			curPageNum;		/* current page in usage from previous two */
+	int			curPageNum;		/* page of the ring currently in usage */
 	uint32		filePageNum;	/* file page currently loaded */
+	int			flushPageNum;	/* page being flushed while prevPageState is
+								 * in-progress or error */
+	uint32		flushFilePageNum;	/* file page of flushPageNum */
+	int			pendingPageNum; /* full page parked for the flusher, -1 if
+								 * none */
+	uint32		pendingFilePageNum; /* file page of pendingPageNum */
 	off_t		freeBytesNum;	/* how many unread bytes left in a file */
 	off_t		evictOffset;
 	SeqBufTag	tag;
@@ -43,4 +43,34 @@ extern bool check_stopevent(int event_id, Jsonb *params);
 extern void wait_for_stopevent_enabled(int event_id);
 extern void stopevents_make_cxt(void);
 
+/*
+ * Binary tracepoints are the production counterpart of stop events: instead
+ * of building Jsonb parameters and evaluating jsonpath conditions, a
+ * tracepoint appends a fixed-layout record to the per-backend ring buffer in
+ * shared memory.  The buffers are sized by orioledb.tracepoint_buffers and
+ * drained with the orioledb_tracepoints() SQL function.
+ */
+typedef enum OTracepointKind
+{
+	OTRACEPOINT_PAGE_LOCK_WAIT,
+	OTRACEPOINT_PAGE_SPLIT,
+	OTRACEPOINT_PAGE_EVICT,
+	OTRACEPOINT_UNDO_RETENTION_STALL,
+	OTRACEPOINT_COUNT
+} OTracepointKind;
+
+extern Size tracepoint_buffers_size;
+extern Pointer oTracepointBuffers;
+
+#define OTRACEPOINT(kind, arg1, arg2) \
+	do { \
+		if (oTracepointBuffers != NULL) \
+			otracepoint_emit((kind), (uint64) (arg1), (uint64) (arg2)); \
+	} while (0)
+
+extern Size TracepointShmemSize(void);
+extern void TracepointShmemInit(Pointer ptr, bool found);
+extern void otracepoint_emit(OTracepointKind kind, uint64 arg1, uint64 arg2);
+extern Datum orioledb_tracepoints(PG_FUNCTION_ARGS);
+
 #endif							/* __STOPEVENT_H__ */
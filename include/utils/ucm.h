@@ -28,6 +28,11 @@ typedef struct UsageCountMap
 	int			nonLeaf;
 	int			rootFactor;
 	uint32		usageCounter;
+	/* TinyLFU admission sketch, see ucm_admission_usage_count() */
+	uint8	   *sketch;
+	pg_atomic_uint32 *sketchOps;
+	uint64		sketchMask;
+	uint32		sketchSampleSize;
 } UsageCountMap;
 
 extern Size estimate_ucm_space(UsageCountMap *map, OInMemoryBlkno offset, OInMemoryBlkno size);
@@ -38,9 +43,14 @@ extern void page_change_usage_count(UsageCountMap *map, OInMemoryBlkno blkno, ui
 extern bool ucm_check_map(UsageCountMap *map);
 extern bool ucm_epoch_needs_shift(UsageCountMap *map);
 extern void ucm_epoch_shift(UsageCountMap *map);
+extern void ucm_epoch_maintenance(UsageCountMap *map, bool need_eviction);
 extern OInMemoryBlkno ucm_next_blkno(UsageCountMap *map, OInMemoryBlkno init_blkno, uint32 mask_src);
-extern OInMemoryBlkno ucm_occupy_free_page(UsageCountMap *map);
+extern OInMemoryBlkno ucm_occupy_free_page(UsageCountMap *map,
+											OInMemoryBlkno init_blkno);
+extern uint32 ucm_admission_usage_count(UsageCountMap *map, uint64 key);
 extern void set_skip_ucm(void);
 extern void unset_skip_ucm(void);
+extern void set_ucm_scan_hint(void);
+extern void unset_ucm_scan_hint(void);
 
 #endif							/* __UCM_H__ */
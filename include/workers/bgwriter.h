@@ -14,8 +14,12 @@
 #define __BGWRITER_H__
 
 extern bool IsBGWriter;
+extern int	bgwriter_num_workers;
 
-extern void register_bgwriter(void);
+extern Size bgwriter_shmem_needs(void);
+extern void bgwriter_shmem_init(Pointer ptr, bool found);
+extern void bgwriter_wakeup(void);
+extern void register_bgwriter(int num);
 extern void bgwriter_main(Datum main_arg);
 
 #endif							/* __BGWRITER_H__ */
@@ -0,0 +1,35 @@
+/*-------------------------------------------------------------------------
+ *
+ * rollback.h
+ *		Routines for parallel rollback worker processes.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/rollback.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __ROLLBACK_H__
+#define __ROLLBACK_H__
+
+#include "transam/undo.h"
+
+/*
+ * Number of undo items the aborting backend applies itself before launching
+ * the parallel rollback workers.  Keeps small transactions free from the
+ * worker startup overhead.
+ */
+#define PARALLEL_ROLLBACK_MIN_ITEMS	(4096)
+
+extern int	parallel_rollback_workers;
+
+extern bool o_parallel_rollback_active(void);
+extern void o_parallel_rollback_begin(OXid oxid, bool changeCountsValid);
+extern bool o_parallel_rollback_route(UndoLocation location,
+									  UndoStackItem *item);
+extern void o_parallel_rollback_barrier(void);
+extern void o_parallel_rollback_end(void);
+extern void rollback_worker_main(Datum main_arg);
+
+#endif							/* __ROLLBACK_H__ */
@@ -47,6 +47,13 @@ RETURNS bool
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
 
+CREATE FUNCTION orioledb_tbl_structure_check(relid oid,
+											 workers int default 0,
+											 sample_ratio float8 default 1.0)
+RETURNS bool
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
 CREATE FUNCTION orioledb_compression_max_level()
 RETURNS int8
 AS 'MODULE_PATHNAME'
@@ -62,6 +69,11 @@ RETURNS text
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
 
+CREATE FUNCTION orioledb_tbl_compression_dict_train(relid oid, OUT name text, OUT dict_size int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
 CREATE FUNCTION orioledb_tbl_indices(relid oid)
 RETURNS text
 AS 'MODULE_PATHNAME'
@@ -113,11 +125,108 @@ RETURNS SETOF record
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
 
+CREATE FUNCTION orioledb_tbl_export(relid oid,
+									batch_rows int default 1024,
+									compression_level int default 1,
+									OUT batch int8, OUT nrows int4,
+									OUT raw_length int8, OUT data bytea)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_checkpoint_progress(OUT checkpoint_number int8,
+											 OUT in_progress bool,
+											 OUT datoid oid, OUT reloid oid,
+											 OUT relnode oid,
+											 OUT trees_total int8,
+											 OUT trees_completed int8,
+											 OUT pages_written int8,
+											 OUT bytes_written int8,
+											 OUT start_time timestamptz,
+											 OUT write_bandwidth float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW orioledb_checkpoint AS
+  SELECT * FROM orioledb_checkpoint_progress();
+
+CREATE FUNCTION orioledb_recovery_progress(OUT worker_id int4,
+										   OUT queue_added_bytes int8,
+										   OUT queue_consumed_bytes int8,
+										   OUT queue_pending_bytes int8,
+										   OUT commit_lsn pg_lsn,
+										   OUT retain_lsn pg_lsn)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW orioledb_recovery AS
+  SELECT * FROM orioledb_recovery_progress();
+
+CREATE FUNCTION orioledb_buffer_stats(OUT pool_name text, OUT total_pages int8,
+									  OUT busy_pages int8, OUT free_pages int8,
+									  OUT dirty_pages int8,
+									  OUT evicted_foreground int8,
+									  OUT evicted_background int8,
+									  OUT written_foreground int8,
+									  OUT written_background int8,
+									  OUT watermark_pages int8,
+									  OUT usage_histogram int8[])
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
 CREATE FUNCTION orioledb_page_stats(OUT pool_name text, OUT busy_pages int8, OUT free_pages int8, OUT dirty_pages int8, OUT all_pages int8)
 RETURNS SETOF record
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
 
+CREATE FUNCTION orioledb_tree_stat(relid oid, OUT name text, OUT lock_acquires int8, OUT lock_waits int8, OUT splits int8, OUT merges int8, OUT evictions int8, OUT write_bytes_raw int8, OUT write_bytes_compressed int8, OUT read_retries int8, OUT read_lock_fallbacks int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_latency_stats(OUT operation text, OUT count int8,
+									   OUT p50 float8, OUT p99 float8,
+									   OUT p999 float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW orioledb_latency AS
+  SELECT * FROM orioledb_latency_stats();
+
+CREATE FUNCTION orioledb_page_waits_stats(OUT wait_site text, OUT count int8,
+										  OUT total_time_ms float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW orioledb_page_waits AS
+  SELECT * FROM orioledb_page_waits_stats();
+
+CREATE FUNCTION orioledb_undo_retained_size(OUT cause text,
+											OUT retained_bytes int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW orioledb_undo_retained AS
+  SELECT * FROM orioledb_undo_retained_size();
+
+CREATE FUNCTION orioledb_page_waiters(OUT pid int4, OUT wait_site text,
+									  OUT blkno int8, OUT datoid oid,
+									  OUT reloid oid, OUT relnode oid)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_bench_primitive(name text, relid oid, iterations int8)
+RETURNS float8
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
 CREATE FUNCTION orioledb_table_description(relid oid)
 RETURNS text
 AS 'MODULE_PATHNAME'
@@ -177,6 +286,13 @@ RETURNS SETOF record
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
 
+CREATE FUNCTION orioledb_tracepoints(OUT pid int4, OUT pos int8,
+									 OUT time timestamptz, OUT event text,
+									 OUT arg1 int8, OUT arg2 int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
 CREATE FUNCTION orioledb_recovery_synchronized()
 RETURNS boolean
 AS 'MODULE_PATHNAME'
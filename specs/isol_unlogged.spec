@@ -0,0 +1,33 @@
+setup
+{
+	CREATE EXTENSION IF NOT EXISTS orioledb;
+	CREATE UNLOGGED TABLE IF NOT EXISTS o_unlogged_mvcc (
+		id int8 NOT NULL,
+		value int8 NOT NULL,
+		PRIMARY KEY(id)
+	) USING orioledb;
+	TRUNCATE o_unlogged_mvcc;
+	INSERT INTO o_unlogged_mvcc VALUES (1, 1), (2, 2);
+}
+
+teardown
+{
+	DROP TABLE o_unlogged_mvcc;
+}
+
+session "s1"
+
+step "s1_begin" { BEGIN; }
+step "s1_update" { UPDATE o_unlogged_mvcc SET value = 100 WHERE id = 1; }
+step "s1_insert" { INSERT INTO o_unlogged_mvcc VALUES (3, 3); }
+step "s1_commit" { COMMIT; }
+step "s1_rollback" { ROLLBACK; }
+
+session "s2"
+
+step "s2_select" { SELECT * FROM o_unlogged_mvcc ORDER BY id; }
+
+# unlogged tables are shared between backends and fully transactional:
+# concurrent readers see neither uncommitted nor rolled back changes
+permutation "s1_begin" "s1_update" "s2_select" "s1_commit" "s2_select"
+permutation "s1_begin" "s1_insert" "s2_select" "s1_rollback" "s2_select"
@@ -0,0 +1,46 @@
+CREATE EXTENSION orioledb;
+
+-- INCLUDE columns of a secondary index are stored in its leaf tuples and
+-- answered from the secondary tree by index-only scans; uniqueness is
+-- enforced on the key columns only.
+CREATE TABLE o_test_include
+(
+	id int8 NOT NULL,
+	val int8 NOT NULL,
+	payload text NOT NULL,
+	PRIMARY KEY (id)
+) USING orioledb;
+CREATE UNIQUE INDEX o_test_include_ix ON o_test_include (val) INCLUDE (payload);
+
+INSERT INTO o_test_include
+SELECT i, i * 10, 'payload ' || i FROM generate_series(1, 10) AS i;
+ANALYZE o_test_include;
+
+SET enable_seqscan = off;
+
+-- the included column is fetched from the secondary index leaf tuple
+EXPLAIN (COSTS off) SELECT val, payload FROM o_test_include WHERE val = 50;
+SELECT val, payload FROM o_test_include WHERE val = 50;
+EXPLAIN (COSTS off) SELECT val, payload FROM o_test_include WHERE val BETWEEN 30 AND 60;
+SELECT val, payload FROM o_test_include WHERE val BETWEEN 30 AND 60;
+
+-- uniqueness covers the key column only: a duplicated key fails regardless
+-- of the included value ...
+INSERT INTO o_test_include VALUES (11, 50, 'other payload');
+-- ... while a duplicated included value under a new key is fine
+INSERT INTO o_test_include VALUES (11, 110, 'payload 5');
+SELECT val, payload FROM o_test_include WHERE val = 110;
+
+-- an update of only the included column is visible through the index
+UPDATE o_test_include SET payload = 'updated payload' WHERE val = 70;
+SELECT val, payload FROM o_test_include WHERE val = 70;
+
+-- and rolled back like any other change
+BEGIN;
+UPDATE o_test_include SET payload = 'aborted payload' WHERE val = 70;
+SELECT val, payload FROM o_test_include WHERE val = 70;
+ROLLBACK;
+SELECT val, payload FROM o_test_include WHERE val = 70;
+
+RESET enable_seqscan;
+DROP EXTENSION orioledb CASCADE;
@@ -0,0 +1,61 @@
+CREATE EXTENSION orioledb;
+
+-- Chunk and page searches compare 64-bit key abbreviations before falling
+-- back to the full comparator.  Check types with tricky encodings: floats
+-- (sign handling, signed zeros, NaN) and text with long shared prefixes.
+CREATE TABLE o_abbrev_f8
+(
+	key float8 NOT NULL,
+	val int8 NOT NULL,
+	PRIMARY KEY (key)
+) USING orioledb;
+
+INSERT INTO o_abbrev_f8
+SELECT i + 0.5, i FROM generate_series(-500, 500) AS i;
+INSERT INTO o_abbrev_f8 VALUES ('-0'::float8, 1000), ('NaN'::float8, 1001);
+
+-- negative keys
+SELECT val FROM o_abbrev_f8 WHERE key = -123.5;
+-- a signed zero is found under both spellings ...
+SELECT val FROM o_abbrev_f8 WHERE key = '0'::float8;
+SELECT val FROM o_abbrev_f8 WHERE key = '-0'::float8;
+-- ... and stays unique
+INSERT INTO o_abbrev_f8 VALUES ('0'::float8, 1002);
+-- NaN is found and sorts after everything else
+SELECT val FROM o_abbrev_f8 WHERE key = 'NaN'::float8;
+SELECT key FROM o_abbrev_f8 ORDER BY key DESC LIMIT 3;
+SELECT count(*) FROM o_abbrev_f8 WHERE key > -2 AND key < 2;
+
+-- the same around zero for a float4 secondary index
+CREATE TABLE o_abbrev_f4
+(
+	id int8 NOT NULL,
+	key float4 NOT NULL,
+	PRIMARY KEY (id)
+) USING orioledb;
+CREATE UNIQUE INDEX o_abbrev_f4_ix ON o_abbrev_f4 (key);
+
+INSERT INTO o_abbrev_f4
+SELECT i, i * 0.25 FROM generate_series(1, 1000) AS i;
+INSERT INTO o_abbrev_f4 VALUES (1001, '-0'::float4);
+
+SET enable_seqscan = off;
+SELECT id FROM o_abbrev_f4 WHERE key = '0'::float4;
+INSERT INTO o_abbrev_f4 VALUES (1002, '0'::float4);
+RESET enable_seqscan;
+
+-- text keys sharing a prefix longer than the abbreviated chunk
+CREATE TABLE o_abbrev_text
+(
+	key text NOT NULL,
+	PRIMARY KEY (key)
+) USING orioledb;
+
+INSERT INTO o_abbrev_text
+SELECT 'sharedprefix' || lpad(i::text, 6, '0') FROM generate_series(1, 2000) AS i;
+
+SELECT key FROM o_abbrev_text WHERE key = 'sharedprefix001234';
+SELECT count(*) FROM o_abbrev_text
+	WHERE key >= 'sharedprefix000100' AND key < 'sharedprefix000200';
+
+DROP EXTENSION orioledb CASCADE;
@@ -0,0 +1,37 @@
+CREATE EXTENSION orioledb;
+
+-- Inserts probe every unique index before modifying any of them, so a
+-- duplicate in a later index must fail the whole insert without leaving
+-- stray entries in the earlier ones.
+CREATE TABLE o_multi_uniq
+(
+	id int8 NOT NULL,
+	u1 int8 NOT NULL,
+	u2 int8 NOT NULL,
+	PRIMARY KEY (id)
+) USING orioledb;
+CREATE UNIQUE INDEX o_multi_uniq_ix1 ON o_multi_uniq (u1);
+CREATE UNIQUE INDEX o_multi_uniq_ix2 ON o_multi_uniq (u2);
+
+INSERT INTO o_multi_uniq SELECT i, i, i FROM generate_series(1, 1000) AS i;
+
+-- conflict in the first unique index
+INSERT INTO o_multi_uniq VALUES (1001, 500, 2000);
+-- conflict in the second unique index only
+INSERT INTO o_multi_uniq VALUES (1001, 2000, 500);
+-- conflict in the primary key
+INSERT INTO o_multi_uniq VALUES (500, 2000, 2000);
+
+-- the failed inserts left nothing behind, the values are still free
+INSERT INTO o_multi_uniq VALUES (1001, 2000, 2000);
+SELECT count(*) FROM o_multi_uniq;
+SELECT * FROM o_multi_uniq WHERE u1 = 2000;
+SELECT * FROM o_multi_uniq WHERE u2 = 2000;
+
+-- a multi-row insert failing halfway is rolled back entirely
+INSERT INTO o_multi_uniq
+	SELECT i, i, i FROM generate_series(1002, 1010) AS i
+	UNION ALL SELECT 1011, 1, 1;
+SELECT count(*) FROM o_multi_uniq;
+
+DROP EXTENSION orioledb CASCADE;
@@ -0,0 +1,38 @@
+CREATE EXTENSION orioledb;
+
+-- Parallel workers claim disjoint keyranges of the scanned tree through a
+-- shared watermark; the combined result must match the serial scan exactly.
+CREATE TABLE o_par_scan
+(
+	id int8 NOT NULL,
+	value int8 NOT NULL,
+	PRIMARY KEY (id)
+) USING orioledb;
+
+INSERT INTO o_par_scan SELECT i, i % 100 FROM generate_series(1, 100000) AS i;
+ANALYZE o_par_scan;
+
+-- serial baseline
+SET max_parallel_workers_per_gather = 0;
+SELECT count(*), sum(id), sum(value) FROM o_par_scan;
+SELECT count(*) FROM o_par_scan WHERE value = 7;
+
+-- force a parallel plan
+SET min_parallel_table_scan_size = 0;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET max_parallel_workers_per_gather = 2;
+EXPLAIN (COSTS off) SELECT count(*), sum(id), sum(value) FROM o_par_scan;
+
+-- every row is scanned exactly once
+SELECT count(*), sum(id), sum(value) FROM o_par_scan;
+SELECT count(*) FROM o_par_scan WHERE value = 7;
+
+-- rows are streamed through the workers, not just partial aggregates
+SELECT * FROM o_par_scan WHERE id % 10000 = 0 ORDER BY id;
+
+RESET max_parallel_workers_per_gather;
+RESET parallel_tuple_cost;
+RESET parallel_setup_cost;
+RESET min_parallel_table_scan_size;
+DROP EXTENSION orioledb CASCADE;
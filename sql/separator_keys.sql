@@ -0,0 +1,34 @@
+CREATE EXTENSION orioledb;
+
+-- Separator keys of leaf splits are truncated to the shortest distinct
+-- attribute prefix.  Fill a tree whose keys share long common prefixes so
+-- that most separators are truncated, then check that descents, range
+-- scans and structure dumps still behave.
+CREATE TABLE o_trunc
+(
+	key1 text NOT NULL,
+	key2 text NOT NULL,
+	key3 int8 NOT NULL,
+	PRIMARY KEY (key1, key2, key3)
+) USING orioledb;
+
+INSERT INTO o_trunc
+SELECT 'common prefix ' || (i / 1000), 'value ' || (i / 100), i
+FROM generate_series(1, 5000) AS i;
+
+SELECT count(*) FROM o_trunc;
+SELECT count(*) FROM o_trunc WHERE key1 = 'common prefix 2';
+SELECT key1, key2, key3 FROM o_trunc
+	WHERE key1 = 'common prefix 1' AND key2 = 'value 12'
+	ORDER BY key3 LIMIT 5;
+SELECT count(*) FROM o_trunc
+	WHERE key1 >= 'common prefix 3' AND key1 < 'common prefix 4';
+
+-- the page structure of a tree with truncated separators is printable
+SELECT length(orioledb_tbl_structure('o_trunc'::regclass, 'ne')) > 0;
+
+DELETE FROM o_trunc WHERE key3 % 2 = 0;
+SELECT count(*) FROM o_trunc;
+SELECT count(*) FROM o_trunc WHERE key1 = 'common prefix 2';
+
+DROP EXTENSION orioledb CASCADE;
@@ -0,0 +1,52 @@
+CREATE EXTENSION orioledb;
+
+-- Temporary and unlogged orioledb tables skip WAL, but stay fully
+-- transactional: rollbacks and savepoints behave as for permanent tables.
+CREATE TEMP TABLE o_tmp
+(
+	id int8 NOT NULL,
+	val text,
+	PRIMARY KEY (id)
+) USING orioledb;
+
+INSERT INTO o_tmp SELECT i, 'val ' || i FROM generate_series(1, 100) AS i;
+SELECT count(*) FROM o_tmp;
+
+BEGIN;
+INSERT INTO o_tmp SELECT i, 'val ' || i FROM generate_series(101, 200) AS i;
+SELECT count(*) FROM o_tmp;
+ROLLBACK;
+SELECT count(*) FROM o_tmp;
+
+BEGIN;
+UPDATE o_tmp SET val = 'updated' WHERE id <= 50;
+SAVEPOINT s1;
+DELETE FROM o_tmp WHERE id > 50;
+SELECT count(*) FROM o_tmp;
+ROLLBACK TO SAVEPOINT s1;
+COMMIT;
+SELECT count(*) FROM o_tmp;
+SELECT count(*) FROM o_tmp WHERE val = 'updated';
+
+CREATE UNLOGGED TABLE o_unlogged
+(
+	id int8 NOT NULL,
+	val text,
+	PRIMARY KEY (id)
+) USING orioledb;
+
+INSERT INTO o_unlogged SELECT i, 'val ' || i FROM generate_series(1, 100) AS i;
+
+BEGIN;
+UPDATE o_unlogged SET val = 'updated' WHERE id <= 50;
+SAVEPOINT s1;
+DELETE FROM o_unlogged WHERE id > 50;
+SELECT count(*) FROM o_unlogged;
+ROLLBACK TO SAVEPOINT s1;
+ROLLBACK;
+SELECT count(*) FROM o_unlogged;
+SELECT count(*) FROM o_unlogged WHERE val = 'updated';
+
+DROP TABLE o_tmp;
+DROP TABLE o_unlogged;
+DROP EXTENSION orioledb CASCADE;
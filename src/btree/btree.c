@@ -53,7 +53,7 @@ o_btree_init(BTreeDescr *desc)
 	init_page_first_chunk(desc, O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno), 0);
 	unlock_page(desc->rootInfo.rootPageBlkno);
 	init_meta_page(desc->rootInfo.metaPageBlkno, 1);
-	MARK_DIRTY(desc->ppool, desc->rootInfo.rootPageBlkno);
+	MARK_DIRTY(desc, desc->rootInfo.rootPageBlkno);
 }
 
 static bool
@@ -172,7 +172,7 @@ free_page(OPagePool *pool, OInMemoryBlkno blkno, uint32 pageChangeCount)
 	Assert(O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(blkno)) == pageChangeCount);
 	Assert(O_GET_IN_MEMORY_PAGEDESC(blkno)->ionum < 0);
 	page_block_reads(blkno);
-	CLEAN_DIRTY(pool, blkno);
+	CLEAN_DIRTY_POOL(pool, blkno);
 	ppool_free_page(pool, blkno, true);
 
 }
@@ -185,7 +185,7 @@ free_meta_page(OPagePool *pool, OInMemoryBlkno metaPageBlkno)
 				j;
 
 	meta_page = (BTreeMetaPage *) O_GET_IN_MEMORY_PAGE(metaPageBlkno);
-	for (i = 0; i < 2; i++)
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
 	{
 		FREE_PAGE_IF_VALID(pool, meta_page->freeBuf.pages[i]);
 		for (j = 0; j < 2; j++)
@@ -79,7 +79,8 @@ stack_page_split(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 	offset = BTREE_PAGE_LOCATOR_GET_OFFSET(img, &stack[level].loc);
 	left_count = btree_page_split_location(desc, img, offset,
 										   tuplesize, tuple, false, offset,
-										   0.9, NULL, COMMITSEQNO_INPROGRESS);
+										   0.9, NULL, NULL,
+										   COMMITSEQNO_INPROGRESS);
 
 
 	/* Distribute the tuples according the the split location */
@@ -218,6 +219,7 @@ put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 		new_page_header->undoLocation = InvalidUndoLocation;
 		new_page_header->checkpointNum = 0;
 		new_page_header->prevInsertOffset = MaxOffsetNumber;
+		new_page_header->insertPattern = 0;
 
 		new_page_header->flags = O_BTREE_FLAG_RIGHTMOST;
 
@@ -233,6 +235,7 @@ put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 		header->undoLocation = InvalidUndoLocation;
 		header->checkpointNum = 0;
 		header->prevInsertOffset = MaxOffsetNumber;
+		header->insertPattern = 0;
 
 		header->flags &= ~O_BTREE_FLAG_RIGHTMOST;
 
@@ -323,55 +326,111 @@ put_tuple_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack,
 							 sizeof(leaf_header), root_level, metaPageBlkno);
 }
 
-void
-btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
-					   Tuplesortstate *sortstate, uint64 ctid,
-					   CheckpointFileHeader *file_header)
+struct BTreeBulkLoadState
 {
-	OTuple		idx_tup;
+	BTreeDescr *desc;
 	OIndexBuildStackItem *stack;
-	int			root_level = 0,
-				saved_root_level;
-	Page		root_page;
-	uint64		downlink;
-	BTreePageHeader *root_page_header;
-	FileExtent	extent;
-	BTreeMetaPage metaPageBlkno = {0};
+	BTreeMetaPage metaPage;
+	int			root_level;
+	bool		validateOrder;
+	bool		haveLastKey;
+	OFixedKey	lastKey;
+};
+
+/*
+ * Begins a bottom-up bulk load of the tree from an ordered tuple stream.
+ *
+ * The caller feeds tuples in ascending key order through
+ * btree_bulk_load_add_tuple() and finalizes the tree with
+ * btree_bulk_load_finish().  With 'validateOrder' the order of the incoming
+ * stream is checked at the cost of a key comparison per tuple: presorted
+ * external data isn't trustworthy the way a tuplesort result is.
+ */
+BTreeBulkLoadState *
+btree_bulk_load_begin(BTreeDescr *desc, uint64 ctid, bool validateOrder)
+{
+	BTreeBulkLoadState *state;
 	int			i;
-	Datum	   *values;
-	bool	   *isnull;
 
 	btree_open_smgr(desc);
 
-	stack = (OIndexBuildStackItem *) palloc0(sizeof(OIndexBuildStackItem) * ORIOLEDB_MAX_DEPTH);
-	values = (Datum *) palloc(sizeof(Datum) * tupdesc->natts);
-	isnull = (bool *) palloc(sizeof(bool) * tupdesc->natts);
-
-	pg_atomic_init_u64(&metaPageBlkno.datafileLength, 0);
-	pg_atomic_init_u64(&metaPageBlkno.numFreeBlocks, 0);
-	pg_atomic_init_u32(&metaPageBlkno.leafPagesNum, 0);
-	pg_atomic_init_u64(&metaPageBlkno.ctid, ctid);
+	state = (BTreeBulkLoadState *) palloc0(sizeof(BTreeBulkLoadState));
+	state->desc = desc;
+	state->stack = (OIndexBuildStackItem *) palloc0(sizeof(OIndexBuildStackItem) * ORIOLEDB_MAX_DEPTH);
+	state->root_level = 0;
+	state->validateOrder = validateOrder;
+	state->haveLastKey = false;
+	clear_fixed_key(&state->lastKey);
+
+	pg_atomic_init_u64(&state->metaPage.datafileLength, 0);
+	pg_atomic_init_u64(&state->metaPage.numFreeBlocks, 0);
+	pg_atomic_init_u32(&state->metaPage.leafPagesNum, 0);
+	pg_atomic_init_u64(&state->metaPage.liveTuplesNum, 0);
+	pg_atomic_init_u64(&state->metaPage.ctid, ctid);
 	for (i = 0; i < ORIOLEDB_MAX_DEPTH; i++)
 	{
 		/* init_page_first_chunk() needs leaf flag to be set */
 		if (i == 0)
-			((BTreePageHeader *) stack[i].img)->flags = O_BTREE_FLAG_LEAF;
-		init_page_first_chunk(desc, stack[i].img, 0);
-		BTREE_PAGE_LOCATOR_FIRST(stack[i].img, &stack[i].loc);
+			((BTreePageHeader *) state->stack[i].img)->flags = O_BTREE_FLAG_LEAF;
+		init_page_first_chunk(desc, state->stack[i].img, 0);
+		BTREE_PAGE_LOCATOR_FIRST(state->stack[i].img, &state->stack[i].loc);
 	}
 
-	idx_tup = tuplesort_getotuple(sortstate, true);
-	while (!O_TUPLE_IS_NULL(idx_tup))
+	return state;
+}
+
+/*
+ * Appends the next tuple of the ordered stream to the tree being built.
+ */
+void
+btree_bulk_load_add_tuple(BTreeBulkLoadState *state, OTuple tuple)
+{
+	BTreeDescr *desc = state->desc;
+
+	Assert(o_tuple_size(tuple, &((OIndexDescr *) desc->arg)->leafSpec) <= O_BTREE_MAX_TUPLE_SIZE);
+
+	if (state->validateOrder)
 	{
-		Assert(o_tuple_size(idx_tup, &((OIndexDescr *) desc->arg)->leafSpec) <= O_BTREE_MAX_TUPLE_SIZE);
-		put_tuple_to_stack(desc, stack, idx_tup, &root_level, &metaPageBlkno);
-		idx_tup = tuplesort_getotuple(sortstate, true);
+		OTuple		key;
+		bool		allocated;
+
+		key = o_btree_tuple_make_key(desc, tuple, NULL, false, &allocated);
+		if (state->haveLastKey &&
+			o_btree_cmp(desc,
+						&state->lastKey.tuple, BTreeKeyNonLeafKey,
+						&key, BTreeKeyNonLeafKey) >= 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("bulk load input is not in ascending key order")));
+		copy_fixed_key(desc, &state->lastKey, key);
+		state->haveLastKey = true;
+		if (allocated)
+			pfree(key.data);
 	}
 
-	pfree(values);
-	pfree(isnull);
+	put_tuple_to_stack(desc, state->stack, tuple, &state->root_level,
+					   &state->metaPage);
+	pg_atomic_fetch_add_u64(&state->metaPage.liveTuplesNum, 1);
+}
+
+/*
+ * Finishes the bulk load: flushes the right spine, writes the root page and
+ * fills the file header of the tree.
+ */
+void
+btree_bulk_load_finish(BTreeBulkLoadState *state,
+					   CheckpointFileHeader *file_header)
+{
+	BTreeDescr *desc = state->desc;
+	OIndexBuildStackItem *stack = state->stack;
+	Page		root_page;
+	BTreePageHeader *root_page_header;
+	uint64		downlink;
+	FileExtent	extent;
+	int			saved_root_level,
+				i;
 
-	saved_root_level = root_level;
+	saved_root_level = state->root_level;
 	for (i = 0; i < saved_root_level; i++)
 	{
 		FileExtent	extent;
@@ -385,30 +444,31 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 		VALGRIND_CHECK_MEM_IS_DEFINED(stack[i].img, ORIOLEDB_BLCKSZ);
 
 		split_page_by_chunks(desc, stack[i].img);
-		downlink = perform_page_io_build(desc, stack[i].img, &extent, &metaPageBlkno);
+		downlink = perform_page_io_build(desc, stack[i].img, &extent, &state->metaPage);
 		if (i == 0)
-			pg_atomic_add_fetch_u32(&metaPageBlkno.leafPagesNum, 1);
+			pg_atomic_add_fetch_u32(&state->metaPage.leafPagesNum, 1);
 
 		put_downlink_to_stack(desc, stack, i + 1, downlink,
 							  stack[i].key.tuple, stack[i].keysize,
-							  &root_level, &metaPageBlkno);
+							  &state->root_level, &state->metaPage);
 	}
 
-	root_page = stack[root_level].img;
+	root_page = stack[state->root_level].img;
 
 	root_page_header = (BTreePageHeader *) root_page;
-	if (root_level == 0)
+	if (state->root_level == 0)
 		root_page_header->flags = O_BTREE_FLAGS_ROOT_INIT;
 	root_page_header->rightLink = InvalidRightLink;
 	root_page_header->csn = COMMITSEQNO_FROZEN;
 	root_page_header->undoLocation = InvalidUndoLocation;
 	root_page_header->checkpointNum = 0;
 	root_page_header->prevInsertOffset = MaxOffsetNumber;
+	root_page_header->insertPattern = 0;
 
 	if (!O_PAGE_IS(root_page, LEAF))
 	{
 		PAGE_SET_N_ONDISK(root_page, BTREE_PAGE_ITEMS_COUNT(root_page));
-		PAGE_SET_LEVEL(root_page, root_level);
+		PAGE_SET_LEVEL(root_page, state->root_level);
 	}
 
 	extent.len = InvalidFileExtentLen;
@@ -417,19 +477,43 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 	VALGRIND_CHECK_MEM_IS_DEFINED(root_page, ORIOLEDB_BLCKSZ);
 
 	split_page_by_chunks(desc, root_page);
-	downlink = perform_page_io_build(desc, root_page, &extent, &metaPageBlkno);
-	if (root_level == 0)
-		pg_atomic_add_fetch_u32(&metaPageBlkno.leafPagesNum, 1);
+	downlink = perform_page_io_build(desc, root_page, &extent, &state->metaPage);
+	if (state->root_level == 0)
+		pg_atomic_add_fetch_u32(&state->metaPage.leafPagesNum, 1);
 
 	btree_close_smgr(desc);
-	pfree(stack);
 
 	memset(file_header, 0, sizeof(*file_header));
 	file_header->rootDownlink = downlink;
-	file_header->datafileLength = pg_atomic_read_u64(&metaPageBlkno.datafileLength);
-	file_header->numFreeBlocks = pg_atomic_read_u64(&metaPageBlkno.numFreeBlocks);
-	file_header->leafPagesNum = pg_atomic_read_u32(&metaPageBlkno.leafPagesNum);
-	file_header->ctid = pg_atomic_read_u64(&metaPageBlkno.ctid);
+	file_header->datafileLength = pg_atomic_read_u64(&state->metaPage.datafileLength);
+	file_header->numFreeBlocks = pg_atomic_read_u64(&state->metaPage.numFreeBlocks);
+	file_header->leafPagesNum = pg_atomic_read_u32(&state->metaPage.leafPagesNum);
+	file_header->liveTuplesNum = pg_atomic_read_u64(&state->metaPage.liveTuplesNum);
+	file_header->ctid = pg_atomic_read_u64(&state->metaPage.ctid);
+
+	pfree(stack);
+	pfree(state);
+}
+
+void
+btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
+					   Tuplesortstate *sortstate, uint64 ctid,
+					   CheckpointFileHeader *file_header)
+{
+	BTreeBulkLoadState *state;
+	OTuple		idx_tup;
+
+	/* the tuplesort result is known to be ordered, don't recheck it */
+	state = btree_bulk_load_begin(desc, ctid, false);
+
+	idx_tup = tuplesort_getotuple(sortstate, true);
+	while (!O_TUPLE_IS_NULL(idx_tup))
+	{
+		btree_bulk_load_add_tuple(state, idx_tup);
+		idx_tup = tuplesort_getotuple(sortstate, true);
+	}
+
+	btree_bulk_load_finish(state, file_header);
 }
 
 void
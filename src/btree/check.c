@@ -27,7 +27,9 @@
 #include "utils/ucm.h"
 
 #include "pgstat.h"
+#include "access/parallel.h"
 #include "access/transam.h"
+#include "utils/sampling.h"
 
 /*
  * Dynamic array of file extents.
@@ -622,7 +624,8 @@ btree_check_compression_recursive(BTreeDescr *desc, BTreeCompressStats *stats, O
 
 	PG_TRY();
 	{
-		o_compress_page(buf, &compressed_size, lvl);
+		/* measures plain per-level compression, dictionaries aside */
+		o_compress_page(buf, &compressed_size, lvl, NULL);
 
 		stats->totalSize += ORIOLEDB_BLCKSZ;
 		stats->totalCompressedSize += compressed_size;
@@ -672,3 +675,448 @@ check_btree_compression(BTreeDescr *desc, BTreeCompressStats *stats, OCompress l
 
 	o_tables_rel_unlock_extended(&desc->oids, AccessShareLock, recovery);
 }
+
+/* number of leaf pages sampled for dictionary training */
+#define DICT_TRAIN_MAX_SAMPLES	256
+/* zstd recommends much more input than the target dictionary size */
+#define DICT_TRAIN_MIN_SAMPLES	8
+
+typedef struct
+{
+	Pointer		samples;
+	size_t		sampleSizes[DICT_TRAIN_MAX_SAMPLES];
+	int			nSamples;
+} BTreeDictTrainState;
+
+static void
+btree_collect_dict_samples_recursive(BTreeDescr *desc,
+									 BTreeDictTrainState *state,
+									 OBTreeFindPageContext *context,
+									 OInMemoryBlkno blkno)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
+
+	if (state->nSamples >= DICT_TRAIN_MAX_SAMPLES)
+		return;
+
+	page_inc_usage_count(&desc->ppool->ucm, blkno,
+						 pg_atomic_read_u32(&header->usageCount), false);
+
+	context->index++;
+	context->items[context->index].blkno = blkno;
+	context->items[context->index].pageChangeCount = O_PAGE_GET_CHANGE_COUNT(p);
+
+	if (!O_PAGE_IS(p, LEAF))
+	{
+		BTreePageItemLocator loc;
+
+		BTREE_PAGE_LOCATOR_FIRST(p, &loc);
+		while (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc) &&
+			   state->nSamples < DICT_TRAIN_MAX_SAMPLES)
+		{
+			Pointer		ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+			BTreeNonLeafTuphdr *tuphdr = (BTreeNonLeafTuphdr *) ptr;
+
+			if (DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+			{
+				btree_collect_dict_samples_recursive(desc, state, context,
+													 DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink));
+			}
+			else if (DOWNLINK_IS_IN_IO(tuphdr->downlink))
+			{
+				wait_for_io_completion(DOWNLINK_GET_IO_LOCKNUM(tuphdr->downlink));
+				continue;
+			}
+			else if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+			{
+				context->items[context->index].locator = loc;
+				lock_page(blkno);
+				load_page(context);
+				unlock_page(blkno);
+				continue;
+			}
+			BTREE_PAGE_LOCATOR_NEXT(p, &loc);
+		}
+	}
+	else
+	{
+		Pointer		sample;
+
+		sample = state->samples + (size_t) state->nSamples * ORIOLEDB_BLCKSZ;
+		memcpy(sample, p, ORIOLEDB_BLCKSZ);
+		null_unused_bytes(sample);
+		state->sampleSizes[state->nSamples] = ORIOLEDB_BLCKSZ;
+		state->nSamples++;
+	}
+
+	context->index--;
+}
+
+/*
+ * Trains a compression dictionary from leaf pages of the tree.  Returns the
+ * size of the dictionary written to dictBuffer.
+ */
+size_t
+train_btree_compression_dict(BTreeDescr *desc, Pointer dictBuffer,
+							 size_t dictCapacity)
+{
+	OBTreeFindPageContext context;
+	BTreeDictTrainState state;
+	bool		recovery = is_recovery_in_progress();
+	size_t		result;
+
+	state.samples = palloc((size_t) DICT_TRAIN_MAX_SAMPLES * ORIOLEDB_BLCKSZ);
+	state.nSamples = 0;
+
+	o_tables_rel_lock_extended(&desc->oids, AccessShareLock, recovery);
+	o_btree_load_shmem(desc);
+	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS, BTREE_PAGE_FIND_MODIFY);
+
+	btree_collect_dict_samples_recursive(desc, &state, &context,
+										 desc->rootInfo.rootPageBlkno);
+
+	o_tables_rel_unlock_extended(&desc->oids, AccessShareLock, recovery);
+
+	if (state.nSamples < DICT_TRAIN_MIN_SAMPLES)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("tree (%u, %u, %u) has too few leaf pages to train a compression dictionary",
+						desc->oids.datoid, desc->oids.reloid,
+						desc->oids.relnode),
+				 errdetail("At least %d leaf pages are required, %d found.",
+						   DICT_TRAIN_MIN_SAMPLES, state.nSamples)));
+
+	result = o_compress_dict_train(state.samples, state.sampleSizes,
+								   state.nSamples, dictBuffer, dictCapacity);
+	pfree(state.samples);
+
+	return result;
+}
+
+/*
+ * Parallel structural check.
+ *
+ * Verifies page-level invariants of the tree: no broken splits, items sorted
+ * within each page and the last item not above the page hikey.  Level 1
+ * subtrees are the parallelism unit: every participant walks the internal
+ * skeleton of the tree, but each level 1 subtree is descended into by exactly
+ * one participant, claimed through a shared counter.  The order of level 1
+ * pages is the same for all participants because the caller holds a lock
+ * preventing concurrent modification of the tree.
+ *
+ * The extents cross-check of check_btree() stays serial: it needs a single
+ * busy extents array for the whole tree and is not the bottleneck.
+ */
+#define O_PARALLEL_KEY_STRUCT_CHECK		UINT64CONST(0xB000000000000004)
+
+typedef struct OBTreeStructCheckShared
+{
+	ORelOids	oids;
+	OIndexType	type;
+	double		sampleRatio;
+	pg_atomic_uint64 subtreeCounter;
+	pg_atomic_uint32 hasError;
+} OBTreeStructCheckShared;
+
+typedef struct
+{
+	BTreeDescr *desc;
+	/* NULL for the serial check */
+	OBTreeStructCheckShared *shared;
+	/* number of level 1 pages seen so far by this participant */
+	uint64		subtreeIndex;
+	/* index of the next level 1 subtree this participant processes */
+	uint64		nextClaim;
+	double		sampleRatio;
+	bool		hasError;
+	OBTreeFindPageContext context;
+#if PG_VERSION_NUM >= 150000
+	pg_prng_state randstate;
+#else
+	SamplerRandomState randstate;
+#endif
+} OBTreeStructCheckState;
+
+/*
+ * Checks invariants of a single page.  The caller holds the page lock.
+ */
+static void
+struct_check_page(OBTreeStructCheckState *state, Page p)
+{
+	BTreeDescr *desc = state->desc;
+	BTreePageItemLocator loc;
+	BTreeKeyType kind;
+	OTuple		prev,
+				cur;
+	bool		havePrev = false;
+
+	if (O_PAGE_IS(p, BROKEN_SPLIT))
+	{
+		elog(NOTICE, "BTree has a broken split.");
+		state->hasError = true;
+	}
+
+	kind = O_PAGE_IS(p, LEAF) ? BTreeKeyLeafTuple : BTreeKeyNonLeafKey;
+
+	BTREE_PAGE_LOCATOR_FIRST(p, &loc);
+	while (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
+	{
+		if (O_PAGE_IS(p, LEAF))
+		{
+			BTreeLeafTuphdr *tuphdr;
+
+			BTREE_PAGE_READ_LEAF_ITEM(tuphdr, cur, p, &loc);
+		}
+		else
+		{
+			/* the first downlink of an internal page has no key */
+			if (BTREE_PAGE_LOCATOR_GET_OFFSET(p, &loc) == 0)
+			{
+				BTREE_PAGE_LOCATOR_NEXT(p, &loc);
+				continue;
+			}
+			BTREE_PAGE_READ_INTERNAL_TUPLE(cur, p, &loc);
+		}
+
+		if (havePrev && o_btree_cmp(desc, &prev, kind, &cur, kind) >= 0)
+		{
+			elog(NOTICE, "Page items have wrong sort order at offset %u",
+				 BTREE_PAGE_LOCATOR_GET_OFFSET(p, &loc));
+			state->hasError = true;
+		}
+		prev = cur;
+		havePrev = true;
+		BTREE_PAGE_LOCATOR_NEXT(p, &loc);
+	}
+
+	if (havePrev && !O_PAGE_IS(p, RIGHTMOST))
+	{
+		OTuple		hikey;
+
+		BTREE_PAGE_GET_HIKEY(hikey, p);
+		if (o_btree_cmp(desc, &prev, kind, &hikey, BTreeKeyNonLeafKey) > 0)
+		{
+			elog(NOTICE, "Last page item is above the page hikey");
+			state->hasError = true;
+		}
+	}
+}
+
+/*
+ * Walks the tree with the same lock coupling as check_walk_btree().
+ */
+static void
+struct_check_walk(OBTreeStructCheckState *state, OInMemoryBlkno blkno,
+				  OInMemoryBlkno parentPagenum)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	OBTreeFindPageContext *context = &state->context;
+	int			level;
+	bool		claimed = true;
+
+	Assert(OInMemoryBlknoIsValid(blkno));
+
+	lock_page(blkno);
+	if (OInMemoryBlknoIsValid(parentPagenum))
+		unlock_page(parentPagenum);
+
+	context->index++;
+	context->items[context->index].blkno = blkno;
+	context->items[context->index].pageChangeCount = O_PAGE_GET_CHANGE_COUNT(p);
+
+	level = PAGE_GET_LEVEL(p);
+
+	/*
+	 * Pages above level 1 are few: they are checked redundantly by every
+	 * participant, which keeps the claiming logic trivial.
+	 */
+	if (state->shared != NULL && level == 1)
+	{
+		claimed = (state->subtreeIndex == state->nextClaim);
+		if (claimed)
+			state->nextClaim =
+				pg_atomic_fetch_add_u64(&state->shared->subtreeCounter, 1);
+		state->subtreeIndex++;
+	}
+
+	if (claimed)
+	{
+		struct_check_page(state, p);
+
+		if (!O_PAGE_IS(p, LEAF))
+		{
+			BTreePageItemLocator loc;
+
+			BTREE_PAGE_LOCATOR_FIRST(p, &loc);
+			while (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
+			{
+				Pointer		ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+				BTreeNonLeafTuphdr *tuphdr = (BTreeNonLeafTuphdr *) ptr;
+
+				/*
+				 * In the sampled mode unsampled leaves are skipped before
+				 * the downlink is resolved, so evicted leaves are not read
+				 * back from disk.
+				 */
+				if (level == 1 && state->sampleRatio < 1.0)
+				{
+					double		r;
+
+#if PG_VERSION_NUM >= 150000
+					r = sampler_random_fract(&state->randstate);
+#else
+					r = sampler_random_fract(state->randstate);
+#endif
+					if (r > state->sampleRatio)
+					{
+						BTREE_PAGE_LOCATOR_NEXT(p, &loc);
+						continue;
+					}
+				}
+
+				if (DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+				{
+					struct_check_walk(state,
+									  DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink),
+									  blkno);
+				}
+				else if (DOWNLINK_IS_IN_IO(tuphdr->downlink))
+				{
+					wait_for_io_completion(DOWNLINK_GET_IO_LOCKNUM(tuphdr->downlink));
+					continue;
+				}
+				else if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+				{
+					context->items[context->index].locator = loc;
+					load_page(context);
+					continue;
+				}
+				BTREE_PAGE_LOCATOR_NEXT(p, &loc);
+			}
+		}
+	}
+
+	if (OInMemoryBlknoIsValid(parentPagenum))
+		lock_page(parentPagenum);
+	unlock_page(blkno);
+	context->index--;
+}
+
+/*
+ * Runs the check for one participant.  Returns true if no error was found by
+ * this participant.
+ */
+static bool
+struct_check_participant(BTreeDescr *desc, OBTreeStructCheckShared *shared,
+						 double sampleRatio)
+{
+	OBTreeStructCheckState state;
+
+	memset(&state, 0, sizeof(OBTreeStructCheckState));
+	state.desc = desc;
+	state.shared = shared;
+	state.sampleRatio = sampleRatio;
+	if (shared != NULL)
+		state.nextClaim = pg_atomic_fetch_add_u64(&shared->subtreeCounter, 1);
+#if PG_VERSION_NUM >= 150000
+	sampler_random_init_state(pg_prng_uint32(&pg_global_prng_state),
+							  &state.randstate);
+#else
+	sampler_random_init_state(random(), state.randstate);
+#endif
+	init_page_find_context(&state.context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_MODIFY);
+
+	struct_check_walk(&state, desc->rootInfo.rootPageBlkno,
+					  OInvalidInMemoryBlkno);
+
+	return !state.hasError;
+}
+
+void
+o_btree_struct_check_worker_main(dsm_segment *seg, shm_toc *toc)
+{
+	OBTreeStructCheckShared *shared;
+	OIndexDescr *indexDescr;
+
+	orioledb_check_shmem();
+
+	shared = shm_toc_lookup(toc, O_PARALLEL_KEY_STRUCT_CHECK, false);
+
+	indexDescr = o_fetch_index_descr(shared->oids, shared->type, true, NULL);
+	if (indexDescr == NULL)
+		elog(ERROR, "unable to fetch descriptor of tree (%u, %u, %u)",
+			 shared->oids.datoid, shared->oids.reloid,
+			 shared->oids.relnode);
+
+	o_btree_load_shmem(&indexDescr->desc);
+
+	if (!struct_check_participant(&indexDescr->desc, shared,
+								  shared->sampleRatio))
+		pg_atomic_write_u32(&shared->hasError, 1);
+}
+
+/*
+ * Checks structural invariants of the tree, fanning level 1 subtrees out
+ * across nworkers parallel workers.  With sampleRatio below 1.0 each leaf is
+ * verified with the given probability only, internal pages are always
+ * verified.  The caller must prevent concurrent modification of the tree.
+ */
+bool
+check_btree_structure(BTreeDescr *desc, int nworkers, double sampleRatio)
+{
+	OBTreeStructCheckShared *shared;
+	ParallelContext *pcxt;
+	bool		result;
+
+	if (nworkers <= 0 || is_recovery_in_progress())
+		return struct_check_participant(desc, NULL, sampleRatio);
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("orioledb",
+								 "o_btree_struct_check_worker_main",
+								 nworkers);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(OBTreeStructCheckShared));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	InitializeParallelDSM(pcxt);
+
+	/* DSM segment might be unavailable, fall back to the serial check */
+	if (pcxt->seg == NULL)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return struct_check_participant(desc, NULL, sampleRatio);
+	}
+
+	shared = (OBTreeStructCheckShared *)
+		shm_toc_allocate(pcxt->toc, sizeof(OBTreeStructCheckShared));
+	shared->oids = desc->oids;
+	shared->type = desc->type;
+	shared->sampleRatio = sampleRatio;
+	pg_atomic_init_u64(&shared->subtreeCounter, 0);
+	pg_atomic_init_u32(&shared->hasError, 0);
+	shm_toc_insert(pcxt->toc, O_PARALLEL_KEY_STRUCT_CHECK, shared);
+
+	LaunchParallelWorkers(pcxt);
+	if (pcxt->nworkers_launched == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return struct_check_participant(desc, NULL, sampleRatio);
+	}
+
+	result = struct_check_participant(desc, shared, sampleRatio);
+
+	WaitForParallelWorkersToFinish(pcxt);
+
+	if (pg_atomic_read_u32(&shared->hasError) != 0)
+		result = false;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	return result;
+}
@@ -0,0 +1,239 @@
+/*-------------------------------------------------------------------------
+ *
+ * decompress_cache.c
+ *		Cache of decompressed page images of compressed trees.
+ *
+ * When the working set of a compressed tree slightly exceeds the page pool,
+ * the same pages get evicted and re-read over and over, and every re-read
+ * pays the decompression.  This module keeps recently decompressed page
+ * images in a shared direct-mapped cache consulted before the disk read, so
+ * such re-reads cost a memcpy() instead of a read plus decompression.
+ *
+ * An image is addressed by the on-disk location of its compressed form:
+ * (datoid, relnode, extent offset), i.e. exactly what a downlink points to.
+ * A write to an extent invalidates the matching cache entry before the
+ * downlink to that extent is published, so a reader can never pick a cached
+ * image of a freed extent reused for another page.
+ *
+ * Slots are protected by per-slot seqlocks: readers copy the image and
+ * recheck the slot state, writers serialize through a compare-and-swap on
+ * the odd state value.  Stores skip busy slots; invalidations spin, they
+ * must not be lost.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/decompress_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/decompress_cache.h"
+
+#include "storage/s_lock.h"
+
+typedef struct
+{
+	Oid			datoid;
+	Oid			relnode;
+	uint64		offset;
+} DecompressCacheTag;
+
+typedef struct
+{
+	/* seqlock: odd value means the slot is being modified */
+	pg_atomic_uint32 state;
+	DecompressCacheTag tag;
+	char		image[ORIOLEDB_BLCKSZ];
+} DecompressCacheSlot;
+
+typedef struct
+{
+	uint64		numSlots;
+	DecompressCacheSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} DecompressCacheShared;
+
+static DecompressCacheShared *decompressCache = NULL;
+
+Size
+decompress_cache_shmem_needs(void)
+{
+	if (decompress_cache_size == 0)
+		return 0;
+
+	return CACHELINEALIGN(offsetof(DecompressCacheShared, slots)) +
+		mul_size(decompress_cache_size / sizeof(DecompressCacheSlot),
+				 sizeof(DecompressCacheSlot));
+}
+
+void
+decompress_cache_shmem_init(Pointer ptr, bool found)
+{
+	if (decompress_cache_size == 0)
+	{
+		decompressCache = NULL;
+		return;
+	}
+
+	decompressCache = (DecompressCacheShared *) ptr;
+
+	if (!found)
+	{
+		uint64		i;
+
+		decompressCache->numSlots = decompress_cache_size /
+			sizeof(DecompressCacheSlot);
+
+		for (i = 0; i < decompressCache->numSlots; i++)
+		{
+			pg_atomic_init_u32(&decompressCache->slots[i].state, 0);
+			decompressCache->slots[i].tag.datoid = InvalidOid;
+			decompressCache->slots[i].tag.relnode = InvalidOid;
+			decompressCache->slots[i].tag.offset = 0;
+		}
+	}
+}
+
+bool
+o_decompress_cache_enabled(void)
+{
+	return decompressCache != NULL;
+}
+
+/*
+ * Finalizer constants are borrowed from MurmurHash3.
+ */
+static DecompressCacheSlot *
+decompress_cache_slot(DecompressCacheTag *tag)
+{
+	uint64		x;
+
+	x = ((uint64) tag->relnode << 32) | tag->datoid;
+	x ^= tag->offset * UINT64CONST(0x9E3779B97F4A7C15);
+	x ^= x >> 33;
+	x *= UINT64CONST(0xFF51AFD7ED558CCD);
+	x ^= x >> 33;
+	x *= UINT64CONST(0xC4CEB9FE1A85EC53);
+	x ^= x >> 33;
+
+	return &decompressCache->slots[x % decompressCache->numSlots];
+}
+
+static inline bool
+decompress_cache_tag_equal(DecompressCacheTag *a, DecompressCacheTag *b)
+{
+	return a->datoid == b->datoid && a->relnode == b->relnode &&
+		a->offset == b->offset;
+}
+
+/*
+ * Copies the cached image of the given extent into img.  Returns false on a
+ * cache miss or when the slot changed underneath the copy.
+ */
+bool
+o_decompress_cache_lookup(BTreeDescr *desc, uint64 offset, Page img)
+{
+	DecompressCacheTag tag;
+	DecompressCacheSlot *slot;
+	uint32		before,
+				after;
+
+	Assert(decompressCache != NULL);
+
+	tag.datoid = desc->oids.datoid;
+	tag.relnode = desc->oids.relnode;
+	tag.offset = offset;
+	slot = decompress_cache_slot(&tag);
+
+	before = pg_atomic_read_u32(&slot->state);
+	if (before & 1)
+		return false;
+	pg_read_barrier();
+
+	if (!decompress_cache_tag_equal(&slot->tag, &tag))
+		return false;
+
+	memcpy(img, slot->image, ORIOLEDB_BLCKSZ);
+
+	pg_read_barrier();
+	after = pg_atomic_read_u32(&slot->state);
+
+	return before == after;
+}
+
+/*
+ * Remembers the decompressed image of the given extent.  Contended slots are
+ * skipped: losing a store only costs a future decompression.
+ */
+void
+o_decompress_cache_store(BTreeDescr *desc, uint64 offset, Page img)
+{
+	DecompressCacheTag tag;
+	DecompressCacheSlot *slot;
+	uint32		state;
+
+	Assert(decompressCache != NULL);
+
+	tag.datoid = desc->oids.datoid;
+	tag.relnode = desc->oids.relnode;
+	tag.offset = offset;
+	slot = decompress_cache_slot(&tag);
+
+	state = pg_atomic_read_u32(&slot->state);
+	if (state & 1)
+		return;
+	if (!pg_atomic_compare_exchange_u32(&slot->state, &state, state + 1))
+		return;
+	pg_write_barrier();
+
+	slot->tag = tag;
+	memcpy(slot->image, img, ORIOLEDB_BLCKSZ);
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&slot->state, state + 2);
+}
+
+/*
+ * Drops the cached image of the given extent.  Called before a downlink to a
+ * rewritten extent is published, so it must not skip on contention.
+ */
+void
+o_decompress_cache_invalidate(BTreeDescr *desc, uint64 offset)
+{
+	DecompressCacheTag tag;
+	DecompressCacheSlot *slot;
+	uint32		state;
+	SpinDelayStatus delayStatus;
+
+	Assert(decompressCache != NULL);
+
+	tag.datoid = desc->oids.datoid;
+	tag.relnode = desc->oids.relnode;
+	tag.offset = offset;
+	slot = decompress_cache_slot(&tag);
+
+	init_local_spin_delay(&delayStatus);
+	while (true)
+	{
+		state = pg_atomic_read_u32(&slot->state);
+		if (!(state & 1) &&
+			pg_atomic_compare_exchange_u32(&slot->state, &state, state + 1))
+			break;
+		perform_spin_delay(&delayStatus);
+	}
+	finish_spin_delay(&delayStatus);
+	pg_write_barrier();
+
+	if (decompress_cache_tag_equal(&slot->tag, &tag))
+	{
+		slot->tag.datoid = InvalidOid;
+		slot->tag.relnode = InvalidOid;
+		slot->tag.offset = 0;
+	}
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&slot->state, state + 2);
+}
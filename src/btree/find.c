@@ -19,9 +19,15 @@
 #include "btree/io.h"
 #include "btree/page_chunks.h"
 #include "tableam/descr.h"
+#include "utils/o_latency.h"
 #include "utils/stopevent.h"
 
 #include "access/transam.h"
+#include "port/pg_bitutils.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 typedef struct
 {
@@ -36,6 +42,8 @@ typedef struct
 	bool		haveLock;
 } OBTreeFindPageInternalContext;
 
+static bool find_page_internal(OBTreeFindPageContext *context, void *key,
+							   BTreeKeyType keyType, uint16 targetLevel);
 static bool follow_rightlink(OBTreeFindPageInternalContext *intCxt);
 static void step_upward_level(OBTreeFindPageInternalContext *intCxt);
 static bool btree_find_read_page(OBTreeFindPageContext *context,
@@ -59,9 +67,91 @@ init_page_find_context(OBTreeFindPageContext *context, BTreeDescr *desc,
 	context->index = 0;
 	context->flags = flags;
 	context->imgUndoLoc = InvalidUndoLocation;
+	context->leafHint.blkno = OInvalidInMemoryBlkno;
+	context->leafHint.pageChangeCount = 0;
 	O_TUPLE_SET_NULL(context->lokey.tuple);
 }
 
+/*
+ * Try to serve a leaf-level fetch from the leaf found by the previous search
+ * with this context, skipping the root-to-leaf descent.
+ *
+ * The cached leaf is usable if it still has the remembered change count and
+ * the key falls between its fences.  The page lokey isn't stored on the page,
+ * so the first page tuple is used as a conservative lower fence instead.
+ *
+ * On success, fills context->items[0] the same way find_page() does for the
+ * leaf level.  On failure the caller performs an ordinary descent.
+ */
+static bool
+find_page_via_leaf_hint(OBTreeFindPageContext *context, void *key,
+						BTreeKeyType keyType)
+{
+	BTreeDescr *desc = context->desc;
+	Page		img = context->img;
+	BTreePageItemLocator loc;
+	OTuple		hikey;
+
+	context->partial.isPartial = false;
+	context->imgUndoLoc = InvalidUndoLocation;
+	context->index = 0;
+
+	if (!btree_find_read_page(context, context->leafHint.blkno,
+							  context->leafHint.pageChangeCount,
+							  img, key, keyType, &context->partial))
+		return false;
+
+	if (!O_PAGE_IS(img, LEAF) ||
+		O_PAGE_GET_CHANGE_COUNT(img) != context->leafHint.pageChangeCount)
+		return false;
+
+	/* The key must not be beyond the page hikey... */
+	if (!O_PAGE_IS(img, RIGHTMOST))
+	{
+		BTREE_PAGE_GET_HIKEY(hikey, img);
+		if (o_btree_cmp(desc, key, keyType,
+						&hikey, BTreeKeyNonLeafKey) >= 0)
+			return false;
+	}
+
+	/*
+	 * ...and must not be before the first page tuple, unless the page is
+	 * leftmost and covers everything below.
+	 */
+	if (!O_PAGE_IS(img, LEFTMOST))
+	{
+		OTuple		firstTup;
+
+		if (BTREE_PAGE_ITEMS_COUNT(img) == 0 ||
+			!partial_load_chunk(&context->partial, img, 0))
+			return false;
+		BTREE_PAGE_LOCATOR_FIRST(img, &loc);
+		BTREE_PAGE_READ_LEAF_TUPLE(firstTup, img, &loc);
+		if (o_btree_cmp(desc, key, keyType,
+						&firstTup, BTreeKeyLeafTuple) < 0)
+			return false;
+	}
+
+	if (STOPEVENTS_ENABLED())
+	{
+		Jsonb	   *params = btree_page_stopevent_params(desc, img);
+
+		STOPEVENT(STOPEVENT_PAGE_READ, params);
+	}
+
+	if (!btree_page_search(desc, img, key, keyType, &context->partial, &loc) ||
+		!page_locator_find_real_item(img, &context->partial, &loc))
+		return false;
+
+	if (!partial_load_chunk(&context->partial, img, loc.chunkOffset))
+		return false;
+
+	context->items[0].locator = loc;
+	context->items[0].blkno = context->leafHint.blkno;
+	context->items[0].pageChangeCount = context->leafHint.pageChangeCount;
+	return true;
+}
+
 /*--
  * Locate page and location within it for given key
  *
@@ -89,12 +179,84 @@ init_page_find_context(OBTreeFindPageContext *context, BTreeDescr *desc,
 bool
 find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 		  uint16 targetLevel)
+{
+	uint64		nacquires = page_lock_nacquires;
+	uint64		nwaits = page_lock_nwaits;
+	bool		result;
+	instr_time	start;
+	bool		track = O_LATENCY_TRACKING();
+
+	if (track)
+		INSTR_TIME_SET_CURRENT(start);
+
+	result = find_page_internal(context, key, keyType, targetLevel);
+
+	if (track)
+		o_latency_record(OLatencyFindPage, start);
+
+	/*
+	 * lock_page() knows nothing about trees, so attribute the page locks
+	 * taken during the descent to the tree being descended.
+	 */
+	if (page_lock_nacquires != nacquires)
+		O_TREE_STAT_ADD(context->desc, lockAcquires,
+						page_lock_nacquires - nacquires);
+	if (page_lock_nwaits != nwaits)
+		O_TREE_STAT_ADD(context->desc, lockWaits,
+						page_lock_nwaits - nwaits);
+
+	return result;
+}
+
+/*
+ * Hint the OS to read the on-disk leaf page the given key would descend to.
+ *
+ * Descends the in-memory part of the tree down to level 1 like an ordinary
+ * find and prefetches the leaf downlink instead of loading it, so that a
+ * subsequent find or modify of the same key pays a page-cache hit rather
+ * than a synchronous disk read.  `*lastDownlink` carries the previously
+ * prefetched downlink between calls to cheaply skip runs of keys targeting
+ * the same leaf.
+ */
+void
+prefetch_page_for_key(BTreeDescr *desc, Pointer key, BTreeKeyType keyType,
+					  uint64 *lastDownlink)
+{
+	OBTreeFindPageContext context;
+	BTreePageItemLocator loc;
+	BTreeNonLeafTuphdr *tuphdr;
+
+	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_IMAGE |
+						   BTREE_PAGE_FIND_DOWNLINK_LOCATION);
+	(void) find_page(&context, key, keyType, 1);
+
+	/* A tree of a single leaf page has nothing to prefetch */
+	if (PAGE_GET_LEVEL(context.img) != 1)
+		return;
+
+	loc = context.items[context.index].locator;
+	if (!BTREE_PAGE_LOCATOR_IS_VALID(context.img, &loc))
+		return;
+
+	tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(context.img, &loc);
+	if (DOWNLINK_IS_ON_DISK(tuphdr->downlink) &&
+		tuphdr->downlink != *lastDownlink)
+	{
+		*lastDownlink = tuphdr->downlink;
+		prefetch_page_from_disk(desc, tuphdr->downlink);
+	}
+}
+
+static bool
+find_page_internal(OBTreeFindPageContext *context, void *key,
+				   BTreeKeyType keyType, uint16 targetLevel)
 {
 	BTreeDescr *desc = context->desc;
 	OBTreeFindPageInternalContext intCxt;
 	BTreePageItemLocator loc;
 	bool		needLock = false,
-				fetchFlag PG_USED_FOR_ASSERTS_ONLY = BTREE_PAGE_FIND_IS(context, FETCH),
+				fetchFlag = BTREE_PAGE_FIND_IS(context, FETCH),
 				modifyFlag = BTREE_PAGE_FIND_IS(context, MODIFY),
 				imageFlag = BTREE_PAGE_FIND_IS(context, IMAGE),
 				tryFlag = BTREE_PAGE_FIND_IS(context, TRY_LOCK),
@@ -131,6 +293,24 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 	context->partial.isPartial = false;
 	context->index = 0;
 
+	/*
+	 * Try to skip the descent altogether using the cached leaf from the
+	 * previous search.  Read-only single-tuple fetches only: modifications
+	 * and image reads need the stack of parent pages to be valid.
+	 */
+	if (fetchFlag && targetLevel == 0 && key != NULL &&
+		keyType != BTreeKeyNone && keyType != BTreeKeyRightmost &&
+		keyType != BTreeKeyPageHiKey &&
+		OInMemoryBlknoIsValid(context->leafHint.blkno))
+	{
+		if (find_page_via_leaf_hint(context, key, keyType))
+			return true;
+		context->leafHint.blkno = OInvalidInMemoryBlkno;
+		context->imgUndoLoc = InvalidUndoLocation;
+		context->partial.isPartial = false;
+		context->index = 0;
+	}
+
 	/* starts from the rootPageBlkno */
 	intCxt.blkno = desc->rootInfo.rootPageBlkno;
 	intCxt.pageChangeCount = desc->rootInfo.rootPageChangeCount;
@@ -460,6 +640,13 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 				}
 			}
 
+			/* Remember the found leaf for the fetch fastpath */
+			if (level == 0 && fetchFlag)
+			{
+				context->leafHint.blkno = context->items[context->index].blkno;
+				context->leafHint.pageChangeCount = context->items[context->index].pageChangeCount;
+			}
+
 			return true;
 		}
 		else if (!noneLeafHdr)
@@ -1192,9 +1379,12 @@ btree_page_search(BTreeDescr *desc, Page p, Pointer key, BTreeKeyType keyType,
 	bool		isLeaf = O_PAGE_IS(p, LEAF),
 				nextkey;
 	OBTreeKeyCmp cmpFunc = desc->ops->cmp;
+	OBTreeKeyCmpPrefix cmpPrefixFunc = desc->ops->cmpPrefix;
 	BTreeKeyType midkind;
 	int			targetCmpVal,
 				result;
+	int			lowEqualAtts = 0,
+				highEqualAtts = 0;
 
 	if (keyType == BTreeKeyPageHiKey && isLeaf)
 	{
@@ -1260,7 +1450,24 @@ btree_page_search(BTreeDescr *desc, Page p, Pointer key, BTreeKeyType keyType,
 
 			locator->itemOffset = mid;
 			BTREE_PAGE_READ_TUPLE(midTup, p, locator);
-			result = cmpFunc(desc, key, keyType, &midTup, midkind);
+			if (cmpPrefixFunc)
+			{
+				/*
+				 * Every item between the low and high fences shares with the
+				 * key the attributes the key shares with both fences, so the
+				 * comparison can skip them.
+				 */
+				int			equalAtts = Min(lowEqualAtts, highEqualAtts);
+
+				result = cmpPrefixFunc(desc, key, keyType, &midTup, midkind,
+									   &equalAtts);
+				if (result >= targetCmpVal)
+					lowEqualAtts = equalAtts;
+				else
+					highEqualAtts = equalAtts;
+			}
+			else
+				result = cmpFunc(desc, key, keyType, &midTup, midkind);
 		}
 
 		if (result >= targetCmpVal)
@@ -1274,6 +1481,168 @@ btree_page_search(BTreeDescr *desc, Page p, Pointer key, BTreeKeyType keyType,
 	return true;
 }
 
+/*
+ * Backend-local cache of chunk hikey abbreviation directories.
+ *
+ * Computing the directory costs one key_abbrev() call per chunk, which
+ * dominates the chunk search on pages with many chunks.  The directory only
+ * changes when the chunk boundaries do (page compaction, split, chunk
+ * re-division), so it's worth keeping between searches of the same page.
+ *
+ * Entries don't get invalidated when the page changes, so a hit is only a
+ * hint: btree_page_abbrev_search_chunks() verifies the narrowed range
+ * against the live page and rebuilds the entry on mismatch.  The identity
+ * fields just keep the false-hit rate low.
+ */
+#define ABBREV_CACHE_SIZE	8	/* must be a power of 2 */
+
+typedef struct
+{
+	uint64		abbrevs[BTREE_PAGE_MAX_CHUNKS] pg_attribute_aligned(64);
+	Page		page;
+	uint32		pageChangeCount;
+	OffsetNumber chunksCount;
+	OffsetNumber hikeysEnd;
+} AbbrevCacheEntry;
+
+static AbbrevCacheEntry abbrevCache[ABBREV_CACHE_SIZE];
+
+/*
+ * Count the chunk hikey abbreviations less and less-or-equal than the key
+ * abbreviation, comparing a whole cache line at once with SIMD instructions
+ * where available.
+ */
+static void
+btree_page_abbrev_count(const uint64 *abbrevs, int count, uint64 keyAbbrev,
+						OffsetNumber *low, OffsetNumber *high)
+{
+	int			countLess = 0,
+				countLessEq = 0,
+				i;
+
+#ifdef __AVX2__
+	{
+		const __m256i bias = _mm256_set1_epi64x((int64) (UINT64CONST(1) << 63));
+		__m256i		keyVec = _mm256_xor_si256(_mm256_set1_epi64x((int64) keyAbbrev), bias);
+
+		for (i = 0; i + 4 <= count; i += 4)
+		{
+			__m256i		chunkVec = _mm256_xor_si256(_mm256_load_si256((const __m256i *) &abbrevs[i]), bias);
+			uint32		gtMask,
+						eqMask;
+
+			gtMask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(keyVec, chunkVec)));
+			eqMask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(keyVec, chunkVec)));
+			countLess += pg_popcount32(gtMask);
+			countLessEq += pg_popcount32(gtMask | eqMask);
+		}
+	}
+#else
+	i = 0;
+#endif
+	for (; i < count; i++)
+	{
+		countLess += (abbrevs[i] < keyAbbrev) ? 1 : 0;
+		countLessEq += (abbrevs[i] <= keyAbbrev) ? 1 : 0;
+	}
+
+	*low = countLess;
+	*high = countLessEq;
+}
+
+/*
+ * Try to narrow the chunk search range using fixed-width abbreviated keys.
+ *
+ * Chunk hikeys are abbreviated into a cache-aligned array of 64-bit
+ * order-preserving values, so that a whole cache line of candidates can be
+ * compared at once with SIMD instructions where available.  Since equal
+ * abbreviations don't guarantee equal keys, the caller must resolve the
+ * resulting [*low, *high] range with the full comparator.
+ *
+ * The directory of a page is cached between searches.  A cached range is
+ * trusted only after checking the boundary hikeys of the range with the full
+ * comparator: the hikeys are ordered, so the checks passing proves the
+ * binary search answer lies within the range whatever the cache contained.
+ *
+ * Returns false if the tree or the given keys don't support abbreviation;
+ * the caller then does plain binary search over the whole page.
+ */
+static bool
+btree_page_abbrev_search_chunks(BTreeDescr *desc, Page p, Pointer key,
+								BTreeKeyType keyType, int targetCmpVal,
+								OffsetNumber *low, OffsetNumber *high)
+{
+	BTreePageHeader *header = (BTreePageHeader *) p;
+	AbbrevCacheEntry *entry;
+	uint64		keyAbbrev;
+	int			count = header->chunksCount - 1,
+				i;
+
+	if (desc->ops->key_abbrev == NULL)
+		return false;
+
+	if (!desc->ops->key_abbrev(desc, key, keyType, &keyAbbrev))
+		return false;
+
+	entry = &abbrevCache[((uintptr_t) p >> 6) & (ABBREV_CACHE_SIZE - 1)];
+
+	if (entry->page == p &&
+		entry->pageChangeCount == O_PAGE_GET_CHANGE_COUNT(p) &&
+		entry->chunksCount == header->chunksCount &&
+		entry->hikeysEnd == header->hikeysEnd)
+	{
+		bool		valid = true;
+		OTuple		hikey;
+
+		btree_page_abbrev_count(entry->abbrevs, count, keyAbbrev, low, high);
+
+		if (*low > 0)
+		{
+			hikey.formatFlags = header->chunkDesc[*low - 1].hikeyFlags;
+			hikey.data = p + SHORT_GET_LOCATION(header->chunkDesc[*low - 1].hikeyShortLocation);
+			valid = desc->ops->cmp(desc, key, keyType,
+								   &hikey, BTreeKeyNonLeafKey) >= targetCmpVal;
+		}
+		if (valid && *high < count)
+		{
+			hikey.formatFlags = header->chunkDesc[*high].hikeyFlags;
+			hikey.data = p + SHORT_GET_LOCATION(header->chunkDesc[*high].hikeyShortLocation);
+			valid = desc->ops->cmp(desc, key, keyType,
+								   &hikey, BTreeKeyNonLeafKey) < targetCmpVal;
+		}
+
+		if (valid)
+			return true;
+	}
+
+	/* Cache miss or a stale directory: rebuild the entry from the page */
+	entry->page = NULL;
+	for (i = 0; i < count; i++)
+	{
+		OTuple		hikey;
+
+		hikey.formatFlags = header->chunkDesc[i].hikeyFlags;
+		hikey.data = p + SHORT_GET_LOCATION(header->chunkDesc[i].hikeyShortLocation);
+		if (!desc->ops->key_abbrev(desc, (Pointer) &hikey,
+								   BTreeKeyNonLeafKey, &entry->abbrevs[i]))
+			return false;
+	}
+	entry->page = p;
+	entry->pageChangeCount = O_PAGE_GET_CHANGE_COUNT(p);
+	entry->chunksCount = header->chunksCount;
+	entry->hikeysEnd = header->hikeysEnd;
+
+	/*
+	 * Chunk hikeys are ordered, and so are their abbreviations.  Hikeys with
+	 * lesser abbreviation are guaranteed to be less than the key, hikeys with
+	 * greater abbreviation are guaranteed to be greater.  So, independently
+	 * of the nextkey mode the binary search answer belongs to the range of
+	 * equal abbreviations.
+	 */
+	btree_page_abbrev_count(entry->abbrevs, count, keyAbbrev, low, high);
+	return true;
+}
+
 /*
  * Search for the chunk containing key.
  */
@@ -1308,6 +1677,25 @@ btree_page_binary_search_chunks(BTreeDescr *desc, Page p,
 	if (keyType == BTreeKeyPageHiKey)
 		keyType = BTreeKeyNonLeafKey;
 
+	/*
+	 * On wide pages, try to narrow the search range using vector comparison
+	 * of abbreviated keys first.  Comparator calls are then only needed to
+	 * resolve abbreviation ties.
+	 */
+	if (high - low >= 8)
+	{
+		OffsetNumber abbrevLow,
+					abbrevHigh;
+
+		if (btree_page_abbrev_search_chunks(desc, p, key, keyType,
+											targetCmpVal,
+											&abbrevLow, &abbrevHigh))
+		{
+			low = Max(low, abbrevLow);
+			high = Min(high, abbrevHigh);
+		}
+	}
+
 	while (high > low)
 	{
 		OTuple		midTup;
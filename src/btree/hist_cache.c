@@ -0,0 +1,259 @@
+/*-------------------------------------------------------------------------
+ *
+ * hist_cache.c
+ *		Cache of reconstructed historical page images.
+ *
+ * Sequential scans under an old snapshot rebuild pre-snapshot page images
+ * from the undo log, see load_first_historical_page().  Concurrent and
+ * repeated scans under the same snapshot redo this reconstruction for every
+ * leaf, so e.g. a batch of overlapping reporting queries pays the undo walk
+ * many times over.  This module keeps reconstructed images in a shared
+ * direct-mapped cache, so only the first scan walks the undo log.
+ *
+ * An image is addressed by the undo location of the leaf's newest undo
+ * record plus the hikey the walk started from (no hikey for the first
+ * historical page of a leaf).  The key hash only picks the slot; the slot
+ * stores the full key, and a lookup verifies it, so a hash collision
+ * between sibling hikeys of one reconstruction chain can't serve a wrong
+ * image.  Undo locations grow monotonically and are never reused, so a tag
+ * can't alias another chain and no invalidation is needed.  Each entry
+ * remembers the CSN of the cached image
+ * and the CSN of the newest undo image above it: the entry serves every
+ * snapshot CSN in between, not just the one it was built under.
+ *
+ * Slots are protected by the same per-slot seqlocks as the decompress
+ * cache: readers copy the image and recheck the slot state, writers
+ * serialize through a compare-and-swap on the odd state value and skip busy
+ * slots.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/hist_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/hist_cache.h"
+#include "btree/page_contents.h"
+
+#include "common/hashfn.h"
+
+typedef struct
+{
+	UndoLocation undoLoc;
+	uint32		hikeyHash;
+} HistCacheTag;
+
+typedef struct
+{
+	/* seqlock: odd value means the slot is being modified */
+	pg_atomic_uint32 state;
+	HistCacheTag tag;
+	/* the hikey the undo walk started from, verified on lookup */
+	LocationIndex hikeyLen;
+	uint8		hikeyFlags;
+	/* CSN of the cached image itself */
+	CommitSeqNo imageCsn;
+	/* CSN of the newest undo image the walk descended past */
+	CommitSeqNo prevCsn;
+	/* first item of the scanned keyrange within the image */
+	OffsetNumber startOffset;
+	char		hikey[O_BTREE_MAX_KEY_SIZE];
+	char		image[ORIOLEDB_BLCKSZ];
+} HistCacheSlot;
+
+typedef struct
+{
+	uint64		numSlots;
+	HistCacheSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} HistCacheShared;
+
+static HistCacheShared *histCache = NULL;
+
+Size
+hist_cache_shmem_needs(void)
+{
+	if (hist_cache_size == 0)
+		return 0;
+
+	return CACHELINEALIGN(offsetof(HistCacheShared, slots)) +
+		mul_size(hist_cache_size / sizeof(HistCacheSlot),
+				 sizeof(HistCacheSlot));
+}
+
+void
+hist_cache_shmem_init(Pointer ptr, bool found)
+{
+	if (hist_cache_size == 0)
+	{
+		histCache = NULL;
+		return;
+	}
+
+	histCache = (HistCacheShared *) ptr;
+
+	if (!found)
+	{
+		uint64		i;
+
+		histCache->numSlots = hist_cache_size / sizeof(HistCacheSlot);
+
+		for (i = 0; i < histCache->numSlots; i++)
+		{
+			pg_atomic_init_u32(&histCache->slots[i].state, 0);
+			histCache->slots[i].tag.undoLoc = InvalidUndoLocation;
+			histCache->slots[i].tag.hikeyHash = 0;
+		}
+	}
+}
+
+bool
+o_hist_cache_enabled(void)
+{
+	return histCache != NULL;
+}
+
+/*
+ * Computes the cache tag component for the hikey the undo walk starts from.
+ * Zero is reserved for the first historical page of a leaf, which starts
+ * from no hikey.
+ */
+static uint32
+hist_cache_hikey_hash(OTuple hikey, LocationIndex hikeyLen)
+{
+	uint32		hash;
+
+	if (O_TUPLE_IS_NULL(hikey))
+		return 0;
+
+	hash = hash_bytes((unsigned char *) hikey.data, hikeyLen);
+	hash ^= (uint32) hikey.formatFlags << 24;
+	return hash == 0 ? 1 : hash;
+}
+
+/*
+ * Finalizer constants are borrowed from MurmurHash3.
+ */
+static HistCacheSlot *
+hist_cache_slot(HistCacheTag *tag)
+{
+	uint64		x;
+
+	x = tag->undoLoc ^ ((uint64) tag->hikeyHash * UINT64CONST(0x9E3779B97F4A7C15));
+	x ^= x >> 33;
+	x *= UINT64CONST(0xFF51AFD7ED558CCD);
+	x ^= x >> 33;
+	x *= UINT64CONST(0xC4CEB9FE1A85EC53);
+	x ^= x >> 33;
+
+	return &histCache->slots[x % histCache->numSlots];
+}
+
+static inline bool
+hist_cache_tag_equal(HistCacheTag *a, HistCacheTag *b)
+{
+	return a->undoLoc == b->undoLoc && a->hikeyHash == b->hikeyHash;
+}
+
+/*
+ * Copies the cached historical image for the given reconstruction start into
+ * img, if there is one serving the given snapshot CSN.  Returns false on a
+ * cache miss or when the slot changed underneath the copy.
+ */
+bool
+o_hist_cache_lookup(UndoLocation undoLoc, OTuple hikey, LocationIndex hikeyLen,
+					CommitSeqNo csn, Page img, OffsetNumber *startOffset)
+{
+	HistCacheTag tag;
+	HistCacheSlot *slot;
+	uint32		before,
+				after;
+
+	Assert(histCache != NULL);
+
+	tag.undoLoc = undoLoc;
+	tag.hikeyHash = hist_cache_hikey_hash(hikey, hikeyLen);
+	slot = hist_cache_slot(&tag);
+
+	before = pg_atomic_read_u32(&slot->state);
+	if (before & 1)
+		return false;
+	pg_read_barrier();
+
+	if (!hist_cache_tag_equal(&slot->tag, &tag))
+		return false;
+
+	/*
+	 * The hash only picks the slot: compare the stored key itself, so a
+	 * collision between sibling hikeys can't serve a wrong image.  Torn
+	 * reads of a concurrently overwritten key are fine here, the final
+	 * seqlock recheck would reject the copy anyway.
+	 */
+	if (slot->hikeyLen != hikeyLen ||
+		(hikeyLen != 0 &&
+		 (slot->hikeyFlags != hikey.formatFlags ||
+		  memcmp(slot->hikey, hikey.data, hikeyLen) != 0)))
+		return false;
+
+	/*
+	 * The image answers csn iff the undo walk from undoLoc under csn would
+	 * stop exactly at it: every image above it must be too new and the image
+	 * itself old enough.
+	 */
+	if (csn > slot->prevCsn ||
+		(COMMITSEQNO_IS_NORMAL(slot->imageCsn) && slot->imageCsn >= csn))
+		return false;
+
+	memcpy(img, slot->image, ORIOLEDB_BLCKSZ);
+	*startOffset = slot->startOffset;
+
+	pg_read_barrier();
+	after = pg_atomic_read_u32(&slot->state);
+
+	return before == after;
+}
+
+/*
+ * Remembers a reconstructed historical image.  Contended slots are skipped:
+ * losing a store only costs a future undo walk.
+ */
+void
+o_hist_cache_store(UndoLocation undoLoc, OTuple hikey, LocationIndex hikeyLen,
+				   CommitSeqNo imageCsn, CommitSeqNo prevCsn,
+				   OffsetNumber startOffset, Page img)
+{
+	HistCacheTag tag;
+	HistCacheSlot *slot;
+	uint32		state;
+
+	Assert(histCache != NULL);
+	Assert(hikeyLen <= O_BTREE_MAX_KEY_SIZE);
+
+	tag.undoLoc = undoLoc;
+	tag.hikeyHash = hist_cache_hikey_hash(hikey, hikeyLen);
+	slot = hist_cache_slot(&tag);
+
+	state = pg_atomic_read_u32(&slot->state);
+	if (state & 1)
+		return;
+	if (!pg_atomic_compare_exchange_u32(&slot->state, &state, state + 1))
+		return;
+	pg_write_barrier();
+
+	slot->tag = tag;
+	slot->hikeyLen = hikeyLen;
+	slot->hikeyFlags = hikeyLen != 0 ? hikey.formatFlags : 0;
+	if (hikeyLen != 0)
+		memcpy(slot->hikey, hikey.data, hikeyLen);
+	slot->imageCsn = imageCsn;
+	slot->prevCsn = prevCsn;
+	slot->startOffset = startOffset;
+	memcpy(slot->image, img, ORIOLEDB_BLCKSZ);
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&slot->state, state + 2);
+}
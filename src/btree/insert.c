@@ -225,8 +225,8 @@ o_btree_finish_root_split_internal(BTreeDescr *desc,
 	ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
 	memcpy(ptr, &internal_header, BTreeNonLeafTuphdrSize);
 
-	MARK_DIRTY(desc->ppool, left_blkno);
-	MARK_DIRTY(desc->ppool, desc->rootInfo.rootPageBlkno);
+	MARK_DIRTY(desc, left_blkno);
+	MARK_DIRTY(desc, desc->rootInfo.rootPageBlkno);
 
 	btree_split_mark_finished(left_blkno, false, true);
 	insert_item->left_blkno = OInvalidInMemoryBlkno;
@@ -532,6 +532,7 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 
 				if (fit != BTreeItemPageFitCompactRequired)
 					page_locator_insert_item(p, &loc, newItemSize);
+				page_track_insert_pattern(p, BTREE_PAGE_LOCATOR_GET_OFFSET(p, &loc));
 				header->prevInsertOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(p, &loc);
 
 				if (O_PAGE_IS(p, LEAF))
@@ -603,7 +604,7 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 
 			page_split_chunk_if_needed(desc, p, &loc);
 
-			MARK_DIRTY(desc->ppool, blkno);
+			MARK_DIRTY(desc, blkno);
 			END_CRIT_SECTION();
 			unlock_page(blkno);
 
@@ -721,6 +722,8 @@ o_btree_insert_item(BTreeInsertStackItem *insert_item, int reserve_kind)
 				elog(ERROR, "Debug condition: page has been splitted.");
 
 			STOPEVENT(STOPEVENT_PAGE_SPLIT, params);
+			OTRACEPOINT(OTRACEPOINT_PAGE_SPLIT, right_blkno,
+						insert_item->level);
 
 			if (!next)
 			{
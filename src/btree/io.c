@@ -20,6 +20,7 @@
 #include "orioledb.h"
 
 #include "btree/io.h"
+#include "btree/decompress_cache.h"
 #include "btree/find.h"
 #include "btree/merge.h"
 #include "btree/page_chunks.h"
@@ -32,6 +33,7 @@
 #include "tableam/handler.h"
 #include "utils/compress.h"
 #include "utils/page_pool.h"
+#include "utils/page_waits.h"
 #include "utils/seq_buf.h"
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
@@ -39,6 +41,7 @@
 
 #include "access/transam.h"
 #include "access/relation.h"
+#include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "utils/memutils.h"
@@ -48,6 +51,9 @@ typedef struct
 {
 	pg_atomic_uint64 writesStarted;
 	pg_atomic_uint64 writesFinished;
+	/* separate ticket lane for background I/O, see io_start() */
+	pg_atomic_uint64 bgWritesStarted;
+	pg_atomic_uint64 bgWritesFinished;
 	ConditionVariable cv[FLEXIBLE_ARRAY_MEMBER];
 } IOShmem;
 
@@ -71,16 +77,53 @@ static IOWriteBack io_writeback =
 {
 	0, 0, NULL
 };
+
+#ifdef USE_LIBURING
+#include <liburing.h>
+
+/*
+ * Per-backend io_uring used to issue write-back flush requests
+ * asynchronously, so that evicting backends and bgwriter don't sleep in
+ * sync_file_range().  Completions are reaped opportunistically on the next
+ * submission; flush errors are not critical, because all the data is
+ * fsync'ed during checkpoint anyway.
+ */
+#define WRITEBACK_URING_DEPTH	64
+
+static struct io_uring writeback_ring;
+static bool writeback_ring_initialized = false;
+static bool writeback_ring_failed = false;
+static int	writeback_ring_inflight = 0;
+#endif
+
 static LWLockPadded *io_locks;
 static IOShmem *ioShmem = NULL;
 static int	num_io_lwlocks;
 static bool io_in_progress = false;
+static bool io_in_progress_background = false;
+
+/*
+ * Stack of tree meta page numbers, whose in-flight write counters are
+ * incremented by this backend.  Writes can nest: write_page() refinding the
+ * parent may run into an incomplete split, and fixing it reserves pages,
+ * which in turn can evict a page of another tree.
+ */
+#define TREE_WRITES_MAX_DEPTH 16
+static OInMemoryBlkno treeWriteMetaBlknos[TREE_WRITES_MAX_DEPTH];
+static int	treeWritesDepth = 0;
+
+/* alignment required for memory buffers of direct IO */
+#define DIRECT_IO_ALIGN	4096
+
+static char *direct_io_buffer = NULL;
 
 static bool prepare_non_leaf_page(Page p);
 static uint64 get_free_disk_offset(BTreeDescr *desc);
-static bool get_free_disk_extent(BTreeDescr *desc, off_t page_size, FileExtent *extent);
+static bool get_free_disk_extent(BTreeDescr *desc, off_t page_size,
+								 uint64 offsetHint, FileExtent *extent);
 static bool get_free_disk_extent_copy_blkno(BTreeDescr *desc, off_t page_size,
-											FileExtent *extent, uint32 checkpoint_number);
+											uint64 offsetHint, FileExtent *extent,
+											uint32 checkpoint_number);
 
 static bool write_page_to_disk(BTreeDescr *desc, FileExtent *extent,
 							   Pointer page, off_t page_size);
@@ -115,12 +158,35 @@ btree_io_shmem_init(Pointer buf, bool found)
 
 		pg_atomic_init_u64(&ioShmem->writesStarted, 0);
 		pg_atomic_init_u64(&ioShmem->writesFinished, 0);
+		pg_atomic_init_u64(&ioShmem->bgWritesStarted, 0);
+		pg_atomic_init_u64(&ioShmem->bgWritesFinished, 0);
 
 		for (i = 0; i < max_procs; i++)
 			ConditionVariableInit(&ioShmem->cv[i]);
 	}
 }
 
+/*
+ * Background I/O (bgwriter workers and checkpointer flushes) may use at most
+ * this many of the max_io_concurrency slots.
+ */
+static inline int
+io_background_limit(void)
+{
+	return Max(1, max_io_concurrency / 2);
+}
+
+/*
+ * Take an I/O slot, possibly waiting for one to free up.
+ *
+ * Foreground backends perform I/O a query is waiting on - evictions on page
+ * shortage and page reads - so they may take the whole window.  Background
+ * flushes issued by the bgwriter workers and the checkpointer go through an
+ * additional ticket lane capped at half of the window: a backlog of
+ * background writes (e.g. a checkpoint hitting a slow volume) can then never
+ * occupy all the slots, and foreground I/O always finds at least half of the
+ * window immediately available.
+ */
 static void
 io_start(void)
 {
@@ -129,11 +195,32 @@ io_start(void)
 	if (max_io_concurrency == 0)
 		return;
 
+	if (IsBGWriter || AmCheckpointerProcess())
+	{
+		startNum = pg_atomic_add_fetch_u64(&ioShmem->bgWritesStarted, 1);
+		io_in_progress_background = true;
+		if (startNum > pg_atomic_read_u64(&ioShmem->bgWritesFinished) + io_background_limit())
+		{
+			o_page_wait_start(OPageWaitIOThrottle, OInvalidInMemoryBlkno);
+			while (startNum > pg_atomic_read_u64(&ioShmem->bgWritesFinished) + io_background_limit())
+			{
+				ConditionVariableSleep(&ioShmem->cv[startNum % max_procs], PG_WAIT_EXTENSION);
+			}
+			o_page_wait_end();
+		}
+		ConditionVariableCancelSleep();
+	}
+
 	startNum = pg_atomic_add_fetch_u64(&ioShmem->writesStarted, 1);
 	io_in_progress = true;
-	while (startNum > pg_atomic_read_u64(&ioShmem->writesFinished) + max_io_concurrency)
+	if (startNum > pg_atomic_read_u64(&ioShmem->writesFinished) + max_io_concurrency)
 	{
-		ConditionVariableSleep(&ioShmem->cv[startNum % max_procs], WAIT_EVENT_PG_SLEEP);
+		o_page_wait_start(OPageWaitIOThrottle, OInvalidInMemoryBlkno);
+		while (startNum > pg_atomic_read_u64(&ioShmem->writesFinished) + max_io_concurrency)
+		{
+			ConditionVariableSleep(&ioShmem->cv[startNum % max_procs], PG_WAIT_EXTENSION);
+		}
+		o_page_wait_end();
 	}
 	ConditionVariableCancelSleep();
 }
@@ -146,9 +233,80 @@ io_finish(void)
 	if (max_io_concurrency == 0)
 		return;
 
-	finishNum = pg_atomic_add_fetch_u64(&ioShmem->writesFinished, 1);
-	io_in_progress = false;
-	ConditionVariableBroadcast(&ioShmem->cv[(finishNum + max_io_concurrency) % max_procs]);
+	/*
+	 * Each lane is released separately: on error cleanup the backend might
+	 * hold the background ticket without having entered the global lane yet.
+	 */
+	if (io_in_progress)
+	{
+		finishNum = pg_atomic_add_fetch_u64(&ioShmem->writesFinished, 1);
+		ConditionVariableBroadcast(&ioShmem->cv[(finishNum + max_io_concurrency) % max_procs]);
+		io_in_progress = false;
+	}
+	if (io_in_progress_background)
+	{
+		finishNum = pg_atomic_add_fetch_u64(&ioShmem->bgWritesFinished, 1);
+		ConditionVariableBroadcast(&ioShmem->cv[(finishNum + io_background_limit()) % max_procs]);
+		io_in_progress_background = false;
+	}
+}
+
+/*
+ * Account an upcoming page write, eviction or merge in the tree's in-flight
+ * counter.  Must be called before sampling the checkpoint number with
+ * get_checkpoint_number(): the counter increment implies a full memory
+ * barrier, so the checkpointer, after publishing the checkpoint bound,
+ * observes either the increment or all effects of the already finished
+ * operation (see checkpoint_skip_clean_tree()).
+ */
+void
+btree_write_start(BTreeDescr *desc)
+{
+	/*
+	 * Beyond TREE_WRITES_MAX_DEPTH (shouldn't happen in practice) the
+	 * increment can not be undone, which just makes the checkpointer always
+	 * traverse the affected tree: safe, unlike a missed increment.
+	 */
+	if (OMetaPageIsValid(desc))
+	{
+		if (treeWritesDepth < TREE_WRITES_MAX_DEPTH)
+			treeWriteMetaBlknos[treeWritesDepth] = desc->rootInfo.metaPageBlkno;
+		pg_atomic_fetch_add_u32(&BTREE_GET_META(desc)->inProgressWritesCount, 1);
+	}
+	else if (treeWritesDepth < TREE_WRITES_MAX_DEPTH)
+		treeWriteMetaBlknos[treeWritesDepth] = OInvalidInMemoryBlkno;
+	treeWritesDepth++;
+}
+
+/*
+ * Decrement the in-flight counter of the innermost accounted write without
+ * closing it.  All page relocations and file extent frees must be completed
+ * by this point.  Used by evict_btree(), which has to release the counter
+ * before the meta page containing it is freed.
+ */
+static void
+btree_write_release(void)
+{
+	BTreeMetaPage *meta;
+
+	Assert(treeWritesDepth > 0);
+	if (treeWritesDepth > TREE_WRITES_MAX_DEPTH ||
+		!OInMemoryBlknoIsValid(treeWriteMetaBlknos[treeWritesDepth - 1]))
+		return;
+
+	meta = (BTreeMetaPage *) O_GET_IN_MEMORY_PAGE(treeWriteMetaBlknos[treeWritesDepth - 1]);
+	pg_atomic_fetch_sub_u32(&meta->inProgressWritesCount, 1);
+	treeWriteMetaBlknos[treeWritesDepth - 1] = OInvalidInMemoryBlkno;
+}
+
+/*
+ * Finish the operation accounted by the innermost btree_write_start().
+ */
+void
+btree_write_finish(void)
+{
+	btree_write_release();
+	treeWritesDepth--;
 }
 
 int
@@ -175,6 +333,36 @@ OFileWrite(File file, char *buffer, int amount, off_t offset,
 	return result;
 }
 
+/*
+ * Direct IO covers only uncompressed trees: their reads and writes are whole
+ * pages at page-aligned offsets.  Variable-size extents of compressed trees
+ * would take read-modify-write cycles of the neighbour extents, which can't
+ * be done safely under concurrency, so compressed trees stay on buffered IO.
+ */
+static inline bool
+btree_smgr_direct_io(BTreeDescr *desc)
+{
+	return use_direct_io && !OCompressIsValid(desc->compress);
+}
+
+/*
+ * Returns the backend-local bounce buffer for direct IO of buffers that
+ * don't meet the alignment requirements themselves.
+ */
+static char *
+get_direct_io_buffer(void)
+{
+	if (direct_io_buffer == NULL)
+	{
+		Pointer		ptr;
+
+		ptr = MemoryContextAlloc(TopMemoryContext,
+								 ORIOLEDB_BLCKSZ + DIRECT_IO_ALIGN);
+		direct_io_buffer = (char *) TYPEALIGN(DIRECT_IO_ALIGN, ptr);
+	}
+	return direct_io_buffer;
+}
+
 char *
 btree_smgr_filename(BTreeDescr *desc, off_t offset)
 {
@@ -195,6 +383,7 @@ static void
 btree_open_smgr_file(BTreeDescr *desc, int num)
 {
 	char	   *filename;
+	int			flags = O_RDWR | O_CREAT | PG_BINARY;
 
 	if (num >= desc->smgr.filesAllocated)
 	{
@@ -211,8 +400,11 @@ btree_open_smgr_file(BTreeDescr *desc, int num)
 	if (desc->smgr.files[num] >= 0)
 		return;
 
+	if (btree_smgr_direct_io(desc))
+		flags |= PG_O_DIRECT;
+
 	filename = btree_smgr_filename(desc, (off_t) num * ORIOLEDB_SEGMENT_SIZE);
-	desc->smgr.files[num] = PathNameOpenFile(filename, O_RDWR | O_CREAT | PG_BINARY);
+	desc->smgr.files[num] = PathNameOpenFile(filename, flags);
 
 	if (desc->smgr.files[num] <= 0)
 		ereport(FATAL,
@@ -276,6 +468,14 @@ btree_smgr_write(BTreeDescr *desc, char *buffer, int amount, off_t offset)
 		return result;
 	}
 
+	if (btree_smgr_direct_io(desc) &&
+		(uintptr_t) buffer % DIRECT_IO_ALIGN != 0)
+	{
+		Assert(amount <= ORIOLEDB_BLCKSZ);
+		memcpy(get_direct_io_buffer(), buffer, amount);
+		buffer = get_direct_io_buffer();
+	}
+
 	while (amount > 0)
 	{
 		int			segno = offset / ORIOLEDB_SEGMENT_SIZE;
@@ -324,6 +524,16 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, int amount, off_t offset)
 		return result;
 	}
 
+	if (btree_smgr_direct_io(desc) &&
+		(uintptr_t) buffer % DIRECT_IO_ALIGN != 0)
+	{
+		Assert(amount <= ORIOLEDB_BLCKSZ);
+		result = btree_smgr_read(desc, get_direct_io_buffer(), amount, offset);
+		if (result > 0)
+			memcpy(buffer, get_direct_io_buffer(), result);
+		return result;
+	}
+
 	while (amount > 0)
 	{
 		int			segno = offset / ORIOLEDB_SEGMENT_SIZE;
@@ -353,6 +563,48 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, int amount, off_t offset)
 	return result;
 }
 
+void
+btree_smgr_prefetch(BTreeDescr *desc, off_t offset, int amount)
+{
+#ifdef USE_PREFETCH
+	if (use_mmap)
+	{
+		/*
+		 * The mapping is advised MADV_RANDOM, so readahead happens only
+		 * where the engine explicitly asks for it.
+		 */
+		Assert(offset + amount <= device_length);
+		(void) madvise(mmap_data + offset, amount, MADV_WILLNEED);
+		return;
+	}
+	else if (use_device)
+		return;
+
+	while (amount > 0)
+	{
+		int			segno = offset / ORIOLEDB_SEGMENT_SIZE;
+
+		btree_open_smgr_file(desc, segno);
+		if ((offset + amount) / ORIOLEDB_SEGMENT_SIZE == segno)
+		{
+			FilePrefetch(desc->smgr.files[segno], offset % ORIOLEDB_SEGMENT_SIZE,
+						 amount, WAIT_EVENT_DATA_FILE_PREFETCH);
+			break;
+		}
+		else
+		{
+			int			stepAmount = ORIOLEDB_SEGMENT_SIZE - offset % ORIOLEDB_SEGMENT_SIZE;
+
+			Assert(amount >= stepAmount);
+			FilePrefetch(desc->smgr.files[segno], offset % ORIOLEDB_SEGMENT_SIZE,
+						 stepAmount, WAIT_EVENT_DATA_FILE_PREFETCH);
+			offset += stepAmount;
+			amount -= stepAmount;
+		}
+	}
+#endif
+}
+
 void
 btree_smgr_writeback(BTreeDescr *desc, off_t offset, int amount)
 {
@@ -394,23 +646,46 @@ btree_smgr_writeback(BTreeDescr *desc, off_t offset, int amount)
 void
 btree_smgr_sync(BTreeDescr *desc, off_t length)
 {
-	int			num;
+	int			num,
+				nsegments;
 
 	if (use_mmap || use_device)
 		return;
 
-	for (num = 0; num < length / ORIOLEDB_SEGMENT_SIZE; num++)
+	if (length <= 0)
+		return;
+
+	nsegments = (length + ORIOLEDB_SEGMENT_SIZE - 1) / ORIOLEDB_SEGMENT_SIZE;
+
+	/*
+	 * Kick off writeback of all the segments before the blocking pass: the
+	 * extents written during the checkpoint are already on their way to disk
+	 * thanks to the incremental perform_writeback() flushes, and this sweep
+	 * picks up whatever they missed.  The FileSync() calls below then mostly
+	 * act as barriers draining the device queue once, instead of writing
+	 * each file out in turn.
+	 */
+	for (num = 0; num < nsegments; num++)
 	{
+		off_t		segStart = (off_t) num * ORIOLEDB_SEGMENT_SIZE;
+
 		btree_open_smgr_file(desc, num);
-		FileSync(desc->smgr.files[num], WAIT_EVENT_DATA_FILE_SYNC);
+		FileWriteback(desc->smgr.files[num], 0,
+					  Min((off_t) ORIOLEDB_SEGMENT_SIZE, length - segStart),
+					  WAIT_EVENT_DATA_FILE_FLUSH);
 	}
+
+	for (num = 0; num < nsegments; num++)
+		FileSync(desc->smgr.files[num], WAIT_EVENT_DATA_FILE_SYNC);
 }
 
 void
 btree_io_error_cleanup(void)
 {
-	if (io_in_progress)
+	if (io_in_progress || io_in_progress_background)
 		io_finish();
+	while (treeWritesDepth > 0)
+		btree_write_finish();
 }
 
 void
@@ -460,7 +735,12 @@ assign_io_num(OInMemoryBlkno blkno, OffsetNumber offnum)
 void
 wait_for_io_completion(int ionum)
 {
-	LWLockAcquire(&io_locks[ionum].lock, LW_SHARED);
+	if (!LWLockConditionalAcquire(&io_locks[ionum].lock, LW_SHARED))
+	{
+		o_page_wait_start(OPageWaitIOCompletion, OInvalidInMemoryBlkno);
+		LWLockAcquire(&io_locks[ionum].lock, LW_SHARED);
+		o_page_wait_end();
+	}
 	LWLockRelease(&io_locks[ionum].lock);
 }
 
@@ -550,7 +830,20 @@ get_free_disk_offset(BTreeDescr *desc)
 			FileExtent	extent;
 
 			if (seq_buf_read_file_extent(&desc->freeBuf, &extent))
-				result = extent.off;
+			{
+				if (orioledb_device_zoned())
+				{
+					/*
+					 * Consume the free list entry, but invalidate it in its
+					 * zone and append instead of rewriting in place.
+					 */
+					orioledb_device_zone_free((uint64) extent.off * ORIOLEDB_COMP_BLCKSZ,
+											  (uint64) extent.len * ORIOLEDB_COMP_BLCKSZ);
+					result = orioledb_device_alloc(desc, ORIOLEDB_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
+				}
+				else
+					result = extent.off;
+			}
 			else
 				result = InvalidFileExtentOff;
 		}
@@ -581,7 +874,8 @@ get_free_disk_offset(BTreeDescr *desc)
  * FileExtentIsValid(extent) == false if fails.
  */
 static bool
-get_free_disk_extent(BTreeDescr *desc, off_t page_size, FileExtent *extent)
+get_free_disk_extent(BTreeDescr *desc, off_t page_size,
+					 uint64 offsetHint, FileExtent *extent)
 {
 	if (!OCompressIsValid(desc->compress))
 	{
@@ -594,7 +888,7 @@ get_free_disk_extent(BTreeDescr *desc, off_t page_size, FileExtent *extent)
 	{
 		/* Try to add free extents if we didn't manage to do after checkpoint */
 		add_free_extents_from_tmp(desc, remove_old_checkpoint_files);
-		*extent = get_extent(desc, FileExtentLen(page_size));
+		*extent = get_extent_near(desc, FileExtentLen(page_size), offsetHint);
 	}
 
 	return FileExtentIsValid(*extent);
@@ -607,13 +901,14 @@ get_free_disk_extent(BTreeDescr *desc, off_t page_size, FileExtent *extent)
  */
 static bool
 get_free_disk_extent_copy_blkno(BTreeDescr *desc, off_t page_size,
-								FileExtent *extent, uint32 checkpoint_number)
+								uint64 offsetHint, FileExtent *extent,
+								uint32 checkpoint_number)
 {
 	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
 
 	LWLockAcquire(&metaPage->copyBlknoLock, LW_SHARED);
 
-	if (!get_free_disk_extent(desc, page_size, extent))
+	if (!get_free_disk_extent(desc, page_size, offsetHint, extent))
 	{
 		LWLockRelease(&metaPage->copyBlknoLock);
 		return false;
@@ -699,6 +994,10 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink, FileExtent *
 		extent->off = offset;
 		extent->len = len;
 
+		if (compressed && o_decompress_cache_enabled() &&
+			o_decompress_cache_lookup(desc, offset, img))
+			return true;
+
 		byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
 		read_size = len * ORIOLEDB_COMP_BLCKSZ;
 
@@ -709,13 +1008,49 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink, FileExtent *
 			OCompressHeader header;
 
 			memcpy(&header, buf, sizeof(OCompressHeader));
-			o_decompress_page(buf + sizeof(OCompressHeader), header, img);
+			o_decompress_page(buf + sizeof(OCompressHeader), header, img,
+							  desc->compressDict);
+			if (o_decompress_cache_enabled())
+				o_decompress_cache_store(desc, offset, img);
 		}
 	}
 
 	return !err;
 }
 
+/*
+ * Hints the OS to prefetch the page referenced by a valid on-disk downlink.
+ * The page will be read by read_page_from_disk() shortly.
+ */
+void
+prefetch_page_from_disk(BTreeDescr *desc, uint64 downlink)
+{
+	off_t		byte_offset,
+				size;
+	uint64		offset = DOWNLINK_GET_DISK_OFF(downlink);
+	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
+
+	Assert(FileExtentOffIsValid(offset));
+	Assert(FileExtentLenIsValid(len));
+
+	if (!OCompressIsValid(desc->compress))
+	{
+		Assert(len == 1);
+		if (use_device)
+			byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		else
+			byte_offset = (off_t) offset * (off_t) ORIOLEDB_BLCKSZ;
+		size = ORIOLEDB_BLCKSZ;
+	}
+	else
+	{
+		byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		size = len * ORIOLEDB_COMP_BLCKSZ;
+	}
+
+	btree_smgr_prefetch(desc, byte_offset, size);
+}
+
 /*
  * Writes a page to the disk. An array of file offsets must be valid.
  */
@@ -745,12 +1080,21 @@ write_page_to_disk(BTreeDescr *desc, FileExtent *extent,
 	}
 	else
 	{
+		/*
+		 * The extent might be a reused one whose previous content is still
+		 * cached.  Drop the cache entry before the downlink to the extent
+		 * gets published.
+		 */
+		if (o_decompress_cache_enabled())
+			o_decompress_cache_invalidate(desc, extent->off);
+
 		byte_offset = (off_t) extent->off * (off_t) ORIOLEDB_COMP_BLCKSZ;
 
 		if (page_size != ORIOLEDB_BLCKSZ)
 		{
-			/* we need to write header first */
+			/* prepend the header, so header and data go in a single write */
 			OCompressHeader header = page_size;
+			char		buf[ORIOLEDB_BLCKSZ];
 
 			/*
 			 * overflow protection
@@ -759,27 +1103,57 @@ write_page_to_disk(BTreeDescr *desc, FileExtent *extent,
 			Assert(sizeof(OCompressHeader) == sizeof(uint16));
 			Assert(ORIOLEDB_BLCKSZ < UINT16_MAX);
 
-			write_size = sizeof(OCompressHeader);
-			err = btree_smgr_write(desc, (char *) &header, write_size, byte_offset) != write_size;
-			byte_offset += write_size;
+			write_size = extent->len * ORIOLEDB_COMP_BLCKSZ;
+			Assert(write_size <= sizeof(buf));
+			memcpy(buf, &header, sizeof(OCompressHeader));
+			memcpy(buf + sizeof(OCompressHeader), page,
+				   write_size - sizeof(OCompressHeader));
 
-			if (err)
-				return false;
-
-			write_size = extent->len * ORIOLEDB_COMP_BLCKSZ - sizeof(OCompressHeader);
+			err = btree_smgr_write(desc, buf, write_size, byte_offset) != write_size;
 		}
 		else
 		{
 			write_size = ORIOLEDB_BLCKSZ;
-		}
 
-		/* write data */
-		err = btree_smgr_write(desc, page, write_size, byte_offset) != write_size;
+			/* write data */
+			err = btree_smgr_write(desc, page, write_size, byte_offset) != write_size;
+		}
 	}
 
 	return !err;
 }
 
+/*
+ * Drop an evicted extent from the device mapping.  The page was evicted for
+ * coldness, so keeping it resident in the mapping duplicates the memory the
+ * page pool just reclaimed.  Only the OS pages fully covered by the extent
+ * are dropped: this is a hint and need not be exact.
+ */
+static void
+mmap_dontneed_extent(BTreeDescr *desc, uint64 downlink)
+{
+	off_t		byte_offset,
+				byte_end;
+	uint64		offset = DOWNLINK_GET_DISK_OFF(downlink);
+	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
+
+	Assert(use_mmap);
+	Assert(DOWNLINK_IS_ON_DISK(downlink));
+
+	byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+	if (!OCompressIsValid(desc->compress))
+		byte_end = byte_offset + ORIOLEDB_BLCKSZ;
+	else
+		byte_end = byte_offset + (off_t) len * (off_t) ORIOLEDB_COMP_BLCKSZ;
+	Assert(byte_end <= device_length);
+
+	byte_offset = TYPEALIGN(4096, byte_offset);
+	byte_end = TYPEALIGN_DOWN(4096, byte_end);
+	if (byte_end > byte_offset)
+		(void) madvise(mmap_data + byte_offset, byte_end - byte_offset,
+					   MADV_DONTNEED);
+}
+
 /*
  * Load the page where context is pointing from disk to memory, assuming parent
  * page is locked.
@@ -855,7 +1229,9 @@ load_page(OBTreeFindPageContext *context)
 
 	put_page_image(blkno, buf);
 	page_change_usage_count(&desc->ppool->ucm, blkno,
-							(pg_atomic_read_u32(desc->ppool->ucm.epoch) + 2) % UCM_USAGE_LEVELS);
+							ucm_admission_usage_count(&desc->ppool->ucm,
+													  ((uint64) desc->oids.relnode << 32) ^
+													  DOWNLINK_GET_DISK_OFF(downlink)));
 	page_desc->type = parent_page_desc->type;
 	page_desc->oids = parent_page_desc->oids;
 
@@ -947,7 +1323,8 @@ get_write_img(BTreeDescr *desc, Page page, size_t *size)
 
 	if (OCompressIsValid(desc->compress))
 	{
-		result = o_compress_page(page, size, desc->compress);
+		result = o_compress_page(page, size, desc->compress,
+								 desc->compressDict);
 		if (*size > (ORIOLEDB_BLCKSZ - ORIOLEDB_COMP_BLCKSZ - sizeof(OCompressHeader)))
 		{
 			/*
@@ -962,6 +1339,10 @@ get_write_img(BTreeDescr *desc, Page page, size_t *size)
 		result = page;
 		*size = ORIOLEDB_BLCKSZ;
 	}
+
+	O_TREE_STAT_ADD(desc, writeBytesRaw, ORIOLEDB_BLCKSZ);
+	O_TREE_STAT_ADD(desc, writeBytesCompressed, *size);
+
 	return result;
 }
 
@@ -1042,6 +1423,8 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 		 * relocate it in order to implement copy-on-write checkpointing.
 		 */
 
+		uint64		offsetHint = InvalidFileExtentOff;
+
 		if (FileExtentIsValid(page_desc->fileExtent))
 		{
 #ifdef USE_ASSERT_CHECKING
@@ -1058,19 +1441,21 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 			Assert(desc->tmpBuf[chkp_index].shared->tag.num == checkpoint_number);
 			SpinLockRelease(&desc->tmpBuf[chkp_index].shared->lock);
 #endif
+			offsetHint = page_desc->fileExtent.off;
 			free_extent_for_checkpoint(desc, &page_desc->fileExtent, checkpoint_number);
 		}
 
 		/* Get free disk page to locate new page image */
 		if (copy_blkno)
 		{
-			err = !get_free_disk_extent_copy_blkno(desc, write_size,
+			err = !get_free_disk_extent_copy_blkno(desc, write_size, offsetHint,
 												   &page_desc->fileExtent,
 												   checkpoint_number);
 		}
 		else
 		{
-			err = !get_free_disk_extent(desc, write_size, &page_desc->fileExtent);
+			err = !get_free_disk_extent(desc, write_size, offsetHint,
+										&page_desc->fileExtent);
 		}
 
 		*dirty_parent = true;
@@ -1098,17 +1483,20 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 			 */
 			if (page_desc->fileExtent.len < new_len)
 			{
+				uint64		offsetHint = page_desc->fileExtent.off;
+
 				free_extent_for_checkpoint(desc, &page_desc->fileExtent, checkpoint_number);
 				/* allocate more file blocks */
 				if (copy_blkno)
 				{
 					err = !get_free_disk_extent_copy_blkno(desc, write_size,
+														   offsetHint,
 														   &page_desc->fileExtent,
 														   checkpoint_number);
 				}
 				else
 				{
-					err = !get_free_disk_extent(desc, write_size,
+					err = !get_free_disk_extent(desc, write_size, offsetHint,
 												&page_desc->fileExtent);
 				}
 			}
@@ -1174,7 +1562,7 @@ perform_page_io_autonomous(BTreeDescr *desc, Page img, FileExtent *extent)
 
 	write_img = get_write_img(desc, img, &write_size);
 
-	if (!get_free_disk_extent(desc, write_size, extent))
+	if (!get_free_disk_extent(desc, write_size, InvalidFileExtentOff, extent))
 	{
 		ereport(PANIC, (errcode_for_file_access(),
 						errmsg("could not get free file offset for write page to file %s",
@@ -1313,6 +1701,11 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 	Assert(OInMemoryBlknoIsValid(desc->rootInfo.rootPageBlkno));
 	Assert(page_is_locked(blkno));
 	EA_EVICT_INC(blkno);
+	if (evict)
+	{
+		O_TREE_STAT_INC(desc, evictions);
+		OTRACEPOINT(OTRACEPOINT_PAGE_EVICT, blkno, desc->oids.relnode);
+	}
 
 	if (!is_root)
 	{
@@ -1381,10 +1774,14 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 										   checkpoint_number, copy_blkno, &dirty_parent);
 
 			if (DiskDownlinkIsValid(new_downlink))
+			{
 				writeback_put_extent(&io_writeback, desc, new_downlink);
+				if (use_mmap)
+					mmap_dontneed_extent(desc, new_downlink);
+			}
 
 			/* Page is not dirty anymore */
-			CLEAN_DIRTY(desc->ppool, blkno);
+			CLEAN_DIRTY(desc, blkno);
 		}
 		else
 		{
@@ -1411,7 +1808,7 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 			/* Clean dirty only if there are no concurrent writes */
 			lock_page(blkno);
 			if (!IS_DIRTY_CONCURRENT(blkno))
-				CLEAN_DIRTY(desc->ppool, blkno);
+				CLEAN_DIRTY(desc, blkno);
 			unlock_page(blkno);
 
 			if (!DiskDownlinkIsValid(new_downlink))
@@ -1474,7 +1871,7 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 			else
 			{
 				if (dirty_parent)
-					MARK_DIRTY(desc->ppool, parent_blkno);
+					MARK_DIRTY(desc, parent_blkno);
 
 				if (evict)
 				{
@@ -1499,7 +1896,8 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 static void
 btree_finalize_private_seq_bufs(BTreeDescr *desc, EvictedTreeData *evicted_data)
 {
-	int			chkp_index;
+	int			chkp_index,
+				i;
 	bool		is_compressed = OCompressIsValid(desc->compress);
 
 	chkp_index = SEQ_BUF_SHARED_EXIST(desc->nextChkp[0].shared) ? 0 : 1;
@@ -1520,19 +1918,19 @@ btree_finalize_private_seq_bufs(BTreeDescr *desc, EvictedTreeData *evicted_data)
 	{
 		evicted_data->freeBuf.tag = desc->freeBuf.shared->tag;
 		evicted_data->freeBuf.offset = seq_buf_finalize(&desc->freeBuf);
-		FREE_PAGE_IF_VALID(desc->ppool, desc->freeBuf.shared->pages[0]);
-		FREE_PAGE_IF_VALID(desc->ppool, desc->freeBuf.shared->pages[1]);
+		for (i = 0; i < SEQ_BUF_PAGES; i++)
+			FREE_PAGE_IF_VALID(desc->ppool, desc->freeBuf.shared->pages[i]);
 	}
 
 	evicted_data->nextChkp.tag = desc->nextChkp[chkp_index].shared->tag;
 	evicted_data->nextChkp.offset = seq_buf_finalize(&desc->nextChkp[chkp_index]);
-	FREE_PAGE_IF_VALID(desc->ppool, desc->nextChkp[chkp_index].shared->pages[0]);
-	FREE_PAGE_IF_VALID(desc->ppool, desc->nextChkp[chkp_index].shared->pages[1]);
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
+		FREE_PAGE_IF_VALID(desc->ppool, desc->nextChkp[chkp_index].shared->pages[i]);
 
 	evicted_data->tmpBuf.tag = desc->tmpBuf[chkp_index].shared->tag;
 	evicted_data->tmpBuf.offset = seq_buf_finalize(&desc->tmpBuf[chkp_index]);
-	FREE_PAGE_IF_VALID(desc->ppool, desc->tmpBuf[chkp_index].shared->pages[0]);
-	FREE_PAGE_IF_VALID(desc->ppool, desc->tmpBuf[chkp_index].shared->pages[1]);
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
+		FREE_PAGE_IF_VALID(desc->ppool, desc->tmpBuf[chkp_index].shared->pages[i]);
 }
 
 /*
@@ -1565,7 +1963,7 @@ evict_btree(BTreeDescr *desc, uint32 checkpoint_number)
 	{
 		bool		not_used;
 
-		CLEAN_DIRTY(desc->ppool, root_blkno);
+		CLEAN_DIRTY(desc, root_blkno);
 
 		/* Code above ensured there is no IO in progress */
 		Assert(root_desc->ionum < 0);
@@ -1596,6 +1994,7 @@ evict_btree(BTreeDescr *desc, uint32 checkpoint_number)
 
 	file_header.datafileLength = pg_atomic_read_u64(&metaPage->datafileLength);
 	file_header.leafPagesNum = pg_atomic_read_u32(&metaPage->leafPagesNum);
+	file_header.liveTuplesNum = pg_atomic_read_u64(&metaPage->liveTuplesNum);
 	file_header.ctid = pg_atomic_read_u64(&metaPage->ctid);
 	file_header.numFreeBlocks = pg_atomic_read_u64(&metaPage->numFreeBlocks);
 #ifdef USE_ASSERT_CHECKING
@@ -1633,6 +2032,12 @@ evict_btree(BTreeDescr *desc, uint32 checkpoint_number)
 	FileClose(file);
 	pfree(filename);
 
+	/*
+	 * All extent relocations and frees are done, release the in-flight write
+	 * counter before the meta page containing it is freed.
+	 */
+	btree_write_release();
+
 	ppool_free_page(desc->ppool, desc->rootInfo.metaPageBlkno, NULL);
 
 	desc->rootInfo.rootPageBlkno = OInvalidInMemoryBlkno;
@@ -1857,12 +2262,14 @@ retry:
 		return OWalkPageSkipped;
 	}
 
+	btree_write_start(desc);
 	if (!get_checkpoint_number(desc, blkno, &checkpoint_number, &copy_blkno))
 	{
 		unlock_page(blkno);
 
 		if (!is_root)
 			unlock_page(context.items[context.index].blkno);
+		btree_write_finish();
 		return OWalkPageSkipped;
 	}
 
@@ -1911,6 +2318,7 @@ retry:
 				if (!recovery)
 					o_tables_rel_unlock_extended(&oids, AccessExclusiveLock, false);
 				o_tables_rel_unlock_extended(&oids, AccessExclusiveLock, true);
+				btree_write_finish();
 				return result ? OWalkPageEvicted : OWalkPageSkipped;
 			}
 			else
@@ -1920,6 +2328,7 @@ retry:
 			}
 		}
 		unlock_page(blkno);
+		btree_write_finish();
 		return OWalkPageSkipped;
 	}
 
@@ -1929,9 +2338,125 @@ retry:
 
 	STOPEVENT(STOPEVENT_AFTER_WRITE_PAGE, NULL);
 
+	btree_write_finish();
+
 	return evict ? OWalkPageEvicted : OWalkPageWritten;
 }
 
+/*
+ * Try to merge the given page with a sibling if it's too sparse.  Unlike
+ * walk_page(), doesn't require the page to be dirty: pages left sparse by
+ * bulk deletes stay clean once written and would otherwise only be merged
+ * when a foreground path stumbles over them.  Never waits for concurrent IO.
+ */
+OWalkPageResult
+merge_page_if_sparse(OInMemoryBlkno blkno)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	BTreeDescr *desc;
+	ORelOids	oids;
+
+	if (!ORelOidsIsValid(page_desc->oids) || page_desc->type == oIndexInvalid)
+		return OWalkPageSkipped;
+
+	if (!try_lock_page(blkno))
+		return OWalkPageSkipped;
+
+	/* page is locked once we get here */
+
+	if (!ORelOidsIsValid(page_desc->oids) || page_desc->type == oIndexInvalid ||
+		O_PAGE_IS(p, PRE_CLEANUP) ||
+		page_desc->ionum >= 0 ||
+		RightLinkIsValid(BTREE_PAGE_GET_RIGHTLINK(p)))
+	{
+		unlock_page(blkno);
+		return OWalkPageSkipped;
+	}
+
+	oids = page_desc->oids;
+	if (IS_SYS_TREE_OIDS(oids))
+	{
+		if (sys_tree_get_storage_type(oids.relnode) != BTreeStorageInMemory)
+		{
+			desc = get_sys_tree(oids.relnode);
+		}
+		else
+		{
+			unlock_page(blkno);
+			return OWalkPageSkipped;
+		}
+	}
+	else
+	{
+		/* Check is this index is visible for us */
+		desc = index_oids_get_btree_descr(oids, page_desc->type);
+
+		if (desc == NULL)
+		{
+			unlock_page(blkno);
+			return OWalkPageSkipped;
+		}
+	}
+
+	if (!is_page_too_sparse(desc, p))
+	{
+		unlock_page(blkno);
+		return OWalkPageSkipped;
+	}
+
+	if (btree_try_merge_and_unlock(desc, blkno, true, false))
+		return OWalkPageMerged;
+
+	/* Merge shouldn't leave us with locked pages. */
+	Assert(!have_locked_pages());
+	return OWalkPageSkipped;
+}
+
+/*
+ * A single background pass over this worker's stride of the main page pool,
+ * merging sparse leaf pages left behind by bulk deletes.  Returns the number
+ * of pages merged, at most maxMerges.
+ */
+int
+merge_sparse_pages_pass(int workerId, int workersCount, int maxMerges,
+						volatile sig_atomic_t *shutdown_requested)
+{
+	OPagePool  *pool = get_ppool(OPagePoolMain);
+	OInMemoryBlkno blkno,
+				end = pool->offset + pool->size;
+	int			merged = 0;
+
+	for (blkno = pool->offset + workerId; blkno < end; blkno += workersCount)
+	{
+		OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+		Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+
+		if (*shutdown_requested || merged >= maxMerges)
+			break;
+
+		/*
+		 * Unlocked prechecks: merge_page_if_sparse() re-checks everything
+		 * under the page lock, so a race here only costs a skipped page or
+		 * a wasted attempt.  The sparseness precheck doesn't count the
+		 * space vacated by deleted tuples, which requires the descriptor:
+		 * the exact check under the lock may still find more.
+		 */
+		if (!ORelOidsIsValid(page_desc->oids) || page_desc->type == oIndexInvalid)
+			continue;
+		if (!O_PAGE_IS(p, LEAF))
+			continue;
+		if (((double) (BTREE_PAGE_FREE_SPACE(p) + PAGE_GET_N_VACATED(p)) /
+			 ORIOLEDB_BLCKSZ) < merge_sparse_ratio)
+			continue;
+
+		if (merge_page_if_sparse(blkno) == OWalkPageMerged)
+			merged++;
+	}
+
+	return merged;
+}
+
 static bool
 write_tree_pages_recursive(OInMemoryBlkno blkno, uint32 changeCount,
 						   int maxLevel, bool evict)
@@ -2142,6 +2667,78 @@ writeback_put_extent(IOWriteBack *writeback, BTreeDescr *desc,
 	}
 }
 
+#ifdef USE_LIBURING
+/*
+ * Try to queue an asynchronous flush of the given file range.  Returns false
+ * if the ring isn't available, then the caller falls back to the synchronous
+ * FileWriteback() path.
+ */
+static bool
+writeback_queue_flush(File file, off_t offset, off_t nbytes)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+
+	if (writeback_ring_failed)
+		return false;
+
+	if (!writeback_ring_initialized)
+	{
+		if (io_uring_queue_init(WRITEBACK_URING_DEPTH, &writeback_ring, 0) < 0)
+		{
+			writeback_ring_failed = true;
+			return false;
+		}
+		writeback_ring_initialized = true;
+	}
+
+	/* Opportunistically reap finished requests */
+	while (writeback_ring_inflight > 0 &&
+		   io_uring_peek_cqe(&writeback_ring, &cqe) == 0)
+	{
+		io_uring_cqe_seen(&writeback_ring, cqe);
+		writeback_ring_inflight--;
+	}
+
+	/* If the ring is full, wait for half of the requests to finish */
+	while (writeback_ring_inflight >= WRITEBACK_URING_DEPTH / 2)
+	{
+		if (io_uring_wait_cqe(&writeback_ring, &cqe) < 0)
+			return false;
+		io_uring_cqe_seen(&writeback_ring, cqe);
+		writeback_ring_inflight--;
+	}
+
+	sqe = io_uring_get_sqe(&writeback_ring);
+	if (sqe == NULL)
+		return false;
+
+	/*
+	 * The kernel takes its own file reference on submission, so the
+	 * subsequent FileClose() of the vfd is fine.
+	 */
+	io_uring_prep_sync_file_range(sqe, FileGetRawDesc(file), nbytes, offset,
+								  SYNC_FILE_RANGE_WRITE);
+	if (io_uring_submit(&writeback_ring) < 0)
+		return false;
+	writeback_ring_inflight++;
+	return true;
+}
+#endif
+
+/*
+ * Flush the accumulated range of the file, asynchronously if possible.
+ */
+static void
+writeback_flush_range(File file, off_t offset, off_t nbytes)
+{
+#ifdef USE_LIBURING
+	if (writeback_queue_flush(file, offset, nbytes))
+		return;
+#endif
+	FileWriteback(file, offset, nbytes, WAIT_EVENT_DATA_FILE_FLUSH);
+}
+
 static void
 perform_writeback(IOWriteBack *writeback)
 {
@@ -2186,9 +2783,8 @@ perform_writeback(IOWriteBack *writeback)
 			{
 				if (len > 0)
 				{
-					FileWriteback(file, (off_t) offset * blcksz,
-								  (off_t) len * blcksz,
-								  WAIT_EVENT_DATA_FILE_FLUSH);
+					writeback_flush_range(file, (off_t) offset * blcksz,
+										  (off_t) len * blcksz);
 				}
 				if (file >= 0)
 					FileClose(file);
@@ -2205,9 +2801,9 @@ perform_writeback(IOWriteBack *writeback)
 				else
 					snprintf(filename, MAXPGPATH, ORIOLEDB_DATA_DIR "/%u_%u.%u", datoid, relnode, segno);
 				file = PathNameOpenFile(filename, O_RDWR | O_CREAT | PG_BINARY);
-				offset = cur.fileExtent.off;
-				len = cur.fileExtent.len;
 			}
+			offset = cur.fileExtent.off;
+			len = cur.fileExtent.len;
 		}
 		else
 		{
@@ -2215,18 +2811,19 @@ perform_writeback(IOWriteBack *writeback)
 			{
 				continue;
 			}
-			else if (cur.fileExtent.off == offset + len)
+			else if (cur.fileExtent.off >= offset + len &&
+					 cur.fileExtent.off <= offset + len + WRITEBACK_MERGE_GAP)
 			{
-				len += cur.fileExtent.len;
+				/* merge near-adjacent ranges too, see WRITEBACK_MERGE_GAP */
+				len = (cur.fileExtent.off - offset) + cur.fileExtent.len;
 			}
 			else
 			{
 				if (use_mmap)
 					msync(mmap_data + (off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz, MS_ASYNC);
 				else
-					FileWriteback(file, (off_t) offset * blcksz,
-								  (off_t) len * blcksz,
-								  WAIT_EVENT_DATA_FILE_FLUSH);
+					writeback_flush_range(file, (off_t) offset * blcksz,
+										  (off_t) len * blcksz);
 				offset = cur.fileExtent.off;
 				len = cur.fileExtent.len;
 			}
@@ -2239,9 +2836,8 @@ perform_writeback(IOWriteBack *writeback)
 		if (use_mmap)
 			msync(mmap_data + (off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz, MS_ASYNC);
 		else
-			FileWriteback(file, (off_t) offset * blcksz,
-						  (off_t) len * blcksz,
-						  WAIT_EVENT_DATA_FILE_FLUSH);
+			writeback_flush_range(file, (off_t) offset * blcksz,
+								  (off_t) len * blcksz);
 	}
 
 	if (!use_mmap && file >= 0)
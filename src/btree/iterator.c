@@ -219,6 +219,90 @@ o_btree_find_tuple_by_key(BTreeDescr *desc, void *key, BTreeKeyType kind,
 										mcxt, hint, NULL, NULL, NULL);
 }
 
+/*
+ * Fetch a batch of sorted keys, amortizing the tree descent: after a leaf
+ * image is found for the current key, all subsequent keys that fall under
+ * the same page hikey are served from that image before the next descent.
+ *
+ * keys[] must be sorted in the tree key order.  For each key, tuples[i] is
+ * set to the found tuple allocated in mcxt, or to NULL tuple.  When outCsns
+ * is given, outCsns[i] is filled the same way as for a single-key fetch.
+ * Returns the number of found tuples.
+ */
+int
+o_btree_find_tuples_batch(BTreeDescr *desc, void **keys, BTreeKeyType kind,
+						  int nkeys, CommitSeqNo readCsn, CommitSeqNo *outCsns,
+						  MemoryContext mcxt, OTuple *tuples)
+{
+	OBTreeFindPageContext context;
+	Page		img;
+	int			i = 0,
+				nfound = 0;
+
+	Assert(COMMITSEQNO_IS_NORMAL(readCsn) || COMMITSEQNO_IS_INPROGRESS(readCsn));
+
+	init_page_find_context(&context, desc, readCsn, BTREE_PAGE_FIND_FETCH);
+	img = context.img;
+
+	while (i < nkeys)
+	{
+		bool		pageValid = true;
+
+		(void) find_page(&context, keys[i], kind, 0);
+
+		/*
+		 * Serve all keys covered by the current leaf image.  The image is
+		 * consistent with readCsn, so only the page fences limit how far we
+		 * can go.
+		 */
+		while (pageValid && i < nkeys)
+		{
+			BTreePageItemLocator loc;
+
+			if (!btree_page_search(desc, img, keys[i], kind,
+								   &context.partial, &loc) ||
+				!page_locator_find_real_item(img, &context.partial, &loc) ||
+				!partial_load_chunk(&context.partial, img, loc.chunkOffset))
+			{
+				/* Concurrent page change: re-find the page for this key */
+				pageValid = false;
+				break;
+			}
+
+			O_TUPLE_SET_NULL(tuples[i]);
+			if (BTREE_PAGE_LOCATOR_IS_VALID(img, &loc))
+			{
+				OTuple		curTuple;
+
+				BTREE_PAGE_READ_LEAF_TUPLE(curTuple, img, &loc);
+				if (o_btree_cmp(desc, keys[i], kind,
+								&curTuple, BTreeKeyLeafTuple) == 0)
+				{
+					tuples[i] = o_find_tuple_version(desc, img, &loc, readCsn,
+													 outCsns ? &outCsns[i] : NULL,
+													 mcxt, NULL, NULL);
+					if (!O_TUPLE_IS_NULL(tuples[i]))
+						nfound++;
+				}
+			}
+			i++;
+
+			/* Does the image cover the next key too? */
+			if (i < nkeys && !O_PAGE_IS(img, RIGHTMOST))
+			{
+				OTuple		hikey;
+
+				BTREE_PAGE_GET_HIKEY(hikey, img);
+				if (o_btree_cmp(desc, keys[i], kind,
+								&hikey, BTreeKeyNonLeafKey) >= 0)
+					break;
+			}
+		}
+	}
+
+	return nfound;
+}
+
 
 /*
  * Finds appropriate tuple version in the undo chain.
@@ -321,9 +405,12 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 		}
 		else
 		{
+			OTuple		prevTuple = curTuple;
+
+			get_prev_leaf_header_and_tuple_from_undo(&tupHdr, &curTuple, 0,
+													 prevTuple);
 			if (curTupleAllocated)
-				pfree(curTuple.data);
-			get_prev_leaf_header_and_tuple_from_undo(&tupHdr, &curTuple, 0);
+				pfree(prevTuple.data);
 			curTupleAllocated = true;
 		}
 
@@ -501,6 +588,55 @@ o_btree_iterator_fetch(BTreeIterator *it, CommitSeqNo *tupleCsn,
 	return result;
 }
 
+/*
+ * Fetch up to `max` tuples in a single call.  Per-tuple semantics are the
+ * same as of o_btree_iterator_fetch(), but the batch stops once the already
+ * loaded leaf (and undo) images are drained: stepping to the next page is
+ * left to the next call, so a single call does a bounded amount of work and
+ * the caller can consume the batch in between.
+ *
+ * Fetched tuples are stored into tuples[]; tupleCsns[] (if given) is filled
+ * in parallel.  Returns the number of fetched tuples.  *scanEnd is set once
+ * the end bound or the tree end is reached; tuples fetched before that are
+ * still returned.
+ */
+int
+o_btree_iterator_fetch_batch(BTreeIterator *it, CommitSeqNo *tupleCsns,
+							 void *end, BTreeKeyType endType,
+							 bool endIsIncluded, BTreeLocationHint *hint,
+							 OTuple *tuples, int max, bool *scanEnd)
+{
+	int			count = 0;
+
+	*scanEnd = false;
+	while (count < max)
+	{
+		OTuple		tuple;
+
+		tuple = o_btree_iterator_fetch(it, tupleCsns ? &tupleCsns[count] : NULL,
+									   end, endType, endIsIncluded, hint);
+
+		if (O_TUPLE_IS_NULL(tuple))
+		{
+			*scanEnd = true;
+			break;
+		}
+		tuples[count++] = tuple;
+
+		/*
+		 * Continue only while further tuples can be served from the current
+		 * images.
+		 */
+		if (!BTREE_PAGE_LOCATOR_IS_VALID(it->context.img,
+										 &it->context.items[it->context.index].locator) &&
+			!(it->combinedPage &&
+			  BTREE_PAGE_LOCATOR_IS_VALID(it->undoIt.image, &it->undoLoc)))
+			break;
+	}
+
+	return count;
+}
+
 /*
  * Free resouces associated with iterator.
  */
@@ -25,11 +25,6 @@
 
 #include "miscadmin.h"
 
-/*
- * If the ratio of free to total space on a leaf page is greater than the value
- * then we will try to merge the node page.
- */
-#define O_MERGE_LEAF_FREE_RATIO (0.7)
 /*
  * If the ratio of free to total space on a node page is greater than the value
  * then we will try to merge the node page.
@@ -72,12 +67,15 @@ btree_try_merge_pages(BTreeDescr *desc,
 		return false;
 	}
 
+	/* The merge is going to free an extent, account it in-flight */
+	btree_write_start(desc);
 	if (!get_checkpoint_number(desc, right_blkno,
 							   &checkpoint_number, &copy_blkno))
 	{
 		/*
 		 * page is concurrent to in progress checkpoint and can not be merged
 		 */
+		btree_write_finish();
 		return false;
 	}
 
@@ -93,6 +91,7 @@ btree_try_merge_pages(BTreeDescr *desc,
 
 	if (!can_be_merged(desc, left, right, csn))
 	{
+		btree_write_finish();
 		return false;
 	}
 
@@ -103,7 +102,7 @@ btree_try_merge_pages(BTreeDescr *desc,
 	page_block_reads(parent_blkno);
 
 	page_locator_delete_item(parent, &right_loc);
-	MARK_DIRTY(desc->ppool, parent_blkno);
+	MARK_DIRTY(desc, parent_blkno);
 
 	/* unlocks the parent page */
 	if (*merge_parent && is_page_too_sparse(desc, parent))
@@ -151,7 +150,7 @@ btree_try_merge_pages(BTreeDescr *desc,
 	 */
 	merge_pages(desc, left_blkno, right, csn);
 	btree_page_update_max_key_len(desc, left);
-	MARK_DIRTY(desc->ppool, left_blkno);
+	MARK_DIRTY(desc, left_blkno);
 
 	/* the right page can not be found in B-Tree after this line */
 
@@ -169,7 +168,7 @@ btree_try_merge_pages(BTreeDescr *desc,
 	right_desc = O_GET_IN_MEMORY_PAGEDESC(right_blkno);
 	right_extent = right_desc->fileExtent;
 
-	CLEAN_DIRTY(desc->ppool, right_blkno);
+	CLEAN_DIRTY(desc, right_blkno);
 	O_PAGE_CHANGE_COUNT_INC(right);
 
 	ppool_free_page(desc->ppool, right_blkno, true);
@@ -185,6 +184,8 @@ btree_try_merge_pages(BTreeDescr *desc,
 								   checkpoint_number);
 	}
 
+	btree_write_finish();
+
 	return true;
 }
 
@@ -546,6 +547,8 @@ merge_pages(BTreeDescr *desc, OInMemoryBlkno left_blkno,
 	Assert(O_PAGE_IS(left, LEAF) == O_PAGE_IS(right, LEAF));
 	Assert(!O_PAGE_IS(left, RIGHTMOST));
 
+	O_TREE_STAT_INC(desc, merges);
+
 	leftHikeySize = BTREE_PAGE_GET_HIKEY_SIZE(left);
 	BTREE_PAGE_GET_HIKEY(leftHikey, left);
 	if (O_PAGE_IS(right, RIGHTMOST))
@@ -659,6 +662,8 @@ merge_pages(BTreeDescr *desc, OInMemoryBlkno left_blkno,
 
 	left_header->rightLink = InvalidRightLink;
 	left_header->prevInsertOffset = InvalidOffsetNumber;
+	/* the merged content no longer reflects either page's insert pattern */
+	left_header->insertPattern = 0;
 }
 
 /*
@@ -684,11 +689,11 @@ is_page_too_sparse(BTreeDescr *desc, Page p)
 			return true;
 
 		space_free = BTREE_PAGE_FREE_SPACE(p) + PAGE_GET_N_VACATED(p);
-		if (((double) space_free / ORIOLEDB_BLCKSZ) < O_MERGE_LEAF_FREE_RATIO)
+		if (((double) space_free / ORIOLEDB_BLCKSZ) < merge_sparse_ratio)
 			return false;
 
 		space_free = BTREE_PAGE_FREE_SPACE(p) + page_get_vacated_space(desc, p, 0);
-		return ((double) space_free / ORIOLEDB_BLCKSZ) >= O_MERGE_LEAF_FREE_RATIO;
+		return ((double) space_free / ORIOLEDB_BLCKSZ) >= merge_sparse_ratio;
 	}
 	else
 	{
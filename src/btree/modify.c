@@ -21,11 +21,13 @@
 #include "btree/modify.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
+#include "btree/unique_filter.h"
 #include "catalog/o_tables.h"
 #include "recovery/recovery.h"
 #include "recovery/wal.h"
 #include "transam/undo.h"
 #include "transam/oxid.h"
+#include "utils/o_latency.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 
@@ -33,6 +35,12 @@
 
 #define IsRelationTree(desc) (ORelOidsIsValid(desc->oids) && !IS_SYS_TREE_OIDS(desc->oids))
 
+StaticAssertDecl((int) OLatencyInsert == (int) BTreeOperationInsert &&
+				 (int) OLatencyLock == (int) BTreeOperationLock &&
+				 (int) OLatencyUpdate == (int) BTreeOperationUpdate &&
+				 (int) OLatencyDelete == (int) BTreeOperationDelete,
+				 "OLatencyOperation mirrors BTreeOperationType");
+
 /*
  * Context for o_btree_modify_internal()
  */
@@ -425,12 +433,20 @@ o_btree_modify_handle_conflicts(BTreeModifyInternalContext *context)
 
 		if (oxid == context->opOxid)
 		{
+			/*
+			 * A delta-encoded undo record reconstructs the old tuple version
+			 * from its successor.  So, if our own previous undo record is a
+			 * delta, the page tuple must not be replaced in-place: chain a
+			 * new undo record instead.
+			 */
 			if (context->action == BTreeOperationLock ||
 				(UndoLocationIsValid(context->savepointUndoLocation) &&
 				 (!UndoLocationIsValid(context->conflictTupHdr.undoLocation) ||
 				  context->conflictTupHdr.undoLocation < context->savepointUndoLocation)) ||
 				o_btree_needs_undo(desc, context->action, curTuple, xactInfo,
-								   tuphdr->deleted, context->tuple, context->opOxid))
+								   tuphdr->deleted, context->tuple, context->opOxid) ||
+				(UndoLocationIsValid(context->conflictTupHdr.undoLocation) &&
+				 undo_record_is_delta_update(context->conflictTupHdr.undoLocation)))
 			{
 				context->needsUndo = true;
 			}
@@ -481,7 +497,7 @@ o_btree_modify_handle_conflicts(BTreeModifyInternalContext *context)
 										&context->conflictTupHdr,
 										context->conflictUndoLocation))
 					context->cmp = -1;
-				MARK_DIRTY(desc->ppool, blkno);
+				MARK_DIRTY(desc, blkno);
 				END_CRIT_SECTION();
 			}
 			else if (COMMITSEQNO_IS_NORMAL(csn) || COMMITSEQNO_IS_FROZEN(csn))
@@ -632,7 +648,7 @@ o_btree_modify_item_rollback(BTreeModifyInternalContext *context)
 	applyResult = page_item_rollback(desc, page, &loc, false,
 									 &context->conflictTupHdr,
 									 context->conflictUndoLocation);
-	MARK_DIRTY(desc->ppool, blkno);
+	MARK_DIRTY(desc, blkno);
 	END_CRIT_SECTION();
 
 	if (!applyResult)
@@ -661,6 +677,84 @@ o_btree_modify_insert_update(BTreeModifyInternalContext *context)
 
 	/* no more sense in that */
 	BTREE_PAGE_FIND_UNSET(pageFindContext, FIX_LEAF_SPLIT);
+
+	/*
+	 * Account the new live tuple.  A replacement of a live tuple is an
+	 * update: the count doesn't change.
+	 */
+	if (!context->replace)
+	{
+		pg_atomic_fetch_add_u64(&BTREE_GET_META(desc)->liveTuplesNum, 1);
+	}
+	else
+	{
+		OInMemoryBlkno itemBlkno = pageFindContext->items[pageFindContext->index].blkno;
+		BTreePageItemLocator itemLoc = pageFindContext->items[pageFindContext->index].locator;
+		BTreeLeafTuphdr *prevTuphdr;
+
+		prevTuphdr = (BTreeLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(O_GET_IN_MEMORY_PAGE(itemBlkno), &itemLoc);
+		if (prevTuphdr->deleted)
+			pg_atomic_fetch_add_u64(&BTREE_GET_META(desc)->liveTuplesNum, 1);
+	}
+
+	/*
+	 * Fast path: a replacement that fits into the existing page item (the
+	 * common case for updates which don't grow the tuple, e.g. counters) is
+	 * written over the old tuple directly, skipping the insert machinery
+	 * with its fit checks and page-space reshuffling.  The undo record made
+	 * above keeps the old version reachable as usual.
+	 */
+	if (context->replace)
+	{
+		OInMemoryBlkno blkno = pageFindContext->items[pageFindContext->index].blkno;
+		BTreePageItemLocator loc = pageFindContext->items[pageFindContext->index].locator;
+		Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+		BTreePageHeader *header = (BTreePageHeader *) p;
+		LocationIndex newItemSize = MAXALIGN(tuplen) + BTreeLeafTuphdrSize;
+
+		Assert(O_PAGE_IS(p, LEAF));
+
+		if (newItemSize <= BTREE_PAGE_GET_ITEM_SIZE(p, &loc))
+		{
+			BTreeLeafTuphdr prev;
+			Pointer		ptr;
+
+			prev = *((BTreeLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc));
+
+			START_CRIT_SECTION();
+			page_block_reads(blkno);
+
+			/*
+			 * Same accounting as the replace branch of the insert path: the
+			 * item isn't resized, so the bytes not covered by the new tuple
+			 * stay vacated until page compaction reclaims them.
+			 */
+			if (!prev.deleted)
+			{
+				OTuple		curTuple;
+
+				BTREE_PAGE_READ_TUPLE(curTuple, p, &loc);
+				PAGE_ADD_N_VACATED(p, BTreeLeafTuphdrSize +
+								   MAXALIGN(o_btree_len(desc, curTuple, OTupleLength)));
+			}
+			PAGE_SUB_N_VACATED(p, newItemSize);
+			header->prevInsertOffset = MaxOffsetNumber;
+
+			ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
+			memcpy(ptr, &context->leafTuphdr, BTreeLeafTuphdrSize);
+			ptr += BTreeLeafTuphdrSize;
+			memcpy(ptr, context->tuple.data, tuplen);
+			BTREE_PAGE_SET_ITEM_FLAGS(p, &loc, context->tuple.formatFlags);
+
+			page_split_chunk_if_needed(desc, p, &loc);
+
+			MARK_DIRTY(desc, blkno);
+			END_CRIT_SECTION();
+			unlock_page(blkno);
+			return;
+		}
+	}
+
 	o_btree_insert_tuple_to_leaf(pageFindContext,
 								 context->tuple, tuplen,
 								 &context->leafTuphdr,
@@ -694,7 +788,7 @@ o_btree_modify_add_undo_record(BTreeModifyInternalContext *context)
 		prevTuphdr = make_undo_record(desc, curTuple, true,
 									  BTreeOperationUpdate, blkno,
 									  O_PAGE_GET_CHANGE_COUNT(page),
-									  &undoLocation);
+									  &undoLocation, &context->tuple);
 		leafTuphdr->undoLocation = undoLocation;
 		leafTuphdr->chainHasLocks = tuphdr->chainHasLocks ||
 			XACT_INFO_IS_LOCK_ONLY(tuphdr->xactInfo);
@@ -709,7 +803,7 @@ o_btree_modify_add_undo_record(BTreeModifyInternalContext *context)
 		(void) make_undo_record(desc, context->tuple, true,
 								BTreeOperationInsert, blkno,
 								O_PAGE_GET_CHANGE_COUNT(page),
-								&undoLocation);
+								&undoLocation, NULL);
 	}
 
 #if PG_VERSION_NUM >= 150000
@@ -790,7 +884,7 @@ o_btree_modify_delete(BTreeModifyInternalContext *context)
 		pageChangeCount = O_PAGE_GET_CHANGE_COUNT(page);
 		prev_tuphdr = make_undo_record(desc, key, key_is_tuple,
 									   BTreeOperationDelete, blkno, pageChangeCount,
-									   &undoLocation);
+									   &undoLocation, NULL);
 		prev_tuphdr->xactInfo = tuphdr->xactInfo;
 		prev_tuphdr->undoLocation = tuphdr->undoLocation;
 		prev_tuphdr->deleted = tuphdr->deleted;
@@ -820,10 +914,12 @@ o_btree_modify_delete(BTreeModifyInternalContext *context)
 
 	PAGE_ADD_N_VACATED(page, BTREE_PAGE_GET_ITEM_SIZE(page, &loc));
 
-	MARK_DIRTY(desc->ppool, blkno);
+	MARK_DIRTY(desc, blkno);
 
 	END_CRIT_SECTION();
 
+	pg_atomic_fetch_sub_u64(&BTREE_GET_META(desc)->liveTuplesNum, 1);
+
 	if (!OXidIsValid(context->opOxid) && is_page_too_sparse(desc, page))
 	{
 		(void) btree_try_merge_and_unlock(desc, blkno, false, false);
@@ -883,7 +979,7 @@ o_btree_modify_lock(BTreeModifyInternalContext *context)
 	pageChangeCount = O_PAGE_GET_CHANGE_COUNT(page);
 	prev_tuphdr = make_undo_record(desc, key, key_is_tuple,
 								   BTreeOperationLock, blkno, pageChangeCount,
-								   &undoLocation);
+								   &undoLocation, NULL);
 	prev_tuphdr->xactInfo = tuphdr->xactInfo;
 	prev_tuphdr->undoLocation = tuphdr->undoLocation;
 	prev_tuphdr->deleted = tuphdr->deleted;
@@ -900,7 +996,7 @@ o_btree_modify_lock(BTreeModifyInternalContext *context)
 										  true);
 	tuphdr->deleted = false;
 
-	MARK_DIRTY(desc->ppool, blkno);
+	MARK_DIRTY(desc, blkno);
 	END_CRIT_SECTION();
 	unlock_release(context, true);
 
@@ -923,6 +1019,59 @@ prepare_modify_start_params(BTreeDescr *desc)
 	return res;
 }
 
+/*
+ * Check if the insertion of the given key can start from the cached
+ * rightmost leaf of the tree instead of the descent from the root.
+ * Monotonically increasing keys (serial primary keys, ordered ingest)
+ * always land on the rightmost leaf, so the cached location saves the
+ * descent for them.
+ *
+ * It's enough to check that the cached page is still the rightmost leaf and
+ * the key is greater than its first item.  The page low bound can only
+ * decrease while the page change count stays the same (merge with the left
+ * sibling), and refind_page() restarts the descent if the page gets split or
+ * evicted concurrently.
+ */
+static bool
+o_btree_check_rightmost_hint(BTreeDescr *desc, Pointer key, BTreeKeyType keyType)
+{
+	BTreeLocationHint *hint = &desc->rightmostHint;
+	Page		p;
+	BTreePageItemLocator loc;
+	OTuple		firstTuple;
+	bool		result;
+
+	if (!OInMemoryBlknoIsValid(hint->blkno))
+		return false;
+
+	p = O_GET_IN_MEMORY_PAGE(hint->blkno);
+	lock_page(hint->blkno);
+	if (O_PAGE_GET_CHANGE_COUNT(p) != hint->pageChangeCount ||
+		!O_PAGE_IS(p, LEAF) ||
+		!O_PAGE_IS(p, RIGHTMOST))
+	{
+		/* The cached page isn't the rightmost leaf anymore, forget it */
+		unlock_page(hint->blkno);
+		hint->blkno = OInvalidInMemoryBlkno;
+		hint->pageChangeCount = InvalidOPageChangeCount;
+		return false;
+	}
+
+	if (BTREE_PAGE_ITEMS_COUNT(p) == 0)
+	{
+		unlock_page(hint->blkno);
+		return false;
+	}
+
+	BTREE_PAGE_LOCATOR_FIRST(p, &loc);
+	BTREE_PAGE_READ_TUPLE(firstTuple, p, &loc);
+	result = (o_btree_cmp(desc, key, keyType,
+						  &firstTuple, BTreeKeyLeafTuple) > 0);
+	unlock_page(hint->blkno);
+
+	return result;
+}
+
 static OBTreeModifyResult
 o_btree_normal_modify(BTreeDescr *desc, BTreeOperationType action,
 					  OTuple tuple, BTreeKeyType tupleType,
@@ -932,6 +1081,7 @@ o_btree_normal_modify(BTreeDescr *desc, BTreeOperationType action,
 					  BTreeModifyCallbackInfo *callbackInfo)
 {
 	OBTreeFindPageContext pageFindContext;
+	OBTreeModifyResult result;
 	Jsonb	   *params = NULL;
 
 	if (STOPEVENTS_ENABLED())
@@ -956,12 +1106,46 @@ o_btree_normal_modify(BTreeDescr *desc, BTreeOperationType action,
 
 	if (hint && OInMemoryBlknoIsValid(hint->blkno))
 		refind_page(&pageFindContext, key, keyType, 0, hint->blkno, hint->pageChangeCount);
+	else if (action == BTreeOperationInsert &&
+			 o_btree_check_rightmost_hint(desc, key, keyType))
+		refind_page(&pageFindContext, key, keyType, 0,
+					desc->rightmostHint.blkno,
+					desc->rightmostHint.pageChangeCount);
 	else
 		(void) find_page(&pageFindContext, key, keyType, 0);
 
-	return o_btree_modify_internal(&pageFindContext, action, tuple, tupleType,
-								   key, keyType, opOxid, opCsn,
-								   lockMode, callbackInfo);
+	result = o_btree_modify_internal(&pageFindContext, action, tuple, tupleType,
+									 key, keyType, opOxid, opCsn,
+									 lockMode, callbackInfo);
+
+	/*
+	 * Remember the leaf page we ended up at.  Callers modifying a sorted
+	 * stream of tuples pass it back as a hint for the next modification,
+	 * saving the descent when consecutive tuples hit the same leaf.
+	 */
+	if (hint)
+	{
+		hint->blkno = pageFindContext.items[pageFindContext.index].blkno;
+		hint->pageChangeCount = pageFindContext.items[pageFindContext.index].pageChangeCount;
+	}
+
+	/*
+	 * Cache the rightmost leaf location for the fast path above.  The page
+	 * is read unlocked here, but a stale cache is safe: it's re-validated
+	 * under the page lock before use.
+	 */
+	if (action == BTreeOperationInsert)
+	{
+		OInMemoryBlkno leafBlkno = pageFindContext.items[pageFindContext.index].blkno;
+
+		if (O_PAGE_IS(O_GET_IN_MEMORY_PAGE(leafBlkno), RIGHTMOST))
+		{
+			desc->rightmostHint.blkno = leafBlkno;
+			desc->rightmostHint.pageChangeCount = pageFindContext.items[pageFindContext.index].pageChangeCount;
+		}
+	}
+
+	return result;
 }
 
 static bool
@@ -1056,6 +1240,7 @@ o_btree_insert_unique(BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType,
 	Page		p;
 	OInMemoryBlkno blkno;
 	uint32		pageChangeCount;
+	uint32		uniqueHash;
 	LWLock	   *uniqueLock;
 	OBTreeModifyResult result;
 	Jsonb	   *params = NULL;
@@ -1088,6 +1273,14 @@ retry:
 	blkno = pageFindContext.items[pageFindContext.index].blkno;
 	pageChangeCount = pageFindContext.items[pageFindContext.index].pageChangeCount;
 	p = O_GET_IN_MEMORY_PAGE(blkno);
+
+	/*
+	 * An empty tree makes the bloom filter verdicts trustworthy for this
+	 * tree from now on.
+	 */
+	if (o_unique_filter_enabled())
+		o_unique_filter_try_cover(desc, p);
+
 	if (O_PAGE_IS(p, RIGHTMOST))
 	{
 		fastpath = true;
@@ -1101,7 +1294,8 @@ retry:
 								key, BTreeKeyUniqueUpperBound) >= 0);
 	}
 
-	uniqueLock = &unique_locks[o_btree_unique_hash(desc, tuple) % num_unique_locks].lock;
+	uniqueHash = o_btree_unique_hash(desc, tuple);
+	uniqueLock = &unique_locks[uniqueHash % num_unique_locks].lock;
 
 	/*---
 	 * We can do fast path unique check if we know that the required key range
@@ -1194,6 +1388,7 @@ retry:
 	else
 	{
 		OTupleXactInfo xactInfo;
+		bool		definitelyAbsent;
 
 		/*
 		 * Evade deadlock: unlock the page before taking an unique lwlock.
@@ -1202,7 +1397,17 @@ retry:
 
 		LWLockAcquire(uniqueLock, LW_EXCLUSIVE);
 
-		if (slowpath_unique_check(desc, &pageFindContext, key,
+		/*
+		 * If the bloom filter covers the tree and proves the key has never
+		 * been inserted, the check descent can be skipped.  The filter has
+		 * to be consulted under the unique lwlock: a concurrent inserter of
+		 * the same key sets the fingerprint before releasing the lock.
+		 */
+		definitelyAbsent = o_unique_filter_covered(desc) &&
+			!o_unique_filter_test(desc, uniqueHash);
+
+		if (!definitelyAbsent &&
+			slowpath_unique_check(desc, &pageFindContext, key,
 								  opOxid, &xactInfo))
 		{
 			Page		p;
@@ -1268,10 +1473,88 @@ retry:
 									 keyType, opOxid, opCsn, lockMode,
 									 callbackInfo);
 
+	/*
+	 * The fingerprint is set before the unique lwlock release, so a
+	 * concurrent check of the same key can't miss it.  Aborted inserts leave
+	 * the fingerprint behind, which only costs a false positive.
+	 */
+	if (result == OBTreeModifyResultInserted && o_unique_filter_enabled())
+		o_unique_filter_insert(desc, uniqueHash);
+
 	LWLockRelease(uniqueLock);
+
+	/* Same as in o_btree_normal_modify(), remember the leaf for the caller */
+	if (hint)
+	{
+		hint->blkno = pageFindContext.items[pageFindContext.index].blkno;
+		hint->pageChangeCount = pageFindContext.items[pageFindContext.index].pageChangeCount;
+	}
+
 	return result;
 }
 
+/*
+ * Read-only probe for a unique conflict: returns true if a live tuple
+ * matching the unique key may be present in the tree.  The answer is not
+ * authoritative, it can change before the insertion takes the unique lwlock,
+ * so the caller still has to run o_btree_insert_unique().  The probe takes
+ * no unique lwlock and works on leaf images, it's meant for reordering and
+ * early detection, see o_tbl_indices_insert().
+ */
+bool
+o_btree_unique_probe(BTreeDescr *desc, OTuple tuple,
+					 Pointer key, BTreeKeyType keyType, OXid opOxid)
+{
+	OBTreeFindPageContext context;
+	OTupleXactInfo xactInfo;
+	OFixedKey	hikey_buf;
+	Page		p;
+
+	Assert(key != NULL && keyType == BTreeKeyBound);
+
+	/* the bloom filter can prove absence without a descent */
+	if (o_unique_filter_covered(desc) &&
+		!o_unique_filter_test(desc, o_btree_unique_hash(desc, tuple)))
+		return false;
+
+	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_IMAGE);
+	(void) find_page(&context, key, BTreeKeyUniqueLowerBound, 0);
+
+	p = context.img;
+
+	while (true)
+	{
+		int			cmp;
+		OTuple		hikey;
+
+		if (page_unique_check(desc, p, &context.items[context.index].locator,
+							  key, opOxid, &xactInfo))
+			return true;
+
+		if (O_PAGE_IS(p, RIGHTMOST))
+			break;
+
+		BTREE_PAGE_GET_HIKEY(hikey, p);
+
+		cmp = o_btree_cmp(desc, &hikey, BTreeKeyNonLeafKey,
+						  key, BTreeKeyUniqueUpperBound);
+		if (cmp > 0)
+			break;
+
+		(void) find_right_page(&context, &hikey_buf);
+
+		/*
+		 * Due to concurrent merges, some tuples might be lower than the
+		 * unique key.  So, we can't just start from the beginning, but have
+		 * to find the right position on the page.
+		 */
+		btree_page_search(desc, p, key, BTreeKeyUniqueLowerBound,
+						  NULL, &context.items[context.index].locator);
+	}
+	return false;
+}
+
 OBTreeModifyResult
 o_btree_modify(BTreeDescr *desc, BTreeOperationType action,
 			   OTuple tuple, BTreeKeyType tupleType,
@@ -1280,6 +1563,11 @@ o_btree_modify(BTreeDescr *desc, BTreeOperationType action,
 			   BTreeLocationHint *hint, BTreeModifyCallbackInfo *callbackInfo)
 {
 	OBTreeModifyResult result;
+	instr_time	start;
+	bool		track = O_LATENCY_TRACKING();
+
+	if (track)
+		INSTR_TIME_SET_CURRENT(start);
 
 	result = o_btree_normal_modify(desc, action,
 								   tuple, tupleType,
@@ -1287,6 +1575,9 @@ o_btree_modify(BTreeDescr *desc, BTreeOperationType action,
 								   oxid, csn, lockMode,
 								   hint, callbackInfo);
 
+	if (track)
+		o_latency_record((OLatencyOperation) action, start);
+
 	return result;
 }
 
@@ -77,6 +77,57 @@ partial_load_chunk(PartialPageState *partial, Page img, OffsetNumber chunkOffset
 	return true;
 }
 
+/*
+ * Decode all items of an internal page into a BTreePageItems snapshot.
+ *
+ * Walks the chunk directory once: each chunk is loaded at most once (the
+ * partial load is batched per chunk instead of being rechecked on every
+ * locator step) and its items are decoded in a tight loop.
+ *
+ * Returns false if a partial chunk load detects a concurrent page change.
+ */
+bool
+btree_page_decode_internal_items(Page p, PartialPageState *partial,
+								 BTreePageItems *items)
+{
+	BTreePageHeader *header = (BTreePageHeader *) p;
+	OffsetNumber chunkOffset;
+	int			i = 0;
+
+	Assert(!O_PAGE_IS(p, LEAF));
+
+	for (chunkOffset = 0; chunkOffset < header->chunksCount; chunkOffset++)
+	{
+		BTreePageChunk *chunk;
+		OffsetNumber chunkItemsCount;
+		OffsetNumber j;
+
+		if (partial && !partial_load_chunk(partial, p, chunkOffset))
+			return false;
+
+		if (chunkOffset + 1 < header->chunksCount)
+			chunkItemsCount = header->chunkDesc[chunkOffset + 1].offset -
+				header->chunkDesc[chunkOffset].offset;
+		else
+			chunkItemsCount = header->itemsCount -
+				header->chunkDesc[chunkOffset].offset;
+		chunk = (BTreePageChunk *) (p + SHORT_GET_LOCATION(header->chunkDesc[chunkOffset].shortLocation));
+
+		for (j = 0; j < chunkItemsCount; j++)
+		{
+			Pointer		item = (Pointer) chunk + ITEM_GET_OFFSET(chunk->items[j]);
+
+			items->downlinks[i] = ((BTreeNonLeafTuphdr *) item)->downlink;
+			items->keys[i].data = item + BTreeNonLeafTuphdrSize;
+			items->keys[i].formatFlags = ITEM_GET_FLAGS(chunk->items[j]);
+			i++;
+		}
+	}
+
+	items->itemsCount = i;
+	return true;
+}
+
 BTreeItemPageFitType
 page_locator_fits_item(BTreeDescr *desc, Page p, BTreePageItemLocator *locator,
 					   LocationIndex size, bool replace, CommitSeqNo csn)
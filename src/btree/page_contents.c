@@ -140,18 +140,59 @@ try_copy_page(OInMemoryBlkno blkno, uint32 pageChangeCount, Page dest,
 	return ReadPageResultOK;
 }
 
+/*
+ * Number of optimistic copy attempts before falling back to the shared page
+ * lock in copy_page().  High enough that the fallback never triggers on
+ * ordinary writer activity, low enough to bound the work wasted on a hot
+ * page: every failed attempt throws away an up-to-ORIOLEDB_BLCKSZ memcpy.
+ */
+#define COPY_PAGE_RETRIES_MAX	16
+
 /*
  * Copy consistent image of page with page number = blkno to dest.
+ *
+ * A reader can't starve here: after COPY_PAGE_RETRIES_MAX failed optimistic
+ * attempts we take the shared page lock, which excludes the writers
+ * invalidating our copies, and retry under it.  The shared lock alone
+ * doesn't guarantee the locked attempt succeeds: a writer may set
+ * PAGE_STATE_NO_READ_FLAG at any time, including while we hold the lock,
+ * and then spins in page_block_reads() waiting for the shared lockers to
+ * drain.  So we must never sleep in page_wait_for_read_enable() while
+ * holding a share of PAGE_STATE_SHARED_MASK -- that would deadlock against
+ * such a writer.  Instead, on failure we release the lock, wait for reads
+ * to be re-enabled and re-acquire it (lock_page_shared() itself waits out
+ * PAGE_STATE_NO_READ_FLAG before its CAS).  Both the retries and the
+ * fallbacks are counted in the per-tree statistics.
  */
 static inline void
-copy_page(OInMemoryBlkno blkno, Page dest, PartialPageState *partial,
-		  CommitSeqNo *readCsn)
+copy_page(BTreeDescr *desc, OInMemoryBlkno blkno, Page dest,
+		  PartialPageState *partial, CommitSeqNo *readCsn)
 {
+	int			retries = 0;
+
 	while (try_copy_page(blkno, InvalidOPageChangeCount, dest,
 						 partial, readCsn) != ReadPageResultOK)
 	{
 		(void) page_wait_for_read_enable(blkno);
+
+		if (++retries >= COPY_PAGE_RETRIES_MAX)
+		{
+			lock_page_shared(blkno);
+			while (try_copy_page(blkno, InvalidOPageChangeCount, dest,
+								 partial, readCsn) != ReadPageResultOK)
+			{
+				unlock_page_shared(blkno);
+				(void) page_wait_for_read_enable(blkno);
+				lock_page_shared(blkno);
+			}
+			unlock_page_shared(blkno);
+			O_TREE_STAT_INC(desc, readLockFallbacks);
+			break;
+		}
 	}
+
+	if (retries > 0)
+		O_TREE_STAT_ADD(desc, readRetries, retries);
 }
 
 /*
@@ -223,7 +264,7 @@ o_btree_read_page(BTreeDescr *desc, OInMemoryBlkno blkno,
 		return true;
 	}
 
-	copy_page(blkno, img, partial, readCsn);
+	copy_page(desc, blkno, img, partial, readCsn);
 
 	/* If that is the required page according to page change count */
 	header = (BTreePageHeader *) img;
@@ -353,6 +394,7 @@ init_new_btree_page(BTreeDescr *desc, OInMemoryBlkno blkno, uint16 flags,
 	header->checkpointNum = 0;
 	header->itemsCount = 0;
 	header->prevInsertOffset = MaxOffsetNumber;
+	header->insertPattern = 0;
 	header->maxKeyLen = 0;
 	page_change_usage_count(&desc->ppool->ucm, blkno,
 							(pg_atomic_read_u32(desc->ppool->ucm.epoch) + 2) % UCM_USAGE_LEVELS);
@@ -373,9 +415,22 @@ init_meta_page(OInMemoryBlkno blkno, uint32 leafPagesNum)
 
 	memset(p + O_PAGE_HEADER_SIZE, 0, ORIOLEDB_BLCKSZ - O_PAGE_HEADER_SIZE);
 	pg_atomic_init_u32(&metaPageBlkno->leafPagesNum, leafPagesNum);
+	pg_atomic_init_u64(&metaPageBlkno->liveTuplesNum, 0);
+	pg_atomic_init_u32(&metaPageBlkno->dirtyPagesCount, 0);
+	pg_atomic_init_u32(&metaPageBlkno->inProgressWritesCount, 0);
 	pg_atomic_init_u64(&metaPageBlkno->numFreeBlocks, 0);
 	pg_atomic_init_u64(&metaPageBlkno->datafileLength, 0);
 	pg_atomic_init_u64(&metaPageBlkno->ctid, 0);
+	pg_atomic_init_u64(&metaPageBlkno->uniqueFilterGen, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.lockAcquires, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.lockWaits, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.splits, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.merges, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.evictions, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.writeBytesRaw, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.writeBytesCompressed, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.readRetries, 0);
+	pg_atomic_init_u64(&metaPageBlkno->stats.readLockFallbacks, 0);
 	for (i = 0; i < NUM_SEQ_SCANS_ARRAY_SIZE; i++)
 		pg_atomic_init_u32(&metaPageBlkno->numSeqScans[i], 0);
 
@@ -391,7 +446,7 @@ init_meta_page(OInMemoryBlkno blkno, uint32 leafPagesNum)
 	page_desc->fileExtent.len = InvalidFileExtentLen;
 	page_desc->fileExtent.off = InvalidFileExtentOff;
 
-	for (i = 0; i < 2; i++)
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
 	{
 		metaPageBlkno->freeBuf.pages[i] = OInvalidInMemoryBlkno;
 		for (j = 0; j < 2; j++)
@@ -402,6 +457,65 @@ init_meta_page(OInMemoryBlkno blkno, uint32 leafPagesNum)
 	}
 }
 
+/*
+ * Account an insert at `offset` in the page insert pattern scores.  Called
+ * before prevInsertOffset is updated to the new insert location.
+ *
+ * The insert is classified against the previous one - adjacent ascending,
+ * adjacent descending, nearby (hotspot) or distant - and the matching score
+ * is bumped while the others decay.  Saturating 4-bit scores make the
+ * detection tolerant to occasional out-of-pattern inserts, which is what
+ * distinguishes it from the exact prevInsertOffset check: interleaved
+ * ascending streams keep the ascending score high even though consecutive
+ * inserts into the page are rarely adjacent.
+ */
+void
+page_track_insert_pattern(Page p, OffsetNumber offset)
+{
+	BTreePageHeader *header = (BTreePageHeader *) p;
+	OffsetNumber prev = header->prevInsertOffset;
+	uint16		asc = O_INSERT_PATTERN_ASC(header),
+				desc = O_INSERT_PATTERN_DESC(header),
+				hot = O_INSERT_PATTERN_HOT(header);
+	int			distance;
+
+	if (prev == MaxOffsetNumber || prev == InvalidOffsetNumber)
+		return;
+
+	distance = (int) offset - (int) prev;
+	if (distance == 1)
+	{
+		asc = Min(asc + 1, O_INSERT_PATTERN_SCORE_MAX);
+		if (desc > 0)
+			desc--;
+	}
+	else if (distance == 0)
+	{
+		desc = Min(desc + 1, O_INSERT_PATTERN_SCORE_MAX);
+		if (asc > 0)
+			asc--;
+	}
+	else if (Abs(distance) <= O_INSERT_PATTERN_HOTSPOT_DISTANCE)
+	{
+		hot = Min(hot + 1, O_INSERT_PATTERN_SCORE_MAX);
+		if (asc > 0)
+			asc--;
+		if (desc > 0)
+			desc--;
+	}
+	else
+	{
+		if (asc > 0)
+			asc--;
+		if (desc > 0)
+			desc--;
+		if (hot > 0)
+			hot--;
+	}
+
+	header->insertPattern = O_INSERT_PATTERN_MAKE(asc, desc, hot);
+}
+
 /*
  * Estimate vacated space in the page.
  */
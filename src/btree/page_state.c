@@ -23,6 +23,7 @@
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/page_pool.h"
+#include "utils/page_waits.h"
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
 
@@ -50,10 +51,19 @@ typedef struct
 } MyLockedPage;
 
 static MyLockedPage myLockedPages[MAX_PAGES_PER_PROCESS];
+static OInMemoryBlkno mySharedLockedPages[MAX_PAGES_PER_PROCESS];
 static OInMemoryBlkno myInProgressSplitPages[ORIOLEDB_MAX_DEPTH * 2];
 static int	numberOfMyLockedPages = 0;
+static int	numberOfMySharedLockedPages = 0;
 static int	numberOfMyInProgressSplitPages = 0;
 
+/*
+ * Backend-local page lock counters.  lock_page() has no tree context, so
+ * find_page() attributes the deltas to the per-tree counters.
+ */
+uint64		page_lock_nacquires = 0;
+uint64		page_lock_nwaits = 0;
+
 
 #ifdef CHECK_PAGE_STRUCT
 static void o_check_page_struct(BTreeDescr *desc, Page p);
@@ -277,14 +287,42 @@ lock_page(OInMemoryBlkno blkno)
 	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
 	uint32		prevState;
 	int			extraWaits = 0;
+	instr_time	waitStart;
 
 	Assert(get_my_locked_page_index(blkno) < 0);
 
+	INSTR_TIME_SET_ZERO(waitStart);
 	EA_LOCK_INC(blkno);
+	page_lock_nacquires++;
 
 	page_inc_usage_count(ucm, blkno,
 						 pg_atomic_read_u32(&header->usageCount), false);
 
+	/*
+	 * Page critical sections are typically shorter than the scheduler
+	 * round-trip of a sleep/wakeup cycle, so before queueing spin for as
+	 * long as perform_spin_delay() stays on the CPU (the spin count adapts
+	 * via the regular s_lock machinery).  Don't spin past queued waiters:
+	 * the lock is handed to them in order, see unlock_page().
+	 */
+	prevState = pg_atomic_read_u32(&header->state);
+	if (O_PAGE_STATE_IS_LOCKED(prevState) &&
+		!(prevState & PAGE_STATE_HAS_WAITERS_FLAG))
+	{
+		SpinDelayStatus spinStatus;
+
+		init_local_spin_delay(&spinStatus);
+		while (O_PAGE_STATE_IS_LOCKED(prevState) &&
+			   !(prevState & PAGE_STATE_HAS_WAITERS_FLAG) &&
+			   spinStatus.delays == 0)
+		{
+			perform_spin_delay(&spinStatus);
+			prevState = pg_atomic_read_u32(&header->state);
+		}
+		if (!O_PAGE_STATE_IS_LOCKED(prevState))
+			finish_spin_delay(&spinStatus);
+	}
+
 	while (true)
 	{
 		prevState = lock_page_or_list(blkno);
@@ -307,7 +345,10 @@ lock_page(OInMemoryBlkno blkno)
 			}
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		page_lock_nwaits++;
+		if (oTracepointBuffers != NULL)
+			INSTR_TIME_SET_CURRENT(waitStart);
+		o_page_wait_start(OPageWaitLock, blkno);
 
 		for (;;)
 		{
@@ -317,7 +358,27 @@ lock_page(OInMemoryBlkno blkno)
 			extraWaits++;
 		}
 
-		pgstat_report_wait_end();
+		o_page_wait_end();
+		if (oTracepointBuffers != NULL)
+		{
+			instr_time	waitTime;
+
+			INSTR_TIME_SET_CURRENT(waitTime);
+			INSTR_TIME_SUBTRACT(waitTime, waitStart);
+			OTRACEPOINT(OTRACEPOINT_PAGE_LOCK_WAIT, blkno,
+						INSTR_TIME_GET_MICROSEC(waitTime));
+		}
+
+		/*
+		 * The releasing backend may have handed the lock directly over to
+		 * us, see unlock_page().  Ownership is already ours then: no need
+		 * to retry the acquisition.
+		 */
+		if (MyProc->lwWaitMode == LW_WAIT_UNTIL_FREE)
+		{
+			prevState = pg_atomic_read_u32(&header->state) & ~PAGE_STATE_LOCKED_FLAG;
+			break;
+		}
 	}
 
 	my_locked_page_add(blkno, prevState | PAGE_STATE_LOCKED_FLAG);
@@ -329,6 +390,79 @@ lock_page(OInMemoryBlkno blkno)
 		PGSemaphoreUnlock(MyProc->sem);
 }
 
+/*
+ * Place shared lock on the page.
+ *
+ * A shared lock guarantees that the page content stays readable: it doesn't
+ * conflict with the exclusive lock itself, but page_block_reads() waits till
+ * all the shared lockers are gone.  It allows structure-reading operations to
+ * look at the page without copying it and without the change-count retry
+ * loop, while writers stay non-blocked up to the actual modification point.
+ */
+void
+lock_page_shared(OInMemoryBlkno blkno)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
+	SpinDelayStatus status;
+	uint32		state;
+
+	Assert(get_my_locked_page_index(blkno) < 0);
+	Assert(numberOfMySharedLockedPages < MAX_PAGES_PER_PROCESS);
+
+	init_local_spin_delay(&status);
+	state = pg_atomic_read_u32(&header->state);
+	while (true)
+	{
+		if (O_PAGE_STATE_READ_IS_BLOCKED(state))
+		{
+			page_wait_for_read_enable(blkno);
+			state = pg_atomic_read_u32(&header->state);
+			continue;
+		}
+
+		if ((state & PAGE_STATE_SHARED_MASK) == PAGE_STATE_SHARED_MASK)
+		{
+			/* The counter of shared lockers is saturated */
+			perform_spin_delay(&status);
+			state = pg_atomic_read_u32(&header->state);
+			continue;
+		}
+
+		if (pg_atomic_compare_exchange_u32(&header->state, &state,
+										   state + PAGE_STATE_SHARED_ONE))
+			break;
+	}
+	finish_spin_delay(&status);
+
+	mySharedLockedPages[numberOfMySharedLockedPages++] = blkno;
+}
+
+/*
+ * Release the shared page lock.  A writer possibly waiting for shared
+ * lockers to drain spins in page_block_reads(), so no explicit wakeup is
+ * needed here.
+ */
+void
+unlock_page_shared(OInMemoryBlkno blkno)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	OrioleDBPageHeader *header = (OrioleDBPageHeader *) p;
+	uint32		state PG_USED_FOR_ASSERTS_ONLY;
+	int			i;
+
+	for (i = 0; i < numberOfMySharedLockedPages; i++)
+	{
+		if (mySharedLockedPages[i] == blkno)
+			break;
+	}
+	Assert(i < numberOfMySharedLockedPages);
+	mySharedLockedPages[i] = mySharedLockedPages[--numberOfMySharedLockedPages];
+
+	state = pg_atomic_fetch_sub_u32(&header->state, PAGE_STATE_SHARED_ONE);
+	Assert((state & PAGE_STATE_SHARED_MASK) != 0);
+}
+
 void
 page_wait_for_read_enable(OInMemoryBlkno blkno)
 {
@@ -356,7 +490,7 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 			return;
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		o_page_wait_start(OPageWaitReadEnable, blkno);
 
 		for (;;)
 		{
@@ -366,7 +500,7 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 			extraWaits++;
 		}
 
-		pgstat_report_wait_end();
+		o_page_wait_end();
 	}
 
 	/*
@@ -412,7 +546,7 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 			return dequeue_self(blkno);
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		o_page_wait_start(OPageWaitChangeCount, blkno);
 
 		for (;;)
 		{
@@ -427,10 +561,10 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 			}
 			extraWaits++;
 		}
+
+		o_page_wait_end();
 		if (exit_loop)
 			break;
-
-		pgstat_report_wait_end();
 	}
 
 	/*
@@ -526,6 +660,21 @@ page_block_reads(OInMemoryBlkno blkno)
 	state = pg_atomic_fetch_or_u32(&(O_PAGE_HEADER(p)->state), PAGE_STATE_NO_READ_FLAG);
 	Assert((state & PAGE_STATE_LOCKED_FLAG));
 	myLockedPages[i].state = state | PAGE_STATE_NO_READ_FLAG;
+
+	/*
+	 * Wait till concurrent shared lockers are gone.  New shared lockers can't
+	 * appear once the no-read flag is set.  Shared locks are short-term, so
+	 * spinning is fine here.
+	 */
+	if (state & PAGE_STATE_SHARED_MASK)
+	{
+		SpinDelayStatus status;
+
+		init_local_spin_delay(&status);
+		while (pg_atomic_read_u32(&(O_PAGE_HEADER(p)->state)) & PAGE_STATE_SHARED_MASK)
+			perform_spin_delay(&status);
+		finish_spin_delay(&status);
+	}
 }
 
 static void
@@ -582,6 +731,97 @@ wakeup_waiters(OInMemoryBlkno blkno)
 	}
 }
 
+/*
+ * Release the page lock, handing it directly to the first queued exclusive
+ * waiter if there is one.
+ *
+ * Called while still holding the lock; lockerState is the locker's recorded
+ * state, which tells whether reads were blocked.  The new owner is chosen
+ * under the list lock, and PAGE_STATE_LOCKED_FLAG stays set through the
+ * releasing atomic transition, so the lock is never observed free: the
+ * woken waiter doesn't have to retry the acquisition (no second scheduler
+ * round-trip through the requeue path), and a late-arriving backend can't
+ * barge in ahead of the queue.  Shared-mode waiters (read-enable and
+ * change-count waits) are woken up the same way as before.
+ */
+static void
+release_page_and_wakeup_waiters(OInMemoryBlkno blkno, uint32 lockerState)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	proclist_head wakeup;
+	proclist_mutable_iter iter;
+	PGPROC	   *newOwner = NULL;
+	uint32		curState;
+	uint32		sub;
+
+	proclist_init(&wakeup);
+
+	curState = lock_page_list(blkno);
+
+	proclist_foreach_modify(iter, &O_GET_IN_MEMORY_PAGEDESC(blkno)->waitersList, lwWaitLink)
+	{
+		PGPROC	   *waiter = GetPGProcByNumber(iter.cur);
+
+		if (waiter->lwWaitMode == LW_EXCLUSIVE)
+		{
+			/* The first exclusive waiter becomes the owner, the rest wait. */
+			if (newOwner != NULL)
+				continue;
+			newOwner = waiter;
+		}
+		proclist_delete(&O_GET_IN_MEMORY_PAGEDESC(blkno)->waitersList, iter.cur, lwWaitLink);
+		if (waiter != newOwner)
+			proclist_push_tail(&wakeup, iter.cur, lwWaitLink);
+	}
+
+	sub = PAGE_STATE_LIST_LOCKED_FLAG;
+	if ((curState & PAGE_STATE_HAS_WAITERS_FLAG) &&
+		proclist_is_empty(&O_GET_IN_MEMORY_PAGEDESC(blkno)->waitersList))
+		sub |= PAGE_STATE_HAS_WAITERS_FLAG;
+	if (newOwner == NULL)
+		sub |= PAGE_STATE_LOCKED_FLAG;
+	if (lockerState & PAGE_STATE_NO_READ_FLAG)
+		sub |= PAGE_STATE_NO_READ_FLAG;
+
+	/*
+	 * The single atomic transition: bump the change count if reads were
+	 * blocked, re-enable reads, release the list lock, and either release
+	 * the lock or keep it set on behalf of the new owner.  All the
+	 * subtracted bits are known to be set (the list lock is ours, and the
+	 * waiters flag can't change while we hold it), so the addition is
+	 * exact.
+	 */
+	pg_atomic_add_fetch_u32(&(O_PAGE_HEADER(p)->state),
+							((lockerState & PAGE_STATE_NO_READ_FLAG) ?
+							 PAGE_STATE_CHANGE_COUNT_ONE : 0) - sub);
+
+	/* Awaken the shared-mode waiters I removed from the queue. */
+	proclist_foreach_modify(iter, &wakeup, lwWaitLink)
+	{
+		PGPROC	   *waiter = GetPGProcByNumber(iter.cur);
+
+		proclist_delete(&wakeup, iter.cur, lwWaitLink);
+
+		/* See the barrier comment in wakeup_waiters(). */
+		pg_write_barrier();
+		waiter->lwWaiting = false;
+		PGSemaphoreUnlock(waiter->sem);
+	}
+
+	if (newOwner != NULL)
+	{
+		/*
+		 * Flag the handoff before clearing lwWaiting: once lwWaiting is
+		 * unset the waiter may inspect lwWaitMode at any moment, see
+		 * lock_page().
+		 */
+		newOwner->lwWaitMode = LW_WAIT_UNTIL_FREE;
+		pg_write_barrier();
+		newOwner->lwWaiting = false;
+		PGSemaphoreUnlock(newOwner->sem);
+	}
+}
+
 /*
  * Unlock the page.  Page should be already locked.
  */
@@ -643,6 +883,18 @@ unlock_page(OInMemoryBlkno blkno)
 
 	Assert((state & PAGE_STATE_CHANGE_NON_WAITERS_MASK) == (pg_atomic_read_u32(&(O_PAGE_HEADER(p)->state)) & PAGE_STATE_CHANGE_NON_WAITERS_MASK));
 
+	/*
+	 * With queued waiters, release and hand off in one atomic transition.
+	 * The flag is stable enough to check without the list lock: it's only
+	 * set by backends about to queue, and a late set is caught by the
+	 * post-release check below.
+	 */
+	if (pg_atomic_read_u32(&(O_PAGE_HEADER(p)->state)) & PAGE_STATE_HAS_WAITERS_FLAG)
+	{
+		release_page_and_wakeup_waiters(blkno, state);
+		return;
+	}
+
 	if (state & PAGE_STATE_NO_READ_FLAG)
 	{
 		state = pg_atomic_add_fetch_u32(&(O_PAGE_HEADER(p)->state),
@@ -668,6 +920,8 @@ release_all_page_locks(void)
 
 	while (numberOfMyLockedPages > 0)
 		unlock_page(myLockedPages[0].blkno);
+	while (numberOfMySharedLockedPages > 0)
+		unlock_page_shared(mySharedLockedPages[0]);
 }
 
 /*
@@ -313,9 +313,12 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 				BTreeLeafTuphdr tuphdr,
 						   *pageTuphdr;
 				OTuple		tuple;
+				OTuple		successor;
+				bool		successorAllocated = false;
 				bool		inUndo = false;
 
 				BTREE_PAGE_READ_LEAF_ITEM(pageTuphdr, tuple, p, &loc);
+				successor = tuple;
 				tuphdr = *pageTuphdr;
 				appendStringInfo(outbuf, "    Item %i: ", i);
 
@@ -404,11 +407,19 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						UndoLocationIsValid(tuphdr.undoLocation))
 					{
 						Assert(UNDO_REC_EXISTS(tuphdr.undoLocation));
-						if (inUndo && !O_TUPLE_IS_NULL(tuple))
-							pfree(tuple.data);
 						if (!tuphdr.deleted && !XACT_INFO_IS_LOCK_ONLY(tuphdr.xactInfo))
 						{
-							get_prev_leaf_header_and_tuple_from_undo(&tuphdr, &tuple, 0);
+							/*
+							 * The last non-NULL tuple is the successor needed
+							 * to decode a delta-encoded update record.
+							 */
+							get_prev_leaf_header_and_tuple_from_undo(&tuphdr,
+																	 &tuple, 0,
+																	 successor);
+							if (successorAllocated)
+								pfree(successor.data);
+							successor = tuple;
+							successorAllocated = true;
 						}
 						else
 						{
@@ -422,8 +433,8 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						break;
 					}
 				}
-				if (inUndo && !O_TUPLE_IS_NULL(tuple))
-					pfree(tuple.data);
+				if (successorAllocated)
+					pfree(successor.data);
 			}
 			else
 			{
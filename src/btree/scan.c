@@ -31,6 +31,7 @@
 
 #include "btree/btree.h"
 #include "btree/find.h"
+#include "btree/hist_cache.h"
 #include "btree/io.h"
 #include "btree/iterator.h"
 #include "btree/page_chunks.h"
@@ -38,6 +39,7 @@
 #include "btree/undo.h"
 #include "tuple/slot.h"
 #include "utils/sampling.h"
+#include "utils/ucm.h"
 #include "utils/stopevent.h"
 
 #include "miscadmin.h"
@@ -59,6 +61,9 @@ struct BTreeSeqScan
 {
 	BTreeDescr *desc;
 
+	/* Shared state of the parallel scan, NULL for a non-parallel scan */
+	ParallelOScanDesc poscan;
+
 	char		leafImg[ORIOLEDB_BLCKSZ];
 	char		histImg[ORIOLEDB_BLCKSZ];
 
@@ -68,7 +73,12 @@ struct BTreeSeqScan
 	OFixedKey	curHikey;
 	BTreeLocationHint hint;
 
-	BTreePageItemLocator intLoc;
+	/*
+	 * Snapshot of the current internal page decoded into a flat downlink
+	 * array, and the index of the next item to consume.
+	 */
+	BTreePageItems intItems;
+	int			intItemIndex;
 
 	/*
 	 * The page offset we started with according to `prevHikey`;
@@ -86,6 +96,7 @@ struct BTreeSeqScan
 	BTreeSeqScanDiskDownlink *diskDownlinks;
 	int64		downlinksCount;
 	int64		downlinkIndex;
+	int64		downlinkPrefetchIndex;
 	int64		allocatedDownlinks;
 
 	BTreeIterator *iter;
@@ -102,6 +113,12 @@ struct BTreeSeqScan
 	BTreeMetaPage *metaPageBlkno;
 	dlist_node	listNode;
 
+	/*
+	 * Index of the shared readahead slot this scan is attached to, -1 if
+	 * none.  See SharedSeqScanSlot.
+	 */
+	int			sharedSlotIndex;
+
 	OFixedKey	nextKey;
 
 	bool		needSampling;
@@ -111,6 +128,14 @@ struct BTreeSeqScan
 
 	BTreeSeqScanCallbacks *cb;
 	void	   *arg;
+
+	/*
+	 * Optional filter applied to committed visible leaf tuples while they
+	 * still reside in the page image, see
+	 * btree_seq_scan_set_tuple_filter().
+	 */
+	BTreeSeqScanTupleFilter tupleFilter;
+	void	   *tupleFilterArg;
 	bool		isSingleLeafPage;	/* Scan couldn't read first internal page */
 	OFixedKey	keyRangeLow,
 				keyRangeHigh;
@@ -119,8 +144,152 @@ struct BTreeSeqScan
 
 static dlist_head listOfScans = DLIST_STATIC_INIT(listOfScans);
 
+/*
+ * Concurrent scans of the same tree at the same CSN (a fan-out of identical
+ * reporting queries is the typical case) read the same on-disk pages in the
+ * same sorted order.  Each scan still consumes every leaf page itself -- the
+ * results can't be partitioned between independent queries -- but the
+ * readahead hints need to be issued only once.  Scans attach to a shared
+ * slot keyed by (tree, csn) and keep a common high-water mark of hinted
+ * block offsets there.
+ */
+#define SHARED_SEQ_SCAN_SLOTS	32
+
+typedef struct SharedSeqScanSlot
+{
+	Oid			datoid;
+	Oid			relnode;
+	CommitSeqNo csn;
+	int			refCount;
+
+	/* block offsets below this mark are already hinted for readahead */
+	pg_atomic_uint64 prefetchLocation;
+} SharedSeqScanSlot;
+
+typedef struct SharedSeqScanState
+{
+	slock_t		mutex;
+	SharedSeqScanSlot slots[SHARED_SEQ_SCAN_SLOTS];
+} SharedSeqScanState;
+
+static SharedSeqScanState *sharedSeqScans = NULL;
+
+Size
+seq_scan_shmem_needs(void)
+{
+	return CACHELINEALIGN(sizeof(SharedSeqScanState));
+}
+
+void
+seq_scan_shmem_init(Pointer ptr, bool found)
+{
+	sharedSeqScans = (SharedSeqScanState *) ptr;
+
+	if (!found)
+	{
+		int			i;
+
+		SpinLockInit(&sharedSeqScans->mutex);
+		for (i = 0; i < SHARED_SEQ_SCAN_SLOTS; i++)
+		{
+			sharedSeqScans->slots[i].refCount = 0;
+			pg_atomic_init_u64(&sharedSeqScans->slots[i].prefetchLocation, 0);
+		}
+	}
+}
+
+/*
+ * Attach the scan to the shared readahead slot of its (tree, csn), creating
+ * one if needed.  Running out of slots just means no readahead sharing.
+ */
+static void
+shared_seq_scan_attach(BTreeSeqScan *scan)
+{
+	int			i,
+				freeIndex = -1;
+
+	scan->sharedSlotIndex = -1;
+	if (sharedSeqScans == NULL ||
+		!COMMITSEQNO_IS_NORMAL(scan->snapshotCsn) ||
+		!ORelOidsIsValid(scan->desc->oids))
+		return;
+
+	SpinLockAcquire(&sharedSeqScans->mutex);
+	for (i = 0; i < SHARED_SEQ_SCAN_SLOTS; i++)
+	{
+		SharedSeqScanSlot *slot = &sharedSeqScans->slots[i];
+
+		if (slot->refCount > 0 &&
+			slot->datoid == scan->desc->oids.datoid &&
+			slot->relnode == scan->desc->oids.relnode &&
+			slot->csn == scan->snapshotCsn)
+		{
+			slot->refCount++;
+			scan->sharedSlotIndex = i;
+			break;
+		}
+		if (slot->refCount == 0 && freeIndex < 0)
+			freeIndex = i;
+	}
+	if (scan->sharedSlotIndex < 0 && freeIndex >= 0)
+	{
+		SharedSeqScanSlot *slot = &sharedSeqScans->slots[freeIndex];
+
+		slot->datoid = scan->desc->oids.datoid;
+		slot->relnode = scan->desc->oids.relnode;
+		slot->csn = scan->snapshotCsn;
+		slot->refCount = 1;
+		pg_atomic_write_u64(&slot->prefetchLocation, 0);
+		scan->sharedSlotIndex = freeIndex;
+	}
+	SpinLockRelease(&sharedSeqScans->mutex);
+}
+
+static void
+shared_seq_scan_detach(BTreeSeqScan *scan)
+{
+	if (scan->sharedSlotIndex < 0)
+		return;
+
+	SpinLockAcquire(&sharedSeqScans->mutex);
+	Assert(sharedSeqScans->slots[scan->sharedSlotIndex].refCount > 0);
+	sharedSeqScans->slots[scan->sharedSlotIndex].refCount--;
+	SpinLockRelease(&sharedSeqScans->mutex);
+	scan->sharedSlotIndex = -1;
+}
+
+/*
+ * Issue readahead for the downlink unless a concurrent scan of the same
+ * (tree, csn) already did.  All the attached scans consume their sorted
+ * downlinks in ascending order, so a high-water mark of block offsets is
+ * enough to deduplicate the hints.
+ */
+static void
+seq_scan_prefetch_downlink(BTreeSeqScan *scan, uint64 downlink)
+{
+	if (scan->sharedSlotIndex >= 0)
+	{
+		SharedSeqScanSlot *slot = &sharedSeqScans->slots[scan->sharedSlotIndex];
+		uint64		off = DOWNLINK_GET_DISK_OFF(downlink);
+		uint64		end = off + DOWNLINK_GET_DISK_LEN(downlink);
+		uint64		mark = pg_atomic_read_u64(&slot->prefetchLocation);
+
+		if (off < mark)
+			return;
+		while (mark < end &&
+			   !pg_atomic_compare_exchange_u64(&slot->prefetchLocation,
+											   &mark, end))
+		{
+			if (off < mark)
+				return;
+		}
+	}
+	prefetch_page_from_disk(scan->desc, downlink);
+}
+
 static void scan_make_iterator(BTreeSeqScan *scan, OTuple startKey, OTuple keyRangeHigh);
-static void get_next_key(BTreeSeqScan *scan, BTreePageItemLocator *intLoc, OFixedKey *next_key);
+static void get_next_key(BTreeSeqScan *scan, int itemIndex, OFixedKey *next_key);
+static bool claim_parallel_keyrange(BTreeSeqScan *scan, bool *partial);
 
 static void
 load_first_historical_page(BTreeSeqScan *scan)
@@ -131,11 +300,29 @@ load_first_historical_page(BTreeSeqScan *scan)
 	OFixedKey	lokey,
 			   *lokeyPtr = &lokey;
 	OFixedKey	hikey;
+	UndoLocation startUndoLoc = header->undoLocation;
+	CommitSeqNo prevCsn = header->csn;
+	OffsetNumber startOffset;
+	OTuple		noHikey;
+	bool		useCache;
 
+	O_TUPLE_SET_NULL(noHikey);
 	scan->haveHistImg = false;
 	if (!COMMITSEQNO_IS_NORMAL(scan->snapshotCsn))
 		return;
 
+	useCache = o_hist_cache_enabled() &&
+		COMMITSEQNO_IS_NORMAL(header->csn) &&
+		header->csn >= scan->snapshotCsn;
+	if (useCache &&
+		o_hist_cache_lookup(startUndoLoc, noHikey, 0, scan->snapshotCsn,
+							scan->histImg, &startOffset))
+	{
+		scan->haveHistImg = true;
+		page_item_fill_locator(scan->histImg, startOffset, &scan->histLoc);
+		return;
+	}
+
 	if (!O_PAGE_IS(scan->leafImg, RIGHTMOST))
 		copy_fixed_hikey(scan->desc, &hikey, scan->leafImg);
 	else
@@ -152,6 +339,7 @@ load_first_historical_page(BTreeSeqScan *scan)
 					 errmsg("snapshot too old")));
 		}
 
+		prevCsn = header->csn;
 		(void) get_page_from_undo(scan->desc, header->undoLocation, key, kind,
 								  scan->histImg, NULL, NULL, NULL,
 								  lokeyPtr, &hikey.tuple);
@@ -187,6 +375,12 @@ load_first_historical_page(BTreeSeqScan *scan)
 		BTREE_PAGE_LOCATOR_FIRST(scan->histImg, &scan->histLoc);
 	}
 
+	if (useCache)
+		o_hist_cache_store(startUndoLoc, noHikey, 0,
+						   ((BTreePageHeader *) scan->histImg)->csn, prevCsn,
+						   BTREE_PAGE_LOCATOR_GET_OFFSET(scan->histImg,
+														 &scan->histLoc),
+						   scan->histImg);
 }
 
 static void
@@ -194,9 +388,29 @@ load_next_historical_page(BTreeSeqScan *scan)
 {
 	BTreePageHeader *header = (BTreePageHeader *) scan->leafImg;
 	OFixedKey	prevHikey;
+	UndoLocation startUndoLoc = header->undoLocation;
+	CommitSeqNo prevCsn = header->csn;
+	LocationIndex hikeyLen = 0;
+	OffsetNumber startOffset;
+	bool		useCache;
 
 	copy_fixed_hikey(scan->desc, &prevHikey, scan->histImg);
 
+	useCache = o_hist_cache_enabled() &&
+		COMMITSEQNO_IS_NORMAL(header->csn) &&
+		header->csn >= scan->snapshotCsn;
+	if (useCache)
+	{
+		hikeyLen = o_btree_len(scan->desc, prevHikey.tuple, OKeyLength);
+		if (o_hist_cache_lookup(startUndoLoc, prevHikey.tuple, hikeyLen,
+								scan->snapshotCsn,
+								scan->histImg, &startOffset))
+		{
+			BTREE_PAGE_LOCATOR_FIRST(scan->histImg, &scan->histLoc);
+			return;
+		}
+	}
+
 	while (COMMITSEQNO_IS_NORMAL(header->csn) &&
 		   header->csn >= scan->snapshotCsn)
 	{
@@ -206,6 +420,7 @@ load_next_historical_page(BTreeSeqScan *scan)
 					(errcode(ERRCODE_SNAPSHOT_TOO_OLD),
 					 errmsg("snapshot too old")));
 		}
+		prevCsn = header->csn;
 		(void) get_page_from_undo(scan->desc, header->undoLocation,
 								  (Pointer) &prevHikey.tuple, BTreeKeyNonLeafKey,
 								  scan->histImg, NULL, NULL, NULL,
@@ -213,6 +428,13 @@ load_next_historical_page(BTreeSeqScan *scan)
 		header = (BTreePageHeader *) scan->histImg;
 	}
 	BTREE_PAGE_LOCATOR_FIRST(scan->histImg, &scan->histLoc);
+
+	if (useCache)
+		o_hist_cache_store(startUndoLoc, prevHikey.tuple, hikeyLen,
+						   ((BTreePageHeader *) scan->histImg)->csn, prevCsn,
+						   BTREE_PAGE_LOCATOR_GET_OFFSET(scan->histImg,
+														 &scan->histLoc),
+						   scan->histImg);
 }
 
 static inline OTuple
@@ -236,6 +458,7 @@ load_next_internal_page(BTreeSeqScan *scan)
 
 	scan->context.flags |= BTREE_PAGE_FIND_DOWNLINK_LOCATION;
 
+	set_ucm_scan_hint();
 	if (!O_TUPLE_IS_NULL(int_page_hikey(scan, scan->context.img)))
 	{
 		copy_fixed_key(scan->desc, &scan->prevHikey, int_page_hikey(scan, scan->context.img));
@@ -246,6 +469,7 @@ load_next_internal_page(BTreeSeqScan *scan)
 		O_TUPLE_SET_NULL(scan->prevHikey.tuple);
 		find_page(&scan->context, NULL, BTreeKeyNone, 1);
 	}
+	unset_ucm_scan_hint();
 
 	scan->firstPageIsLoaded = true;
 
@@ -255,14 +479,17 @@ load_next_internal_page(BTreeSeqScan *scan)
 		 * Check if the left bound of the found keyrange corresponds to the
 		 * previous hikey.  Otherwise, use iterator to correct the situation.
 		 */
-		scan->intLoc = scan->context.items[scan->context.index].locator;
-		scan->intStartOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(scan->context.img, &scan->intLoc);
+		btree_page_decode_internal_items(scan->context.img, NULL,
+										 &scan->intItems);
+		scan->intStartOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(scan->context.img,
+															 &scan->context.items[scan->context.index].locator);
+		scan->intItemIndex = scan->intStartOffset;
 		if (!O_TUPLE_IS_NULL(scan->prevHikey.tuple))
 		{
 			OTuple		intTup;
 
 			if (scan->intStartOffset > 0)
-				BTREE_PAGE_READ_INTERNAL_TUPLE(intTup, scan->context.img, &scan->intLoc);
+				intTup = scan->intItems.keys[scan->intStartOffset];
 			else
 				intTup = scan->context.lokey.tuple;
 
@@ -270,7 +497,8 @@ load_next_internal_page(BTreeSeqScan *scan)
 							&scan->prevHikey.tuple, BTreeKeyNonLeafKey,
 							&intTup, BTreeKeyNonLeafKey) != 0)
 			{
-				get_next_key(scan, &scan->intLoc, &scan->keyRangeHigh);
+				get_next_key(scan, scan->intItemIndex, &scan->keyRangeHigh);
+				scan->intItemIndex++;
 				scan_make_iterator(scan, scan->prevHikey.tuple, scan->keyRangeHigh.tuple);
 			}
 		}
@@ -279,11 +507,42 @@ load_next_internal_page(BTreeSeqScan *scan)
 	else
 	{
 		Assert(PAGE_GET_LEVEL(scan->context.img) == 0);
+
+		/*
+		 * The tree consists of the single leaf page.  The whole key space is
+		 * one keyrange, so only one worker of a parallel scan reads it.
+		 */
+		if (scan->poscan)
+		{
+			bool		partial;
+
+			clear_fixed_key(&scan->keyRangeLow);
+			clear_fixed_key(&scan->keyRangeHigh);
+			if (!claim_parallel_keyrange(scan, &partial))
+			{
+				BTREE_PAGE_LOCATOR_SET_INVALID(&scan->leafLoc);
+				scan->intItems.itemsCount = 0;
+				scan->intItemIndex = 0;
+				O_TUPLE_SET_NULL(scan->nextKey.tuple);
+				scan->haveHistImg = false;
+				return false;
+			}
+			if (partial)
+			{
+				scan_make_iterator(scan, scan->keyRangeLow.tuple,
+								   scan->keyRangeHigh.tuple);
+				scan->intItems.itemsCount = 0;
+				scan->intItemIndex = 0;
+				O_TUPLE_SET_NULL(scan->nextKey.tuple);
+				return false;
+			}
+		}
 		memcpy(scan->leafImg, scan->context.img, ORIOLEDB_BLCKSZ);
 		BTREE_PAGE_LOCATOR_FIRST(scan->leafImg, &scan->leafLoc);
 		scan->hint.blkno = scan->context.items[0].blkno;
 		scan->hint.pageChangeCount = scan->context.items[0].pageChangeCount;
-		BTREE_PAGE_LOCATOR_SET_INVALID(&scan->intLoc);
+		scan->intItems.itemsCount = 0;
+		scan->intItemIndex = 0;
 		O_TUPLE_SET_NULL(scan->nextKey.tuple);
 		load_first_historical_page(scan);
 		has_next = false;
@@ -341,6 +600,7 @@ scan_make_iterator(BTreeSeqScan *scan, OTuple keyRangeLow, OTuple keyRangeHigh)
 	MemoryContext mctx;
 
 	mctx = MemoryContextSwitchTo(scan->mctx);
+	set_ucm_scan_hint();
 	if (!O_TUPLE_IS_NULL(keyRangeLow))
 		scan->iter = o_btree_iterator_create(scan->desc, &keyRangeLow, BTreeKeyNonLeafKey,
 											 scan->snapshotCsn,
@@ -349,6 +609,7 @@ scan_make_iterator(BTreeSeqScan *scan, OTuple keyRangeLow, OTuple keyRangeHigh)
 		scan->iter = o_btree_iterator_create(scan->desc, NULL, BTreeKeyNone,
 											 scan->snapshotCsn,
 											 ForwardScanDirection);
+	unset_ucm_scan_hint();
 	MemoryContextSwitchTo(mctx);
 
 	BTREE_PAGE_LOCATOR_SET_INVALID(&scan->leafLoc);
@@ -356,19 +617,111 @@ scan_make_iterator(BTreeSeqScan *scan, OTuple keyRangeLow, OTuple keyRangeHigh)
 	scan->iterEnd = keyRangeHigh;
 }
 
-/* Output next key and locator on a current internal page */
+/* Output the key following the given item on a current internal page */
 static void
-get_next_key(BTreeSeqScan *scan, BTreePageItemLocator *intLoc, OFixedKey *next_key)
+get_next_key(BTreeSeqScan *scan, int itemIndex, OFixedKey *next_key)
 {
-	BTREE_PAGE_LOCATOR_NEXT(scan->context.img, intLoc);
-	if (BTREE_PAGE_LOCATOR_IS_VALID(scan->context.img, intLoc))
-		copy_fixed_page_key(scan->desc, next_key, scan->context.img, intLoc);
+	if (itemIndex + 1 < scan->intItems.itemsCount)
+		copy_fixed_key(scan->desc, next_key,
+					   scan->intItems.keys[itemIndex + 1]);
 	else if (!O_PAGE_IS(scan->context.img, RIGHTMOST))
 		copy_fixed_hikey(scan->desc, next_key, scan->context.img);
 	else
 		clear_fixed_key(next_key);
 }
 
+/*
+ * Try to claim the current keyrange [keyRangeLow, keyRangeHigh) for this
+ * worker of a parallel sequential scan.
+ *
+ * All the keys below the shared watermark are already claimed by some
+ * worker.  The keyrange is skipped (false is returned) if it lies below the
+ * watermark completely.  Otherwise the keyrange is claimed, and the
+ * watermark is advanced to its high key.  If the watermark reaches into the
+ * keyrange, *partial is set, scan->keyRangeLow is advanced to the watermark,
+ * and the caller should read the remainder through an iterator instead of
+ * the whole leaf page.
+ *
+ * The key comparison can call user-defined code, so it's done outside of the
+ * spinlock.  Claims are versioned to detect the race instead.
+ */
+static bool
+claim_parallel_keyrange(BTreeSeqScan *scan, bool *partial)
+{
+	ParallelOScanDesc poscan = scan->poscan;
+	OFixedKey	watermark;
+	uint64		version;
+	bool		finished,
+				watermarkValid;
+
+	*partial = false;
+
+	while (true)
+	{
+		SpinLockAcquire(&poscan->mutex);
+		version = poscan->claimVersion;
+		finished = poscan->finished;
+		watermarkValid = poscan->watermarkValid;
+		if (watermarkValid)
+			copy_from_fixed_shmem_key(&watermark, &poscan->watermark);
+		SpinLockRelease(&poscan->mutex);
+
+		if (finished)
+			return false;
+
+		if (watermarkValid)
+		{
+			/*
+			 * The watermark only advances, so it's safe to skip the keyrange
+			 * even if we lose the race for the claim.
+			 */
+			if (!O_TUPLE_IS_NULL(scan->keyRangeHigh.tuple) &&
+				o_btree_cmp(scan->desc,
+							&scan->keyRangeHigh.tuple, BTreeKeyNonLeafKey,
+							&watermark.tuple, BTreeKeyNonLeafKey) <= 0)
+				return false;
+
+			/*
+			 * Page boundaries of our traversal might not match the claimed
+			 * ones anymore (concurrent splits and merges), so the watermark
+			 * is allowed to be in the middle of the keyrange.
+			 */
+			if (O_TUPLE_IS_NULL(scan->keyRangeLow.tuple) ||
+				o_btree_cmp(scan->desc,
+							&scan->keyRangeLow.tuple, BTreeKeyNonLeafKey,
+							&watermark.tuple, BTreeKeyNonLeafKey) < 0)
+				*partial = true;
+		}
+		else
+		{
+			/* Nothing is claimed yet: we must be at the leftmost keyrange */
+			Assert(O_TUPLE_IS_NULL(scan->keyRangeLow.tuple));
+		}
+
+		SpinLockAcquire(&poscan->mutex);
+		if (poscan->claimVersion != version)
+		{
+			/* Somebody has claimed a keyrange concurrently: recheck */
+			SpinLockRelease(&poscan->mutex);
+			continue;
+		}
+		poscan->claimVersion++;
+		if (O_TUPLE_IS_NULL(scan->keyRangeHigh.tuple))
+			poscan->finished = true;
+		else
+		{
+			copy_fixed_shmem_key(scan->desc, &poscan->watermark,
+								 scan->keyRangeHigh.tuple);
+			poscan->watermarkValid = true;
+		}
+		SpinLockRelease(&poscan->mutex);
+
+		if (*partial)
+			copy_fixed_key(scan->desc, &scan->keyRangeLow, watermark.tuple);
+		return true;
+	}
+}
+
 /*
  * Gets the next downlink with it's keyrange (low and high keys of the
  * keyrange).
@@ -405,21 +758,29 @@ get_next_downlink(BTreeSeqScan *scan, uint64 *downlink,
 				return false;
 		}
 
-		if (BTREE_PAGE_LOCATOR_IS_VALID(scan->context.img, &scan->intLoc))
+		if (scan->intItemIndex < scan->intItems.itemsCount)
 		{
 			/* inside the internal page */
-			BTreeNonLeafTuphdr *tuphdr;
-			OTuple		tuple;
+			int			itemIndex = scan->intItemIndex;
 
-			STOPEVENT(STOPEVENT_STEP_DOWN, btree_downlink_stopevent_params(scan->desc,
-																		   scan->context.img, &scan->intLoc));
+			if (STOPEVENTS_ENABLED())
+			{
+				BTreePageItemLocator loc;
+
+				BTREE_PAGE_OFFSET_GET_LOCATOR(scan->context.img, itemIndex,
+											  &loc);
+				STOPEVENT(STOPEVENT_STEP_DOWN,
+						  btree_downlink_stopevent_params(scan->desc,
+														  scan->context.img,
+														  &loc));
+			}
 
-			BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, tuple, scan->context.img, &scan->intLoc);
-			*downlink = tuphdr->downlink;
+			*downlink = scan->intItems.downlinks[itemIndex];
 
 			/* construct fixed lokey of internal item */
-			if (BTREE_PAGE_LOCATOR_GET_OFFSET(scan->context.img, &scan->intLoc) != scan->intStartOffset)
-				copy_fixed_key(scan->desc, keyRangeLow, tuple);
+			if (itemIndex != scan->intStartOffset)
+				copy_fixed_key(scan->desc, keyRangeLow,
+							   scan->intItems.keys[itemIndex]);
 			else if (!O_PAGE_IS(scan->context.img, LEFTMOST))
 			{
 				Assert(!O_TUPLE_IS_NULL(scan->prevHikey.tuple));
@@ -432,10 +793,11 @@ get_next_downlink(BTreeSeqScan *scan, uint64 *downlink,
 			}
 
 			/*
-			 * construct fixed hikey of internal item and get next internal
-			 * locator
+			 * construct fixed hikey of internal item and step to the next
+			 * one
 			 */
-			get_next_key(scan, &scan->intLoc, keyRangeHigh);
+			get_next_key(scan, itemIndex, keyRangeHigh);
+			scan->intItemIndex++;
 
 			return true;
 		}
@@ -500,7 +862,25 @@ iterate_internal_page(BTreeSeqScan *scan)
 	{
 		bool		valid_downlink = true;
 
-		if (scan->cb && scan->cb->isRangeValid)
+		if (scan->poscan)
+		{
+			bool		partial;
+
+			valid_downlink = claim_parallel_keyrange(scan, &partial);
+			if (valid_downlink && partial)
+			{
+				/*
+				 * The part of the keyrange below the watermark belongs to
+				 * another worker: read only the remainder through an
+				 * iterator.
+				 */
+				scan_make_iterator(scan, scan->keyRangeLow.tuple,
+								   scan->keyRangeHigh.tuple);
+				Assert(scan->iter);
+				return true;
+			}
+		}
+		else if (scan->cb && scan->cb->isRangeValid)
 			valid_downlink = scan->cb->isRangeValid(scan->keyRangeLow.tuple, scan->keyRangeHigh.tuple,
 													scan->arg);
 		else if (scan->needSampling)
@@ -593,6 +973,26 @@ load_next_disk_leaf_page(BTreeSeqScan *scan)
 	if (scan->downlinkIndex >= scan->downlinksCount)
 		return false;
 
+	/*
+	 * Hint the OS to read the following downlinks ahead, overlapping their
+	 * I/O with consumption of the current leaf page.  The downlinks are
+	 * sorted, so the reads are issued in as sequential order as possible.
+	 */
+	if (seq_scan_prefetch_depth > 0)
+	{
+		int64		prefetchLimit = Min(scan->downlinkIndex + 1 + seq_scan_prefetch_depth,
+										scan->downlinksCount);
+
+		if (scan->downlinkPrefetchIndex <= scan->downlinkIndex)
+			scan->downlinkPrefetchIndex = scan->downlinkIndex + 1;
+		while (scan->downlinkPrefetchIndex < prefetchLimit)
+		{
+			seq_scan_prefetch_downlink(scan,
+									   scan->diskDownlinks[scan->downlinkPrefetchIndex].downlink);
+			scan->downlinkPrefetchIndex++;
+		}
+	}
+
 	downlink = scan->diskDownlinks[scan->downlinkIndex];
 	success = read_page_from_disk(scan->desc,
 								  scan->leafImg,
@@ -622,7 +1022,7 @@ load_next_disk_leaf_page(BTreeSeqScan *scan)
 static BTreeSeqScan *
 make_btree_seq_scan_internal(BTreeDescr *desc, CommitSeqNo csn,
 							 BTreeSeqScanCallbacks *cb, void *arg,
-							 BlockSampler sampler)
+							 BlockSampler sampler, ParallelOScanDesc poscan)
 {
 	BTreeSeqScan *scan = (BTreeSeqScan *) MemoryContextAlloc(btree_seqscan_context,
 															 sizeof(BTreeSeqScan));
@@ -632,16 +1032,20 @@ make_btree_seq_scan_internal(BTreeDescr *desc, CommitSeqNo csn,
 	BTreeMetaPage *metaPageBlkno = BTREE_GET_META(desc);
 
 	scan->desc = desc;
+	scan->poscan = poscan;
 	scan->snapshotCsn = csn;
 	scan->status = BTreeSeqScanInMemory;
 	scan->allocatedDownlinks = 16;
 	scan->downlinksCount = 0;
 	scan->downlinkIndex = 0;
+	scan->downlinkPrefetchIndex = 0;
 	scan->diskDownlinks = (BTreeSeqScanDiskDownlink *) palloc(sizeof(scan->diskDownlinks[0]) * scan->allocatedDownlinks);
 	scan->mctx = CurrentMemoryContext;
 	scan->iter = NULL;
 	scan->cb = cb;
 	scan->arg = arg;
+	scan->tupleFilter = NULL;
+	scan->tupleFilterArg = NULL;
 	scan->firstPageIsLoaded = false;
 
 	scan->samplingNumber = 0;
@@ -662,6 +1066,8 @@ make_btree_seq_scan_internal(BTreeDescr *desc, CommitSeqNo csn,
 
 	O_TUPLE_SET_NULL(scan->nextKey.tuple);
 
+	shared_seq_scan_attach(scan);
+
 	START_CRIT_SECTION();
 	dlist_push_tail(&listOfScans, &scan->listNode);
 
@@ -708,23 +1114,40 @@ make_btree_seq_scan_internal(BTreeDescr *desc, CommitSeqNo csn,
 }
 
 BTreeSeqScan *
-make_btree_seq_scan(BTreeDescr *desc, CommitSeqNo csn)
+make_btree_seq_scan(BTreeDescr *desc, CommitSeqNo csn,
+					ParallelOScanDesc poscan)
 {
-	return make_btree_seq_scan_internal(desc, csn, NULL, NULL, NULL);
+	return make_btree_seq_scan_internal(desc, csn, NULL, NULL, NULL, poscan);
 }
 
 BTreeSeqScan *
 make_btree_seq_scan_cb(BTreeDescr *desc, CommitSeqNo csn,
 					   BTreeSeqScanCallbacks *cb, void *arg)
 {
-	return make_btree_seq_scan_internal(desc, csn, cb, arg, NULL);
+	return make_btree_seq_scan_internal(desc, csn, cb, arg, NULL, NULL);
 }
 
 BTreeSeqScan *
 make_btree_sampling_scan(BTreeDescr *desc, BlockSampler sampler)
 {
 	return make_btree_seq_scan_internal(desc, COMMITSEQNO_INPROGRESS,
-										NULL, NULL, sampler);
+										NULL, NULL, sampler, NULL);
+}
+
+/*
+ * Install a filter applied to leaf tuples before they are copied out of the
+ * page image.  The filter is only invoked on tuples whose page-resident
+ * version is committed, visible to the scan snapshot and not deleted, so it
+ * always sees the version the scan would return; tuples requiring an undo
+ * walk are returned unfiltered.  The filter is an optimization: the caller
+ * must be prepared to recheck the returned tuples.
+ */
+void
+btree_seq_scan_set_tuple_filter(BTreeSeqScan *scan,
+								BTreeSeqScanTupleFilter filter, void *arg)
+{
+	scan->tupleFilter = filter;
+	scan->tupleFilterArg = arg;
 }
 
 static OTuple
@@ -734,6 +1157,7 @@ btree_seq_scan_get_tuple_from_iterator(BTreeSeqScan *scan,
 {
 	OTuple		result;
 
+	set_ucm_scan_hint();
 	if (!O_TUPLE_IS_NULL(scan->iterEnd))
 		result = o_btree_iterator_fetch(scan->iter, tupleCsn,
 										&scan->iterEnd, BTreeKeyNonLeafKey,
@@ -742,6 +1166,7 @@ btree_seq_scan_get_tuple_from_iterator(BTreeSeqScan *scan,
 		result = o_btree_iterator_fetch(scan->iter, tupleCsn,
 										NULL, BTreeKeyNone,
 										false, hint);
+	unset_ucm_scan_hint();
 
 	if (O_TUPLE_IS_NULL(result))
 	{
@@ -1028,6 +1453,38 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 			continue;
 		}
 
+		/*
+		 * When the page-resident version is committed, visible and not
+		 * deleted, it's exactly the version the scan would return: apply the
+		 * tuple filter to it in-place, skipping the version walk and the
+		 * tuple copy for non-matching tuples.  Versions requiring the undo
+		 * walk are returned unfiltered and rechecked by the caller.
+		 */
+		if (scan->tupleFilter)
+		{
+			BTreeLeafTuphdr *tupHdr;
+			OTuple		rawTuple;
+
+			BTREE_PAGE_READ_LEAF_ITEM(tupHdr, rawTuple,
+									  scan->leafImg, &scan->leafLoc);
+			if (!tupHdr->deleted &&
+				!XACT_INFO_IS_LOCK_ONLY(tupHdr->xactInfo) &&
+				XACT_INFO_IS_FINISHED(tupHdr->xactInfo))
+			{
+				CommitSeqNo tupcsn = XACT_INFO_MAP_CSN(tupHdr->xactInfo);
+
+				if (!COMMITSEQNO_IS_INPROGRESS(tupcsn) &&
+					!COMMITSEQNO_IS_ABORTED(tupcsn) &&
+					(tupcsn < scan->snapshotCsn ||
+					 COMMITSEQNO_IS_INPROGRESS(scan->snapshotCsn)) &&
+					!scan->tupleFilter(rawTuple, scan->tupleFilterArg))
+				{
+					BTREE_PAGE_LOCATOR_NEXT(scan->leafImg, &scan->leafLoc);
+					continue;
+				}
+			}
+		}
+
 		tuple = o_find_tuple_version(scan->desc,
 									 scan->leafImg,
 									 &scan->leafLoc,
@@ -1186,6 +1643,8 @@ free_btree_seq_scan(BTreeSeqScan *scan)
 {
 	BTreeMetaPage *metaPageBlkno = BTREE_GET_META(scan->desc);
 
+	shared_seq_scan_detach(scan);
+
 	START_CRIT_SECTION();
 	dlist_delete(&scan->listNode);
 	(void) pg_atomic_fetch_sub_u32(&metaPageBlkno->numSeqScans[scan->checkpointNumber % NUM_SEQ_SCANS_ARRAY_SIZE], 1);
@@ -1209,6 +1668,7 @@ seq_scans_cleanup(void)
 		BTreeSeqScan *scan = dlist_head_element(BTreeSeqScan, listNode, &listOfScans);
 		BTreeMetaPage *metaPageBlkno = BTREE_GET_META(scan->desc);
 
+		shared_seq_scan_detach(scan);
 		(void) pg_atomic_fetch_sub_u32(&metaPageBlkno->numSeqScans[scan->checkpointNumber % NUM_SEQ_SCANS_ARRAY_SIZE], 1);
 
 		dlist_delete(&scan->listNode);
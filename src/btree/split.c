@@ -27,6 +27,12 @@
 #include "miscadmin.h"
 #include "utils/memutils.h"
 
+/*
+ * How far from the space-balanced split point we are willing to move the
+ * boundary looking for adjacent tuples with distinct key prefixes.
+ */
+#define O_SPLIT_DISTINCT_KEY_WINDOW 8
+
 typedef struct
 {
 	BTreeDescr *desc;
@@ -175,13 +181,15 @@ split_item_interator_get(SplitItemIterator *it)
  * as close as possible to `targetLocation`, or if `targetLocation == 0` close
  * to `spaceRatio`.  Also, this function takes advantage of reclaiming unused
  * space according to `csn`.  Returns number of items in new left page and
- * sets the first tuple of right page to `*split_item`.
+ * sets the first tuple of right page to `*split_item` and the last tuple of
+ * the left page to `*left_item`.
  */
 OffsetNumber
 btree_page_split_location(BTreeDescr *desc, Page page, OffsetNumber offset,
 						  LocationIndex tuplesize, OTuple tuple, bool replace,
 						  OffsetNumber targetLocation, float4 spaceRatio,
-						  OTuple *split_item, CommitSeqNo csn)
+						  OTuple *split_item, OTuple *left_item,
+						  CommitSeqNo csn)
 {
 	int			leftPageSpaceLeft,
 				rightPageSpaceLeft,
@@ -268,9 +276,121 @@ btree_page_split_location(BTreeDescr *desc, Page page, OffsetNumber offset,
 		}
 	}
 
+	/*
+	 * For leaf pages of trees with attribute-wise comparison, try to move
+	 * the split point to a nearby boundary between distinct key prefixes.
+	 * Non-unique indexes repeat the key in long runs of tuples differing
+	 * only in the primary key tail: splitting inside such a run spreads it
+	 * over two pages and forces a separator carrying the whole tuple key.
+	 * A boundary between runs keeps duplicates together and lets the
+	 * separator be truncated down to the first distinct attribute.
+	 */
+	if (O_PAGE_IS(page, LEAF) && desc->ops->cmpPrefix != NULL &&
+		targetLocation == 0)
+	{
+		SplitItemIterator it,
+					last_left_it;
+		OTuple		lastLeft,
+					firstRight;
+		int			bestEqualAtts,
+					equalAtts,
+					bestShift = 0,
+					shift,
+					spaceLeft,
+					count;
+
+		last_left_it = left_it;
+		split_item_interator_prev(&last_left_it);
+		lastLeft = split_item_interator_get(&last_left_it);
+		firstRight = split_item_interator_get(&left_it);
+
+		/*
+		 * cmpPrefix() reads *equalAtts on entry as the number of leading
+		 * attributes to skip, so it must be zeroed before every call.
+		 */
+		bestEqualAtts = 0;
+		(void) desc->ops->cmpPrefix(desc,
+									&lastLeft, BTreeKeyLeafTuple,
+									&firstRight, BTreeKeyLeafTuple,
+									&bestEqualAtts);
+
+		/* Scan the boundaries right of the chosen one */
+		it = left_it;
+		spaceLeft = leftPageSpaceLeft;
+		count = minLeftPageItemsCount;
+		for (shift = 1;
+			 shift <= O_SPLIT_DISTINCT_KEY_WINDOW && bestEqualAtts > 0;
+			 shift++)
+		{
+			spaceLeft -= split_item_interator_size(&it);
+			if (spaceLeft < 0 || count >= totalCount - 1)
+				break;
+			count++;
+			lastLeft = split_item_interator_get(&it);
+			split_item_interator_next(&it);
+			firstRight = split_item_interator_get(&it);
+			equalAtts = 0;
+			(void) desc->ops->cmpPrefix(desc,
+										&lastLeft, BTreeKeyLeafTuple,
+										&firstRight, BTreeKeyLeafTuple,
+										&equalAtts);
+			if (equalAtts < bestEqualAtts)
+			{
+				bestEqualAtts = equalAtts;
+				bestShift = shift;
+			}
+		}
+
+		/* Scan the boundaries left of the chosen one */
+		it = right_it;
+		spaceLeft = rightPageSpaceLeft;
+		count = minLeftPageItemsCount;
+		for (shift = 1;
+			 shift <= O_SPLIT_DISTINCT_KEY_WINDOW && bestEqualAtts > 0;
+			 shift++)
+		{
+			spaceLeft -= split_item_interator_size(&it);
+			if (spaceLeft < 0 || count <= 1)
+				break;
+			count--;
+			firstRight = split_item_interator_get(&it);
+			split_item_interator_prev(&it);
+			lastLeft = split_item_interator_get(&it);
+			equalAtts = 0;
+			(void) desc->ops->cmpPrefix(desc,
+										&lastLeft, BTreeKeyLeafTuple,
+										&firstRight, BTreeKeyLeafTuple,
+										&equalAtts);
+			if (equalAtts < bestEqualAtts)
+			{
+				bestEqualAtts = equalAtts;
+				bestShift = -shift;
+			}
+		}
+
+		for (; bestShift > 0; bestShift--)
+		{
+			split_item_interator_next(&left_it);
+			minLeftPageItemsCount++;
+		}
+		for (; bestShift < 0; bestShift++)
+		{
+			split_item_interator_prev(&left_it);
+			minLeftPageItemsCount--;
+		}
+	}
+
 	if (split_item)
 		*split_item = split_item_interator_get(&left_it);
 
+	if (left_item)
+	{
+		SplitItemIterator last_left_it = left_it;
+
+		split_item_interator_prev(&last_left_it);
+		*left_item = split_item_interator_get(&last_left_it);
+	}
+
 	return minLeftPageItemsCount;
 }
 
@@ -287,6 +407,7 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 	OffsetNumber result;
 	float4		spaceRatio;
 	OTuple		split_item;
+	OTuple		left_item;
 
 	/* The default target is to split the page 50%/50% */
 	targetCount = 0;
@@ -316,6 +437,36 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 			targetCount = offset;
 	}
 
+	/*
+	 * The previous insert wasn't adjacent, but the page-level pattern scores
+	 * may still recognize an ordered workload: several interleaved ascending
+	 * (or descending) streams rarely produce two consecutive adjacent
+	 * inserts into the same page, yet each stream inserts ahead of its own
+	 * front.  Split the same way as for the exactly detected order then.
+	 */
+	else if (O_INSERT_PATTERN_ASC(header) >= O_INSERT_PATTERN_THRESHOLD)
+	{
+		if ((float) offset / (float) header->itemsCount >= 0.9)
+			targetCount = offset;
+		else
+			targetCount = offset + 1;
+	}
+	else if (O_INSERT_PATTERN_DESC(header) >= O_INSERT_PATTERN_THRESHOLD)
+	{
+		if ((float) offset / (float) header->itemsCount <= 0.1)
+			targetCount = offset + 1;
+		else
+			targetCount = offset;
+	}
+
+	/*
+	 * A hotspot concentrates future inserts around the current offset:
+	 * splitting right at it leaves both halves headroom where the inserts
+	 * will land.
+	 */
+	else if (O_INSERT_PATTERN_HOT(header) >= O_INSERT_PATTERN_THRESHOLD)
+		targetCount = offset;
+
 	/*
 	 * If we don't autodetect the insertion order, we still assume TOAST and
 	 * rightmost inserts are always assumed to be ordered ascendingly.
@@ -324,7 +475,8 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 		spaceRatio = 0.9;
 
 	result = btree_page_split_location(desc, page, offset, tuplesize, tuple, replace,
-									   targetCount, spaceRatio, &split_item, csn);
+									   targetCount, spaceRatio, &split_item,
+									   split_key ? &left_item : NULL, csn);
 
 	/*
 	 * Fill the split key.  Convert tuple to key if needed.
@@ -334,9 +486,36 @@ btree_get_split_left_count(BTreeDescr *desc, OInMemoryBlkno blkno,
 		bool		allocated = true;
 
 		if (O_PAGE_IS(page, LEAF))
+		{
 			split_item = o_btree_tuple_make_key(desc, split_item, NULL,
 												false, &allocated);
 
+			/*
+			 * Truncate the separator key to the shortest attribute prefix
+			 * which still distinguishes the last left tuple from the first
+			 * right one.
+			 */
+			if (desc->ops->truncate_key && desc->ops->cmpPrefix)
+			{
+				OTuple		truncated;
+				int			equalAtts = 0;
+
+				(void) desc->ops->cmpPrefix(desc,
+											&left_item, BTreeKeyLeafTuple,
+											&split_item, BTreeKeyNonLeafKey,
+											&equalAtts);
+				truncated = desc->ops->truncate_key(desc, split_item,
+													equalAtts + 1);
+				if (!O_TUPLE_IS_NULL(truncated))
+				{
+					if (allocated)
+						pfree(split_item.data);
+					split_item = truncated;
+					allocated = true;
+				}
+			}
+		}
+
 		*split_key_len = o_btree_len(desc, split_item, OKeyLength);
 		if (!O_PAGE_IS(page, LEAF) || !allocated)
 		{
@@ -380,6 +559,8 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 	BTreePageItem items[BTREE_PAGE_MAX_CHUNK_ITEMS + 1];
 	char		newItem[Max(BTreeLeafTuphdrSize, BTreeNonLeafTuphdrSize) + O_BTREE_MAX_TUPLE_SIZE];
 
+	O_TREE_STAT_INC(desc, splits);
+
 	init_new_btree_page(desc, new_blkno,
 						left_header->flags & ~(O_BTREE_FLAG_LEFTMOST),
 						PAGE_GET_LEVEL(left_page), false);
@@ -514,6 +695,6 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno, OInMemoryBlkno new_bl
 	o_btree_page_calculate_statistics(desc, left_page);
 	o_btree_page_calculate_statistics(desc, right_page);
 
-	MARK_DIRTY(desc->ppool, blkno);
-	MARK_DIRTY(desc->ppool, new_blkno);
+	MARK_DIRTY(desc, blkno);
+	MARK_DIRTY(desc, new_blkno);
 }
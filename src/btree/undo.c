@@ -29,6 +29,31 @@
 #include "access/transam.h"
 #include "miscadmin.h"
 #include "utils/inval.h"
+#include "utils/memutils.h"
+
+/*
+ * Per-backend cache of tuple versions materialized from the undo log.
+ *
+ * Visibility checks of a recently modified tuple walk its version chain and
+ * re-read the same undo records again and again; long snapshots under OLTP
+ * churn make this a noticeable CPU cost.  A version payload is written to the
+ * undo log once and never changes (undo locations are never reused), so it
+ * can be cached safely.  The leaf tuple header stored next to it can't: it
+ * keeps being updated in place, see update_leaf_header_in_undo().  Therefore
+ * only the materialized payload is cached, and the header is always read
+ * fresh.
+ */
+typedef struct
+{
+	UndoLocation location;		/* InvalidUndoLocation means an empty entry */
+	LocationIndex tupleSize;
+	uint64		lastUsage;
+	char		data[O_BTREE_MAX_TUPLE_SIZE];
+} UndoTupleCacheEntry;
+
+static UndoTupleCacheEntry *undo_tuple_cache = NULL;
+static int	undo_tuple_cache_entries = 0;
+static uint64 undo_tuple_cache_clock = 0;
 
 /* Undo records */
 typedef struct
@@ -38,6 +63,21 @@ typedef struct
 	ORelOids	oids;
 	OInMemoryBlkno blkno;
 	uint32		pageChangeCount;
+
+	/*
+	 * Delta-encoded update record: instead of the full old tuple image, the
+	 * payload contains the tuple key followed by the bytes of the old tuple
+	 * which differ from the new one.  The old tuple is reconstructed by
+	 * splicing the diff between the common prefix and suffix of the
+	 * successor version.  deltaKeyLen of zero means a plain full image.
+	 */
+	LocationIndex deltaKeyLen;
+	LocationIndex deltaPrefixLen;
+	LocationIndex deltaSuffixLen;
+	LocationIndex deltaOldLen;
+	LocationIndex deltaNewLen;
+	uint8		deltaKeyFlags;
+
 	BTreeLeafTuphdr tuphdr;
 } BTreeModifyUndoStackItem;
 
@@ -101,6 +141,22 @@ page_add_item_to_undo(BTreeDescr *desc, Pointer p, CommitSeqNo imageCsn,
 	return undoLocation;
 }
 
+/*
+ * Reflect a live/deleted state transition of a page tuple in the approximate
+ * per-tree live tuple counter.
+ */
+static void
+adjust_live_tuples_num(BTreeDescr *desc, bool wasLive, bool isLive)
+{
+	if (isLive == wasLive)
+		return;
+
+	if (isLive)
+		pg_atomic_fetch_add_u64(&BTREE_GET_META(desc)->liveTuplesNum, 1);
+	else
+		pg_atomic_fetch_sub_u64(&BTREE_GET_META(desc)->liveTuplesNum, 1);
+}
+
 /*
  * Given page item modified by in-progress transaction.  Rollback changes
  * using undo chain.  Specify 'wholeChain' flag to revert all in-progress
@@ -119,9 +175,11 @@ page_item_rollback(BTreeDescr *desc, Page p, BTreePageItemLocator *locator,
 	Pointer		item;
 	BTreeLeafTuphdr *tuphdr,
 				nonLockTuphdr;
+	bool		wasLive;
 
 	item = BTREE_PAGE_LOCATOR_GET_ITEM(p, locator);
 	tuphdr = (BTreeLeafTuphdr *) item;
+	wasLive = !tuphdr->deleted;
 
 	if (!nonLockTuphdrPtr)
 	{
@@ -180,7 +238,8 @@ retry:
 		tuplen = BTREE_PAGE_GET_ITEM_SIZE(p, locator) - BTreeLeafTuphdrSize;
 		get_prev_leaf_header_and_tuple_from_undo(&prev_header,
 												 &tuple,
-												 tuplen);
+												 tuplen,
+												 tuple);
 		tuplen = o_btree_len(desc, tuple, OTupleLength);
 		itemlen = BTreeLeafTuphdrSize + MAXALIGN(tuplen);
 
@@ -220,7 +279,10 @@ retry:
 			/* Find the next item in the chain */
 			nonLockUndoLocation = find_non_lock_only_undo_record(nonLockTuphdrPtr);
 			if (XACT_INFO_IS_FINISHED(nonLockTuphdrPtr->xactInfo))
+			{
+				adjust_live_tuples_num(desc, wasLive, !tuphdr->deleted);
 				return true;
+			}
 			item = BTREE_PAGE_LOCATOR_GET_ITEM(p, locator);
 			tuphdr = (BTreeLeafTuphdr *) item;
 			goto retry;
@@ -241,15 +303,17 @@ retry:
 						   (BTreeLeafTuphdrSize + MAXALIGN(o_btree_len(desc, prev_tuple, OTupleLength))));
 
 		page_locator_delete_item(p, locator);
+		adjust_live_tuples_num(desc, wasLive, false);
 		return false;
 	}
+	adjust_live_tuples_num(desc, wasLive, !tuphdr->deleted);
 	return true;
 }
 
 static Jsonb *
 undo_record_key_stopevent_params(BTreeOperationType action,
 								 BTreeDescr *desc,
-								 OTuple tuple, OXid oxid)
+								 OTuple tuple, bool is_tuple, OXid oxid)
 {
 	JsonbParseState *state = NULL;
 	Jsonb	   *res;
@@ -267,7 +331,7 @@ undo_record_key_stopevent_params(BTreeOperationType action,
 	jsonb_push_int8_key(&state, "oxid", oxid);
 	btree_desc_stopevent_params_internal(desc, &state);
 	jsonb_push_key(&state, "key");
-	if (action == BTreeOperationUpdate)
+	if (is_tuple)
 	{
 		OTuple		key;
 		bool		allocated;
@@ -287,30 +351,87 @@ undo_record_key_stopevent_params(BTreeOperationType action,
 	return res;
 }
 
+/*
+ * Compute the layout of a delta-encoded update record for the given old and
+ * new tuple images.  Returns false if the full image isn't worth delta
+ * encoding.
+ */
+static bool
+delta_update_layout(BTreeDescr *desc, OTuple tuple, OTuple newTuple,
+					LocationIndex tuplelen,
+					LocationIndex *keyLen, LocationIndex *prefixLen,
+					LocationIndex *suffixLen, LocationIndex *newLen)
+{
+	LocationIndex newTupleLen,
+				minLen,
+				prefix,
+				suffix;
+
+	newTupleLen = o_btree_len(desc, newTuple, OTupleLength);
+	minLen = Min(tuplelen, newTupleLen);
+
+	prefix = 0;
+	while (prefix < minLen && tuple.data[prefix] == newTuple.data[prefix])
+		prefix++;
+
+	suffix = 0;
+	while (suffix < minLen - prefix &&
+		   tuple.data[tuplelen - suffix - 1] ==
+		   newTuple.data[newTupleLen - suffix - 1])
+		suffix++;
+
+	*keyLen = o_btree_len(desc, tuple, OTupleKeyLength);
+	*prefixLen = prefix;
+	*suffixLen = suffix;
+	*newLen = newTupleLen;
+
+	/* Only bother when the delta is substantially smaller. */
+	return *keyLen + (tuplelen - prefix - suffix) +
+		sizeof(LocationIndex) * 4 < tuplelen;
+}
+
 /*
  * Make undo record associated with give tuple and operation.
+ *
+ * For update records the caller may pass the new tuple image: then the old
+ * tuple is stored delta-encoded against it when that pays off.  The new
+ * image must stay the record's immediate successor in the version chain,
+ * see undo_record_is_delta_update().
  */
 BTreeLeafTuphdr *
 make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 				 BTreeOperationType action, OInMemoryBlkno blkno,
 				 uint32 pageChangeCount,
-				 UndoLocation *undoLocation)
+				 UndoLocation *undoLocation, OTuple *newTuple)
 {
 	LocationIndex tuplelen;
 	BTreeModifyUndoStackItem *item;
 	LocationIndex size;
+	LocationIndex keyLen = 0,
+				prefixLen = 0,
+				suffixLen = 0,
+				newLen = 0;
+	bool		delta = false;
 
 	if (action == BTreeOperationUpdate)
 	{
 		Assert(is_tuple);
 		tuplelen = o_btree_len(desc, tuple, OTupleLength);
+		if (newTuple && !O_TUPLE_IS_NULL(*newTuple))
+			delta = delta_update_layout(desc, tuple, *newTuple, tuplelen,
+										&keyLen, &prefixLen, &suffixLen,
+										&newLen);
 	}
 	else
 	{
 		tuplelen = o_btree_len(desc, tuple, is_tuple ? OTupleKeyLength : OKeyLength);
 	}
 
-	size = sizeof(BTreeModifyUndoStackItem) + tuplelen;
+	if (delta)
+		size = sizeof(BTreeModifyUndoStackItem) + keyLen +
+			(tuplelen - prefixLen - suffixLen);
+	else
+		size = sizeof(BTreeModifyUndoStackItem) + tuplelen;
 	item = (BTreeModifyUndoStackItem *) get_undo_record(desc->undoType,
 														undoLocation,
 														MAXALIGN(size));
@@ -324,8 +445,31 @@ make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 	item->blkno = blkno;
 	item->pageChangeCount = pageChangeCount;
 	item->oids = desc->oids;
+	item->deltaKeyLen = 0;
+	item->deltaKeyFlags = 0;
+
+	if (delta)
+	{
+		bool		key_palloc = false;
+		OTuple		key;
 
-	if (action == BTreeOperationUpdate || !is_tuple)
+		memset((Pointer) item + sizeof(BTreeModifyUndoStackItem), 0, keyLen);
+		key = o_btree_tuple_make_key(desc, tuple,
+									 (Pointer) item + sizeof(BTreeModifyUndoStackItem),
+									 true, &key_palloc);
+		Assert(!key_palloc);
+		memcpy((Pointer) item + sizeof(BTreeModifyUndoStackItem) + keyLen,
+			   tuple.data + prefixLen,
+			   tuplelen - prefixLen - suffixLen);
+		item->deltaKeyLen = keyLen;
+		item->deltaKeyFlags = key.formatFlags;
+		item->deltaPrefixLen = prefixLen;
+		item->deltaSuffixLen = suffixLen;
+		item->deltaOldLen = tuplelen;
+		item->deltaNewLen = newLen;
+		item->tuphdr.formatFlags = tuple.formatFlags;
+	}
+	else if (action == BTreeOperationUpdate || !is_tuple)
 	{
 		memcpy((Pointer) item + sizeof(BTreeModifyUndoStackItem),
 			   tuple.data,
@@ -351,6 +495,26 @@ make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 	return &item->tuphdr;
 }
 
+/*
+ * Check whether the undo record at given location is a delta-encoded update.
+ * Such record can only be reconstructed against its immediate successor
+ * version, so overwriting the successor in place (without chaining a new
+ * undo record) is not allowed.
+ */
+bool
+undo_record_is_delta_update(UndoLocation location)
+{
+	BTreeModifyUndoStackItem item;
+
+	undo_read(location - offsetof(BTreeModifyUndoStackItem, tuphdr),
+			  sizeof(BTreeModifyUndoStackItem),
+			  (Pointer) &item);
+
+	return item.header.type == ModifyUndoItemType &&
+		item.action == BTreeOperationUpdate &&
+		item.deltaKeyLen != 0;
+}
+
 static BTreeDescr *
 get_tree_descr(ORelOids oids, OIndexType type)
 {
@@ -368,6 +532,21 @@ get_tree_descr(ORelOids oids, OIndexType type)
 	}
 }
 
+/*
+ * Returns the tree oids of a modify or row lock undo item.  Used to route
+ * the item during parallel rollback while keeping the item layout private.
+ */
+ORelOids
+btree_undo_item_get_oids(UndoStackItem *baseItem)
+{
+	BTreeModifyUndoStackItem *item = (BTreeModifyUndoStackItem *) baseItem;
+
+	Assert(baseItem->type == ModifyUndoItemType ||
+		   baseItem->type == RowLockUndoItemType);
+
+	return item->oids;
+}
+
 /*
  * Callback for aborting B-tree record modification.
  */
@@ -393,14 +572,25 @@ modify_undo_callback(UndoLocation location, UndoStackItem *baseItem,
 	if (!desc)
 		return;
 
-	tuple.formatFlags = item->tuphdr.formatFlags;
-	tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+	if (item->action == BTreeOperationUpdate && item->deltaKeyLen != 0)
+	{
+		/* Delta-encoded record: the payload begins with the tuple key */
+		tuple.formatFlags = item->deltaKeyFlags;
+		tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+		keyType = BTreeKeyNonLeafKey;
+	}
+	else
+	{
+		tuple.formatFlags = item->tuphdr.formatFlags;
+		tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+	}
 
 	if (STOPEVENTS_ENABLED())
 	{
 		Jsonb	   *params = undo_record_key_stopevent_params(item->action,
-															  desc,
-															  tuple, oxid);
+															  desc, tuple,
+															  keyType == BTreeKeyLeafTuple,
+															  oxid);
 
 		STOPEVENT(STOPEVENT_APPLY_UNDO, params);
 	}
@@ -472,7 +662,7 @@ modify_undo_callback(UndoLocation location, UndoStackItem *baseItem,
 								  &nonLockTupHdr, nonLockUndoLocation);
 	}
 
-	MARK_DIRTY(desc->ppool, blkno);
+	MARK_DIRTY(desc, blkno);
 	if (blkno != desc->rootInfo.rootPageBlkno && is_page_too_sparse(desc, p))
 	{
 		/* We can try to merge this page */
@@ -513,7 +703,8 @@ lock_undo_callback(UndoLocation location, UndoStackItem *baseItem, OXid oxid,
 	if (STOPEVENTS_ENABLED())
 	{
 		Jsonb	   *params = undo_record_key_stopevent_params(BTreeOperationLock,
-															  desc, key, oxid);
+															  desc, key, false,
+															  oxid);
 
 		STOPEVENT(STOPEVENT_APPLY_UNDO, params);
 	}
@@ -586,7 +777,7 @@ lock_undo_callback(UndoLocation location, UndoStackItem *baseItem, OXid oxid,
 				page_tuphdr->undoLocation = prev_tuphdr.undoLocation;
 				page_tuphdr->chainHasLocks = prev_tuphdr.chainHasLocks;
 				tuphdr = *page_tuphdr;
-				MARK_DIRTY(desc->ppool, blkno);
+				MARK_DIRTY(desc, blkno);
 			}
 			else
 			{
@@ -1344,10 +1535,78 @@ get_prev_leaf_header_from_undo(BTreeLeafTuphdr *tuphdr, bool inPage)
 	}
 }
 
+/*
+ * Looks up the materialized version payload at the given undo location.
+ */
+static bool
+undo_tuple_cache_lookup(UndoLocation location, Pointer dest,
+						LocationIndex tupleSize)
+{
+	int			i;
+
+	for (i = 0; i < undo_tuple_cache_entries; i++)
+	{
+		UndoTupleCacheEntry *entry = &undo_tuple_cache[i];
+
+		if (entry->location == location)
+		{
+			Assert(entry->tupleSize == tupleSize);
+			memcpy(dest, entry->data, tupleSize);
+			entry->lastUsage = ++undo_tuple_cache_clock;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Puts a materialized version payload into the cache, evicting the least
+ * recently used entry.  Allocates the cache on the first call.
+ */
+static void
+undo_tuple_cache_store(UndoLocation location, Pointer data,
+					   LocationIndex tupleSize)
+{
+	UndoTupleCacheEntry *victim;
+	int			i;
+
+	if (undo_tuple_cache_size <= 0)
+		return;
+
+	if (undo_tuple_cache == NULL)
+	{
+		undo_tuple_cache_entries = undo_tuple_cache_size;
+		undo_tuple_cache = (UndoTupleCacheEntry *)
+			MemoryContextAlloc(TopMemoryContext,
+							   sizeof(UndoTupleCacheEntry) *
+							   undo_tuple_cache_entries);
+		for (i = 0; i < undo_tuple_cache_entries; i++)
+			undo_tuple_cache[i].location = InvalidUndoLocation;
+	}
+
+	victim = &undo_tuple_cache[0];
+	for (i = 1; i < undo_tuple_cache_entries; i++)
+	{
+		if (!UndoLocationIsValid(undo_tuple_cache[i].location))
+		{
+			victim = &undo_tuple_cache[i];
+			break;
+		}
+		if (undo_tuple_cache[i].lastUsage < victim->lastUsage)
+			victim = &undo_tuple_cache[i];
+	}
+
+	victim->location = location;
+	victim->tupleSize = tupleSize;
+	victim->lastUsage = ++undo_tuple_cache_clock;
+	memcpy(victim->data, data, tupleSize);
+}
+
 void
 get_prev_leaf_header_and_tuple_from_undo(BTreeLeafTuphdr *tuphdr,
 										 OTuple *tuple,
-										 LocationIndex sizeAvailable)
+										 LocationIndex sizeAvailable,
+										 OTuple newTuple)
 {
 	BTreeModifyUndoStackItem item;
 	LocationIndex tupleSize;
@@ -1363,13 +1622,52 @@ get_prev_leaf_header_and_tuple_from_undo(BTreeLeafTuphdr *tuphdr,
 
 	*tuphdr = item.tuphdr;
 	tuple->formatFlags = tuphdr->formatFlags;
-	tupleSize = item.header.itemSize - sizeof(BTreeModifyUndoStackItem);
+
+	tupleSize = (item.deltaKeyLen != 0) ? item.deltaOldLen :
+		item.header.itemSize - sizeof(BTreeModifyUndoStackItem);
 	if (sizeAvailable == 0)
 		tuple->data = palloc(tupleSize);
 	Assert(sizeAvailable == 0 || sizeAvailable >= tupleSize);
-	undo_read(undoLocation + BTreeLeafTuphdrSize,
-			  tupleSize,
-			  tuple->data);
+
+	if (undo_tuple_cache_entries > 0 &&
+		undo_tuple_cache_lookup(undoLocation, tuple->data, tupleSize))
+	{
+		tuphdr->formatFlags = 0;
+		return;
+	}
+
+	if (item.deltaKeyLen != 0)
+	{
+		char		reconstructed[O_BTREE_MAX_TUPLE_SIZE];
+		LocationIndex diffLen;
+
+		/*
+		 * Splice the old tuple back together from the common prefix and
+		 * suffix of the successor version and the stored diff.  Compose into
+		 * a scratch buffer first: the destination may alias the successor
+		 * image.
+		 */
+		Assert(!O_TUPLE_IS_NULL(newTuple));
+
+		diffLen = tupleSize - item.deltaPrefixLen - item.deltaSuffixLen;
+		memcpy(reconstructed, newTuple.data, item.deltaPrefixLen);
+		undo_read(undoLocation + BTreeLeafTuphdrSize + item.deltaKeyLen,
+				  diffLen,
+				  reconstructed + item.deltaPrefixLen);
+		memcpy(reconstructed + item.deltaPrefixLen + diffLen,
+			   newTuple.data + item.deltaNewLen - item.deltaSuffixLen,
+			   item.deltaSuffixLen);
+
+		memcpy(tuple->data, reconstructed, tupleSize);
+	}
+	else
+	{
+		undo_read(undoLocation + BTreeLeafTuphdrSize,
+				  tupleSize,
+				  tuple->data);
+	}
+
+	undo_tuple_cache_store(undoLocation, tuple->data, tupleSize);
 	tuphdr->formatFlags = 0;
 }
 
@@ -0,0 +1,202 @@
+/*-------------------------------------------------------------------------
+ *
+ * unique_filter.c
+ *		Bloom filter short-circuiting unique constraint checks.
+ *
+ * o_btree_insert_unique() has to verify the key is absent before the
+ * insertion.  When the key range doesn't fit a single locked page, that
+ * verification takes a second descent to the leaf level.  This module
+ * maintains a shared blocked bloom filter of the keys inserted into unique
+ * trees, so the second descent can be skipped for keys the filter proves to
+ * have never been inserted.
+ *
+ * The filter is shared by all the unique trees: fingerprints are hashes of
+ * both the tree identity and the key, so absence of a fingerprint proves the
+ * key was never inserted into the given tree.  Since the filter starts empty
+ * on the postmaster start while trees may already contain keys, its verdicts
+ * can only be trusted for trees whose every key passed through the filter.
+ * Such coverage is established when an insert observes the tree empty, and is
+ * remembered in the tree meta page together with the filter generation.  The
+ * generation changes on every postmaster start, so a coverage mark surviving
+ * in a checkpointed meta page doesn't outlive the filter itself.
+ *
+ * Deletes never clear fingerprints: a stale fingerprint only costs a false
+ * positive, which falls back to the regular check.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/unique_filter.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/page_contents.h"
+#include "btree/unique_filter.h"
+
+#include "utils/timestamp.h"
+
+/*
+ * A filter block is a single cache line.  Every fingerprint sets
+ * UNIQUE_FILTER_PROBES bits within one block, so both the test and the
+ * insert touch exactly one cache line.
+ */
+#define UNIQUE_FILTER_BLOCK_WORDS	8
+#define UNIQUE_FILTER_BLOCK_BITS	(UNIQUE_FILTER_BLOCK_WORDS * 64)
+#define UNIQUE_FILTER_PROBES		4
+
+typedef struct
+{
+	pg_atomic_uint64 words[UNIQUE_FILTER_BLOCK_WORDS];
+} UniqueFilterBlock;
+
+typedef struct
+{
+	uint64		gen;			/* unique per postmaster lifetime, never 0 */
+	uint64		numBlocks;
+	UniqueFilterBlock blocks[FLEXIBLE_ARRAY_MEMBER];
+} UniqueFilterShared;
+
+static UniqueFilterShared *uniqueFilter = NULL;
+
+Size
+unique_filter_shmem_needs(void)
+{
+	if (unique_filter_size == 0)
+		return 0;
+
+	return CACHELINEALIGN(offsetof(UniqueFilterShared, blocks)) +
+		mul_size(unique_filter_size / sizeof(UniqueFilterBlock),
+				 sizeof(UniqueFilterBlock));
+}
+
+void
+unique_filter_shmem_init(Pointer ptr, bool found)
+{
+	if (unique_filter_size == 0)
+	{
+		uniqueFilter = NULL;
+		return;
+	}
+
+	uniqueFilter = (UniqueFilterShared *) ptr;
+
+	if (!found)
+	{
+		uint64		i,
+					j;
+
+		/*
+		 * The generation must differ from any generation a checkpointed meta
+		 * page could have been written with.  A timestamp fits: it grows
+		 * monotonically across postmaster lifetimes.
+		 */
+		uniqueFilter->gen = Max((uint64) GetCurrentTimestamp(), 1);
+		uniqueFilter->numBlocks = unique_filter_size / sizeof(UniqueFilterBlock);
+
+		for (i = 0; i < uniqueFilter->numBlocks; i++)
+			for (j = 0; j < UNIQUE_FILTER_BLOCK_WORDS; j++)
+				pg_atomic_init_u64(&uniqueFilter->blocks[i].words[j], 0);
+	}
+}
+
+bool
+o_unique_filter_enabled(void)
+{
+	return uniqueFilter != NULL;
+}
+
+/*
+ * Mix the tree identity into the key hash, so trees sharing the filter don't
+ * share fingerprints.  Finalizer constants are borrowed from MurmurHash3.
+ */
+static uint64
+unique_filter_hash(BTreeDescr *desc, uint32 uniqueHash)
+{
+	uint64		x;
+
+	x = ((uint64) desc->oids.relnode << 32) | uniqueHash;
+	x ^= (uint64) desc->oids.datoid * UINT64CONST(0x9E3779B97F4A7C15);
+	x ^= x >> 33;
+	x *= UINT64CONST(0xFF51AFD7ED558CCD);
+	x ^= x >> 33;
+	x *= UINT64CONST(0xC4CEB9FE1A85EC53);
+	x ^= x >> 33;
+	return x;
+}
+
+/*
+ * Mark the tree as covered by the filter if the given locked leaf page shows
+ * the tree is empty.  From an empty state on, every inserted key gets a
+ * fingerprint, so the filter verdicts become trustworthy for this tree.
+ */
+void
+o_unique_filter_try_cover(BTreeDescr *desc, Page p)
+{
+	BTreeMetaPage *meta;
+
+	if (uniqueFilter == NULL)
+		return;
+
+	if (!O_PAGE_IS(p, LEFTMOST) || !O_PAGE_IS(p, RIGHTMOST) ||
+		BTREE_PAGE_ITEMS_COUNT(p) != 0)
+		return;
+
+	meta = BTREE_GET_META(desc);
+	pg_atomic_write_u64(&meta->uniqueFilterGen, uniqueFilter->gen);
+}
+
+bool
+o_unique_filter_covered(BTreeDescr *desc)
+{
+	BTreeMetaPage *meta;
+
+	if (uniqueFilter == NULL)
+		return false;
+
+	meta = BTREE_GET_META(desc);
+	return pg_atomic_read_u64(&meta->uniqueFilterGen) == uniqueFilter->gen;
+}
+
+void
+o_unique_filter_insert(BTreeDescr *desc, uint32 uniqueHash)
+{
+	uint64		h = unique_filter_hash(desc, uniqueHash);
+	UniqueFilterBlock *block;
+	int			i;
+
+	Assert(uniqueFilter != NULL);
+
+	block = &uniqueFilter->blocks[(h >> 36) % uniqueFilter->numBlocks];
+	for (i = 0; i < UNIQUE_FILTER_PROBES; i++)
+	{
+		uint32		bit = (h >> (i * 9)) % UNIQUE_FILTER_BLOCK_BITS;
+
+		(void) pg_atomic_fetch_or_u64(&block->words[bit / 64],
+									  UINT64CONST(1) << (bit % 64));
+	}
+}
+
+bool
+o_unique_filter_test(BTreeDescr *desc, uint32 uniqueHash)
+{
+	uint64		h = unique_filter_hash(desc, uniqueHash);
+	UniqueFilterBlock *block;
+	int			i;
+
+	Assert(uniqueFilter != NULL);
+
+	block = &uniqueFilter->blocks[(h >> 36) % uniqueFilter->numBlocks];
+	for (i = 0; i < UNIQUE_FILTER_PROBES; i++)
+	{
+		uint32		bit = (h >> (i * 9)) % UNIQUE_FILTER_BLOCK_BITS;
+
+		if ((pg_atomic_read_u64(&block->words[bit / 64]) &
+			 (UINT64CONST(1) << (bit % 64))) == 0)
+			return false;
+	}
+	return true;
+}
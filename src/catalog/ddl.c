@@ -1039,6 +1039,7 @@ orioledb_utility_command(PlannedStmt *pstmt,
 					o_table = o_table_tableam_create(oids, toastOids, tupdesc,
 													 compress, primary_compress,
 													 toast_compress);
+					o_table->persistence = rel->rd_rel->relpersistence;
 					o_opclass_add_all(o_table);
 
 					LWLockAcquire(&checkpoint_state->oTablesAddLock, LW_SHARED);
@@ -1115,8 +1116,14 @@ orioledb_utility_command(PlannedStmt *pstmt,
 	{
 		IndexStmt  *stmt = (IndexStmt *) pstmt->utilityStmt;
 		Relation	rel;
+		LOCKMODE	lockmode;
 
-		rel = table_openrv(stmt->relation, AccessExclusiveLock);
+		/*
+		 * Match the lock level taken by o_index_create(): a secondary index
+		 * build doesn't block concurrent readers of the table.
+		 */
+		lockmode = stmt->primary ? AccessExclusiveLock : ShareRowExclusiveLock;
+		rel = table_openrv(stmt->relation, lockmode);
 
 		if ((rel->rd_rel->relkind == RELKIND_RELATION) && is_orioledb_rel(rel))
 		{
@@ -1124,7 +1131,7 @@ orioledb_utility_command(PlannedStmt *pstmt,
 
 			call_next = false;
 		}
-		table_close(rel, AccessExclusiveLock);
+		table_close(rel, lockmode);
 	}
 	else if (IsA(pstmt->utilityStmt, RenameStmt))
 	{
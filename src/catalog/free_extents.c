@@ -49,6 +49,124 @@
 								 (ex1).datoid == (ex2).datoid && \
 								 (ex1).relnode == (ex2).relnode)
 
+/*
+ * Backend-local extent reservations.
+ *
+ * Carving one extent per get_extent() call serializes concurrent evictions
+ * of compressed trees on the pages of the shared free-extents trees.  To cut
+ * the number of tree descents, a successful descent carves up to
+ * EXTENT_RESERVE_BATCH extents of the requested length out of the found free
+ * range and keeps the extras in a backend-local list binned by tree identity
+ * and extent length, so subsequent writes of similar-sized pages of the same
+ * tree are satisfied without touching the shared trees.  A request with no
+ * reservation of the exact length can still be served by splitting the
+ * best-fitting longer reservation of the same tree.  Unused reservations
+ * go back to the shared trees at transaction end and on backend exit.
+ *
+ * metaPage->numFreeBlocks counts the blocks reusable either from the shared
+ * trees or from a backend-local bin: carving subtracts only the extent being
+ * served, serving from a bin subtracts like a tree allocation would, and
+ * returning reservations to the trees adds nothing back.  Reservations lost
+ * to a backend crash are re-collected by the free list restore on the next
+ * start.
+ */
+#define EXTENT_RESERVE_BATCH	8
+
+typedef struct
+{
+	OIndexType	ixType;
+	Oid			datoid;
+	Oid			relnode;
+	uint32		len;
+} ReservedExtentsKey;
+
+typedef struct
+{
+	ReservedExtentsKey key;
+	int			count;
+	uint64		offsets[EXTENT_RESERVE_BATCH - 1];
+} ReservedExtentsBin;
+
+static HTAB *reservedExtents = NULL;
+
+static void free_extent_identity(OIndexType ixType, Oid datoid, Oid relnode,
+								 FileExtent extent);
+
+static ReservedExtentsBin *
+reserved_extents_bin(BTreeDescr *desc, uint16 len, bool create)
+{
+	ReservedExtentsKey key;
+	ReservedExtentsBin *bin;
+	bool		found;
+
+	if (reservedExtents == NULL)
+	{
+		HASHCTL		ctl;
+
+		if (!create)
+			return NULL;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(ReservedExtentsKey);
+		ctl.entrysize = sizeof(ReservedExtentsBin);
+		ctl.hcxt = TopMemoryContext;
+		reservedExtents = hash_create("orioledb reserved extents", 16,
+									  &ctl,
+									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.ixType = desc->type;
+	key.datoid = desc->oids.datoid;
+	key.relnode = desc->oids.relnode;
+	key.len = len;
+
+	bin = hash_search(reservedExtents, &key,
+					  create ? HASH_ENTER : HASH_FIND, &found);
+	if (bin != NULL && !found)
+		bin->count = 0;
+
+	return bin;
+}
+
+/*
+ * Returns all unused backend-local reservations to the shared trees.
+ */
+void
+release_reserved_extents(void)
+{
+	HASH_SEQ_STATUS scan;
+	ReservedExtentsBin *bin;
+
+	if (reservedExtents == NULL)
+		return;
+
+	hash_seq_init(&scan, reservedExtents);
+	while ((bin = (ReservedExtentsBin *) hash_seq_search(&scan)) != NULL)
+	{
+		FileExtent	extent;
+
+		while (bin->count > 0)
+		{
+			extent.off = bin->offsets[--bin->count];
+			extent.len = bin->key.len;
+			free_extent_identity(bin->key.ixType, bin->key.datoid,
+								 bin->key.relnode, extent);
+		}
+		hash_search(reservedExtents, &bin->key, HASH_REMOVE, NULL);
+	}
+}
+
+void
+free_extents_xact_callback(XactEvent event, void *arg)
+{
+	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+		event == XACT_EVENT_PARALLEL_COMMIT ||
+		event == XACT_EVENT_PARALLEL_ABORT ||
+		event == XACT_EVENT_PREPARE)
+		release_reserved_extents();
+}
+
 /*
  * Returns free file extent with length = len.
  *
@@ -90,6 +208,82 @@ get_extent(BTreeDescr *desc, uint16 len)
 	BTreeDescr *len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
 	BTreeDescr *off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
 	OTuple		tmpTup;
+	ReservedExtentsBin *bin;
+	uint64		reserved;
+
+	/*
+	 * In the zoned device mode space is reused per whole zone only, see
+	 * device_zone_switch().  Always append to the current zone.
+	 */
+	if (orioledb_device_zoned())
+	{
+		result.len = len;
+		result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
+		return result;
+	}
+
+	/* serve from the backend-local reservation first */
+	bin = reserved_extents_bin(desc, len, false);
+	if (bin != NULL && bin->count > 0)
+	{
+		result.off = bin->offsets[--bin->count];
+		result.len = len;
+		if (pg_atomic_read_u64(&metaPage->numFreeBlocks) >= len)
+			pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
+		return result;
+	}
+
+	/*
+	 * No reservation of the exact length.  Before descending the shared
+	 * trees, try to split a longer reservation held for the same tree: pick
+	 * the best-fitting bin, serve the head of one of its extents and keep
+	 * the tail in the bin of the remaining length.
+	 */
+	if (reservedExtents != NULL)
+	{
+		HASH_SEQ_STATUS scan;
+		ReservedExtentsBin *curBin,
+				   *bestBin = NULL;
+
+		hash_seq_init(&scan, reservedExtents);
+		while ((curBin = (ReservedExtentsBin *) hash_seq_search(&scan)) != NULL)
+		{
+			if (curBin->count == 0 || curBin->key.len <= len ||
+				curBin->key.ixType != desc->type ||
+				curBin->key.datoid != desc->oids.datoid ||
+				curBin->key.relnode != desc->oids.relnode)
+				continue;
+			if (bestBin == NULL || curBin->key.len < bestBin->key.len)
+				bestBin = curBin;
+		}
+
+		if (bestBin != NULL)
+		{
+			uint64		off = bestBin->offsets[--bestBin->count];
+			uint16		restLen = bestBin->key.len - len;
+
+			result.off = off;
+			result.len = len;
+
+			bin = reserved_extents_bin(desc, restLen, true);
+			if (bin->count < EXTENT_RESERVE_BATCH - 1)
+				bin->offsets[bin->count++] = off + len;
+			else
+			{
+				FileExtent	rest;
+
+				rest.off = off + len;
+				rest.len = restLen;
+				free_extent_identity(desc->type, desc->oids.datoid,
+									 desc->oids.relnode, rest);
+			}
+
+			/* the tail stays counted, subtract the served extent only */
+			if (pg_atomic_read_u64(&metaPage->numFreeBlocks) >= len)
+				pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
+			return result;
+		}
+	}
 
 	/* a fast check */
 	if (pg_atomic_read_u64(&metaPage->numFreeBlocks) < len)
@@ -203,7 +397,7 @@ get_extent(BTreeDescr *desc, uint16 len)
 
 	deleted_tup = *cur_tup;
 
-	MARK_DIRTY(len_off_tree->ppool, context.items[context.index].blkno);
+	MARK_DIRTY(len_off_tree, context.items[context.index].blkno);
 
 	if (is_page_too_sparse(len_off_tree, p))
 		(void) btree_try_merge_and_unlock(len_off_tree,
@@ -213,8 +407,25 @@ get_extent(BTreeDescr *desc, uint16 len)
 		unlock_page(context.items[context.index].blkno);
 
 	Assert(deleted_tup.extent.length >= len);
+
+	/*
+	 * Reserve extra extents of the same length from the tail of the found
+	 * free range, so following allocations don't have to descend the trees
+	 * again.  The range is deleted from the trees as a whole below, only the
+	 * middle part between the served extent and the reservations returns.
+	 */
+	reserved = 0;
+	bin = reserved_extents_bin(desc, len, true);
+	while (bin->count < EXTENT_RESERVE_BATCH - 1 &&
+		   deleted_tup.extent.length - reserved >= 2 * len)
+	{
+		reserved += len;
+		bin->offsets[bin->count++] =
+			deleted_tup.extent.offset + deleted_tup.extent.length - reserved;
+	}
+
 	tup = deleted_tup;
-	tup.extent.length -= len;
+	tup.extent.length -= len + reserved;
 
 	if (tup.extent.length > 0)
 	{
@@ -263,6 +474,183 @@ get_extent(BTreeDescr *desc, uint16 len)
 	return result;
 }
 
+/*
+ * Number of (off, len) B-tree tuples examined after the hint offset before
+ * get_extent_near() gives up on locality and falls back to get_extent().
+ */
+#define EXTENT_NEAR_SEARCH_WINDOW	16
+
+/*
+ * Like get_extent(), but prefers free space located at or after hintOff, so
+ * that evicted pages of a compressed tree land near their previous location
+ * and the disk order established by index build and checkpointing survives
+ * evict/load cycles.  Falls back to get_extent() placement when no free
+ * extent of a sufficient length is found in the window after the hint.
+ */
+FileExtent
+get_extent_near(BTreeDescr *desc, uint16 len, uint64 hintOff)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	BTreeIterator *it;
+	FreeTreeTuple tup,
+				found_tup,
+			   *cur;
+	FileExtent	result;
+	BTreeDescr *len_off_tree;
+	BTreeDescr *off_len_tree;
+	OTuple		tmpTup;
+	ReservedExtentsBin *bin;
+	bool		old_enable_stopevents;
+	bool		claimed = false,
+				modify_result;
+
+	if (!FileExtentOffIsValid(hintOff) || orioledb_device_zoned())
+		return get_extent(desc, len);
+
+	/* serve the backend-local reservation closest to the hint first */
+	bin = reserved_extents_bin(desc, len, false);
+	if (bin != NULL && bin->count > 0)
+	{
+		int			best = 0,
+					i;
+
+		for (i = 1; i < bin->count; i++)
+		{
+			uint64		bestDist = bin->offsets[best] > hintOff ?
+			bin->offsets[best] - hintOff : hintOff - bin->offsets[best];
+			uint64		curDist = bin->offsets[i] > hintOff ?
+			bin->offsets[i] - hintOff : hintOff - bin->offsets[i];
+
+			if (curDist < bestDist)
+				best = i;
+		}
+
+		result.off = bin->offsets[best];
+		result.len = len;
+		bin->offsets[best] = bin->offsets[--bin->count];
+		if (pg_atomic_read_u64(&metaPage->numFreeBlocks) >= len)
+			pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
+		return result;
+	}
+
+	/* no free space at all: get_extent() will extend the file */
+	if (pg_atomic_read_u64(&metaPage->numFreeBlocks) < len)
+		return get_extent(desc, len);
+
+	len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
+	off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
+
+	old_enable_stopevents = enable_stopevents;
+	enable_stopevents = false;
+
+	memset(&tup, 0, sizeof(FreeTreeTuple));
+	tup.ixType = desc->type;
+	tup.datoid = desc->oids.datoid;
+	tup.relnode = desc->oids.relnode;
+
+	while (!claimed)
+	{
+		int			window;
+		bool		found = false;
+
+		tup.extent.offset = hintOff;
+		tup.extent.length = 0;
+
+		/* find a long enough free extent at or after the hint */
+		tmpTup.data = (Pointer) &tup;
+		tmpTup.formatFlags = 0;
+		it = o_btree_iterator_create(off_len_tree, (Pointer) &tmpTup,
+									 BTreeKeyNonLeafKey,
+									 COMMITSEQNO_INPROGRESS,
+									 ForwardScanDirection);
+		for (window = 0; window < EXTENT_NEAR_SEARCH_WINDOW; window++)
+		{
+			tmpTup = o_btree_iterator_fetch(it, NULL, NULL, BTreeKeyLeafTuple,
+											false, NULL);
+			cur = (FreeTreeTuple *) tmpTup.data;
+			if (cur == NULL || !EXTENTS_IX_EQ(*cur, tup))
+			{
+				if (cur != NULL)
+					pfree(cur);
+				break;
+			}
+			if (cur->extent.length >= len)
+			{
+				found_tup = *cur;
+				found = true;
+				pfree(cur);
+				break;
+			}
+			pfree(cur);
+		}
+		btree_iterator_free(it);
+
+		if (!found)
+		{
+			enable_stopevents = old_enable_stopevents;
+			return get_extent(desc, len);
+		}
+
+		/*
+		 * Claim the extent: as in free_extent(), a successful delete from the
+		 * (len, off) B-tree guarantees the rest of the modifications, a
+		 * failed one means the extent has been taken concurrently.
+		 */
+		tmpTup.data = (Pointer) &found_tup;
+		tmpTup.formatFlags = 0;
+		modify_result = o_btree_autonomous_delete(len_off_tree, tmpTup,
+												  BTreeKeyLeafTuple, NULL);
+		if (!modify_result)
+			continue;
+
+		claimed = true;
+	}
+
+	pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
+
+	tmpTup.data = (Pointer) &found_tup;
+	tmpTup.formatFlags = 0;
+	modify_result = o_btree_autonomous_delete(off_len_tree, tmpTup,
+											  BTreeKeyLeafTuple, NULL);
+	if (!modify_result)
+	{
+		elog(FATAL, "unable to delete extent (%lu, %lu) from the (off, len) B-tree",
+			 found_tup.extent.offset, found_tup.extent.length);
+	}
+
+	if (found_tup.extent.length > len)
+	{
+		/* serve the head, return the tail into both B-trees */
+		tup = found_tup;
+		tup.extent.offset += len;
+		tup.extent.length -= len;
+
+		tmpTup.data = (Pointer) &tup;
+		tmpTup.formatFlags = 0;
+		modify_result = o_btree_autonomous_insert(off_len_tree, tmpTup);
+		if (!modify_result)
+		{
+			elog(FATAL, "unable to insert extent (%lu, %lu) into the (off, len) B-tree",
+				 tup.extent.offset, tup.extent.length);
+		}
+
+		tmpTup.data = (Pointer) &tup;
+		tmpTup.formatFlags = 0;
+		modify_result = o_btree_autonomous_insert(len_off_tree, tmpTup);
+		if (!modify_result)
+		{
+			elog(FATAL, "unable to insert extent (%lu, %lu) into the (len, off) B-tree",
+				 tup.extent.offset, tup.extent.length);
+		}
+	}
+
+	result.off = found_tup.extent.offset;
+	result.len = len;
+
+	enable_stopevents = old_enable_stopevents;
+	return result;
+}
+
 /*
  * Adds the extent to a free extents list.
  *
@@ -279,6 +667,14 @@ get_extent(BTreeDescr *desc, uint16 len)
  */
 void
 free_extent(BTreeDescr *desc, FileExtent extent)
+{
+	free_extent_identity(desc->type, desc->oids.datoid, desc->oids.relnode,
+						 extent);
+}
+
+static void
+free_extent_identity(OIndexType ixType, Oid datoid, Oid relnode,
+					 FileExtent extent)
 {
 	BTreeIterator *it = NULL;
 	FreeTreeTuple tup,
@@ -290,21 +686,35 @@ free_extent(BTreeDescr *desc, FileExtent extent)
 				merge_right,
 				merge_left,
 				inserted = false;
-	BTreeDescr *len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
-	BTreeDescr *off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
+	BTreeDescr *len_off_tree;
+	BTreeDescr *off_len_tree;
 	OTuple		tmpTup;
 
-	enable_stopevents = false;
-
 	Assert(FileExtentIsValid(extent));
 
+	/*
+	 * In the zoned device mode freed extents only invalidate bytes in their
+	 * zone, there is nothing to merge or keep in the trees.
+	 */
+	if (orioledb_device_zoned())
+	{
+		orioledb_device_zone_free((uint64) extent.off * ORIOLEDB_COMP_BLCKSZ,
+								  (uint64) extent.len * ORIOLEDB_COMP_BLCKSZ);
+		return;
+	}
+
+	len_off_tree = get_sys_tree(SYS_TREES_EXTENTS_LEN_OFF);
+	off_len_tree = get_sys_tree(SYS_TREES_EXTENTS_OFF_LEN);
+
+	enable_stopevents = false;
+
 	memset(&tup, 0, sizeof(FreeTreeTuple));
 	memset(&right, 0, sizeof(FreeTreeTuple));
 	memset(&left, 0, sizeof(FreeTreeTuple));
 
-	tup.ixType = desc->type;
-	tup.datoid = desc->oids.datoid;
-	tup.relnode = desc->oids.relnode;
+	tup.ixType = ixType;
+	tup.datoid = datoid;
+	tup.relnode = relnode;
 
 	while (!inserted)
 	{
@@ -595,8 +1005,10 @@ add_free_extents_from_tmp(BTreeDescr *desc, bool remove)
 			cur_off = (FileExtent *) buf;
 			for (i = 0; i < buf_len; i += sizeof(FileExtent))
 			{
-				pg_atomic_fetch_add_u64(&metaPage->numFreeBlocks,
-										(uint64) cur_off->len);
+				/* in the zoned mode blocks are not individually reusable */
+				if (!orioledb_device_zoned())
+					pg_atomic_fetch_add_u64(&metaPage->numFreeBlocks,
+											(uint64) cur_off->len);
 				free_extent(desc, *cur_off);
 				cur_off++;
 			}
@@ -16,6 +16,7 @@
 
 #include "btree/build.h"
 #include "btree/io.h"
+#include "btree/scan.h"
 #include "btree/undo.h"
 #include "checkpoint/checkpoint.h"
 #include "catalog/indices.h"
@@ -31,6 +32,7 @@
 #include "tuple/toast.h"
 
 #include "access/genam.h"
+#include "access/parallel.h"
 #include "access/relation.h"
 #include "access/table.h"
 #include "catalog/heap.h"
@@ -44,6 +46,7 @@
 #include "commands/tablecmds.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
 #include "parser/parse_utilcmd.h"
 #include "pgstat.h"
 #include "storage/predicate.h"
@@ -275,6 +278,8 @@ o_index_create(Relation rel,
 			   Node *utilityStmt)
 {
 	int			nattrs;
+	int			nincluded;
+	ListCell   *lc;
 	Oid			myrelid = RelationGetRelid(rel);
 	ORelOids	oids = {MyDatabaseId, myrelid, rel->rd_node.relNode};
 	Oid			relid;
@@ -290,6 +295,7 @@ o_index_create(Relation rel,
 	OTableDescr *old_descr = NULL;
 	List	   *index_expr_fields = NIL;
 	List	   *index_predicate = NIL;
+	List	   *index_elems = NIL;
 
 	/*
 	 * TODO: ? if (strcmp(stmt->accessMethod, "orioledb") != 0) elog(ERROR,
@@ -311,10 +317,31 @@ o_index_create(Relation rel,
 		elog(ERROR, "orioledb tables indices support "
 			 "only \"compress\" option.");
 
-	if (stmt->indexIncludingParams != NIL)
-		elog(ERROR, "include indexes are not supported");
+	if (stmt->primary && stmt->indexIncludingParams != NIL)
+		elog(ERROR, "include indexes are not supported for the primary key");
 
-	relid = RangeVarGetRelidExtended(stmt->relation, AccessExclusiveLock,
+	foreach(lc, stmt->indexIncludingParams)
+	{
+		IndexElem  *ielem = (IndexElem *) lfirst(lc);
+
+		if (ielem->expr != NULL)
+			elog(ERROR, "expressions are not supported in included columns");
+	}
+
+	/*
+	 * Creation of a secondary index doesn't touch the existing trees: the
+	 * build scans the primary index and writes the new relnode, which
+	 * becomes visible to other backends only with o_tables_update() at the
+	 * end.  So a full table lock isn't needed: ShareRowExclusiveLock blocks
+	 * concurrent modifications (the build scan must see the complete
+	 * committed state of the table) and other index builds (they would
+	 * overwrite each other's update of the serialized table definition),
+	 * but readers keep working.  Creation of a primary index rewrites the
+	 * whole table into new relnodes and still requires AccessExclusiveLock.
+	 */
+	relid = RangeVarGetRelidExtended(stmt->relation,
+									 stmt->primary ? AccessExclusiveLock :
+									 ShareRowExclusiveLock,
 									 0,
 									 RangeVarCallbackOwnsRelation,
 									 NULL);
@@ -336,6 +363,7 @@ o_index_create(Relation rel,
 
 	/* check index fields number */
 	nattrs = list_length(stmt->indexParams);
+	nincluded = list_length(stmt->indexIncludingParams);
 	if (ix_type == oIndexPrimary)
 	{
 		if (o_table->nindices > 0)
@@ -359,7 +387,7 @@ o_index_create(Relation rel,
 	{
 		if (o_table->nindices > 0
 			&& o_table->indices[0].type != oIndexRegular
-			&& nattrs + o_table->indices[0].nfields > INDEX_MAX_KEYS)
+			&& nattrs + nincluded + o_table->indices[0].nfields > INDEX_MAX_KEYS)
 		{
 			elog(ERROR, "too many fields in the index");
 		}
@@ -407,7 +435,8 @@ o_index_create(Relation rel,
 		   sizeof(OTableIndex));
 
 	o_table->indices[ix_num].type = ix_type;
-	o_table->indices[ix_num].nfields = list_length(stmt->indexParams);
+	o_table->indices[ix_num].nfields = nattrs + nincluded;
+	o_table->indices[ix_num].nkeyfields = nattrs;
 
 	if (OCompressIsValid(compress))
 		o_table->indices[ix_num].compress = compress;
@@ -425,9 +454,14 @@ o_index_create(Relation rel,
 	{
 		int			i;
 		int			nfields;
+		List	   *includeParams = stmt->indexIncludingParams;
 
-		/* Remove assert if INCLUDE supported */
-		Assert(!stmt->indexIncludingParams);
+		/*
+		 * Primary key fields go before user-defined INCLUDE columns, so that
+		 * the index relation attribute order matches the layout of our leaf
+		 * tuples: key fields, then primary key fields, then included fields.
+		 */
+		stmt->indexIncludingParams = NIL;
 
 		if (o_table->has_primary)
 		{
@@ -450,6 +484,8 @@ o_index_create(Relation rel,
 					lappend(stmt->indexIncludingParams, iparam);
 			}
 		}
+		stmt->indexIncludingParams = list_concat(stmt->indexIncludingParams,
+												 includeParams);
 	}
 
 	/* define index */
@@ -501,8 +537,20 @@ o_index_create(Relation rel,
 
 	index_expr_fields = RelationGetIndexExpressions(index_rel);
 	index_predicate = RelationGetIndexPredicate(index_rel);
-	/* fill index fields */
-	o_table_fill_index(o_table, ix_num, ix_type, stmt->indexParams,
+	/* fill index fields: key fields first, then included fields */
+	index_elems = list_copy(stmt->indexParams);
+	if (nincluded > 0)
+	{
+		int			skip = list_length(stmt->indexIncludingParams) - nincluded;
+
+		foreach(lc, stmt->indexIncludingParams)
+		{
+			if (skip-- > 0)
+				continue;
+			index_elems = lappend(index_elems, lfirst(lc));
+		}
+	}
+	o_table_fill_index(o_table, ix_num, ix_type, index_elems,
 					   index_expr_fields, index_predicate);
 
 	index_close(index_rel, AccessShareLock);
@@ -566,6 +614,246 @@ o_index_create(Relation rel,
 		LWLockRelease(&checkpoint_state->oTablesAddLock);
 }
 
+/*
+ * Parallel secondary index build.
+ *
+ * The key space of the primary index is handed out to the participants
+ * dynamically by the same ParallelOScanDescData machinery as the parallel
+ * sequential scan uses.  Each participant sorts the secondary tuples of its
+ * keyranges into a worker tuplesort backed by the shared Sharedsort state,
+ * then the leader merges the worker runs and feeds the ordinary sequential
+ * leaf writer.  The new table definition is not visible in the O_TABLES sys
+ * tree yet, so it is passed to the workers in serialized form.
+ */
+#define O_PARALLEL_KEY_BUILD_SHARED		UINT64CONST(0xB000000000000001)
+#define O_PARALLEL_KEY_TUPLESORT		UINT64CONST(0xB000000000000002)
+#define O_PARALLEL_KEY_O_TABLE			UINT64CONST(0xB000000000000003)
+
+typedef struct OIndexBuildShared
+{
+	ParallelOScanDescData poscan;
+	OIndexNumber ix_num;
+	int			sortmem;
+	Size		o_table_size;
+	slock_t		mutex;
+	double		heap_tuples;
+} OIndexBuildShared;
+
+typedef struct OIndexBuildLeader
+{
+	ParallelContext *pcxt;
+	OIndexBuildShared *ibshared;
+	Sharedsort *sharedsort;
+	bool		leaderparticipates;
+	int			nparticipanttuplesorts;
+} OIndexBuildLeader;
+
+/*
+ * Scan the claimed keyranges of the primary index and sort the corresponding
+ * secondary index tuples.  Returns the number of scanned tuples.
+ */
+static double
+o_index_build_participant(OTableDescr *descr, OIndexDescr *idx,
+						  ParallelOScanDesc poscan, Sharedsort *sharedsort,
+						  int sortmem)
+{
+	SortCoordinate coordinate;
+	Tuplesortstate *sortstate;
+	BTreeSeqScan *scan;
+	TupleTableSlot *primarySlot;
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	double		heap_tuples = 0;
+
+	coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	sortstate = tuplesort_begin_orioledb_index(idx, sortmem, false, coordinate);
+
+	scan = make_btree_seq_scan(&primary->desc, COMMITSEQNO_INPROGRESS, poscan);
+	primarySlot = MakeSingleTupleTableSlot(descr->tupdesc, &TTSOpsOrioleDB);
+
+	while (true)
+	{
+		OTuple		primaryTup;
+		OTuple		secondaryTup;
+		MemoryContext oldContext;
+		BTreeLocationHint hint;
+		CommitSeqNo tupleCsn;
+
+		primaryTup = btree_seq_scan_getnext(scan, primarySlot->tts_mcxt,
+											&tupleCsn, &hint);
+
+		if (O_TUPLE_IS_NULL(primaryTup))
+			break;
+
+		tts_orioledb_store_tuple(primarySlot, primaryTup, descr,
+								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
+								 true, &hint);
+
+		slot_getallattrs(primarySlot);
+
+		heap_tuples++;
+
+		oldContext = MemoryContextSwitchTo(sortstate->tuplecontext);
+		secondaryTup = tts_orioledb_make_secondary_tuple(primarySlot, idx, true);
+		MemoryContextSwitchTo(oldContext);
+
+		o_btree_check_size_of_tuple(o_tuple_size(secondaryTup, &idx->leafSpec), idx->name.data, true);
+		tuplesort_putotuple(sortstate, secondaryTup);
+
+		ExecClearTuple(primarySlot);
+	}
+	ExecDropSingleTupleTableSlot(primarySlot);
+	free_btree_seq_scan(scan);
+
+	tuplesort_performsort(sortstate);
+	tuplesort_end_orioledb_index(sortstate);
+	pfree(coordinate);
+
+	return heap_tuples;
+}
+
+void
+o_index_build_worker_main(dsm_segment *seg, shm_toc *toc)
+{
+	OIndexBuildShared *ibshared;
+	Sharedsort *sharedsort;
+	Pointer		o_table_serialized;
+	OTable	   *o_table;
+	OTableDescr tmpDescr;
+	OIndexDescr *idx;
+	double		heap_tuples;
+
+	orioledb_check_shmem();
+
+	ibshared = shm_toc_lookup(toc, O_PARALLEL_KEY_BUILD_SHARED, false);
+	sharedsort = shm_toc_lookup(toc, O_PARALLEL_KEY_TUPLESORT, false);
+	o_table_serialized = shm_toc_lookup(toc, O_PARALLEL_KEY_O_TABLE, false);
+
+	tuplesort_attach_shared(sharedsort, seg);
+
+	o_table = deserialize_o_table(o_table_serialized, ibshared->o_table_size);
+
+	o_fill_tmp_table_descr(&tmpDescr, o_table);
+	idx = tmpDescr.indices[o_table->has_primary ? ibshared->ix_num :
+						   ibshared->ix_num + 1];
+
+	o_btree_load_shmem(&GET_PRIMARY(&tmpDescr)->desc);
+
+	heap_tuples = o_index_build_participant(&tmpDescr, idx, &ibshared->poscan,
+											sharedsort, ibshared->sortmem);
+
+	SpinLockAcquire(&ibshared->mutex);
+	ibshared->heap_tuples += heap_tuples;
+	SpinLockRelease(&ibshared->mutex);
+
+	o_free_tmp_table_descr(&tmpDescr);
+	o_table_free(o_table);
+}
+
+/*
+ * Attempt to begin a parallel index build.  Returns NULL if no parallel
+ * workers could be used, the caller falls back to the serial build then.
+ */
+static OIndexBuildLeader *
+o_index_build_begin_parallel(OTable *o_table, OTableDescr *descr,
+							 OIndexDescr *idx, OIndexNumber ix_num)
+{
+	OIndexBuildLeader *leader;
+	ParallelContext *pcxt;
+	OIndexBuildShared *ibshared;
+	Sharedsort *sharedsort;
+	ParallelOScanDesc poscan;
+	Pointer		o_table_serialized,
+				shm_o_table;
+	int			o_table_size;
+	int			nworkers;
+	int			scantuplesortstates;
+	bool		leaderparticipates = parallel_leader_participation;
+
+	nworkers = plan_create_index_workers(o_table->oids.reloid,
+										 idx->oids.reloid);
+	if (nworkers <= 0)
+		return NULL;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("orioledb", "o_index_build_worker_main",
+								 nworkers);
+
+	scantuplesortstates = leaderparticipates ? nworkers + 1 : nworkers;
+
+	o_table_serialized = serialize_o_table(o_table, &o_table_size);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(OIndexBuildShared));
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   tuplesort_estimate_shared(scantuplesortstates));
+	shm_toc_estimate_chunk(&pcxt->estimator, o_table_size);
+	shm_toc_estimate_keys(&pcxt->estimator, 3);
+
+	InitializeParallelDSM(pcxt);
+
+	/* DSM segment might be unavailable, fall back to the serial build */
+	if (pcxt->seg == NULL)
+	{
+		pfree(o_table_serialized);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return NULL;
+	}
+
+	ibshared = (OIndexBuildShared *) shm_toc_allocate(pcxt->toc,
+													  sizeof(OIndexBuildShared));
+	memset(ibshared, 0, sizeof(OIndexBuildShared));
+	ibshared->ix_num = ix_num;
+	ibshared->sortmem = Max(work_mem / scantuplesortstates, 64);
+	ibshared->o_table_size = o_table_size;
+	SpinLockInit(&ibshared->mutex);
+
+	poscan = &ibshared->poscan;
+	poscan->phs_base.phs_relid = o_table->oids.reloid;
+	poscan->phs_base.phs_syncscan = false;
+	SpinLockInit(&poscan->mutex);
+	shm_toc_insert(pcxt->toc, O_PARALLEL_KEY_BUILD_SHARED, ibshared);
+
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc,
+												 tuplesort_estimate_shared(scantuplesortstates));
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates, pcxt->seg);
+	shm_toc_insert(pcxt->toc, O_PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	shm_o_table = (Pointer) shm_toc_allocate(pcxt->toc, o_table_size);
+	memcpy(shm_o_table, o_table_serialized, o_table_size);
+	shm_toc_insert(pcxt->toc, O_PARALLEL_KEY_O_TABLE, shm_o_table);
+	pfree(o_table_serialized);
+
+	LaunchParallelWorkers(pcxt);
+	if (pcxt->nworkers_launched == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return NULL;
+	}
+
+	leader = (OIndexBuildLeader *) palloc0(sizeof(OIndexBuildLeader));
+	leader->pcxt = pcxt;
+	leader->ibshared = ibshared;
+	leader->sharedsort = sharedsort;
+	leader->leaderparticipates = leaderparticipates;
+	leader->nparticipanttuplesorts = pcxt->nworkers_launched +
+		(leaderparticipates ? 1 : 0);
+
+	return leader;
+}
+
+static void
+o_index_build_end_parallel(OIndexBuildLeader *leader)
+{
+	DestroyParallelContext(leader->pcxt);
+	ExitParallelMode();
+	pfree(leader);
+}
+
 void
 build_secondary_index(OTable *o_table, OTableDescr *descr, OIndexNumber ix_num)
 {
@@ -576,6 +864,7 @@ build_secondary_index(OTable *o_table, OTableDescr *descr, OIndexNumber ix_num)
 	TupleTableSlot *primarySlot;
 	Relation	tableRelation,
 				indexRelation = NULL;
+	OIndexBuildLeader *parallel = NULL;
 	double		heap_tuples,
 				index_tuples;
 	uint64		ctid;
@@ -588,56 +877,86 @@ build_secondary_index(OTable *o_table, OTableDescr *descr, OIndexNumber ix_num)
 	o_btree_load_shmem(&primary->desc);
 
 	if (!is_recovery_in_progress())
+	{
 		indexRelation = index_open(idx->oids.reloid, AccessShareLock);
-	sortstate = tuplesort_begin_orioledb_index(idx, work_mem, false, NULL);
-	if (indexRelation)
-		index_close(indexRelation, AccessShareLock);
-
-	iter = o_btree_iterator_create(&primary->desc, NULL, BTreeKeyNone,
-								   COMMITSEQNO_INPROGRESS, ForwardScanDirection);
-
-	primarySlot = MakeSingleTupleTableSlot(descr->tupdesc, &TTSOpsOrioleDB);
+		parallel = o_index_build_begin_parallel(o_table, descr, idx, ix_num);
+	}
 
 	heap_tuples = 0;
 	ctid = 1;
-	while (true)
+	if (parallel)
 	{
-		OTuple		primaryTup;
-		OTuple		secondaryTup;
-		MemoryContext oldContext;
+		SortCoordinate coordinate;
+
+		if (parallel->leaderparticipates)
+			heap_tuples += o_index_build_participant(descr, idx,
+													 &parallel->ibshared->poscan,
+													 parallel->sharedsort,
+													 parallel->ibshared->sortmem);
+
+		WaitForParallelWorkersToFinish(parallel->pcxt);
+		heap_tuples += parallel->ibshared->heap_tuples;
+
+		/* Begin the leader tuplesort merging the participant runs */
+		coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+		coordinate->isWorker = false;
+		coordinate->nParticipants = parallel->nparticipanttuplesorts;
+		coordinate->sharedsort = parallel->sharedsort;
+		sortstate = tuplesort_begin_orioledb_index(idx, work_mem, false,
+												   coordinate);
+	}
+	else
+	{
+		sortstate = tuplesort_begin_orioledb_index(idx, work_mem, false, NULL);
 
-		primaryTup = o_btree_iterator_fetch(iter, NULL, NULL,
-											BTreeKeyNone, true, NULL);
+		iter = o_btree_iterator_create(&primary->desc, NULL, BTreeKeyNone,
+									   COMMITSEQNO_INPROGRESS, ForwardScanDirection);
 
-		if (O_TUPLE_IS_NULL(primaryTup))
-			break;
+		primarySlot = MakeSingleTupleTableSlot(descr->tupdesc, &TTSOpsOrioleDB);
 
-		tts_orioledb_store_tuple(primarySlot, primaryTup, descr,
-								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
-								 true, NULL);
+		while (true)
+		{
+			OTuple		primaryTup;
+			OTuple		secondaryTup;
+			MemoryContext oldContext;
 
-		slot_getallattrs(primarySlot);
+			primaryTup = o_btree_iterator_fetch(iter, NULL, NULL,
+												BTreeKeyNone, true, NULL);
 
-		heap_tuples++;
+			if (O_TUPLE_IS_NULL(primaryTup))
+				break;
 
-		oldContext = MemoryContextSwitchTo(sortstate->tuplecontext);
-		secondaryTup = tts_orioledb_make_secondary_tuple(primarySlot, idx, true);
-		MemoryContextSwitchTo(oldContext);
+			tts_orioledb_store_tuple(primarySlot, primaryTup, descr,
+									 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
+									 true, NULL);
 
-		o_btree_check_size_of_tuple(o_tuple_size(secondaryTup, &idx->leafSpec), idx->name.data, true);
-		tuplesort_putotuple(sortstate, secondaryTup);
+			slot_getallattrs(primarySlot);
 
-		ExecClearTuple(primarySlot);
+			heap_tuples++;
+
+			oldContext = MemoryContextSwitchTo(sortstate->tuplecontext);
+			secondaryTup = tts_orioledb_make_secondary_tuple(primarySlot, idx, true);
+			MemoryContextSwitchTo(oldContext);
+
+			o_btree_check_size_of_tuple(o_tuple_size(secondaryTup, &idx->leafSpec), idx->name.data, true);
+			tuplesort_putotuple(sortstate, secondaryTup);
+
+			ExecClearTuple(primarySlot);
+		}
+		ExecDropSingleTupleTableSlot(primarySlot);
+		pfree(iter);
 	}
 	index_tuples = heap_tuples;
-	ExecDropSingleTupleTableSlot(primarySlot);
-	pfree(iter);
+	if (indexRelation)
+		index_close(indexRelation, AccessShareLock);
 
 	tuplesort_performsort(sortstate);
 
 	btree_write_index_data(&idx->desc, idx->leafTupdesc, sortstate,
 						   ctid, &fileHeader);
 	tuplesort_end_orioledb_index(sortstate);
+	if (parallel)
+		o_index_build_end_parallel(parallel);
 
 	/*
 	 * We hold oTablesAddLock till o_tables_update().  So, checkpoint number
@@ -649,9 +968,16 @@ build_secondary_index(OTable *o_table, OTableDescr *descr, OIndexNumber ix_num)
 
 	if (!is_recovery_in_progress())
 	{
-		tableRelation = table_open(o_table->oids.reloid, AccessExclusiveLock);
+		/*
+		 * o_index_create() holds ShareRowExclusiveLock on the table, which
+		 * is enough here: concurrent modifications stay blocked while we
+		 * update the relation stats.  Asking for a stronger lock would be
+		 * an upgrade and could deadlock against other lockers.
+		 */
+		tableRelation = table_open(o_table->oids.reloid,
+								   ShareRowExclusiveLock);
 		indexRelation = index_open(o_table->indices[ix_num].oids.reloid,
-								   AccessExclusiveLock);
+								   ShareRowExclusiveLock);
 		index_update_stats(tableRelation,
 						   true,
 						   heap_tuples);
@@ -662,8 +988,8 @@ build_secondary_index(OTable *o_table, OTableDescr *descr, OIndexNumber ix_num)
 
 		/* Make the updated catalog row versions visible */
 		CommandCounterIncrement();
-		table_close(tableRelation, AccessExclusiveLock);
-		index_close(indexRelation, AccessExclusiveLock);
+		table_close(tableRelation, ShareRowExclusiveLock);
+		index_close(indexRelation, ShareRowExclusiveLock);
 	}
 }
 
@@ -846,13 +1172,43 @@ rebuild_indices(OTable *old_o_table, OTableDescr *old_descr,
 					int2vector *indkey;
 					int			attnum;
 					int			pkey_natts;
+					int			n_included;
 					Datum		values[Natts_pg_index] = {0};
 					bool		nulls[Natts_pg_index] = {0};
 					bool		replaces[Natts_pg_index] = {0};
 					HeapTuple	old_index_tuple;
 
+					n_included = table_index->nfields -
+						table_index->nkeyfields;
 					pkey_natts = idx_descr->nFields -
-						idx_descr->nPrimaryFields;
+						table_index->nkeyfields;
+
+					/*
+					 * Shift included columns up to make room for the primary
+					 * key columns, which go between the key columns and the
+					 * included columns.
+					 */
+					for (attnum = n_included - 1; attnum >= 0; attnum--)
+					{
+						HeapTuple	attr_tuple;
+						Form_pg_attribute attr_form;
+
+						attr_tuple =
+							SearchSysCacheCopy2(ATTNUM,
+												ObjectIdGetDatum(reloid),
+												Int16GetDatum(index_form->indnkeyatts + attnum + 1));
+
+						if (!HeapTupleIsValid(attr_tuple))
+							elog(ERROR, "could not find pg_attribute for "
+								 "relation %u", reloid);
+
+						attr_form = (Form_pg_attribute) GETSTRUCT(attr_tuple);
+						attr_form->attnum += pkey_natts;
+						CatalogTupleUpdate(pg_attribute, &attr_tuple->t_self,
+										   attr_tuple);
+						heap_freetuple(attr_tuple);
+					}
+
 					for (attnum = 0; attnum < pkey_natts; attnum++)
 					{
 						FormData_pg_attribute attribute;
@@ -860,7 +1216,7 @@ rebuild_indices(OTable *old_o_table, OTableDescr *old_descr,
 						FormData_pg_attribute *aattr[] = {&attribute};
 						TupleDesc	tupdesc;
 #endif
-						OIndexField *idx_field = &idx_descr->fields[idx_descr->nPrimaryFields + attnum];
+						OIndexField *idx_field = &idx_descr->fields[table_index->nkeyfields + attnum];
 						OTableField *table_field = &o_table->fields[idx_field->tableAttnum - 1];
 
 						attribute.attrelid = reloid;
@@ -868,7 +1224,7 @@ rebuild_indices(OTable *old_o_table, OTableDescr *old_descr,
 						attribute.atttypid = table_field->typid;
 						attribute.attstattarget = 0;
 						attribute.attlen = table_field->typlen;
-						attribute.attnum = idx_descr->nPrimaryFields + attnum + 1;
+						attribute.attnum = index_form->indnkeyatts + attnum + 1;
 						attribute.attndims = table_field->ndims;
 						attribute.atttypmod = table_field->typmod;
 						attribute.attbyval = table_field->byval;
@@ -899,16 +1255,20 @@ rebuild_indices(OTable *old_o_table, OTableDescr *old_descr,
 					index_form->indnatts += pkey_natts;
 
 					indkey = buildint2vector(NULL, index_form->indnatts);
-					for (i = 0; i < index_form->indnkeyatts; i++)
-						indkey->values[i] = index_form->indkey.values[i];
-					for (i = 0; i < pkey_natts; i++)
+					for (attnum = 0; attnum < index_form->indnkeyatts; attnum++)
+						indkey->values[attnum] = index_form->indkey.values[attnum];
+					for (attnum = 0; attnum < pkey_natts; attnum++)
 					{
-						int			j = index_form->indnkeyatts + i;
+						int			j = index_form->indnkeyatts + attnum;
 						OIndexField *idx_field =
-						&idx_descr->fields[idx_descr->nPrimaryFields + i];
+						&idx_descr->fields[table_index->nkeyfields + attnum];
 
 						indkey->values[j] = idx_field->tableAttnum;
 					}
+					/* included columns keep their positions after the pk */
+					for (attnum = 0; attnum < n_included; attnum++)
+						indkey->values[index_form->indnkeyatts + pkey_natts + attnum] =
+							index_form->indkey.values[index_form->indnkeyatts + attnum];
 
 					replaces[Anum_pg_index_indkey - 1] = true;
 					values[Anum_pg_index_indkey - 1] = PointerGetDatum(indkey);
@@ -923,9 +1283,12 @@ rebuild_indices(OTable *old_o_table, OTableDescr *old_descr,
 				{
 					int			attnum;
 					int			pkey_natts;
+					int			n_included;
 
+					n_included = table_index->nfields -
+						table_index->nkeyfields;
 					pkey_natts = index_form->indnatts -
-						index_form->indnkeyatts;
+						index_form->indnkeyatts - n_included;
 					for (attnum = 0; attnum < pkey_natts; attnum++)
 					{
 						HeapTuple	attr_tuple;
@@ -941,8 +1304,58 @@ rebuild_indices(OTable *old_o_table, OTableDescr *old_descr,
 
 						CatalogTupleDelete(pg_attribute, &attr_tuple->t_self);
 					}
-					class_form->relnatts = index_form->indnkeyatts;
-					index_form->indnatts = index_form->indnkeyatts;
+
+					/* move included columns down to follow the key columns */
+					for (attnum = 0; attnum < n_included; attnum++)
+					{
+						HeapTuple	attr_tuple;
+						Form_pg_attribute attr_form;
+
+						attr_tuple =
+							SearchSysCacheCopy2(ATTNUM,
+												ObjectIdGetDatum(reloid),
+												Int16GetDatum(index_form->indnkeyatts + pkey_natts + attnum + 1));
+
+						if (!HeapTupleIsValid(attr_tuple))
+							elog(ERROR, "could not find pg_attribute for "
+								 "relation %u", reloid);
+
+						attr_form = (Form_pg_attribute) GETSTRUCT(attr_tuple);
+						attr_form->attnum -= pkey_natts;
+						CatalogTupleUpdate(pg_attribute, &attr_tuple->t_self,
+										   attr_tuple);
+						heap_freetuple(attr_tuple);
+					}
+
+					if (n_included > 0)
+					{
+						int2vector *indkey;
+						Datum		values[Natts_pg_index] = {0};
+						bool		nulls[Natts_pg_index] = {0};
+						bool		replaces[Natts_pg_index] = {0};
+						HeapTuple	old_index_tuple;
+
+						indkey = buildint2vector(NULL,
+												 index_form->indnkeyatts + n_included);
+						for (attnum = 0; attnum < index_form->indnkeyatts; attnum++)
+							indkey->values[attnum] = index_form->indkey.values[attnum];
+						for (attnum = 0; attnum < n_included; attnum++)
+							indkey->values[index_form->indnkeyatts + attnum] =
+								index_form->indkey.values[index_form->indnkeyatts + pkey_natts + attnum];
+
+						replaces[Anum_pg_index_indkey - 1] = true;
+						values[Anum_pg_index_indkey - 1] = PointerGetDatum(indkey);
+
+						old_index_tuple = index_tuple;
+						index_tuple = heap_modify_tuple(old_index_tuple,
+														RelationGetDescr(pg_index), values,
+														nulls, replaces);
+						heap_freetuple(old_index_tuple);
+						index_form = (Form_pg_index) GETSTRUCT(index_tuple);
+					}
+
+					class_form->relnatts = index_form->indnkeyatts + n_included;
+					index_form->indnatts = index_form->indnkeyatts + n_included;
 				}
 
 				CatalogTupleUpdate(pg_class, &class_tuple->t_self,
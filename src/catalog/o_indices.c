@@ -272,6 +272,7 @@ add_index_fields(OIndex *index, OTable *table, OTableIndex *tableIndex, int *j,
 				 bool fillPrimary)
 {
 	int			i;
+	int			nfields;
 	int			expr_field = 0;
 
 	if (tableIndex)
@@ -301,7 +302,9 @@ add_index_fields(OIndex *index, OTable *table, OTableIndex *tableIndex, int *j,
 			}
 			MemoryContextSwitchTo(old_mcxt);
 		}
-		for (i = 0; i < tableIndex->nfields; i++)
+		/* included columns of a secondary index are added separately */
+		nfields = fillPrimary ? tableIndex->nfields : tableIndex->nkeyfields;
+		for (i = 0; i < nfields; i++)
 		{
 			int			attnum = tableIndex->fields[i].attnum;
 			int			k;
@@ -340,6 +343,7 @@ make_secondary_o_index(OTable *table, OTableIndex *tableIndex)
 {
 	OTableIndex *primary = NULL;
 	OIndex	   *result = (OIndex *) palloc0(sizeof(OIndex));
+	int			i;
 	int			j;
 
 	if (table->has_primary)
@@ -367,11 +371,27 @@ make_secondary_o_index(OTable *table, OTableIndex *tableIndex)
 
 	j = 0;
 	add_index_fields(result, table, tableIndex, &j, false);
-	Assert(j <= tableIndex->nfields);
+	Assert(j <= tableIndex->nkeyfields);
 	result->nKeyFields = j;
 	add_index_fields(result, table, primary, &j, true);
 	Assert(j <= result->nLeafFields);
-	result->nLeafFields = result->nNonLeafFields = j;
+	result->nNonLeafFields = j;
+
+	/*
+	 * Included columns are stored in the tail of leaf tuples, but don't
+	 * participate in non-leaf (key) tuples.  We still keep nonLeafFields[]
+	 * entries for them to preserve the attnum mapping.  We don't try to
+	 * deduplicate them against key fields: the index relation keeps the
+	 * duplicates too, and leaf tuples must match its attribute order.
+	 */
+	for (i = tableIndex->nkeyfields; i < tableIndex->nfields; i++)
+	{
+		result->leafFields[j] = table->fields[tableIndex->fields[i].attnum];
+		result->nonLeafFields[j] = tableIndex->fields[i];
+		j++;
+	}
+	result->nLeafFields = j;
+	result->nIncludedFields = result->nLeafFields - result->nNonLeafFields;
 
 	if (tableIndex->type == oIndexUnique)
 		result->nUniqueFields = result->nKeyFields;
@@ -530,7 +550,8 @@ serialize_o_index(OIndex *o_index, int *size)
 	appendBinaryStringInfo(&str, (Pointer) o_index->leafFields,
 						   o_index->nLeafFields * sizeof(o_index->leafFields[0]));
 	appendBinaryStringInfo(&str, (Pointer) o_index->nonLeafFields,
-						   o_index->nNonLeafFields * sizeof(o_index->nonLeafFields[0]));
+						   (o_index->nNonLeafFields + o_index->nIncludedFields) *
+						   sizeof(o_index->nonLeafFields[0]));
 	o_serialize_node((Node *) o_index->predicate, &str);
 	if (o_index->predicate)
 		o_serialize_string(o_index->predicate_str, &str);
@@ -565,7 +586,8 @@ deserialize_o_index(OIndexChunkKey *key, Pointer data, Size length)
 	memcpy(oIndex->leafFields, ptr, len);
 	ptr += len;
 
-	len = oIndex->nNonLeafFields * sizeof(OTableIndexField);
+	len = (oIndex->nNonLeafFields + oIndex->nIncludedFields) *
+		sizeof(OTableIndexField);
 	oIndex->nonLeafFields = (OTableIndexField *) palloc(len);
 	Assert((ptr - data) + len <= length);
 	memcpy(oIndex->nonLeafFields, ptr, len);
@@ -608,6 +630,7 @@ make_o_index(OTable *table, OIndexNumber ixNum)
 
 		index = make_secondary_o_index(table, tableIndex);
 	}
+	index->tablePersistence = table->persistence;
 	return index;
 }
 
@@ -623,6 +646,7 @@ fillFixedFormatSpec(TupleDesc tupdesc, OTupleFixedFormatSpec *spec,
 		natts = *primary_init_nfields;
 	else
 		natts = tupdesc->natts;
+	spec->offsets = palloc(sizeof(spec->offsets[0]) * natts);
 	for (i = 0; i < natts; i++)
 	{
 		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
@@ -631,6 +655,7 @@ fillFixedFormatSpec(TupleDesc tupdesc, OTupleFixedFormatSpec *spec,
 			break;
 
 		len = att_align_nominal(len, attr->attalign);
+		spec->offsets[i] = len;
 		len += attr->attlen;
 	}
 	spec->natts = i;
@@ -650,6 +675,7 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex)
 	memset(descr, 0, sizeof(*descr));
 	descr->oids = oIndex->indexOids;
 	descr->tableOids = oIndex->tableOids;
+	descr->tablePersistence = oIndex->tablePersistence;
 	descr->refcnt = 0;
 	descr->valid = true;
 	namestrcpy(&descr->name, oIndex->name.data);
@@ -695,8 +721,21 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex)
 	else if (oIndex->indexType == oIndexRegular ||
 			 oIndex->indexType == oIndexUnique)
 	{
-		Assert(oIndex->nNonLeafFields == oIndex->nLeafFields);
-		descr->nonLeafTupdesc = CreateTupleDescCopy(descr->leafTupdesc);
+		if (oIndex->nIncludedFields == 0)
+		{
+			Assert(oIndex->nNonLeafFields == oIndex->nLeafFields);
+			descr->nonLeafTupdesc = CreateTupleDescCopy(descr->leafTupdesc);
+		}
+		else
+		{
+			/* included columns are present in leaf tuples only */
+			Assert(oIndex->nNonLeafFields + oIndex->nIncludedFields ==
+				   oIndex->nLeafFields);
+			descr->nonLeafTupdesc = CreateTemplateTupleDesc(oIndex->nNonLeafFields);
+			for (i = 0; i < oIndex->nNonLeafFields; i++)
+				TupleDescCopyEntry(descr->nonLeafTupdesc, i + 1,
+								   descr->leafTupdesc, i + 1);
+		}
 	}
 	else if (oIndex->indexType == oIndexToast)
 	{
@@ -711,8 +750,9 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex)
 					 oIndex->indexType == oIndexPrimary);
 	descr->nUniqueFields = oIndex->nUniqueFields;
 	descr->nFields = oIndex->nNonLeafFields;
+	descr->nIncludedFields = oIndex->nIncludedFields;
 
-	for (i = 0; i < oIndex->nNonLeafFields; i++)
+	for (i = 0; i < oIndex->nNonLeafFields + oIndex->nIncludedFields; i++)
 	{
 		OIndexField *field = &descr->fields[i];
 		OTableIndexField *iField = &oIndex->nonLeafFields[i];
@@ -735,6 +775,19 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex)
 
 		field->tableAttnum = attnum;
 		maxTableAttnum = Max(maxTableAttnum, attnum);
+
+		if (i >= oIndex->nNonLeafFields)
+		{
+			/*
+			 * Included column: it needs only the table attnum mapping and
+			 * collation, there is nothing to sort or compare.
+			 */
+			field->collation = TupleDescAttr(descr->leafTupdesc, i)->attcollation;
+			if (OidIsValid(iField->collation))
+				field->collation = iField->collation;
+			continue;
+		}
+
 		field->collation = TupleDescAttr(descr->nonLeafTupdesc, i)->attcollation;
 		if (OidIsValid(iField->collation))
 			field->collation = iField->collation;
@@ -794,11 +847,13 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex)
 		   sizeof(descr->nPrimaryFields) * sizeof(descr->primaryFieldsAttnums[0]));
 	descr->compress = oIndex->compress;
 
+	old_mcxt = MemoryContextSwitchTo(mcxt);
 	fillFixedFormatSpec(descr->leafTupdesc, &descr->leafSpec,
 						(oIndex->indexType == oIndexPrimary),
 						primary_init_nfields);
 	fillFixedFormatSpec(descr->nonLeafTupdesc, &descr->nonLeafSpec,
 						false, NULL);
+	MemoryContextSwitchTo(old_mcxt);
 	if (primary_init_nfields)
 		pfree(primary_init_nfields);
 }
@@ -92,6 +92,9 @@ o_opclass_add_all(OTable *o_table)
 
 		for (cur_field = 0; cur_field < index->nfields; cur_field++)
 		{
+			/* included columns have no opclass */
+			if (!OidIsValid(index->fields[cur_field].opclass))
+				continue;
 			o_opclass_add_if_needed(o_table->oids.datoid,
 									index->fields[cur_field].opclass);
 		}
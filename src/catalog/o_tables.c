@@ -28,6 +28,7 @@
 #include "access/transam.h"
 #include "catalog/heap.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_am.h"
 #include "catalog/pg_language.h"
 #include "catalog/pg_proc.h"
@@ -40,6 +41,7 @@
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
 #include "pgstat.h"
+#include "storage/lwlock.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
@@ -94,8 +96,6 @@ static void o_tables_foreach_callback(ORelOids oids, void *arg);
 static void o_tables_drop_all_callback(ORelOids oids, void *arg);
 static void o_table_oids_array_callback(ORelOids oids, void *arg);
 static inline void o_tables_rel_fill_locktag(LOCKTAG *tag, ORelOids *oids, int lockmode, bool checkpoint);
-static Pointer serialize_o_table(OTable *o_table, int *size);
-static OTable *deserialize_o_table(Pointer data, Size length);
 
 List	   *o_func_list = NIL;
 
@@ -244,6 +244,241 @@ ToastAPI	oTablesToastAPI = {
 	.versionCallback = oTablesVersionCallback
 };
 
+/*
+ * Shared cache of serialized table definitions.
+ *
+ * Table descriptors are private to a backend, but they are all built from
+ * the serialized OTable images stored in the SYS_TREES_O_TABLES tree.
+ * Fetching an image takes a descent of that tree, so after an invalidation
+ * (or for a freshly started backend) every backend pays the catalog read
+ * again.  This cache keeps recently fetched images in shared memory: only
+ * the first backend descends the sys tree, the rest deserialize the image
+ * straight from the cache.  The cache is direct-mapped, a hash collision
+ * simply evicts the previous occupant.
+ *
+ * Coherence follows the invalidation protocol of the private descriptor
+ * hash.  Every writer of the o_tables tree clears the table's slot before
+ * the change becomes visible to anybody, and each backend clears it again
+ * while processing the corresponding invalidation message.
+ *
+ * Readers take no locks.  Like in-memory btree pages, a slot carries a
+ * change count which every modification makes odd for its duration and
+ * advances: a reader copies the slot out, rereads the count and retries if
+ * it moved, so the read path performs plain loads only.  The same count
+ * closes the store race: a reader remembers it before descending the sys
+ * tree and only stores the fetched image if it hasn't moved, so an image
+ * fetched before a concurrent change can never outlive the invalidation of
+ * that change.  Slot modifications are serialized by a single LWLock, which
+ * is fine for catalog write rates.
+ *
+ * Backends with an orioledb transaction in progress and recovery workers
+ * bypass the cache entirely: they could observe catalog rows that aren't
+ * committed yet, and those must not leak into other backends.
+ */
+#define O_TABLES_CACHE_SLOT_DATA_SIZE	(8 * 1024)
+
+typedef struct
+{
+	pg_atomic_uint32 state;		/* change count, odd while being modified */
+	ORelOids	oids;
+	uint32		version;
+	uint32		dataLength;		/* 0 for an empty slot */
+	char		data[O_TABLES_CACHE_SLOT_DATA_SIZE];
+} OTablesCacheSlot;
+
+typedef struct
+{
+	int			lockTrancheId;
+	LWLock		lock;
+	uint64		numSlots;
+	OTablesCacheSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} OTablesCacheShared;
+
+static OTablesCacheShared *oTablesCache = NULL;
+
+Size
+o_tables_cache_shmem_needs(void)
+{
+	if (table_cache_size < sizeof(OTablesCacheSlot))
+		return 0;
+
+	return CACHELINEALIGN(offsetof(OTablesCacheShared, slots)) +
+		mul_size(table_cache_size / sizeof(OTablesCacheSlot),
+				 sizeof(OTablesCacheSlot));
+}
+
+void
+o_tables_cache_shmem_init(Pointer ptr, bool found)
+{
+	if (table_cache_size < sizeof(OTablesCacheSlot))
+	{
+		oTablesCache = NULL;
+		return;
+	}
+
+	oTablesCache = (OTablesCacheShared *) ptr;
+
+	if (!found)
+	{
+		uint64		i;
+
+		oTablesCache->lockTrancheId = LWLockNewTrancheId();
+		LWLockInitialize(&oTablesCache->lock, oTablesCache->lockTrancheId);
+		oTablesCache->numSlots = table_cache_size / sizeof(OTablesCacheSlot);
+		for (i = 0; i < oTablesCache->numSlots; i++)
+		{
+			pg_atomic_init_u32(&oTablesCache->slots[i].state, 0);
+			oTablesCache->slots[i].dataLength = 0;
+		}
+	}
+	LWLockRegisterTranche(oTablesCache->lockTrancheId,
+						  "orioledb_tables_cache");
+}
+
+static OTablesCacheSlot *
+o_tables_cache_slot(ORelOids oids)
+{
+	uint64		x;
+
+	x = ((uint64) oids.datoid << 32) | oids.reloid;
+	x ^= (uint64) oids.relnode * UINT64CONST(0x9E3779B97F4A7C15);
+	x ^= x >> 33;
+	x *= UINT64CONST(0xFF51AFD7ED558CCD);
+	x ^= x >> 33;
+
+	return &oTablesCache->slots[x % oTablesCache->numSlots];
+}
+
+static bool
+o_tables_cache_usable(void)
+{
+	return oTablesCache != NULL &&
+		!OXidIsValid(get_current_oxid_if_any()) &&
+		!is_recovery_in_progress();
+}
+
+/*
+ * Returns the cached OTable, or NULL on a miss.  *slotState gets the slot
+ * change count to be passed to o_tables_cache_put() on a miss.
+ */
+static OTable *
+o_tables_cache_lookup(ORelOids oids, uint32 *slotState)
+{
+	OTablesCacheSlot *slot = o_tables_cache_slot(oids);
+	OTable	   *table;
+	Pointer		data;
+	uint32		dataLength;
+	uint32		version;
+	uint32		state;
+
+	while (true)
+	{
+		state = pg_atomic_read_u32(&slot->state);
+		*slotState = state;
+		if (state & 1)
+		{
+			/* a modification is in progress, treat as a miss */
+			return NULL;
+		}
+
+		pg_read_barrier();
+
+		dataLength = slot->dataLength;
+		if (dataLength == 0 || dataLength > O_TABLES_CACHE_SLOT_DATA_SIZE ||
+			!ORelOidsIsEqual(slot->oids, oids))
+		{
+			pg_read_barrier();
+			if (pg_atomic_read_u32(&slot->state) != state)
+				continue;
+			return NULL;
+		}
+		version = slot->version;
+		data = palloc(dataLength);
+		memcpy(data, slot->data, dataLength);
+
+		pg_read_barrier();
+
+		if (pg_atomic_read_u32(&slot->state) == state)
+			break;
+		pfree(data);
+	}
+
+	table = deserialize_o_table(data, dataLength);
+	table->version = version;
+	pfree(data);
+
+	return table;
+}
+
+static void
+o_tables_cache_put(ORelOids oids, uint32 version, Pointer data,
+				   Size dataLength, uint32 slotState)
+{
+	OTablesCacheSlot *slot = o_tables_cache_slot(oids);
+
+	if (dataLength > O_TABLES_CACHE_SLOT_DATA_SIZE)
+		return;
+
+	LWLockAcquire(&oTablesCache->lock, LW_EXCLUSIVE);
+	if (pg_atomic_read_u32(&slot->state) == slotState)
+	{
+		pg_atomic_write_u32(&slot->state, slotState + 1);
+		pg_write_barrier();
+
+		slot->oids = oids;
+		slot->version = version;
+		slot->dataLength = dataLength;
+		memcpy(slot->data, data, dataLength);
+
+		pg_write_barrier();
+		pg_atomic_write_u32(&slot->state, slotState + 2);
+	}
+	LWLockRelease(&oTablesCache->lock);
+}
+
+static void
+o_tables_cache_clear_slot(OTablesCacheSlot *slot)
+{
+	uint32		state = pg_atomic_read_u32(&slot->state);
+
+	pg_atomic_write_u32(&slot->state, state + 1);
+	pg_write_barrier();
+
+	slot->dataLength = 0;
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&slot->state, state + 2);
+}
+
+/*
+ * Drops the cached image of the given table.  Must be called by every
+ * modification of the o_tables tree before the new state becomes visible.
+ */
+void
+o_tables_cache_invalidate(ORelOids oids)
+{
+	if (oTablesCache == NULL)
+		return;
+
+	LWLockAcquire(&oTablesCache->lock, LW_EXCLUSIVE);
+	o_tables_cache_clear_slot(o_tables_cache_slot(oids));
+	LWLockRelease(&oTablesCache->lock);
+}
+
+void
+o_tables_cache_invalidate_all(void)
+{
+	uint64		i;
+
+	if (oTablesCache == NULL)
+		return;
+
+	LWLockAcquire(&oTablesCache->lock, LW_EXCLUSIVE);
+	for (i = 0; i < oTablesCache->numSlots; i++)
+		o_tables_cache_clear_slot(&oTablesCache->slots[i]);
+	LWLockRelease(&oTablesCache->lock);
+}
+
 void
 o_tables_foreach_oids(OTablesOidsCallback callback,
 					  CommitSeqNo csn,
@@ -676,12 +911,25 @@ o_table_fill_index(OTable *o_table, OIndexNumber ix_num,
 			ix_field->attnum = EXPR_ATTNUM;
 			ix_field->collation = exprField->collation;
 		}
-		ix_field->ordering = ielem->ordering;
-		ix_field->nullsOrdering = ielem->nulls_ordering;
-		ix_field->opclass = ResolveOpClass(ielem->opclass,
-										   field_typeid,
-										   "btree",
-										   BTREE_AM_OID);
+		if (ixfield_num < index->nkeyfields)
+		{
+			ix_field->ordering = ielem->ordering;
+			ix_field->nullsOrdering = ielem->nulls_ordering;
+			ix_field->opclass = ResolveOpClass(ielem->opclass,
+											   field_typeid,
+											   "btree",
+											   BTREE_AM_OID);
+		}
+		else
+		{
+			/*
+			 * Included columns are only stored, never compared, so they don't
+			 * need a btree opclass.
+			 */
+			ix_field->ordering = SORTBY_DEFAULT;
+			ix_field->nullsOrdering = SORTBY_NULLS_DEFAULT;
+			ix_field->opclass = InvalidOid;
+		}
 		ixfield_num++;
 	}
 }
@@ -735,6 +983,7 @@ o_table_tableam_create(ORelOids oids, ORelOids toastOids, TupleDesc tupdesc,
 	o_table->oids = oids;
 	o_table->toast_oids = toastOids;
 	o_table->has_missing = false;
+	o_table->persistence = RELPERSISTENCE_PERMANENT;
 	o_table->tid_btree_ops_oid = GetDefaultOpClass(TIDOID, BTREE_AM_OID);
 
 	if (OCompressIsValid(default_compress))
@@ -1059,6 +1308,7 @@ o_tables_drop_by_oids(ORelOids oids, OXid oxid, CommitSeqNo csn)
 	key.offset = 0;
 
 	systrees_modify_start();
+	o_tables_cache_invalidate(oids);
 	table = o_tables_get(oids);
 	o_tables_oids_indexes(table, NULL, oxid, csn);
 	result = generic_toast_delete(&oTablesToastAPI, (Pointer) &key, oxid,
@@ -1104,6 +1354,7 @@ o_tables_add(OTable *table, OXid oxid, CommitSeqNo csn)
 	key.version = 0;
 
 	systrees_modify_start();
+	o_tables_cache_invalidate(table->oids);
 	o_tables_oids_indexes(NULL, table, oxid, csn);
 	result = generic_toast_insert(&oTablesToastAPI, (Pointer) &key, data, len,
 								  oxid, csn, get_sys_tree(SYS_TREES_O_TABLES));
@@ -1124,6 +1375,16 @@ o_tables_get_by_oids_and_version(ORelOids oids, uint32 *version)
 	Pointer		result;
 	Size		dataLength;
 	OTable	   *oTable;
+	bool		useCache;
+	uint32		slotState = 0;
+
+	useCache = (version == NULL && o_tables_cache_usable());
+	if (useCache)
+	{
+		oTable = o_tables_cache_lookup(oids, &slotState);
+		if (oTable != NULL)
+			return oTable;
+	}
 
 	key.oids = oids;
 	key.offset = 0;
@@ -1142,6 +1403,10 @@ o_tables_get_by_oids_and_version(ORelOids oids, uint32 *version)
 	if (result == NULL)
 		return NULL;
 
+	if (useCache)
+		o_tables_cache_put(oids, found_key->version, result, dataLength,
+						   slotState);
+
 	oTable = deserialize_o_table(result, dataLength);
 	oTable->version = found_key->version;
 	pfree(result);
@@ -1219,6 +1484,7 @@ o_tables_update_without_wal(OTable *table, OXid oxid, CommitSeqNo csn)
 	key.version = table->version + 1;
 
 	systrees_modify_start();
+	o_tables_cache_invalidate(table->oids);
 	old_table = o_tables_get(table->oids);
 	o_tables_oids_indexes(old_table, table, oxid, csn);
 	result = generic_toast_update(&oTablesToastAPI, (Pointer) &key, data, len,
@@ -1651,7 +1917,7 @@ serialize_o_table_index(OTableIndex *o_table_index, StringInfo str)
 	o_serialize_func_list(o_table_index->func_list, str);
 }
 
-static Pointer
+Pointer
 serialize_o_table(OTable *o_table, int *size)
 {
 	StringInfoData str;
@@ -570,10 +570,13 @@ sys_tree_init(int i, bool init_shmem)
 	ops->hash = sys_tree_hash;
 
 	descr->compress = InvalidOCompress;
+	descr->compressDict = NULL;
 	descr->ppool = pool;
 	descr->undoType = meta->undoReserveType;
 	descr->storageType = meta->storageType;
 	descr->createOxid = InvalidOXid;
+	descr->rightmostHint.blkno = OInvalidInMemoryBlkno;
+	descr->rightmostHint.pageChangeCount = InvalidOPageChangeCount;
 
 	if (descr->storageType == BTreeStoragePersistence)
 	{
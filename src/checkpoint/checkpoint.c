@@ -40,14 +40,19 @@
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
 
+#include "catalog/pg_type_d.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "portability/instr_time.h"
 #include "postmaster/bgwriter.h"
 #include "storage/bufmgr.h"
 #include "storage/proc.h"
+#include "utils/builtins.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timestamp.h"
 
 #define CONTROL_FILENAME ORIOLEDB_DATA_DIR"/control"
 
@@ -116,6 +121,18 @@ typedef struct
 	int			flags;
 } CheckpointTablesArg;
 
+/*
+ * A tree collected for the table checkpointing schedule, see
+ * checkpoint_tables_collect_callback().
+ */
+typedef struct
+{
+	OIndexType	type;
+	ORelOids	treeOids;
+	ORelOids	tableOids;
+	uint32		dirtyPagesCount;
+} CheckpointTreeEntry;
+
 typedef struct
 {
 	FileExtent *extents;
@@ -182,8 +199,12 @@ static void prepare_leaf_page(BTreeDescr *descr, CheckpointState *state);
 static void checkpoint_lock_page(BTreeDescr *descr, CheckpointState *state,
 								 OInMemoryBlkno *blkno, uint32 page_chage_count,
 								 int level);
-static void checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
-									   ORelOids tableOids, void *arg);
+static void checkpoint_tables_collect_callback(OIndexType type, ORelOids treeOids,
+											   ORelOids tableOids, void *arg);
+static int	checkpoint_tree_entry_cmp(const ListCell *a, const ListCell *b);
+static void checkpoint_tables_tree(OIndexType type, ORelOids treeOids,
+								   ORelOids tableOids,
+								   CheckpointTablesArg *tbl_arg);
 static inline bool init_seq_buf_pages(BTreeDescr *desc, SeqBufDescShared *shared);
 static inline void free_seq_buf_pages(BTreeDescr *desc, SeqBufDescShared *shared);
 static FileExtentsArray *file_extents_array_init(void);
@@ -328,6 +349,8 @@ checkpoint_shmem_init(Pointer ptr, bool found)
 		checkpoint_state->controlToastConsistentPtr = control.toastConsistentPtr;
 		checkpoint_state->controlReplayStartPtr = control.replayStartPtr;
 		pg_atomic_write_u64(&checkpoint_state->mmapDataLength, control.mmapDataLength);
+		if (orioledb_device_zoned())
+			orioledb_device_zones_restore();
 
 		pg_atomic_write_u64(&undo_meta->lastUsedLocation, control.lastUndoLocation);
 		pg_atomic_write_u64(&undo_meta->advanceReservedLocation, control.lastUndoLocation);
@@ -368,6 +391,117 @@ checkpoint_shmem_init(Pointer ptr, bool found)
 						  "orioledb_meta");
 }
 
+/*
+ * Adaptive pacing of checkpoint writes.
+ *
+ * The effective completion ratio starts at
+ * orioledb.checkpoint_completion_ratio and drifts between the bounds below:
+ * towards the maximum when checkpoint writeback calls get slow (the device is
+ * busy with foreground IO, spread the checkpoint out), towards the minimum
+ * when the device is idle or WAL and undo are generated faster than the
+ * configured budget (the sooner the checkpoint completes, the sooner the next
+ * one can recycle them).
+ */
+#define PACING_RATIO_MIN			(0.1)
+#define PACING_RATIO_MAX			(0.9)
+#define PACING_ADJUST_INTERVAL_USECS	1000000
+/* average per-call writeback latency above which the device is busy */
+#define PACING_BUSY_WRITEBACK_USECS	2000
+
+typedef struct
+{
+	instr_time	intervalStart;
+	XLogRecPtr	walLocation;
+	UndoLocation undoLocation;
+	uint64		writebackUsecs;
+	uint32		writebackCalls;
+	double		ratio;
+} CheckpointPacing;
+
+static CheckpointPacing pacing;
+
+static void
+checkpoint_pacing_reset(void)
+{
+	INSTR_TIME_SET_CURRENT(pacing.intervalStart);
+	pacing.walLocation = GetXLogInsertRecPtr();
+	pacing.undoLocation = pg_atomic_read_u64(&undo_meta->lastUsedLocation);
+	pacing.writebackUsecs = 0;
+	pacing.writebackCalls = 0;
+	pacing.ratio = o_checkpoint_completion_ratio;
+}
+
+/*
+ * Returns the effective completion ratio, re-evaluating the feedback once
+ * per PACING_ADJUST_INTERVAL_USECS.
+ */
+static double
+checkpoint_pacing_ratio(void)
+{
+	instr_time	interval;
+	uint64		intervalUsecs;
+
+	if (!o_checkpoint_adaptive_pacing)
+		return o_checkpoint_completion_ratio;
+
+	INSTR_TIME_SET_CURRENT(interval);
+	INSTR_TIME_SUBTRACT(interval, pacing.intervalStart);
+	intervalUsecs = INSTR_TIME_GET_MICROSEC(interval);
+	if (intervalUsecs >= PACING_ADJUST_INTERVAL_USECS)
+	{
+		XLogRecPtr	walLocation = GetXLogInsertRecPtr();
+		UndoLocation undoLocation = pg_atomic_read_u64(&undo_meta->lastUsedLocation);
+		uint64		logBytes,
+					logBudget;
+		bool		deviceBusy;
+
+		/* WAL and undo bytes generated during the interval */
+		logBytes = (walLocation - pacing.walLocation) +
+			(undoLocation - pacing.undoLocation);
+
+		/* the byte rate max_wal_size and checkpoint_timeout budget for */
+		logBudget = ((uint64) max_wal_size_mb * 1024 * 1024 /
+					 CheckPointTimeout) * intervalUsecs / 1000000;
+
+		deviceBusy = pacing.writebackCalls > 0 &&
+			pacing.writebackUsecs / pacing.writebackCalls >
+			PACING_BUSY_WRITEBACK_USECS;
+
+		if (deviceBusy && logBytes <= logBudget)
+			pacing.ratio *= 1.25;
+		else
+			pacing.ratio *= 0.8;
+		pacing.ratio = Max(PACING_RATIO_MIN,
+						   Min(PACING_RATIO_MAX, pacing.ratio));
+
+		INSTR_TIME_SET_CURRENT(pacing.intervalStart);
+		pacing.walLocation = walLocation;
+		pacing.undoLocation = undoLocation;
+		pacing.writebackUsecs = 0;
+		pacing.writebackCalls = 0;
+	}
+
+	return pacing.ratio;
+}
+
+/*
+ * btree_smgr_writeback() wrapper, which feeds the call latency back to the
+ * checkpoint pacing.
+ */
+static void
+checkpoint_writeback_timed(BTreeDescr *desc, off_t offset, off_t amount)
+{
+	instr_time	start,
+				duration;
+
+	INSTR_TIME_SET_CURRENT(start);
+	btree_smgr_writeback(desc, offset, amount);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	pacing.writebackUsecs += INSTR_TIME_GET_MICROSEC(duration);
+	pacing.writebackCalls++;
+}
+
 static void
 init_writeback(CheckpointWriteBack *writeback, int flags, bool isCompressed)
 {
@@ -422,15 +556,25 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 			continue;
 		}
 
-		if (writeback->extents[i].off == offset + len && len < 1024)
+		if (writeback->extents[i].off >= offset + len &&
+			writeback->extents[i].off <= offset + len + WRITEBACK_MERGE_GAP &&
+			len < 1024)
 		{
-			len += writeback->extents[i].len;
+			/*
+			 * Merge near-adjacent extents too: flushing a small clean gap is
+			 * cheaper than an extra syscall.
+			 */
+			len = (writeback->extents[i].off - offset) +
+				writeback->extents[i].len;
 		}
 		else
 		{
 			if (len > 0)
-				btree_smgr_writeback(desc, (off_t) offset * (off_t) blcksz,
-									 (off_t) len * (off_t) blcksz);
+			{
+				checkpoint_writeback_timed(desc, (off_t) offset * (off_t) blcksz,
+										   (off_t) len * (off_t) blcksz);
+				checkpoint_state->bytesWritten += (uint64) len * blcksz;
+			}
 			offset = writeback->extents[i].off;
 			len = writeback->extents[i].len;
 		}
@@ -441,15 +585,18 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 				/ (double) checkpoint_state->dirtyPagesEstimate;
 			if (progress < 1.0)
 			{
-				progress *= o_checkpoint_completion_ratio;
+				progress *= checkpoint_pacing_ratio();
 				CheckpointWriteDelay(writeback->checkpointFlags, progress);
 			}
 		}
 	}
 
 	if (len > 0)
-		btree_smgr_writeback(desc, (off_t) offset * (off_t) blcksz,
-							 (off_t) len * (off_t) blcksz);
+	{
+		checkpoint_writeback_timed(desc, (off_t) offset * (off_t) blcksz,
+								   (off_t) len * (off_t) blcksz);
+		checkpoint_state->bytesWritten += (uint64) len * blcksz;
+	}
 	checkpoint_state->pagesWritten += writeback->extentsNumber;
 	writeback->extentsNumber = 0;
 }
@@ -816,6 +963,8 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 {
 	CheckpointTablesArg chkp_tbl_arg;
 	CheckpointControl control;
+	List	   *chkp_trees = NIL;
+	ListCell   *lc;
 	int			old_enable_stopevents;
 	uint32		cur_chkp_num = checkpoint_state->lastCheckpointNumber + 1,
 				prev_chkp_num = checkpoint_state->lastCheckpointNumber;
@@ -837,6 +986,12 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 
 	memset(&control, 0, sizeof(control));
 
+	/*
+	 * Return our own extent reservations to the shared trees, so they get
+	 * into the free lists written by this checkpoint.
+	 */
+	release_reserved_extents();
+
 	chkp_tbl_arg.cleanupMap = NULL;
 	chkp_tbl_arg.freeExtents = NULL;
 	chkp_tbl_arg.flags = flags;
@@ -845,7 +1000,12 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	checkpoint_state->dirtyPagesEstimate *= (1.0 + CheckPointCompletionTarget
 											 * o_checkpoint_completion_ratio);
 	checkpoint_state->pagesWritten = 0;
+	checkpoint_state->bytesWritten = 0;
+	checkpoint_state->treesTotal = 0;
+	checkpoint_state->treesCompleted = 0;
+	checkpoint_state->startTimestamp = GetCurrentTimestamp();
 	checkpoint_state->toastConsistentPtr = InvalidXLogRecPtr;
+	checkpoint_pacing_reset();
 
 	if (chkp_mem_context == NULL)
 	{
@@ -914,7 +1074,39 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	enable_stopevents = old_enable_stopevents;
 
 	LWLockAcquire(&checkpoint_state->oTablesAddLock, LW_EXCLUSIVE);
-	o_indices_foreach_oids(checkpoint_tables_callback, &chkp_tbl_arg);
+	o_indices_foreach_oids(checkpoint_tables_collect_callback, &chkp_trees);
+	LWLockRelease(&checkpoint_state->oTablesAddLock);
+
+	/*
+	 * Estimate per-tree dirty volume and checkpoint the least dirty trees
+	 * first.  Small hot trees then finish early and stop retaining undo
+	 * instead of waiting behind a giant cold table for the whole flush.
+	 */
+	foreach(lc, chkp_trees)
+	{
+		CheckpointTreeEntry *entry = (CheckpointTreeEntry *) lfirst(lc);
+		OIndexDescr *indexDescr;
+
+		indexDescr = o_fetch_index_descr(entry->treeOids, entry->type,
+										 false, NULL);
+		if (indexDescr != NULL && OMetaPageIsValid(&indexDescr->desc))
+			entry->dirtyPagesCount =
+				pg_atomic_read_u32(&BTREE_GET_META(&indexDescr->desc)->dirtyPagesCount);
+	}
+	list_sort(chkp_trees, checkpoint_tree_entry_cmp);
+
+	checkpoint_state->treesTotal = list_length(chkp_trees);
+	foreach(lc, chkp_trees)
+	{
+		CheckpointTreeEntry *entry = (CheckpointTreeEntry *) lfirst(lc);
+
+		checkpoint_tables_tree(entry->type, entry->treeOids, entry->tableOids,
+							   &chkp_tbl_arg);
+		checkpoint_state->treesCompleted++;
+	}
+	list_free_deep(chkp_trees);
+
+	LWLockAcquire(&checkpoint_state->oTablesAddLock, LW_EXCLUSIVE);
 
 	chkp_inc_changecount_before(checkpoint_state);
 	checkpoint_state->lastCheckpointNumber++;
@@ -981,6 +1173,9 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 
 	write_checkpoint_control(&control);
 
+	if (orioledb_device_zoned())
+		orioledb_device_zones_save();
+
 	/*
 	 * Now we can free extents for compressed indices
 	 */
@@ -1894,6 +2089,58 @@ backend_set_autonomous_level(CheckpointState *state, uint32 level)
 	}
 }
 
+/*
+ * Attempt to checkpoint a tree without traversing it.
+ *
+ * If the tree has no dirty in-memory pages and no in-flight writes, nothing
+ * has been modified since the previous checkpoint wrote the root: every
+ * eviction or non-evict write of a relocated page marks its parent dirty, and
+ * the root itself is only cleaned by the tree traversal.  Thus the on-disk
+ * image referenced by the root file extent is complete and exact, and the
+ * current *.map file contains no extra extents.  In this case the tree
+ * checkpoint boils down to reusing the root downlink of the previous
+ * checkpoint.
+ *
+ * To close the race against writers, which have already sampled the
+ * checkpoint number but didn't dirty or free anything yet, publish the
+ * checkpoint bound as finished first and only then check the counters.  The
+ * counter increment in btree_write_start() implies a full memory barrier
+ * before the checkpoint state is read in get_checkpoint_number(), so either
+ * the writer observes CurKeyFinished and operates with the next checkpoint
+ * number, or we observe a non-zero in-flight counter and fall back to the
+ * normal traversal.
+ */
+static bool
+checkpoint_skip_clean_tree(BTreeDescr *descr)
+{
+	BTreeMetaPage *meta_page = BTREE_GET_META(descr);
+	OrioleDBPageDesc *root_desc = O_GET_IN_MEMORY_PAGEDESC(descr->rootInfo.rootPageBlkno);
+
+	if (!FileExtentIsValid(root_desc->fileExtent))
+		return false;			/* the tree was never written out */
+
+	if (pg_atomic_read_u32(&meta_page->dirtyPagesCount) != 0)
+		return false;
+
+	chkp_inc_changecount_before(checkpoint_state);
+	checkpoint_state->curKeyType = CurKeyFinished;
+	chkp_inc_changecount_after(checkpoint_state);
+
+	pg_memory_barrier();
+
+	if (pg_atomic_read_u32(&meta_page->inProgressWritesCount) != 0 ||
+		pg_atomic_read_u32(&meta_page->dirtyPagesCount) != 0)
+	{
+		/* a concurrent write slipped in, traverse the tree normally */
+		chkp_inc_changecount_before(checkpoint_state);
+		checkpoint_state->curKeyType = CurKeyLeast;
+		chkp_inc_changecount_after(checkpoint_state);
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * Make checkpoint of an index.
  */
@@ -1972,20 +2219,29 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 						get_seq_buf_filename(&next_tmp_tag))));
 
 	/* Make checkpoint of the tree itself */
-	init_writeback(&writeback, flags, is_compressed);
-	root_downlink = checkpoint_btree(&descr, checkpoint_state, &writeback);
-	if (!DiskDownlinkIsValid(root_downlink))
+	if (checkpoint_skip_clean_tree(descr))
 	{
+		/* Nothing was dirtied, reuse the previous checkpoint image as-is */
+		root_downlink = MAKE_ON_DISK_DOWNLINK(O_GET_IN_MEMORY_PAGEDESC(descr->rootInfo.rootPageBlkno)->fileExtent);
+	}
+	else
+	{
+		init_writeback(&writeback, flags, is_compressed);
+		root_downlink = checkpoint_btree(&descr, checkpoint_state, &writeback);
+		if (!DiskDownlinkIsValid(root_downlink))
+		{
+			free_writeback(&writeback);
+			return false;
+		}
+		descr = perform_writeback_and_relock(descr, &writeback,
+											 checkpoint_state, NULL, 0);
 		free_writeback(&writeback);
-		return false;
+		if (!descr)
+			return false;
+
+		Assert(checkpoint_state->curKeyType == CurKeyGreatest);
 	}
-	descr = perform_writeback_and_relock(descr, &writeback,
-										 checkpoint_state, NULL, 0);
-	free_writeback(&writeback);
-	if (!descr)
-		return false;
 
-	Assert(checkpoint_state->curKeyType == CurKeyGreatest);
 	Assert(DiskDownlinkIsValid(root_downlink));
 
 	if (!use_device)
@@ -2020,6 +2276,7 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 	header.rootDownlink = root_downlink;
 	header.datafileLength = pg_atomic_read_u64(&meta_page->datafileLength);
 	header.leafPagesNum = pg_atomic_read_u32(&meta_page->leafPagesNum);
+	header.liveTuplesNum = pg_atomic_read_u64(&meta_page->liveTuplesNum);
 	header.ctid = pg_atomic_read_u64(&meta_page->ctid);
 
 	if (!is_compressed)
@@ -2316,7 +2573,7 @@ checkpointer_update_autonomous(BTreeDescr *desc, CheckpointState *state)
 			{
 				/* the offset will not be used in current checkpoint */
 				free_extent_for_checkpoint(desc, &page_desc->fileExtent, cur_chkp_num);
-				MARK_DIRTY(desc->ppool, state->stack[i].blkno);
+				MARK_DIRTY(desc, state->stack[i].blkno);
 			}
 		}
 	}
@@ -2741,7 +2998,7 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 
 	/* Prepare message start walk from the rootPageBlkno */
 	page = O_GET_IN_MEMORY_PAGE(blkno);
-	lock_page(blkno);
+	lock_page_shared(blkno);
 	level = PAGE_GET_LEVEL(page);
 	message.action = WalkDownwards;
 	message.content.downwards.blkno = blkno;
@@ -2759,7 +3016,7 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 	chkp_inc_changecount_after(state);
 
 	level++;
-	unlock_page(blkno);
+	unlock_page_shared(blkno);
 
 	while (true)
 	{
@@ -2853,7 +3110,7 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 					/* the offset will not be used in current checkpoint */
 					free_extent_for_checkpoint(descr, &page_desc->fileExtent,
 											   checkpoint_state->lastCheckpointNumber + 1);
-					MARK_DIRTY(descr->ppool, blkno);
+					MARK_DIRTY(descr, blkno);
 				}
 			}
 
@@ -2895,7 +3152,7 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 					 * we assume that concurrent eviction of the parent is
 					 * forbidden by get_checkpoint_number() in walk_page()
 					 */
-					CLEAN_DIRTY(descr->ppool, blkno);
+					CLEAN_DIRTY(descr, blkno);
 
 					/* prepare_leaf_page() unlocks page */
 					prepare_leaf_page(descr, state);
@@ -3045,7 +3302,7 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 			page = O_GET_IN_MEMORY_PAGE(blkno);
 
 			if (message.content.upwards.parentDirty)
-				MARK_DIRTY(descr->ppool, blkno);
+				MARK_DIRTY(descr, blkno);
 		}
 		else if (message.action == WalkContinue)
 		{
@@ -3978,7 +4235,7 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 			 * we assume that concurrent eviction of the parent is forbidden
 			 * by get_checkpoint_number() in walk_page()
 			 */
-			CLEAN_DIRTY(descr->ppool, blkno);
+			CLEAN_DIRTY(descr, blkno);
 		}
 
 		/* We've finished operation with the page, allow concurrent operations */
@@ -4075,18 +4332,52 @@ prepare_leaf_page(BTreeDescr *descr, CheckpointState *state)
 	unlock_page(blkno);
 }
 
+/*
+ * Collects the tree into the list for the table checkpointing schedule.
+ * The actual work is done in checkpoint_tables_tree() after the trees are
+ * ordered by their dirty volume.
+ */
+static void
+checkpoint_tables_collect_callback(OIndexType type, ORelOids treeOids,
+								   ORelOids tableOids, void *arg)
+{
+	List	  **trees = (List **) arg;
+	CheckpointTreeEntry *entry;
+	MemoryContext old_context;
+
+	old_context = MemoryContextSwitchTo(TopMemoryContext);
+	entry = (CheckpointTreeEntry *) palloc(sizeof(CheckpointTreeEntry));
+	entry->type = type;
+	entry->treeOids = treeOids;
+	entry->tableOids = tableOids;
+	entry->dirtyPagesCount = 0;
+	*trees = lappend(*trees, entry);
+	MemoryContextSwitchTo(old_context);
+}
+
+/*
+ * list_sort() comparator: ascending per-tree dirty page counts.
+ */
+static int
+checkpoint_tree_entry_cmp(const ListCell *a, const ListCell *b)
+{
+	const CheckpointTreeEntry *ea = (const CheckpointTreeEntry *) lfirst(a);
+	const CheckpointTreeEntry *eb = (const CheckpointTreeEntry *) lfirst(b);
+
+	if (ea->dirtyPagesCount != eb->dirtyPagesCount)
+		return ea->dirtyPagesCount < eb->dirtyPagesCount ? -1 : 1;
+	return 0;
+}
+
 static void
-checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
-						   ORelOids tableOids, void *arg)
+checkpoint_tables_tree(OIndexType type, ORelOids treeOids,
+					   ORelOids tableOids, CheckpointTablesArg *tbl_arg)
 {
-	CheckpointTablesArg *tbl_arg = (CheckpointTablesArg *) arg;
 	OIndexDescr *descr;
 	int			cur_chkp_index = (checkpoint_state->lastCheckpointNumber + 1) % 2;
 	MemoryContext prev_context;
 	Jsonb	   *params;
 
-	LWLockRelease(&checkpoint_state->oTablesAddLock);
-
 	prev_context = MemoryContextSwitchTo(chkp_mem_context);
 
 	if (STOPEVENTS_ENABLED())
@@ -4107,6 +4398,21 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 		Assert(!have_locked_pages());
 		Assert(!have_retained_undo_location());
 
+		if (td->storageType != BTreeStoragePersistence)
+		{
+			/*
+			 * Temporary trees are not checkpointed, only their tmp files
+			 * are maintained the same way as for the temporary system
+			 * trees.
+			 */
+			checkpoint_temporary_tree(tbl_arg->flags, td);
+			sort_checkpoint_tmp_file(td, cur_chkp_index);
+			o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
+			MemoryContextSwitchTo(prev_context);
+			MemoryContextResetOnly(chkp_mem_context);
+			return;
+		}
+
 		if (td->type >= oIndexUnique &&
 			XLogRecPtrIsInvalid(checkpoint_state->toastConsistentPtr))
 		{
@@ -4130,8 +4436,6 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 
 	MemoryContextSwitchTo(prev_context);
 	MemoryContextResetOnly(chkp_mem_context);
-
-	LWLockAcquire(&checkpoint_state->oTablesAddLock, LW_EXCLUSIVE);
 }
 
 char *
@@ -4219,21 +4523,111 @@ can_use_checkpoint_extents(BTreeDescr *desc, uint32 chkp_num)
 	return true;
 }
 
+/*
+ * Help an in-progress checkpoint by writing dirty leaf pages of the tree
+ * currently walked by the checkpointer.
+ *
+ * Background writers call this to fan leaf flushing of a single tree out to
+ * the whole pool of workers: pages written here become clean, so the
+ * checkpointer only harvests their downlinks instead of writing them itself.
+ * walk_page() picks the right checkpoint number for every page, so writing
+ * any dirty page of the tree is correct regardless of its position relative
+ * to the current checkpoint bound, and the resulting extents go through the
+ * same map/tmp file machinery as the checkpointer's own writes.
+ *
+ * Each worker processes its own subset of the page pool, so workers don't
+ * contend with each other.  Returns true if a checkpoint of some tree was in
+ * progress.
+ */
+bool
+checkpoint_flush_ahead_pass(int workerId, int workersCount,
+							volatile sig_atomic_t *shutdown_requested)
+{
+	OIndexType	treeType = oIndexInvalid;
+	Oid			datoid = InvalidOid,
+				relnode = InvalidOid;
+	CurKeyType	curKeyType = CurKeyFinished;
+	int			before_changecount,
+				after_changecount;
+	OPagePool  *pool;
+	OInMemoryBlkno blkno,
+				end;
+
+	/* Read the tree currently under checkpoint. */
+	do
+	{
+		chkp_save_changecount_before(checkpoint_state, before_changecount);
+		if ((before_changecount & 1) != 0)
+			continue;
+
+		treeType = checkpoint_state->treeType;
+		datoid = checkpoint_state->datoid;
+		relnode = checkpoint_state->relnode;
+		curKeyType = checkpoint_state->curKeyType;
+
+		chkp_save_changecount_after(checkpoint_state, after_changecount);
+		if (before_changecount == after_changecount)
+			break;
+	} while (true);
+
+	if (curKeyType == CurKeyFinished || !OidIsValid(datoid))
+		return false;
+
+	pool = get_ppool(OPagePoolMain);
+	end = pool->offset + pool->size;
+	for (blkno = pool->offset + workerId; blkno < end; blkno += workersCount)
+	{
+		OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+
+		if (*shutdown_requested)
+			break;
+
+		/*
+		 * Unlocked checks: walk_page() re-checks everything under the page
+		 * lock, so a race here only costs a skipped page or a wasted
+		 * attempt.
+		 */
+		if (!IS_DIRTY(blkno))
+			continue;
+		if (page_desc->type != treeType ||
+			page_desc->oids.datoid != datoid ||
+			page_desc->oids.relnode != relnode)
+			continue;
+		if (!O_PAGE_IS(O_GET_IN_MEMORY_PAGE(blkno), LEAF))
+			continue;
+
+		/* Stop once the checkpointer moves on to another tree. */
+		if (checkpoint_state->datoid != datoid ||
+			checkpoint_state->relnode != relnode ||
+			checkpoint_state->curKeyType == CurKeyFinished)
+			break;
+
+		(void) walk_page(blkno, false);
+	}
+
+	return true;
+}
+
 static inline bool
 init_seq_buf_pages(BTreeDescr *desc, SeqBufDescShared *shared)
 {
-	Assert(!OInMemoryBlknoIsValid(shared->pages[0]));
-	Assert(!OInMemoryBlknoIsValid(shared->pages[1]));
+	int			i;
 
-	shared->pages[0] = ppool_get_metapage(desc->ppool);
-	if (!OInMemoryBlknoIsValid(shared->pages[0]))
-		return false;
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
+		Assert(!OInMemoryBlknoIsValid(shared->pages[i]));
 
-	shared->pages[1] = ppool_get_metapage(desc->ppool);
-	if (!OInMemoryBlknoIsValid(shared->pages[1]))
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
 	{
-		ppool_free_page(desc->ppool, shared->pages[0], NULL);
-		return false;
+		shared->pages[i] = ppool_get_metapage(desc->ppool);
+		if (!OInMemoryBlknoIsValid(shared->pages[i]))
+		{
+			while (--i >= 0)
+			{
+				ppool_free_page(desc->ppool, shared->pages[i], NULL);
+				shared->pages[i] = OInvalidInMemoryBlkno;
+			}
+			return false;
+		}
 	}
 	return true;
 }
@@ -4241,8 +4635,10 @@ init_seq_buf_pages(BTreeDescr *desc, SeqBufDescShared *shared)
 static inline void
 free_seq_buf_pages(BTreeDescr *desc, SeqBufDescShared *shared)
 {
-	FREE_PAGE_IF_VALID(desc->ppool, shared->pages[0]);
-	FREE_PAGE_IF_VALID(desc->ppool, shared->pages[1]);
+	int			i;
+
+	for (i = 0; i < SEQ_BUF_PAGES; i++)
+		FREE_PAGE_IF_VALID(desc->ppool, shared->pages[i]);
 }
 
 static bool
@@ -4366,6 +4762,7 @@ evictable_tree_init_meta(BTreeDescr *desc, EvictedTreeData **evicted_data,
 		file_header.datafileLength = 0;
 		file_header.numFreeBlocks = 0;
 		file_header.leafPagesNum = 1;
+		file_header.liveTuplesNum = 0;
 		file_header.ctid = 0;
 	}
 	else
@@ -4394,6 +4791,7 @@ evictable_tree_init_meta(BTreeDescr *desc, EvictedTreeData **evicted_data,
 			file_header.datafileLength = 0;
 			file_header.numFreeBlocks = 0;
 			file_header.leafPagesNum = 1;
+			file_header.liveTuplesNum = 0;
 			file_header.ctid = 0;
 
 			prev_chkp_file = PathNameOpenFile(prev_chkp_fname, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
@@ -4454,6 +4852,7 @@ evictable_tree_init_meta(BTreeDescr *desc, EvictedTreeData **evicted_data,
 	pg_atomic_write_u64(&meta_page->numFreeBlocks, file_header.numFreeBlocks);
 	pg_atomic_write_u64(&meta_page->datafileLength, file_header.datafileLength);
 	pg_atomic_write_u32(&meta_page->leafPagesNum, file_header.leafPagesNum);
+	pg_atomic_write_u64(&meta_page->liveTuplesNum, file_header.liveTuplesNum);
 	pg_atomic_write_u64(&meta_page->ctid, file_header.ctid);
 
 	VALGRIND_CHECK_MEM_IS_DEFINED(meta_page, ORIOLEDB_BLCKSZ);
@@ -4479,7 +4878,7 @@ evictable_tree_init_meta(BTreeDescr *desc, EvictedTreeData **evicted_data,
 		}
 
 		put_page_image(desc->rootInfo.rootPageBlkno, buf);
-		CLEAN_DIRTY(desc->ppool, desc->rootInfo.rootPageBlkno);
+		CLEAN_DIRTY(desc, desc->rootInfo.rootPageBlkno);
 		Assert(root_desc->flags == 0);
 
 		unlock_page(desc->rootInfo.rootPageBlkno);
@@ -4754,3 +5153,125 @@ systrees_modify_end(void)
 	LWLockRelease(&checkpoint_state->oSysTreesLock);
 	add_systrees_lock_undo(true);
 }
+
+PG_FUNCTION_INFO_V1(orioledb_checkpoint_progress);
+
+/*
+ * Report the progress of the checkpoint in progress (or the totals of the
+ * last completed one): the tree being written, trees completed out of the
+ * total, pages and bytes written, and the average write bandwidth since the
+ * checkpoint started.  The current tree identity is read under the
+ * changecount protocol, the counters are read unlocked: a torn snapshot of
+ * monotonic progress counters is harmless.
+ */
+Datum
+orioledb_checkpoint_progress(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	AttrNumber	attnum;
+	uint32		checkpointNumber;
+	OIndexType	treeType;
+	Oid			datoid,
+				reloid,
+				relnode;
+	uint32		before_changecount,
+				after_changecount;
+	uint64		bytesWritten;
+	TimestampTz startTimestamp;
+	long		secs;
+	int			usecs;
+	double		elapsed;
+	Datum		values[11];
+	bool		nulls[11] = {false};
+
+	orioledb_check_shmem();
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(11);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "checkpoint_number", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "in_progress", BOOLOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "datoid", OIDOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "reloid", OIDOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "relnode", OIDOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "trees_total", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "trees_completed", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "pages_written", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "bytes_written", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "start_time", TIMESTAMPTZOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "write_bandwidth", FLOAT8OID, -1, 0);
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	while (true)
+	{
+		chkp_save_changecount_before(checkpoint_state, before_changecount);
+		if (before_changecount & 1)
+			continue;
+
+		checkpointNumber = checkpoint_state->lastCheckpointNumber;
+		treeType = checkpoint_state->treeType;
+		datoid = checkpoint_state->datoid;
+		reloid = checkpoint_state->reloid;
+		relnode = checkpoint_state->relnode;
+
+		chkp_save_changecount_after(checkpoint_state, after_changecount);
+		if (before_changecount == after_changecount)
+			break;
+	}
+
+	bytesWritten = checkpoint_state->bytesWritten;
+	startTimestamp = checkpoint_state->startTimestamp;
+
+	values[0] = Int64GetDatum((int64) checkpointNumber);
+	values[1] = BoolGetDatum(treeType != oIndexInvalid);
+	values[2] = ObjectIdGetDatum(datoid);
+	values[3] = ObjectIdGetDatum(reloid);
+	values[4] = ObjectIdGetDatum(relnode);
+	values[5] = Int64GetDatum((int64) checkpoint_state->treesTotal);
+	values[6] = Int64GetDatum((int64) checkpoint_state->treesCompleted);
+	values[7] = Int64GetDatum((int64) checkpoint_state->pagesWritten);
+	values[8] = Int64GetDatum((int64) bytesWritten);
+	if (startTimestamp == 0)
+	{
+		nulls[9] = true;
+		nulls[10] = true;
+	}
+	else
+	{
+		values[9] = TimestampTzGetDatum(startTimestamp);
+		TimestampDifference(startTimestamp, GetCurrentTimestamp(),
+							&secs, &usecs);
+		elapsed = (double) secs + (double) usecs / 1000000.0;
+		if (elapsed > 0.0)
+			values[10] = Float8GetDatum((double) bytesWritten / elapsed);
+		else
+			nulls[10] = true;
+	}
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	PG_RETURN_VOID();
+}
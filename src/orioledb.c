@@ -18,6 +18,10 @@
 #include "btree/find.h"
 #include "btree/io.h"
 #include "btree/scan.h"
+#include "btree/decompress_cache.h"
+#include "btree/hist_cache.h"
+#include "btree/unique_filter.h"
+#include "catalog/free_extents.h"
 #include "catalog/o_opclass.h"
 #include "catalog/o_tables.h"
 #include "catalog/o_type_cache.h"
@@ -32,10 +36,14 @@
 #include "tuple/toast.h"
 #include "utils/compress.h"
 #include "utils/memdebug.h"
+#include "utils/o_latency.h"
 #include "utils/page_pool.h"
+#include "utils/page_waits.h"
+#include "utils/prewarm.h"
 #include "utils/stopevent.h"
 #include "utils/ucm.h"
 #include "workers/bgwriter.h"
+#include "workers/rollback.h"
 
 #include "access/table.h"
 #include "catalog/pg_enum.h"
@@ -43,6 +51,7 @@
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "optimizer/plancat.h"
+#include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
@@ -52,6 +61,7 @@
 #include "storage/ipc.h"
 #include "storage/lwlock.h"
 #include "storage/proclist.h"
+#include "storage/s_lock.h"
 #include "utils/builtins.h"
 #include "utils/inval.h"
 #include "utils/rangetypes.h"
@@ -84,6 +94,11 @@ OrioleDBPageDesc *page_descs = NULL;
 int			main_buffers_guc;
 static int	undo_buffers_guc;
 static int	xid_buffers_guc;
+static int	unique_filter_buffers_guc;
+static int	decompress_cache_buffers_guc;
+static int	hist_cache_buffers_guc;
+static int	table_cache_buffers_guc;
+static int	tracepoint_buffers_guc;
 int			max_procs;
 Size		orioledb_buffers_size;
 Size		orioledb_buffers_count;
@@ -92,17 +107,38 @@ Size		undo_circular_buffer_size;
 uint32		undo_buffers_count;
 Size		xid_circular_buffer_size;
 uint32		xid_buffers_count;
+Size		unique_filter_size;
+Size		decompress_cache_size;
+Size		hist_cache_size;
+Size		table_cache_size;
+Size		tracepoint_buffers_size;
 bool		remove_old_checkpoint_files = true;
 bool		debug_disable_bgwriter = false;
 bool		use_mmap = false;
+bool		use_direct_io = false;
 bool		use_device = false;
 char	   *device_filename = NULL;
 Pointer		mmap_data = NULL;
 int			device_fd;
 int			device_length_guc = 0;
+int			device_zone_size_guc = 0;
 Size		device_length = 0;
 double		o_checkpoint_completion_ratio;
+bool		o_checkpoint_adaptive_pacing = true;
 int			bgwriter_num_workers = 1;
+bool		checkpoint_flush_ahead = true;
+double		merge_sparse_ratio = 0.7;
+int			bgwriter_merge_pages = 100;
+int			undo_trim_max_files = 16;
+double		free_pages_watermark;
+bool		tinylfu_admission = false;
+bool		recovery_prefetch = true;
+bool		wal_compression = false;
+int			undo_tuple_cache_size = 32;
+int			toast_cache_size = 1024;
+int			seq_scan_prefetch_depth = 8;
+int			oxid_batch_size = 1;
+int			group_commit_delay = 0;
 int			max_io_concurrency = 1;
 ODBProcData *oProcData;
 int			default_compress = InvalidOCompress;
@@ -135,6 +171,8 @@ static Size o_proc_shmem_needs(void);
 static void o_proc_shmem_init(Pointer ptr, bool found);
 static Size ppools_shmem_needs(void);
 static void ppools_shmem_init(Pointer ptr, bool found);
+static Size device_zones_shmem_needs(void);
+static void device_zones_shmem_init(Pointer ptr, bool found);
 
 typedef struct
 {
@@ -151,10 +189,21 @@ static ShmemItem shmemItems[] = {
 	{oxid_shmem_needs, oxid_init_shmem},
 	{sys_trees_shmem_needs, sys_trees_shmem_init},
 	{StopEventShmemSize, StopEventShmemInit},
+	{TracepointShmemSize, TracepointShmemInit},
+	{o_latency_shmem_needs, o_latency_shmem_init},
+	{page_waits_shmem_needs, page_waits_shmem_init},
 	{undo_shmem_needs, undo_shmem_init},
+	{unique_filter_shmem_needs, unique_filter_shmem_init},
+	{decompress_cache_shmem_needs, decompress_cache_shmem_init},
+	{hist_cache_shmem_needs, hist_cache_shmem_init},
+	{seq_scan_shmem_needs, seq_scan_shmem_init},
+	{o_tables_cache_shmem_needs, o_tables_cache_shmem_init},
+	/* before checkpoint: checkpoint_shmem_init() restores the zones state */
+	{device_zones_shmem_needs, device_zones_shmem_init},
 	{checkpoint_shmem_size, checkpoint_shmem_init},
 	{recovery_shmem_needs, recovery_shmem_init},
 	{o_proc_shmem_needs, o_proc_shmem_init},
+	{bgwriter_shmem_needs, bgwriter_shmem_init},
 	{ppools_shmem_needs, ppools_shmem_init}
 };
 
@@ -267,6 +316,82 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.decompress_cache_buffers",
+							"Size of the cache of decompressed page images of compressed trees.",
+							NULL,
+							&decompress_cache_buffers_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.hist_cache_buffers",
+							"Size of the cache of historical page images rebuilt for snapshot scans.",
+							NULL,
+							&hist_cache_buffers_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.unique_filter_buffers",
+							"Size of the bloom filter accelerating unique constraint checks.",
+							NULL,
+							&unique_filter_buffers_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.table_cache_buffers",
+							"Size of the shared cache of table definitions used to build table descriptors.",
+							NULL,
+							&table_cache_buffers_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.tracepoint_buffers",
+							"Size of each backend's binary tracepoint ring buffer.",
+							NULL,
+							&tracepoint_buffers_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.track_latencies",
+							 "Collect latency histograms of btree operations.",
+							 NULL,
+							 &track_latencies,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.enable_stopevents",
 							 "Enable stop events.",
 							 NULL,
@@ -371,6 +496,20 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	/*
+	 * See checkpoint_pacing_ratio() in src/checkpoint/checkpoint.c.
+	 */
+	DefineCustomBoolVariable("orioledb.checkpoint_adaptive_pacing",
+							 "Adapt checkpoint write pacing to device load and log rate.",
+							 NULL,
+							 &o_checkpoint_adaptive_pacing,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.bgwriter_num_workers",
 							"Number of background writers.",
 							NULL,
@@ -384,6 +523,208 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.parallel_rollback_workers",
+							"Number of background workers a large transaction rollback can use.",
+							"0 disables the parallel rollback.",
+							&parallel_rollback_workers,
+							0,
+							0,
+							MAX_BACKENDS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.checkpoint_flush_ahead",
+							 "Background writers flush the tree being checkpointed.",
+							 NULL,
+							 &checkpoint_flush_ahead,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	/*
+	 * Free to total space ratio beyond which a page is merged with a
+	 * sibling.
+	 */
+	DefineCustomRealVariable("orioledb.merge_sparse_ratio",
+							 "Free space ratio beyond which a leaf page is merged.",
+							 NULL,
+							 &merge_sparse_ratio,
+							 0.7,
+							 0.1,
+							 1.0,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.bgwriter_merge_pages",
+							"Maximum number of sparse leaf pages a background writer merges per cycle.",
+							NULL,
+							&bgwriter_merge_pages,
+							100,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.undo_trim_max_files",
+							"Maximum number of retained undo files unlinked per cleanup pass.",
+							"0 removes the limit.",
+							&undo_trim_max_files,
+							16,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	/*
+	 * See ppool_watermark_pages() in include/utils/page_pool.h.
+	 */
+	DefineCustomRealVariable("orioledb.free_pages_watermark",
+							 "Fraction of a page pool kept immediately allocatable by the background writers.",
+							 NULL,
+							 &free_pages_watermark,
+							 0.05,
+							 0.0,
+							 0.9,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	/*
+	 * PGC_POSTMASTER because the setting controls registration of the
+	 * prewarm background worker.
+	 */
+	DefineCustomIntVariable("orioledb.prewarm_interval",
+							"Interval between dumps of the hot page set; 0 disables prewarming.",
+							NULL,
+							&prewarm_interval,
+							0,
+							0,
+							86400,
+							PGC_POSTMASTER,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	/*
+	 * See ucm_admission_usage_count() in src/utils/ucm.c.  PGC_POSTMASTER
+	 * because the sketch is sized into the page pool shared memory.
+	 */
+	DefineCustomBoolVariable("orioledb.tinylfu_admission",
+							 "Enables frequency-based admission of pages loaded from disk.",
+							 NULL,
+							 &tinylfu_admission,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.recovery_prefetch",
+							 "Enables prefetch of the pages targeted by WAL records ahead of replay.",
+							 NULL,
+							 &recovery_prefetch,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.wal_compression",
+							 "Compresses whole WAL containers with zstd before logging them.",
+							 NULL,
+							 &wal_compression,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.undo_tuple_cache_size",
+							"Number of tuple versions from the undo log each backend caches.",
+							"0 disables the cache.  The cache is sized on its first use.",
+							&undo_tuple_cache_size,
+							32,
+							0,
+							1024,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.toast_cache_size",
+							"Amount of memory each backend uses to cache recently detoasted values.",
+							"0 disables the cache.",
+							&toast_cache_size,
+							1024,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.seq_scan_prefetch_depth",
+							"Number of on-disk pages to prefetch ahead during sequential scans.",
+							NULL,
+							&seq_scan_prefetch_depth,
+							8,
+							0,
+							1024,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.oxid_batch_size",
+							"Number of transaction identifiers a backend reserves at once.",
+							NULL,
+							&oxid_batch_size,
+							1,
+							1,
+							1024,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.group_commit_delay",
+							"Microseconds to wait for concurrent commits before WAL flush.",
+							NULL,
+							&group_commit_delay,
+							0,
+							0,
+							100000,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("orioledb.max_io_concurrency",
 							"Number of maximum concurrent IO operations.",
 							NULL,
@@ -397,6 +738,17 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomBoolVariable("orioledb.use_direct_io",
+							 "Bypass the OS page cache for the table data files.",
+							 NULL,
+							 &use_direct_io,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.use_mmap",
 							 "Store data in the mmap'ed file.",
 							 NULL,
@@ -432,6 +784,19 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.device_zone_size",
+							"Size of a device allocation zone.",
+							"0 disables the zoned allocation mode.",
+							&device_zone_size_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("orioledb.default_compress",
 							"Default compression level.",
 							NULL,
@@ -490,6 +855,16 @@ _PG_init(void)
 	xid_buffers_count = (uint32) xid_circular_buffer_size;
 	xid_circular_buffer_size *= ORIOLEDB_BLCKSZ / sizeof(pg_atomic_uint64);
 
+	unique_filter_size = (Size) unique_filter_buffers_guc * BLCKSZ;
+
+	decompress_cache_size = (Size) decompress_cache_buffers_guc * BLCKSZ;
+
+	hist_cache_size = (Size) hist_cache_buffers_guc * BLCKSZ;
+
+	table_cache_size = (Size) table_cache_buffers_guc * BLCKSZ;
+
+	tracepoint_buffers_size = (Size) tracepoint_buffers_guc * BLCKSZ;
+
 	recovery_queue_size_guc *= 1024;
 
 	page_descs_size = CACHELINEALIGN(mul_size(orioledb_buffers_count, sizeof(OrioleDBPageDesc)));
@@ -537,12 +912,28 @@ _PG_init(void)
 							 0);
 			if (!mmap_data)
 				elog(LOG, "can't map device file %s", device_filename);
+			else
+			{
+				/*
+				 * The engine drives its own readahead over the mapping (see
+				 * btree_smgr_prefetch()), so kernel readahead only pulls in
+				 * pages the access pattern doesn't ask for.
+				 */
+				(void) madvise(mmap_data, device_length, MADV_RANDOM);
+			}
 
 		}
 		if (device_fd >= 0)
 			use_device = true;
 		if (!mmap_data)
 			use_mmap = false;
+
+		if (use_device && device_zone_size_guc > 0 &&
+			device_length < (Size) device_zone_size_guc * BLCKSZ)
+		{
+			elog(LOG, "orioledb.device_zone_size is larger than the device, zoned mode is not used");
+			device_zone_size_guc = 0;
+		}
 	}
 	else
 	{
@@ -550,9 +941,27 @@ _PG_init(void)
 		use_device = false;
 	}
 
+	if (use_direct_io)
+	{
+		if (use_device)
+		{
+			elog(LOG, "direct IO is not used in the block device mode");
+			use_direct_io = false;
+		}
+		else if (PG_O_DIRECT == 0)
+		{
+			elog(LOG, "direct IO is not supported on this platform");
+			use_direct_io = false;
+		}
+	}
+
 	/* Register background writers */
 	for (i = 0; i < bgwriter_num_workers; i++)
-		register_bgwriter();
+		register_bgwriter(i);
+
+	/* Register the prewarm worker */
+	if (prewarm_interval > 0)
+		register_prewarm_worker();
 
 	/* Register custom deTOAST function */
 	register_o_detoast_func(o_detoast);
@@ -569,6 +978,7 @@ _PG_init(void)
 	set_rel_pathlist_hook = orioledb_set_rel_pathlist_hook;
 	set_plain_rel_pathlist_hook = orioledb_set_plain_rel_pathlist_hook;
 	RegisterXactCallback(undo_xact_callback, NULL);
+	RegisterXactCallback(free_extents_xact_callback, NULL);
 	RegisterSubXactCallback(undo_subxact_callback, NULL);
 	CacheRegisterUsercacheCallback(orioledb_usercache_hook, PointerGetDatum(NULL));
 	CacheRegisterSyscacheCallback(TYPEOID, orioledb_syscache_type_hook, PointerGetDatum(NULL));
@@ -645,6 +1055,7 @@ ppools_shmem_needs(void)
 
 	for (i = 0; i < OPagePoolTypesCount; i++)
 		size = add_size(size, page_pools_size[i]);
+	size = add_size(size, ORIOLEDB_BUFFERS_ALIGN);
 	size = add_size(size, orioledb_buffers_size);
 	size = add_size(size, page_descs_size);
 	return size;
@@ -661,6 +1072,13 @@ ppools_shmem_init(Pointer ptr, bool found)
 		page_pools_ptr[i] = ptr;
 		ptr += page_pools_size[i];
 	}
+
+	/*
+	 * Align the page pool to the huge page boundary.  The shared memory
+	 * segment is huge-page-aligned when PostgreSQL "huge_pages" are in use,
+	 * so this keeps pool pages from straddling huge page boundaries.
+	 */
+	ptr = (Pointer) TYPEALIGN(ORIOLEDB_BUFFERS_ALIGN, ptr);
 	o_shared_buffers = ptr;
 	ptr += orioledb_buffers_size;
 	page_descs = (OrioleDBPageDesc *) ptr;
@@ -714,6 +1132,8 @@ orioledb_memsize(void)
 static void
 orioledb_on_shmem_exit(int code, Datum arg)
 {
+	if (code == 0)
+		release_reserved_extents();
 	if (MyProc)
 		pg_atomic_write_u64(&oProcData[MyProc->pgprocno].xmin, InvalidOXid);
 }
@@ -782,9 +1202,22 @@ orioledb_shmem_startup(void)
 	if (!found)
 		elog(LOG, "%s started", ORIOLEDB_VERSION);
 
+	/*
+	 * The write path allocates strictly transiently into this context and
+	 * resets it after every top-level operation, never calling pfree().  A
+	 * generation context turns that pattern into plain pointer-bumping with
+	 * geometrically grown blocks; before PG 15 its reset releases all the
+	 * blocks back to malloc, so the freelist-keeping aset is cheaper there.
+	 */
+#if PG_VERSION_NUM >= 150000
+	btree_insert_context = GenerationContextCreate(TopMemoryContext,
+												   "orioledb B-tree insert context",
+												   ALLOCSET_DEFAULT_SIZES);
+#else
 	btree_insert_context = AllocSetContextCreate(TopMemoryContext,
 												 "orioledb B-tree insert context",
 												 ALLOCSET_DEFAULT_SIZES);
+#endif
 
 	btree_seqscan_context = AllocSetContextCreate(TopMemoryContext,
 												  "orioledb B-tree seqential scans context",
@@ -795,11 +1228,365 @@ orioledb_shmem_startup(void)
 								   false);
 }
 
+/*
+ * Zoned allocation mode for the device file.
+ *
+ * The device is carved into fixed-size zones and every allocation advances
+ * the write pointer of the current zone, so within a zone the device only
+ * ever sees sequential appends.  Since OrioleDB pages are copy-on-write,
+ * freed space is never rewritten in place: free_extent_identity() and the
+ * free blocks list only invalidate bytes in their zone, and a zone becomes
+ * reusable as a whole once everything ever written to it is invalidated.
+ * This matches the zone model of ZNS SSDs; issuing the actual zone reset
+ * commands is left to the device or an external tool, we only guarantee
+ * the sequential write pattern.
+ */
+typedef struct
+{
+	pg_atomic_uint64 writePointer;
+	pg_atomic_uint64 freedBytes;
+} DeviceZone;
+
+typedef struct
+{
+	pg_atomic_uint32 currentZone;
+	/* first zone that was never opened yet */
+	pg_atomic_uint32 zoneFrontier;
+	/* serializes the switch of the current zone */
+	pg_atomic_uint32 switchInProgress;
+} DeviceZonesMeta;
+
+typedef struct
+{
+	uint32		nZones;
+	uint32		currentZone;
+	uint32		zoneFrontier;
+} DeviceZonesFileHeader;
+
+#define DEVICE_ZONES_FILENAME ORIOLEDB_DATA_DIR"/zones"
+#define InvalidDeviceZone	UINT32_MAX
+
+static DeviceZonesMeta *deviceZonesMeta = NULL;
+static DeviceZone *deviceZones = NULL;
+
+static inline uint64
+device_zone_bytes(void)
+{
+	return (uint64) device_zone_size_guc * BLCKSZ;
+}
+
+static inline uint32
+device_zone_count(void)
+{
+	return ((uint64) device_length_guc * BLCKSZ) / device_zone_bytes();
+}
+
+bool
+orioledb_device_zoned(void)
+{
+	return use_device && device_zone_size_guc > 0;
+}
+
+static Size
+device_zones_shmem_needs(void)
+{
+	if (device_filename == NULL || device_zone_size_guc <= 0 ||
+		device_zone_count() == 0)
+		return 0;
+
+	return add_size(CACHELINEALIGN(sizeof(DeviceZonesMeta)),
+					mul_size(device_zone_count(), sizeof(DeviceZone)));
+}
+
+static void
+device_zones_shmem_init(Pointer ptr, bool found)
+{
+	if (device_zones_shmem_needs() == 0)
+		return;
+
+	deviceZonesMeta = (DeviceZonesMeta *) ptr;
+	deviceZones = (DeviceZone *) (ptr + CACHELINEALIGN(sizeof(DeviceZonesMeta)));
+
+	if (!found)
+	{
+		uint32		i,
+					nZones = device_zone_count();
+
+		pg_atomic_init_u32(&deviceZonesMeta->currentZone, 0);
+		pg_atomic_init_u32(&deviceZonesMeta->zoneFrontier, 1);
+		pg_atomic_init_u32(&deviceZonesMeta->switchInProgress, 0);
+		for (i = 0; i < nZones; i++)
+		{
+			pg_atomic_init_u64(&deviceZones[i].writePointer, 0);
+			pg_atomic_init_u64(&deviceZones[i].freedBytes, 0);
+		}
+	}
+}
+
+/*
+ * Open the next zone after fullZone ran out of space.  A single backend wins
+ * the switchInProgress flag and performs the switch, the others wait for the
+ * current zone to change.
+ */
+static void
+device_zone_switch(uint32 fullZone)
+{
+	uint32		expected = 0;
+	uint32		nZones = device_zone_count();
+
+	if (pg_atomic_compare_exchange_u32(&deviceZonesMeta->switchInProgress,
+									   &expected, 1))
+	{
+		/* recheck: somebody might have switched before we got the flag */
+		if (pg_atomic_read_u32(&deviceZonesMeta->currentZone) == fullZone)
+		{
+			uint32		frontier = pg_atomic_read_u32(&deviceZonesMeta->zoneFrontier),
+						next = InvalidDeviceZone;
+
+			if (frontier < nZones)
+			{
+				next = frontier;
+				pg_atomic_write_u32(&deviceZonesMeta->zoneFrontier, frontier + 1);
+			}
+			else
+			{
+				uint32		i;
+
+				/* no fresh zones left, reclaim a fully invalidated one */
+				for (i = 0; i < nZones; i++)
+				{
+					uint64		writePointer;
+
+					if (i == fullZone)
+						continue;
+
+					writePointer = pg_atomic_read_u64(&deviceZones[i].writePointer);
+					if (writePointer == 0 ||
+						pg_atomic_read_u64(&deviceZones[i].freedBytes) != writePointer)
+						continue;
+
+					/*
+					 * CAS guards against a straggler, which read this zone as
+					 * current long ago, appending concurrently.  A free of
+					 * such a late append can slip in before the counter
+					 * reset and get lost, which only delays the next reclaim
+					 * of the zone.
+					 */
+					if (!pg_atomic_compare_exchange_u64(&deviceZones[i].writePointer,
+														&writePointer, 0))
+						continue;
+					pg_atomic_write_u64(&deviceZones[i].freedBytes, 0);
+					next = i;
+					break;
+				}
+			}
+
+			if (next == InvalidDeviceZone)
+			{
+				pg_atomic_write_u32(&deviceZonesMeta->switchInProgress, 0);
+				elog(ERROR, "device file overflow");
+			}
+
+			pg_atomic_write_u32(&deviceZonesMeta->currentZone, next);
+		}
+		pg_atomic_write_u32(&deviceZonesMeta->switchInProgress, 0);
+	}
+	else
+	{
+		SpinDelayStatus status;
+
+		init_local_spin_delay(&status);
+		while (pg_atomic_read_u32(&deviceZonesMeta->currentZone) == fullZone &&
+			   pg_atomic_read_u32(&deviceZonesMeta->switchInProgress) != 0)
+			perform_spin_delay(&status);
+		finish_spin_delay(&status);
+	}
+}
+
+static uint64
+device_zone_alloc(uint32 size)
+{
+	uint64		zoneBytes = device_zone_bytes();
+
+	while (true)
+	{
+		uint32		zone = pg_atomic_read_u32(&deviceZonesMeta->currentZone);
+		DeviceZone *deviceZone = &deviceZones[zone];
+		uint64		writePointer = pg_atomic_read_u64(&deviceZone->writePointer);
+
+		while (writePointer + size <= zoneBytes)
+		{
+			/* a failed CAS reloads writePointer */
+			if (pg_atomic_compare_exchange_u64(&deviceZone->writePointer,
+											   &writePointer,
+											   writePointer + size))
+				return (uint64) zone * zoneBytes + writePointer;
+		}
+
+		device_zone_switch(zone);
+	}
+}
+
+/*
+ * Account freed device bytes to their zones.  The space itself is not reused
+ * until the whole zone is invalidated, see device_zone_switch().
+ */
+void
+orioledb_device_zone_free(uint64 offset, uint64 size)
+{
+	uint64		zoneBytes = device_zone_bytes();
+
+	while (size > 0)
+	{
+		uint64		zone = offset / zoneBytes;
+		uint64		chunk = Min(size, (zone + 1) * zoneBytes - offset);
+
+		Assert(zone < device_zone_count());
+		pg_atomic_fetch_add_u64(&deviceZones[zone].freedBytes, chunk);
+		offset += chunk;
+		size -= chunk;
+	}
+}
+
+/*
+ * Persist the zones state together with the checkpoint control file.  Like
+ * mmapDataLength, the saved write pointers are consistent with the
+ * checkpointed data: space allocated after the checkpoint is re-allocated
+ * during recovery.
+ */
+void
+orioledb_device_zones_save(void)
+{
+	File		zonesFile;
+	uint32		i,
+				nZones = device_zone_count();
+	Size		len = sizeof(DeviceZonesFileHeader) +
+		(Size) nZones * 2 * sizeof(uint64) + sizeof(pg_crc32c);
+	Pointer		buf = palloc(len),
+				ptr = buf;
+	DeviceZonesFileHeader header;
+	pg_crc32c	crc;
+
+	header.nZones = nZones;
+	header.currentZone = pg_atomic_read_u32(&deviceZonesMeta->currentZone);
+	header.zoneFrontier = pg_atomic_read_u32(&deviceZonesMeta->zoneFrontier);
+	memcpy(ptr, &header, sizeof(header));
+	ptr += sizeof(header);
+
+	for (i = 0; i < nZones; i++)
+	{
+		uint64		value;
+
+		value = pg_atomic_read_u64(&deviceZones[i].writePointer);
+		memcpy(ptr, &value, sizeof(value));
+		ptr += sizeof(value);
+		value = pg_atomic_read_u64(&deviceZones[i].freedBytes);
+		memcpy(ptr, &value, sizeof(value));
+		ptr += sizeof(value);
+	}
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, buf, ptr - buf);
+	FIN_CRC32C(crc);
+	memcpy(ptr, &crc, sizeof(crc));
+
+	zonesFile = PathNameOpenFile(DEVICE_ZONES_FILENAME, O_RDWR | O_CREAT | PG_BINARY);
+	if (zonesFile < 0)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not open device zones file %s", DEVICE_ZONES_FILENAME)));
+
+	if (OFileWrite(zonesFile, buf, len, 0, WAIT_EVENT_SLRU_WRITE) != len ||
+		FileSync(zonesFile, WAIT_EVENT_SLRU_SYNC) != 0)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not write device zones to file %s", DEVICE_ZONES_FILENAME)));
+
+	FileClose(zonesFile);
+	pfree(buf);
+}
+
+/*
+ * Restore the zones state saved by the last checkpoint.  Called from
+ * checkpoint_shmem_init() next to the mmapDataLength restore.
+ */
+void
+orioledb_device_zones_restore(void)
+{
+	int			zonesFile;
+	uint32		i,
+				nZones = device_zone_count();
+	Size		len = sizeof(DeviceZonesFileHeader) +
+		(Size) nZones * 2 * sizeof(uint64) + sizeof(pg_crc32c);
+	Pointer		buf,
+				ptr;
+	DeviceZonesFileHeader header;
+	pg_crc32c	crc;
+
+	zonesFile = BasicOpenFile(DEVICE_ZONES_FILENAME, O_RDONLY | PG_BINARY);
+	if (zonesFile < 0)
+	{
+		/*
+		 * No zones state, but the device already contains data: it was
+		 * filled by the plain append allocation, the zones layout would
+		 * overwrite it.
+		 */
+		if (pg_atomic_read_u64(&checkpoint_state->mmapDataLength) > 0)
+			ereport(FATAL,
+					(errmsg("orioledb.device_zone_size is set, but the device was used without zones"),
+					 errhint("Reset orioledb.device_zone_size or recreate the device data.")));
+
+		return;					/* fresh device, all the zones start empty */
+	}
+
+	buf = palloc(len);
+	if (read(zonesFile, buf, len) != len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read data from device zones file %s", DEVICE_ZONES_FILENAME)));
+
+	close(zonesFile);
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, buf, len - sizeof(pg_crc32c));
+	FIN_CRC32C(crc);
+
+	if (memcmp(&crc, buf + len - sizeof(pg_crc32c), sizeof(crc)) != 0)
+		elog(ERROR, "Wrong CRC in device zones file");
+
+	memcpy(&header, buf, sizeof(header));
+	if (header.nZones != nZones)
+		ereport(FATAL,
+				(errmsg("device zones file does not match the current settings"),
+				 errdetail("The zones state was written for %u zones, but "
+						   "orioledb.device_length and orioledb.device_zone_size "
+						   "now give %u zones.",
+						   header.nZones, nZones)));
+
+	pg_atomic_write_u32(&deviceZonesMeta->currentZone, header.currentZone);
+	pg_atomic_write_u32(&deviceZonesMeta->zoneFrontier, header.zoneFrontier);
+
+	ptr = buf + sizeof(header);
+	for (i = 0; i < nZones; i++)
+	{
+		uint64		value;
+
+		memcpy(&value, ptr, sizeof(value));
+		ptr += sizeof(value);
+		pg_atomic_write_u64(&deviceZones[i].writePointer, value);
+		memcpy(&value, ptr, sizeof(value));
+		ptr += sizeof(value);
+		pg_atomic_write_u64(&deviceZones[i].freedBytes, value);
+	}
+	pfree(buf);
+}
+
 uint64
 orioledb_device_alloc(struct BTreeDescr *descr, uint32 size)
 {
 	uint64		result;
 
+	if (orioledb_device_zoned())
+		return device_zone_alloc(size);
+
 	result = pg_atomic_fetch_add_u64(&checkpoint_state->mmapDataLength, size);
 
 	if (result + size > device_length)
@@ -1280,6 +2067,7 @@ orioledb_error_cleanup_hook(void)
 	release_undo_size(UndoReserveTxn);
 	btree_mark_incomplete_splits();
 	unset_skip_ucm();
+	unset_ucm_scan_hint();
 	btree_io_error_cleanup();
 	seq_scans_cleanup();
 }
@@ -1296,8 +2084,6 @@ orioledb_get_relation_info_hook(PlannerInfo *rootPageBlkno,
 
 	if (is_orioledb_rel(relation))
 	{
-		/* Evade parallel scan of OrioleDB's tables */
-		rel->rel_parallel_workers = 0;
 		if (relation->rd_rel->relhasindex)
 		{
 			int			i;
@@ -16,6 +16,7 @@
 #include "orioledb.h"
 
 #include "btree/btree.h"
+#include "btree/find.h"
 #include "btree/io.h"
 #include "btree/modify.h"
 #include "btree/undo.h"
@@ -27,10 +28,14 @@
 #include "recovery/wal.h"
 #include "tableam/descr.h"
 #include "transam/undo.h"
+#include "utils/compress.h"
 #include "utils/stopevent.h"
 
 #include "access/hash.h"
 #include "access/xlog_internal.h"
+#include "catalog/pg_type_d.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
 #if PG_VERSION_NUM >= 150000
 #include "access/xlogrecovery.h"
 #endif
@@ -45,6 +50,26 @@
 #include "storage/shm_mq.h"
 #include "storage/standby.h"
 #include "utils/memutils.h"
+#include "utils/pg_lsn.h"
+
+/* Number of key hash slices used to route modify records to workers */
+#define RECOVERY_HASH_SLICES 1024
+/* Number of routed modify records between queue depth skew checks */
+#define RECOVERY_REBALANCE_INTERVAL 4096
+/* Minimal queue depth difference (in bytes) which triggers a migration */
+#define RECOVERY_REBALANCE_MIN_SKEW (2 * RECOVERY_QUEUE_BUF_SIZE)
+/*
+ * Tuples of this size and above are sent to the worker queue directly from
+ * the WAL container with shm_mq_sendv() instead of being copied into the
+ * queue buffer first.  For smaller tuples batching wins over the saved copy.
+ */
+#define RECOVERY_SENDV_TUPLE_THRESHOLD 256
+
+/*
+ * Cap for the per-transaction list of savepoints not yet delivered to the
+ * workers.  When it overflows, the list is broadcast the old way.
+ */
+#define RECOVERY_PENDING_SAVEPOINTS_MAX 16
 
 /*
  * Recovery transaction state.
@@ -79,6 +104,17 @@ typedef struct
 	bool		wal_xid;
 	/* usage map */
 	bool	   *used_by;
+
+	/*
+	 * Savepoints of the transaction not yet delivered to every worker.  They
+	 * are piggybacked onto the next message of the transaction per queue
+	 * instead of being broadcast immediately, see
+	 * worker_emit_pending_savepoints().
+	 */
+	SubTransactionId pendingSavepoints[RECOVERY_PENDING_SAVEPOINTS_MAX];
+	int			nPendingSavepoints;
+	/* per worker: how many of pendingSavepoints are already delivered */
+	int		   *sentSavepoints;
 } RecoveryXidState;
 
 typedef struct
@@ -96,6 +132,8 @@ typedef struct
 	shm_mq_handle *queue;
 	char		queue_buf[RECOVERY_QUEUE_BUF_SIZE];
 	int			queue_buf_len;
+	/* Total number of bytes flushed to the worker queue */
+	uint64		sent_bytes;
 	/* Current oids */
 	ORelOids	oids;
 	/* Current oxid */
@@ -107,6 +145,7 @@ typedef struct
 } RecoveryWorkerState;
 
 PG_FUNCTION_INFO_V1(orioledb_recovery_synchronized);
+PG_FUNCTION_INFO_V1(orioledb_recovery_progress);
 
 /*
  * Comparator for retain min-heap.
@@ -176,6 +215,19 @@ static dlist_head joint_commit_list;
 /* Pool of recovery workers and oxid hash for it */
 static RecoveryWorkerState *workers_pool;
 
+/*
+ * Routing of modify records to workers.  The key hash space is split into
+ * RECOVERY_HASH_SLICES slices, each owned by a single worker.  When queue
+ * depths get skewed, a hot slice is migrated from the busiest worker to the
+ * least loaded one, see consider_slice_migration().
+ */
+static int *slice_worker_map = NULL;
+static uint32 *slice_send_counts = NULL;
+static int	migration_slice = -1;
+static int	migration_target;
+static uint64 migration_barrier;
+static uint32 rebalance_countdown = RECOVERY_REBALANCE_INTERVAL;
+
 /* orioledb checkpoint number from which we start recovery */
 static uint32 startup_chkp_num;
 
@@ -236,6 +288,8 @@ RecoveryWorkerPtrs *worker_ptrs;
 pg_atomic_uint64 *recovery_ptr;
 pg_atomic_uint64 *recovery_main_retain_ptr;
 pg_atomic_uint64 *recovery_finished_list_ptr;
+pg_atomic_uint64 *recovery_queue_consumed;
+pg_atomic_uint64 *recovery_queue_added;
 bool	   *recovery_single_process;
 
 
@@ -249,24 +303,31 @@ static void worker_wait_shutdown(RecoveryWorkerState *worker);
 
 static void replay_container(Pointer ptr, Pointer endPtr,
 							 bool single, XLogRecPtr xlogRecPtr);
+static void prefetch_container_targets(Pointer startPtr, Pointer endPtr);
 
 static inline void worker_send_msg(int worker_id, Pointer msg, uint64 msg_size);
 static void worker_send_modify(int worker_id, BTreeDescr *desc, uint16 recType,
 							   OTuple tuple, int tuple_len, bool wal);
 static void workers_send_finish(void);
 static void workers_send_oxid_finish(XLogRecPtr ptr, bool commit);
+static void worker_emit_pending_savepoints(int worker_id);
+static void workers_flush_pending_savepoints(void);
 static void workers_send_savepoint(SubTransactionId parentSubId);
 static void workers_send_rollback_to_savepoint(XLogRecPtr ptr,
 											   SubTransactionId parentSubId);
 static void workers_synchronize(XLogRecPtr csn, bool send_synchronize);
 static void workers_notify_toast_consistent(void);
 static inline void worker_queue_flush(int worker_id);
+static void workers_wait_for_consumed(void);
 
 static inline bool apply_sys_tree_modify_record(int sys_tree_num, uint16 type,
 												OTuple tup,
 												OXid oxid, CommitSeqNo csn);
 static inline void spread_idx_modify(BTreeDescr *desc, uint16 recType,
 									 OTuple rec, bool wal);
+static int	route_modify_hash(uint32 hash);
+static void note_modify_sent(uint32 hash, int worker_id);
+static void consider_slice_migration(void);
 
 static inline uint16 recovery_msg_from_wal_record(uint8 wal_record);
 
@@ -287,6 +348,10 @@ recovery_shmem_needs(void)
 	size = add_size(size, CACHELINEALIGN(mul_size(sizeof(RecoveryWorkerPtrs),
 												  recovery_pool_size_guc + 1)));
 	size = add_size(size, CACHELINEALIGN(mul_size(sizeof(pg_atomic_uint64), 3)));
+	size = add_size(size, CACHELINEALIGN(mul_size(sizeof(pg_atomic_uint64),
+												  recovery_pool_size_guc)));
+	size = add_size(size, CACHELINEALIGN(mul_size(sizeof(pg_atomic_uint64),
+												  recovery_pool_size_guc)));
 
 	return size;
 }
@@ -325,6 +390,14 @@ recovery_shmem_init(Pointer ptr, bool found)
 
 	ptr += CACHELINEALIGN(mul_size(sizeof(pg_atomic_uint64), 3));
 
+	recovery_queue_consumed = (pg_atomic_uint64 *) ptr;
+	ptr += CACHELINEALIGN(mul_size(sizeof(pg_atomic_uint64),
+								   recovery_pool_size_guc));
+
+	recovery_queue_added = (pg_atomic_uint64 *) ptr;
+	ptr += CACHELINEALIGN(mul_size(sizeof(pg_atomic_uint64),
+								   recovery_pool_size_guc));
+
 	recovery_queue_data_size = recovery_queue_size_guc;
 
 	if (!found)
@@ -346,6 +419,8 @@ recovery_shmem_init(Pointer ptr, bool found)
 			pg_atomic_init_u64(&worker_ptrs[i].commitPtr, InvalidXLogRecPtr);
 			pg_atomic_init_u64(&worker_ptrs[i].retainPtr, InvalidXLogRecPtr);
 			worker_ptrs[i].flushedUndoLocCompletedCheckpointNumber = 0;
+			pg_atomic_init_u64(&recovery_queue_consumed[i], 0);
+			pg_atomic_init_u64(&recovery_queue_added[i], 0);
 		}
 		pg_atomic_init_u64(recovery_ptr, InvalidXLogRecPtr);
 		pg_atomic_init_u64(recovery_main_retain_ptr, InvalidXLogRecPtr);
@@ -362,6 +437,9 @@ undo_stack_locations_set_invalid(UndoStackLocations *location)
 	location->onCommitLocation = InvalidUndoLocation;
 }
 
+/* number of xid records read_xids() reads from the xid file at once */
+#define XID_RECS_BATCH_SIZE 1024
+
 /*
  * Read information about undo locations of in-progress transactions.
  */
@@ -370,9 +448,10 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
 {
 	char	   *xidFilename = psprintf(XID_FILENAME_FORMAT, checkpointnum);
 	File		xidFile;
+	XidFileRec *xidRecs;
 	off_t		offset = 0;
 	uint32		count = 0,
-				i;
+				i = 0;
 
 	xidFile = PathNameOpenFile(xidFilename, O_RDONLY | O_CREAT | PG_BINARY);
 	if (xidFile < 0)
@@ -386,60 +465,76 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
 						errmsg("could not read xid record from file %s", xidFilename)));
 	offset += sizeof(count);
 
-	for (i = 0; i < count; i++)
+	xidRecs = (XidFileRec *) palloc(sizeof(XidFileRec) * XID_RECS_BATCH_SIZE);
+	while (i < count)
 	{
-		RecoveryXidState *state;
-		XidFileRec	xidRec;
-		bool		found;
+		uint32		batchCount = Min(count - i, XID_RECS_BATCH_SIZE);
+		int			batchSize = batchCount * sizeof(XidFileRec);
+		uint32		j;
 
-		if (OFileRead(xidFile, (Pointer) &xidRec,
-					  sizeof(xidRec), offset,
-					  WAIT_EVENT_SLRU_READ) != sizeof(xidRec))
+		if (OFileRead(xidFile, (Pointer) xidRecs,
+					  batchSize, offset,
+					  WAIT_EVENT_SLRU_READ) != batchSize)
 			ereport(FATAL, (errcode_for_file_access(),
 							errmsg("could not read xid record from file %s", xidFilename)));
+		offset += batchSize;
+		i += batchCount;
 
-		advance_oxids(xidRec.oxid);
-		state = (RecoveryXidState *) hash_search(recovery_xid_state_hash,
-												 &xidRec.oxid,
-												 HASH_ENTER,
-												 &found);
-
-		if (!found)
+		for (j = 0; j < batchCount; j++)
 		{
-			state->xid = InvalidTransactionId;
-			state->needs_wal_flush = false;
-			state->retain_loc = InvalidUndoLocation;	/* undo locations are
-														 * held by checkpoint */
-			state->csn = COMMITSEQNO_INPROGRESS;
-			state->ptr = InvalidXLogRecPtr;
-			state->in_finished_list = false;
-			state->in_retain_heap = false;
-			undo_stack_locations_set_invalid(&state->undo_stack);
-			dlist_init(&state->checkpoint_undo_stacks);
-			if (worker_id < 0)
-				pairingheap_add(xmin_queue, &state->xmin_ph_node);
+			RecoveryXidState *state;
+			XidFileRec *xidRec = &xidRecs[j];
+			bool		found;
 
-			state->systree_modified = false;
-			state->checkpoint_xid = true;
-			state->wal_xid = false;
-			if (!recovery_single && worker_id < 0)
-				state->used_by = palloc0(recovery_pool_size_guc * sizeof(bool));
-			else
-				state->used_by = NULL;
-		}
-		if (worker_id < 0)
-		{
-			CheckpointUndoStack *stack;
+			advance_oxids(xidRec->oxid);
+			state = (RecoveryXidState *) hash_search(recovery_xid_state_hash,
+													 &xidRec->oxid,
+													 HASH_ENTER,
+													 &found);
 
-			stack = (CheckpointUndoStack *) MemoryContextAlloc(TopMemoryContext,
-															   sizeof(CheckpointUndoStack));
-			stack->undo_stack = xidRec.undoLocation;
-			dlist_push_tail(&state->checkpoint_undo_stacks, &stack->node);
-			set_oxid_csn(xidRec.oxid, COMMITSEQNO_INPROGRESS);
-		}
+			if (!found)
+			{
+				state->xid = InvalidTransactionId;
+				state->needs_wal_flush = false;
+				state->retain_loc = InvalidUndoLocation;	/* undo locations are
+															 * held by checkpoint */
+				state->csn = COMMITSEQNO_INPROGRESS;
+				state->ptr = InvalidXLogRecPtr;
+				state->in_finished_list = false;
+				state->in_retain_heap = false;
+				undo_stack_locations_set_invalid(&state->undo_stack);
+				dlist_init(&state->checkpoint_undo_stacks);
+				if (worker_id < 0)
+					pairingheap_add(xmin_queue, &state->xmin_ph_node);
+
+				state->systree_modified = false;
+				state->checkpoint_xid = true;
+				state->wal_xid = false;
+				state->nPendingSavepoints = 0;
+				if (!recovery_single && worker_id < 0)
+				{
+					state->used_by = palloc0(recovery_pool_size_guc * sizeof(bool));
+					state->sentSavepoints = palloc0(recovery_pool_size_guc * sizeof(int));
+				}
+				else
+				{
+					state->used_by = NULL;
+					state->sentSavepoints = NULL;
+				}
+			}
+			if (worker_id < 0)
+			{
+				CheckpointUndoStack *stack;
 
-		offset += sizeof(xidRec);
+				stack = (CheckpointUndoStack *) MemoryContextAlloc(TopMemoryContext,
+																   sizeof(CheckpointUndoStack));
+				stack->undo_stack = xidRec->undoLocation;
+				dlist_push_tail(&state->checkpoint_undo_stacks, &stack->node);
+				set_oxid_csn(xidRec->oxid, COMMITSEQNO_INPROGRESS);
+			}
+		}
 	}
+	pfree(xidRecs);
 
 	if (worker_id < 0)
 		update_run_xmin();
@@ -452,19 +547,29 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
  *
  * These records are intended to be already aborted.  But checkpointer could
  * "see" tuples which still reference those records.  This routine is du
+ *
+ * With a worker pool available the per-transaction work is fanned out
+ * round-robin: branches of different transactions are independent undo
+ * chains, and page-level locking makes concurrent application safe.  The
+ * caller must wait for the queues to drain before WAL replay starts, so
+ * that replay observes the same state as after a single-process pass.
  */
 static void
-apply_xids_branches(void)
+apply_xids_branches(bool recovery_single)
 {
 	HASH_SEQ_STATUS hash_seq;
+	int			worker_id = 0;
 
 	hash_seq_init(&hash_seq, recovery_xid_state_hash);
 	while ((cur_state = (RecoveryXidState *) hash_seq_search(&hash_seq)) != NULL)
 	{
 		dlist_iter	iter;
 
-		oxid_needs_wal_flush = cur_state->needs_wal_flush;
-		recovery_oxid = cur_state->oxid;
+		if (recovery_single)
+		{
+			oxid_needs_wal_flush = cur_state->needs_wal_flush;
+			recovery_oxid = cur_state->oxid;
+		}
 
 		dlist_foreach(iter, &cur_state->checkpoint_undo_stacks)
 		{
@@ -472,8 +577,23 @@ apply_xids_branches(void)
 														 node,
 														 iter.cur);
 
-			set_cur_undo_locations(stack->undo_stack);
-			apply_undo_branches(recovery_oxid);
+			if (recovery_single)
+			{
+				set_cur_undo_locations(stack->undo_stack);
+				apply_undo_branches(recovery_oxid);
+			}
+			else
+			{
+				RecoveryMsgApplyBranches msg;
+
+				memset(&msg, 0, sizeof(msg));
+				msg.header.type = RECOVERY_APPLY_BRANCHES;
+				msg.oxid = cur_state->oxid;
+				msg.undoStack = stack->undo_stack;
+				msg.needsWalFlush = cur_state->needs_wal_flush;
+				worker_send_msg(worker_id, (Pointer) &msg, sizeof(msg));
+				worker_id = (worker_id + 1) % recovery_pool_size_guc;
+			}
 		}
 	}
 
@@ -481,6 +601,66 @@ apply_xids_branches(void)
 	recovery_oxid = InvalidOXid;
 	reset_cur_undo_locations();
 	cur_state = NULL;
+
+	if (!recovery_single)
+		workers_wait_for_consumed();
+}
+
+/*
+ * Applies undo branches of a single checkpoint transaction by a recovery
+ * worker, see apply_xids_branches().
+ */
+void
+recovery_apply_branches(OXid oxid, UndoStackLocations undoStack,
+						bool needsWalFlush)
+{
+	bool		found;
+
+	cur_state = (RecoveryXidState *) hash_search(recovery_xid_state_hash,
+												 &oxid, HASH_FIND, &found);
+	Assert(found);
+	if (!found)
+		return;
+
+	oxid_needs_wal_flush = needsWalFlush;
+	recovery_oxid = oxid;
+	set_cur_undo_locations(undoStack);
+	apply_undo_branches(oxid);
+
+	oxid_needs_wal_flush = false;
+	recovery_oxid = InvalidOXid;
+	reset_cur_undo_locations();
+	cur_state = NULL;
+}
+
+/*
+ * Flush the worker queues and wait until every worker has consumed all the
+ * messages sent so far.
+ */
+static void
+workers_wait_for_consumed(void)
+{
+	int			i;
+
+	for (i = 0; i < recovery_pool_size_guc; i++)
+	{
+		if (workers_pool[i].queue_buf_len > 0)
+			worker_queue_flush(i);
+	}
+
+	for (i = 0; i < recovery_pool_size_guc; i++)
+	{
+		while (pg_atomic_read_u64(&recovery_queue_consumed[i]) <
+			   workers_pool[i].sent_bytes)
+		{
+			if (unexpected_worker_detach)
+			{
+				abort_recovery(workers_pool, recovery_pool_size_guc);
+				elog(ERROR, "orioledb recovery worker detached unexpectedly.");
+			}
+			pg_usleep(10000L);
+		}
+	}
 }
 
 void
@@ -507,8 +687,17 @@ o_recovery_start_hook(void)
 
 	if (!recovery_single)
 	{
+		int			slice;
+
 		workers_pool = palloc0(sizeof(RecoveryWorkerState) * num_workers);
 
+		slice_worker_map = palloc(sizeof(int) * RECOVERY_HASH_SLICES);
+		slice_send_counts = palloc0(sizeof(uint32) * RECOVERY_HASH_SLICES);
+		for (slice = 0; slice < RECOVERY_HASH_SLICES; slice++)
+			slice_worker_map[slice] = slice % num_workers;
+		migration_slice = -1;
+		rebalance_countdown = RECOVERY_REBALANCE_INTERVAL;
+
 		for (i = 0; i < num_workers; i++)
 		{
 			state = &workers_pool[i];
@@ -555,7 +744,7 @@ o_recovery_start_hook(void)
 	recovery_init(-1);
 
 	if (checkpoint_state->lastCheckpointNumber > 0)
-		apply_xids_branches();
+		apply_xids_branches(recovery_single);
 }
 
 void
@@ -572,10 +761,28 @@ o_recovery_logicalmsg_redo_hook(XLogReaderState *record)
 			&& strncmp(xlrec->message, ORIOLEDB_WAL_PREFIX, ORIOLEDB_WAL_PREFIX_SIZE) == 0)
 		{
 			Pointer		msg_start = xlrec->message + xlrec->prefix_size;
+			Size		msg_size = xlrec->message_size;
 			bool		recovery_single;
 
 			recovery_single = *recovery_single_process;
 
+			if (msg_size > 0 && *msg_start == WAL_REC_CONTAINER_COMPRESSED)
+			{
+				static char decompressed_buffer[LOCAL_WAL_BUFFER_SIZE];
+				WALRecContainerCompressed *rec = (WALRecContainerCompressed *) msg_start;
+				uint32		rawLength;
+
+				memcpy(&rawLength, rec->rawLength, sizeof(rawLength));
+				if (rawLength > LOCAL_WAL_BUFFER_SIZE)
+					elog(PANIC, "Wrong WAL container raw length: %u", rawLength);
+
+				o_decompress_wal_container(msg_start + sizeof(*rec),
+										   msg_size - sizeof(*rec),
+										   decompressed_buffer, rawLength);
+				msg_start = decompressed_buffer;
+				msg_size = rawLength;
+			}
+
 			if (record->ReadRecPtr >= checkpoint_state->controlToastConsistentPtr)
 			{
 				toast_consistent = true;
@@ -585,7 +792,7 @@ o_recovery_logicalmsg_redo_hook(XLogReaderState *record)
 
 			if (record->ReadRecPtr >= checkpoint_state->controlReplayStartPtr)
 			{
-				replay_container(msg_start, msg_start + xlrec->message_size,
+				replay_container(msg_start, msg_start + msg_size,
 								 recovery_single, record->ReadRecPtr);
 			}
 
@@ -941,10 +1148,17 @@ recovery_switch_to_oxid(OXid oxid, int worker_id)
 				pairingheap_add(xmin_queue, &cur_state->xmin_ph_node);
 			cur_state->systree_modified = false;
 			cur_state->checkpoint_xid = false;
+			cur_state->nPendingSavepoints = 0;
 			if (worker_id < 0 && !*recovery_single_process)
+			{
 				cur_state->used_by = palloc0(recovery_pool_size_guc * sizeof(bool));
+				cur_state->sentSavepoints = palloc0(recovery_pool_size_guc * sizeof(int));
+			}
 			else
+			{
 				cur_state->used_by = NULL;
+				cur_state->sentSavepoints = NULL;
+			}
 		}
 		update_proc_retain_undo_location(worker_id);
 	}
@@ -964,6 +1178,8 @@ check_delete_xid_state(RecoveryXidState *state, int worker_id)
 
 		if (state->used_by)
 			pfree(state->used_by);
+		if (state->sentSavepoints)
+			pfree(state->sentSavepoints);
 		if (worker_id < 0)
 		{
 			pairingheap_remove(xmin_queue, &state->xmin_ph_node);
@@ -1175,10 +1391,15 @@ recovery_insert_systree_callback(BTreeDescr *descr,
 
 /*
  * Applies modify recovery record to the BTree.
+ *
+ * The caller may pass a persistent hint, which is updated to the modified
+ * leaf.  WAL containers of ingest-heavy workloads hold long runs of records
+ * targeting the same leaf, so passing the hint back lets refind_page() skip
+ * the root-to-leaf descent for all but the first record of a run.
  */
 bool
 apply_btree_modify_record(BTreeDescr *tree, uint16 type, OTuple ptr,
-						  OXid oxid, CommitSeqNo csn)
+						  OXid oxid, CommitSeqNo csn, BTreeLocationHint *hint)
 {
 	OBTreeModifyResult modifyResult;
 	BTreeModifyCallbackInfo callbackInfo = nullCallbackInfo;
@@ -1212,7 +1433,7 @@ apply_btree_modify_record(BTreeDescr *tree, uint16 type, OTuple ptr,
 										  ptr, BTreeKeyLeafTuple,
 										  NULL, BTreeKeyNone,
 										  oxid, csn, RowLockUpdate,
-										  NULL, &callbackInfo);
+										  hint, &callbackInfo);
 			result = modifyResult == OBTreeModifyResultInserted || modifyResult == OBTreeModifyResultUpdated;
 			break;
 		case RECOVERY_UPDATE:
@@ -1220,13 +1441,13 @@ apply_btree_modify_record(BTreeDescr *tree, uint16 type, OTuple ptr,
 									ptr, BTreeKeyLeafTuple,
 									NULL, BTreeKeyNone,
 									oxid, csn, RowLockNoKeyUpdate,
-									NULL, &callbackInfo) == OBTreeModifyResultUpdated;
+									hint, &callbackInfo) == OBTreeModifyResultUpdated;
 			break;
 		case RECOVERY_DELETE:
 			result = o_btree_modify(tree, BTreeOperationDelete,
 									ptr, BTreeKeyNonLeafKey,
 									NULL, BTreeKeyNone, oxid, csn, RowLockUpdate,
-									NULL, &callbackInfo) == OBTreeModifyResultDeleted;
+									hint, &callbackInfo) == OBTreeModifyResultDeleted;
 			break;
 		default:
 			Assert(false);
@@ -1291,6 +1512,78 @@ orioledb_recovery_synchronized(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(true);
 }
 
+/*
+ * Report per-worker recovery progress: how many bytes the master enqueued
+ * and the worker consumed (their difference is the queue backlog), and the
+ * commit and retain LSNs the worker has reached.  All counters are zero
+ * when no recovery ran in this server lifetime.
+ */
+Datum
+orioledb_recovery_progress(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	AttrNumber	attnum;
+	int			i;
+
+	orioledb_check_shmem();
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(6);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "worker_id", INT4OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "queue_added_bytes", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "queue_consumed_bytes", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "queue_pending_bytes", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "commit_lsn", LSNOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "retain_lsn", LSNOID, -1, 0);
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < recovery_pool_size_guc; i++)
+	{
+		uint64		added = pg_atomic_read_u64(&recovery_queue_added[i]);
+		uint64		consumed = pg_atomic_read_u64(&recovery_queue_consumed[i]);
+		XLogRecPtr	commitPtr = pg_atomic_read_u64(&worker_ptrs[i].commitPtr);
+		XLogRecPtr	retainPtr = pg_atomic_read_u64(&worker_ptrs[i].retainPtr);
+		Datum		values[6];
+		bool		nulls[6] = {false};
+
+		values[0] = Int32GetDatum(i);
+		values[1] = Int64GetDatum((int64) added);
+		values[2] = Int64GetDatum((int64) consumed);
+		values[3] = Int64GetDatum((int64) (added - consumed));
+		if (XLogRecPtrIsInvalid(commitPtr))
+			nulls[4] = true;
+		else
+			values[4] = LSNGetDatum(commitPtr);
+		if (XLogRecPtrIsInvalid(retainPtr))
+			nulls[5] = true;
+		else
+			values[5] = LSNGetDatum(retainPtr);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	PG_RETURN_VOID();
+}
+
 static void
 update_run_xmin(void)
 {
@@ -1732,6 +2025,118 @@ o_indices_get_oids(Pointer tuple, ORelOids *tableOids)
 	return treeOids;
 }
 
+/*
+ * Peek ahead at the modify records of a WAL container and hint the OS to
+ * read the on-disk leaf pages they target, so that by the time the records
+ * are applied -- here or by a recovery worker -- the reads are already in
+ * flight instead of being serial demand misses in load_page().
+ *
+ * The pass mirrors the pointer arithmetic of replay_container() but has no
+ * side effects beyond fetching tree descriptors, which the apply pass would
+ * fetch moments later anyway.  Records of system trees and of trees whose
+ * descriptor cannot be resolved are skipped.
+ */
+static void
+prefetch_container_targets(Pointer startPtr, Pointer endPtr)
+{
+	OIndexDescr *indexDescr = NULL;
+	ORelOids	cur_oids = {0, 0, 0};
+	OffsetNumber length;
+	uint8		rec_type;
+	int			sys_tree_num = -1;
+	uint64		lastDownlink = 0;
+	Pointer		ptr = startPtr;
+
+	while (ptr < endPtr)
+	{
+		rec_type = *ptr;
+		ptr++;
+
+		if (rec_type == WAL_REC_XID)
+		{
+			ptr += sizeof(OXid);
+		}
+		else if (rec_type == WAL_REC_COMMIT || rec_type == WAL_REC_ROLLBACK)
+		{
+			ptr += sizeof(OXid);
+		}
+		else if (rec_type == WAL_REC_JOINT_COMMIT)
+		{
+			ptr += sizeof(TransactionId) + sizeof(OXid);
+		}
+		else if (rec_type == WAL_REC_RELATION)
+		{
+			OIndexType	ix_type;
+
+			ix_type = *ptr;
+			ptr++;
+			memcpy(&cur_oids.datoid, ptr, sizeof(Oid));
+			ptr += sizeof(Oid);
+			memcpy(&cur_oids.reloid, ptr, sizeof(Oid));
+			ptr += sizeof(Oid);
+			memcpy(&cur_oids.relnode, ptr, sizeof(Oid));
+			ptr += sizeof(Oid);
+
+			indexDescr = NULL;
+			if (IS_SYS_TREE_OIDS(cur_oids))
+			{
+				sys_tree_num = cur_oids.relnode;
+			}
+			else
+			{
+				sys_tree_num = -1;
+				if (ix_type == oIndexInvalid)
+				{
+					OTableDescr *descr = o_fetch_table_descr(cur_oids);
+
+					indexDescr = descr ? GET_PRIMARY(descr) : NULL;
+				}
+				else
+				{
+					indexDescr = o_fetch_index_descr(cur_oids, ix_type,
+													 false, NULL);
+				}
+			}
+		}
+		else if (rec_type == WAL_REC_INVALIDATE)
+		{
+			ptr += 4 * sizeof(Oid);
+		}
+		else if (rec_type == WAL_REC_SAVEPOINT ||
+				 rec_type == WAL_REC_ROLLBACK_TO_SAVEPOINT)
+		{
+			ptr += sizeof(SubTransactionId);
+		}
+		else
+		{
+			OFixedTuple tuple;
+
+			Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE || rec_type == WAL_REC_DELETE);
+
+			tuple.tuple.formatFlags = *ptr;
+			ptr++;
+
+			memcpy(&length, ptr, sizeof(OffsetNumber));
+			ptr += sizeof(OffsetNumber);
+
+			if (sys_tree_num <= 0 && indexDescr != NULL)
+			{
+				memcpy(tuple.fixedData, ptr, length);
+				tuple.tuple.data = tuple.fixedData;
+
+				o_btree_load_shmem(&indexDescr->desc);
+				prefetch_page_for_key(&indexDescr->desc,
+									  (Pointer) &tuple.tuple,
+									  rec_type == WAL_REC_DELETE ?
+									  BTreeKeyNonLeafKey : BTreeKeyLeafTuple,
+									  &lastDownlink);
+			}
+
+			ptr += length;
+		}
+	}
+}
+
 /*
  * Replays a single orioledb WAL container.
  */
@@ -1742,6 +2147,7 @@ replay_container(Pointer startPtr, Pointer endPtr,
 	OTableDescr *descr = NULL;
 	OIndexDescr *indexDescr = NULL;
 	OXid		oxid = InvalidOXid;
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, InvalidOPageChangeCount};
 	ORelOids	cur_oids = {0, 0, 0},
 				tmp_oids,
 			   *treeOids;
@@ -1753,6 +2159,9 @@ replay_container(Pointer startPtr, Pointer endPtr,
 	Pointer		ptr = startPtr;
 	XLogRecPtr	xlogPtr;
 
+	if (recovery_prefetch)
+		prefetch_container_targets(startPtr, endPtr);
+
 	while (ptr < endPtr)
 	{
 		xlogPtr = xlogRecPtr + (ptr - startPtr);
@@ -1836,6 +2245,10 @@ replay_container(Pointer startPtr, Pointer endPtr,
 			else
 				sys_tree_num = -1;
 
+			/* the leaf hint is only valid within a run on the same tree */
+			hint.blkno = OInvalidInMemoryBlkno;
+			hint.pageChangeCount = InvalidOPageChangeCount;
+
 			if (sys_tree_num > 0)
 			{
 				descr = NULL;
@@ -2028,7 +2441,8 @@ replay_container(Pointer startPtr, Pointer endPtr,
 			if (single)
 			{
 				recovery_switch_to_oxid(oxid, -1);
-				apply_modify_record(descr, indexDescr, type, tuple.tuple, false);
+				apply_modify_record(descr, indexDescr, type, tuple.tuple,
+									false, &hint);
 			}
 			else
 			{
@@ -2113,6 +2527,11 @@ worker_send_modify(int worker_id, BTreeDescr *desc, uint16 recType,
 	ORelOids	oids = desc->oids;
 	OIndexType	type = desc->type;
 
+	/* deliver the savepoints this record has to be ordered after */
+	if (cur_state->sentSavepoints != NULL &&
+		cur_state->sentSavepoints[worker_id] < cur_state->nPendingSavepoints)
+		worker_emit_pending_savepoints(worker_id);
+
 	if (wal && !IS_SYS_TREE_OIDS(oids) && type == oIndexPrimary)
 	{
 		OIndexDescr *id = (OIndexDescr *) desc->arg;
@@ -2163,12 +2582,53 @@ worker_send_modify(int worker_id, BTreeDescr *desc, uint16 recType,
 	memcpy(data, &tuple.formatFlags, 1);
 
 	state->queue_buf_len += sizeof(int) + 1;
-	state->queue_buf_len = MAXALIGN(state->queue_buf_len);
-	data = state->queue_buf + state->queue_buf_len;
 
-	memcpy(data, tuple.data, tuple_len);
-	state->queue_buf_len += tuple_len;
-	state->queue_buf_len = MAXALIGN(state->queue_buf_len);
+	if (tuple_len >= RECOVERY_SENDV_TUPLE_THRESHOLD)
+	{
+		/*
+		 * Send the buffered messages and the tuple body in a single chunk,
+		 * pointing the second iovec directly at the WAL container.  This
+		 * skips the copy of the tuple into the queue buffer; the worker
+		 * parses the chunk the same way as a buffered one.
+		 */
+		shm_mq_iovec iov[2];
+		shm_mq_result result;
+		int			padded_len = MAXALIGN(state->queue_buf_len);
+
+		memset(state->queue_buf + state->queue_buf_len, 0,
+			   padded_len - state->queue_buf_len);
+		state->queue_buf_len = padded_len;
+
+		iov[0].data = state->queue_buf;
+		iov[0].len = state->queue_buf_len;
+		iov[1].data = tuple.data;
+		iov[1].len = tuple_len;
+
+#if PG_VERSION_NUM >= 150000
+		result = shm_mq_sendv(state->queue, iov, 2, false, true);
+#else
+		result = shm_mq_sendv(state->queue, iov, 2, false);
+#endif
+		state->sent_bytes += state->queue_buf_len + tuple_len;
+		pg_atomic_write_u64(&recovery_queue_added[worker_id], state->sent_bytes);
+		state->queue_buf_len = 0;
+		Assert(result != SHM_MQ_WOULD_BLOCK);
+		if (result == SHM_MQ_DETACHED)
+		{
+			unexpected_worker_detach = true;
+			return;
+		}
+		Assert(result == SHM_MQ_SUCCESS);
+	}
+	else
+	{
+		state->queue_buf_len = MAXALIGN(state->queue_buf_len);
+		data = state->queue_buf + state->queue_buf_len;
+
+		memcpy(data, tuple.data, tuple_len);
+		state->queue_buf_len += tuple_len;
+		state->queue_buf_len = MAXALIGN(state->queue_buf_len);
+	}
 }
 
 /*
@@ -2196,38 +2656,84 @@ workers_send_finish(void)
 }
 
 /*
- * Sends savepoint message to workers with active the oxid in the pool.
+ * Deliver the savepoints of the current transaction the worker hasn't
+ * received yet.  Called right before a message whose ordering against the
+ * savepoints matters goes to the worker queue: the next modify record of the
+ * transaction or a rollback to one of the savepoints.
  */
 static void
-workers_send_savepoint(SubTransactionId parentSubId)
+worker_emit_pending_savepoints(int worker_id)
 {
-	RecoveryWorkerState *state;
+	RecoveryWorkerState *state = &workers_pool[worker_id];
 	RecoveryMsgSavepoint msg;
 	int			i;
 
-	Assert(cur_state);
+	Assert(cur_state->sentSavepoints != NULL);
 
-	msg.header.type = RECOVERY_SAVEPOINT;
-	msg.oxid = cur_state->oxid;
-	msg.parentSubId = parentSubId;
+	if (!cur_state->used_by[worker_id])
+	{
+		/*
+		 * The worker hasn't applied anything of the transaction yet, so
+		 * everything it ever applies will postdate these savepoints and the
+		 * boundaries are of no use for it: rollback to an absent boundary
+		 * undoes the whole per-worker undo stack of the transaction, which
+		 * is exactly the records applied after the savepoint.
+		 */
+		cur_state->sentSavepoints[worker_id] = cur_state->nPendingSavepoints;
+		return;
+	}
+
+	for (i = cur_state->sentSavepoints[worker_id];
+		 i < cur_state->nPendingSavepoints; i++)
+	{
+		msg.header.type = RECOVERY_SAVEPOINT;
+		msg.oxid = cur_state->oxid;
+		msg.parentSubId = cur_state->pendingSavepoints[i];
+
+		if (state->oxid == cur_state->oxid)
+			state->oxid = InvalidOXid;
+
+		worker_send_msg(worker_id, (Pointer) &msg, sizeof(msg));
+	}
+	cur_state->sentSavepoints[worker_id] = cur_state->nPendingSavepoints;
+}
+
+/*
+ * Deliver the pending savepoints to every worker that applied something of
+ * the transaction and empty the pending list.
+ */
+static void
+workers_flush_pending_savepoints(void)
+{
+	int			i;
 
 	for (i = 0; i < recovery_pool_size_guc; i++)
 	{
 		if (cur_state->used_by[i])
-		{
-			state = &workers_pool[i];
-			if (state->oxid == cur_state->oxid)
-				state->oxid = InvalidOXid;
+			worker_emit_pending_savepoints(i);
+	}
 
-			worker_send_msg(i, (Pointer) &msg, sizeof(msg));
+	cur_state->nPendingSavepoints = 0;
+	memset(cur_state->sentSavepoints, 0,
+		   recovery_pool_size_guc * sizeof(int));
+}
 
-			if (EnableHotStandby)
-			{
-				/* we need to apply recovery records as fast as we can */
-				worker_queue_flush(i);
-			}
-		}
-	}
+/*
+ * Remember a savepoint of the current transaction to be piggybacked onto the
+ * next message per worker queue.  Broadcasting it immediately would multiply
+ * savepoint-heavy replay traffic by the worker count; most savepoints are
+ * never rolled back to, and a worker only needs the boundary once something
+ * it applies can be rolled back past it.
+ */
+static void
+workers_send_savepoint(SubTransactionId parentSubId)
+{
+	Assert(cur_state);
+
+	if (cur_state->nPendingSavepoints == RECOVERY_PENDING_SAVEPOINTS_MAX)
+		workers_flush_pending_savepoints();
+
+	cur_state->pendingSavepoints[cur_state->nPendingSavepoints++] = parentSubId;
 }
 
 /*
@@ -2252,6 +2758,9 @@ workers_send_rollback_to_savepoint(XLogRecPtr ptr,
 	{
 		if (cur_state->used_by[i])
 		{
+			/* the rollback target boundary must reach the worker first */
+			worker_emit_pending_savepoints(i);
+
 			state = &workers_pool[i];
 			if (state->oxid == cur_state->oxid)
 				state->oxid = InvalidOXid;
@@ -2265,6 +2774,9 @@ workers_send_rollback_to_savepoint(XLogRecPtr ptr,
 			}
 		}
 	}
+	cur_state->nPendingSavepoints = 0;
+	memset(cur_state->sentSavepoints, 0,
+		   recovery_pool_size_guc * sizeof(int));
 	pg_atomic_write_u64(recovery_ptr, ptr);
 }
 
@@ -2282,6 +2794,12 @@ workers_send_oxid_finish(XLogRecPtr ptr, bool commit)
 	oxid_ptr_record.oxid = cur_state->oxid;
 	oxid_ptr_record.ptr = ptr;
 
+	/*
+	 * Pending savepoints are dropped here: commit collapses the whole
+	 * transaction and rollback undoes the whole per-worker undo stack, the
+	 * subtransaction boundaries don't matter for either.
+	 */
+
 	for (i = 0; i < recovery_pool_size_guc; i++)
 	{
 		if (cur_state->used_by[i])
@@ -2386,6 +2904,8 @@ worker_queue_flush(int worker_id)
 #else
 	result = shm_mq_send(state->queue, state->queue_buf_len, state->queue_buf, false);
 #endif
+	state->sent_bytes += state->queue_buf_len;
+	pg_atomic_write_u64(&recovery_queue_added[worker_id], state->sent_bytes);
 	state->queue_buf_len = 0;
 	Assert(result != SHM_MQ_WOULD_BLOCK);
 	if (result == SHM_MQ_DETACHED)
@@ -2411,23 +2931,135 @@ apply_sys_tree_modify_record(int sys_tree_num, uint16 type, OTuple tup,
 	bool		result;
 
 	result = apply_btree_modify_record(get_sys_tree(sys_tree_num),
-									   type, tup, oxid, csn);
+									   type, tup, oxid, csn, NULL);
 
 	return result;
 }
 
+/*
+ * Returns the worker responsible for the hash slice of the given key hash.
+ *
+ * Tuples with a same key must be processed by a same worker, so an ongoing
+ * slice migration completes only once the old owner has consumed everything
+ * enqueued for the slice so far, see note_modify_sent().
+ */
+static int
+route_modify_hash(uint32 hash)
+{
+	int			worker_id;
+
+	if (migration_slice >= 0 &&
+		pg_atomic_read_u64(&recovery_queue_consumed[slice_worker_map[migration_slice]]) >= migration_barrier)
+	{
+		slice_worker_map[migration_slice] = migration_target;
+		migration_slice = -1;
+	}
+
+	worker_id = slice_worker_map[hash % RECOVERY_HASH_SLICES];
+	slice_send_counts[hash % RECOVERY_HASH_SLICES]++;
+
+	if (--rebalance_countdown == 0)
+	{
+		rebalance_countdown = RECOVERY_REBALANCE_INTERVAL;
+		consider_slice_migration();
+	}
+
+	return worker_id;
+}
+
+/*
+ * Notes that a record for the given key hash was enqueued.  While a slice
+ * migration is pending, every record enqueued for the slice pushes the
+ * barrier the old owner must consume up to before the new owner may receive
+ * records of the slice.
+ */
+static void
+note_modify_sent(uint32 hash, int worker_id)
+{
+	if (migration_slice >= 0 &&
+		(int) (hash % RECOVERY_HASH_SLICES) == migration_slice)
+		migration_barrier = workers_pool[worker_id].sent_bytes +
+			workers_pool[worker_id].queue_buf_len;
+}
+
+/*
+ * Checks whether the worker queue depths are skewed enough to migrate the
+ * hottest hash slice of the busiest worker to the least loaded one.
+ */
+static void
+consider_slice_migration(void)
+{
+	uint64		maxDepth = 0,
+				minDepth = UINT64_MAX;
+	int			maxWorker = -1,
+				minWorker = -1,
+				bestSlice = -1,
+				i;
+	uint32		bestCount = 0;
+
+	if (migration_slice >= 0 || recovery_pool_size_guc <= 1)
+		return;
+
+	for (i = 0; i < recovery_pool_size_guc; i++)
+	{
+		uint64		enqueued = workers_pool[i].sent_bytes +
+			workers_pool[i].queue_buf_len;
+		uint64		depth = enqueued -
+			pg_atomic_read_u64(&recovery_queue_consumed[i]);
+
+		if (depth >= maxDepth)
+		{
+			maxDepth = depth;
+			maxWorker = i;
+		}
+		if (depth < minDepth)
+		{
+			minDepth = depth;
+			minWorker = i;
+		}
+	}
+
+	if (maxWorker != minWorker &&
+		maxDepth >= minDepth + RECOVERY_REBALANCE_MIN_SKEW)
+	{
+		for (i = 0; i < RECOVERY_HASH_SLICES; i++)
+		{
+			if (slice_worker_map[i] == maxWorker &&
+				slice_send_counts[i] > bestCount)
+			{
+				bestCount = slice_send_counts[i];
+				bestSlice = i;
+			}
+		}
+
+		if (bestSlice >= 0)
+		{
+			migration_slice = bestSlice;
+			migration_target = minWorker;
+			migration_barrier = workers_pool[maxWorker].sent_bytes +
+				workers_pool[maxWorker].queue_buf_len;
+		}
+	}
+
+	memset(slice_send_counts, 0, sizeof(uint32) * RECOVERY_HASH_SLICES);
+}
+
 /*
  * Spreads the index modify recovery record to the recovery workers pool.
  *
- * Tuples with a same key will be processed by a same worker. This approach
- * helps to apply recovery records for tuples in the right order.
+ * Tuples with a same key of a same tree will be processed by a same worker.
+ * This approach helps to apply recovery records for tuples in the right
+ * order.  The routed hash is salted with the tree identity: trees with
+ * identical key patterns (e.g. serial integer primary keys) would otherwise
+ * march over the same slices in lockstep and pile onto the same workers.
  */
 static inline void
 spread_idx_modify(BTreeDescr *desc, uint16 recType, OTuple rec, bool wal)
 {
 	OTuple		key PG_USED_FOR_ASSERTS_ONLY;
 	uint32		hash;
-	int			key_len,
+	int			worker_id,
+				key_len,
 				tup_len;
 	bool		key_pfree PG_USED_FOR_ASSERTS_ONLY;
 
@@ -2443,14 +3075,20 @@ spread_idx_modify(BTreeDescr *desc, uint16 recType, OTuple rec, bool wal)
 			if (key_pfree)
 				pfree(key.data);
 #endif
-			worker_send_modify(GET_WORKER_ID(hash), desc,
+			hash = hash_combine(murmurhash32(desc->oids.relnode), hash);
+			worker_id = route_modify_hash(hash);
+			worker_send_modify(worker_id, desc,
 							   recType, rec, tup_len, wal);
+			note_modify_sent(hash, worker_id);
 			break;
 		case RECOVERY_DELETE:
 			key_len = o_btree_len(desc, rec, OKeyLength);
 			hash = o_btree_hash(desc, rec, BTreeKeyNonLeafKey);
-			worker_send_modify(GET_WORKER_ID(hash), desc, recType,
+			hash = hash_combine(murmurhash32(desc->oids.relnode), hash);
+			worker_id = route_modify_hash(hash);
+			worker_send_modify(worker_id, desc, recType,
 							   rec, key_len, wal);
+			note_modify_sent(hash, worker_id);
 			break;
 		default:
 			Assert(false);
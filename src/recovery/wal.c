@@ -19,7 +19,9 @@
 #include "recovery/wal.h"
 #include "tableam/descr.h"
 #include "transam/oxid.h"
+#include "utils/compress.h"
 
+#include "catalog/pg_class.h"
 #include "replication/message.h"
 #include "storage/proc.h"
 
@@ -40,6 +42,7 @@ static void add_xid_wal_record(OXid oxid);
 static void add_rel_wal_record(ORelOids oids, OIndexType type);
 static void flush_local_wal_if_needed(int required_length);
 static inline void add_local_modify(uint8 record_type, OTuple record, OffsetNumber length);
+static bool have_concurrent_commit_in_progress(void);
 
 void
 add_modify_wal_record(uint8 rec_type, BTreeDescr *desc,
@@ -53,6 +56,13 @@ add_modify_wal_record(uint8 rec_type, BTreeDescr *desc,
 	if (OXidIsValid(recovery_oxid))
 		return;
 
+	/* Temporary and unlogged trees are not WAL-logged */
+	if (desc->storageType != BTreeStoragePersistence)
+		return;
+	if (!IS_SYS_TREE_OIDS(oids) &&
+		((OIndexDescr *) desc->arg)->tablePersistence != RELPERSISTENCE_PERMANENT)
+		return;
+
 	if (!IS_SYS_TREE_OIDS(oids) && type == oIndexPrimary)
 	{
 		OIndexDescr *id = (OIndexDescr *) desc->arg;
@@ -125,7 +135,37 @@ wal_commit(OXid oxid)
 
 	if (synchronous_commit > SYNCHRONOUS_COMMIT_OFF ||
 		oxid_needs_wal_flush)
+	{
+		/*
+		 * Group commit: when other backends have commits in flight, wait
+		 * within the configured latency budget so a single XLogFlush() call
+		 * covers several commits.  XLogFlush() exits early if a concurrent
+		 * flush has already covered our position.
+		 */
+		if (group_commit_delay > 0 && have_concurrent_commit_in_progress())
+			pg_usleep(group_commit_delay);
 		XLogFlush(wait_pos);
+	}
+}
+
+/*
+ * Returns whether some other backend has an orioledb commit in progress.
+ */
+static bool
+have_concurrent_commit_in_progress(void)
+{
+	ODBProcData *curProcData = GET_CUR_PROCDATA();
+	int			i;
+
+	for (i = 0; i < max_procs; i++)
+	{
+		if (&oProcData[i] == curProcData)
+			continue;
+		if (pg_atomic_read_u64(&oProcData[i].commitInProgressXlogLocation) !=
+			INVALID_COMMIT_POS)
+			return true;
+	}
+	return false;
 }
 
 void
@@ -388,6 +428,32 @@ flush_local_wal_if_needed(int required_length)
 XLogRecPtr
 log_logical_wal_container(Pointer ptr, int length)
 {
+	/*
+	 * Try to compress the container when it's enabled and the container is
+	 * big enough for the attempt to make sense.  A container that doesn't
+	 * shrink is logged as is: the compressed form must save at least the
+	 * wrapper record size, which o_compress_wal_container() guarantees by
+	 * failing when the output doesn't fit into the given buffer.
+	 */
+	if (wal_compression && length > 2 * sizeof(WALRecContainerCompressed))
+	{
+		static char compressed_buffer[LOCAL_WAL_BUFFER_SIZE];
+		WALRecContainerCompressed *rec = (WALRecContainerCompressed *) compressed_buffer;
+		uint32		rawLength = length;
+		size_t		compressedLength;
+
+		compressedLength = o_compress_wal_container(ptr, length,
+													compressed_buffer + sizeof(*rec),
+													length - sizeof(*rec) - 1);
+		if (compressedLength > 0)
+		{
+			rec->recType = WAL_REC_CONTAINER_COMPRESSED;
+			memcpy(rec->rawLength, &rawLength, sizeof(rawLength));
+			return LogLogicalMessage(ORIOLEDB_WAL_PREFIX, compressed_buffer,
+									 sizeof(*rec) + compressedLength, false);
+		}
+	}
+
 	return LogLogicalMessage(ORIOLEDB_WAL_PREFIX, ptr, length, false);
 }
 
@@ -47,13 +47,16 @@ static void recovery_queue_process(shm_mq_handle *queue, int id);
 static inline Pointer recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id);
 static bool apply_tbl_modify_record(OTableDescr *descr, uint16 type,
 									OTuple p, OXid oxid, CommitSeqNo csn,
-									bool must_modify);
+									bool must_modify, BTreeLocationHint *hint);
 static bool apply_tbl_insert(OTableDescr *descr, OTuple tuple,
-							 OXid oxid, CommitSeqNo csn, bool must_modify);
+							 OXid oxid, CommitSeqNo csn, bool must_modify,
+							 BTreeLocationHint *hint);
 static bool apply_tbl_delete(OTableDescr *descr, OTuple key,
-							 OXid oxid, CommitSeqNo csn, bool must_modify);
+							 OXid oxid, CommitSeqNo csn, bool must_modify,
+							 BTreeLocationHint *hint);
 static bool apply_tbl_update(OTableDescr *descr, OTuple tuple,
-							 OXid oxid, CommitSeqNo csn, bool must_modify);
+							 OXid oxid, CommitSeqNo csn, bool must_modify,
+							 BTreeLocationHint *hint);
 
 typedef struct
 {
@@ -263,6 +266,7 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 	RecoveryMsgHeader *recovery_header;
 	OTableDescr *descr = NULL;
 	OIndexDescr *indexDescr = NULL;
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, InvalidOPageChangeCount};
 	Pointer		data;
 	OIndexType	ix_type;
 	ORelOids	oids = {InvalidOid, InvalidOid, InvalidOid};
@@ -301,6 +305,11 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 					data_pos += sizeof(ORelOids);
 					ix_type = *(data + data_pos);
 					data_pos++;
+
+					/* the leaf hint is only valid within a run on the same tree */
+					hint.blkno = OInvalidInMemoryBlkno;
+					hint.pageChangeCount = InvalidOPageChangeCount;
+
 					if (descr)
 					{
 						table_descr_dec_refcnt(descr);
@@ -334,7 +343,7 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 
 					apply_modify_record(descr, indexDescr,
 										(recovery_header->type & RECOVERY_MODIFY),
-										tuple, false);
+										tuple, false, &hint);
 				}
 				data_pos += tuple_len;
 			}
@@ -395,12 +404,28 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 				update_worker_ptr(id, msg->ptr);
 				data_pos += sizeof(RecoveryMsgRollbackToSavepoint);
 			}
+			else if (recovery_header->type & RECOVERY_APPLY_BRANCHES)
+			{
+				RecoveryMsgApplyBranches *msg;
+
+				msg = (RecoveryMsgApplyBranches *) (data + data_pos);
+				recovery_apply_branches(msg->oxid, msg->undoStack,
+										msg->needsWalFlush);
+				data_pos += sizeof(RecoveryMsgApplyBranches);
+			}
 			else
 			{
 				Assert(false);
 			}
 			data_pos = MAXALIGN(data_pos);
 		}
+
+		/*
+		 * Publish consumption progress only after the received chunk is fully
+		 * applied: the master relies on it to migrate hash slices between
+		 * workers, see route_modify_hash().
+		 */
+		pg_atomic_fetch_add_u64(&recovery_queue_consumed[id], data_size);
 		update_recovery_undo_loc_flush(false, id);
 	}
 	if (descr)
@@ -409,10 +434,15 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 
 /*
  * Apply the modify WAL or XIP record.
+ *
+ * The hint keeps the location of the last modified leaf of the current tree
+ * (of its primary index for table records).  Long runs of records targeting
+ * the same leaf are typical for append workloads, and the hint lets them be
+ * applied without repeating the root-to-leaf descent, see o_btree_modify().
  */
 void
 apply_modify_record(OTableDescr *descr, OIndexDescr *id, uint16 type,
-					OTuple p, bool must_modify)
+					OTuple p, bool must_modify, BTreeLocationHint *hint)
 {
 	OXid		oxid;
 	CommitSeqNo csn;
@@ -429,12 +459,13 @@ apply_modify_record(OTableDescr *descr, OIndexDescr *id, uint16 type,
 	if (descr && toast_consistent)
 	{
 		/* Modify table */
-		success = apply_tbl_modify_record(descr, type, p, oxid, csn, must_modify);
+		success = apply_tbl_modify_record(descr, type, p, oxid, csn,
+										  must_modify, hint);
 	}
 	else
 	{
 		o_btree_load_shmem(&id->desc);
-		success = apply_btree_modify_record(&id->desc, type, p, oxid, csn);
+		success = apply_btree_modify_record(&id->desc, type, p, oxid, csn, hint);
 	}
 
 	/* For now only XIP records must be always applied */
@@ -521,16 +552,16 @@ recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id)
 static bool
 apply_tbl_modify_record(OTableDescr *descr, uint16 type,
 						OTuple p, OXid oxid, CommitSeqNo csn,
-						bool must_modify)
+						bool must_modify, BTreeLocationHint *hint)
 {
 	switch (type)
 	{
 		case RECOVERY_INSERT:
-			return apply_tbl_insert(descr, p, oxid, csn, must_modify);
+			return apply_tbl_insert(descr, p, oxid, csn, must_modify, hint);
 		case RECOVERY_DELETE:
-			return apply_tbl_delete(descr, p, oxid, csn, must_modify);
+			return apply_tbl_delete(descr, p, oxid, csn, must_modify, hint);
 		case RECOVERY_UPDATE:
-			return apply_tbl_update(descr, p, oxid, csn, must_modify);
+			return apply_tbl_update(descr, p, oxid, csn, must_modify, hint);
 		default:
 			Assert(false);
 			elog(ERROR, "Wrong primary index modify record type %d", type);
@@ -540,7 +571,8 @@ apply_tbl_modify_record(OTableDescr *descr, uint16 type,
 
 static bool
 apply_tbl_insert(OTableDescr *descr, OTuple tuple,
-				 OXid oxid, CommitSeqNo csn, bool must_modify)
+				 OXid oxid, CommitSeqNo csn, bool must_modify,
+				 BTreeLocationHint *hint)
 {
 	OBTreeModifyResult modify_result;
 	OBTreeKeyBound keyBound;
@@ -600,7 +632,7 @@ apply_tbl_insert(OTableDescr *descr, OTuple tuple,
 									   cur_tuple, BTreeKeyLeafTuple,
 									   (Pointer) &keyBound, BTreeKeyBound,
 									   oxid, csn, RowLockUpdate,
-									   NULL, &callbackInfo);
+									   primary ? hint : NULL, &callbackInfo);
 
 		if (!(modify_result == OBTreeModifyResultInserted || modify_result == OBTreeModifyResultUpdated)
 			&& must_modify)
@@ -624,7 +656,8 @@ apply_tbl_insert(OTableDescr *descr, OTuple tuple,
 
 static bool
 apply_tbl_delete(OTableDescr *descr, OTuple key,
-				 OXid oxid, CommitSeqNo csn, bool must_modify)
+				 OXid oxid, CommitSeqNo csn, bool must_modify,
+				 BTreeLocationHint *hint)
 {
 	OBTreeModifyResult modify_result;
 	OBTreeKeyBound keyBound;
@@ -660,7 +693,7 @@ apply_tbl_delete(OTableDescr *descr, OTuple key,
 										   nullTup, BTreeKeyNone,
 										   (Pointer) &keyBound, BTreeKeyBound,
 										   oxid, csn, RowLockUpdate,
-										   NULL, &callbackInfo);
+										   hint, &callbackInfo);
 			if (modify_result != OBTreeModifyResultDeleted)
 				return false;
 
@@ -702,7 +735,8 @@ apply_tbl_delete(OTableDescr *descr, OTuple key,
 
 static bool
 apply_tbl_update(OTableDescr *descr, OTuple tuple,
-				 OXid oxid, CommitSeqNo csn, bool must_modify)
+				 OXid oxid, CommitSeqNo csn, bool must_modify,
+				 BTreeLocationHint *hint)
 {
 	OBTreeModifyResult modify_result;
 	OBTreeKeyBound old_key,
@@ -738,7 +772,7 @@ apply_tbl_update(OTableDescr *descr, OTuple tuple,
 										   tuple, BTreeKeyLeafTuple,
 										   NULL, BTreeKeyNone, oxid, csn,
 										   RowLockNoKeyUpdate,
-										   NULL, &callbackInfo);
+										   hint, &callbackInfo);
 			if (modify_result != OBTreeModifyResultUpdated)
 				return false;
 
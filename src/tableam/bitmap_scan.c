@@ -29,6 +29,20 @@
 
 #include <math.h>
 
+/*
+ * A sparse bitmap (up to this many keys) is fetched with batched sorted
+ * point probes of the primary tree instead of a range-skipping sequential
+ * scan, which would read whole leaf pages per matching key.
+ */
+#define O_BITMAP_PROBE_MODE_MAX_TUPLES	1024
+#define O_BITMAP_PROBE_BATCH_SIZE		64
+
+typedef struct OBitmapProbeKey
+{
+	OTuple		tuple;
+	char		data[SizeOfOTupleHeader + sizeof(int64)];
+} OBitmapProbeKey;
+
 typedef struct OBitmapScan
 {
 	OTableDescr *tbl_desc;
@@ -38,6 +52,16 @@ typedef struct OBitmapScan
 	RBTree	   *saved_bitmap;
 	Oid			typeoid;
 	BTreeSeqScan *seq_scan;
+
+	/* Probe mode state, used instead of seq_scan for sparse bitmaps */
+	bool		probeMode;
+	bool		probeExhausted;
+	uint64		probeNextValue;
+	int			probeCount;
+	int			probeIndex;
+	OBitmapProbeKey probeKeys[O_BITMAP_PROBE_BATCH_SIZE];
+	OTuple		probeTuples[O_BITMAP_PROBE_BATCH_SIZE];
+	CommitSeqNo probeCsns[O_BITMAP_PROBE_BATCH_SIZE];
 } OBitmapScan;
 
 static bool o_bitmap_is_range_valid(OTuple low, OTuple high, void *arg);
@@ -349,6 +373,129 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 	return result;
 }
 
+/*
+ * Forms a fixed-format non-leaf key of the single-attribute primary index
+ * from the bitmap value.
+ */
+static void
+o_bitmap_fill_pk_key(OIndexDescr *primary, uint64 value, Pointer buf,
+					 OTuple *tuple)
+{
+	FormData_pg_attribute *attr = TupleDescAttr(primary->nonLeafTupdesc, 0);
+	OTupleHeader tuphdr = (OTupleHeader) buf;
+
+	Assert(primary->nFields == 1);
+	tuphdr->hasnulls = false;
+	tuphdr->natts = 1;
+	tuphdr->len = SizeOfOTupleHeader + attr->attlen;
+	uint64_get_val(value, attr->atttypid, buf + SizeOfOTupleHeader);
+	tuple->data = buf;
+	tuple->formatFlags = 0;
+}
+
+/*
+ * Check whether the bitmap holds at most O_BITMAP_PROBE_MODE_MAX_TUPLES
+ * keys, so the probe mode pays off.
+ */
+static bool
+o_bitmap_is_sparse(RBTree *bitmap)
+{
+	uint64		value = 0;
+	bool		found;
+	int			count = 0;
+
+	while (true)
+	{
+		value = o_keybitmap_get_next(bitmap, value, &found);
+		if (!found)
+			break;
+		if (++count > O_BITMAP_PROBE_MODE_MAX_TUPLES)
+			return false;
+		if (value == UINT64_MAX)
+			break;
+		value++;
+	}
+	return true;
+}
+
+/*
+ * Load the next batch of bitmap keys and probe the primary tree for them in
+ * one sorted pass.
+ */
+static void
+o_bitmap_probe_refill(OBitmapScan *scan, MemoryContext tupleCxt)
+{
+	OIndexDescr *primary = GET_PRIMARY(scan->tbl_desc);
+	void	   *keys[O_BITMAP_PROBE_BATCH_SIZE];
+	int			n = 0;
+
+	scan->probeIndex = 0;
+	scan->probeCount = 0;
+	if (scan->probeExhausted)
+		return;
+
+	while (n < O_BITMAP_PROBE_BATCH_SIZE)
+	{
+		uint64		value;
+		bool		found;
+
+		value = o_keybitmap_get_next(scan->saved_bitmap,
+									 scan->probeNextValue, &found);
+		if (!found)
+		{
+			scan->probeExhausted = true;
+			break;
+		}
+		o_bitmap_fill_pk_key(primary, value,
+							 scan->probeKeys[n].data,
+							 &scan->probeKeys[n].tuple);
+		keys[n] = &scan->probeKeys[n].tuple;
+		n++;
+		if (value == UINT64_MAX)
+		{
+			scan->probeExhausted = true;
+			break;
+		}
+		scan->probeNextValue = value + 1;
+	}
+
+	if (n > 0)
+		(void) o_btree_find_tuples_batch(&primary->desc, keys,
+										 BTreeKeyNonLeafKey, n, scan->csn,
+										 scan->probeCsns, tupleCxt,
+										 scan->probeTuples);
+	scan->probeCount = n;
+}
+
+static OTuple
+o_bitmap_probe_getnext(OBitmapScan *scan, MemoryContext tupleCxt,
+					   CommitSeqNo *tupleCsn)
+{
+	OTuple		tuple;
+
+	while (true)
+	{
+		int			i;
+
+		if (scan->probeIndex >= scan->probeCount)
+		{
+			o_bitmap_probe_refill(scan, tupleCxt);
+			if (scan->probeCount == 0)
+				break;
+		}
+
+		i = scan->probeIndex++;
+		if (!O_TUPLE_IS_NULL(scan->probeTuples[i]))
+		{
+			*tupleCsn = scan->probeCsns[i];
+			return scan->probeTuples[i];
+		}
+	}
+
+	O_TUPLE_SET_NULL(tuple);
+	return tuple;
+}
+
 OBitmapScan *
 o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 				   PlanState *bitmapqualplanstate, Relation rel,
@@ -367,8 +514,11 @@ o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 	scan->saved_bitmap = o_exec_bitmapqual(bitmap_state, bitmapqualplanstate);
 	primary = &GET_PRIMARY(scan->tbl_desc)->desc;
 	o_btree_load_shmem(primary);
-	scan->seq_scan = make_btree_seq_scan_cb(primary, scan->csn,
-											&bitmap_seq_scan_callbacks, scan);
+	scan->probeMode = o_bitmap_is_sparse(scan->saved_bitmap);
+	if (!scan->probeMode)
+		scan->seq_scan = make_btree_seq_scan_cb(primary, scan->csn,
+												&bitmap_seq_scan_callbacks,
+												scan);
 	return scan;
 }
 
@@ -385,8 +535,15 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 		MemoryContext tupleCxt = node->ss.ss_ScanTupleSlot->tts_mcxt;
 		CommitSeqNo tupleCsn;
 
-		tuple = btree_seq_scan_getnext(scan->seq_scan, tupleCxt, &tupleCsn,
-									   &hint);
+		if (scan->probeMode)
+		{
+			tuple = o_bitmap_probe_getnext(scan, tupleCxt, &tupleCsn);
+			hint.blkno = OInvalidInMemoryBlkno;
+			hint.pageChangeCount = InvalidOPageChangeCount;
+		}
+		else
+			tuple = btree_seq_scan_getnext(scan->seq_scan, tupleCxt, &tupleCsn,
+										   &hint);
 
 		if (O_TUPLE_IS_NULL(tuple))
 		{
@@ -401,7 +558,9 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 			descr = relation_get_descr(node->ss.ss_currentRelation);
 			value = primary_tuple_get_data(tuple, GET_PRIMARY(descr), false);
 
-			if (o_keybitmap_test(scan->saved_bitmap, value))
+			/* probed tuples are fetched by exact bitmap keys */
+			if (scan->probeMode ||
+				o_keybitmap_test(scan->saved_bitmap, value))
 			{
 				TupleTableSlot *scan_slot;
 				MemoryContext oldcxt;
@@ -436,7 +595,8 @@ o_exec_bitmap_fetch(OBitmapScan *scan, CustomScanState *node)
 void
 o_free_bitmap_scan(OBitmapScan *scan)
 {
-	free_btree_seq_scan(scan->seq_scan);
+	if (scan->seq_scan)
+		free_btree_seq_scan(scan->seq_scan);
 	o_keybitmap_free(scan->saved_bitmap);
 	pfree(scan);
 }
@@ -470,7 +630,6 @@ o_bitmap_get_next_key(OFixedKey *key, bool inclusive, void *arg)
 	bool		found;
 	uint64		prev_value = 0;
 	uint64		res_value;
-	OTupleHeader tuphdr;
 	OIndexDescr *primary = GET_PRIMARY(bitmap_scan->tbl_desc);
 
 	if (!O_TUPLE_IS_NULL(key->tuple))
@@ -489,18 +648,7 @@ o_bitmap_get_next_key(OFixedKey *key, bool inclusive, void *arg)
 
 	if (found)
 	{
-		FormData_pg_attribute *attr = TupleDescAttr(primary->nonLeafTupdesc, 0);
-
-		Assert(primary->nFields == 1);
-		tuphdr = (OTupleHeader) key->fixedData;
-		tuphdr->hasnulls = false;
-		tuphdr->natts = 1;
-		tuphdr->len = SizeOfOTupleHeader + attr->attlen;
-		uint64_get_val(res_value,
-					   attr->atttypid,
-					   &key->fixedData[SizeOfOTupleHeader]);
-		key->tuple.data = key->fixedData;
-		key->tuple.formatFlags = 0;
+		o_bitmap_fill_pk_key(primary, res_value, key->fixedData, &key->tuple);
 	}
 	else
 	{
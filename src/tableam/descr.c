@@ -29,6 +29,7 @@
 #include "tableam/tree.h"
 #include "tuple/slot.h"
 #include "transam/undo.h"
+#include "utils/compress.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 
@@ -39,10 +40,12 @@
 #include "miscadmin.h"
 #include "parser/parse_coerce.h"
 #include "utils/builtins.h"
+#include "utils/fmgroids.h"
 #include "utils/fmgrtab.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
+#include "utils/uuid.h"
 #include "pgstat.h"
 
 static OIndexDescr *get_index_descr(ORelOids ixOids, OIndexType ixType,
@@ -79,10 +82,20 @@ struct OComparator
 	FmgrInfo	finfo;
 
 	/* Filled when haveSortSupport == true */
-	MemoryContext ssup_cxt;
-	Oid			ssup_collation;
-	void	   *ssup_extra;
-	int			(*ssup_comparator) (Datum x, Datum y, SortSupport ssup);
+	SortSupportData ssup;
+	FmgrInfo	ssup_finfo;
+
+	/*
+	 * Ready-to-use call info for the plain comparison function, prepared
+	 * once when the comparator is cached, so o_call_comparator() doesn't
+	 * re-initialize it on every comparison.  Valid when haveSortSupport ==
+	 * false.
+	 */
+	union
+	{
+		FunctionCallInfoBaseData fcinfo;
+		char		fcinfo_data[SizeForFunctionCallInfo(2)];
+	}			fc;
 };
 
 static HTAB *oTableDescrHash;
@@ -197,7 +210,15 @@ o_btree_load_shmem(BTreeDescr *desc)
 		sharedRootInfo = create_shared_root_info(desc->ppool, &key);
 		desc->rootInfo = sharedRootInfo->rootInfo;
 
-		checkpointable_tree_init(desc, true, &was_evicted);
+		if (desc->storageType == BTreeStoragePersistence)
+		{
+			checkpointable_tree_init(desc, true, &was_evicted);
+		}
+		else
+		{
+			evictable_tree_init(desc, true);
+			was_evicted = false;
+		}
 		is_compressed = OCompressIsValid(desc->compress);
 		desc->rootInfo = sharedRootInfo->rootInfo;
 
@@ -246,7 +267,10 @@ o_btree_load_shmem(BTreeDescr *desc)
 		Assert(OInMemoryBlknoIsValid(sharedRootInfo->rootInfo.metaPageBlkno));
 
 		desc->rootInfo = sharedRootInfo->rootInfo;
-		(void) checkpointable_tree_init(desc, false, NULL);
+		if (desc->storageType == BTreeStoragePersistence)
+			(void) checkpointable_tree_init(desc, false, NULL);
+		else
+			evictable_tree_init(desc, false);
 	}
 
 	if (hasLock)
@@ -284,7 +308,10 @@ o_btree_try_use_shmem(BTreeDescr *desc)
 
 		desc->rootInfo = shared->rootInfo;
 
-		(void) checkpointable_tree_init(desc, false, NULL);
+		if (desc->storageType == BTreeStoragePersistence)
+			(void) checkpointable_tree_init(desc, false, NULL);
+		else
+			evictable_tree_init(desc, false);
 		pfree(shared);
 	}
 	return true;
@@ -357,6 +384,11 @@ index_descr_free(OIndexDescr *tree)
 	{
 		MemoryContextDelete(tree->index_mctx);
 	}
+	if (tree->desc.compressDict)
+	{
+		o_compress_dict_free(tree->desc.compressDict);
+		tree->desc.compressDict = NULL;
+	}
 	checkpointable_tree_free(&tree->desc);
 }
 
@@ -655,7 +687,7 @@ cleanup_shared_root_info_pages(OPagePool *pool, SharedRootInfo *sharedRootInfo)
 					bufnum;
 		BTreeMetaPage *meta_page = (BTreeMetaPage *) O_GET_IN_MEMORY_PAGE(rootInfo->metaPageBlkno);
 
-		for (blkno = 0; blkno < 2; blkno++)
+		for (blkno = 0; blkno < SEQ_BUF_PAGES; blkno++)
 		{
 			FREE_PAGE_IF_VALID(pool, meta_page->freeBuf.pages[blkno]);
 			for (bufnum = 0; bufnum < 2; bufnum++)
@@ -693,7 +725,7 @@ init_shared_root_info(OPagePool *pool, SharedRootInfo *sharedRootInfo)
 	}
 
 	meta_page = (BTreeMetaPage *) O_GET_IN_MEMORY_PAGE(rootInfo->metaPageBlkno);
-	for (blkno = 0; blkno < 2; blkno++)
+	for (blkno = 0; blkno < SEQ_BUF_PAGES; blkno++)
 	{
 		meta_page->freeBuf.pages[blkno] = OInvalidInMemoryBlkno;
 		for (bufnum = 0; bufnum < 2; bufnum++)
@@ -714,6 +746,7 @@ o_invalidate_descrs(Oid datoid, Oid reloid, Oid relfilenode)
 	if (!OidIsValid(datoid) || !OidIsValid(reloid) || !OidIsValid(relfilenode))
 	{
 		Assert(!OidIsValid(datoid) && !OidIsValid(reloid) && !OidIsValid(relfilenode));
+		o_tables_cache_invalidate_all();
 		hash_seq_init(&scan_status, oTableDescrHash);
 		while ((tableDescr = (OTableDescr *) hash_seq_search(&scan_status)) != NULL)
 		{
@@ -740,6 +773,7 @@ o_invalidate_descrs(Oid datoid, Oid reloid, Oid relfilenode)
 		ORelOids	oids = {datoid, reloid, relfilenode};
 		bool		found;
 
+		o_tables_cache_invalidate(oids);
 		tableDescr = hash_search(oTableDescrHash, &oids, HASH_FIND, &found);
 		if (found)
 		{
@@ -968,6 +1002,110 @@ o_find_toastable_attrs(OTableDescr *tableDescr)
 	}
 }
 
+/*
+ * Comparison functions specialized for common built-in key types.  They
+ * implement exactly the same ordering as the corresponding btree opclass
+ * support procedures, but are called directly, without fmgr or sort support
+ * dispatch.
+ */
+static int
+o_fast_cmp_int2(Datum left, Datum right)
+{
+	int16		lval = DatumGetInt16(left);
+	int16		rval = DatumGetInt16(right);
+
+	if (lval > rval)
+		return 1;
+	else if (lval == rval)
+		return 0;
+	else
+		return -1;
+}
+
+static int
+o_fast_cmp_int4(Datum left, Datum right)
+{
+	int32		lval = DatumGetInt32(left);
+	int32		rval = DatumGetInt32(right);
+
+	if (lval > rval)
+		return 1;
+	else if (lval == rval)
+		return 0;
+	else
+		return -1;
+}
+
+static int
+o_fast_cmp_int8(Datum left, Datum right)
+{
+	int64		lval = DatumGetInt64(left);
+	int64		rval = DatumGetInt64(right);
+
+	if (lval > rval)
+		return 1;
+	else if (lval == rval)
+		return 0;
+	else
+		return -1;
+}
+
+static int
+o_fast_cmp_oid(Datum left, Datum right)
+{
+	Oid			lval = DatumGetObjectId(left);
+	Oid			rval = DatumGetObjectId(right);
+
+	if (lval > rval)
+		return 1;
+	else if (lval == rval)
+		return 0;
+	else
+		return -1;
+}
+
+static int
+o_fast_cmp_uuid(Datum left, Datum right)
+{
+	return memcmp(DatumGetUUIDP(left), DatumGetUUIDP(right), UUID_LEN);
+}
+
+/*
+ * Return the specialized comparison function matching the ordering of the
+ * given btree comparison procedure, NULL if there is none.  Matching on the
+ * procedure oid guarantees we only shortcut opclasses with the built-in
+ * semantics, custom opclasses over the same types keep the generic path.
+ */
+static OFastComparator
+o_find_fast_comparator(Oid cmpOid)
+{
+	switch (cmpOid)
+	{
+		case F_BTINT2CMP:
+			return o_fast_cmp_int2;
+		case F_BTINT4CMP:
+			return o_fast_cmp_int4;
+		case F_BTINT8CMP:
+			return o_fast_cmp_int8;
+		case F_BTOIDCMP:
+			return o_fast_cmp_oid;
+		case F_UUID_CMP:
+			return o_fast_cmp_uuid;
+
+			/*
+			 * DateADT and Timestamp[Tz] order exactly as their underlying
+			 * int32/int64 representations.
+			 */
+		case F_DATE_CMP:
+			return o_fast_cmp_int4;
+		case F_TIMESTAMP_CMP:
+		case F_TIMESTAMPTZ_CMP:
+			return o_fast_cmp_int8;
+		default:
+			return NULL;
+	}
+}
+
 /* fills field opclass fields and finds comparator for it */
 void
 oFillFieldOpClassAndComparator(OIndexField *field, Oid datoid, Oid opclassoid)
@@ -978,6 +1116,7 @@ oFillFieldOpClassAndComparator(OIndexField *field, Oid datoid, Oid opclassoid)
 	field->inputtype = opclass->inputtype;
 	field->opfamily = opclass->opfamily;
 	field->comparator = o_find_opclass_comparator(opclass, field->collation);
+	field->fastCmp = o_find_fast_comparator(opclass->cmpOid);
 
 	Assert(field->comparator != NULL);
 }
@@ -1027,10 +1166,8 @@ o_find_comparator(Oid opfamily, Oid lefttype, Oid righttype, Oid collation)
 		if (ssup.comparator != NULL)
 		{
 			comparator.haveSortSupport = true;
-			comparator.ssup_cxt = ssup.ssup_cxt;
-			comparator.ssup_collation = ssup.ssup_collation;
-			comparator.ssup_extra = ssup.ssup_extra;
-			comparator.ssup_comparator = ssup.comparator;
+			comparator.ssup = ssup;
+			fmgr_info(procOid, &comparator.ssup_finfo);
 		}
 	}
 
@@ -1111,10 +1248,8 @@ o_find_opclass_comparator(OOpclass *opclass, Oid collation)
 		if (ssup.comparator != NULL)
 		{
 			comparator.haveSortSupport = true;
-			comparator.ssup_cxt = ssup.ssup_cxt;
-			comparator.ssup_collation = ssup.ssup_collation;
-			comparator.ssup_extra = ssup.ssup_extra;
-			comparator.ssup_comparator = ssup.comparator;
+			comparator.ssup = ssup;
+			memcpy(&comparator.ssup_finfo, &finfo, sizeof(FmgrInfo));
 		}
 	}
 
@@ -1168,6 +1303,18 @@ o_add_comparator_to_cache(OComparator *comparator)
 	cached = hash_search(comparatorCache, &comparator->key, HASH_ENTER, NULL);
 	memcpy(cached, comparator, sizeof(OComparator));
 
+	/*
+	 * The entry address is stable, so the call info can reference the cached
+	 * FmgrInfo and be reused by every o_call_comparator() call.
+	 */
+	if (!cached->haveSortSupport)
+	{
+		InitFunctionCallInfoData(cached->fc.fcinfo, &cached->finfo, 2,
+								 cached->key.collation, NULL, NULL);
+		cached->fc.fcinfo.args[0].isnull = false;
+		cached->fc.fcinfo.args[1].isnull = false;
+	}
+
 	memcpy(&lastkey, &comparator->key, sizeof(OComparatorKey));
 	lastcmp = cached;
 
@@ -1181,22 +1328,17 @@ o_call_comparator(OComparator *comparator, Datum left, Datum right)
 
 	if (comparator->haveSortSupport)
 	{
-		SortSupportData ssup;
-
-		memset(&ssup, 0, sizeof(ssup));
-		ssup.ssup_cxt = comparator->ssup_cxt;
-		ssup.ssup_collation = comparator->ssup_collation;
-		ssup.ssup_extra = comparator->ssup_extra;
-		ssup.abbreviate = false;
-		ret = comparator->ssup_comparator(left, right, &ssup);
-		comparator->ssup_extra = ssup.ssup_extra;
+		ret = comparator->ssup.comparator(left, right, &comparator->ssup);
 	}
 	else
 	{
+		FunctionCallInfo fcinfo = &comparator->fc.fcinfo;
 		Datum		cmp;
 
-		cmp = FunctionCall2Coll(&comparator->finfo,
-								comparator->key.collation, left, right);
+		fcinfo->args[0].value = left;
+		fcinfo->args[1].value = right;
+		fcinfo->isnull = false;
+		cmp = FunctionCallInvoke(fcinfo);
 		ret = DatumGetInt32(cmp);
 	}
 
@@ -1208,8 +1350,8 @@ o_finish_sort_support_function(OComparator *comparator, SortSupport ssup)
 {
 	if (comparator->haveSortSupport)
 	{
-		ssup->comparator = comparator->ssup_comparator;
-		ssup->ssup_extra = comparator->ssup_extra;
+		ssup->comparator = comparator->ssup.comparator;
+		ssup->ssup_extra = comparator->ssup.ssup_extra;
 	}
 	else
 	{
@@ -1231,6 +1373,28 @@ o_finish_sort_support_function(OComparator *comparator, SortSupport ssup)
 	}
 }
 
+/*
+ * Like o_finish_sort_support_function(), but lets the opclass sort support
+ * function fill the whole SortSupport.  This way it can install the
+ * abbreviated key machinery for the leading sort column, so the sort inner
+ * loop compares datums and only falls back to the full comparator on ties.
+ * Falls back to the cached comparator when the opclass has no sort support
+ * function.
+ */
+void
+o_finish_sort_support_function_abbrev(OComparator *comparator, SortSupport ssup)
+{
+	if (comparator->haveSortSupport)
+	{
+		FunctionCall1(&comparator->ssup_finfo, PointerGetDatum(ssup));
+		if (ssup->comparator != NULL)
+			return;
+	}
+
+	ssup->abbreviate = false;
+	o_finish_sort_support_function(comparator, ssup);
+}
+
 void
 o_tableam_descr_init(void)
 {
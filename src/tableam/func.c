@@ -13,6 +13,8 @@
 
 #include "postgres.h"
 
+#include <math.h>
+
 #include "orioledb.h"
 
 #include "btree/btree.h"
@@ -20,10 +22,13 @@
 #include "btree/io.h"
 #include "btree/iterator.h"
 #include "btree/page_chunks.h"
+#include "btree/scan.h"
 #include "catalog/indices.h"
 #include "tableam/toast.h"
 #include "tuple/format.h"
 #include "utils/compress.h"
+#include "utils/o_latency.h"
+#include "utils/page_pool.h"
 
 #include "pgstat.h"
 #include "access/genam.h"
@@ -31,20 +36,28 @@
 #include "access/table.h"
 #include "catalog/pg_type_d.h"
 #include "miscadmin.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
 
 PG_FUNCTION_INFO_V1(orioledb_tbl_structure);
 PG_FUNCTION_INFO_V1(orioledb_idx_structure);
 PG_FUNCTION_INFO_V1(orioledb_tbl_check);
+PG_FUNCTION_INFO_V1(orioledb_tbl_structure_check);
 PG_FUNCTION_INFO_V1(orioledb_compression_max_level);
 PG_FUNCTION_INFO_V1(orioledb_tbl_compression_check);
+PG_FUNCTION_INFO_V1(orioledb_tbl_compression_dict_train);
 PG_FUNCTION_INFO_V1(orioledb_tbl_indices);
 PG_FUNCTION_INFO_V1(orioledb_relation_size);
 PG_FUNCTION_INFO_V1(orioledb_tbl_are_indices_equal);
 PG_FUNCTION_INFO_V1(orioledb_table_pages);
+PG_FUNCTION_INFO_V1(orioledb_tbl_export);
+PG_FUNCTION_INFO_V1(orioledb_tree_stat);
+PG_FUNCTION_INFO_V1(orioledb_latency_stats);
+PG_FUNCTION_INFO_V1(orioledb_buffer_stats);
 
 extern void log_btree(BTreeDescr *desc);
 
@@ -604,6 +617,278 @@ orioledb_table_pages(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Appends a batch row to the result: the raw buffer compressed into a bytea
+ * plus the batch metadata.  Resets the raw buffer for the next batch.
+ */
+static void
+tbl_export_emit_batch(Tuplestorestate *tupstore, TupleDesc tupdesc,
+					  int64 batchNum, int32 nrows, StringInfo raw,
+					  OCompress lvl)
+{
+	Datum		values[4];
+	bool		nulls[4] = {false, false, false, false};
+	size_t		bound = o_compress_bound(raw->len);
+	size_t		size;
+	bytea	   *data;
+
+	data = (bytea *) palloc(VARHDRSZ + bound);
+	size = o_compress_row_batch(raw->data, raw->len,
+								VARDATA(data), bound, lvl);
+	SET_VARSIZE(data, VARHDRSZ + size);
+
+	values[0] = Int64GetDatum(batchNum);
+	values[1] = Int32GetDatum(nrows);
+	values[2] = Int64GetDatum((int64) raw->len);
+	values[3] = PointerGetDatum(data);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	pfree(data);
+	resetStringInfo(raw);
+}
+
+/*
+ * Exports the visible rows of an OrioleDB table as compressed binary row
+ * batches.
+ *
+ * Each batch is a zstd frame over concatenated raw primary index leaf
+ * tuples: one byte of format flags, four bytes of tuple length, then the
+ * tuple body exactly as stored in the tree.  No per-tuple datum conversion
+ * is involved and TOASTed values are exported as in-tree references, so the
+ * consumer has to understand the orioledb tuple format.  Intended for
+ * high-throughput copies like change-data-capture bootstrap, where the text
+ * protocol is the bottleneck.
+ */
+Datum
+orioledb_tbl_export(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			relid = PG_GETARG_OID(0);
+	int32		batchRows = PG_GETARG_INT32(1);
+	int32		lvl = PG_GETARG_INT32(2);
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	Relation	rel;
+	OTableDescr *descr;
+	OIndexDescr *primary;
+	BTreeSeqScan *scan;
+	StringInfoData raw;
+	AttrNumber	attnum;
+	int64		batchNum = 0;
+	int32		nrows = 0;
+
+	orioledb_check_shmem();
+
+	if (batchRows <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("batch_rows must be a positive integer")));
+	if (lvl < 1 || lvl > o_compress_max_lvl())
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("compression_level must be in the range [1, %d]",
+						o_compress_max_lvl())));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(4);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "batch", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "nrows", INT4OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "raw_length", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "data", BYTEAOID, -1, 0);
+	attnum++;
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	rel = relation_open(relid, AccessShareLock);
+	descr = relation_get_descr(rel);
+
+	if (!descr)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("relation oid %u is not orioledb", relid)));
+
+	primary = GET_PRIMARY(descr);
+	o_btree_load_shmem(&primary->desc);
+
+	scan = make_btree_seq_scan(&primary->desc,
+							   GetActiveSnapshot()->snapshotcsn, NULL);
+	initStringInfo(&raw);
+
+	while (true)
+	{
+		OTuple		tuple;
+		CommitSeqNo tupleCsn;
+		BTreeLocationHint hint;
+		uint32		tupleLen;
+
+		tuple = btree_seq_scan_getnext(scan, CurrentMemoryContext,
+									   &tupleCsn, &hint);
+		if (O_TUPLE_IS_NULL(tuple))
+			break;
+
+		tupleLen = o_tuple_size(tuple, &primary->leafSpec);
+		appendStringInfoChar(&raw, tuple.formatFlags);
+		appendBinaryStringInfo(&raw, (char *) &tupleLen, sizeof(tupleLen));
+		appendBinaryStringInfo(&raw, tuple.data, tupleLen);
+		pfree(tuple.data);
+
+		if (++nrows == batchRows)
+		{
+			tbl_export_emit_batch(tupstore, tupdesc, batchNum, nrows,
+								  &raw, lvl);
+			batchNum++;
+			nrows = 0;
+		}
+	}
+
+	if (nrows > 0)
+		tbl_export_emit_batch(tupstore, tupdesc, batchNum, nrows, &raw, lvl);
+
+	free_btree_seq_scan(scan);
+	pfree(raw.data);
+	relation_close(rel, AccessShareLock);
+	return (Datum) 0;
+}
+
+/*
+ * Returns the hot-path counters of every tree of an OrioleDB table.  The
+ * counters accumulate since the tree meta page was initialized and are never
+ * reset, so monitoring should diff subsequent snapshots.
+ */
+Datum
+orioledb_tree_stat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			relid = PG_GETARG_OID(0);
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	Relation	rel;
+	OTableDescr *descr;
+	int			treen;
+	AttrNumber	attnum;
+
+	orioledb_check_shmem();
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(10);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "name", TEXTOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "lock_acquires", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "lock_waits", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "splits", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "merges", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "evictions", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "write_bytes_raw", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "write_bytes_compressed", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "read_retries", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "read_lock_fallbacks", INT8OID, -1, 0);
+	attnum++;
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	rel = relation_open(relid, AccessShareLock);
+	descr = relation_get_descr(rel);
+
+	if (!descr)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("relation oid %u is not orioledb", relid)));
+
+	for (treen = 0; treen < descr->nIndices + 1; treen++)
+	{
+		BTreeDescr *td;
+		BTreeMetaPage *meta;
+		BTreeTreeStats *stats;
+		Datum		values[10];
+		bool		nulls[10] = {false};
+		char	   *name;
+
+		if (treen < descr->nIndices)
+		{
+			td = &descr->indices[treen]->desc;
+			name = descr->indices[treen]->name.data;
+		}
+		else
+		{
+			td = &descr->toast->desc;
+			name = "toast";
+		}
+
+		o_btree_load_shmem(td);
+		meta = BTREE_GET_META(td);
+		stats = &meta->stats;
+
+		values[0] = PointerGetDatum(cstring_to_text(name));
+		values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->lockAcquires));
+		values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->lockWaits));
+		values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->splits));
+		values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->merges));
+		values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->evictions));
+		values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->writeBytesRaw));
+		values[7] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->writeBytesCompressed));
+		values[8] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->readRetries));
+		values[9] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->readLockFallbacks));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	relation_close(rel, AccessShareLock);
+	return (Datum) 0;
+}
+
 Datum
 orioledb_tbl_are_indices_equal(PG_FUNCTION_ARGS)
 {
@@ -730,6 +1015,50 @@ orioledb_tbl_check(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(result);
 }
 
+Datum
+orioledb_tbl_structure_check(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int32		nworkers = PG_GETARG_INT32(1);
+	float8		sample_ratio = PG_GETARG_FLOAT8(2);
+	Relation	rel;
+	OTableDescr *descr;
+	bool		result = true;
+	int			i;
+
+	orioledb_check_shmem();
+
+	if (sample_ratio <= 0.0 || sample_ratio > 1.0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("sample_ratio must be in the range (0.0, 1.0]")));
+
+	/*
+	 * ExclusiveLock keeps the trees unchanged, so the participants see the
+	 * subtrees in the same order
+	 */
+	rel = relation_open(relid, AccessExclusiveLock);
+	descr = relation_get_descr(rel);
+
+	if (!descr)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("relation oid %u is not orioledb", relid)));
+
+	for (i = 0; i < descr->nIndices; i++)
+	{
+		o_btree_load_shmem(&descr->indices[i]->desc);
+		result = check_btree_structure(&descr->indices[i]->desc, nworkers,
+									   sample_ratio);
+
+		if (result == false)
+			break;
+	}
+	relation_close(rel, AccessExclusiveLock);
+
+	PG_RETURN_BOOL(result);
+}
+
 Datum
 orioledb_compression_max_level(PG_FUNCTION_ARGS)
 {
@@ -884,6 +1213,141 @@ orioledb_tbl_compression_check(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(cstring_to_text(result.data));
 }
 
+/*
+ * Trains a compression dictionary for every compressed tree of the table and
+ * stores it next to the tree data files.  Newly written pages of the trees
+ * are compressed with the dictionary; the already written pages stay
+ * readable.  Re-training is forbidden: pages compressed with the existing
+ * dictionary would become unreadable.
+ */
+Datum
+orioledb_tbl_compression_dict_train(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			relid = PG_GETARG_OID(0);
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	Relation	rel;
+	OTableDescr *descr;
+	int			treen;
+	AttrNumber	attnum;
+	Pointer		dictBuffer;
+
+	orioledb_check_shmem();
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(2);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "name", TEXTOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "dict_size", INT8OID, -1, 0);
+	attnum++;
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * The exclusive lock keeps concurrent backends from writing
+	 * dictionary-compressed pages before they picked the dictionary up.
+	 */
+	rel = relation_open(relid, AccessExclusiveLock);
+	descr = relation_get_descr(rel);
+
+	if (!descr)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("relation oid %u is not orioledb", relid)));
+
+	dictBuffer = palloc(O_COMPRESS_DICT_SIZE);
+
+	for (treen = 0; treen < descr->nIndices + 1; treen++)
+	{
+		BTreeDescr *td;
+		const char *treeName;
+		char	   *filename;
+		File		file;
+		size_t		dictSize;
+		Datum		values[2];
+		bool		nulls[2] = {false};
+
+		if (treen < descr->nIndices)
+		{
+			td = &descr->indices[treen]->desc;
+			treeName = descr->indices[treen]->name.data;
+		}
+		else
+		{
+			td = &descr->toast->desc;
+			treeName = "toast";
+		}
+
+		if (!OCompressIsValid(td->compress))
+			continue;
+
+		filename = o_compress_dict_filename(td->oids);
+		file = PathNameOpenFile(filename, O_RDONLY | PG_BINARY);
+		if (file >= 0)
+		{
+			FileClose(file);
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("compression dictionary file %s already exists",
+							filename),
+					 errdetail("Pages compressed with the existing dictionary would become unreadable if it was replaced.")));
+		}
+
+		dictSize = train_btree_compression_dict(td, dictBuffer,
+												O_COMPRESS_DICT_SIZE);
+
+		file = PathNameOpenFile(filename, O_WRONLY | O_CREAT | PG_BINARY);
+		if (file < 0 ||
+			OFileWrite(file, dictBuffer, dictSize, 0,
+					   WAIT_EVENT_DATA_FILE_WRITE) != dictSize)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write compression dictionary file %s",
+							filename)));
+		FileClose(file);
+		pfree(filename);
+
+		/* this backend starts using the dictionary at once */
+		if (td->compressDict == NULL)
+			td->compressDict = o_compress_dict_load(td->oids, td->compress);
+		o_invalidate_oids(td->oids);
+
+		values[0] = PointerGetDatum(cstring_to_text(treeName));
+		values[1] = Int64GetDatum((int64) dictSize);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	pfree(dictBuffer);
+
+	/* other backends rebuild descriptors and pick the dictionaries up */
+	o_invalidate_oids(descr->oids);
+
+	relation_close(rel, AccessExclusiveLock);
+	return (Datum) 0;
+}
+
 Datum
 orioledb_tbl_indices(PG_FUNCTION_ARGS)
 {
@@ -977,3 +1441,208 @@ orioledb_relation_size(PG_FUNCTION_ARGS)
 	relation_close(rel, AccessShareLock);
 	PG_RETURN_INT64(result);
 }
+
+/*
+ * Report the merged latency histograms collected while
+ * orioledb.track_latencies is on: one row per operation type with the
+ * number of operations and the p50/p99/p999 durations in microseconds.
+ */
+Datum
+orioledb_latency_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	AttrNumber	attnum;
+	int			op;
+
+	orioledb_check_shmem();
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(5);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "operation", TEXTOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "count", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "p50", FLOAT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "p99", FLOAT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "p999", FLOAT8OID, -1, 0);
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (op = 0; op < OLatencyOperationsCount; op++)
+	{
+		uint64		buckets[O_LATENCY_BUCKETS];
+		uint64		total = 0;
+		static const double percentiles[] = {0.50, 0.99, 0.999};
+		double		values_out[3] = {0.0, 0.0, 0.0};
+		Datum		values[5];
+		bool		nulls[5] = {false, false, false, false, false};
+		int			i,
+					bucket;
+
+		o_latency_merged_histogram((OLatencyOperation) op, buckets);
+
+		for (bucket = 0; bucket < O_LATENCY_BUCKETS; bucket++)
+			total += buckets[bucket];
+
+		if (total == 0)
+		{
+			nulls[2] = nulls[3] = nulls[4] = true;
+		}
+		else
+		{
+			for (i = 0; i < 3; i++)
+			{
+				uint64		target;
+				uint64		cumulative = 0;
+
+				target = (uint64) ceil((double) total * percentiles[i]);
+				if (target < 1)
+					target = 1;
+
+				for (bucket = 0; bucket < O_LATENCY_BUCKETS; bucket++)
+				{
+					cumulative += buckets[bucket];
+					if (cumulative >= target)
+						break;
+				}
+				values_out[i] = o_latency_bucket_value(Min(bucket, O_LATENCY_BUCKETS - 1));
+			}
+		}
+
+		values[0] = PointerGetDatum(cstring_to_text(o_latency_operation_name((OLatencyOperation) op)));
+		values[1] = Int64GetDatum((int64) total);
+		values[2] = Float8GetDatum(values_out[0]);
+		values[3] = Float8GetDatum(values_out[1]);
+		values[4] = Float8GetDatum(values_out[2]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Report per-pool buffer pressure: occupancy and dirty counts, the clock
+ * replacement counters split by initiator (foreground backends vs the
+ * background writers), and the distribution of page usage counts relative
+ * to the current UCM epoch (usage_histogram[1] is the coldest level, the
+ * last element the hottest).  The counters are monotonic; sample the view
+ * periodically to get rates.  watermark_pages is the current adaptive free
+ * pages watermark, see ppool_adjust_watermarks().
+ */
+Datum
+orioledb_buffer_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	AttrNumber	attnum;
+	int			i;
+
+	orioledb_check_shmem();
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(11);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "pool_name", TEXTOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "total_pages", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "busy_pages", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "free_pages", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "dirty_pages", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "evicted_foreground", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "evicted_background", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "written_foreground", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "written_background", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "watermark_pages", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "usage_histogram", INT8ARRAYOID, -1, 0);
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = get_ppool((OPagePoolType) i);
+		uint32		epoch = pg_atomic_read_u32(pool->ucm.epoch);
+		int64		histogram[UCM_USAGE_LEVELS] = {0};
+		Datum		histogramDatums[UCM_USAGE_LEVELS];
+		int64		freePages;
+		Datum		values[11];
+		bool		nulls[11] = {false};
+		OInMemoryBlkno blkno;
+		int			level;
+
+		if (i == OPagePoolMain)
+			values[0] = PointerGetDatum(cstring_to_text("main"));
+		else if (i == OPagePoolFreeTree)
+			values[0] = PointerGetDatum(cstring_to_text("free_tree"));
+		else if (i == OPagePoolCatalog)
+			values[0] = PointerGetDatum(cstring_to_text("catalog"));
+
+		for (blkno = pool->offset; blkno < pool->offset + pool->size; blkno++)
+		{
+			Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+			uint32		usageCount = pg_atomic_read_u32(&O_PAGE_HEADER(p)->usageCount);
+
+			/* free and magazine-held pages are counted by free_pages */
+			if (usageCount >= UCM_USAGE_LEVELS)
+				continue;
+			histogram[(UCM_USAGE_LEVELS + usageCount - epoch) % UCM_USAGE_LEVELS]++;
+		}
+		for (level = 0; level < UCM_USAGE_LEVELS; level++)
+			histogramDatums[level] = Int64GetDatum(histogram[level]);
+
+		freePages = (int64) ppool_free_pages_count(pool);
+		values[1] = Int64GetDatum((int64) pool->size);
+		values[2] = Int64GetDatum((int64) pool->size - freePages);
+		values[3] = Int64GetDatum(freePages);
+		values[4] = Int64GetDatum((int64) ppool_dirty_pages_count(pool));
+		values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&pool->statCounters->evictedForeground));
+		values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&pool->statCounters->evictedBackground));
+		values[7] = Int64GetDatum((int64) pg_atomic_read_u64(&pool->statCounters->writtenForeground));
+		values[8] = Int64GetDatum((int64) pg_atomic_read_u64(&pool->statCounters->writtenBackground));
+		values[9] = Int64GetDatum((int64) ppool_watermark_pages(pool));
+		values[10] = PointerGetDatum(construct_array(histogramDatums,
+													 UCM_USAGE_LEVELS,
+													 INT8OID, sizeof(int64),
+													 FLOAT8PASSBYVAL,
+													 TYPALIGN_DOUBLE));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	PG_RETURN_VOID();
+}
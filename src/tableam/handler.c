@@ -17,6 +17,8 @@
 #include "orioledb.h"
 
 #include "btree/btree.h"
+#include "btree/build.h"
+#include "btree/io.h"
 #include "btree/iterator.h"
 #include "btree/scan.h"
 #include "btree/undo.h"
@@ -30,6 +32,7 @@
 #include "tableam/tree.h"
 #include "transam/oxid.h"
 #include "tuple/slot.h"
+#include "tuple/sort.h"
 #include "utils/stopevent.h"
 
 #include "access/heapam.h"
@@ -54,12 +57,50 @@
 #include "utils/lsyscache.h"
 #include "utils/sampling.h"
 
+#if PG_VERSION_NUM >= 140000
+/*
+ * Bounds of a TID range scan mapped onto a range of the surrogate "ctid"
+ * primary key.  Both keys are inclusive.
+ */
+typedef struct OTidRangeScanArg
+{
+	BTreeDescr *desc;
+	OFixedKey	low;
+	OFixedKey	high;
+} OTidRangeScanArg;
+#endif
+
+/*
+ * Scan keys compiled into a raw-tuple filter pushed down into the B-tree
+ * sequential scan, see o_seq_scan_setup_raw_filter().
+ */
+typedef struct OSeqScanRawFilterItem
+{
+	ScanKey		key;			/* points into rs_base.rs_key */
+	AttrNumber	attnum;			/* attribute number in the leaf tuple */
+} OSeqScanRawFilterItem;
+
+typedef struct OSeqScanRawFilter
+{
+	OIndexDescr *id;
+	int			nitems;
+	OSeqScanRawFilterItem items[FLEXIBLE_ARRAY_MEMBER];
+} OSeqScanRawFilter;
+
+static bool o_seq_scan_raw_filter(OTuple tuple, void *arg);
+static void o_seq_scan_setup_raw_filter(struct OScanDescData *scan,
+										OTableDescr *descr);
+
 typedef struct OScanDescData
 {
 	TableScanDescData rs_base;	/* AM independent part of the descriptor */
 	BTreeSeqScan *scan;
 	CommitSeqNo csn;
 	ItemPointerData iptr;
+	OSeqScanRawFilter *rawFilter;
+#if PG_VERSION_NUM >= 140000
+	OTidRangeScanArg tidRange;
+#endif
 } OScanDescData;
 typedef OScanDescData *OScanDesc;
 
@@ -709,6 +750,7 @@ orioledb_relation_set_new_filenode(Relation rel,
 		oldTreeOids = o_table_make_index_oids(o_table, &oldTreeOidsNum);
 
 		o_table_fill_oids(o_table, rel, newrnode);
+		o_table->persistence = persistence;
 
 		newOids = o_table->oids;
 		newTreeOids = o_table_make_index_oids(o_table, &newTreeOidsNum);
@@ -796,7 +838,155 @@ orioledb_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 								   double *tups_vacuumed,
 								   double *tups_recently_dead)
 {
-	elog(ERROR, "Not implemented: %s", PG_FUNCNAME_MACRO);
+	OTableDescr *old_descr = relation_get_descr(OldHeap);
+	OTableDescr *descr = relation_get_descr(NewHeap);
+	OIndexDescr *old_primary = GET_PRIMARY(old_descr);
+	OIndexDescr *idx;
+	BTreeIterator *iter;
+	TupleTableSlot *primarySlot;
+	Tuplesortstate **sortstates;
+	Tuplesortstate *toastSortState;
+	CheckpointFileHeader *fileHeaders;
+	CheckpointFileHeader toastFileHeader;
+	double		heap_tuples;
+	uint64		ctid;
+	int			i;
+
+	Assert(old_descr != NULL && descr != NULL);
+
+	/*
+	 * OrioleDB tables are always stored in primary key order, so the only
+	 * physical order we can rewrite into is the primary key one.  That is
+	 * what VACUUM FULL (OldIndex == NULL) and CLUSTER on the primary key
+	 * index ask for; clustering by any other index is not supported.
+	 */
+	if (OldIndex != NULL &&
+		RelationGetRelid(OldIndex) != old_primary->oids.reloid)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("orioledb tables can only be clustered by the primary key index")));
+
+	o_btree_load_shmem(&old_primary->desc);
+
+	sortstates = (Tuplesortstate **) palloc(sizeof(Tuplesortstate *) *
+											descr->nIndices);
+	fileHeaders = (CheckpointFileHeader *) palloc(sizeof(CheckpointFileHeader) *
+												  descr->nIndices);
+
+	for (i = 0; i < descr->nIndices; i++)
+		sortstates[i] = tuplesort_begin_orioledb_index(descr->indices[i],
+													   work_mem, false, NULL);
+	primarySlot = MakeSingleTupleTableSlot(old_descr->tupdesc, &TTSOpsOrioleDB);
+
+	btree_open_smgr(&descr->toast->desc);
+	toastSortState = tuplesort_begin_orioledb_toast(descr->toast,
+													descr->indices[0],
+													work_mem, false, NULL);
+
+	/*
+	 * An iterator over the old primary tree yields live tuples in key
+	 * order, so the rewrite both compacts the table and preserves its
+	 * physical order; dead versions are simply not copied.
+	 */
+	iter = o_btree_iterator_create(&old_primary->desc, NULL, BTreeKeyNone,
+								   COMMITSEQNO_INPROGRESS,
+								   ForwardScanDirection);
+	heap_tuples = 0;
+	ctid = 0;
+	while (true)
+	{
+		OTuple		primaryTup;
+
+		primaryTup = o_btree_iterator_fetch(iter, NULL, NULL,
+											BTreeKeyNone, true, NULL);
+
+		if (O_TUPLE_IS_NULL(primaryTup))
+			break;
+
+		tts_orioledb_store_tuple(primarySlot, primaryTup, old_descr,
+								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
+								 true, NULL);
+
+		slot_getallattrs(primarySlot);
+		tts_orioledb_detoast(primarySlot);
+		tts_orioledb_toast(primarySlot, descr);
+
+		for (i = 0; i < descr->nIndices; i++)
+		{
+			OTuple		newTup;
+			MemoryContext oldContext;
+
+			idx = descr->indices[i];
+
+			if (!o_is_index_predicate_satisfied(idx, primarySlot,
+												idx->econtext))
+				continue;
+
+			oldContext = MemoryContextSwitchTo(sortstates[i]->tuplecontext);
+			if (i == 0)
+			{
+				if (idx->primaryIsCtid)
+				{
+					primarySlot->tts_tid.ip_posid = (OffsetNumber) ctid;
+					BlockIdSet(&primarySlot->tts_tid.ip_blkid, (uint32) (ctid >> 16));
+					ctid++;
+				}
+				newTup = tts_orioledb_form_orphan_tuple(primarySlot, descr);
+			}
+			else
+			{
+				newTup = tts_orioledb_make_secondary_tuple(primarySlot, idx, true);
+			}
+			MemoryContextSwitchTo(oldContext);
+
+			o_btree_check_size_of_tuple(o_tuple_size(newTup, &idx->leafSpec),
+										idx->name.data, true);
+			tuplesort_putotuple(sortstates[i], newTup);
+		}
+
+		tts_orioledb_toast_sort_add(primarySlot, descr, toastSortState);
+
+		ExecClearTuple(primarySlot);
+		heap_tuples++;
+	}
+
+	ExecDropSingleTupleTableSlot(primarySlot);
+	btree_iterator_free(iter);
+
+	for (i = 0; i < descr->nIndices; i++)
+	{
+		idx = descr->indices[i];
+		tuplesort_performsort(sortstates[i]);
+		btree_write_index_data(&idx->desc, idx->leafTupdesc, sortstates[i],
+							   (idx->primaryIsCtid && i == PrimaryIndexNumber) ? ctid : 0,
+							   &fileHeaders[i]);
+		tuplesort_end_orioledb_index(sortstates[i]);
+	}
+	pfree(sortstates);
+
+	tuplesort_performsort(toastSortState);
+	btree_write_index_data(&descr->toast->desc, descr->toast->leafTupdesc,
+						   toastSortState, 0, &toastFileHeader);
+	tuplesort_end_orioledb_index(toastSortState);
+
+	/*
+	 * Hold oTablesAddLock while writing the file headers, so the
+	 * checkpoint number in the data files stays consistent with o_tables
+	 * metadata.
+	 */
+	LWLockAcquire(&checkpoint_state->oTablesAddLock, LW_SHARED);
+
+	for (i = 0; i < descr->nIndices; i++)
+		btree_write_file_header(&descr->indices[i]->desc, &fileHeaders[i]);
+	btree_write_file_header(&descr->toast->desc, &toastFileHeader);
+
+	LWLockRelease(&checkpoint_state->oTablesAddLock);
+
+	pfree(fileHeaders);
+
+	*num_tuples = heap_tuples;
+	*tups_vacuumed = 0;
+	*tups_recently_dead = 0;
 }
 
 static bool
@@ -933,6 +1123,45 @@ orioledb_estimate_rel_size(Relation rel, int32 *attr_widths,
 	double		reltuples;
 	BlockNumber relallvisible;
 	double		density;
+	OTableDescr *descr;
+
+	descr = relation_get_descr(rel);
+
+	/*
+	 * Fast path: the primary index meta page maintains fresh leaf page and
+	 * live tuple counters, so size estimation is a constant-time read which
+	 * doesn't lag behind ANALYZE.
+	 */
+	if (descr != NULL)
+	{
+		BTreeDescr *td = &GET_PRIMARY(descr)->desc;
+
+		o_btree_load_shmem(td);
+		curpages = TREE_NUM_LEAF_PAGES(td);
+		*tuples = (double) TREE_NUM_LIVE_TUPLES(td);
+
+		/*
+		 * Same idea as the "never vacuumed" heuristic below: don't let a plan
+		 * cached against a still-empty table assume the table stays tiny.
+		 */
+		if (curpages < 10 &&
+			rel->rd_rel->relpages == 0 &&
+			!rel->rd_rel->relhassubclass)
+		{
+			int32		tuple_width;
+
+			tuple_width = get_rel_data_width(rel, attr_widths);
+			tuple_width += MAXALIGN(SizeOfOTupleHeader);
+			density = ((double) (ORIOLEDB_BLCKSZ / 2)) / tuple_width;
+			curpages = 10;
+			*tuples = Max(*tuples, rint(density * (double) curpages));
+		}
+
+		*pages = curpages;
+		/* no visibility map: every page needs a visibility check */
+		*allvisfrac = 0;
+		return;
+	}
 
 	/* it has storage, ok to call the smgr */
 	curpages = RelationGetNumberOfBlocks(rel);
@@ -1105,10 +1334,18 @@ orioledb_beginscan(Relation relation, Snapshot snapshot,
 	ItemPointerSetBlockNumber(&scan->iptr, 0);
 	ItemPointerSetOffsetNumber(&scan->iptr, FirstOffsetNumber);
 
+	scan->scan = NULL;
+	scan->rawFilter = NULL;
 	if (descr)
 	{
 		o_btree_load_shmem(&GET_PRIMARY(descr)->desc);
-		scan->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, scan->csn);
+#if PG_VERSION_NUM >= 140000
+		/* the bounded scan is made by orioledb_scan_set_tidrange() */
+		if (!(flags & SO_TYPE_TIDRANGESCAN))
+#endif
+			scan->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, scan->csn,
+											 (ParallelOScanDesc) parallel_scan);
+		o_seq_scan_setup_raw_filter(scan, descr);
 	}
 
 	return &scan->rs_base;
@@ -1131,7 +1368,9 @@ orioledb_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
 		free_btree_seq_scan(scan->scan);
 
 	o_btree_load_shmem(&GET_PRIMARY(descr)->desc);
-	scan->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, scan->csn);
+	scan->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, scan->csn,
+									 (ParallelOScanDesc) scan->rs_base.rs_parallel);
+	o_seq_scan_setup_raw_filter(scan, descr);
 }
 
 static void
@@ -1145,6 +1384,84 @@ orioledb_endscan(TableScanDesc sscan)
 		free_btree_seq_scan(scan->scan);
 }
 
+static bool
+o_seq_scan_raw_filter(OTuple tuple, void *arg)
+{
+	OSeqScanRawFilter *filter = (OSeqScanRawFilter *) arg;
+	OIndexDescr *id = filter->id;
+	int			i;
+
+	for (i = 0; i < filter->nitems; i++)
+	{
+		ScanKey		key = filter->items[i].key;
+		bool		isnull;
+		Datum		val;
+
+		val = o_fastgetattr(tuple, filter->items[i].attnum,
+							id->leafTupdesc, &id->leafSpec, &isnull);
+
+		if (isnull)
+			return false;
+
+		if (!DatumGetBool(FunctionCall2Coll(&key->sk_func,
+											key->sk_collation,
+											val,
+											key->sk_argument)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Compile the simple scan keys into a raw-tuple filter and push it down into
+ * the B-tree sequential scan, so non-matching tuples are skipped while they
+ * still reside in the page image, without the tuple copy, the slot store and
+ * the full deform.  Only keys on attributes within the fixed-format prefix
+ * of the primary index leaf tuples qualify: those are fixed-width, never
+ * null in the stored tuple and never toasted, so a single attribute fetch is
+ * enough to evaluate the key.  The remaining keys (and the pushed-down ones
+ * again) are checked by slot_keytest() on the returned tuples.
+ */
+static void
+o_seq_scan_setup_raw_filter(OScanDesc scan, OTableDescr *descr)
+{
+	OIndexDescr *id = GET_PRIMARY(descr);
+	int			ctid_off = id->primaryIsCtid ? 1 : 0;
+	OSeqScanRawFilter *filter;
+	int			i,
+				n = 0;
+
+	if (scan->rs_base.rs_nkeys <= 0 || !scan->scan)
+		return;
+
+	if (scan->rawFilter == NULL)
+		scan->rawFilter = (OSeqScanRawFilter *)
+			palloc(offsetof(OSeqScanRawFilter, items) +
+				   sizeof(OSeqScanRawFilterItem) * scan->rs_base.rs_nkeys);
+	filter = scan->rawFilter;
+	filter->id = id;
+
+	for (i = 0; i < scan->rs_base.rs_nkeys; i++)
+	{
+		ScanKey		key = &scan->rs_base.rs_key[i];
+		AttrNumber	attnum = key->sk_attno + ctid_off;
+
+		if (key->sk_flags & SK_ISNULL)
+			continue;
+		if (attnum < 1 || attnum > id->leafSpec.natts)
+			continue;
+		filter->items[n].key = key;
+		filter->items[n].attnum = attnum;
+		n++;
+	}
+	filter->nitems = n;
+
+	if (n > 0)
+		btree_seq_scan_set_tuple_filter(scan->scan, o_seq_scan_raw_filter,
+										filter);
+}
+
 static bool
 slot_keytest(TupleTableSlot *slot, int nkeys, ScanKey keys)
 {
@@ -1214,28 +1531,144 @@ orioledb_getnextslot(TableScanDesc sscan, ScanDirection direction,
 	return true;
 }
 
+#if PG_VERSION_NUM >= 140000
+static bool o_tidrange_is_range_valid(OTuple low, OTuple high, void *arg);
+static bool o_tidrange_get_next_key(OFixedKey *key, bool inclusive, void *arg);
+
+static BTreeSeqScanCallbacks tidrange_seq_scan_callbacks = {
+	.isRangeValid = o_tidrange_is_range_valid,
+	.getNextKey = o_tidrange_get_next_key
+};
+
 /*
- * partial (and parallel) scans disabled by orioledb_set_rel_pathlist_hook()
+ * Make a fixed primary key from the given TID.  Valid for surrogate "ctid"
+ * primary keys only, where the key consists of the single TID attribute.
  */
+static void
+o_tidrange_fill_key(OIndexDescr *primary, OFixedKey *key, ItemPointer iptr)
+{
+	FormData_pg_attribute *attr = TupleDescAttr(primary->nonLeafTupdesc, 0);
+	OTupleHeader tuphdr = (OTupleHeader) key->fixedData;
+
+	Assert(primary->nFields == 1);
+	tuphdr->hasnulls = false;
+	tuphdr->natts = 1;
+	tuphdr->len = SizeOfOTupleHeader + attr->attlen;
+	*((ItemPointer) &key->fixedData[SizeOfOTupleHeader]) = *iptr;
+	key->tuple.data = key->fixedData;
+	key->tuple.formatFlags = 0;
+}
+
+static bool
+o_tidrange_is_range_valid(OTuple low, OTuple high, void *arg)
+{
+	OTidRangeScanArg *range = (OTidRangeScanArg *) arg;
+
+	if (!O_TUPLE_IS_NULL(low) &&
+		o_btree_cmp(range->desc,
+					&low, BTreeKeyNonLeafKey,
+					&range->high.tuple, BTreeKeyNonLeafKey) > 0)
+		return false;
+
+	if (!O_TUPLE_IS_NULL(high) &&
+		o_btree_cmp(range->desc,
+					&high, BTreeKeyNonLeafKey,
+					&range->low.tuple, BTreeKeyNonLeafKey) <= 0)
+		return false;
+
+	return true;
+}
+
+static bool
+o_tidrange_get_next_key(OFixedKey *key, bool inclusive, void *arg)
+{
+	OTidRangeScanArg *range = (OTidRangeScanArg *) arg;
+
+	if (o_btree_cmp(range->desc,
+					&key->tuple, BTreeKeyLeafTuple,
+					&range->high.tuple, BTreeKeyNonLeafKey) > 0)
+		return false;
+
+	if (o_btree_cmp(range->desc,
+					&key->tuple, BTreeKeyLeafTuple,
+					&range->low.tuple, BTreeKeyNonLeafKey) < 0)
+		copy_fixed_key(range->desc, key, range->low.tuple);
+
+	return true;
+}
+
+static void
+orioledb_scan_set_tidrange(TableScanDesc sscan, ItemPointer mintid,
+						   ItemPointer maxtid)
+{
+	OScanDesc	scan = (OScanDesc) sscan;
+	OTableDescr *descr;
+	OIndexDescr *primary;
+
+	descr = relation_get_descr(scan->rs_base.rs_rd);
+	primary = GET_PRIMARY(descr);
+
+	if (!primary->primaryIsCtid)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("orioledb table \"%s\" does not support TID range scans",
+						RelationGetRelationName(scan->rs_base.rs_rd)),
+				 errdetail("TID range scans work only for tables with the surrogate \"ctid\" primary key.")));
+
+	if (scan->scan)
+		free_btree_seq_scan(scan->scan);
+
+	o_btree_load_shmem(&primary->desc);
+	scan->tidRange.desc = &primary->desc;
+	o_tidrange_fill_key(primary, &scan->tidRange.low, mintid);
+	o_tidrange_fill_key(primary, &scan->tidRange.high, maxtid);
+
+	scan->scan = make_btree_seq_scan_cb(&primary->desc, scan->csn,
+										&tidrange_seq_scan_callbacks,
+										&scan->tidRange);
+}
+
+static bool
+orioledb_scan_getnextslot_tidrange(TableScanDesc sscan, ScanDirection direction,
+								   TupleTableSlot *slot)
+{
+	/* the bounds are enforced by the seq scan callbacks */
+	return orioledb_getnextslot(sscan, direction, slot);
+}
+#endif
+
 static Size
 orioledb_parallelscan_estimate(Relation rel)
 {
-	elog(ERROR, "Not implemented: %s", PG_FUNCNAME_MACRO);
-	return 0;
+	return sizeof(ParallelOScanDescData);
 }
 
 static Size
 orioledb_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan)
 {
-	elog(ERROR, "Not implemented: %s", PG_FUNCNAME_MACRO);
-	return 0;
+	ParallelOScanDesc poscan = (ParallelOScanDesc) pscan;
+
+	poscan->phs_base.phs_relid = RelationGetRelid(rel);
+	poscan->phs_base.phs_syncscan = false;
+	SpinLockInit(&poscan->mutex);
+	poscan->claimVersion = 0;
+	poscan->finished = false;
+	poscan->watermarkValid = false;
+
+	return sizeof(ParallelOScanDescData);
 }
 
 static void
 orioledb_parallelscan_reinitialize(Relation rel,
 								   ParallelTableScanDesc pscan)
 {
-	elog(ERROR, "Not implemented: %s", PG_FUNCNAME_MACRO);
+	ParallelOScanDesc poscan = (ParallelOScanDesc) pscan;
+
+	SpinLockAcquire(&poscan->mutex);
+	poscan->claimVersion++;
+	poscan->finished = false;
+	poscan->watermarkValid = false;
+	SpinLockRelease(&poscan->mutex);
 }
 
 static void
@@ -1251,11 +1684,13 @@ orioledb_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
 					  EState *estate,
 					  CommandId cid, int options, BulkInsertState bistate)
 {
-	int			i;
+	OTableDescr *descr;
+	CommitSeqNo csn;
+	OXid		oxid;
 
-	for (i = 0; i < ntuples; i++)
-		orioledb_tuple_insert(relation, slots[i], estate,
-							  cid, options, bistate);
+	descr = relation_get_descr(relation);
+	fill_current_oxid_csn(&oxid, &csn);
+	o_tbl_multi_insert(descr, relation, estate, slots, ntuples, oxid, csn);
 }
 
 static void
@@ -1427,22 +1862,29 @@ orioledb_acquire_sample_rows(Relation relation, int elevel,
 	/* Prepare for sampling rows */
 	reservoir_init_selection_state(&rstate, targrows);
 
-	tuple = btree_seq_scan_getnext_raw(scan, CurrentMemoryContext,
-									   &scanEnd, NULL);
-	while (!scanEnd)
+	while (true)
 	{
 		tuple = btree_seq_scan_getnext_raw(scan, CurrentMemoryContext,
 										   &scanEnd, NULL);
+		if (scanEnd)
+			break;
 
 		if (!O_TUPLE_IS_NULL(tuple))
 		{
-			tts_orioledb_store_tuple(slot, tuple, descr, COMMITSEQNO_INPROGRESS,
-									 PrimaryIndexNumber, false, NULL);
+			int			k = -1;
 
 			liverows += 1;
 
+			/*
+			 * Decide whether the row enters the reservoir before touching
+			 * the slot: rows passed over by the reservoir sampler -- the
+			 * vast majority once it is full -- are never deformed at all.
+			 * Toasted values of the kept rows stay external pointers in the
+			 * formed heap tuples, so detoast is deferred to the typanalyze
+			 * functions that actually examine the column.
+			 */
 			if (numrows < targrows)
-				rows[numrows++] = ExecCopySlotHeapTuple(slot);
+				k = numrows++;
 			else
 			{
 				/*
@@ -1460,17 +1902,26 @@ orioledb_acquire_sample_rows(Relation relation, int elevel,
 					 * tuple at random
 					 */
 #if PG_VERSION_NUM >= 150000
-					int			k = (int) (targrows * sampler_random_fract(&rstate.randstate));
+					k = (int) (targrows * sampler_random_fract(&rstate.randstate));
 #else
-					int			k = (int) (targrows * sampler_random_fract(rstate.randstate));
+					k = (int) (targrows * sampler_random_fract(rstate.randstate));
 #endif
 					Assert(k >= 0 && k < targrows);
 					heap_freetuple(rows[k]);
-					rows[k] = ExecCopySlotHeapTuple(slot);
 				}
 
 				rowstoskip -= 1;
 			}
+
+			if (k >= 0)
+			{
+				tts_orioledb_store_tuple(slot, tuple, descr,
+										 COMMITSEQNO_INPROGRESS,
+										 PrimaryIndexNumber, false, NULL);
+				rows[k] = ExecCopySlotHeapTuple(slot);
+				ExecClearTuple(slot);
+			}
+
 			samplerows += 1;
 		}
 		else
@@ -1541,6 +1992,10 @@ static const ExtendedTableAmRoutine orioledb_am_methods = {
 		.scan_end = orioledb_endscan,
 		.scan_rescan = orioledb_rescan,
 		.scan_getnextslot = orioledb_getnextslot,
+#if PG_VERSION_NUM >= 140000
+		.scan_set_tidrange = orioledb_scan_set_tidrange,
+		.scan_getnextslot_tidrange = orioledb_scan_getnextslot_tidrange,
+#endif
 
 		.parallelscan_estimate = orioledb_parallelscan_estimate,
 		.parallelscan_initialize = orioledb_parallelscan_initialize,
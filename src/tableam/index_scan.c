@@ -217,6 +217,103 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 	return tup;
 }
 
+/*
+ * Batch counterpart of o_iterate_index().  Fetches up to `max` tuples in one
+ * call, draining the iterator leaf by leaf.  Exact key ranges produce at most
+ * one tuple per call.  tupleCsns[] and (if given) hints[] are filled in
+ * parallel with tuples[].  Returns the number of fetched tuples; zero means
+ * the scan is over.
+ */
+int
+o_iterate_index_batch(OIndexDescr *indexDescr, OScanState *ostate,
+					  CommitSeqNo csn, CommitSeqNo *tupleCsns,
+					  MemoryContext tupleCxt, BTreeLocationHint *hints,
+					  OTuple *tuples, int max)
+{
+	int			count = 0;
+
+	if (ostate->exact || ostate->curKeyRange.empty)
+	{
+		if (!switch_to_next_range(indexDescr, ostate, csn, tupleCxt))
+			return 0;
+	}
+
+	do
+	{
+		if (ostate->exact)
+		{
+			OTuple		tup;
+
+			if (hints)
+				hints[0].blkno = InvalidBlockNumber;
+
+			tup = o_btree_find_tuple_by_key(&indexDescr->desc,
+											&ostate->curKeyRange.low,
+											BTreeKeyBound, csn, &tupleCsns[0],
+											tupleCxt, hints ? &hints[0] : NULL);
+			if (!O_TUPLE_IS_NULL(tup))
+			{
+				tuples[0] = tup;
+				count = 1;
+			}
+		}
+		else if (ostate->iterator)
+		{
+			OBTreeKeyBound *bound;
+			BTreeLocationHint hint = {OInvalidInMemoryBlkno, 0};
+			bool		scanEnd = false;
+
+			bound = (ostate->scanDir == ForwardScanDirection
+					 ? &ostate->curKeyRange.high : &ostate->curKeyRange.low);
+
+			do
+			{
+				int			base = count,
+							nfetched,
+							i;
+
+				nfetched = o_btree_iterator_fetch_batch(ostate->iterator,
+														&tupleCsns[base],
+														bound, BTreeKeyBound,
+														true,
+														hints ? &hint : NULL,
+														&tuples[base],
+														max - base, &scanEnd);
+
+				/* keep only the tuples matching the current key range */
+				for (i = 0; i < nfetched; i++)
+				{
+					OTuple		tup = tuples[base + i];
+					CommitSeqNo tupCsn = tupleCsns[base + i];
+
+					if (!is_tuple_valid(tup, indexDescr, ostate->scanDir,
+										&ostate->curKeyRange))
+					{
+						pfree(tup.data);
+						continue;
+					}
+
+					tuples[count] = tup;
+					tupleCsns[count] = tupCsn;
+					if (hints)
+						hints[count] = hint;
+					count++;
+				}
+			} while (count == 0 && !scanEnd);
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (count == 0 &&
+			!switch_to_next_range(indexDescr, ostate, csn, tupleCxt))
+			return 0;
+	} while (count == 0);
+
+	return count;
+}
+
 OTuple
 o_index_scan_getnext(OTableDescr *descr, OScanState *ostate, CommitSeqNo csn,
 					 CommitSeqNo *tupleCsn, bool scan_primary,
@@ -270,6 +367,92 @@ o_index_scan_getnext(OTableDescr *descr, OScanState *ostate, CommitSeqNo csn,
 	return tup;
 }
 
+/*
+ * Refills the batch buffer of the scan state with up to
+ * O_INDEX_SCAN_BATCH_SIZE tuples.  Returns false when the scan is over.
+ *
+ * Tuples are fetched the same way as by o_index_scan_getnext(): when we
+ * should fetch tuples from primary and the current index is secondary, each
+ * fetched index tuple is replaced by the corresponding primary one.
+ */
+bool
+o_index_scan_refill_batch(OTableDescr *descr, OScanState *ostate,
+						  CommitSeqNo csn, bool scan_primary,
+						  MemoryContext tupleCxt)
+{
+	OIndexDescr *id = descr->indices[ostate->ixNum];
+	int			count;
+
+	ostate->batchCount = 0;
+	ostate->batchPos = 0;
+
+	o_btree_load_shmem(&id->desc);
+	while (true)
+	{
+		count = o_iterate_index_batch(id, ostate, csn, ostate->batchCsns,
+									  tupleCxt,
+									  ostate->ixNum == PrimaryIndexNumber ?
+									  ostate->batchHints : NULL,
+									  ostate->batchTuples,
+									  O_INDEX_SCAN_BATCH_SIZE);
+		if (count == 0)
+			return false;
+
+		if (scan_primary && ostate->ixNum != PrimaryIndexNumber)
+		{
+			int			i,
+						kept = 0;
+
+			for (i = 0; i < count; i++)
+			{
+				OBTreeKeyBound bound;
+				OTuple		tup = ostate->batchTuples[i];
+				OTuple		ptup;
+				BTreeLocationHint *hint = &ostate->batchHints[kept];
+
+				/* fetch primary index key from tuple and search raw tuple */
+				o_fill_pindex_tuple_key_bound(&id->desc, tup, &bound);
+
+				hint->blkno = InvalidBlockNumber;
+				hint->pageChangeCount = 0;
+
+				ptup = o_btree_find_tuple_by_key(&GET_PRIMARY(descr)->desc,
+												 (Pointer) &bound, BTreeKeyBound,
+												 csn, &ostate->batchCsns[kept],
+												 tupleCxt, hint);
+				pfree(tup.data);
+
+				/*
+				 * in concurrent DELETE/UPDATE it might happen, we should to
+				 * try fetch next tuple
+				 */
+				if (O_TUPLE_IS_NULL(ptup))
+					continue;
+
+				ostate->batchTuples[kept] = ptup;
+				kept++;
+			}
+
+			count = kept;
+			if (count == 0)
+				continue;
+		}
+		else if (ostate->ixNum != PrimaryIndexNumber)
+		{
+			int			i;
+
+			/* no hints to store for secondary index tuples */
+			for (i = 0; i < count; i++)
+			{
+				ostate->batchHints[i].blkno = OInvalidInMemoryBlkno;
+				ostate->batchHints[i].pageChangeCount = 0;
+			}
+		}
+
+		ostate->batchCount = count;
+		return true;
+	}
+}
 
 /* fetches next tuple for oIterateDirectModify */
 TupleTableSlot *
@@ -277,32 +460,30 @@ o_exec_fetch(OScanState *ostate, ScanState *ss, CommitSeqNo csn)
 {
 	OTableDescr *descr = relation_get_descr(ss->ss_currentRelation);
 	TupleTableSlot *slot;
-	OTuple		tuple;
 	bool		scan_primary = ostate->ixNum == PrimaryIndexNumber ||
 	!ostate->onlyCurIx;
 	MemoryContext tupleCxt = ss->ss_ScanTupleSlot->tts_mcxt;
 
 	do
 	{
-		BTreeLocationHint hint = {OInvalidInMemoryBlkno, 0};
-		CommitSeqNo tupleCsn;
-
 		if (!ostate->curKeyRangeIsLoaded)
 			ostate->curKeyRange.empty = true;
 
-		tuple = o_index_scan_getnext(descr, ostate, csn, &tupleCsn,
-									 scan_primary, tupleCxt, &hint);
-
-		if (O_TUPLE_IS_NULL(tuple))
+		if (ostate->batchPos >= ostate->batchCount &&
+			!o_index_scan_refill_batch(descr, ostate, csn, scan_primary,
+									   tupleCxt))
 		{
 			slot = ExecClearTuple(ss->ss_ScanTupleSlot);
 		}
 		else
 		{
-			tts_orioledb_store_tuple(ss->ss_ScanTupleSlot, tuple,
-									 descr, tupleCsn,
+			int			pos = ostate->batchPos++;
+
+			tts_orioledb_store_tuple(ss->ss_ScanTupleSlot,
+									 ostate->batchTuples[pos],
+									 descr, ostate->batchCsns[pos],
 									 scan_primary ? PrimaryIndexNumber : ostate->ixNum,
-									 true, &hint);
+									 true, &ostate->batchHints[pos]);
 			slot = ss->ss_ScanTupleSlot;
 		}
 	} while (!TupIsNull(slot) &&
@@ -21,6 +21,11 @@
 #include "tuple/slot.h"
 
 #include "lib/rbtree.h"
+#include "port/pg_bitutils.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 static int	bm_rbt_comparator(const RBTNode *a, const RBTNode *b, void *arg);
 static void bm_rbt_combiner(RBTNode *existing, const RBTNode *newdata, void *arg);
@@ -30,6 +35,7 @@ static void bm_rbt_freefunc(RBTNode *x, void *arg);
 #define HIGH_PART_MASK	(0xFFFFFFFFFFFFFC00)
 #define LOW_PART_MASK	(0x00000000000003FF)
 #define BITMAP_SIZE		0x80
+#define BITMAP_WORDS	(BITMAP_SIZE / (int) sizeof(uint64))
 
 typedef struct
 {
@@ -38,6 +44,67 @@ typedef struct
 	uint8	   *bitmap;
 } OKeyBitmapRBTNode;
 
+/*
+ * Intersect two bitmap containers in-place: a &= b.  Returns true if the
+ * result is empty.
+ */
+static bool
+bitmap_and(uint8 *a, const uint8 *b)
+{
+#ifdef __AVX2__
+	__m256i		accum = _mm256_setzero_si256();
+	int			i;
+
+	for (i = 0; i < BITMAP_SIZE; i += sizeof(__m256i))
+	{
+		__m256i		r = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (a + i)),
+										 _mm256_loadu_si256((const __m256i *) (b + i)));
+
+		_mm256_storeu_si256((__m256i *) (a + i), r);
+		accum = _mm256_or_si256(accum, r);
+	}
+	return _mm256_testz_si256(accum, accum);
+#else
+	uint64	   *wa = (uint64 *) a;
+	const uint64 *wb = (const uint64 *) b;
+	uint64		accum = 0;
+	int			i;
+
+	for (i = 0; i < BITMAP_WORDS; i++)
+	{
+		wa[i] &= wb[i];
+		accum |= wa[i];
+	}
+	return accum == 0;
+#endif
+}
+
+/*
+ * Unite two bitmap containers in-place: a |= b.
+ */
+static void
+bitmap_or(uint8 *a, const uint8 *b)
+{
+#ifdef __AVX2__
+	int			i;
+
+	for (i = 0; i < BITMAP_SIZE; i += sizeof(__m256i))
+	{
+		__m256i		r = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (a + i)),
+										_mm256_loadu_si256((const __m256i *) (b + i)));
+
+		_mm256_storeu_si256((__m256i *) (a + i), r);
+	}
+#else
+	uint64	   *wa = (uint64 *) a;
+	const uint64 *wb = (const uint64 *) b;
+	int			i;
+
+	for (i = 0; i < BITMAP_WORDS; i++)
+		wa[i] |= wb[i];
+#endif
+}
+
 RBTree *
 o_keybitmap_create(void)
 {
@@ -95,7 +162,7 @@ o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high)
 	int			i,
 				iStart,
 				iEnd;
-	uint8		startMask,
+	uint64		startMask,
 				endMask;
 	bool		valid = false;
 	bool		first = true;
@@ -121,36 +188,38 @@ o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high)
 
 		if (!skip_step)
 		{
+			uint64	   *words = (uint64 *) node->bitmap;
+
 			if ((low & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
 			{
-				iStart = (low & LOW_PART_MASK) >> 3;
-				startMask = 0xFF << ((low & LOW_PART_MASK) & 7);
+				iStart = (low & LOW_PART_MASK) >> 6;
+				startMask = ~UINT64CONST(0) << ((low & LOW_PART_MASK) & 63);
 			}
 			else
 			{
 				iStart = 0;
-				startMask = 0xFF;
+				startMask = ~UINT64CONST(0);
 			}
 
 			if ((high & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
 			{
-				iEnd = ((high - 1) & LOW_PART_MASK) >> 3;
-				endMask = 0xFF >> (7 - (((high - 1) & LOW_PART_MASK) & 7));
+				iEnd = ((high - 1) & LOW_PART_MASK) >> 6;
+				endMask = ~UINT64CONST(0) >> (63 - (((high - 1) & LOW_PART_MASK) & 63));
 			}
 			else
 			{
-				iEnd = BITMAP_SIZE - 1;
-				endMask = 0xFF;
+				iEnd = BITMAP_WORDS - 1;
+				endMask = ~UINT64CONST(0);
 			}
 			for (i = iStart; i <= iEnd; i++)
 			{
-				uint8		mask;
+				uint64		mask;
 
-				mask = (i == iStart) ? startMask : 0xFF;
+				mask = (i == iStart) ? startMask : ~UINT64CONST(0);
 				if (i == iEnd)
 					mask &= endMask;
 
-				if (node->bitmap[i] & mask)
+				if (words[i] & mask)
 					valid = true;
 			}
 		}
@@ -169,28 +238,17 @@ o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high)
 static int
 find_next_offset(uint8 *bitmap, int minOffset)
 {
+	uint64	   *words = (uint64 *) bitmap;
+	uint64		mask = ~UINT64CONST(0) << (minOffset & 63);
 	int			i;
-	uint8		mask;
 
-	i = minOffset >> 3;
-	mask = 0xFF << (minOffset & 7);
-	while (i < BITMAP_SIZE)
+	for (i = minOffset >> 6; i < BITMAP_WORDS; i++)
 	{
-		mask &= bitmap[i];
-		if (mask)
-		{
-			int			result;
+		uint64		word = words[i] & mask;
 
-			result = i << 3;
-			while (!(mask & 1))
-			{
-				result++;
-				mask >>= 1;
-			}
-			return result;
-		}
-		mask = 0xFF;
-		i++;
+		if (word)
+			return (i << 6) + pg_rightmost_one_pos64(word);
+		mask = ~UINT64CONST(0);
 	}
 	return -1;
 }
@@ -292,36 +350,42 @@ o_keybitmap_is_empty(RBTree *rbtree)
 	return rbt_leftmost(rbtree) == NULL;
 }
 
+/*
+ * Intersects two key bitmaps in-place: a &= b.
+ *
+ * Both trees are consumed by leapfrogging search probes instead of paired
+ * container-by-container iteration.  Each probe skips a whole run of
+ * non-matching containers, so a skewed intersection costs
+ * O(min(|a|, |b|) * log(max(|a|, |b|))) rather than a visit plus a deletion
+ * for every container of the bigger tree.  Surviving containers are moved
+ * into a fresh tree, which then replaces the content of "a".
+ */
 void
 o_keybitmap_intersect(RBTree *a, RBTree *b)
 {
-	RBTreeIterator iterA;
-	RBTreeIterator iterB;
+	RBTree	   *result = o_keybitmap_create();
 	OKeyBitmapRBTNode *nodeA;
 	OKeyBitmapRBTNode *nodeB;
-	List	   *removing = NIL;
-	ListCell   *lc;
+	OKeyBitmapRBTNode probe;
 
-	rbt_begin_iterate(a, LeftRightWalk, &iterA);
-	rbt_begin_iterate(b, LeftRightWalk, &iterB);
+	probe.bitmap = NULL;
 
-	nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB);
-	while ((nodeA = (OKeyBitmapRBTNode *) rbt_iterate(&iterA)) != NULL)
+	nodeA = (OKeyBitmapRBTNode *) rbt_leftmost(a);
+	while (nodeA != NULL)
 	{
-		while (nodeB &&
-			   (nodeB->key & HIGH_PART_MASK) < (nodeA->key & HIGH_PART_MASK))
-		{
-			nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB);
-		}
+		bool		survives;
 
-		if (!nodeB ||
-			(nodeB->key & HIGH_PART_MASK) > (nodeA->key & HIGH_PART_MASK))
-		{
-			OKeyBitmapRBTNode *removed_node;
+		probe.key = nodeA->key;
+		nodeB = (OKeyBitmapRBTNode *) rbt_find_great_equal(b, &probe.rbtnode);
+		if (!nodeB)
+			break;
 
-			removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-			memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-			removing = lappend(removing, removed_node);
+		if ((nodeB->key & HIGH_PART_MASK) > (nodeA->key & HIGH_PART_MASK))
+		{
+			/* gallop "a" forward to the first container not below nodeB */
+			probe.key = nodeB->key;
+			nodeA = (OKeyBitmapRBTNode *) rbt_find_great_equal(a,
+															   &probe.rbtnode);
 			continue;
 		}
 
@@ -331,29 +395,13 @@ o_keybitmap_intersect(RBTree *a, RBTree *b)
 		{
 			if (!nodeB->bitmap)
 			{
-				if (nodeA->key != nodeB->key)
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
+				survives = (nodeA->key == nodeB->key);
 			}
 			else
 			{
 				int			offset = (nodeA->key & LOW_PART_MASK);
 
-				if (!(nodeB->bitmap[offset >> 3] & (1 << (offset & 7))))
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
+				survives = (nodeB->bitmap[offset >> 3] & (1 << (offset & 7))) != 0;
 			}
 		}
 		else
@@ -362,58 +410,41 @@ o_keybitmap_intersect(RBTree *a, RBTree *b)
 			{
 				int			offset = (nodeB->key & LOW_PART_MASK);
 
-				if (!(nodeA->bitmap[offset >> 3] & (1 << (offset & 7))))
+				survives = (nodeA->bitmap[offset >> 3] & (1 << (offset & 7))) != 0;
+				if (survives)
 				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
+					pfree(nodeA->bitmap);
+					nodeA->bitmap = NULL;
+					nodeA->key = nodeB->key;
 				}
-				pfree(nodeA->bitmap);
-				nodeA->bitmap = NULL;
-				nodeA->key = nodeB->key;
 			}
 			else
 			{
-				int			i;
-				bool		empty = true;
-
-				for (i = 0; i < BITMAP_SIZE; i++)
-				{
-					nodeA->bitmap[i] &= nodeB->bitmap[i];
-					if (nodeA->bitmap[i] != 0)
-						empty = false;
-				}
+				survives = !bitmap_and(nodeA->bitmap, nodeB->bitmap);
+			}
+		}
 
-				if (empty)
-				{
-					OKeyBitmapRBTNode *removed_node;
+		if (survives)
+		{
+			bool		is_new;
 
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
+			(void) rbt_insert(result, &nodeA->rbtnode, &is_new);
+			Assert(is_new);
+			/* the bitmap (if any) now belongs to the result tree */
+			nodeA->bitmap = NULL;
 		}
-	}
 
-	foreach(lc, removing)
-	{
-		OKeyBitmapRBTNode *search_node;
-		OKeyBitmapRBTNode *removing_node;
-
-		search_node = (OKeyBitmapRBTNode *) lfirst(lc);
-		if (search_node->bitmap)
-			pfree(search_node->bitmap);
-		removing_node = (OKeyBitmapRBTNode *) rbt_find(a,
-													   (RBTNode *) search_node);
-		rbt_delete(a, (RBTNode *) removing_node);
-		pfree(search_node);
+		/* step to the next container of "a" */
+		probe.key = (nodeA->key & HIGH_PART_MASK) + (LOW_PART_MASK + 1);
+		if (probe.key == 0)
+			break;
+		nodeA = (OKeyBitmapRBTNode *) rbt_find_great_equal(a, &probe.rbtnode);
 	}
-	list_free(removing);
+
+	/* replace the content of "a" with the result */
+	free_tree_node(*((RBTNode **) a));
+	*((RBTNode **) a) = *((RBTNode **) result);
+	pfree(result);
 }
 
 void
@@ -476,12 +507,7 @@ bm_rbt_combiner(RBTNode *existing,
 		old->bitmap[offset >> 3] |= 1 << (offset & 7);
 	}
 	else
-	{
-		int			i;
-
-		for (i = 0; i < BITMAP_SIZE; i++)
-			old->bitmap[i] |= new->bitmap[i];
-	}
+		bitmap_or(old->bitmap, new->bitmap);
 }
 
 static RBTNode *
@@ -26,6 +26,7 @@
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "tuple/slot.h"
+#include "tuple/toast.h"
 #include "utils/stopevent.h"
 
 #include "access/heapam.h"
@@ -51,7 +52,16 @@ static OTableModifyResult o_tbl_indices_insert(TupleTableSlot *slot,
 											   EState *estate,
 											   OIndexNumber start_ix, OXid oxid,
 											   CommitSeqNo csn,
+											   BTreeLocationHint *startIxHint,
 											   BTreeModifyCallbackInfo *callbackInfo);
+static bool o_tbl_index_insert(OTableDescr *descr,
+							   OIndexDescr *id,
+							   TupleTableSlot *slot,
+							   OTuple *formedTup,
+							   ExprContext *econtext,
+							   OXid oxid, CommitSeqNo csn,
+							   BTreeLocationHint *hint,
+							   BTreeModifyCallbackInfo *callbackInfo);
 static OTableModifyResult o_tbl_indices_overwrite(OTableDescr *descr,
 												  OBTreeKeyBound *oldPkey,
 												  TupleTableSlot *newSlot,
@@ -179,7 +189,7 @@ o_tbl_insert(OTableDescr *descr, Relation relation,
 								false);
 
 	mres = o_tbl_indices_insert(slot, descr, estate, PrimaryIndexNumber, oxid,
-								csn, &callbackInfo);
+								csn, NULL, &callbackInfo);
 
 	if (!mres.success)
 	{
@@ -191,6 +201,250 @@ o_tbl_insert(OTableDescr *descr, Relation relation,
 	o_wal_insert(&primary->desc, tup);
 }
 
+typedef struct
+{
+	TupleTableSlot *slot;
+	OBTreeKeyBound pkey;
+} OMultiInsertEntry;
+
+static int
+multi_insert_entry_cmp(const void *a, const void *b, void *arg)
+{
+	BTreeDescr *desc = (BTreeDescr *) arg;
+	OMultiInsertEntry *ea = (OMultiInsertEntry *) a;
+	OMultiInsertEntry *eb = (OMultiInsertEntry *) b;
+
+	return o_idx_cmp(desc,
+					 (Pointer) &ea->pkey, BTreeKeyBound,
+					 (Pointer) &eb->pkey, BTreeKeyBound);
+}
+
+void
+o_tbl_multi_insert(OTableDescr *descr, Relation relation,
+				   EState *estate, TupleTableSlot **slots, int ntuples,
+				   OXid oxid, CommitSeqNo csn)
+{
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	OMultiInsertEntry *entries;
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, InvalidOPageChangeCount};
+	OToastChunkBatch toastBatch = {NULL, 0, 0, NULL};
+	ExprContext *econtext;
+	bool		needCopy;
+	int			i,
+				ix;
+	BTreeModifyCallbackInfo callbackInfo =
+	{
+		.waitCallback = NULL,
+		.insertToDeleted = o_insert_callback,
+		.modifyCallback = NULL,
+		.needsUndoForSelfCreated = false,
+		.arg = NULL
+	};
+
+	entries = (OMultiInsertEntry *) palloc(sizeof(OMultiInsertEntry) * ntuples);
+	for (i = 0; i < ntuples; i++)
+		entries[i].slot = slots[i];
+
+	/*
+	 * Sort the batch by the primary key, so that consecutive inserts hit the
+	 * same leaf page and reuse its location as a hint instead of descending
+	 * from the root every time.  Tables with ctid primary key get ascending
+	 * keys assigned below: their input order is already the key order.
+	 */
+	if (!primary->primaryIsCtid)
+	{
+		for (i = 0; i < ntuples; i++)
+			tts_orioledb_fill_key_bound(entries[i].slot, primary,
+										&entries[i].pkey);
+		qsort_arg(entries, ntuples, sizeof(OMultiInsertEntry),
+				  multi_insert_entry_cmp, &primary->desc);
+	}
+
+	/*
+	 * The batched path below keeps references to all slots across the
+	 * secondary index passes, so it requires the caller's slots; if any of
+	 * them would have to be copied into the shared descr->newTuple slot,
+	 * fall back to the plain per-row path.
+	 */
+	needCopy = false;
+	for (i = 0; i < ntuples; i++)
+	{
+		if (slots[i]->tts_ops != descr->newTuple->tts_ops)
+		{
+			needCopy = true;
+			break;
+		}
+	}
+
+	if (needCopy)
+	{
+		for (i = 0; i < ntuples; i++)
+		{
+			TupleTableSlot *slot = entries[i].slot;
+			OTableModifyResult mres;
+			OTuple		tup;
+
+			ExecCopySlot(descr->newTuple, slot);
+			slot = descr->newTuple;
+			callbackInfo.arg = slot;
+
+			if (primary->primaryIsCtid)
+			{
+				o_btree_load_shmem(&primary->desc);
+				slot->tts_tid = btree_ctid_get_and_inc(&primary->desc);
+			}
+
+			tts_orioledb_toast(slot, descr);
+
+			tup = tts_orioledb_form_tuple(slot, descr);
+			o_btree_check_size_of_tuple(o_tuple_size(tup, &primary->leafSpec),
+										RelationGetRelationName(relation),
+										false);
+
+			mres = o_tbl_indices_insert(slot, descr, estate,
+										PrimaryIndexNumber,
+										oxid, csn, &hint, &callbackInfo);
+			if (!mres.success)
+				o_report_duplicate(relation, descr->indices[mres.failedIxNum],
+								   slot);
+
+			o_toast_insert_values(relation, descr, slot, oxid, csn);
+
+			o_wal_insert(&primary->desc, tup);
+		}
+
+		pfree(entries);
+		return;
+	}
+
+	econtext = GetPerTupleExprContext(estate);
+
+	toastBatch.mcxt = CurrentMemoryContext;
+
+	/* First pass: the primary index and WAL, in key order */
+	for (i = 0; i < ntuples; i++)
+	{
+		TupleTableSlot *slot = entries[i].slot;
+		OTuple		tup;
+
+		callbackInfo.arg = slot;
+
+		if (primary->primaryIsCtid)
+		{
+			o_btree_load_shmem(&primary->desc);
+			slot->tts_tid = btree_ctid_get_and_inc(&primary->desc);
+		}
+
+		tts_orioledb_toast(slot, descr);
+
+		tup = tts_orioledb_form_tuple(slot, descr);
+		o_btree_check_size_of_tuple(o_tuple_size(tup, &primary->leafSpec),
+									RelationGetRelationName(relation),
+									false);
+
+		if (!o_tbl_index_insert(descr, primary, slot, NULL, econtext,
+								oxid, csn, &hint, &callbackInfo))
+			o_report_duplicate(relation, primary, slot);
+
+		/*
+		 * Stage the TOAST chunks instead of inserting them here: each
+		 * inline insertion would descend the toast tree from the root and
+		 * evict the primary leaf the hint points to from cache.
+		 */
+		tts_orioledb_toast_batch_add(slot, descr, &toastBatch);
+
+		o_wal_insert(&primary->desc, tup);
+	}
+
+	/*
+	 * Second pass: the staged TOAST chunks.  TOAST keys are prefixed by the
+	 * primary key and the batch is sorted by it (ctid primary keys are
+	 * assigned ascending above), so the chunks are already in toast-tree key
+	 * order and the shared hint inside the batch insert turns one descent
+	 * per chunk into one per touched leaf.
+	 */
+	if (toastBatch.count > 0)
+	{
+		o_btree_load_shmem(&descr->toast->desc);
+		if (!o_toast_batch_insert(GET_PRIMARY(descr), descr->toast,
+								  &toastBatch, oxid, csn))
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Unable to insert TOASTable value in \"%s\"",
+							RelationGetRelationName(relation))));
+
+		for (i = 0; i < toastBatch.count; i++)
+			pfree(toastBatch.chunks[i].data);
+		pfree(toastBatch.chunks);
+	}
+
+	/*
+	 * Remaining passes: one per secondary index, each over the whole batch
+	 * sorted by that index's key.  Rows adjacent in an index land on the
+	 * same leaf, so the location hint turns N descents into one per touched
+	 * leaf.  Unique violations still surface while the offending row is
+	 * inserted; only the order of checks across rows changes, which doesn't
+	 * matter since any violation aborts the whole statement.
+	 */
+	for (ix = 0; ix < descr->nIndices; ix++)
+	{
+		OIndexDescr *id = descr->indices[ix];
+		BTreeLocationHint ixHint = {OInvalidInMemoryBlkno, InvalidOPageChangeCount};
+		TupleTableSlot **batchSlots;
+		OTuple	   *batchTuples;
+		Pointer		batchArena;
+		int			n = 0;
+
+		if (ix == PrimaryIndexNumber)
+			continue;
+
+		for (i = 0; i < ntuples; i++)
+		{
+			TupleTableSlot *slot = slots[i];
+
+			if (!o_is_index_predicate_satisfied(id, slot, econtext))
+				continue;
+
+			entries[n].slot = slot;
+			tts_orioledb_fill_key_bound(slot, id, &entries[n].pkey);
+			n++;
+		}
+
+		if (n == 0)
+			continue;
+
+		qsort_arg(entries, n, sizeof(OMultiInsertEntry),
+				  multi_insert_entry_cmp, &id->desc);
+
+		/*
+		 * Form the secondary tuples of the whole batch at once: the index
+		 * values are collected in a single pass and the tuples are packed
+		 * into one arena instead of a palloc per row.
+		 */
+		batchSlots = (TupleTableSlot **) palloc(sizeof(TupleTableSlot *) * n);
+		for (i = 0; i < n; i++)
+			batchSlots[i] = entries[i].slot;
+		batchTuples = (OTuple *) palloc(sizeof(OTuple) * n);
+		batchArena = tts_orioledb_make_secondary_tuples(batchSlots, n, id,
+														batchTuples);
+
+		for (i = 0; i < n; i++)
+		{
+			callbackInfo.arg = batchSlots[i];
+			if (!o_tbl_index_insert(descr, id, batchSlots[i], &batchTuples[i],
+									econtext, oxid, csn, &ixHint,
+									&callbackInfo))
+				o_report_duplicate(relation, id, batchSlots[i]);
+		}
+
+		pfree(batchArena);
+		pfree(batchTuples);
+		pfree(batchSlots);
+	}
+
+	pfree(entries);
+}
+
 OBTreeModifyResult
 o_tbl_lock(OTableDescr *descr, OBTreeKeyBound *pkey, LockTupleMode mode,
 		   OXid oxid, OLockCallbackArg *larg, BTreeLocationHint *hint)
@@ -286,6 +540,7 @@ o_tbl_insert_on_conflict(ModifyTableState *mstate,
 	{
 		CommitSeqNo save_csn = csn;
 		OTuple		primary_tup;
+		bool		conflictFound = false;
 		BTreeModifyCallbackInfo callbackInfo = {
 			.waitCallback = o_insert_on_conflict_wait_callback,
 			.insertToDeleted = o_insert_on_conflict_insert_to_deleted_callback,
@@ -300,40 +555,77 @@ o_tbl_insert_on_conflict(ModifyTableState *mstate,
 		ioc_arg.conflictOxid = InvalidOXid;
 		ioc_arg.csn = csn;
 
-		memset(&mres, 0, sizeof(OTableModifyResult));
-
-		mres = o_tbl_indices_insert(slot, descr, estate, conflict_ix, oxid,
-									csn, &callbackInfo);
+		/*
+		 * Upsert workloads mostly hit existing rows, and for them the
+		 * insert-first approach is pure waste: undo is reserved, the tuple
+		 * is inserted into indexes up to the conflicting one, and then the
+		 * whole insertion is rolled back through the undo stack.  Probe the
+		 * conflict index first instead and go straight to the update path
+		 * on a hit.  A miss falls through to the normal insert attempt,
+		 * which still detects concurrently inserted conflicts.
+		 */
+		if (on_update)
+		{
+			OIndexDescr *conflict_td = descr->indices[conflict_ix];
+			OBTreeKeyBound conflictKey;
+			OTuple		conflictTup;
+			CommitSeqNo conflictTupCsn;
+			BTreeLocationHint chint = {OInvalidInMemoryBlkno, 0};
+
+			tts_orioledb_fill_key_bound(slot, conflict_td, &conflictKey);
+			o_btree_load_shmem(&conflict_td->desc);
+			conflictTup = o_btree_find_tuple_by_key(&conflict_td->desc,
+													(Pointer) &conflictKey,
+													BTreeKeyBound,
+													csn, &conflictTupCsn,
+													ioc_arg.scanSlot->tts_mcxt,
+													&chint);
+			if (!O_TUPLE_IS_NULL(conflictTup))
+			{
+				tts_orioledb_store_tuple(ioc_arg.scanSlot, conflictTup,
+										 descr, conflictTupCsn, conflict_ix,
+										 true, &chint);
+				conflictFound = true;
+			}
+		}
 
-		if (mres.success)
+		if (!conflictFound)
 		{
-			BTreeDescr *primary = &GET_PRIMARY(descr)->desc;
+			memset(&mres, 0, sizeof(OTableModifyResult));
 
-			/* all OK */
-			tts_orioledb_insert_toast_values(slot, descr, oxid, csn);
+			mres = o_tbl_indices_insert(slot, descr, estate, conflict_ix, oxid,
+										csn, NULL, &callbackInfo);
 
-			tup = tts_orioledb_form_tuple(slot, descr);
-			o_wal_insert(primary, tup);
-			return slot;
-		}
+			if (mres.success)
+			{
+				BTreeDescr *primary = &GET_PRIMARY(descr)->desc;
 
-		/* failed to insert */
-		release_undo_size(UndoReserveTxn);
-		apply_undo_stack(oxid, &undoStackLocations, true);
-		if (ioc_arg.conflictOxid != InvalidOXid)
-		{
-			/* helps avoid deadlocks */
-			oxid_notify(ioc_arg.conflictOxid);
-			(void) wait_for_oxid(ioc_arg.conflictOxid);
-			continue;
-		}
+				/* all OK */
+				tts_orioledb_insert_toast_values(slot, descr, oxid, csn);
 
-		if (!ignore_all && mres.failedIxNum != conflict_ix)
-		{
-			o_report_duplicate(rel, descr->indices[mres.failedIxNum], slot);
-		}
+				tup = tts_orioledb_form_tuple(slot, descr);
+				o_wal_insert(primary, tup);
+				return slot;
+			}
+
+			/* failed to insert */
+			release_undo_size(UndoReserveTxn);
+			apply_undo_stack(oxid, &undoStackLocations, true);
+			if (ioc_arg.conflictOxid != InvalidOXid)
+			{
+				/* helps avoid deadlocks */
+				oxid_notify(ioc_arg.conflictOxid);
+				(void) wait_for_oxid(ioc_arg.conflictOxid);
+				continue;
+			}
 
-		csn = ioc_arg.csn;
+			if (!ignore_all && mres.failedIxNum != conflict_ix)
+			{
+				o_report_duplicate(rel, descr->indices[mres.failedIxNum], slot);
+			}
+
+			csn = ioc_arg.csn;
+		}
 
 		if (on_update)
 		{
@@ -665,7 +957,9 @@ o_update_secondary_indices(OTableDescr *descr,
 			update = true;
 		else
 			update = !is_keys_eq(&id->desc, &old_key, &new_key) ||
-				(old_valid != new_valid);
+				(old_valid != new_valid) ||
+				(id->nIncludedFields > 0 &&
+				 !tts_orioledb_included_fields_eq(oldSlot, newSlot, id));
 
 		if (update)
 		{
@@ -966,8 +1260,10 @@ static bool
 o_tbl_index_insert(OTableDescr *descr,
 				   OIndexDescr *id,
 				   TupleTableSlot *slot,
+				   OTuple *formedTup,
 				   ExprContext *econtext,
 				   OXid oxid, CommitSeqNo csn,
+				   BTreeLocationHint *hint,
 				   BTreeModifyCallbackInfo *callbackInfo)
 {
 	BTreeDescr *bd = &id->desc;
@@ -983,7 +1279,11 @@ o_tbl_index_insert(OTableDescr *descr,
 
 		if (!primary)
 		{
-			tup = tts_orioledb_make_secondary_tuple(slot, id, true);
+			/* the batched callers form secondary tuples beforehand */
+			if (formedTup)
+				tup = *formedTup;
+			else
+				tup = tts_orioledb_make_secondary_tuple(slot, id, true);
 			o_btree_check_size_of_tuple(o_tuple_size(tup, &id->leafSpec),
 										id->name.data, true);
 		}
@@ -998,12 +1298,12 @@ o_tbl_index_insert(OTableDescr *descr,
 									  tup, BTreeKeyLeafTuple,
 									  (Pointer) &knew, BTreeKeyBound,
 									  oxid, csn, RowLockUpdate,
-									  NULL, callbackInfo) == OBTreeModifyResultInserted;
+									  hint, callbackInfo) == OBTreeModifyResultInserted;
 		else
 			inserted = o_btree_insert_unique(bd, tup, BTreeKeyLeafTuple,
 											 (Pointer) &knew, BTreeKeyBound,
 											 oxid, csn, RowLockUpdate,
-											 NULL, callbackInfo) == OBTreeModifyResultInserted;
+											 hint, callbackInfo) == OBTreeModifyResultInserted;
 
 		((OTableSlot *) slot)->version = o_tuple_get_version(tup);
 
@@ -1023,10 +1323,14 @@ o_tbl_indices_insert(TupleTableSlot *slot,
 					 EState *estate,
 					 OIndexNumber start_ix,
 					 OXid oxid, CommitSeqNo csn,
+					 BTreeLocationHint *startIxHint,
 					 BTreeModifyCallbackInfo *callbackInfo)
 {
 	OTableModifyResult result;
 	int			i;
+	int			pass;
+	OTuple	   *formedTups;
+	bool	   *suspected;
 	ExprContext *econtext;
 
 	result.success = true;
@@ -1037,7 +1341,8 @@ o_tbl_indices_insert(TupleTableSlot *slot,
 	econtext = GetPerTupleExprContext(estate);
 
 	result.success = o_tbl_index_insert(descr, descr->indices[start_ix], slot,
-										econtext, oxid, csn, callbackInfo);
+										NULL, econtext, oxid, csn, startIxHint,
+										callbackInfo);
 	if (!result.success)
 	{
 		result.failedIxNum = i;
@@ -1046,21 +1351,63 @@ o_tbl_indices_insert(TupleTableSlot *slot,
 		return result;
 	}
 
+	/*
+	 * Phase one: probe the unique secondary indexes read-only, collecting
+	 * suspected conflicts.  No unique lwlocks or page locks are held across
+	 * indexes, and the formed secondary tuples are reused by the inserts.
+	 */
+	formedTups = (OTuple *) palloc(sizeof(OTuple) * descr->nIndices);
+	suspected = (bool *) palloc0(sizeof(bool) * descr->nIndices);
 	for (i = 0; i < descr->nIndices; i++)
 	{
-		if (i == start_ix)
+		OIndexDescr *id = descr->indices[i];
+		OBTreeKeyBound key;
+
+		O_TUPLE_SET_NULL(formedTups[i]);
+		if (i == start_ix || id->desc.type == oIndexPrimary)
+			continue;
+		if (!o_is_index_predicate_satisfied(id, slot, econtext))
 			continue;
 
-		result.success = o_tbl_index_insert(descr, descr->indices[i], slot,
-											econtext, oxid, csn, callbackInfo);
-		if (!result.success)
+		formedTups[i] = tts_orioledb_make_secondary_tuple(slot, id, true);
+		if (!id->unique || o_has_nulls(formedTups[i]))
+			continue;
+
+		tts_orioledb_fill_key_bound(slot, id, &key);
+		o_btree_load_shmem(&id->desc);
+		suspected[i] = o_btree_unique_probe(&id->desc, formedTups[i],
+											(Pointer) &key, BTreeKeyBound,
+											oxid);
+	}
+
+	/*
+	 * Phase two: apply the inserts in index order, but the indexes with
+	 * suspected conflicts first, so a duplicate key is detected before the
+	 * remaining indexes are modified and have to be rolled back.
+	 */
+	for (pass = 0; pass < 2; pass++)
+	{
+		for (i = 0; i < descr->nIndices; i++)
 		{
-			result.failedIxNum = i;
-			result.action = BTreeOperationInsert;
-			result.oldTuple = NULL;
-			return result;
+			if (i == start_ix || suspected[i] != (pass == 0))
+				continue;
+
+			result.success = o_tbl_index_insert(descr, descr->indices[i], slot,
+												O_TUPLE_IS_NULL(formedTups[i]) ?
+												NULL : &formedTups[i],
+												econtext, oxid, csn, NULL,
+												callbackInfo);
+			if (!result.success)
+			{
+				result.failedIxNum = i;
+				result.action = BTreeOperationInsert;
+				result.oldTuple = NULL;
+				return result;
+			}
 		}
 	}
+	pfree(formedTups);
+	pfree(suspected);
 
 	return result;
 }
@@ -292,10 +292,21 @@ orioledb_set_rel_pathlist_hook(PlannerInfo *rootPageBlkno, RelOptInfo *rel,
 			}
 
 			/*
-			 * disable partial scans
+			 * Only plain partial scans survive: they are executed through
+			 * the table AM, which hands out downlink keyranges to the
+			 * parallel workers.  Partial index and bitmap paths would
+			 * bypass our custom scans, so they are removed.
 			 */
-			list_free(rel->partial_pathlist);
-			rel->partial_pathlist = NIL;
+			i = 0;
+			while (i < list_length(rel->partial_pathlist))
+			{
+				Path	   *path = list_nth(rel->partial_pathlist, i);
+
+				if (IsA(path, Path))
+					i++;
+				else
+					rel->partial_pathlist = list_delete_nth_cell(rel->partial_pathlist, i);
+			}
 		}
 
 		if (relation != NULL)
@@ -677,6 +688,12 @@ o_rescan_custom_scan(CustomScanState *node)
 			btree_iterator_free(ix_plan_state->ostate.iterator);
 		}
 
+		/* drop the tuples still sitting in the batch buffer */
+		while (ix_plan_state->ostate.batchPos < ix_plan_state->ostate.batchCount)
+			pfree(ix_plan_state->ostate.batchTuples[ix_plan_state->ostate.batchPos++].data);
+		ix_plan_state->ostate.batchCount = 0;
+		ix_plan_state->ostate.batchPos = 0;
+
 		ix_plan_state->ostate.curKeyRangeIsLoaded = false;
 		ix_plan_state->ostate.curKeyRange.empty = true;
 		ix_plan_state->ostate.iterator = NULL;
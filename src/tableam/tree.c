@@ -23,13 +23,16 @@
 #include "tableam/toast.h"
 #include "tableam/tree.h"
 #include "tuple/toast.h"
+#include "utils/compress.h"
 #include "utils/stopevent.h"
 
 #include "access/nbtree.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "parser/parse_coerce.h"
 #include "utils/builtins.h"
+#include "utils/pg_locale.h"
 #include "utils/syscache.h"
 
 static uint32 o_idx_hash(BTreeDescr *desc, OTuple tuple, BTreeKeyType kind);
@@ -50,6 +53,9 @@ static OTuple o_create_key_tuple(BTreeDescr *desc, OTuple tuple,
 static bool pk_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 						  OTuple oldTuple, OTupleXactInfo oldXactInfo,
 						  bool oldDeleted, OTuple newTuple, OXid newOxid);
+static bool o_idx_key_abbrev(BTreeDescr *desc, void *p, BTreeKeyType kind,
+							 uint64 *abbrev);
+static OTuple o_idx_truncate_key(BTreeDescr *desc, OTuple key, int natts);
 
 static BTreeOps primaryOps = {
 	.len = o_idx_len,
@@ -57,8 +63,11 @@ static BTreeOps primaryOps = {
 	.tuple_make_key = o_tuple_make_key,
 	.needs_undo = pk_needs_undo,
 	.cmp = o_idx_cmp,
+	.cmpPrefix = o_idx_cmp_prefix,
+	.truncate_key = o_idx_truncate_key,
 	.hash = o_idx_hash,
-	.unique_hash = o_idx_unique_hash
+	.unique_hash = o_idx_unique_hash,
+	.key_abbrev = o_idx_key_abbrev
 },
 
 			secondaryOps = {
@@ -67,8 +76,11 @@ static BTreeOps primaryOps = {
 	.tuple_make_key = o_sidx_tuple_make_key,
 	.needs_undo = NULL,
 	.cmp = o_idx_cmp,
+	.cmpPrefix = o_idx_cmp_prefix,
+	.truncate_key = o_idx_truncate_key,
 	.hash = o_idx_hash,
-	.unique_hash = o_idx_unique_hash
+	.unique_hash = o_idx_unique_hash,
+	.key_abbrev = o_idx_key_abbrev
 },
 
 			toastOps = {
@@ -96,6 +108,10 @@ index_btree_desc_init(BTreeDescr *desc, OCompress compress, ORelOids oids,
 	desc->oids = oids;
 	desc->arg = arg;
 	desc->compress = compress;
+	if (OCompressIsValid(compress))
+		desc->compressDict = o_compress_dict_load(oids, compress);
+	else
+		desc->compressDict = NULL;
 	desc->type = type;
 	desc->rootInfo.rootPageBlkno = OInvalidInMemoryBlkno;
 	desc->rootInfo.metaPageBlkno = OInvalidInMemoryBlkno;
@@ -108,9 +124,34 @@ index_btree_desc_init(BTreeDescr *desc, OCompress compress, ORelOids oids,
 	desc->tmpBuf[0].file = -1;
 	desc->tmpBuf[0].file = -1;
 	desc->ppool = get_ppool(OPagePoolMain);
-	desc->storageType = BTreeStoragePersistence;
+	if (((OIndexDescr *) arg)->tablePersistence == RELPERSISTENCE_TEMP)
+	{
+		/*
+		 * Temporary trees emit no WAL and are not checkpointed: they are
+		 * session-local and their content doesn't survive a restart.
+		 */
+		desc->storageType = BTreeStorageTemporary;
+	}
+	else
+	{
+		/*
+		 * Unlogged trees are checkpointed so that their content survives a
+		 * clean shutdown, but emit no WAL (see add_modify_wal_record()):
+		 * after a crash they recover to the last checkpoint, with the
+		 * then-uncommitted changes reverted through undo.
+		 */
+		desc->storageType = BTreeStoragePersistence;
+	}
+
+	/*
+	 * Both persistence classes keep transactional undo: ROLLBACK [TO
+	 * SAVEPOINT] and the MVCC visibility of unlogged tables shared between
+	 * backends depend on it.
+	 */
 	desc->undoType = UndoReserveTxn;
 	desc->createOxid = createOxid;
+	desc->rightmostHint.blkno = OInvalidInMemoryBlkno;
+	desc->rightmostHint.pageChangeCount = InvalidOPageChangeCount;
 }
 
 static inline OIndexDescr *
@@ -543,6 +584,18 @@ cmp_inclusive2(uint8 f1, uint8 f2)
 	return cmp1 - cmp2;
 }
 
+/*
+ * Compare two values of an index field, using the specialized comparison
+ * function when the descriptor initialization selected one.
+ */
+static inline int
+o_idx_cmp_field_values(OIndexField *field, Datum value1, Datum value2)
+{
+	if (field->fastCmp)
+		return field->fastCmp(value1, value2);
+	return o_call_comparator(field->comparator, value1, value2);
+}
+
 int
 o_idx_cmp_range_key_to_value(OBTreeValueBound *bound1, OIndexField *field,
 							 Datum value, bool isnull)
@@ -555,7 +608,7 @@ o_idx_cmp_range_key_to_value(OBTreeValueBound *bound1, OIndexField *field,
 		if ((bound1->flags & O_VALUE_BOUND_COERCIBLE) && bound1->value == value)
 			cmp = 0;
 		else if (o_bound_is_coercible(bound1, field))
-			cmp = o_call_comparator(field->comparator, bound1->value, value);
+			cmp = o_idx_cmp_field_values(field, bound1->value, value);
 		else
 			cmp = o_call_comparator(bound1->comparator, bound1->value, value);
 
@@ -577,10 +630,16 @@ o_idx_cmp_range_key_to_value(OBTreeValueBound *bound1, OIndexField *field,
 	}
 }
 
+/*
+ * Compare two tuples attribute by attribute.  If equalAtts is given, the
+ * first *equalAtts attributes are taken as equal without comparison, and on
+ * return *equalAtts is set to the number of leading equal attributes.
+ */
 static int
 o_idx_cmp_tuples(OIndexDescr *id,
 				 OTuple *tuple1, BTreeKeyType keyType1,
-				 OTuple *tuple2, BTreeKeyType keyType2)
+				 OTuple *tuple2, BTreeKeyType keyType2,
+				 int *equalAtts)
 {
 	TupleDesc	tupdesc1,
 				tupdesc2;
@@ -620,19 +679,41 @@ o_idx_cmp_tuples(OIndexDescr *id,
 	}
 
 	n = id->nonLeafTupdesc->natts;
-	for (i = 0; i < n; i++)
+	for (i = equalAtts ? *equalAtts : 0; i < n; i++)
 	{
 		OIndexField *field = &id->fields[i];
 		int			cmp = 0;
+		bool		trunc1,
+					trunc2;
 
 		attnum1 = OIndexKeyAttnumToTupleAttnum(keyType1, id, i + 1);
-		value1 = o_fastgetattr(*tuple1, attnum1, tupdesc1, spec1, &isnull1);
 		attnum2 = OIndexKeyAttnumToTupleAttnum(keyType2, id, i + 1);
+
+		/*
+		 * An attribute cut away by separator key truncation compares less
+		 * than any value.  Only non-leaf keys are ever truncated: a short
+		 * leaf tuple means missing columns added after the tuple was
+		 * written.
+		 */
+		trunc1 = keyType1 == BTreeKeyNonLeafKey &&
+			attnum1 > o_tuple_natts(*tuple1, spec1);
+		trunc2 = keyType2 == BTreeKeyNonLeafKey &&
+			attnum2 > o_tuple_natts(*tuple2, spec2);
+		if (trunc1 || trunc2)
+		{
+			if (equalAtts)
+				*equalAtts = i;
+			if (trunc1 == trunc2)
+				return 0;
+			return trunc1 ? -1 : 1;
+		}
+
+		value1 = o_fastgetattr(*tuple1, attnum1, tupdesc1, spec1, &isnull1);
 		value2 = o_fastgetattr(*tuple2, attnum2, tupdesc2, spec2, &isnull2);
 
 		if (!isnull1 && !isnull2)
 		{
-			cmp = o_call_comparator(field->comparator, value1, value2);
+			cmp = o_idx_cmp_field_values(field, value1, value2);
 			if (!field->ascending)
 				cmp = -cmp;
 		}
@@ -644,15 +725,22 @@ o_idx_cmp_tuples(OIndexDescr *id,
 			cmp = field->nullfirst ? 1 : -1;
 
 		if (cmp != 0)
+		{
+			if (equalAtts)
+				*equalAtts = i;
 			return cmp;
+		}
 	}
+	if (equalAtts)
+		*equalAtts = n;
 	return 0;
 }
 
 static int
 o_idx_cmp_key_bound_to_tuple(OIndexDescr *id,
 							 OBTreeKeyBound *key1, BTreeKeyType keyType1,
-							 OTuple *tuple2, BTreeKeyType keyType2)
+							 OTuple *tuple2, BTreeKeyType keyType2,
+							 int *equalAtts)
 {
 	TupleDesc	tupdesc;
 	OTupleFixedFormatSpec *spec;
@@ -679,22 +767,42 @@ o_idx_cmp_key_bound_to_tuple(OIndexDescr *id,
 	else
 		n = id->nUniqueFields;
 
-	for (i = 0; i < n; i++)
+	for (i = equalAtts ? *equalAtts : 0; i < n; i++)
 	{
 		uint8		flags = key1->keys[i].flags;
 		int			cmp;
 
 		if (flags & O_VALUE_BOUND_UNBOUNDED)
+		{
+			if (equalAtts)
+				*equalAtts = i;
 			return (flags & O_VALUE_BOUND_LOWER) ? -1 : 1;
+		}
 
 		attnum = OIndexKeyAttnumToTupleAttnum(keyType2, id, i + 1);
+
+		/* A truncated separator key compares less than any bound */
+		if (keyType2 == BTreeKeyNonLeafKey &&
+			attnum > o_tuple_natts(*tuple2, spec))
+		{
+			if (equalAtts)
+				*equalAtts = i;
+			return 1;
+		}
+
 		value = o_fastgetattr(*tuple2, attnum, tupdesc, spec, &isnull);
 
 		cmp = o_idx_cmp_range_key_to_value(&key1->keys[i], &id->fields[i],
 										   value, isnull);
 		if (cmp != 0)
+		{
+			if (equalAtts)
+				*equalAtts = i;
 			return cmp;
+		}
 	}
+	if (equalAtts)
+		*equalAtts = n;
 
 	if (keyType1 == BTreeKeyUniqueLowerBound)
 		return -1;
@@ -731,7 +839,7 @@ o_idx_cmp_value_bounds(OBTreeValueBound *bound1,
 			bool		coercible2 = o_bound_is_coercible(bound2, field);
 
 			if (coercible1 && coercible2)
-				res = o_call_comparator(field->comparator, bound1->value, bound2->value);
+				res = o_idx_cmp_field_values(field, bound1->value, bound2->value);
 			else if (coercible1)
 				res = -o_call_comparator(bound2->comparator, bound2->value, bound1->value);
 			else if (coercible2)
@@ -825,18 +933,21 @@ o_idx_cmp(BTreeDescr *desc,
 												(OBTreeKeyBound *) p1,
 												keyType1,
 												(OTuple *) p2,
-												keyType2);
+												keyType2,
+												NULL);
 		if (IS_BOUND_KEY_TYPE(keyType2))
 			return -o_idx_cmp_key_bound_to_tuple(id,
 												 (OBTreeKeyBound *) p2,
 												 keyType2,
 												 (OTuple *) p1,
-												 keyType1);
+												 keyType1,
+												 NULL);
 		return o_idx_cmp_tuples(id,
 								(OTuple *) p1,
 								keyType1,
 								(OTuple *) p2,
-								keyType2);
+								keyType2,
+								NULL);
 	}
 
 	key1 = (OBTreeKeyBound *) p1;
@@ -872,6 +983,210 @@ o_idx_cmp(BTreeDescr *desc,
 	return 0;
 }
 
+/*
+ * Build a minimal separator key keeping the first `natts` attributes.
+ * Returns a NULL tuple when truncation wouldn't help or isn't possible.
+ */
+static OTuple
+o_idx_truncate_key(BTreeDescr *desc, OTuple key, int natts)
+{
+	OIndexDescr *id = o_get_tree_def(desc);
+
+	return o_tuple_make_truncated_key(id->nonLeafTupdesc, &id->nonLeafSpec,
+									  key, natts);
+}
+
+/*
+ * Prefix-aware version of o_idx_cmp().  Supports the key/tuple combinations
+ * the page binary search produces; everything else falls back to the full
+ * comparison.
+ */
+int
+o_idx_cmp_prefix(BTreeDescr *desc,
+				 void *p1, BTreeKeyType keyType1,
+				 void *p2, BTreeKeyType keyType2,
+				 int *equalAtts)
+{
+	OIndexDescr *id = o_get_tree_def(desc);
+
+	o_type_cmp_datoid = desc->oids.datoid;
+
+	if (IS_BOUND_KEY_TYPE(keyType1) && !IS_BOUND_KEY_TYPE(keyType2))
+		return o_idx_cmp_key_bound_to_tuple(id,
+											(OBTreeKeyBound *) p1,
+											keyType1,
+											(OTuple *) p2,
+											keyType2,
+											equalAtts);
+	if (!IS_BOUND_KEY_TYPE(keyType1) && !IS_BOUND_KEY_TYPE(keyType2))
+		return o_idx_cmp_tuples(id,
+								(OTuple *) p1,
+								keyType1,
+								(OTuple *) p2,
+								keyType2,
+								equalAtts);
+
+	*equalAtts = 0;
+	return o_idx_cmp(desc, p1, keyType1, p2, keyType2);
+}
+
+/*
+ * Pack up to the first 8 bytes of a binary-comparable byte string into an
+ * uint64 so that unsigned comparison of the results matches memcmp() order
+ * of the originals.  Shorter strings are zero-padded, which sorts a proper
+ * prefix before its extensions, consistently with memcmp-then-length
+ * comparators.
+ */
+static uint64
+o_abbrev_bytes(const unsigned char *data, Size len)
+{
+	uint64		result = 0;
+	Size		i,
+				n = Min(len, sizeof(uint64));
+
+	for (i = 0; i < n; i++)
+		result |= (uint64) data[i] << (56 - i * 8);
+	return result;
+}
+
+/*
+ * Compute a 64-bit order-preserving abbreviation of the first key field.
+ *
+ * Only ascending non-null values of types with a binary-comparable
+ * normalized form are abbreviated: integers, ctids and other types whose
+ * native representation already sorts, floats after the usual sign-flip
+ * transform, and byte-wise ordered varlenas (bytea, uuid, and text under
+ * the C collation).  Everything else falls back to the comparator-based
+ * search.
+ */
+static bool
+o_idx_key_abbrev(BTreeDescr *desc, void *p, BTreeKeyType kind, uint64 *abbrev)
+{
+	OIndexDescr *id = o_get_tree_def(desc);
+	OIndexField *field = &id->fields[0];
+	ItemPointer iptr;
+	Datum		value;
+	bool		isnull;
+
+	if (!field->ascending)
+		return false;
+
+	if (IS_BOUND_KEY_TYPE(kind))
+	{
+		OBTreeValueBound *bound = &((OBTreeKeyBound *) p)->keys[0];
+
+		if ((bound->flags & O_VALUE_BOUND_NO_VALUE) ||
+			!o_bound_is_coercible(bound, field))
+			return false;
+		value = bound->value;
+	}
+	else
+	{
+		OTuple	   *tuple = (OTuple *) p;
+		TupleDesc	tupdesc;
+		OTupleFixedFormatSpec *spec;
+		int			attnum;
+
+		Assert(kind == BTreeKeyLeafTuple || kind == BTreeKeyNonLeafKey);
+		if (kind == BTreeKeyLeafTuple)
+		{
+			tupdesc = id->leafTupdesc;
+			spec = &id->leafSpec;
+		}
+		else
+		{
+			tupdesc = id->nonLeafTupdesc;
+			spec = &id->nonLeafSpec;
+		}
+		attnum = OIndexKeyAttnumToTupleAttnum(kind, id, 1);
+		value = o_fastgetattr(*tuple, attnum, tupdesc, spec, &isnull);
+		if (isnull)
+			return false;
+	}
+
+	switch (field->inputtype)
+	{
+		case INT2OID:
+			*abbrev = (uint64) (int64) DatumGetInt16(value) ^ (UINT64CONST(1) << 63);
+			break;
+		case INT4OID:
+			*abbrev = (uint64) (int64) DatumGetInt32(value) ^ (UINT64CONST(1) << 63);
+			break;
+		case INT8OID:
+			*abbrev = (uint64) DatumGetInt64(value) ^ (UINT64CONST(1) << 63);
+			break;
+		case OIDOID:
+			*abbrev = (uint64) DatumGetObjectId(value);
+			break;
+		case TIDOID:
+			iptr = DatumGetItemPointer(value);
+			*abbrev = ((uint64) ItemPointerGetBlockNumberNoCheck(iptr) << 16) |
+				(uint64) ItemPointerGetOffsetNumberNoCheck(iptr);
+			break;
+		case DATEOID:
+			*abbrev = (uint64) (int64) DatumGetInt32(value) ^ (UINT64CONST(1) << 63);
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			*abbrev = (uint64) DatumGetInt64(value) ^ (UINT64CONST(1) << 63);
+			break;
+		case FLOAT4OID:
+		case FLOAT8OID:
+			{
+				double		val;
+				uint64		bits;
+
+				if (field->inputtype == FLOAT4OID)
+					val = (double) DatumGetFloat4(value);
+				else
+					val = DatumGetFloat8(value);
+				if (isnan(val))
+				{
+					/* NaNs compare equal and sort after everything else */
+					*abbrev = PG_UINT64_MAX;
+					break;
+				}
+
+				/*
+				 * -0 and +0 compare equal, but their bit patterns differ;
+				 * collapse them so equal keys get equal abbreviations.
+				 */
+				if (val == 0)
+					val = 0;
+				memcpy(&bits, &val, sizeof(bits));
+				if (bits & (UINT64CONST(1) << 63))
+					bits = ~bits;
+				else
+					bits |= UINT64CONST(1) << 63;
+				*abbrev = bits;
+				break;
+			}
+		case UUIDOID:
+			*abbrev = o_abbrev_bytes((const unsigned char *) DatumGetPointer(value),
+									 16);
+			break;
+		case TEXTOID:
+		case VARCHAROID:
+			if (!lc_collate_is_c(field->collation))
+				return false;
+			/* FALLTHROUGH */
+		case BYTEAOID:
+			{
+				struct varlena *vlena = (struct varlena *) DatumGetPointer(value);
+
+				if (VARATT_IS_EXTERNAL(vlena) || VARATT_IS_COMPRESSED(vlena))
+					return false;
+				*abbrev = o_abbrev_bytes((const unsigned char *) VARDATA_ANY(vlena),
+										 VARSIZE_ANY_EXHDR(vlena));
+				break;
+			}
+		default:
+			return false;
+	}
+
+	return true;
+}
+
 static bool
 pk_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 			  OTuple oldTuple, OTupleXactInfo oldXactInfo, bool oldDeleted,
@@ -986,9 +1301,11 @@ o_key_to_jsonb(BTreeDescr *desc, OTuple key, JsonbParseState **state)
 	OIndexDescr *id = o_get_tree_def(desc);
 
 	(void) pushJsonbValue(state, WJB_BEGIN_OBJECT, NULL);
+	/* truncated separator keys carry fewer attributes than the tupdesc */
 	o_key_to_jsonb_internal(id->nonLeafTupdesc,
 							&id->nonLeafSpec,
-							id->nonLeafTupdesc->natts,
+							Min(id->nonLeafTupdesc->natts,
+								o_tuple_natts(key, &id->nonLeafSpec)),
 							key, state);
 	return pushJsonbValue(state, WJB_END_OBJECT, NULL);
 }
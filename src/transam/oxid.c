@@ -29,18 +29,55 @@
 
 #define	COMMITSEQNO_SPECIAL_BIT (UINT64CONST(1) << 63)
 #define COMMITSEQNO_SPECIAL_COMMITTING_BIT (1)
+#define COMMITSEQNO_SPECIAL_RESERVED_BIT (2)
 #define COMMITSEQNO_IS_SPECIAL(csn) ((csn) & COMMITSEQNO_SPECIAL_BIT)
+#define COMMITSEQNO_IS_RESERVED(csn) \
+	(COMMITSEQNO_IS_SPECIAL(csn) && ((csn) & COMMITSEQNO_SPECIAL_RESERVED_BIT))
 #define COMMITSEQNO_GET_LXID(csn) (((csn) >> 31) & 0xFFFFFFFF)
 #define COMMITSEQNO_GET_PROCNUM(csn) (((csn) >> 15) & 0xFFFF)
 #define COMMITSEQNO_MAKE_SPECIAL(procnum, lxid, committing) \
 	(COMMITSEQNO_SPECIAL_BIT | ((uint64) procnum << 15) | \
 	 ((uint64) lxid << 31) | \
 	 ((committing) ? COMMITSEQNO_SPECIAL_COMMITTING_BIT : 0))
+#define COMMITSEQNO_MAKE_RESERVED(procnum, tag) \
+	(COMMITSEQNO_SPECIAL_BIT | COMMITSEQNO_SPECIAL_RESERVED_BIT | \
+	 ((uint64) procnum << 15) | ((uint64) tag << 31))
+
+/*
+ * Don't consume a batch-reserved oxid as aborted until nextXid went at least
+ * this far beyond it: the owner is probably still going to claim it.
+ */
+#define RESERVED_OXID_CONSUME_SLACK (2048)
 
 static OXid curOxid = InvalidOXid;
 static pg_atomic_uint64 *xidBuffer;
 static LocalTransactionId curLocalXid;
 
+/*
+ * A small backend-local direct-mapped cache of final oxid => csn
+ * resolutions.  A scan over a page modified by a handful of transactions
+ * re-resolves the same oxids over and over, paying for an o_buffers lookup
+ * each time once the oxid got out of the in-memory circular buffer window.
+ * Only final resolutions (committed, aborted, frozen) are cached: they never
+ * change and oxids are never reused, so the cache needs no invalidation.
+ */
+#define OXID_CSN_CACHE_SIZE (64)
+typedef struct
+{
+	OXid		oxid;
+	CommitSeqNo csn;
+} OXidCsnCacheEntry;
+static OXidCsnCacheEntry oxidCsnCache[OXID_CSN_CACHE_SIZE];
+static bool oxidCsnCacheInitialized = false;
+
+/*
+ * The locally reserved oxid range [reservedOxid, reservedXmax) and the value
+ * its xidmap slots were marked with.  See get_current_oxid().
+ */
+static OXid reservedOxid = InvalidOXid;
+static OXid reservedXmax = InvalidOXid;
+static CommitSeqNo reservedSlotValue = COMMITSEQNO_FROZEN;
+
 XidMeta    *xid_meta;
 
 static OBuffersDesc buffersDesc = {
@@ -51,6 +88,7 @@ static OBuffersDesc buffersDesc = {
 };
 
 static void advance_global_xmin(OXid newXid);
+static void advance_run_xmin_loop(void);
 
 Size
 oxid_shmem_needs(void)
@@ -276,6 +314,33 @@ fsync_xidmap_range(OXid xmin, OXid xmax, uint32 wait_event_info)
 				   wait_event_info);
 }
 
+/*
+ * Write the oldest part of the xidmap circular buffer out when oxid
+ * allocation is close to the window end.  Called from the background writer,
+ * so that get_current_oxid() doesn't have to do the write synchronously on
+ * the foreground commit path.
+ */
+void
+write_xidsmap_ahead(void)
+{
+	OXid		nextXid = pg_atomic_read_u64(&xid_meta->nextXid);
+	OXid		writtenXmin = pg_atomic_read_u64(&xid_meta->writtenXmin);
+
+	/* Keep at least 1/8 of the window ahead of nextXid written out */
+	if (nextXid + xid_circular_buffer_size / 8 <
+		writtenXmin + xid_circular_buffer_size)
+		return;
+
+	advance_global_xmin(nextXid);
+
+	if (LWLockAcquireOrWait(&xid_meta->xidMapWriteLock, LW_EXCLUSIVE))
+	{
+		write_xidsmap(nextXid + xid_circular_buffer_size / 8 -
+					  xid_circular_buffer_size);
+		LWLockRelease(&xid_meta->xidMapWriteLock);
+	}
+}
+
 /*
  * Wait particular oxid to finish or oxid_notify() call.  Returns true if
  * oxid was finished.
@@ -499,6 +564,13 @@ advance_global_xmin(OXid newXid)
 										 newCheckpointXmaxNum + 1),
 									 newCleanedNum - 1);
 	}
+
+	/*
+	 * runXmin might be stalled by an unclaimed oxid reservation of an idle
+	 * backend, which no commit is going to consume.  Rescue it here: this
+	 * function is called once per a fair amount of oxid allocations.
+	 */
+	advance_run_xmin_loop();
 }
 
 /*
@@ -550,6 +622,76 @@ advance_oxids(OXid new_xid)
 }
 
 
+/*
+ * Make new xidmap item for given oxid: publish the vxid mapping and
+ * construct the special csn pointing to it.
+ */
+static CommitSeqNo
+make_own_special_csn(OXid oxid)
+{
+	XidVXidMapElement *vxidElem;
+
+	curLocalXid = ++(GET_CUR_PROCDATA()->lastLXid);
+	vxidElem = &GET_CUR_PROCDATA()->vxids[curLocalXid % PROC_XID_ARRAY_SIZE];
+
+	vxidElem->oxid = oxid;
+	vxidElem->vxid.backendId = MyProc->backendId;
+	vxidElem->vxid.localTransactionId = MyProc->lxid;
+
+	return COMMITSEQNO_MAKE_SPECIAL(MyProc->pgprocno, curLocalXid, false);
+}
+
+/*
+ * Try to claim the next oxid of the locally reserved range.  The claim is a
+ * compare-and-swap of the reservation mark with the regular special csn: if
+ * runXmin advancement has consumed the reservation meanwhile, the swap fails
+ * and the whole remaining range is lost (consumption goes in oxid order).
+ */
+static OXid
+claim_reserved_oxid(void)
+{
+	while (reservedOxid < reservedXmax)
+	{
+		OXid		oxid = reservedOxid++;
+		CommitSeqNo expected = reservedSlotValue;
+		CommitSeqNo specialCsn = make_own_special_csn(oxid);
+
+		if (pg_atomic_compare_exchange_u64(&xidBuffer[oxid % xid_circular_buffer_size],
+										   &expected, specialCsn))
+			return oxid;
+
+		reservedOxid = reservedXmax;
+	}
+
+	return InvalidOXid;
+}
+
+/*
+ * Mark xidmap slots of the range (newOxid, newOxid + batchSize) as reserved
+ * by the current backend and remember the range locally.  The mark value is
+ * tagged with a fresh local xid, so a claim can't confuse it with an another
+ * reservation wrapped around the circular buffer.
+ */
+static void
+reserve_oxid_range(OXid newOxid, int batchSize)
+{
+	OXid		oxid;
+
+	if (batchSize <= 1)
+		return;
+
+	reservedSlotValue = COMMITSEQNO_MAKE_RESERVED(MyProc->pgprocno,
+												  ++(GET_CUR_PROCDATA()->lastLXid));
+	for (oxid = newOxid + 1; oxid < newOxid + batchSize; oxid++)
+	{
+		Assert(pg_atomic_read_u64(&xidBuffer[oxid % xid_circular_buffer_size]) == COMMITSEQNO_FROZEN);
+		pg_atomic_write_u64(&xidBuffer[oxid % xid_circular_buffer_size],
+							reservedSlotValue);
+	}
+	reservedOxid = newOxid + 1;
+	reservedXmax = newOxid + batchSize;
+}
+
 /*
  * Get curent OrioleDB xid (oxid).  Assign new oxid it's not done yet.
  */
@@ -561,50 +703,54 @@ get_current_oxid(void)
 
 	if (!OXidIsValid(curOxid))
 	{
-		OXid		newOxid = pg_atomic_fetch_add_u64(&xid_meta->nextXid, 1);
-		XidVXidMapElement *vxidElem;
+		OXid		newOxid = claim_reserved_oxid();
 
-		/*
-		 * Advance xmin every 10th part of circular buffer.  That should
-		 * prevent unnecessry circular buffer overrun.
-		 */
-		if (newOxid > pg_atomic_read_u64(&xid_meta->lastXidWhenUpdatedGlobalXmin) + xid_circular_buffer_size / 10)
-			advance_global_xmin(newOxid);
-
-		/*
-		 * Write some xids out of circular buffer if needed.  We always keep
-		 * one COMMITSEQNO_FROZEN in circular buffers as a delimited beween
-		 * the future and the past.  This helps protect runXmin from growing
-		 * bigger than nextXid.
-		 */
-		while (newOxid >= pg_atomic_read_u64(&xid_meta->writtenXmin) + xid_circular_buffer_size - 1)
+		if (!OXidIsValid(newOxid))
 		{
-			advance_global_xmin(newOxid);
-			if (newOxid >= pg_atomic_read_u64(&xid_meta->writtenXmin) + xid_circular_buffer_size - 1)
+			int			batchSize = Max(oxid_batch_size, 1);
+			OXid		lastOxid;
+
+			newOxid = pg_atomic_fetch_add_u64(&xid_meta->nextXid, batchSize);
+			lastOxid = newOxid + batchSize - 1;
+
+			/*
+			 * Advance xmin every 10th part of circular buffer.  That should
+			 * prevent unnecessry circular buffer overrun.
+			 */
+			if (newOxid > pg_atomic_read_u64(&xid_meta->lastXidWhenUpdatedGlobalXmin) + xid_circular_buffer_size / 10)
+				advance_global_xmin(newOxid);
+
+			/*
+			 * Write some xids out of circular buffer if needed.  We always
+			 * keep one COMMITSEQNO_FROZEN in circular buffers as a delimited
+			 * beween the future and the past.  This helps protect runXmin
+			 * from growing bigger than nextXid.
+			 */
+			while (lastOxid >= pg_atomic_read_u64(&xid_meta->writtenXmin) + xid_circular_buffer_size - 1)
 			{
-				if (LWLockAcquireOrWait(&xid_meta->xidMapWriteLock, LW_EXCLUSIVE))
+				advance_global_xmin(newOxid);
+				if (lastOxid >= pg_atomic_read_u64(&xid_meta->writtenXmin) + xid_circular_buffer_size - 1)
 				{
-					write_xidsmap(newOxid - xid_circular_buffer_size);
-					LWLockRelease(&xid_meta->xidMapWriteLock);
+					if (LWLockAcquireOrWait(&xid_meta->xidMapWriteLock, LW_EXCLUSIVE))
+					{
+						write_xidsmap(lastOxid - xid_circular_buffer_size);
+						LWLockRelease(&xid_meta->xidMapWriteLock);
+					}
 				}
 			}
-		}
 
-		/*
-		 * Make new xidmap item and write it to the circular buffer.
-		 */
-		curLocalXid = ++(GET_CUR_PROCDATA()->lastLXid);
-		vxidElem = &GET_CUR_PROCDATA()->vxids[curLocalXid % PROC_XID_ARRAY_SIZE];
-
-		vxidElem->oxid = newOxid;
-		vxidElem->vxid.backendId = MyProc->backendId;
-		vxidElem->vxid.localTransactionId = MyProc->lxid;
-
-		Assert(pg_atomic_read_u64(&xidBuffer[newOxid % xid_circular_buffer_size]) == COMMITSEQNO_FROZEN);
-		pg_atomic_write_u64(&xidBuffer[newOxid % xid_circular_buffer_size],
-							COMMITSEQNO_MAKE_SPECIAL(MyProc->pgprocno,
-													 curLocalXid,
-													 false));
+			/*
+			 * Make new xidmap item and write it to the circular buffer.  The
+			 * rest of the batch is marked as reserved and claimed by the
+			 * subsequent transactions of this backend, saving them the
+			 * atomic increment of nextXid and the checks above.
+			 */
+			Assert(pg_atomic_read_u64(&xidBuffer[newOxid % xid_circular_buffer_size]) == COMMITSEQNO_FROZEN);
+			pg_atomic_write_u64(&xidBuffer[newOxid % xid_circular_buffer_size],
+								make_own_special_csn(newOxid));
+
+			reserve_oxid_range(newOxid, batchSize);
+		}
 		curOxid = newOxid;
 	}
 
@@ -658,28 +804,82 @@ current_oxid_precommit(void)
 	pg_write_barrier();
 }
 
+/*
+ * Consume a batch-reserved oxid, which was never claimed by its owner, as
+ * aborted, so runXmin can be advanced past it.  Returns false if the
+ * reservation is too fresh, raced with a claim, or can't be consumed right
+ * now.
+ */
+static bool
+consume_reserved_oxid(OXid oxid, CommitSeqNo csn)
+{
+	Assert(COMMITSEQNO_IS_RESERVED(csn));
+
+	/* Give the owner a chance to claim the recently reserved oxids. */
+	if (pg_atomic_read_u64(&xid_meta->nextXid) <
+		oxid + RESERVED_OXID_CONSUME_SLACK)
+		return false;
+
+	if (oxid >= pg_atomic_read_u64(&xid_meta->writeInProgressXmin))
+		return pg_atomic_compare_exchange_u64(&xidBuffer[oxid % xid_circular_buffer_size],
+											  &csn, COMMITSEQNO_ABORTED);
+
+	/*
+	 * The reservation mark was wiped out of the circular buffer, rewrite it
+	 * in o_buffers.  Skip the range a concurrent write_xidsmap() is working
+	 * on: set_oxid_csn() would wait on xidMapWriteLock, which the caller
+	 * might be holding.
+	 */
+	if (oxid < pg_atomic_read_u64(&xid_meta->writtenXmin))
+	{
+		set_oxid_csn(oxid, COMMITSEQNO_ABORTED);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Advance runXmin past the finished oxids and the stale unclaimed
+ * reservations following it.
+ */
 static void
-advance_run_xmin(OXid oxid)
+advance_run_xmin_loop(void)
 {
 	OXid		run_xmin;
 	CommitSeqNo csn;
 
-	pg_read_barrier();
-
 	run_xmin = pg_atomic_read_u64(&xid_meta->runXmin);
-	if (run_xmin == oxid)
+	while (true)
 	{
-		while (pg_atomic_compare_exchange_u64(&xid_meta->runXmin,
-											  &run_xmin, run_xmin + 1))
+		csn = map_oxid_csn(run_xmin);
+		if (COMMITSEQNO_IS_RESERVED(csn))
 		{
-			run_xmin++;
-			csn = map_oxid_csn(run_xmin);
-			if (COMMITSEQNO_IS_SPECIAL(csn) || COMMITSEQNO_IS_FROZEN(csn))
+			if (!consume_reserved_oxid(run_xmin, csn))
 				break;
 		}
+		else if (COMMITSEQNO_IS_SPECIAL(csn) || COMMITSEQNO_IS_FROZEN(csn))
+			break;
+
+		if (!pg_atomic_compare_exchange_u64(&xid_meta->runXmin,
+											&run_xmin, run_xmin + 1))
+			break;
+		run_xmin++;
 	}
 }
 
+static void
+advance_run_xmin(OXid oxid)
+{
+	OXid		run_xmin;
+
+	pg_read_barrier();
+
+	run_xmin = pg_atomic_read_u64(&xid_meta->runXmin);
+	if (run_xmin == oxid)
+		advance_run_xmin_loop();
+}
+
 void
 current_oxid_commit(CommitSeqNo csn)
 {
@@ -725,16 +925,35 @@ oxid_get_csn(OXid oxid)
 {
 	CommitSeqNo csn;
 	SpinDelayStatus status;
+	OXidCsnCacheEntry *cacheEntry;
 
 	if (oxid == BootstrapTransactionId)
 		return COMMITSEQNO_FROZEN;
 
+	if (!oxidCsnCacheInitialized)
+	{
+		int			i;
+
+		for (i = 0; i < OXID_CSN_CACHE_SIZE; i++)
+			oxidCsnCache[i].oxid = InvalidOXid;
+		oxidCsnCacheInitialized = true;
+	}
+
+	cacheEntry = &oxidCsnCache[oxid % OXID_CSN_CACHE_SIZE];
+	if (cacheEntry->oxid == oxid)
+		return cacheEntry->csn;
+
 	init_local_spin_delay(&status);
 
 	while (true)
 	{
 		if (oxid < pg_atomic_read_u64(&xid_meta->globalXmin))
+		{
+			/* globalXmin only advances, the oxid stays frozen */
+			cacheEntry->oxid = oxid;
+			cacheEntry->csn = COMMITSEQNO_FROZEN;
 			return COMMITSEQNO_FROZEN;
+		}
 
 		csn = map_oxid_csn(oxid);
 		if (COMMITSEQNO_IS_SPECIAL(csn) && (csn & COMMITSEQNO_SPECIAL_COMMITTING_BIT))
@@ -748,6 +967,9 @@ oxid_get_csn(OXid oxid)
 	if (COMMITSEQNO_IS_SPECIAL(csn))
 		return COMMITSEQNO_INPROGRESS;
 
+	cacheEntry->oxid = oxid;
+	cacheEntry->csn = csn;
+
 	return csn;
 }
 
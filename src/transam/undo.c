@@ -27,13 +27,19 @@
 #include "utils/o_buffers.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
+#include "workers/rollback.h"
 
 #include "access/transam.h"
+#include "catalog/pg_type_d.h"
+#include "funcapi.h"
 #include "miscadmin.h"
+#include "nodes/execnodes.h"
 #include "pgstat.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/tuplestore.h"
 
 #define GET_UNDO_REC(loc) (o_undo_buffers + (loc) % undo_circular_buffer_size)
 #define UNDO_FILE_SIZE (0x4000000)
@@ -100,6 +106,7 @@ UndoItemTypeDescr undoItemTypeDescrs[] = {
 
 
 PG_FUNCTION_INFO_V1(orioledb_has_retained_undo);
+PG_FUNCTION_INFO_V1(orioledb_undo_retained_size);
 
 UndoMeta   *undo_meta = NULL;
 
@@ -108,6 +115,20 @@ bool		oxid_needs_wal_flush = false;
 
 static Size reserved_undo_size = 0;
 
+/*
+ * Subtransaction boundaries registered by undo_subxact_callback(), but not
+ * materialized as undo stack items yet.  Exception-block-heavy PL code starts
+ * and releases subtransactions at high rate while most of them never touch
+ * the undo log.  So, we only record the parent subids here and write the
+ * actual SubXactUndoStackItem's (and the savepoint WAL records) on the first
+ * undo reservation made under the boundary.  The array lives in
+ * TopMemoryContext and is reused across transactions.
+ */
+static SubTransactionId *pendingSubxactSubids = NULL;
+static int	pendingSubxactCount = 0;
+static int	pendingSubxactAllocated = 0;
+static bool pendingSubxactFlushInProgress = false;
+
 static OBuffersDesc buffersDesc = {
 	.singleFileSize = UNDO_FILE_SIZE,
 	.filenameTemplate = ORIOLEDB_UNDO_DIR "/%02X%08X",
@@ -116,6 +137,7 @@ static OBuffersDesc buffersDesc = {
 };
 
 static bool wait_for_reserved_location(UndoLocation undoLocationToWait);
+static void flush_pending_subxact_undo_items(bool waitForUndoLocation);
 
 Size
 undo_shmem_needs(void)
@@ -181,6 +203,7 @@ update_min_undo_locations(bool have_lock, bool do_cleanup)
 				minTransactionRetainLocation,
 				lastUsedLocation;
 	UndoLocation oldCleanedLocation,
+				newCleanedLocation,
 				oldCheckpointStartLocation,
 				oldCheckpointEndLocation,
 				newCheckpointStartLocation,
@@ -263,13 +286,28 @@ update_min_undo_locations(bool have_lock, bool do_cleanup)
 		newCheckpointStartLocation = pg_atomic_read_u64(&undo_meta->checkpointRetainStartLocation);
 		newCheckpointEndLocation = pg_atomic_read_u64(&undo_meta->checkpointRetainEndLocation);
 
-		if (oldCleanedLocation != minRetainLocation ||
+		/*
+		 * Rate-limit the trimming: release of a long-retained location makes
+		 * a whole tail of undo files reclaimable at once, and unlinking them
+		 * all in one pass would compete with foreground I/O.  Advance the
+		 * cleaned location by at most orioledb.undo_trim_max_files files and
+		 * leave the rest to the subsequent passes (the background writer
+		 * makes one every cycle).
+		 */
+		newCleanedLocation = minRetainLocation;
+		if (undo_trim_max_files > 0 &&
+			newCleanedLocation / UNDO_FILE_SIZE >
+			oldCleanedLocation / UNDO_FILE_SIZE + undo_trim_max_files)
+			newCleanedLocation = (oldCleanedLocation / UNDO_FILE_SIZE +
+								  undo_trim_max_files) * UNDO_FILE_SIZE;
+
+		if (oldCleanedLocation != newCleanedLocation ||
 			oldCheckpointStartLocation != newCheckpointStartLocation ||
 			oldCheckpointEndLocation != newCheckpointEndLocation)
 		{
 			pg_atomic_write_u64(&undo_meta->cleanedCheckpointStartLocation, newCheckpointStartLocation);
 			pg_atomic_write_u64(&undo_meta->cleanedCheckpointEndLocation, newCheckpointEndLocation);
-			pg_atomic_write_u64(&undo_meta->cleanedLocation, minRetainLocation);
+			pg_atomic_write_u64(&undo_meta->cleanedLocation, newCleanedLocation);
 		}
 		else
 		{
@@ -284,7 +322,7 @@ update_min_undo_locations(bool have_lock, bool do_cleanup)
 	if (do_cleanup)
 	{
 		int64		oldCleanedNum = oldCleanedLocation / UNDO_FILE_SIZE,
-					newCleanedNum = minRetainLocation / UNDO_FILE_SIZE,
+					newCleanedNum = newCleanedLocation / UNDO_FILE_SIZE,
 					oldCheckpointStartNum = oldCheckpointStartLocation / UNDO_FILE_SIZE,
 					oldCheckpointEndNum = oldCheckpointEndLocation / UNDO_FILE_SIZE,
 					newCheckpointStartNum = newCheckpointStartLocation / UNDO_FILE_SIZE,
@@ -515,20 +553,48 @@ o_add_branch_undo_item(UndoLocation newLocation)
 
 /*
  * Walk through the undo stack calling the callbacks for each item.
+ *
+ * With allowParallel, long abort walks hand the B-tree modify and row lock
+ * items over to the parallel rollback workers, see workers/rollback.c.  The
+ * walk itself stays single-threaded: it reads every item anyway to follow
+ * the chain and maintain the "on commit" location.
  */
 static UndoLocation
 walk_undo_range(UndoLocation location, UndoLocation toLoc, UndoItemBuf *buf,
 				OXid oxid, bool abort, UndoLocation *onCommitLocation,
-				bool changeCountsValid)
+				bool changeCountsValid, bool allowParallel)
 {
 	UndoStackItem *item;
 	UndoItemTypeDescr *descr;
+	uint64		itemsWalked = 0;
+	bool		routed;
 
 	while (UndoLocationIsValid(location) && (location > toLoc || !UndoLocationIsValid(toLoc)))
 	{
 		item = undo_item_buf_read_item(buf, location);
 		descr = item_type_get_descr(item->type);
-		descr->callback(location, item, oxid, abort, changeCountsValid);
+
+		routed = false;
+		if (allowParallel)
+		{
+			itemsWalked++;
+			if (!o_parallel_rollback_active() &&
+				itemsWalked == PARALLEL_ROLLBACK_MIN_ITEMS)
+				o_parallel_rollback_begin(oxid, changeCountsValid);
+			if (o_parallel_rollback_active())
+			{
+				routed = o_parallel_rollback_route(location, item);
+
+				/*
+				 * The remaining item types observe the state left by the
+				 * preceding (newer) items, so drain the workers first.
+				 */
+				if (!routed)
+					o_parallel_rollback_barrier();
+			}
+		}
+		if (!routed)
+			descr->callback(location, item, oxid, abort, changeCountsValid);
 
 		/*
 		 * Update location of the last item, which needs an action on commit,
@@ -560,6 +626,23 @@ walk_undo_range(UndoLocation location, UndoLocation toLoc, UndoItemBuf *buf,
 	return location;
 }
 
+/*
+ * Reads the undo item at the given location and applies its abort callback.
+ * Used by the parallel rollback workers, see workers/rollback.c.
+ */
+void
+apply_undo_item(UndoLocation location, OXid oxid, bool changeCountsValid)
+{
+	UndoItemBuf buf;
+	UndoStackItem *item;
+
+	init_undo_item_buf(&buf);
+	item = undo_item_buf_read_item(&buf, location);
+	item_type_get_descr(item->type)->callback(location, item, oxid, true,
+											  changeCountsValid);
+	free_undo_item_buf(&buf);
+}
+
 /*
  * Apply undo branches: parts of transaction undo chain, which should be already
  * aborted.  This is used during recovery: despite some parts of chain are
@@ -581,7 +664,7 @@ apply_undo_branches(OXid oxid)
 		item = (BranchUndoStackItem *) undo_item_buf_read_item(&buf, location);
 		location = item->prevBranchLocation;
 		walk_undo_range(item->longPathLocation, item->header.prev, &buf,
-						oxid, true, NULL, false);
+						oxid, true, NULL, false, false);
 	}
 	free_undo_item_buf(&buf);
 }
@@ -623,7 +706,8 @@ walk_undo_stack(OXid oxid, UndoStackLocations *toLocation, bool abortTrx,
 		Assert(!toLocation);
 		location = pg_atomic_read_u64(&sharedLocations->onCommitLocation);
 		location = walk_undo_range(location, InvalidUndoLocation, &buf,
-								   oxid, false, NULL, changeCountsValid);
+								   oxid, false, NULL, changeCountsValid,
+								   false);
 		Assert(!UndoLocationIsValid(location));
 		newOnCommitLocation = InvalidUndoLocation;
 	}
@@ -638,7 +722,9 @@ walk_undo_stack(OXid oxid, UndoStackLocations *toLocation, bool abortTrx,
 		location = walk_undo_range(location,
 								   toLocation ? toLocation->location : InvalidUndoLocation,
 								   &buf, oxid, true, &newOnCommitLocation,
-								   changeCountsValid);
+								   changeCountsValid, true);
+		if (o_parallel_rollback_active())
+			o_parallel_rollback_end();
 	}
 
 	/*
@@ -844,6 +930,13 @@ reserve_undo_size_extended(UndoReserveType type, Size size,
 	Assert(type == UndoReserveTxn);
 	Assert(size > 0);
 
+	/*
+	 * The transaction is about to write undo: materialize the subtransaction
+	 * boundaries lazily registered by undo_subxact_callback().
+	 */
+	if (pendingSubxactCount > 0 && !pendingSubxactFlushInProgress)
+		flush_pending_subxact_undo_items(waitForUndoLocation);
+
 	if (reserved_undo_size >= size)
 		return true;
 
@@ -856,6 +949,13 @@ reserve_undo_size_extended(UndoReserveType type, Size size,
 		pg_atomic_read_u64(&undo_meta->writtenLocation) + undo_circular_buffer_size)
 		return true;
 
+	/*
+	 * The circular buffer can't be reused up to our reservation yet: undo
+	 * retained by other transactions or snapshots is in the way.
+	 */
+	OTRACEPOINT(OTRACEPOINT_UNDO_RETENTION_STALL, location + size,
+				pg_atomic_read_u64(&undo_meta->writtenLocation));
+
 	update_min_undo_locations(false, waitForUndoLocation);
 
 	if (!check_reserved_undo_location(location + size, &minProcReservedLocation,
@@ -1124,6 +1224,16 @@ undo_xact_callback(XactEvent event, void *arg)
 	 */
 	ea_counters = NULL;
 
+	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT)
+	{
+		/*
+		 * Pending subtransaction boundaries die with the transaction.  Drop
+		 * them before abort processing reserves undo and tries to flush.
+		 */
+		pendingSubxactCount = 0;
+		pendingSubxactFlushInProgress = false;
+	}
+
 	if (!OXidIsValid(oxid))
 	{
 		switch (event)
@@ -1204,35 +1314,104 @@ undo_xact_callback(XactEvent event, void *arg)
 			OPagePool  *pool = get_ppool((OPagePoolType) i);
 
 			ppool_release_reserved(pool, PPOOL_RESERVE_MASK_ALL);
+			ppool_flush_magazine(pool);
 		}
 
 		free_retained_undo_location();
 	}
 }
 
-void
-add_subxact_undo_item(SubTransactionId parentSubid)
+static void
+add_subxact_undo_item_extended(SubTransactionId parentSubid,
+							   bool waitForUndoLocation)
 {
 	SubXactUndoStackItem *item;
 	UndoStackSharedLocations *sharedLocations = GET_CUR_UNDO_STACK_LOCATIONS();
 	UndoLocation location;
 	Size		size;
+	Size		prevReservedSize = reserved_undo_size;
 
 	size = sizeof(SubXactUndoStackItem);
 
-	item = (SubXactUndoStackItem *) get_undo_record_unreserved(UndoReserveTxn,
-															   &location,
-															   MAXALIGN(size));
+	/*
+	 * We might be called from reserve_undo_size_extended() while the caller
+	 * already holds a reservation: reserve on top of it and give it back
+	 * untouched.
+	 */
+	(void) reserve_undo_size_extended(UndoReserveTxn,
+									  prevReservedSize + 2 * MAXALIGN(size),
+									  waitForUndoLocation, true);
+	item = (SubXactUndoStackItem *) get_undo_record(UndoReserveTxn, &location,
+													MAXALIGN(size));
 	item->prevSubLocation = pg_atomic_read_u64(&sharedLocations->subxactLocation);
 	item->parentSubid = parentSubid;
 	item->header.type = SubXactUndoItemType;
 	item->header.indexType = oIndexPrimary;
 	item->header.itemSize = size;
 	add_new_undo_stack_item(location);
-	release_undo_size(UndoReserveTxn);
+	if (prevReservedSize == 0)
+		release_undo_size(UndoReserveTxn);
 	pg_atomic_write_u64(&sharedLocations->subxactLocation, location);
 }
 
+void
+add_subxact_undo_item(SubTransactionId parentSubid)
+{
+	add_subxact_undo_item_extended(parentSubid, true);
+}
+
+/*
+ * Remember the subtransaction boundary to be materialized on the first undo
+ * reservation made under it, see flush_pending_subxact_undo_items().
+ */
+static void
+add_pending_subxact_undo_item(SubTransactionId parentSubid)
+{
+	if (pendingSubxactCount >= pendingSubxactAllocated)
+	{
+		pendingSubxactAllocated = Max(pendingSubxactAllocated * 2, 16);
+		if (pendingSubxactSubids == NULL)
+			pendingSubxactSubids = (SubTransactionId *)
+				MemoryContextAlloc(TopMemoryContext,
+								   sizeof(SubTransactionId) * pendingSubxactAllocated);
+		else
+			pendingSubxactSubids = (SubTransactionId *)
+				repalloc(pendingSubxactSubids,
+						 sizeof(SubTransactionId) * pendingSubxactAllocated);
+	}
+	pendingSubxactSubids[pendingSubxactCount++] = parentSubid;
+}
+
+/*
+ * Materialize the lazily registered subtransaction boundaries, outermost
+ * first.  Runs before the first undo record is actually reserved under the
+ * boundaries, so the undo stack items and the savepoint WAL records appear in
+ * the same order as with eager registration.
+ */
+static void
+flush_pending_subxact_undo_items(bool waitForUndoLocation)
+{
+	pendingSubxactFlushInProgress = true;
+	(void) get_current_oxid();
+	while (pendingSubxactCount > 0)
+	{
+		SubTransactionId subid = pendingSubxactSubids[0];
+
+		add_subxact_undo_item_extended(subid, waitForUndoLocation);
+		add_savepoint_wal_record(subid);
+
+		/*
+		 * Consume the entry only once it's materialized: if the reservation
+		 * errors out, the remaining boundaries stay pending and the
+		 * subtransaction abort handles them as such.
+		 */
+		pendingSubxactCount--;
+		memmove(&pendingSubxactSubids[0], &pendingSubxactSubids[1],
+				pendingSubxactCount * sizeof(SubTransactionId));
+	}
+	pendingSubxactFlushInProgress = false;
+}
+
 static bool
 search_for_undo_sub_location(UndoStackKind kind, UndoLocation location,
 							 UndoItemBuf *buf, SubTransactionId parentSubid,
@@ -1344,16 +1523,40 @@ undo_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 	switch (event)
 	{
 		case SUBXACT_EVENT_START_SUB:
-			(void) get_current_oxid();
-			add_subxact_undo_item(parentSubid);
-			add_savepoint_wal_record(parentSubid);
+			add_pending_subxact_undo_item(parentSubid);
 			break;
 		case SUBXACT_EVENT_COMMIT_SUB:
 			/* In future we may want to release subxact undo location */
 			break;
 		case SUBXACT_EVENT_ABORT_SUB:
-			rollback_to_savepoint(UndoStackFull, parentSubid, true);
-			add_rollback_to_savepoint_wal_record(parentSubid);
+			{
+				bool		wasPending = false;
+
+				/* An error could be thrown in the middle of a flush */
+				pendingSubxactFlushInProgress = false;
+
+				/*
+				 * Drop the pending boundaries at or inside the aborted
+				 * subtransaction.  If the aborted boundary itself is still
+				 * pending, nothing was written under it: any undo
+				 * reservation would have flushed all pending boundaries.
+				 * Then there is neither undo to roll back nor a savepoint
+				 * WAL record to pair the rollback record with.
+				 */
+				while (pendingSubxactCount > 0 &&
+					   pendingSubxactSubids[pendingSubxactCount - 1] >= parentSubid)
+				{
+					if (pendingSubxactSubids[pendingSubxactCount - 1] == parentSubid)
+						wasPending = true;
+					pendingSubxactCount--;
+				}
+
+				if (!wasPending)
+				{
+					rollback_to_savepoint(UndoStackFull, parentSubid, true);
+					add_rollback_to_savepoint_wal_record(parentSubid);
+				}
+			}
 			break;
 		default:
 			break;
@@ -1396,6 +1599,82 @@ orioledb_has_retained_undo(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(result);
 }
 
+/*
+ * Report the amount of retained undo log per retention cause: one row each
+ * for old snapshots, in-progress transactions and the last checkpoint.  The
+ * values are approximate: the per-proc locations are read without a lock.
+ */
+Datum
+orioledb_undo_retained_size(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	UndoLocation lastUsedLocation,
+				minSnapshotLocation,
+				minTransactionLocation,
+				checkpointStartLocation,
+				checkpointEndLocation;
+	static const char *causes[] = {"snapshot", "transaction", "checkpoint"};
+	uint64		sizes[3];
+	int			i;
+
+	orioledb_check_shmem();
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(2);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "cause", TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "retained_bytes", INT8OID, -1, 0);
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	lastUsedLocation = pg_atomic_read_u64(&undo_meta->lastUsedLocation);
+	minSnapshotLocation = lastUsedLocation;
+	minTransactionLocation = lastUsedLocation;
+	for (i = 0; i < max_procs; i++)
+	{
+		UndoLocation tmp;
+
+		tmp = pg_atomic_read_u64(&oProcData[i].snapshotRetainUndoLocation);
+		minSnapshotLocation = Min(minSnapshotLocation, tmp);
+		tmp = pg_atomic_read_u64(&oProcData[i].transactionUndoRetainLocation);
+		minTransactionLocation = Min(minTransactionLocation, tmp);
+	}
+
+	sizes[0] = lastUsedLocation - minSnapshotLocation;
+	sizes[1] = lastUsedLocation - minTransactionLocation;
+
+	checkpointStartLocation = pg_atomic_read_u64(&undo_meta->checkpointRetainStartLocation);
+	checkpointEndLocation = pg_atomic_read_u64(&undo_meta->checkpointRetainEndLocation);
+	if (UndoLocationIsValid(checkpointStartLocation) &&
+		checkpointEndLocation > checkpointStartLocation)
+		sizes[2] = checkpointEndLocation - checkpointStartLocation;
+	else
+		sizes[2] = 0;
+
+	for (i = 0; i < 3; i++)
+	{
+		Datum		values[2];
+		bool		nulls[2] = {false, false};
+
+		values[0] = CStringGetTextDatum(causes[i]);
+		values[1] = Int64GetDatum((int64) sizes[i]);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 void
 start_autonomous_transaction(OAutonomousTxState *state)
 {
@@ -1404,6 +1683,13 @@ start_autonomous_transaction(OAutonomousTxState *state)
 	state->oxid = get_current_oxid();
 	state->has_retained_undo_location = have_retained_undo_location();
 
+	/*
+	 * Pending subtransaction boundaries belong to the outer transaction:
+	 * suspend flushing them until it's resumed.
+	 */
+	state->flush_pending_subxacts = pendingSubxactFlushInProgress;
+	pendingSubxactFlushInProgress = true;
+
 	if (!local_wal_is_empty())
 		flush_local_wal(false);
 
@@ -1428,6 +1714,7 @@ abort_autonomous_transaction(OAutonomousTxState *state)
 	}
 
 	oxid_needs_wal_flush = state->needs_wal_flush;
+	pendingSubxactFlushInProgress = state->flush_pending_subxacts;
 	set_current_oxid(state->oxid);
 }
 
@@ -1455,6 +1742,7 @@ finish_autonomous_transaction(OAutonomousTxState *state)
 	}
 
 	oxid_needs_wal_flush = state->needs_wal_flush;
+	pendingSubxactFlushInProgress = state->flush_pending_subxacts;
 	set_current_oxid(state->oxid);
 }
 
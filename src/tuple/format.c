@@ -65,6 +65,26 @@ o_tuple_init_reader(OTupleReaderState *state, OTuple tuple, TupleDesc desc,
 	state->estate = estate;
 }
 
+/*
+ * Fast-forward a freshly initialized reader over the fixed-width prefix of
+ * the tuple using the precomputed spec offsets, so a walk towards a later
+ * attribute doesn't re-derive the per-attribute alignment chain.  Only valid
+ * when none of the skipped attributes is null; the caller must have checked
+ * that.
+ */
+void
+o_tuple_reader_skip_fixed_prefix(OTupleReaderState *state,
+								 OTupleFixedFormatSpec *spec)
+{
+	Assert(state->attnum == 0 && !state->slow);
+
+	if (spec->natts == 0 || state->natts < spec->natts)
+		return;
+
+	state->attnum = spec->natts;
+	state->off = spec->len;
+}
+
 static uint32
 o_tuple_next_field_offset(OTupleReaderState *state, Form_pg_attribute att)
 {
@@ -173,6 +193,39 @@ o_tuple_read_next_field(OTupleReaderState *state, bool *isnull)
 	return fetchatt(att, state->tp + off);
 }
 
+/*
+ * Deform the fixed-width prefix of a fixed-format tuple in a single pass.
+ *
+ * Fixed-format tuples have neither a header nor a null bitmap, and all the
+ * first spec->natts attributes are fixed-length and not null.  So, their
+ * offsets are known in advance and the per-attribute alignment and TOAST
+ * checks of o_tuple_read_next_field() can be skipped altogether.
+ *
+ * Returns the number of attributes deformed.
+ */
+int
+o_tuple_deform_fixed(TupleDesc desc, OTupleFixedFormatSpec *spec,
+					 OTuple tuple, int natts, Datum *values, bool *isnull)
+{
+	char	   *tp = (char *) tuple.data;
+	int			i;
+
+	Assert(tuple.formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT);
+
+	if (natts > spec->natts)
+		natts = spec->natts;
+
+	for (i = 0; i < natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, i);
+
+		values[i] = fetchatt(att, tp + spec->offsets[i]);
+		isnull[i] = false;
+	}
+
+	return natts;
+}
+
 static Pointer
 o_tuple_read_next_field_ptr(OTupleReaderState *state)
 {
@@ -305,7 +358,9 @@ o_toast_nocachegetattr_ptr(OTuple tuple,
 	}
 
 	o_tuple_init_reader(&reader, tuple, tupleDesc, spec, NULL, NULL);
-	for (i = 0; i <= attnum; i++)
+	if (!slow && attnum >= spec->natts)
+		o_tuple_reader_skip_fixed_prefix(&reader, spec);
+	for (i = reader.attnum; i <= attnum; i++)
 		result = o_tuple_read_next_field_ptr(&reader);
 
 	Assert(result != NULL);
@@ -396,7 +451,9 @@ o_toast_nocachegetattr(OTuple tuple,
 	}
 
 	o_tuple_init_reader(&reader, tuple, tupleDesc, spec, NULL, NULL);
-	for (i = 0; i <= attnum; i++)
+	if (!slow && attnum >= spec->natts)
+		o_tuple_reader_skip_fixed_prefix(&reader, spec);
+	for (i = reader.attnum; i <= attnum; i++)
 		result = o_tuple_read_next_field(&reader, &is_null);
 
 	Assert(!is_null);
@@ -753,6 +810,47 @@ o_tuple_fill(TupleDesc tupleDesc, OTupleFixedFormatSpec *spec,
 	Assert((data - tuple->data) == tuple_size);
 }
 
+/*
+ * Make a copy of the key containing only the first `natts` attributes.
+ * The result always uses the non-fixed format, since its header carries the
+ * per-tuple attribute count.  Returns a NULL tuple when the key can't be
+ * truncated: keys with nulls would need the bitmap recut.
+ */
+OTuple
+o_tuple_make_truncated_key(TupleDesc tupleDesc, OTupleFixedFormatSpec *spec,
+						   OTuple key, int natts)
+{
+	OTupleReaderState state;
+	OTupleHeader header;
+	OTuple		result;
+	uint32		len;
+	int			i;
+
+	O_TUPLE_SET_NULL(result);
+
+	if (o_has_nulls(key))
+		return result;
+
+	o_tuple_init_reader(&state, key, tupleDesc, spec, NULL, NULL);
+	if (natts >= state.natts)
+		return result;
+
+	for (i = 0; i < natts; i++)
+		(void) o_tuple_next_field_offset(&state, TupleDescAttr(tupleDesc, i));
+	len = state.off;
+
+	result.data = (Pointer) palloc0(SizeOfOTupleHeader + len);
+	result.formatFlags = 0;
+	header = (OTupleHeader) result.data;
+	header->natts = natts;
+	header->hasnulls = 0;
+	header->version = o_tuple_get_version(key);
+	header->len = SizeOfOTupleHeader + len;
+	memcpy(result.data + SizeOfOTupleHeader, state.tp, len);
+
+	return result;
+}
+
 OTuple
 o_form_tuple(TupleDesc tupleDesc, OTupleFixedFormatSpec *spec,
 			 uint32 version, Datum *values, bool *isnull)
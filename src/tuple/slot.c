@@ -23,6 +23,7 @@
 #include "access/toast_internals.h"
 #include "catalog/pg_type_d.h"
 #include "storage/itemptr.h"
+#include "utils/datum.h"
 #include "utils/expandeddatum.h"
 #include "utils/lsyscache.h"
 
@@ -176,7 +177,8 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 	int			natts,
 				attnum,
 				ctid_off,
-				res_ctidoff;
+				res_ctidoff,
+				leaf_skip;
 	OTableDescr *descr = oslot->descr;
 	Datum	   *values = slot->tts_values;
 	bool	   *isnull = slot->tts_isnull;
@@ -195,9 +197,23 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 
 	res_ctidoff = GET_PRIMARY(descr)->primaryIsCtid ? 1 : 0;
 
+	/*
+	 * The index relation attributes don't contain the surrogate ctid primary
+	 * key, which sits in our leaf tuples between the key fields and the
+	 * included fields.  Skip over it when decoding into a RECORD slot shaped
+	 * after the index relation.
+	 */
+	if (slot->tts_tupleDescriptor->tdtypeid == RECORDOID &&
+		oslot->ixnum != PrimaryIndexNumber && idx->primaryIsCtid &&
+		idx->nIncludedFields > 0 &&
+		slot->tts_tupleDescriptor->natts >= idx->nFields - 1)
+		leaf_skip = 1;
+	else
+		leaf_skip = 0;
+
 	if (slot->tts_tupleDescriptor->tdtypeid == RECORDOID)
 	{
-		natts = Min(slot->tts_tupleDescriptor->natts,
+		natts = Min(slot->tts_tupleDescriptor->natts + leaf_skip,
 					oslot->state.desc->natts);
 	}
 	else if (oslot->ixnum == PrimaryIndexNumber)
@@ -209,7 +225,29 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 		natts = oslot->state.desc->natts;
 	}
 
-	for (attnum = slot->tts_nvalid; attnum < natts; attnum++)
+	attnum = slot->tts_nvalid;
+
+	/*
+	 * Batch-deform the fixed-width prefix of a fixed-format tuple.  This is
+	 * only possible when we read attributes in the table order from the very
+	 * beginning of the tuple, so that the reader state can be simply advanced
+	 * past the deformed prefix.  The prefix attributes are fixed-length, so
+	 * none of them can appear to be a TOAST pointer.
+	 */
+	if (attnum == 0 && oslot->state.attnum == 0 &&
+		(oslot->tuple.formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT) &&
+		oslot->ixnum == PrimaryIndexNumber && oslot->table_order)
+	{
+		OTupleFixedFormatSpec *spec = &idx->leafSpec;
+
+		attnum = o_tuple_deform_fixed(idx->leafTupdesc, spec, oslot->tuple,
+									  natts, values, isnull);
+		oslot->state.attnum = attnum;
+		oslot->state.off = (attnum < spec->natts) ? spec->offsets[attnum] :
+			spec->len;
+	}
+
+	for (; attnum < natts; attnum++)
 	{
 		Form_pg_attribute thisatt;
 		int			res_attnum;
@@ -225,7 +263,20 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 		}
 		else if (slot->tts_tupleDescriptor->tdtypeid == RECORDOID)
 		{
-			res_attnum = attnum;
+			if (leaf_skip > 0 && attnum >= idx->nFields - 1)
+			{
+				if (attnum == idx->nFields - 1)
+				{
+					bool		iptr_null;
+
+					/* the surrogate ctid primary key, see above */
+					(void) o_tuple_read_next_field(&oslot->state, &iptr_null);
+					continue;
+				}
+				res_attnum = attnum - 1;
+			}
+			else
+				res_attnum = attnum;
 		}
 		else
 		{
@@ -308,7 +359,7 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 
 	Assert(attnum == natts);
 
-	slot->tts_nvalid = natts;
+	slot->tts_nvalid = natts - leaf_skip;
 }
 
 static Datum
@@ -847,6 +898,106 @@ tts_orioledb_make_secondary_tuple(TupleTableSlot *slot, OIndexDescr *idx, bool l
 	return o_form_tuple(tupleDesc, spec, 0, values, isnull);
 }
 
+/*
+ * Forms leaf tuples of a secondary index for a batch of slots.
+ *
+ * Semantically equivalent to calling tts_orioledb_make_secondary_tuple() for
+ * every slot, but the index values of the whole batch are collected in one
+ * pass over the index definition and the formed tuples are packed into a
+ * single palloc'd arena instead of being allocated one by one, which takes
+ * the memory allocator out of the per-row path.  Returns the arena: the
+ * caller releases all the tuples at once with a single pfree().
+ */
+Pointer
+tts_orioledb_make_secondary_tuples(TupleTableSlot **slots, int nslots,
+								   OIndexDescr *idx, OTuple *tuples)
+{
+	TupleDesc	tupleDesc = idx->leafTupdesc;
+	OTupleFixedFormatSpec *spec = &idx->leafSpec;
+	int			ctid_off = idx->primaryIsCtid ? 1 : 0;
+	Datum	   *values;
+	bool	   *isnull;
+	Size	   *sizes;
+	Size		arenaSize = 0;
+	Pointer		arena,
+				ptr;
+	int			i;
+
+	values = (Datum *) palloc(sizeof(Datum) * tupleDesc->natts * nslots);
+	isnull = (bool *) palloc(sizeof(bool) * tupleDesc->natts * nslots);
+	sizes = (Size *) palloc(sizeof(Size) * nslots);
+
+	/* First pass: collect the index values and size the arena */
+	for (i = 0; i < nslots; i++)
+	{
+		slot_getsomeattrs(slots[i], idx->maxTableAttnum - ctid_off);
+		tts_orioledb_get_index_values(slots[i], idx,
+									  values + i * tupleDesc->natts,
+									  isnull + i * tupleDesc->natts, true);
+		sizes[i] = o_new_tuple_size(tupleDesc, spec, NULL, 0,
+									values + i * tupleDesc->natts,
+									isnull + i * tupleDesc->natts, NULL);
+		arenaSize += MAXALIGN(sizes[i]);
+	}
+
+	/* Second pass: form the tuples into the arena */
+	arena = (Pointer) palloc0(arenaSize);
+	ptr = arena;
+	for (i = 0; i < nslots; i++)
+	{
+		tuples[i].data = ptr;
+		o_tuple_fill(tupleDesc, spec, &tuples[i], sizes[i], NULL, 0,
+					 values + i * tupleDesc->natts,
+					 isnull + i * tupleDesc->natts, NULL);
+		ptr += MAXALIGN(sizes[i]);
+	}
+
+	pfree(values);
+	pfree(isnull);
+	pfree(sizes);
+
+	return arena;
+}
+
+/*
+ * Compare the included (non-key) index fields of two table slots.  Used to
+ * skip a secondary index update when neither the key fields nor the included
+ * fields have been changed.
+ */
+bool
+tts_orioledb_included_fields_eq(TupleTableSlot *slot1, TupleTableSlot *slot2,
+								OIndexDescr *idx)
+{
+	int			ctid_off = idx->primaryIsCtid ? 1 : 0;
+	int			i;
+
+	slot_getsomeattrs(slot1, idx->maxTableAttnum - ctid_off);
+	slot_getsomeattrs(slot2, idx->maxTableAttnum - ctid_off);
+
+	for (i = idx->nFields; i < idx->nFields + idx->nIncludedFields; i++)
+	{
+		int			attnum = idx->fields[i].tableAttnum;
+		Form_pg_attribute att = TupleDescAttr(idx->leafTupdesc, i);
+		Datum		value1,
+					value2;
+		bool		isnull1,
+					isnull2;
+
+		value1 = get_tbl_att(slot1, attnum, idx->primaryIsCtid,
+							 &isnull1, NULL);
+		value2 = get_tbl_att(slot2, attnum, idx->primaryIsCtid,
+							 &isnull2, NULL);
+
+		if (isnull1 != isnull2)
+			return false;
+		if (isnull1)
+			continue;
+		if (!datumIsEqual(value1, value2, att->attbyval, att->attlen))
+			return false;
+	}
+	return true;
+}
+
 /* fills key bound from tuple or index tuple that belongs to current BTree */
 void
 tts_orioledb_fill_key_bound(TupleTableSlot *slot, OIndexDescr *idx,
@@ -1295,6 +1446,43 @@ tts_orioledb_toast_sort_add(TupleTableSlot *slot,
 	pfree(idx_tup.data);
 }
 
+void
+tts_orioledb_toast_batch_add(TupleTableSlot *slot,
+							 OTableDescr *descr,
+							 struct OToastChunkBatch *batch)
+{
+	OTableSlot *oslot = (OTableSlot *) slot;
+	TupleDesc	tupleDesc = slot->tts_tupleDescriptor;
+	OTuple		idx_tup;
+	int			i;
+	int			ctid_off = GET_PRIMARY(descr)->primaryIsCtid ? 1 : 0;
+
+	if (oslot->to_toast == NULL)
+		return;
+
+	idx_tup = tts_orioledb_make_key(slot, descr);
+
+	for (i = 0; i < tupleDesc->natts; i++)
+	{
+		if (oslot->to_toast[i])
+		{
+			Datum		value;
+			Pointer		p;
+			bool		free;
+
+			value = o_get_src_value(slot->tts_values[i], &free);
+			p = DatumGetPointer(value);
+
+			o_toast_batch_add(GET_PRIMARY(descr), descr->toast,
+							  idx_tup, i + 1 + ctid_off, p,
+							  toast_datum_size(value), batch);
+			if (free)
+				pfree(p);
+		}
+	}
+	pfree(idx_tup.data);
+}
+
 bool
 tts_orioledb_remove_toast_values(TupleTableSlot *slot,
 								 OTableDescr *descr,
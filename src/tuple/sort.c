@@ -205,11 +205,11 @@ copytup_orioledb_index(Tuplesortstate *state, SortTuple *stup, void *tup)
 
 			tuple.data = (Pointer) mtup->tuple;
 			tuple.formatFlags = mtup->flags;
-			original = o_fastgetattr(tuple,
-									 state->sortKeys[0].ssup_attno,
-									 state->tupDesc,
-									 spec,
-									 &stup->isnull1);
+			mtup->datum1 = o_fastgetattr(tuple,
+										 state->sortKeys[0].ssup_attno,
+										 state->tupDesc,
+										 spec,
+										 &mtup->isnull1);
 		}
 	}
 }
@@ -310,8 +310,11 @@ tuplesort_begin_orioledb_index(OIndexDescr *idx,
 		sortKey->ssup_attno = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, idx, i + 1);
 		sortKey->abbreviate = (i == 0);
 		sortKey->ssup_reverse = !idx->fields[i].ascending;
-		/* FIXME: no abbrev converter yet */
-		o_finish_sort_support_function(idx->fields[i].comparator, sortKey);
+		if (sortKey->abbreviate)
+			o_finish_sort_support_function_abbrev(idx->fields[i].comparator,
+												  sortKey);
+		else
+			o_finish_sort_support_function(idx->fields[i].comparator, sortKey);
 	}
 
 	state = tuplesort_begin_custom(idx->leafTupdesc, idx->unique,
@@ -356,8 +359,11 @@ tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 		sortKey->ssup_attno = primary->nonLeafTupdesc->attrs[i].attnum;
 		sortKey->abbreviate = (i == 0);
 		sortKey->ssup_reverse = !primary->fields[i].ascending;
-		/* FIXME: no abbrev converter yet */
-		o_finish_sort_support_function(primary->fields[i].comparator, sortKey);
+		if (sortKey->abbreviate)
+			o_finish_sort_support_function_abbrev(primary->fields[i].comparator,
+												  sortKey);
+		else
+			o_finish_sort_support_function(primary->fields[i].comparator, sortKey);
 	}
 
 	field.collation = DEFAULT_COLLATION_OID;
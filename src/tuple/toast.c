@@ -29,7 +29,9 @@
 #include "access/htup_details.h"
 #include "access/detoast.h"
 #include "catalog/pg_type.h"
+#include "lib/ilist.h"
 #include "utils/builtins.h"
+#include "utils/memutils.h"
 #include "miscadmin.h"
 
 typedef struct
@@ -197,6 +199,106 @@ o_toast_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 }
 
 
+/*
+ * Per-backend cache of recently assembled TOAST values.
+ *
+ * Hot values (configuration blobs, popular rows) get detoasted over and
+ * over, each time re-descending the TOAST tree once per chunk.  The cache
+ * keys assembled values by relation, attribute and primary key tuple; the
+ * row version embedded in the key tuple makes entries of overwritten
+ * versions unreachable, so no explicit invalidation is needed.  Only values
+ * read under a normal (committed) CSN are cached: in-progress chunks are
+ * visible to their own transaction only and may yet be rolled back.
+ */
+typedef struct OToastCacheEntry
+{
+	dlist_node	lruNode;
+	ORelOids	oids;
+	uint16		attnum;
+	uint8		formatFlags;
+	uint16		keySize;
+	int32		dataSize;
+	char		data[FLEXIBLE_ARRAY_MEMBER];	/* key bytes, then value */
+} OToastCacheEntry;
+
+#define O_TOAST_CACHE_ENTRY_SIZE(keySize, dataSize) \
+	(offsetof(OToastCacheEntry, data) + (keySize) + (dataSize))
+
+static dlist_head toast_cache = DLIST_STATIC_INIT(toast_cache);
+static Size toast_cache_used = 0;
+
+/*
+ * Looks up an assembled value in the cache.  Returns a palloc'd copy, or
+ * NULL on miss.
+ */
+static Pointer
+o_toast_cache_lookup(ORelOids oids, OToastExternal *ote, Pointer keyData)
+{
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &toast_cache)
+	{
+		OToastCacheEntry *entry = dlist_container(OToastCacheEntry, lruNode,
+												  iter.cur);
+		Pointer		result;
+
+		if (!ORelOidsIsEqual(entry->oids, oids) ||
+			entry->attnum != ote->attnum ||
+			entry->formatFlags != ote->formatFlags ||
+			entry->keySize != ote->data_size ||
+			memcmp(entry->data, keyData, ote->data_size) != 0)
+			continue;
+
+		Assert(entry->dataSize == ote->toasted_size);
+		dlist_move_head(&toast_cache, &entry->lruNode);
+		result = palloc(entry->dataSize);
+		memcpy(result, entry->data + entry->keySize, entry->dataSize);
+		return result;
+	}
+	return NULL;
+}
+
+/*
+ * Puts an assembled value into the cache, evicting least recently used
+ * entries until the value fits under orioledb.toast_cache_size.
+ */
+static void
+o_toast_cache_store(ORelOids oids, OToastExternal *ote, Pointer keyData,
+					Pointer value)
+{
+	Size		limit = (Size) toast_cache_size * 1024;
+	Size		entrySize = O_TOAST_CACHE_ENTRY_SIZE(ote->data_size,
+													 ote->toasted_size);
+	OToastCacheEntry *entry;
+
+	if (entrySize > limit)
+		return;
+
+	while (toast_cache_used + entrySize > limit &&
+		   !dlist_is_empty(&toast_cache))
+	{
+		OToastCacheEntry *victim = dlist_container(OToastCacheEntry, lruNode,
+												   dlist_tail_node(&toast_cache));
+
+		dlist_delete(&victim->lruNode);
+		toast_cache_used -= O_TOAST_CACHE_ENTRY_SIZE(victim->keySize,
+													 victim->dataSize);
+		pfree(victim);
+	}
+
+	entry = (OToastCacheEntry *) MemoryContextAlloc(TopMemoryContext,
+													entrySize);
+	entry->oids = oids;
+	entry->attnum = ote->attnum;
+	entry->formatFlags = ote->formatFlags;
+	entry->keySize = ote->data_size;
+	entry->dataSize = ote->toasted_size;
+	memcpy(entry->data, keyData, ote->data_size);
+	memcpy(entry->data + ote->data_size, value, ote->toasted_size);
+	dlist_push_head(&toast_cache, &entry->lruNode);
+	toast_cache_used += entrySize;
+}
+
 struct varlena *
 o_detoast(struct varlena *attr)
 {
@@ -204,6 +306,7 @@ o_detoast(struct varlena *attr)
 	ORelOids	oids;
 	OTableDescr *descr;
 	OFixedKey	key;
+	Pointer		result;
 
 	memcpy(&ote, VARDATA_EXTERNAL(attr), O_TOAST_EXTERNAL_SZ);
 	oids.datoid = ote.datoid;
@@ -219,9 +322,74 @@ o_detoast(struct varlena *attr)
 	memcpy(key.fixedData,
 		   VARDATA_EXTERNAL(attr) + O_TOAST_EXTERNAL_SZ,
 		   ote.data_size);
-	return (struct varlena *) o_toast_get(GET_PRIMARY(descr), descr->toast,
-										  key.tuple, ote.attnum,
-										  ote.toasted_size, ote.csn);
+
+	if (toast_cache_size > 0 && COMMITSEQNO_IS_NORMAL(ote.csn))
+	{
+		result = o_toast_cache_lookup(oids, &ote, key.fixedData);
+		if (result)
+			return (struct varlena *) result;
+	}
+
+	result = o_toast_get(GET_PRIMARY(descr), descr->toast,
+						 key.tuple, ote.attnum,
+						 ote.toasted_size, ote.csn);
+
+	if (result != NULL && toast_cache_size > 0 &&
+		COMMITSEQNO_IS_NORMAL(ote.csn))
+		o_toast_cache_store(oids, &ote, key.fixedData, result);
+
+	return (struct varlena *) result;
+}
+
+ODetoastIterator *
+o_detoast_iterator_create(struct varlena *attr)
+{
+	OToastExternal ote;
+	ORelOids	oids;
+	OTableDescr *descr;
+	ODetoastIterator *iter;
+	OTableToastArg *arg;
+
+	Assert(VARATT_IS_EXTERNAL_ORIOLEDB(attr));
+	memcpy(&ote, VARDATA_EXTERNAL(attr), O_TOAST_EXTERNAL_SZ);
+	oids.datoid = ote.datoid;
+	oids.reloid = ote.relid;
+	oids.relnode = ote.relnode;
+	descr = o_fetch_table_descr(oids);
+
+	Assert(descr);
+
+	o_btree_load_shmem(&descr->toast->desc);
+
+	iter = (ODetoastIterator *) palloc(sizeof(ODetoastIterator) +
+									   sizeof(OTableToastArg));
+	arg = (OTableToastArg *) (iter + 1);
+	arg->pk = GET_PRIMARY(descr);
+	arg->toast = descr->toast;
+
+	iter->pk.tuple.formatFlags = ote.formatFlags;
+	iter->pk.tuple.data = iter->pk.fixedData;
+	memcpy(iter->pk.fixedData,
+		   VARDATA_EXTERNAL(attr) + O_TOAST_EXTERNAL_SZ,
+		   ote.data_size);
+
+	iter->key.pk_tuple = iter->pk.tuple;
+	iter->key.attnum = ote.attnum;
+	iter->key.offset = 0;
+	iter->rawSize = ote.raw_size;
+	iter->toastedSize = ote.toasted_size;
+
+	generic_toast_iterator_init(&iter->gen, &tableToastAPI,
+								(Pointer) &iter->key, ote.csn, arg);
+
+	return iter;
+}
+
+void
+o_detoast_iterator_free(ODetoastIterator *iter)
+{
+	generic_toast_iterator_free(&iter->gen);
+	pfree(iter);
 }
 
 static BTreeDescr *
@@ -481,6 +649,79 @@ generic_toast_sort_add(ToastAPI *api, void *key,
 	}
 }
 
+void
+generic_toast_batch_add(ToastAPI *api, void *key,
+						Pointer data, Size data_size,
+						OToastChunkBatch *batch, void *arg)
+{
+	uint32		max_length = api->getMaxChunkSize(key, arg);
+	uint32		offset = 0;
+
+	Assert(data_size > 0);
+
+	while (data_size > 0)
+	{
+		OTuple		tup;
+		int			length = 0;
+		MemoryContext mctx;
+
+		if (data_size < max_length)
+		{
+			length = data_size;
+		}
+		else
+		{
+			length = max_length;
+		}
+
+		mctx = MemoryContextSwitchTo(batch->mcxt);
+		tup = api->createTuple(key, data, offset, length, arg);
+
+		if (batch->count >= batch->allocated)
+		{
+			batch->allocated = batch->allocated > 0 ? batch->allocated * 2 : 64;
+			if (batch->chunks)
+				batch->chunks = (OTuple *) repalloc(batch->chunks,
+													sizeof(OTuple) * batch->allocated);
+			else
+				batch->chunks = (OTuple *) palloc(sizeof(OTuple) * batch->allocated);
+		}
+		MemoryContextSwitchTo(mctx);
+
+		batch->chunks[batch->count++] = tup;
+
+		offset += length;
+		data_size -= length;
+	}
+}
+
+bool
+generic_toast_batch_insert(ToastAPI *api, OToastChunkBatch *batch,
+						   OXid oxid, CommitSeqNo csn, void *arg)
+{
+	BTreeDescr *desc = api->getBTreeDesc(arg);
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, InvalidOPageChangeCount};
+	BTreeModifyCallbackInfo callbackInfo = nullCallbackInfo;
+	int			i;
+
+	for (i = 0; i < batch->count; i++)
+	{
+		OTuple		tup = batch->chunks[i];
+
+		if (o_btree_modify(desc, BTreeOperationInsert,
+						   tup, BTreeKeyLeafTuple,
+						   NULL, BTreeKeyNone,
+						   oxid, csn, RowLockUpdate,
+						   &hint, &callbackInfo) != OBTreeModifyResultInserted)
+			return false;
+
+		add_modify_wal_record(WAL_REC_INSERT, desc,
+							  tup, o_btree_len(desc, tup, OTupleLength));
+	}
+
+	return true;
+}
+
 static OBTreeModifyCallbackAction
 o_update_callback(BTreeDescr *descr,
 				  OTuple tup, OTuple *newtup, OXid oxid,
@@ -706,6 +947,84 @@ generic_toast_get(ToastAPI *api, void *key, Size data_size,
 	return data;
 }
 
+void
+generic_toast_iterator_init(GenericToastIterator *iter, ToastAPI *api,
+							void *key, CommitSeqNo csn, void *arg)
+{
+	BTreeDescr *desc = api->getBTreeDesc(arg);
+
+	iter->api = api;
+	iter->key = key;
+	iter->arg = arg;
+	iter->maxChunkSize = api->getMaxChunkSize(key, arg);
+	iter->iterator = o_btree_iterator_create(desc, key, BTreeKeyBound,
+											 csn, ForwardScanDirection);
+	if (api->versionCallback)
+		o_btree_iterator_set_callback(iter->iterator, api->versionCallback,
+									  key);
+	O_TUPLE_SET_NULL(iter->chunkTuple);
+	iter->finished = false;
+}
+
+/*
+ * Fetch the next chunk of the value.  Returns a pointer to chunkSize bytes
+ * of chunk data, or NULL when the value is exhausted.  The previously
+ * returned chunk is freed, so callers must consume chunks strictly one at a
+ * time.
+ */
+Pointer
+generic_toast_iterator_next(GenericToastIterator *iter, uint32 *chunkSize)
+{
+	ToastAPI   *api = iter->api;
+	OTuple		tuple;
+	uint32		size;
+
+	if (!O_TUPLE_IS_NULL(iter->chunkTuple))
+	{
+		pfree(iter->chunkTuple.data);
+		O_TUPLE_SET_NULL(iter->chunkTuple);
+	}
+
+	if (iter->finished)
+		return NULL;
+
+	/*
+	 * getNextKey() may return a pointer to static storage, so recompute it
+	 * on every fetch instead of caching it in the iterator.
+	 */
+	tuple = o_btree_iterator_fetch(iter->iterator, NULL,
+								   api->getNextKey(iter->key, iter->arg),
+								   BTreeKeyBound, false, NULL);
+
+	if (O_TUPLE_IS_NULL(tuple))
+	{
+		iter->finished = true;
+		return NULL;
+	}
+
+	size = api->getTupleDataSize(tuple, iter->arg);
+
+	/* A short chunk is always the last one */
+	if (size < iter->maxChunkSize)
+		iter->finished = true;
+
+	iter->chunkTuple = tuple;
+	if (chunkSize)
+		*chunkSize = size;
+	return api->getTupleData(tuple, iter->arg);
+}
+
+void
+generic_toast_iterator_free(GenericToastIterator *iter)
+{
+	if (!O_TUPLE_IS_NULL(iter->chunkTuple))
+	{
+		pfree(iter->chunkTuple.data);
+		O_TUPLE_SET_NULL(iter->chunkTuple);
+	}
+	btree_iterator_free(iter->iterator);
+}
+
 /*
  * Common code for
  * generic_toast_get_any_with_callback and generic_toast_get_any_with_key
@@ -855,6 +1174,37 @@ o_toast_sort_add(OIndexDescr *primary, OIndexDescr *toast,
 
 }
 
+void
+o_toast_batch_add(OIndexDescr *primary, OIndexDescr *toast,
+				  OTuple pk, uint16 attn,
+				  Pointer data, Size data_size,
+				  OToastChunkBatch *batch)
+{
+	OToastKey	tkey;
+	OTableToastArg arg = {primary, toast};
+
+	tkey.pk_tuple = pk;
+	tkey.attnum = attn;
+	tkey.offset = 0;
+
+	Assert(toast->desc.type == oIndexToast);
+
+	generic_toast_batch_add(&tableToastAPI, (Pointer) &tkey, data,
+							data_size, batch, &arg);
+}
+
+bool
+o_toast_batch_insert(OIndexDescr *primary, OIndexDescr *toast,
+					 OToastChunkBatch *batch,
+					 OXid oxid, CommitSeqNo csn)
+{
+	OTableToastArg arg = {primary, toast};
+
+	Assert(toast->desc.type == oIndexToast);
+
+	return generic_toast_batch_insert(&tableToastAPI, batch, oxid, csn, &arg);
+}
+
 bool
 o_toast_delete(OIndexDescr *primary, OIndexDescr *toast,
 			   OTuple pk, uint16 attn,
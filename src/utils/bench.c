@@ -0,0 +1,191 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench.c
+ *		SQL-callable microbenchmarks of engine primitives.
+ *
+ * orioledb_bench_primitive() runs a tight loop over a single engine
+ * primitive against a live tree and returns the averaged cost per
+ * operation in nanoseconds.  The loops run inside an ordinary backend, so
+ * the numbers include exactly what production backends pay and can be
+ * compared between builds on the same machine.  Contended variants (e.g.
+ * lock_page) are produced by running the same primitive from several
+ * sessions at once; o_btree_modify() insert/update loops are driven
+ * through plain SQL with orioledb.track_latencies instead, since they
+ * need real tuples and transactions.  The `make bench` driver collects
+ * everything into JSON lines for trend tracking.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/bench.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+#include "btree/find.h"
+#include "btree/page_chunks.h"
+#include "btree/page_contents.h"
+#include "btree/page_state.h"
+#include "tableam/descr.h"
+#include "tableam/handler.h"
+#include "utils/compress.h"
+
+#include "access/relation.h"
+#include "portability/instr_time.h"
+#include "utils/builtins.h"
+
+PG_FUNCTION_INFO_V1(orioledb_bench_primitive);
+
+/*
+ * Results are accumulated here so the compiler can't discard the benchmark
+ * loops as dead code.
+ */
+static volatile uint64 benchSink = 0;
+
+Datum
+orioledb_bench_primitive(PG_FUNCTION_ARGS)
+{
+	char	   *name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	Oid			relid = PG_GETARG_OID(1);
+	int64		iterations = PG_GETARG_INT64(2);
+	Relation	rel;
+	OTableDescr *descr;
+	BTreeDescr *td;
+	instr_time	start,
+				duration;
+	int64		i;
+
+	orioledb_check_shmem();
+
+	if (iterations <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("iterations must be a positive number")));
+
+	rel = relation_open(relid, AccessShareLock);
+	descr = relation_get_descr(rel);
+	if (!descr)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an orioledb table",
+						RelationGetRelationName(rel))));
+
+	td = &GET_PRIMARY(descr)->desc;
+	o_btree_load_shmem(td);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	if (strcmp(name, "find_page") == 0)
+	{
+		/* Root-to-leaf descent of the primary tree */
+		OBTreeFindPageContext context;
+
+		init_page_find_context(&context, td, COMMITSEQNO_INPROGRESS,
+							   BTREE_PAGE_FIND_IMAGE);
+		for (i = 0; i < iterations; i++)
+		{
+			find_page(&context, NULL, BTreeKeyNone, 0);
+			benchSink += BTREE_PAGE_ITEMS_COUNT(context.img);
+		}
+	}
+	else if (strcmp(name, "page_iterate") == 0)
+	{
+		/* Item locator walk over a leaf page image */
+		OBTreeFindPageContext context;
+		BTreePageItemLocator loc;
+
+		init_page_find_context(&context, td, COMMITSEQNO_INPROGRESS,
+							   BTREE_PAGE_FIND_IMAGE);
+		find_page(&context, NULL, BTreeKeyNone, 0);
+		for (i = 0; i < iterations; i++)
+		{
+			BTREE_PAGE_FOREACH_ITEMS(context.img, &loc)
+				benchSink += (uintptr_t) BTREE_PAGE_LOCATOR_GET_ITEM(context.img, &loc);
+		}
+	}
+	else if (strcmp(name, "page_insert_item") == 0)
+	{
+		/*
+		 * page_locator_insert_item()/page_locator_delete_item() pair at the
+		 * first position of a private copy of a leaf page: the insert
+		 * shifts the whole page data, which is the representative cost, and
+		 * the delete restores the page for the next iteration.
+		 */
+		OBTreeFindPageContext context;
+		BTreePageItemLocator loc;
+		char		img[ORIOLEDB_BLCKSZ];
+		LocationIndex itemsize = MAXALIGN(sizeof(BTreeLeafTuphdr) + 8);
+
+		init_page_find_context(&context, td, COMMITSEQNO_INPROGRESS,
+							   BTREE_PAGE_FIND_IMAGE);
+		find_page(&context, NULL, BTreeKeyNone, 0);
+		memcpy(img, context.img, ORIOLEDB_BLCKSZ);
+
+		if (BTREE_PAGE_FREE_SPACE(img) < itemsize + MAXIMUM_ALIGNOF +
+			sizeof(LocationIndex))
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("leftmost leaf page of \"%s\" has no room for the benchmark item",
+							RelationGetRelationName(rel))));
+
+		for (i = 0; i < iterations; i++)
+		{
+			BTREE_PAGE_LOCATOR_FIRST(img, &loc);
+			page_locator_insert_item(img, &loc, itemsize);
+			BTREE_PAGE_LOCATOR_FIRST(img, &loc);
+			page_locator_delete_item(img, &loc);
+			benchSink += BTREE_PAGE_ITEMS_COUNT(img);
+		}
+	}
+	else if (strcmp(name, "compress") == 0)
+	{
+		/* o_compress_page() of a leaf page image */
+		OBTreeFindPageContext context;
+		OCompress	lvl;
+
+		lvl = OCompressIsValid(td->compress) ? td->compress : 1;
+
+		init_page_find_context(&context, td, COMMITSEQNO_INPROGRESS,
+							   BTREE_PAGE_FIND_IMAGE);
+		find_page(&context, NULL, BTreeKeyNone, 0);
+		for (i = 0; i < iterations; i++)
+		{
+			size_t		size = ORIOLEDB_BLCKSZ;
+
+			(void) o_compress_page(context.img, &size, lvl,
+								   td->compressDict);
+			benchSink += size;
+		}
+	}
+	else if (strcmp(name, "lock_page") == 0)
+	{
+		/*
+		 * Exclusive lock/unlock of the root page.  Run this from several
+		 * sessions at once to measure contention.
+		 */
+		OInMemoryBlkno rootBlkno = td->rootInfo.rootPageBlkno;
+
+		for (i = 0; i < iterations; i++)
+		{
+			lock_page(rootBlkno);
+			unlock_page(rootBlkno);
+		}
+	}
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unknown benchmark primitive \"%s\"", name),
+				 errhint("Valid primitives are \"find_page\", \"page_iterate\", \"page_insert_item\", \"compress\" and \"lock_page\".")));
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	relation_close(rel, AccessShareLock);
+
+	PG_RETURN_FLOAT8((double) INSTR_TIME_GET_NANOSEC(duration) /
+					 (double) iterations);
+}
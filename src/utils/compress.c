@@ -14,18 +14,28 @@
 
 #include "orioledb.h"
 
+#include "btree/io.h"
 #include "utils/compress.h"
 
+#include "pgstat.h"
+#include "storage/fd.h"
 #include "utils/elog.h"
 #include "utils/memdebug.h"
 
 #include <zstd.h>
+#include <zdict.h>
 
 static ZSTD_CCtx *zstd_cctx = NULL;
 static ZSTD_DCtx *zstd_dctx = NULL;
 static size_t zstd_dst_size;
 static Pointer zstd_dst = NULL;
 
+struct OCompressDict
+{
+	ZSTD_CDict *cdict;
+	ZSTD_DDict *ddict;
+};
+
 /*
  * Initializes compression context.
  */
@@ -49,16 +59,22 @@ o_compress_init(void)
 }
 
 /*
- * Compresses a BTree page.
+ * Compresses a BTree page.  Uses the trained dictionary of the tree, if any.
  */
 Pointer
-o_compress_page(Pointer page, size_t *size, OCompress lvl)
+o_compress_page(Pointer page, size_t *size, OCompress lvl, OCompressDict *dict)
 {
 	VALGRIND_CHECK_MEM_IS_DEFINED(page, ORIOLEDB_BLCKSZ);
-	*size = ZSTD_compressCCtx(zstd_cctx,
-							  zstd_dst, zstd_dst_size,
-							  page, ORIOLEDB_BLCKSZ,
-							  lvl);
+	if (dict)
+		*size = ZSTD_compress_usingCDict(zstd_cctx,
+										 zstd_dst, zstd_dst_size,
+										 page, ORIOLEDB_BLCKSZ,
+										 dict->cdict);
+	else
+		*size = ZSTD_compressCCtx(zstd_cctx,
+								  zstd_dst, zstd_dst_size,
+								  page, ORIOLEDB_BLCKSZ,
+								  lvl);
 	VALGRIND_MAKE_MEM_DEFINED(zstd_dst, *size);
 	if (ZSTD_isError(*size))
 	{
@@ -71,15 +87,25 @@ o_compress_page(Pointer page, size_t *size, OCompress lvl)
 
 /*
  * Decompresses a BTree page.
+ *
+ * Pages written without a dictionary decompress fine when a dictionary is
+ * given, so trees with pages from before the dictionary was trained stay
+ * readable.
  */
 void
-o_decompress_page(Pointer src, size_t size, Pointer page)
+o_decompress_page(Pointer src, size_t size, Pointer page, OCompressDict *dict)
 {
 	size_t		result;
 
-	result = ZSTD_decompressDCtx(zstd_dctx,
-								 page, ORIOLEDB_BLCKSZ,
-								 src, size);
+	if (dict)
+		result = ZSTD_decompress_usingDDict(zstd_dctx,
+											page, ORIOLEDB_BLCKSZ,
+											src, size,
+											dict->ddict);
+	else
+		result = ZSTD_decompressDCtx(zstd_dctx,
+									 page, ORIOLEDB_BLCKSZ,
+									 src, size);
 	if (ZSTD_isError(result))
 	{
 		elog(PANIC,
@@ -89,6 +115,83 @@ o_decompress_page(Pointer src, size_t size, Pointer page)
 	Assert(result == ORIOLEDB_BLCKSZ);
 }
 
+/*
+ * Compresses a WAL container into dst.  Returns the compressed size, or 0
+ * when the container doesn't fit into dstSize, i.e. isn't worth compressing.
+ *
+ * Uses a light compression level: the call sits on the commit path, so
+ * latency matters more than the last few percent of the ratio.
+ */
+size_t
+o_compress_wal_container(Pointer data, size_t length,
+						 Pointer dst, size_t dstSize)
+{
+	size_t		size;
+
+	size = ZSTD_compressCCtx(zstd_cctx,
+							 dst, dstSize,
+							 data, length,
+							 1);
+	if (ZSTD_isError(size))
+		return 0;
+
+	return size;
+}
+
+/*
+ * Decompresses a WAL container compressed by o_compress_wal_container().
+ */
+void
+o_decompress_wal_container(Pointer src, size_t size,
+						   Pointer dst, size_t rawLength)
+{
+	size_t		result;
+
+	result = ZSTD_decompressDCtx(zstd_dctx,
+								 dst, rawLength,
+								 src, size);
+	if (ZSTD_isError(result))
+		elog(PANIC, "Unable to decompress WAL container, reason: %s",
+			 ZSTD_getErrorName(result));
+
+	if (result != rawLength)
+		elog(PANIC, "Wrong decompressed WAL container length: %zu instead of %zu",
+			 result, rawLength);
+}
+
+/*
+ * Returns the worst-case compressed size for a buffer of the given size.
+ */
+size_t
+o_compress_bound(size_t size)
+{
+	return ZSTD_compressBound(size);
+}
+
+/*
+ * Compresses a binary row batch into dst.  Returns the compressed size.
+ * Unlike the page codec above the batch has no fixed size, so the caller
+ * provides a destination sized with o_compress_bound().
+ */
+size_t
+o_compress_row_batch(Pointer data, size_t length,
+					 Pointer dst, size_t dstSize, OCompress lvl)
+{
+	size_t		size;
+
+	size = ZSTD_compressCCtx(zstd_cctx,
+							 dst, dstSize,
+							 data, length,
+							 lvl);
+	if (ZSTD_isError(size))
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("unable to compress row batch: %s",
+						ZSTD_getErrorName(size))));
+
+	return size;
+}
+
 /*
  * Returns max orioledb compression level.
  */
@@ -97,3 +200,103 @@ o_compress_max_lvl()
 {
 	return ZSTD_maxCLevel();
 }
+
+/*
+ * Returns the name of the file storing the trained dictionary of a tree.  The
+ * file lives next to the tree data files and shares their lifetime.
+ */
+char *
+o_compress_dict_filename(ORelOids oids)
+{
+	return psprintf(ORIOLEDB_DATA_DIR "/%u_%u.dict",
+					oids.datoid, oids.relnode);
+}
+
+/*
+ * Loads the trained dictionary of a tree and digests it for the given
+ * compression level.  Returns NULL if the tree has no dictionary.
+ */
+OCompressDict *
+o_compress_dict_load(ORelOids oids, OCompress lvl)
+{
+	char	   *filename = o_compress_dict_filename(oids);
+	File		file;
+	off_t		size;
+	Pointer		buf;
+	OCompressDict *dict;
+
+	file = PathNameOpenFile(filename, O_RDONLY | PG_BINARY);
+	if (file < 0)
+	{
+		pfree(filename);
+		return NULL;
+	}
+
+	size = FileSize(file);
+	if (size <= 0)
+	{
+		FileClose(file);
+		pfree(filename);
+		return NULL;
+	}
+
+	buf = palloc(size);
+	if (OFileRead(file, buf, size, 0, WAIT_EVENT_DATA_FILE_READ) != size)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read compression dictionary file %s",
+						filename)));
+	FileClose(file);
+
+	/*
+	 * The dictionary outlives any memory context: it's cached in the
+	 * backend-local tree descriptor.
+	 */
+	dict = (OCompressDict *) malloc(sizeof(OCompressDict));
+	if (dict == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	dict->cdict = ZSTD_createCDict(buf, size, lvl);
+	dict->ddict = ZSTD_createDDict(buf, size);
+	if (dict->cdict == NULL || dict->ddict == NULL)
+		elog(ERROR, "unable to digest compression dictionary file %s",
+			 filename);
+
+	pfree(buf);
+	pfree(filename);
+
+	return dict;
+}
+
+/*
+ * Frees a dictionary loaded by o_compress_dict_load().
+ */
+void
+o_compress_dict_free(OCompressDict *dict)
+{
+	ZSTD_freeCDict(dict->cdict);
+	ZSTD_freeDDict(dict->ddict);
+	free(dict);
+}
+
+/*
+ * Trains a dictionary from concatenated page samples.  Returns the size of
+ * the trained dictionary written to dictBuffer.
+ */
+size_t
+o_compress_dict_train(Pointer samples, size_t *sampleSizes, unsigned nSamples,
+					  Pointer dictBuffer, size_t dictCapacity)
+{
+	size_t		result;
+
+	result = ZDICT_trainFromBuffer(dictBuffer, dictCapacity,
+								   samples, sampleSizes, nSamples);
+	if (ZDICT_isError(result))
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("unable to train compression dictionary: %s",
+						ZDICT_getErrorName(result))));
+
+	return result;
+}
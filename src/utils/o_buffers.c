@@ -167,8 +167,36 @@ read_buffer(OBuffersDesc *desc, OBuffer *buffer)
 		memset(&buffer->data[result], 0, ORIOLEDB_BLCKSZ - result);
 }
 
+/*
+ * Hint the OS to read the given file range ahead.  Saves waiting for the
+ * physical IO block-by-block when a caller reads a multi-block range.
+ */
+static void
+prefetch_range(OBuffersDesc *desc, int64 offset, int64 size)
+{
+#ifdef USE_PREFETCH
+	while (size > 0)
+	{
+		uint64		fileNum = offset / desc->singleFileSize;
+		off_t		fileOffset = offset % desc->singleFileSize;
+		int64		stepSize = Min(size, desc->singleFileSize - fileOffset);
+
+		open_file(desc, fileNum);
+		FilePrefetch(desc->curFile, fileOffset, stepSize,
+					 WAIT_EVENT_DATA_FILE_PREFETCH);
+		offset += stepSize;
+		size -= stepSize;
+	}
+#endif
+}
+
+/*
+ * The `overwrite` flag tells that the caller is going to replace the whole
+ * block contents, so there is no need to read the old contents from the file
+ * on a cache miss.
+ */
 static OBuffer *
-get_buffer(OBuffersDesc *desc, int64 blockNum, bool write)
+get_buffer(OBuffersDesc *desc, int64 blockNum, bool write, bool overwrite)
 {
 	OBuffersGroup *group = &desc->groups[blockNum % desc->groupsCount];
 	OBuffer    *buffer = NULL;
@@ -213,7 +241,8 @@ get_buffer(OBuffersDesc *desc, int64 blockNum, bool write)
 	buffer->dirty = false;
 	buffer->blockNum = blockNum;
 
-	read_buffer(desc, buffer);
+	if (!overwrite)
+		read_buffer(desc, buffer);
 
 	LWLockRelease(&group->groupCtlLock);
 	return buffer;
@@ -229,9 +258,13 @@ o_buffers_rw(OBuffersDesc *desc, Pointer buf,
 				blockNum;
 	Pointer		ptr = buf;
 
+	if (!write && lastBlockNum > firstBlockNum)
+		prefetch_range(desc, firstBlockNum * ORIOLEDB_BLCKSZ,
+					   (lastBlockNum - firstBlockNum + 1) * ORIOLEDB_BLCKSZ);
+
 	for (blockNum = firstBlockNum; blockNum <= lastBlockNum; blockNum++)
 	{
-		OBuffer    *buffer = get_buffer(desc, blockNum, write);
+		OBuffer    *buffer;
 		uint32		copySize,
 					copyOffset;
 
@@ -256,6 +289,9 @@ o_buffers_rw(OBuffersDesc *desc, Pointer buf,
 			copyOffset = 0;
 		}
 
+		buffer = get_buffer(desc, blockNum, write,
+							write && copySize == ORIOLEDB_BLCKSZ);
+
 		if (write)
 		{
 			memcpy(&buffer->data[copyOffset], ptr, copySize);
@@ -0,0 +1,179 @@
+/*-------------------------------------------------------------------------
+ *
+ * o_latency.c
+ *		Latency histograms of btree operations.
+ *
+ * Every backend accumulates durations of o_btree_modify() and find_page()
+ * calls into its own slice of a shared memory array, so the hot path needs
+ * no locks and no shared cache lines: two timestamp calls and one counter
+ * increment per operation.  The orioledb_latency_stats() function merges
+ * the per-backend histograms and computes percentiles from the merged one.
+ *
+ * The buckets are HDR-style: two sub-bucket bits per power of two of the
+ * nanosecond duration, so any reported percentile is within 25% of the
+ * true value, over a range from nanoseconds to hours.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/o_latency.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/o_latency.h"
+
+#include "miscadmin.h"
+#include "port/pg_bitutils.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+
+bool		track_latencies = false;
+Pointer		oLatencyCounters = NULL;
+
+#define O_LATENCY_PROC_COUNTERS \
+	(OLatencyOperationsCount * O_LATENCY_BUCKETS)
+
+static const char *const latencyoperationnames[] = {
+	"insert",
+	"lock",
+	"update",
+	"delete",
+	"find_page"
+};
+
+StaticAssertDecl(lengthof(latencyoperationnames) == OLatencyOperationsCount,
+				 "latencyoperationnames covers OLatencyOperation");
+
+static inline pg_atomic_uint64 *
+o_latency_proc_counters(int pgprocno)
+{
+	return ((pg_atomic_uint64 *) oLatencyCounters) +
+		(Size) pgprocno * O_LATENCY_PROC_COUNTERS;
+}
+
+Size
+o_latency_shmem_needs(void)
+{
+	return mul_size(max_procs,
+					mul_size(O_LATENCY_PROC_COUNTERS,
+							 sizeof(pg_atomic_uint64)));
+}
+
+void
+o_latency_shmem_init(Pointer ptr, bool found)
+{
+	oLatencyCounters = ptr;
+
+	if (!found)
+	{
+		pg_atomic_uint64 *counters = (pg_atomic_uint64 *) ptr;
+		Size		i,
+					count;
+
+		count = (Size) max_procs * O_LATENCY_PROC_COUNTERS;
+		for (i = 0; i < count; i++)
+			pg_atomic_init_u64(&counters[i], 0);
+	}
+}
+
+static inline int
+o_latency_bucket(uint64 ns)
+{
+	int			msb;
+
+	if (ns < O_LATENCY_SUBBUCKETS)
+		return (int) ns;
+
+	msb = pg_leftmost_one_pos64(ns);
+	return ((msb - O_LATENCY_SUBBUCKET_BITS + 1) << O_LATENCY_SUBBUCKET_BITS) +
+		(int) ((ns >> (msb - O_LATENCY_SUBBUCKET_BITS)) &
+			   (O_LATENCY_SUBBUCKETS - 1));
+}
+
+/*
+ * Account a finished operation started at "start" into the backend's own
+ * histogram.  The counters are single-writer: the atomic type is only used
+ * to let concurrent readers see untorn values.
+ */
+void
+o_latency_record(OLatencyOperation op, instr_time start)
+{
+	pg_atomic_uint64 *counter;
+	instr_time	duration;
+	int			bucket;
+
+	Assert(op >= 0 && op < OLatencyOperationsCount);
+
+	if (MyProc == NULL)
+		return;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	bucket = o_latency_bucket((uint64) INSTR_TIME_GET_NANOSEC(duration));
+	counter = o_latency_proc_counters(MyProc->pgprocno) +
+		op * O_LATENCY_BUCKETS + bucket;
+	pg_atomic_write_u64(counter, pg_atomic_read_u64(counter) + 1);
+}
+
+/*
+ * Sum the per-backend histograms of the given operation into "buckets",
+ * which must have room for O_LATENCY_BUCKETS values.
+ */
+void
+o_latency_merged_histogram(OLatencyOperation op, uint64 *buckets)
+{
+	int			i,
+				bucket;
+
+	memset(buckets, 0, sizeof(uint64) * O_LATENCY_BUCKETS);
+
+	if (oLatencyCounters == NULL)
+		return;
+
+	for (i = 0; i < max_procs; i++)
+	{
+		pg_atomic_uint64 *counters = o_latency_proc_counters(i) +
+			op * O_LATENCY_BUCKETS;
+
+		for (bucket = 0; bucket < O_LATENCY_BUCKETS; bucket++)
+			buckets[bucket] += pg_atomic_read_u64(&counters[bucket]);
+	}
+}
+
+/*
+ * The representative duration of a bucket in microseconds: the middle of
+ * the nanosecond range the bucket covers.
+ */
+double
+o_latency_bucket_value(int bucket)
+{
+	uint64		lower,
+				width;
+	int			msb,
+				sub;
+
+	Assert(bucket >= 0 && bucket < O_LATENCY_BUCKETS);
+
+	if (bucket < O_LATENCY_SUBBUCKETS)
+		return (double) bucket / 1000.0;
+
+	msb = (bucket >> O_LATENCY_SUBBUCKET_BITS) + O_LATENCY_SUBBUCKET_BITS - 1;
+	sub = bucket & (O_LATENCY_SUBBUCKETS - 1);
+	width = UINT64CONST(1) << (msb - O_LATENCY_SUBBUCKET_BITS);
+	lower = (UINT64CONST(1) << msb) + (uint64) sub * width;
+
+	return ((double) lower + (double) width / 2.0) / 1000.0;
+}
+
+const char *
+o_latency_operation_name(OLatencyOperation op)
+{
+	Assert(op >= 0 && op < OLatencyOperationsCount);
+
+	return latencyoperationnames[op];
+}
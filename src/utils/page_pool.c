@@ -20,7 +20,9 @@
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/ucm.h"
+#include "workers/bgwriter.h"
 
+#include "storage/proc.h"
 #include "utils/memdebug.h"
 
 /*
@@ -40,6 +42,8 @@ ppool_estimate_space(OPagePool *pool, OInMemoryBlkno offset, OInMemoryBlkno size
 
 	result += CACHELINEALIGN(sizeof(pg_atomic_uint64));
 	result += CACHELINEALIGN(sizeof(pg_atomic_uint32));
+	result += CACHELINEALIGN(sizeof(OPagePoolStatCounters));
+	result += CACHELINEALIGN(sizeof(pg_atomic_uint32));
 
 	pool->ucmShmemSize = estimate_ucm_space(&pool->ucm, offset, size);
 
@@ -60,12 +64,25 @@ ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found)
 	pool->dirtyPagesCount = (pg_atomic_uint32 *) ptr;
 	ptr += CACHELINEALIGN(sizeof(pg_atomic_uint32));
 
+	pool->statCounters = (OPagePoolStatCounters *) ptr;
+	ptr += CACHELINEALIGN(sizeof(OPagePoolStatCounters));
+
+	pool->watermarkBoost = (pg_atomic_uint32 *) ptr;
+	ptr += CACHELINEALIGN(sizeof(pg_atomic_uint32));
+
 	if (!found)
 	{
 		pg_atomic_init_u64(pool->availablePagesCount, pool->size);
 		pg_atomic_init_u32(pool->dirtyPagesCount, 0);
+		pg_atomic_init_u64(&pool->statCounters->evictedForeground, 0);
+		pg_atomic_init_u64(&pool->statCounters->evictedBackground, 0);
+		pg_atomic_init_u64(&pool->statCounters->writtenForeground, 0);
+		pg_atomic_init_u64(&pool->statCounters->writtenBackground, 0);
+		pg_atomic_init_u32(pool->watermarkBoost, PPOOL_WATERMARK_BOOST_MIN);
 	}
 
+	pool->freeMagazineCount = 0;
+
 	init_ucm(&pool->ucm, ptr, found);
 
 #if PG_VERSION_NUM >= 150000
@@ -106,6 +123,16 @@ ppool_reserve_pages(OPagePool *pool, int kind, int count)
 		return;
 
 	val = pg_atomic_sub_fetch_u64(pool->availablePagesCount, count);
+
+	/*
+	 * Ask the background writers to refill the pool once it dips below the
+	 * watermark, so that the synchronous clock run below stays a last
+	 * resort.
+	 */
+	if ((val & (UINT64CONST(1) << 63)) ||
+		val < ppool_watermark_pages(pool))
+		bgwriter_wakeup();
+
 	while (val & (UINT64CONST(1) << 63))
 	{
 		ppool_run_clock(pool, true, NULL);
@@ -164,6 +191,24 @@ ppool_get_metapage(OPagePool *pool)
 	return ppool_get_page(pool, PPOOL_RESERVE_META);
 }
 
+/*
+ * The backend's home location in the pool.  Allocation starts the search
+ * for a free page here, so that concurrent backends allocate from disjoint
+ * regions of the pool: less contention over the same free pages, and the
+ * pages a backend works with tend to be placed on its local NUMA node by
+ * the first-touch policy.
+ */
+static OInMemoryBlkno
+ppool_backend_location(OPagePool *pool)
+{
+	if (MyProc == NULL)
+		return pool->offset;
+
+	return pool->offset +
+		(OInMemoryBlkno) ((uint64) pool->size *
+						  (MyProc->pgprocno % max_procs) / max_procs);
+}
+
 /*
  * Get next free page from the pool.
  *
@@ -177,7 +222,21 @@ ppool_get_page(OPagePool *pool, int kind)
 	Assert(pool->numPagesReserved[kind] > 0);
 	pool->numPagesReserved[kind]--;
 
-	result = ucm_occupy_free_page(&pool->ucm);
+	if (pool->freeMagazineCount > 0)
+	{
+		/*
+		 * Take a page from the backend-local magazine.  The page was never
+		 * returned to the global accounting, so the reservation that pays
+		 * for it goes back instead.
+		 */
+		result = pool->freeMagazine[--pool->freeMagazineCount];
+		pg_atomic_add_fetch_u64(pool->availablePagesCount, 1);
+	}
+	else
+	{
+		result = ucm_occupy_free_page(&pool->ucm,
+									  ppool_backend_location(pool));
+	}
 	Assert(pool->offset <= result && result < pool->offset + pool->size);
 
 	VALGRIND_CHECK_MEM_IS_DEFINED(O_GET_IN_MEMORY_PAGE(result), ORIOLEDB_BLCKSZ);
@@ -185,6 +244,41 @@ ppool_get_page(OPagePool *pool, int kind)
 	return result;
 }
 
+/*
+ * Spill `count` oldest pages of the backend-local magazine back to the
+ * global pool.  The counter of available pages is updated once for the
+ * whole batch.
+ */
+static void
+ppool_spill_magazine(OPagePool *pool, int count)
+{
+	int			i;
+
+	Assert(count > 0 && count <= pool->freeMagazineCount);
+
+	for (i = 0; i < count; i++)
+		page_change_usage_count(&pool->ucm, pool->freeMagazine[i],
+								UCM_FREE_PAGES_LEVEL);
+
+	pool->freeMagazineCount -= count;
+	memmove(&pool->freeMagazine[0], &pool->freeMagazine[count],
+			pool->freeMagazineCount * sizeof(OInMemoryBlkno));
+
+	pg_atomic_add_fetch_u64(pool->availablePagesCount, count);
+}
+
+/*
+ * Make all the pages from the backend-local magazine visible to other
+ * backends.  Called on transaction end, so that an idle backend doesn't keep
+ * free pages to itself.
+ */
+void
+ppool_flush_magazine(OPagePool *pool)
+{
+	if (pool->freeMagazineCount > 0)
+		ppool_spill_magazine(pool, pool->freeMagazineCount);
+}
+
 /*
  * Return free page to the pool.
  */
@@ -214,9 +308,19 @@ ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock)
 	page_desc->fileExtent.len = InvalidFileExtentLen;
 	unlock_page(blkno);
 
-	page_change_usage_count(&pool->ucm, blkno, UCM_FREE_PAGES_LEVEL);
+	/*
+	 * Keep the page in the backend-local magazine: page allocation is on the
+	 * page-split hot path, and reusing own recently freed pages avoids the
+	 * contention of concurrent backends over the same global free pages.
+	 * Until the magazine is spilled, the page stays in the
+	 * InvalidUsageCount state, invisible to both ucm_occupy_free_page() and
+	 * the eviction clock.
+	 */
+	if (pool->freeMagazineCount >= PPOOL_MAGAZINE_SIZE)
+		ppool_spill_magazine(pool, PPOOL_MAGAZINE_SIZE / 2);
 
-	pg_atomic_add_fetch_u64(pool->availablePagesCount, 1);
+	page_change_usage_count(&pool->ucm, blkno, InvalidUsageCount);
+	pool->freeMagazine[pool->freeMagazineCount++] = blkno;
 }
 
 /*
@@ -279,11 +383,23 @@ ppool_run_clock(OPagePool *pool, bool evict,
 		if (shutdown_requested != NULL && *shutdown_requested)
 			break;
 
+		OWalkPageResult walkResult;
+
 		blkno = ucm_next_blkno(&pool->ucm, blkno, 1);
 
 		Assert(blkno >= pool->offset && blkno < pool->offset + pool->size);
-		if (walk_page(blkno, evict) != OWalkPageSkipped)
+		walkResult = walk_page(blkno, evict);
+		if (walkResult != OWalkPageSkipped)
 		{
+			if (walkResult == OWalkPageEvicted ||
+				walkResult == OWalkPageMerged)
+				pg_atomic_fetch_add_u64(IsBGWriter ?
+										&pool->statCounters->evictedBackground :
+										&pool->statCounters->evictedForeground, 1);
+			else if (walkResult == OWalkPageWritten)
+				pg_atomic_fetch_add_u64(IsBGWriter ?
+										&pool->statCounters->writtenBackground :
+										&pool->statCounters->writtenForeground, 1);
 			Assert(!have_locked_pages());
 			break;
 		}
@@ -312,3 +428,40 @@ ppool_run_clock(OPagePool *pool, bool evict,
 			reserve_undo_size(UndoReserveTxn, undoSize);
 	}
 }
+
+/*
+ * Adapt the free pages watermark of every pool to the observed foreground
+ * pressure.  Any growth of the foreground clock counters since the last call
+ * means backends had to evict or write pages synchronously, so the watermark
+ * boost of that pool is raised and the background writers keep a deeper
+ * reserve of allocatable pages there; pools without foreground activity
+ * decay back to the configured watermark.  Called from a single background
+ * writer once per pass, see bgwriter_main().
+ */
+void
+ppool_adjust_watermarks(void)
+{
+	static uint64 prevForeground[OPagePoolTypesCount] = {0};
+	int			i;
+
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = get_ppool((OPagePoolType) i);
+		uint64		foreground;
+		uint32		boost;
+
+		foreground = pg_atomic_read_u64(&pool->statCounters->evictedForeground) +
+			pg_atomic_read_u64(&pool->statCounters->writtenForeground);
+
+		boost = pg_atomic_read_u32(pool->watermarkBoost);
+		if (foreground > prevForeground[i])
+			boost = Min(boost + PPOOL_WATERMARK_BOOST_STEP,
+						PPOOL_WATERMARK_BOOST_MAX);
+		else
+			boost = Max(boost - PPOOL_WATERMARK_BOOST_DECAY,
+						PPOOL_WATERMARK_BOOST_MIN);
+		pg_atomic_write_u32(pool->watermarkBoost, boost);
+
+		prevForeground[i] = foreground;
+	}
+}
@@ -0,0 +1,243 @@
+/*-------------------------------------------------------------------------
+ *
+ * page_waits.c
+ *		Page lock and I/O wait tracking.
+ *
+ * Every sleep of a backend on shared engine state (the page lock waiters
+ * queue, read-enable and changecount waits, I/O completion and throttling,
+ * the seq buffer previous page write) is bracketed by
+ * o_page_wait_start()/o_page_wait_end().  While a backend sleeps,
+ * pg_stat_activity shows it in the "Extension" wait event class, and its
+ * slot here records which site blocks it together with the blocked page
+ * and the owning tree.  Ended waits are accumulated per backend and per
+ * site; the slots are single-writer, so the hot path needs no locks, and
+ * the monitoring readers accept slightly torn snapshots.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/page_waits.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/page_waits.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "portability/instr_time.h"
+#include "storage/proc.h"
+#include "utils/builtins.h"
+
+PG_FUNCTION_INFO_V1(orioledb_page_waits_stats);
+PG_FUNCTION_INFO_V1(orioledb_page_waiters);
+
+/* value of OPageWaitProcState.site while the backend isn't waiting */
+#define PW_NOT_WAITING (0xFFFFFFFF)
+
+typedef struct OPageWaitProcState
+{
+	/* the site the backend currently sleeps at, or PW_NOT_WAITING */
+	uint32		site;
+	OInMemoryBlkno blkno;
+	ORelOids	oids;
+	int			pid;
+
+	/* accumulators of ended waits, indexed by OPageWaitSite */
+	uint64		counts[OPageWaitSitesCount];
+	uint64		timeNs[OPageWaitSitesCount];
+} OPageWaitProcState;
+
+static OPageWaitProcState *pageWaitStates = NULL;
+static OPageWaitSite pageWaitCurSite;
+static instr_time pageWaitCurStart;
+
+static const char *const pagewaitsitenames[] = {
+	"page_lock",
+	"read_enable",
+	"changecount",
+	"io_completion",
+	"io_throttle",
+	"seq_buf_prev_page"
+};
+
+StaticAssertDecl(lengthof(pagewaitsitenames) == OPageWaitSitesCount,
+				 "pagewaitsitenames covers OPageWaitSite");
+
+Size
+page_waits_shmem_needs(void)
+{
+	return mul_size(max_procs, sizeof(OPageWaitProcState));
+}
+
+void
+page_waits_shmem_init(Pointer ptr, bool found)
+{
+	pageWaitStates = (OPageWaitProcState *) ptr;
+
+	if (!found)
+	{
+		int			i;
+
+		memset(ptr, 0, page_waits_shmem_needs());
+		for (i = 0; i < max_procs; i++)
+			pageWaitStates[i].site = PW_NOT_WAITING;
+	}
+}
+
+void
+o_page_wait_start(OPageWaitSite site, OInMemoryBlkno blkno)
+{
+	OPageWaitProcState *state;
+
+	Assert(site >= 0 && site < OPageWaitSitesCount);
+
+	if (pageWaitStates == NULL || MyProc == NULL)
+		return;
+
+	state = &pageWaitStates[MyProc->pgprocno];
+	state->blkno = blkno;
+	if (OInMemoryBlknoIsValid(blkno))
+		state->oids = O_GET_IN_MEMORY_PAGEDESC(blkno)->oids;
+	else
+		memset(&state->oids, 0, sizeof(state->oids));
+	state->pid = MyProcPid;
+	pg_write_barrier();
+	state->site = site;
+
+	pageWaitCurSite = site;
+	INSTR_TIME_SET_CURRENT(pageWaitCurStart);
+	pgstat_report_wait_start(PG_WAIT_EXTENSION);
+}
+
+void
+o_page_wait_end(void)
+{
+	OPageWaitProcState *state;
+	instr_time	duration;
+
+	if (pageWaitStates == NULL || MyProc == NULL)
+		return;
+
+	pgstat_report_wait_end();
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, pageWaitCurStart);
+
+	state = &pageWaitStates[MyProc->pgprocno];
+	state->site = PW_NOT_WAITING;
+	pg_write_barrier();
+	state->counts[pageWaitCurSite]++;
+	state->timeNs[pageWaitCurSite] +=
+		(uint64) INSTR_TIME_GET_NANOSEC(duration);
+}
+
+/*
+ * Common tuplestore boilerplate of the two monitoring functions.
+ */
+static Tuplestorestate *
+page_waits_srf_init(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	bool		randomAccess;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+Datum
+orioledb_page_waits_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	int			site;
+
+	orioledb_check_shmem();
+
+	tupstore = page_waits_srf_init(fcinfo, &tupdesc);
+
+	for (site = 0; site < OPageWaitSitesCount; site++)
+	{
+		Datum		values[3];
+		bool		nulls[3] = {false, false, false};
+		uint64		count = 0,
+					timeNs = 0;
+		int			i;
+
+		for (i = 0; i < max_procs; i++)
+		{
+			count += pageWaitStates[i].counts[site];
+			timeNs += pageWaitStates[i].timeNs[site];
+		}
+
+		values[0] = CStringGetTextDatum(pagewaitsitenames[site]);
+		values[1] = Int64GetDatum((int64) count);
+		values[2] = Float8GetDatum((double) timeNs / 1000000.0);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	PG_RETURN_NULL();
+}
+
+Datum
+orioledb_page_waiters(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	int			i;
+
+	orioledb_check_shmem();
+
+	tupstore = page_waits_srf_init(fcinfo, &tupdesc);
+
+	for (i = 0; i < max_procs; i++)
+	{
+		OPageWaitProcState state = pageWaitStates[i];
+		Datum		values[6];
+		bool		nulls[6] = {false, false, false, false, false, false};
+
+		if (state.site >= OPageWaitSitesCount)
+			continue;
+
+		values[0] = Int32GetDatum(state.pid);
+		values[1] = CStringGetTextDatum(pagewaitsitenames[state.site]);
+		if (OInMemoryBlknoIsValid(state.blkno))
+			values[2] = Int64GetDatum((int64) state.blkno);
+		else
+			nulls[2] = true;
+		values[3] = ObjectIdGetDatum(state.oids.datoid);
+		values[4] = ObjectIdGetDatum(state.oids.reloid);
+		values[5] = ObjectIdGetDatum(state.oids.relnode);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	PG_RETURN_NULL();
+}
@@ -0,0 +1,347 @@
+/*-------------------------------------------------------------------------
+ *
+ * prewarm.c
+ *		Page pool prewarming.
+ *
+ * Periodically dumps identifiers of the high-usage pages of the page pools
+ * to a file, and re-reads those pages from data files after a restart, so
+ * that the working set doesn't have to be refilled by demand misses one
+ * synchronous disk read at a time.
+ *
+ * The dump records (tree oids, index type, file extent) of every in-memory
+ * page whose usage count is well above the eviction edge.  The loader
+ * resolves each tree by its oids and reads the extents through
+ * read_page_from_disk() into a scratch buffer: the pages enter the OS page
+ * cache (and the decompress cache for compressed trees), so the subsequent
+ * demand loads through load_page() hit memory instead of disk.  Extents are
+ * read in file order, which makes the refill sequential I/O.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/prewarm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/io.h"
+#include "btree/page_contents.h"
+#include "catalog/sys_trees.h"
+#include "tableam/descr.h"
+#include "utils/page_pool.h"
+#include "utils/prewarm.h"
+#include "utils/ucm.h"
+
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/fd.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/sinvaladt.h"
+#include "utils/memutils.h"
+#include "utils/timeout.h"
+
+#include "pgstat.h"
+
+#define PREWARM_FILENAME		ORIOLEDB_DATA_DIR "/prewarm"
+#define PREWARM_TMP_FILENAME	ORIOLEDB_DATA_DIR "/prewarm.tmp"
+#define PREWARM_MAGIC			0x50524557
+
+/*
+ * A page is dumped when its usage count is at least this many levels above
+ * the eviction edge of the UCM clock.
+ */
+#define PREWARM_MIN_USAGE		2
+
+typedef struct
+{
+	ORelOids	oids;
+	uint32		type;
+	uint64		off;
+	uint32		len;
+} PrewarmRecord;
+
+typedef struct
+{
+	uint32		magic;
+	uint32		count;
+} PrewarmFileHeader;
+
+int			prewarm_interval = 0;
+
+static volatile sig_atomic_t shutdown_requested = false;
+
+static void
+handle_sigterm(SIGNAL_ARGS)
+{
+	shutdown_requested = true;
+	SetLatch(MyLatch);
+}
+
+static int
+prewarm_record_cmp(const void *p1, const void *p2)
+{
+	const PrewarmRecord *r1 = (const PrewarmRecord *) p1;
+	const PrewarmRecord *r2 = (const PrewarmRecord *) p2;
+
+	if (r1->oids.datoid != r2->oids.datoid)
+		return r1->oids.datoid < r2->oids.datoid ? -1 : 1;
+	if (r1->oids.relnode != r2->oids.relnode)
+		return r1->oids.relnode < r2->oids.relnode ? -1 : 1;
+	if (r1->off != r2->off)
+		return r1->off < r2->off ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Collect identifiers of high-usage pages and write them to the dump file.
+ * The walk reads page headers without locks: a concurrently changing page
+ * only makes an individual record stale, which the loader tolerates.
+ */
+static void
+prewarm_dump(void)
+{
+	PrewarmRecord *records;
+	PrewarmFileHeader header;
+	OInMemoryBlkno totalSize = 0;
+	OPagePoolType poolType;
+	File		file;
+	uint32		count = 0;
+	Size		writeSize;
+
+	for (poolType = 0; poolType < OPagePoolTypesCount; poolType++)
+		totalSize += get_ppool(poolType)->size;
+
+	records = (PrewarmRecord *) palloc(sizeof(PrewarmRecord) * totalSize);
+
+	for (poolType = 0; poolType < OPagePoolTypesCount; poolType++)
+	{
+		OPagePool  *pool = get_ppool(poolType);
+		uint32		epoch = pg_atomic_read_u32(pool->ucm.epoch);
+		OInMemoryBlkno blkno;
+
+		for (blkno = pool->offset; blkno < pool->offset + pool->size; blkno++)
+		{
+			Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+			OrioleDBPageDesc *pageDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+			uint32		usageCount;
+
+			usageCount = pg_atomic_read_u32(&(O_PAGE_HEADER(p)->usageCount));
+			if (usageCount >= UCM_USAGE_LEVELS)
+				continue;
+			if ((UCM_USAGE_LEVELS + usageCount - epoch) % UCM_USAGE_LEVELS <
+				PREWARM_MIN_USAGE)
+				continue;
+
+			if (!ORelOidsIsValid(pageDesc->oids) ||
+				IS_SYS_TREE_OIDS(pageDesc->oids) ||
+				pageDesc->type == oIndexInvalid ||
+				!FileExtentIsValid(pageDesc->fileExtent))
+				continue;
+
+			records[count].oids = pageDesc->oids;
+			records[count].type = pageDesc->type;
+			records[count].off = pageDesc->fileExtent.off;
+			records[count].len = pageDesc->fileExtent.len;
+			count++;
+		}
+	}
+
+	qsort(records, count, sizeof(PrewarmRecord), prewarm_record_cmp);
+
+	file = PathNameOpenFile(PREWARM_TMP_FILENAME,
+							O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+	if (file < 0)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not open prewarm file %s",
+							 PREWARM_TMP_FILENAME)));
+		pfree(records);
+		return;
+	}
+
+	header.magic = PREWARM_MAGIC;
+	header.count = count;
+	writeSize = sizeof(PrewarmRecord) * count;
+	if (OFileWrite(file, (Pointer) &header, sizeof(header), 0,
+				   WAIT_EVENT_DATA_FILE_WRITE) != sizeof(header) ||
+		OFileWrite(file, (Pointer) records, writeSize, sizeof(header),
+				   WAIT_EVENT_DATA_FILE_WRITE) != writeSize ||
+		FileSync(file, WAIT_EVENT_DATA_FILE_SYNC) != 0)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not write prewarm file %s",
+							 PREWARM_TMP_FILENAME)));
+		FileClose(file);
+		pfree(records);
+		return;
+	}
+	FileClose(file);
+	pfree(records);
+
+	durable_rename(PREWARM_TMP_FILENAME, PREWARM_FILENAME, LOG);
+}
+
+/*
+ * Read the pages recorded in the dump file back from the data files.
+ *
+ * Trees which no longer exist and extents which fail to read are silently
+ * skipped: the dump describes a past state of the pools and is only a hint.
+ */
+static void
+prewarm_load(void)
+{
+	PrewarmFileHeader header;
+	PrewarmRecord *records;
+	OIndexDescr *indexDescr = NULL;
+	ORelOids	curOids = {0, 0, 0};
+	char		img[ORIOLEDB_BLCKSZ];
+	File		file;
+	Size		readSize;
+	uint32		loaded = 0;
+	uint32		i;
+
+	file = PathNameOpenFile(PREWARM_FILENAME, O_RDONLY | PG_BINARY);
+	if (file < 0)
+		return;
+
+	if (OFileRead(file, (Pointer) &header, sizeof(header), 0,
+				  WAIT_EVENT_DATA_FILE_READ) != sizeof(header) ||
+		header.magic != PREWARM_MAGIC)
+	{
+		ereport(LOG, (errmsg("skipping invalid prewarm file %s",
+							 PREWARM_FILENAME)));
+		FileClose(file);
+		return;
+	}
+
+	records = (PrewarmRecord *) palloc(sizeof(PrewarmRecord) * header.count);
+	readSize = sizeof(PrewarmRecord) * header.count;
+	if (OFileRead(file, (Pointer) records, readSize, sizeof(header),
+				  WAIT_EVENT_DATA_FILE_READ) != readSize)
+	{
+		ereport(LOG, (errmsg("skipping truncated prewarm file %s",
+							 PREWARM_FILENAME)));
+		FileClose(file);
+		pfree(records);
+		return;
+	}
+	FileClose(file);
+
+	for (i = 0; i < header.count && !shutdown_requested; i++)
+	{
+		PrewarmRecord *record = &records[i];
+		FileExtent	extent;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (!ORelOidsIsEqual(curOids, record->oids) || indexDescr == NULL)
+		{
+			curOids = record->oids;
+			indexDescr = o_fetch_index_descr(curOids, record->type,
+											 false, NULL);
+		}
+
+		if (indexDescr == NULL || !indexDescr->valid)
+			continue;
+
+		extent.off = record->off;
+		extent.len = record->len;
+		if (!FileExtentIsValid(extent))
+			continue;
+
+		if (read_page_from_disk(&indexDescr->desc, img,
+								MAKE_ON_DISK_DOWNLINK(extent), &extent))
+			loaded++;
+	}
+
+	pfree(records);
+	elog(LOG, "orioledb prewarm: %u of %u pages read", loaded, header.count);
+}
+
+void
+register_prewarm_worker(void)
+{
+	BackgroundWorker worker;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 0;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "prewarm_worker_main");
+	strcpy(worker.bgw_name, "orioledb prewarm worker");
+	strcpy(worker.bgw_type, "orioledb prewarm worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+void
+prewarm_worker_main(Datum main_arg)
+{
+	int			rc,
+				wake_events = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT;
+
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+
+	/* enable relation cache invalidation (remove old OTableDescr) */
+	RelationCacheInitialize();
+	InitCatalogCache();
+	SharedInvalBackendInit(false);
+
+	/* show the worker in pg_stat_activity */
+	InitializeSessionUserIdStandalone();
+#if PG_VERSION_NUM >= 140000
+	pgstat_beinit();
+#else
+	pgstat_initialize();
+#endif
+	pgstat_bestart();
+
+	SetProcessingMode(NormalProcessing);
+
+	pqsignal(SIGTERM, handle_sigterm);
+	BackgroundWorkerUnblockSignals();
+
+	elog(LOG, "orioledb prewarm worker started");
+
+	ResetLatch(MyLatch);
+
+	PG_TRY();
+	{
+		prewarm_load();
+
+		while (!shutdown_requested)
+		{
+			rc = WaitLatch(MyLatch, wake_events,
+						   prewarm_interval * 1000L,
+						   PG_WAIT_EXTENSION);
+
+			if (rc & WL_POSTMASTER_DEATH)
+				break;
+
+			if (shutdown_requested)
+				break;
+
+			if (rc & WL_TIMEOUT)
+				prewarm_dump();
+
+			ResetLatch(MyLatch);
+		}
+
+		/* Keep the dump fresh for the next start */
+		if (shutdown_requested)
+			prewarm_dump();
+
+		elog(LOG, "orioledb prewarm worker is shut down");
+	}
+	PG_CATCH();
+	{
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
@@ -26,6 +26,7 @@
 #include "orioledb.h"
 
 #include "btree/io.h"
+#include "utils/page_waits.h"
 #include "utils/seq_buf.h"
 
 #include "pgstat.h"
@@ -58,6 +59,9 @@
 static bool seq_buf_tag_eq(SeqBufTag *t1, SeqBufTag *t2);
 static bool seq_buf_check_open_file(SeqBufDescPrivate *private);
 static bool seq_buf_switch_page(SeqBufDescPrivate *private);
+static bool seq_buf_run_flush(SeqBufDescPrivate *private,
+							  int pageNum, uint32 filePageNum);
+static bool seq_buf_drain_flushes(SeqBufDescPrivate *private);
 static inline bool seq_buf_rw(SeqBufDescPrivate *private,
 							  char *data, Size data_size, bool write);
 static bool seq_buf_read_pages(SeqBufDescPrivate *private,
@@ -85,11 +89,16 @@ init_seq_buf(SeqBufDescPrivate *private, SeqBufDescShared *shared,
 		SpinLockInit(&shared->lock);
 		SpinLockAcquire(&shared->lock);
 
-		Assert(OInMemoryBlknoIsValid(shared->pages[0])
-			   && OInMemoryBlknoIsValid(shared->pages[1]));
+#ifdef USE_ASSERT_CHECKING
+		for (i = 0; i < SEQ_BUF_PAGES; i++)
+			Assert(OInMemoryBlknoIsValid(shared->pages[i]));
+#endif
 
 		shared->curPageNum = 0;
 		shared->filePageNum = 0;
+		shared->flushPageNum = 0;
+		shared->flushFilePageNum = 0;
+		shared->pendingPageNum = -1;
 		shared->freeBytesNum = 0;
 		shared->location = SEQBUF_DATA_OFF + (evicted_used ? 0 : skip_len);
 		shared->tag = *tag;
@@ -97,7 +106,7 @@ init_seq_buf(SeqBufDescPrivate *private, SeqBufDescShared *shared,
 		shared->evictOffset = evicted_used ? evicted->offset : 0;
 		private->tag = *tag;
 
-		for (i = 0; i < 2; i++)
+		for (i = 0; i < SEQ_BUF_PAGES; i++)
 		{
 			OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(shared->pages[i]);
 
@@ -228,6 +237,7 @@ seq_buf_wait_prev_page(SeqBufDescShared *shared)
 	if (shared->prevPageState != SeqBufPrevPageInProgress)
 		return false;
 
+	o_page_wait_start(OPageWaitSeqBufPrevPage, OInvalidInMemoryBlkno);
 	init_local_spin_delay(&status);
 	while (shared->prevPageState == SeqBufPrevPageInProgress)
 	{
@@ -236,84 +246,168 @@ seq_buf_wait_prev_page(SeqBufDescShared *shared)
 		SpinLockAcquire(&shared->lock);
 	}
 	finish_spin_delay(&status);
+	o_page_wait_end();
 	return true;
 }
 
+/*
+ * Write given ring page to the corresponding file page.  The caller should
+ * not hold the spinlock: prevPageState guards the page against reuse while
+ * the write is in flight.
+ */
 static bool
-seq_buf_finish_prev_page(SeqBufDescPrivate *private)
+seq_buf_flush_page(SeqBufDescPrivate *private, int pageNum, uint32 filePageNum)
 {
 	SeqBufDescShared *shared = private->shared;
-	off_t		offset;
+	off_t		offset = SEQBUF_FILE_OFFSET(shared, (off_t) filePageNum);
 
-	if (private->write)
+	if (OFileWrite(private->file,
+				   SEQBUF_DATA_POS(O_GET_IN_MEMORY_PAGE(shared->pages[pageNum])),
+				   SEQBUF_CHUNK_SIZE, offset, WAIT_EVENT_SLRU_WRITE) != SEQBUF_CHUNK_SIZE)
+	{
+		ereport(PANIC, (errcode_for_file_access(),
+						errmsg("Error write seq buf %s at offset %u",
+							   FilePathName(private->file),
+							   (uint32) offset)));
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Flush given ring page and then any page parked by producers meanwhile.
+ * Enters and returns with the spinlock held, the write itself is performed
+ * with the lock released and prevPageState set to in-progress.
+ */
+static bool
+seq_buf_run_flush(SeqBufDescPrivate *private, int pageNum, uint32 filePageNum)
+{
+	SeqBufDescShared *shared = private->shared;
+
+	Assert(private->write);
+
+	while (true)
 	{
-		offset = SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum - 1);
+		shared->flushPageNum = pageNum;
+		shared->flushFilePageNum = filePageNum;
+		shared->prevPageState = SeqBufPrevPageInProgress;
+		SpinLockRelease(&shared->lock);
 
-		/* Write previous page */
-		if (OFileWrite(private->file,
-					   SEQBUF_DATA_POS(O_GET_IN_MEMORY_PAGE(shared->pages[1 - shared->curPageNum])),
-					   SEQBUF_CHUNK_SIZE, offset, WAIT_EVENT_SLRU_WRITE) != SEQBUF_CHUNK_SIZE)
+		if (!seq_buf_flush_page(private, pageNum, filePageNum))
 		{
-			SpinLockRelease(&shared->lock);
-			ereport(PANIC, (errcode_for_file_access(),
-							errmsg("Error write seq buf %s at offset %u",
-								   FilePathName(private->file),
-								   (uint32) offset)));
+			SpinLockAcquire(&shared->lock);
+			shared->prevPageState = SeqBufPrevPageError;
 			return false;
 		}
-	}
-	else
-	{
-		char		buf[ORIOLEDB_BLCKSZ];
 
-		memset(buf, 0xFF, ORIOLEDB_BLCKSZ);
-#ifdef USE_ASSERT_CHECKING
-		put_page_image(shared->pages[1 - shared->curPageNum], buf);
-#endif
-		if (shared->freeBytesNum > 0)
+		SpinLockAcquire(&shared->lock);
+		if (shared->pendingPageNum < 0)
 		{
-			/* Read next page */
-			int			nbytes;
+			shared->prevPageState = SeqBufPrevPageDone;
+			return true;
+		}
 
-			offset = SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum + 1);
+		/* Pick up the parked page, keeping prevPageState in-progress. */
+		pageNum = shared->pendingPageNum;
+		filePageNum = shared->pendingFilePageNum;
+		shared->pendingPageNum = -1;
+	}
+}
 
-			if ((nbytes = OFileRead(private->file, SEQBUF_DATA_POS(buf), SEQBUF_CHUNK_SIZE,
-									offset, WAIT_EVENT_SLRU_READ)) == 0)
-			{
-				SpinLockRelease(&shared->lock);
-				ereport(PANIC, (errcode_for_file_access(),
-								errmsg("Error read seq buf %s at offset %u",
-									   FilePathName(private->file),
-									   (uint32) offset)));
-				return false;
-			}
+/*
+ * Wait out and retry all in-flight, failed and parked page flushes.
+ * The spinlock should be held.
+ */
+static bool
+seq_buf_drain_flushes(SeqBufDescPrivate *private)
+{
+	SeqBufDescShared *shared = private->shared;
 
-			if (shared->freeBytesNum >= SEQBUF_CHUNK_SIZE &&
-				nbytes != SEQBUF_CHUNK_SIZE)
-			{
-				SpinLockRelease(&shared->lock);
-				Assert(nbytes < SEQBUF_CHUNK_SIZE);
-				elog(PANIC, "Error read sequence buffer file %s at offset %u."
-					 "Bytes read = %d is less than expected = %ld.",
-					 get_seq_buf_filename(&private->tag), (uint32) offset,
-					 nbytes, SEQBUF_CHUNK_SIZE);
+	Assert(private->write);
+
+	while (true)
+	{
+		seq_buf_wait_prev_page(shared);
+		if (shared->prevPageState == SeqBufPrevPageError)
+		{
+			if (!seq_buf_run_flush(private, shared->flushPageNum,
+								   shared->flushFilePageNum))
 				return false;
-			}
-			else if (shared->freeBytesNum < SEQBUF_CHUNK_SIZE &&
-					 shared->freeBytesNum != nbytes)
-			{
-				SpinLockRelease(&shared->lock);
-				elog(PANIC, "Error read sequence buffer file %s at offset %u. "
-					 "Bytes read = %d is not equal than expected = %lu",
-					 get_seq_buf_filename(&private->tag), (uint32) offset,
-					 nbytes, (uint64) shared->freeBytesNum);
+		}
+		else if (shared->pendingPageNum >= 0)
+		{
+			int			pageNum = shared->pendingPageNum;
+			uint32		filePageNum = shared->pendingFilePageNum;
+
+			shared->pendingPageNum = -1;
+			if (!seq_buf_run_flush(private, pageNum, filePageNum))
 				return false;
-			}
+		}
+		else
+			return true;
+	}
+}
 
-			shared->freeBytesNum -= nbytes;
-			Assert(shared->freeBytesNum >= 0);
-			put_page_image(shared->pages[1 - shared->curPageNum], buf);
+/*
+ * Read ahead the next file page into the spare page.  Only used in read
+ * mode: write mode flushes pages via seq_buf_run_flush().
+ */
+static bool
+seq_buf_finish_prev_page(SeqBufDescPrivate *private)
+{
+	SeqBufDescShared *shared = private->shared;
+	off_t		offset;
+	char		buf[ORIOLEDB_BLCKSZ];
+
+	Assert(!private->write);
+
+	memset(buf, 0xFF, ORIOLEDB_BLCKSZ);
+#ifdef USE_ASSERT_CHECKING
+	put_page_image(shared->pages[1 - shared->curPageNum], buf);
+#endif
+	if (shared->freeBytesNum > 0)
+	{
+		/* Read next page */
+		int			nbytes;
+
+		offset = SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum + 1);
+
+		if ((nbytes = OFileRead(private->file, SEQBUF_DATA_POS(buf), SEQBUF_CHUNK_SIZE,
+								offset, WAIT_EVENT_SLRU_READ)) == 0)
+		{
+			SpinLockRelease(&shared->lock);
+			ereport(PANIC, (errcode_for_file_access(),
+							errmsg("Error read seq buf %s at offset %u",
+								   FilePathName(private->file),
+								   (uint32) offset)));
+			return false;
 		}
+
+		if (shared->freeBytesNum >= SEQBUF_CHUNK_SIZE &&
+			nbytes != SEQBUF_CHUNK_SIZE)
+		{
+			SpinLockRelease(&shared->lock);
+			Assert(nbytes < SEQBUF_CHUNK_SIZE);
+			elog(PANIC, "Error read sequence buffer file %s at offset %u."
+				 "Bytes read = %d is less than expected = %ld.",
+				 get_seq_buf_filename(&private->tag), (uint32) offset,
+				 nbytes, SEQBUF_CHUNK_SIZE);
+			return false;
+		}
+		else if (shared->freeBytesNum < SEQBUF_CHUNK_SIZE &&
+				 shared->freeBytesNum != nbytes)
+		{
+			SpinLockRelease(&shared->lock);
+			elog(PANIC, "Error read sequence buffer file %s at offset %u. "
+				 "Bytes read = %d is not equal than expected = %lu",
+				 get_seq_buf_filename(&private->tag), (uint32) offset,
+				 nbytes, (uint64) shared->freeBytesNum);
+			return false;
+		}
+
+		shared->freeBytesNum -= nbytes;
+		Assert(shared->freeBytesNum >= 0);
+		put_page_image(shared->pages[1 - shared->curPageNum], buf);
 	}
 	return true;
 }
@@ -322,6 +416,11 @@ seq_buf_finish_prev_page(SeqBufDescPrivate *private)
  * Switch to the next page after filePageNum.  Function returns control when
  * we have switched to the next page or other process did it instead of us.
  *
+ * In write mode the pages form a ring: if a flush of the previous page is
+ * still in flight, the filled page is parked for the flusher and the switch
+ * completes without waiting for write I/O.  A producer only waits when both
+ * spare pages of the ring are busy.
+ *
  * Private->shared should be locked. Call unlocks private->shared.
  */
 static bool
@@ -337,6 +436,69 @@ seq_buf_switch_page(SeqBufDescPrivate *private)
 		return false;
 	}
 
+	if (private->write)
+	{
+		int			prevPageNum;
+		uint32		prevFilePageNum;
+
+		while (true)
+		{
+			/* Check if it's already switched after given page number... */
+			if (shared->filePageNum != filePageNum)
+			{
+				SpinLockRelease(&shared->lock);
+				return true;
+			}
+
+			if (shared->prevPageState == SeqBufPrevPageError)
+			{
+				/* Retry the failed flush before reusing its page */
+				if (!seq_buf_run_flush(private, shared->flushPageNum,
+									   shared->flushFilePageNum))
+				{
+					SpinLockRelease(&shared->lock);
+					return false;
+				}
+				continue;
+			}
+
+			if (shared->prevPageState == SeqBufPrevPageInProgress &&
+				shared->pendingPageNum >= 0)
+			{
+				/* Both spare pages are busy, wait for the flusher */
+				seq_buf_wait_prev_page(shared);
+				continue;
+			}
+			break;
+		}
+
+		Assert(shared->location == ORIOLEDB_BLCKSZ);
+
+		prevPageNum = shared->curPageNum;
+		prevFilePageNum = shared->filePageNum;
+		shared->curPageNum = (shared->curPageNum + 1) % SEQ_BUF_PAGES;
+		shared->filePageNum++;
+		shared->location = SEQBUF_DATA_OFF;
+
+		if (shared->prevPageState == SeqBufPrevPageInProgress)
+		{
+			/*
+			 * A flush is in flight: park the filled page for the flusher and
+			 * continue without waiting for write I/O.
+			 */
+			shared->pendingPageNum = prevPageNum;
+			shared->pendingFilePageNum = prevFilePageNum;
+			SpinLockRelease(&shared->lock);
+			return true;
+		}
+
+		(void) seq_buf_run_flush(private, prevPageNum, prevFilePageNum);
+		SpinLockRelease(&shared->lock);
+
+		/* If even we didn't flush the previous page, current page is OK. */
+		return true;
+	}
+
 	/* Check if it's already switched after given page number... */
 	if (shared->filePageNum != filePageNum)
 	{
@@ -472,26 +634,21 @@ seq_buf_finalize(SeqBufDescPrivate *private)
 	off_t		result;
 
 	SpinLockAcquire(&shared->lock);
-	seq_buf_wait_prev_page(shared);
-	if (shared->prevPageState == SeqBufPrevPageError)
+	if (private->write)
 	{
-		if (!seq_buf_finish_prev_page(private))
+		if (!seq_buf_check_open_file(private))
 		{
 			SpinLockRelease(&shared->lock);
 			ereport(PANIC, (errcode_for_file_access(),
-							errmsg("could not finalize previous sequence buffer page to file %s",
+							errmsg("could not open sequence buffer file %s",
 								   get_seq_buf_filename(&private->tag))));
 		}
-		shared->prevPageState = SeqBufPrevPageDone;
-	}
 
-	if (private->write)
-	{
-		if (!seq_buf_check_open_file(private))
+		if (!seq_buf_drain_flushes(private))
 		{
 			SpinLockRelease(&shared->lock);
 			ereport(PANIC, (errcode_for_file_access(),
-							errmsg("could not open sequence buffer file %s",
+							errmsg("could not finalize previous sequence buffer page to file %s",
 								   get_seq_buf_filename(&private->tag))));
 		}
 
@@ -509,6 +666,21 @@ seq_buf_finalize(SeqBufDescPrivate *private)
 			}
 		}
 	}
+	else
+	{
+		seq_buf_wait_prev_page(shared);
+		if (shared->prevPageState == SeqBufPrevPageError)
+		{
+			if (!seq_buf_finish_prev_page(private))
+			{
+				SpinLockRelease(&shared->lock);
+				ereport(PANIC, (errcode_for_file_access(),
+								errmsg("could not finalize previous sequence buffer page to file %s",
+									   get_seq_buf_filename(&private->tag))));
+			}
+			shared->prevPageState = SeqBufPrevPageDone;
+		}
+	}
 
 	result = SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum)
 		+ (shared->location - SEQBUF_DATA_OFF);
@@ -598,6 +770,7 @@ seq_buf_try_replace(SeqBufDescPrivate *private, SeqBufTag *tag,
 
 	shared->curPageNum = 0;
 	shared->filePageNum = 0;
+	shared->pendingPageNum = -1;
 	/* reads data from tmp file, it has not header */
 	shared->location = SEQBUF_DATA_OFF;
 	shared->evictOffset = 0;
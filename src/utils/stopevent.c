@@ -29,6 +29,7 @@
 #include "utils/jsonpath.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timestamp.h"
 
 #define QUERY_BUFFER_SIZE 1024
 
@@ -407,3 +408,223 @@ stopevents_make_cxt(void)
 											   "StopEventsMemoryContext",
 											   ALLOCSET_DEFAULT_SIZES);
 }
+
+/*
+ * Binary tracepoints.
+ *
+ * Stop events pay for their flexibility: every firing builds Jsonb
+ * parameters, and the firing backend can evaluate a jsonpath condition.
+ * That makes them unsuitable for always-on production use.  Tracepoints
+ * cover the hot-path events needed to diagnose tail latency with a
+ * fixed-layout record appended to a per-backend ring buffer: one timestamp
+ * call, a few stores and a write barrier per event, no locks.
+ *
+ * Each backend writes only its own ring.  The insert position is bumped
+ * with an atomic write after the record contents, so a concurrent drain
+ * can detect records that may have been overwritten under it: it copies
+ * the ring, re-reads the insert position and discards everything the new
+ * position proves recycled.
+ */
+typedef struct OTracepointRecord
+{
+	TimestampTz time;
+	uint64		arg1;
+	uint64		arg2;
+	uint32		kind;
+} OTracepointRecord;
+
+typedef struct OTracepointBuffer
+{
+	pg_atomic_uint64 insertPos;
+	int			pid;
+	OTracepointRecord records[FLEXIBLE_ARRAY_MEMBER];
+} OTracepointBuffer;
+
+Pointer		oTracepointBuffers = NULL;
+
+static uint64 tracepointRecordsCount = 0;
+static Size tracepointBufferStride = 0;
+
+PG_FUNCTION_INFO_V1(orioledb_tracepoints);
+
+static const char *const tracepointnames[] = {
+	"page_lock_wait",
+	"page_split",
+	"page_evict",
+	"undo_retention_stall"
+};
+
+StaticAssertDecl(lengthof(tracepointnames) == OTRACEPOINT_COUNT,
+				 "tracepointnames covers OTracepointKind");
+
+static inline OTracepointBuffer *
+otracepoint_buffer(int pgprocno)
+{
+	return (OTracepointBuffer *) (oTracepointBuffers +
+								  tracepointBufferStride * pgprocno);
+}
+
+Size
+TracepointShmemSize(void)
+{
+	if (tracepoint_buffers_size < sizeof(OTracepointRecord))
+		return 0;
+
+	tracepointRecordsCount = tracepoint_buffers_size / sizeof(OTracepointRecord);
+	tracepointBufferStride =
+		CACHELINEALIGN(offsetof(OTracepointBuffer, records) +
+					   mul_size(tracepointRecordsCount,
+								sizeof(OTracepointRecord)));
+	return mul_size(max_procs, tracepointBufferStride);
+}
+
+void
+TracepointShmemInit(Pointer ptr, bool found)
+{
+	if (tracepoint_buffers_size < sizeof(OTracepointRecord))
+	{
+		oTracepointBuffers = NULL;
+		return;
+	}
+
+	oTracepointBuffers = ptr;
+
+	if (!found)
+	{
+		int			i;
+
+		for (i = 0; i < max_procs; i++)
+		{
+			OTracepointBuffer *buffer = otracepoint_buffer(i);
+
+			pg_atomic_init_u64(&buffer->insertPos, 0);
+			buffer->pid = 0;
+		}
+	}
+}
+
+void
+otracepoint_emit(OTracepointKind kind, uint64 arg1, uint64 arg2)
+{
+	OTracepointBuffer *buffer;
+	OTracepointRecord *record;
+	uint64		pos;
+
+	Assert(oTracepointBuffers != NULL);
+
+	if (MyProc == NULL)
+		return;
+
+	buffer = otracepoint_buffer(MyProc->pgprocno);
+	pos = pg_atomic_read_u64(&buffer->insertPos);
+	record = &buffer->records[pos % tracepointRecordsCount];
+	record->time = GetCurrentTimestamp();
+	record->kind = (uint32) kind;
+	record->arg1 = arg1;
+	record->arg2 = arg2;
+	buffer->pid = MyProcPid;
+
+	pg_write_barrier();
+	pg_atomic_write_u64(&buffer->insertPos, pos + 1);
+}
+
+Datum
+orioledb_tracepoints(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	bool		randomAccess;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	AttrNumber	attnum;
+	OTracepointRecord *copy;
+	int			i;
+
+	/* The tupdesc and tuplestore must be created in ecxt_per_query_memory */
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTemplateTupleDesc(6);
+	attnum = (AttrNumber) 1;
+	TupleDescInitEntry(tupdesc, attnum, "pid", INT4OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "pos", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "time", TIMESTAMPTZOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "event", TEXTOID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "arg1", INT8OID, -1, 0);
+	attnum++;
+	TupleDescInitEntry(tupdesc, attnum, "arg2", INT8OID, -1, 0);
+
+	randomAccess = (rsinfo->allowedModes & SFRM_Materialize_Random) != 0;
+	tupstore = tuplestore_begin_heap(randomAccess, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (oTracepointBuffers == NULL)
+		PG_RETURN_VOID();
+
+	copy = (OTracepointRecord *) palloc(mul_size(tracepointRecordsCount,
+												 sizeof(OTracepointRecord)));
+
+	for (i = 0; i < max_procs; i++)
+	{
+		OTracepointBuffer *buffer = otracepoint_buffer(i);
+		uint64		endPos,
+					copyPos,
+					startPos,
+					recheckPos,
+					pos;
+		int			pid;
+
+		endPos = pg_atomic_read_u64(&buffer->insertPos);
+		if (endPos == 0)
+			continue;
+
+		copyPos = endPos > tracepointRecordsCount ?
+			endPos - tracepointRecordsCount : 0;
+		pid = buffer->pid;
+
+		pg_read_barrier();
+
+		for (pos = copyPos; pos < endPos; pos++)
+			copy[pos - copyPos] = buffer->records[pos % tracepointRecordsCount];
+
+		/*
+		 * Records overwritten while we copied are torn: discard everything
+		 * the new insert position proves recycled.
+		 */
+		pg_read_barrier();
+		recheckPos = pg_atomic_read_u64(&buffer->insertPos);
+		startPos = copyPos;
+		if (recheckPos > tracepointRecordsCount)
+			startPos = Max(startPos, recheckPos - tracepointRecordsCount);
+
+		for (pos = startPos; pos < endPos; pos++)
+		{
+			OTracepointRecord *record = &copy[pos - copyPos];
+			Datum		values[6];
+			bool		nulls[6] = {false, false, false, false, false, false};
+
+			if (record->kind >= OTRACEPOINT_COUNT)
+				continue;
+
+			values[0] = Int32GetDatum(pid);
+			values[1] = Int64GetDatum((int64) pos);
+			values[2] = TimestampTzGetDatum(record->time);
+			values[3] = PointerGetDatum(cstring_to_text(tracepointnames[record->kind]));
+			values[4] = Int64GetDatum((int64) record->arg1);
+			values[5] = Int64GetDatum((int64) record->arg2);
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	pfree(copy);
+
+	PG_RETURN_VOID();
+}
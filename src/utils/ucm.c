@@ -15,12 +15,27 @@
 #include "orioledb.h"
 
 #include "utils/ucm.h"
+#include "workers/bgwriter.h"
 
 #define UCM_BRANCH_FACTOR	15
 #define UCM_LEVEL_BITS		4
 #define UCM_LEVEL_MASK		0xF
 
+/*
+ * TinyLFU admission sketch: a count-min sketch of 4-bit saturating counters
+ * packed two per byte.  Each disk page load bumps UCM_SKETCH_HASHES counters;
+ * the minimum of them estimates how often the page has been loaded within the
+ * current sample window.  Once sketchSampleSize loads have been accounted,
+ * all counters are halved, so the estimate tracks recent frequency rather
+ * than all-time frequency.
+ */
+#define UCM_SKETCH_HASHES		4
+#define UCM_SKETCH_COUNTER_MAX	0xF
+#define UCM_SKETCH_COUNTERS_PER_PAGE	4
+#define UCM_SKETCH_SAMPLE_FACTOR		16
+
 static bool skip_ucm = false;
+static bool ucm_scan_hint = false;
 
 static int	init_ucm_non_leaf_recursive(UsageCountMap *map, int i);
 static void ucm_inc_recursive(UsageCountMap *map, int i, int prev, int next);
@@ -60,7 +75,27 @@ estimate_ucm_space(UsageCountMap *map, OInMemoryBlkno offset, OInMemoryBlkno siz
 
 	map->total = n_non_leaf_vars + n_leaf_vars;
 	map->nonLeaf = n_non_leaf_vars;
-	return PG_CACHE_LINE_SIZE + sizeof(pg_atomic_uint32) * map->total;
+
+	map->sketch = NULL;
+	map->sketchOps = NULL;
+	map->sketchMask = 0;
+	if (tinylfu_admission)
+	{
+		uint64		nCounters = UINT64CONST(1);
+
+		/*
+		 * Power-of-two number of counters, at least several counters per pool
+		 * page, so that hash positions can be taken by masking.
+		 */
+		while (nCounters < (uint64) size * UCM_SKETCH_COUNTERS_PER_PAGE)
+			nCounters *= 2;
+		map->sketchMask = nCounters - 1;
+		map->sketchSampleSize = size * UCM_SKETCH_SAMPLE_FACTOR;
+	}
+
+	return PG_CACHE_LINE_SIZE + sizeof(pg_atomic_uint32) * map->total +
+		(map->sketchMask == 0 ? 0 :
+		 PG_CACHE_LINE_SIZE + CACHELINEALIGN((map->sketchMask + 1) / 2));
 }
 
 static int
@@ -122,12 +157,26 @@ init_ucm(UsageCountMap *map, Pointer ptr, bool found)
 	ptr += PG_CACHE_LINE_SIZE;
 
 	map->ucm = (pg_atomic_uint32 *) ptr;
+	ptr += sizeof(pg_atomic_uint32) * map->total;
+
+	if (map->sketchMask != 0)
+	{
+		map->sketchOps = (pg_atomic_uint32 *) ptr;
+		ptr += PG_CACHE_LINE_SIZE;
+		map->sketch = (uint8 *) ptr;
+	}
 
 	if (found)
 		return;
 
 	pg_atomic_init_u32(map->epoch, 0);
 
+	if (map->sketchMask != 0)
+	{
+		pg_atomic_init_u32(map->sketchOps, 0);
+		memset(map->sketch, 0, (map->sketchMask + 1) / 2);
+	}
+
 	/* Init leaf variables */
 	blkno = 0;
 	for (i = map->nonLeaf; i < map->total; i++)
@@ -226,7 +275,7 @@ page_inc_usage_count(UsageCountMap *map, OInMemoryBlkno blkno,
 
 	if (usageCount == InvalidUsageCount ||
 		usageCount == UCM_FREE_PAGES_LEVEL ||
-		(!no_skip && skip_ucm))
+		(!no_skip && (skip_ucm || ucm_scan_hint)))
 		return;
 
 	Assert(usageCount < UCM_USAGE_LEVELS);
@@ -401,6 +450,46 @@ ucm_epoch_shift(UsageCountMap *map)
 	pg_atomic_compare_exchange_u32(map->epoch, &epoch, next_epoch);
 }
 
+/*
+ * Epoch maintenance performed by the background writers, see bgwriter_main().
+ *
+ * Shift the epoch when every in-use page has climbed into the top two usage
+ * levels (the historical ucm_epoch_needs_shift() condition, which restores
+ * resolution at the bottom of the scale), and also when eviction is needed
+ * but the eviction edge - the lowest level relative to the epoch - has
+ * drained.  In the latter case the clock in ppool_run_clock() is about to
+ * get stuck, and whatever backend runs it would have to advance the epoch
+ * itself; shifting here keeps that cost off foreground paths.
+ *
+ * Only the root counters are examined, so the cost per invocation is bounded
+ * regardless of the pool size.
+ */
+void
+ucm_epoch_maintenance(UsageCountMap *map, bool need_eviction)
+{
+	uint32		epoch,
+				edge_mask;
+	int			i;
+
+	if (ucm_epoch_needs_shift(map))
+	{
+		ucm_epoch_shift(map);
+		return;
+	}
+
+	if (!need_eviction)
+		return;
+
+	epoch = pg_atomic_read_u32(map->epoch);
+	edge_mask = UCM_LEVEL_MASK << ((epoch % UCM_USAGE_LEVELS) * UCM_LEVEL_BITS);
+	for (i = 0; i < UCM_BRANCH_FACTOR; i++)
+	{
+		if (pg_atomic_read_u32(&map->ucm[i]) & edge_mask)
+			return;
+	}
+	ucm_epoch_shift(map);
+}
+
 OInMemoryBlkno
 ucm_next_blkno(UsageCountMap *map, OInMemoryBlkno init_blkno,
 			   uint32 mask_src)
@@ -412,6 +501,7 @@ ucm_next_blkno(UsageCountMap *map, OInMemoryBlkno init_blkno,
 	int64		num_iterations;
 	uint32		mask;
 	uint32		epoch;
+	bool		wake_sent = false;
 
 	epoch = pg_atomic_read_u32(map->epoch);
 
@@ -475,16 +565,34 @@ retry:
 				 */
 				if (base == 0)
 				{
-					uint32		next_epoch;
-
-					if (epoch == UCM_USAGE_LEVELS - 1)
-						next_epoch = 0;
+					/*
+					 * The requested usage counts have drained, so the epoch
+					 * has to advance before this scan can succeed.  Epoch
+					 * maintenance belongs to the background writers (see
+					 * ucm_epoch_maintenance()); give them one chance to do
+					 * the shift and recheck, falling back to shifting
+					 * ourselves in case they are disabled or have not
+					 * started yet.
+					 */
+					if (!IsBGWriter && !wake_sent)
+					{
+						bgwriter_wakeup();
+						wake_sent = true;
+					}
 					else
-						next_epoch = epoch + 1;
-
-					pg_atomic_compare_exchange_u32(map->epoch,
-												   &epoch,
-												   next_epoch);
+					{
+						uint32		next_epoch;
+
+						if (epoch == UCM_USAGE_LEVELS - 1)
+							next_epoch = 0;
+						else
+							next_epoch = epoch + 1;
+
+						pg_atomic_compare_exchange_u32(map->epoch,
+													   &epoch,
+													   next_epoch);
+					}
+					epoch = pg_atomic_read_u32(map->epoch);
 					goto retry;
 				}
 				factor *= UCM_BRANCH_FACTOR;
@@ -501,8 +609,14 @@ retry:
 	}
 }
 
+/*
+ * Occupy a free page, preferring pages at or after `init_blkno`.  Starting
+ * the search from a per-backend location spreads concurrent backends over
+ * the map and keeps a backend reusing pages from its own region, which
+ * first-touch NUMA policy placed on its local node.
+ */
 OInMemoryBlkno
-ucm_occupy_free_page(UsageCountMap *map)
+ucm_occupy_free_page(UsageCountMap *map, OInMemoryBlkno init_blkno)
 {
 	int64		location;
 	int64		i;
@@ -511,8 +625,10 @@ ucm_occupy_free_page(UsageCountMap *map)
 	int64		num_iterations;
 	uint32		mask;
 
+	Assert(init_blkno >= map->offset && init_blkno < map->offset + map->size);
+
 	mask = UCM_LEVEL_MASK << (UCM_FREE_PAGES_LEVEL * UCM_LEVEL_BITS);
-	location = 0;
+	location = init_blkno - map->offset;
 	factor = map->rootFactor;
 	base = 0;
 	num_iterations = 0;
@@ -570,6 +686,114 @@ ucm_occupy_free_page(UsageCountMap *map)
 	}
 }
 
+/*
+ * Mix `key` into the position of the i-th sketch counter (splitmix64
+ * finalizer).
+ */
+static inline uint64
+ucm_sketch_hash(uint64 key, int i)
+{
+	uint64		h = key + UINT64CONST(0x9E3779B97F4A7C15) * (i + 1);
+
+	h = (h ^ (h >> 30)) * UINT64CONST(0xBF58476D1CE4E5B9);
+	h = (h ^ (h >> 27)) * UINT64CONST(0x94D049BB133111EB);
+	return h ^ (h >> 31);
+}
+
+/*
+ * Sketch counters are read and written without atomics: a concurrently lost
+ * increment only blurs an estimate that is approximate by design.
+ */
+static inline uint32
+ucm_sketch_read(UsageCountMap *map, uint64 pos)
+{
+	uint8		byte = map->sketch[pos / 2];
+
+	return (pos & 1) ? (byte >> 4) : (byte & 0xF);
+}
+
+static inline void
+ucm_sketch_inc(UsageCountMap *map, uint64 pos)
+{
+	uint8		byte = map->sketch[pos / 2];
+
+	if (pos & 1)
+	{
+		if ((byte >> 4) < UCM_SKETCH_COUNTER_MAX)
+			map->sketch[pos / 2] = byte + 0x10;
+	}
+	else
+	{
+		if ((byte & 0xF) < UCM_SKETCH_COUNTER_MAX)
+			map->sketch[pos / 2] = byte + 0x01;
+	}
+}
+
+/*
+ * Halve all sketch counters.  Called once per sample window by the backend
+ * that crossed the ops threshold; the linear pass over the sketch is cheap
+ * relative to the disk reads the window consists of.
+ */
+static void
+ucm_sketch_halve(UsageCountMap *map)
+{
+	uint64		bytes = (map->sketchMask + 1) / 2;
+	uint64		i;
+
+	for (i = 0; i < bytes; i++)
+		map->sketch[i] = (map->sketch[i] >> 1) & 0x77;
+}
+
+/*
+ * Account a disk page load in the admission sketch and choose the usage
+ * count to admit the page at.
+ *
+ * Without the sketch every loaded page is admitted two levels above the
+ * eviction edge, so a single large read of cold data ages the whole working
+ * set out of the pool.  With the sketch, pages seen for the first time within
+ * the sample window land one level above the edge (reclaimed soon unless
+ * touched again), while pages which keep coming back from disk are admitted
+ * higher.  A backend inside a sequential scan admits at the lowest level
+ * unconditionally.
+ */
+uint32
+ucm_admission_usage_count(UsageCountMap *map, uint64 key)
+{
+	uint32		epoch = pg_atomic_read_u32(map->epoch);
+	uint32		levelsUp = 2;
+
+	if (ucm_scan_hint)
+	{
+		levelsUp = 1;
+	}
+	else if (map->sketchMask != 0)
+	{
+		uint32		estimate = UCM_SKETCH_COUNTER_MAX;
+		int			i;
+
+		for (i = 0; i < UCM_SKETCH_HASHES; i++)
+		{
+			uint64		pos = ucm_sketch_hash(key, i) & map->sketchMask;
+
+			ucm_sketch_inc(map, pos);
+			estimate = Min(estimate, ucm_sketch_read(map, pos));
+		}
+
+		if (pg_atomic_fetch_add_u32(map->sketchOps, 1) >= map->sketchSampleSize)
+		{
+			pg_atomic_write_u32(map->sketchOps, 0);
+			ucm_sketch_halve(map);
+		}
+
+		if (estimate <= 1)
+			levelsUp = 1;
+		else if (estimate >= 8)
+			levelsUp = 3;
+	}
+
+	return (epoch + levelsUp) % UCM_USAGE_LEVELS;
+}
+
 void
 set_skip_ucm(void)
 {
@@ -581,3 +805,20 @@ unset_skip_ucm(void)
 {
 	skip_ucm = false;
 }
+
+/*
+ * Mark the backend as running a sequential scan: pages it loads are admitted
+ * at the lowest usage count and its accesses don't promote pages, so a large
+ * scan can't flush the hot working set out of the pool.
+ */
+void
+set_ucm_scan_hint(void)
+{
+	ucm_scan_hint = true;
+}
+
+void
+unset_ucm_scan_hint(void)
+{
+	ucm_scan_hint = false;
+}
@@ -14,6 +14,9 @@
 
 #include "orioledb.h"
 
+#include "btree/io.h"
+#include "checkpoint/checkpoint.h"
+#include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/ucm.h"
@@ -37,6 +40,74 @@
 static volatile sig_atomic_t shutdown_requested = false;
 bool		IsBGWriter = false;
 
+/*
+ * Proc numbers of the running background writers, so that foreground
+ * backends can wake them up when a page pool dips below the free pages
+ * watermark.
+ */
+static pg_atomic_uint32 *bgwriterProcnos = NULL;
+
+/*
+ * Number of foreground page shortages since a background writer last looked.
+ * Every bgwriter_wakeup() call bumps it; the writers read-and-reset it each
+ * pass and treat a non-zero value as proof they are running behind.
+ */
+static pg_atomic_uint32 *bgwriterShortageCount = NULL;
+
+#define BGWRITER_INVALID_PROCNO		PG_UINT32_MAX
+
+/* bounds for the adaptive batch/sleep control loop, see bgwriter_main() */
+#define BGWRITER_MAX_BATCH_MULTIPLIER	16
+#define BGWRITER_MIN_DELAY_DIVISOR		16
+
+Size
+bgwriter_shmem_needs(void)
+{
+	return add_size(mul_size(bgwriter_num_workers, sizeof(pg_atomic_uint32)),
+					CACHELINEALIGN(sizeof(pg_atomic_uint32)));
+}
+
+void
+bgwriter_shmem_init(Pointer ptr, bool found)
+{
+	bgwriterProcnos = (pg_atomic_uint32 *) ptr;
+	ptr += mul_size(bgwriter_num_workers, sizeof(pg_atomic_uint32));
+	bgwriterShortageCount = (pg_atomic_uint32 *) ptr;
+
+	if (!found)
+	{
+		int			i;
+
+		for (i = 0; i < bgwriter_num_workers; i++)
+			pg_atomic_init_u32(&bgwriterProcnos[i], BGWRITER_INVALID_PROCNO);
+		pg_atomic_init_u32(bgwriterShortageCount, 0);
+	}
+}
+
+/*
+ * Set the latches of all the running background writers.  Called by
+ * foreground backends on page shortage; cheap enough for that path, since
+ * the shortage itself is the rare case the watermark maintains.
+ */
+void
+bgwriter_wakeup(void)
+{
+	int			i;
+
+	if (bgwriterProcnos == NULL)
+		return;
+
+	pg_atomic_fetch_add_u32(bgwriterShortageCount, 1);
+
+	for (i = 0; i < bgwriter_num_workers; i++)
+	{
+		uint32		procno = pg_atomic_read_u32(&bgwriterProcnos[i]);
+
+		if (procno != BGWRITER_INVALID_PROCNO)
+			SetLatch(&GetPGProcByNumber(procno)->procLatch);
+	}
+}
+
 static void
 handle_sigterm(SIGNAL_ARGS)
 {
@@ -45,7 +116,7 @@ handle_sigterm(SIGNAL_ARGS)
 }
 
 void
-register_bgwriter(void)
+register_bgwriter(int num)
 {
 	BackgroundWorker worker;
 
@@ -58,6 +129,7 @@ register_bgwriter(void)
 	strcpy(worker.bgw_function_name, "bgwriter_main");
 	strcpy(worker.bgw_name, "orioledb background writer");
 	strcpy(worker.bgw_type, "orioledb background writer");
+	worker.bgw_main_arg = Int32GetDatum(num);
 	RegisterBackgroundWorker(&worker);
 }
 
@@ -65,10 +137,15 @@ void
 bgwriter_main(Datum main_arg)
 {
 	OPagePool  *pool;
+	int			worker_num = DatumGetInt32(main_arg);
 	int			rc,
 				wake_events = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT;
 	bool		need_eviction,
 				need_write;
+	int			batch_baseline = bgwriter_lru_maxpages * (BLCKSZ / ORIOLEDB_BLCKSZ),
+				batch_limit = batch_baseline;
+	long		sleep_time = BgWriterDelay;
+	uint32		prev_dirty[OPagePoolTypesCount] = {0};
 
 	/* enable timeout for relation lock */
 	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
@@ -102,6 +179,8 @@ bgwriter_main(Datum main_arg)
 		return;
 	}
 
+	pg_atomic_write_u32(&bgwriterProcnos[worker_num], MyProc->pgprocno);
+
 	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
 												  "orioledb bgwriter current transaction context",
 												  ALLOCSET_DEFAULT_SIZES);
@@ -119,6 +198,7 @@ bgwriter_main(Datum main_arg)
 			OPagePoolType poolType;
 			UndoLocation lastUsedLocation;
 			UndoLocation writeInProgressLocation;
+			bool		behind;
 
 			if (shutdown_requested)
 				break;
@@ -128,16 +208,31 @@ bgwriter_main(Datum main_arg)
 			 * checkpoint.
 			 */
 			rc = WaitLatch(MyLatch, wake_events,
-						   BgWriterDelay,
+						   sleep_time,
 						   WAIT_EVENT_BGWRITER_MAIN);
 
 			if (rc & WL_POSTMASTER_DEATH)
 				shutdown_requested = true;
 
+			/*
+			 * Any foreground shortage since the previous pass means we did
+			 * not keep enough pages clean and free in time.
+			 */
+			behind = pg_atomic_exchange_u32(bgwriterShortageCount, 0) > 0;
+
+			/*
+			 * Shift the free pages watermarks towards the pools where
+			 * foreground backends had to run the clock themselves.
+			 */
+			if (worker_num == 0)
+				ppool_adjust_watermarks();
+
 			for (poolType = 0; poolType < OPagePoolTypesCount && !shutdown_requested; poolType++)
 			{
+				uint32		cur_dirty;
+
 				pool = get_ppool(poolType);
-				need_eviction = ppool_free_pages_count(pool) < pool->size / 20;
+				need_eviction = ppool_free_pages_count(pool) < ppool_watermark_pages(pool);
 				need_write = ppool_dirty_pages_count(pool) > pool->size / 2;
 
 				if (need_eviction || need_write)
@@ -149,13 +244,17 @@ bgwriter_main(Datum main_arg)
 						ppool_run_clock(pool, need_eviction, &shutdown_requested);
 						i++;
 
-						if (i >= bgwriter_lru_maxpages * (BLCKSZ / ORIOLEDB_BLCKSZ))
+						if (i >= batch_limit)
+						{
+							/* ran out of budget with work still pending */
+							behind = true;
 							break;
+						}
 
 						if (shutdown_requested)
 							break;
 
-						need_eviction = ppool_free_pages_count(pool) < pool->size / 20;
+						need_eviction = ppool_free_pages_count(pool) < ppool_watermark_pages(pool);
 						need_write = ppool_dirty_pages_count(pool) > pool->size / 2;
 					}
 
@@ -163,10 +262,68 @@ bgwriter_main(Datum main_arg)
 					MemoryContextReset(TopTransactionContext);
 				}
 
-				if (!shutdown_requested && ucm_epoch_needs_shift(&pool->ucm))
+				/*
+				 * A growing dirty count despite the pass above means pages
+				 * are dirtied faster than we clean them.
+				 */
+				cur_dirty = ppool_dirty_pages_count(pool);
+				if (cur_dirty > prev_dirty[poolType] &&
+					cur_dirty > pool->size / 2)
+					behind = true;
+				prev_dirty[poolType] = cur_dirty;
+
+				if (!shutdown_requested)
+					ucm_epoch_maintenance(&pool->ucm, need_eviction);
+			}
+
+			/*
+			 * Feedback control: while behind, write bigger batches more
+			 * often; once the load subsides, decay back to the configured
+			 * cadence.  bgwriter_lru_maxpages stays the baseline knob, the
+			 * multipliers only stretch it under pressure.
+			 */
+			if (behind)
+			{
+				batch_limit = Min(batch_limit * 2,
+								  batch_baseline * BGWRITER_MAX_BATCH_MULTIPLIER);
+				sleep_time = Max(sleep_time / 2,
+								 Max(BgWriterDelay / BGWRITER_MIN_DELAY_DIVISOR, 1));
+			}
+			else
+			{
+				batch_limit = Max(batch_limit / 2, batch_baseline);
+				sleep_time = Min(sleep_time * 2, BgWriterDelay);
+			}
+
+			/*
+			 * Fan leaf flushing of the tree being checkpointed out to the
+			 * whole pool of background writers.
+			 */
+			if (checkpoint_flush_ahead && !shutdown_requested)
+			{
+				if (checkpoint_flush_ahead_pass(worker_num,
+												bgwriter_num_workers,
+												&shutdown_requested))
 				{
-					if (ucm_epoch_needs_shift(&pool->ucm))
-						ucm_epoch_shift(&pool->ucm);
+					MemoryContextReset(CurTransactionContext);
+					MemoryContextReset(TopTransactionContext);
+				}
+			}
+
+			/*
+			 * Merge sparse leaf pages left behind by bulk deletes, so that
+			 * scans don't stumble over them and foreground paths don't pay
+			 * for the merges.
+			 */
+			if (bgwriter_merge_pages > 0 && !shutdown_requested)
+			{
+				if (merge_sparse_pages_pass(worker_num,
+											bgwriter_num_workers,
+											bgwriter_merge_pages,
+											&shutdown_requested) > 0)
+				{
+					MemoryContextReset(CurTransactionContext);
+					MemoryContextReset(TopTransactionContext);
 				}
 			}
 
@@ -182,6 +339,24 @@ bgwriter_main(Datum main_arg)
 					write_undo(targetLocation, minProcReservedLocation, true);
 			}
 
+			/*
+			 * Likewise write the oldest part of the xidmap circular buffer
+			 * out before foreground oxid allocation runs into the window end.
+			 */
+			if (!shutdown_requested)
+				write_xidsmap_ahead();
+
+			/*
+			 * Trim retained undo incrementally.  Each pass unlinks at most
+			 * orioledb.undo_trim_max_files undo files, so the space freed by
+			 * the end of a long-lived snapshot is reclaimed at a steady pace
+			 * here instead of in a foreground or checkpoint burst.  One
+			 * worker is enough: the pass is cheap when there is nothing to
+			 * trim.
+			 */
+			if (worker_num == 0 && !shutdown_requested)
+				update_min_undo_locations(false, true);
+
 			ResetLatch(MyLatch);
 		}
 		elog(LOG, "orioledb bgwriter is shut down");
@@ -0,0 +1,353 @@
+/*-------------------------------------------------------------------------
+ *
+ * rollback.c
+ *		Parallel rollback worker process implementation for orioledb engine.
+ *
+ * Rolling back a large transaction walks its whole undo stack in a single
+ * backend.  Undo items of different trees are independent, and items of the
+ * same tree revert in the order they are applied, so the stack can be fanned
+ * out to background workers partitioned by tree: the aborting backend walks
+ * the chain and routes the locations of B-tree modify and row lock items
+ * over per-worker queues, keeping every tree pinned to one worker.  The
+ * remaining item types (relnode drops, invalidations etc.) are rare and stay
+ * in the backend, applied after a barrier which drains the queues, so they
+ * observe the same state as in a serial walk.
+ *
+ * A rollback must not complete partially, hence a worker failure in the
+ * middle of it escalates to PANIC, the same way an error inside a serial
+ * abort would.
+ *
+ * Copyright (c) 2021-2022, Oriole DB Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/rollback.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/undo.h"
+#include "recovery/recovery.h"
+#include "transam/oxid.h"
+#include "transam/undo.h"
+#include "workers/rollback.h"
+
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/sinvaladt.h"
+#include "tcop/tcopprot.h"
+#include "utils/inval.h"
+#include "utils/syscache.h"
+#include "utils/timeout.h"
+
+/* size of a single worker queue ring */
+#define ROLLBACK_QUEUE_SIZE		(64 * 1024)
+/* number of undo item locations sent in one queue message */
+#define ROLLBACK_BATCH_ITEMS	(128)
+
+int			parallel_rollback_workers = 0;
+
+/*
+ * Shared state at the beginning of the DSM segment, followed by the
+ * per-worker queue rings.
+ */
+typedef struct
+{
+	OXid		oxid;
+	bool		changeCountsValid;
+	int			nworkers;
+	pg_atomic_uint64 consumed[FLEXIBLE_ARRAY_MEMBER];
+} ORollbackShared;
+
+#define ROLLBACK_SHARED_SIZE(nworkers) \
+	(CACHELINEALIGN(offsetof(ORollbackShared, consumed) + \
+					(nworkers) * sizeof(pg_atomic_uint64)))
+#define GET_ROLLBACK_QUEUE(shared, i) \
+	((shm_mq *) ((Pointer) (shared) + \
+				 ROLLBACK_SHARED_SIZE((shared)->nworkers) + \
+				 (i) * ROLLBACK_QUEUE_SIZE))
+
+typedef struct
+{
+	shm_mq_handle *mqh;
+	BackgroundWorkerHandle *handle;
+	uint64		sent;
+	UndoLocation batch[ROLLBACK_BATCH_ITEMS];
+	int			batchItems;
+} RollbackWorkerState;
+
+static dsm_segment *rollback_seg = NULL;
+static ORollbackShared *rollback_shared = NULL;
+static RollbackWorkerState *rollback_workers = NULL;
+static int	rollback_nworkers = 0;
+
+static void rollback_worker_flush(int i);
+static void rollback_worker_check_alive(int i);
+
+bool
+o_parallel_rollback_active(void)
+{
+	return rollback_nworkers > 0;
+}
+
+/*
+ * Launches the parallel rollback workers.  Silently stays serial when
+ * workers are disabled, unavailable or we can't use them in the current
+ * environment.
+ */
+void
+o_parallel_rollback_begin(OXid oxid, bool changeCountsValid)
+{
+	int			nworkers = parallel_rollback_workers;
+	Size		size;
+	Pointer		ptr;
+	int			i;
+
+	Assert(rollback_seg == NULL);
+
+	if (nworkers <= 0 || !IsUnderPostmaster || is_recovery_process())
+		return;
+
+	size = ROLLBACK_SHARED_SIZE(nworkers) +
+		(Size) nworkers * ROLLBACK_QUEUE_SIZE;
+	rollback_seg = dsm_create(size, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (rollback_seg == NULL)
+		return;
+
+	ptr = (Pointer) dsm_segment_address(rollback_seg);
+	rollback_shared = (ORollbackShared *) ptr;
+	rollback_shared->oxid = oxid;
+	rollback_shared->changeCountsValid = changeCountsValid;
+	rollback_shared->nworkers = nworkers;
+	for (i = 0; i < nworkers; i++)
+		pg_atomic_init_u64(&rollback_shared->consumed[i], 0);
+
+	rollback_workers = (RollbackWorkerState *)
+		MemoryContextAllocZero(TopMemoryContext,
+							   sizeof(RollbackWorkerState) * nworkers);
+
+	for (i = 0; i < nworkers; i++)
+	{
+		char		worker_name[128];
+		BackgroundWorker worker;
+		shm_mq	   *mq;
+
+		mq = shm_mq_create((Pointer) GET_ROLLBACK_QUEUE(rollback_shared, i),
+						   ROLLBACK_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+		rollback_workers[i].mqh = shm_mq_attach(mq, rollback_seg, NULL);
+
+		sprintf(worker_name, "orioledb rollback worker %d", i);
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_ConsistentState;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(rollback_seg));
+		memcpy(worker.bgw_extra, &i, sizeof(i));
+		strcpy(worker.bgw_library_name, "orioledb");
+		strcpy(worker.bgw_function_name, "rollback_worker_main");
+		strcpy(worker.bgw_name, worker_name);
+		strcpy(worker.bgw_type, "orioledb rollback worker");
+		worker.bgw_notify_pid = MyProcPid;
+
+		if (!RegisterDynamicBackgroundWorker(&worker,
+											 &rollback_workers[i].handle))
+			break;
+		shm_mq_set_handle(rollback_workers[i].mqh,
+						  rollback_workers[i].handle);
+	}
+
+	if (i == 0)
+	{
+		/* no worker slots available, fall back to the serial walk */
+		dsm_detach(rollback_seg);
+		pfree(rollback_workers);
+		rollback_seg = NULL;
+		rollback_shared = NULL;
+		rollback_workers = NULL;
+		return;
+	}
+
+	rollback_nworkers = i;
+}
+
+/*
+ * Routes an undo item to the worker owning its tree.  Returns false when
+ * the item can't be applied out of the backend.
+ */
+bool
+o_parallel_rollback_route(UndoLocation location, UndoStackItem *item)
+{
+	ORelOids	oids;
+	int			i;
+	RollbackWorkerState *state;
+
+	Assert(rollback_nworkers > 0);
+
+	if (item->type != ModifyUndoItemType && item->type != RowLockUndoItemType)
+		return false;
+
+	oids = btree_undo_item_get_oids(item);
+	i = oids.relnode % rollback_nworkers;
+
+	state = &rollback_workers[i];
+	state->batch[state->batchItems++] = location;
+	if (state->batchItems == ROLLBACK_BATCH_ITEMS)
+		rollback_worker_flush(i);
+
+	return true;
+}
+
+/*
+ * Waits until the workers have applied everything routed so far.
+ */
+void
+o_parallel_rollback_barrier(void)
+{
+	int			i;
+
+	for (i = 0; i < rollback_nworkers; i++)
+	{
+		if (rollback_workers[i].batchItems > 0)
+			rollback_worker_flush(i);
+	}
+
+	for (i = 0; i < rollback_nworkers; i++)
+	{
+		while (pg_atomic_read_u64(&rollback_shared->consumed[i]) <
+			   rollback_workers[i].sent)
+		{
+			rollback_worker_check_alive(i);
+			pg_usleep(1000L);
+		}
+	}
+}
+
+/*
+ * Drains the queues and releases the workers and the shared segment.
+ */
+void
+o_parallel_rollback_end(void)
+{
+	int			i;
+
+	Assert(rollback_nworkers > 0);
+
+	o_parallel_rollback_barrier();
+
+	for (i = 0; i < rollback_nworkers; i++)
+	{
+		shm_mq_detach(rollback_workers[i].mqh);
+		if (WaitForBackgroundWorkerShutdown(rollback_workers[i].handle) !=
+			BGWH_STOPPED)
+			elog(PANIC, "orioledb rollback worker %d didn't stop", i);
+		pfree(rollback_workers[i].handle);
+	}
+
+	dsm_detach(rollback_seg);
+	pfree(rollback_workers);
+	rollback_seg = NULL;
+	rollback_shared = NULL;
+	rollback_workers = NULL;
+	rollback_nworkers = 0;
+}
+
+static void
+rollback_worker_flush(int i)
+{
+	RollbackWorkerState *state = &rollback_workers[i];
+	shm_mq_result result;
+
+	result = shm_mq_send(state->mqh,
+						 state->batchItems * sizeof(UndoLocation),
+						 state->batch, false);
+	if (result != SHM_MQ_SUCCESS)
+		elog(PANIC, "orioledb rollback worker %d detached unexpectedly", i);
+	state->sent += state->batchItems;
+	state->batchItems = 0;
+}
+
+static void
+rollback_worker_check_alive(int i)
+{
+	pid_t		pid;
+
+	if (GetBackgroundWorkerPid(rollback_workers[i].handle, &pid) !=
+		BGWH_STARTED)
+		elog(PANIC, "orioledb rollback worker %d exited before finishing its undo items", i);
+}
+
+/*
+ * Rollback worker main function.
+ */
+void
+rollback_worker_main(Datum main_arg)
+{
+	int			id;
+	dsm_segment *seg;
+	ORollbackShared *shared;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+
+	memcpy(&id, MyBgworkerEntry->bgw_extra, sizeof(id));
+
+	elog(DEBUG1, "orioledb rollback worker %d started.", id);
+
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+	/* enable relation cache invalidation (remove old table descriptors) */
+	RelationCacheInitialize();
+	InitCatalogCache();
+	SharedInvalBackendInit(false);
+
+	SetProcessingMode(NormalProcessing);
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		elog(ERROR, "unable to attach to rollback DSM segment");
+	shared = (ORollbackShared *) dsm_segment_address(seg);
+
+	mq = GET_ROLLBACK_QUEUE(shared, id);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	set_current_oxid(shared->oxid);
+
+	while (true)
+	{
+		shm_mq_result result;
+		Size		size;
+		Pointer		data;
+		UndoLocation *locations;
+		int			nitems,
+					i;
+
+		result = shm_mq_receive(mqh, &size, (void **) &data, false);
+		if (result == SHM_MQ_DETACHED)
+			break;
+		Assert(result == SHM_MQ_SUCCESS);
+
+		locations = (UndoLocation *) data;
+		nitems = size / sizeof(UndoLocation);
+		for (i = 0; i < nitems; i++)
+			apply_undo_item(locations[i], shared->oxid,
+							shared->changeCountsValid);
+
+		pg_atomic_add_fetch_u64(&shared->consumed[id], nitems);
+	}
+
+	shm_mq_detach(mqh);
+	dsm_detach(seg);
+
+	elog(DEBUG1, "orioledb rollback worker %d finished.", id);
+	proc_exit(0);
+}
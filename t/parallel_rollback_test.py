@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+class ParallelRollbackTest(BaseTest):
+	def setUp(self):
+		super().setUp()
+		node = self.node
+		node.append_conf('postgresql.conf',
+						 "orioledb.parallel_rollback_workers = 2\n"
+						 "max_worker_processes = 20\n")
+		node.start()
+		node.safe_psql('postgres',
+					 """CREATE EXTENSION IF NOT EXISTS orioledb;
+					    CREATE TABLE IF NOT EXISTS o_par_rollback (
+							id integer NOT NULL,
+							value integer NOT NULL,
+							PRIMARY KEY (id)
+						) USING orioledb;
+						CREATE INDEX o_par_rollback_ix
+							ON o_par_rollback (value);""")
+
+	def test_parallel_rollback_insert(self):
+		node = self.node
+		con1 = node.connect()
+
+		con1.begin()
+		con1.execute("INSERT INTO o_par_rollback (SELECT i, i FROM generate_series(1, 200000) i);")
+		con1.rollback()
+		con1.close()
+
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_par_rollback;")[0][0], 0)
+
+		node.execute("INSERT INTO o_par_rollback (SELECT i, i FROM generate_series(1, 1000) i);")
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_par_rollback;")[0][0], 1000)
+		node.stop()
+
+	def test_parallel_rollback_update(self):
+		node = self.node
+
+		node.execute("INSERT INTO o_par_rollback (SELECT i, i FROM generate_series(1, 100000) i);")
+
+		con1 = node.connect()
+		con1.begin()
+		con1.execute("UPDATE o_par_rollback SET value = value + 1;")
+		con1.execute("DELETE FROM o_par_rollback WHERE id % 2 = 0;")
+		con1.rollback()
+		con1.close()
+
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_par_rollback;")[0][0], 100000)
+		self.assertEqual(node.execute("SELECT SUM(value) FROM o_par_rollback;")[0][0], 5000050000)
+		# the secondary index agrees with the primary after the rollback
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_par_rollback WHERE value > 0;")[0][0], 100000)
+		node.stop()
+
+	def test_parallel_rollback_to_savepoint(self):
+		node = self.node
+		con1 = node.connect()
+
+		con1.begin()
+		con1.execute("INSERT INTO o_par_rollback (SELECT i, i FROM generate_series(1, 1000) i);")
+		con1.execute("SAVEPOINT s1;")
+		con1.execute("INSERT INTO o_par_rollback (SELECT i, i FROM generate_series(1001, 100000) i);")
+		con1.execute("ROLLBACK TO SAVEPOINT s1;")
+		con1.commit()
+		con1.close()
+
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_par_rollback;")[0][0], 1000)
+		node.stop()
+
+if __name__ == "__main__":
+	unittest.main()
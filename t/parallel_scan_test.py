@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+from .base_test import ThreadQueryExecutor
+
+class ParallelScanTest(BaseTest):
+	def setUp(self):
+		super().setUp()
+		node = self.node
+		node.append_conf('postgresql.conf',
+						 "min_parallel_table_scan_size = 0\n"
+						 "parallel_setup_cost = 0\n"
+						 "parallel_tuple_cost = 0\n"
+						 "max_parallel_workers_per_gather = 2\n")
+		node.start()
+		node.safe_psql('postgres',
+					 """CREATE EXTENSION IF NOT EXISTS orioledb;
+					    CREATE TABLE IF NOT EXISTS o_par_scan (
+							id int8 NOT NULL,
+							value int8 NOT NULL,
+							PRIMARY KEY (id)
+						) USING orioledb;""")
+
+	def test_parallel_scan_results(self):
+		node = self.node
+
+		node.execute("INSERT INTO o_par_scan (SELECT i, i % 100 FROM generate_series(1, 100000) i);")
+		node.execute("ANALYZE o_par_scan;")
+
+		plan = node.execute("EXPLAIN (COSTS off) SELECT count(*) FROM o_par_scan;")
+		self.assertIn('Parallel Seq Scan on o_par_scan',
+					  [row[0].strip() for row in plan])
+
+		serial = node.execute("""SET max_parallel_workers_per_gather = 0;
+								 SELECT count(*), sum(id), sum(value) FROM o_par_scan;""")
+		parallel = node.execute("SELECT count(*), sum(id), sum(value) FROM o_par_scan;")
+		self.assertEqual(serial, parallel)
+		self.assertEqual(parallel[0][0], 100000)
+		node.stop()
+
+	def test_parallel_scan_concurrent_dml(self):
+		node = self.node
+
+		node.execute("INSERT INTO o_par_scan (SELECT i, i % 100 FROM generate_series(1, 100000) i);")
+		node.execute("ANALYZE o_par_scan;")
+
+		# Concurrent inserts and deletes above the stable keyrange split and
+		# merge pages under the scan, so the watermark keeps landing in the
+		# middle of the keyranges the workers traverse.
+		con1 = node.connect()
+		dml = ""
+		for i in range(5):
+			dml += "INSERT INTO o_par_scan (SELECT i, i % 100 FROM generate_series(100001, 140000) i);\n"
+			dml += "DELETE FROM o_par_scan WHERE id > 100000;\n"
+		t1 = ThreadQueryExecutor(con1, dml)
+		t1.start()
+
+		while t1.is_alive():
+			result = node.execute("SELECT count(*), sum(id) FROM o_par_scan WHERE id <= 100000;")
+			self.assertEqual(result[0][0], 100000)
+			self.assertEqual(result[0][1], 5000050000)
+
+		t1.join()
+		con1.commit()
+		con1.close()
+
+		result = node.execute("SELECT count(*), sum(id) FROM o_par_scan;")
+		self.assertEqual(result[0][0], 100000)
+		self.assertEqual(result[0][1], 5000050000)
+		node.stop()
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import unittest
+
+from .base_test import BaseTest
+
+class UniqueFilterTest(BaseTest):
+	def setUp(self):
+		super().setUp()
+		node = self.node
+		node.append_conf('postgresql.conf',
+						 "orioledb.unique_filter_buffers = 1MB\n")
+		node.start()
+		node.safe_psql('postgres',
+					 """CREATE EXTENSION IF NOT EXISTS orioledb;
+					    CREATE TABLE IF NOT EXISTS o_unique_filter (
+							id integer NOT NULL,
+							value integer NOT NULL,
+							PRIMARY KEY (id)
+						) USING orioledb;
+						CREATE UNIQUE INDEX o_unique_filter_ix
+							ON o_unique_filter (value);""")
+
+	def test_unique_filter_insert(self):
+		node = self.node
+
+		node.execute("INSERT INTO o_unique_filter (SELECT i, i FROM generate_series(1, 10000) i);")
+
+		with self.assertRaises(Exception) as e:
+			node.execute("INSERT INTO o_unique_filter VALUES (10001, 5000);")
+		self.assertErrorMessageEquals(e, 'duplicate key value violates unique constraint "o_unique_filter_ix"')
+
+		node.execute("INSERT INTO o_unique_filter VALUES (10001, 10001);")
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_unique_filter;")[0][0], 10001)
+		node.stop()
+
+	def test_unique_filter_rollback(self):
+		node = self.node
+		con1 = node.connect()
+
+		node.execute("INSERT INTO o_unique_filter (SELECT i, i FROM generate_series(1, 1000) i);")
+
+		# the filter is conservative: values of a rolled back insert may stay
+		# in it, but must not make later inserts of the same values fail
+		con1.begin()
+		con1.execute("INSERT INTO o_unique_filter (SELECT i, i FROM generate_series(1001, 2000) i);")
+		con1.rollback()
+		con1.close()
+
+		node.execute("INSERT INTO o_unique_filter (SELECT i, i FROM generate_series(1001, 2000) i);")
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_unique_filter;")[0][0], 2000)
+		node.stop()
+
+	def test_unique_filter_restart(self):
+		node = self.node
+
+		node.execute("INSERT INTO o_unique_filter (SELECT i, i FROM generate_series(1, 1000) i);")
+		node.stop()
+		node.start()
+
+		# the filter is empty after a restart, checks fall back to the index
+		with self.assertRaises(Exception) as e:
+			node.execute("INSERT INTO o_unique_filter VALUES (1001, 500);")
+		self.assertErrorMessageEquals(e, 'duplicate key value violates unique constraint "o_unique_filter_ix"')
+
+		node.execute("INSERT INTO o_unique_filter VALUES (1001, 1001);")
+		self.assertEqual(node.execute("SELECT COUNT(*) FROM o_unique_filter;")[0][0], 1001)
+		node.stop()
+
+if __name__ == "__main__":
+	unittest.main()